@@ -19,13 +19,24 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#include <ctype.h>
 
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #endif
 
 #include <libdivecomputer/serial.h>
@@ -37,12 +48,6 @@
 #include "common.h"
 #include "utils.h"
 
-#ifdef _WIN32
-#define DC_TICKS_FORMAT "%I64d"
-#else
-#define DC_TICKS_FORMAT "%lld"
-#endif
-
 #define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
 
 typedef struct backend_table_t {
@@ -210,6 +215,8 @@ dctool_event_cb (dc_device_t *device, dc_event_type_t event, const void *data, v
 	const dc_event_devinfo_t *devinfo = (const dc_event_devinfo_t *) data;
 	const dc_event_clock_t *clock = (const dc_event_clock_t *) data;
 	const dc_event_vendor_t *vendor = (const dc_event_vendor_t *) data;
+	const dc_event_stats_t *stats = (const dc_event_stats_t *) data;
+	static const char * const phases[] = {"handshake", "logbook", "profile"};
 
 	switch (event) {
 	case DC_EVENT_WAITING:
@@ -236,6 +243,16 @@ dctool_event_cb (dc_device_t *device, dc_event_type_t event, const void *data, v
 			message ("%02X", vendor->data[i]);
 		message ("\n");
 		break;
+	case DC_EVENT_STATS:
+		message ("Event: phase=%s, elapsed=%u ms, remaining=",
+			stats->phase < 3 ? phases[stats->phase] : "unknown", stats->elapsed);
+		if (stats->remaining == UINT_MAX)
+			message ("unknown");
+		else
+			message ("%u ms", stats->remaining);
+		message (", %.0f bytes/s, %.1f round trips/s, retries=%u\n",
+			stats->bytes, stats->roundtrips, stats->retries);
+		break;
 	default:
 		break;
 	}
@@ -245,61 +262,37 @@ dc_status_t
 dctool_descriptor_search (dc_descriptor_t **out, const char *name, dc_family_t family, unsigned int model)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
-
-	dc_iterator_t *iterator = NULL;
-	rc = dc_descriptor_iterator (&iterator);
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR ("Error creating the device descriptor iterator.");
-		return rc;
-	}
-
-	dc_descriptor_t *descriptor = NULL, *current = NULL;
-	while ((rc = dc_iterator_next (iterator, &descriptor)) == DC_STATUS_SUCCESS) {
-		if (name) {
-			const char *vendor = dc_descriptor_get_vendor (descriptor);
-			const char *product = dc_descriptor_get_product (descriptor);
-
-			size_t n = strlen (vendor);
-			if (strncasecmp (name, vendor, n) == 0 && name[n] == ' ' &&
-				strcasecmp (name + n + 1, product) == 0)
-			{
-				current = descriptor;
-				break;
-			} else if (strcasecmp (name, product) == 0) {
-				current = descriptor;
-				break;
-			}
-		} else {
-			if (family == dc_descriptor_get_type (descriptor)) {
-				if (model == dc_descriptor_get_model (descriptor)) {
-					// Exact match found. Return immediately.
-					dc_descriptor_free (current);
-					current = descriptor;
-					break;
-				} else {
-					// Possible match found. Keep searching for an exact match.
-					// If no exact match is found, the first match is returned.
-					if (current == NULL) {
-						current = descriptor;
-						descriptor = NULL;
-					}
-				}
+	dc_descriptor_t *descriptor = NULL;
+
+	if (name) {
+		// Try all possible splits in a vendor and product name first,
+		// because vendor names can contain spaces too.
+		char buffer[128];
+		size_t length = strlen (name);
+		if (length < sizeof (buffer)) {
+			memcpy (buffer, name, length + 1);
+			for (size_t i = 0; i < length && descriptor == NULL; ++i) {
+				if (buffer[i] != ' ')
+					continue;
+				buffer[i] = 0;
+				rc = dc_descriptor_find_name (&descriptor, buffer, buffer + i + 1);
+				buffer[i] = ' ';
 			}
 		}
 
-		dc_descriptor_free (descriptor);
+		// Fallback to the product name only.
+		if (descriptor == NULL)
+			rc = dc_descriptor_find_name (&descriptor, NULL, name);
+	} else {
+		rc = dc_descriptor_find (&descriptor, family, model);
 	}
 
-	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_DONE) {
-		dc_descriptor_free (current);
-		dc_iterator_free (iterator);
-		ERROR ("Error iterating the device descriptors.");
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_NODEVICE) {
+		ERROR ("Error searching the device descriptors.");
 		return rc;
 	}
 
-	dc_iterator_free (iterator);
-
-	*out = current;
+	*out = descriptor;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -370,6 +363,13 @@ dctool_file_read (const char *filename)
 {
 	FILE *fp = NULL;
 
+	// Map regular files into memory, to avoid copying the data.
+	if (filename) {
+		dc_buffer_t *buffer = dc_buffer_new_file (filename);
+		if (buffer)
+			return buffer;
+	}
+
 	// Open the file.
 	if (filename) {
 		fp = fopen (filename, "rb");
@@ -399,6 +399,108 @@ dctool_file_read (const char *filename)
 	return buffer;
 }
 
+static int
+dctool_range_compare (const void *a, const void *b)
+{
+	const dctool_range_t *ra = (const dctool_range_t *) a;
+	const dctool_range_t *rb = (const dctool_range_t *) b;
+
+	if (ra->address < rb->address)
+		return -1;
+	if (ra->address > rb->address)
+		return 1;
+	return 0;
+}
+
+dc_status_t
+dctool_ranges_read (const char *filename, dctool_range_t **out, unsigned int *out_count)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_range_t *ranges = NULL;
+	unsigned int count = 0, capacity = 0;
+	char line[256];
+
+	if (filename == NULL || out == NULL || out_count == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	FILE *fp = fopen (filename, "r");
+	if (fp == NULL)
+		return DC_STATUS_IO;
+
+	unsigned int lineno = 0;
+	while (fgets (line, sizeof (line), fp)) {
+		lineno++;
+
+		// Skip empty lines and comments.
+		char *p = line;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#')
+			continue;
+
+		char *end = NULL;
+		unsigned long address = strtoul (p, &end, 0);
+		if (end == p) {
+			message ("Invalid memory range on line %u.\n", lineno);
+			status = DC_STATUS_DATAFORMAT;
+			goto error;
+		}
+
+		p = end;
+		unsigned long nbytes = strtoul (p, &end, 0);
+		if (end == p || nbytes == 0 || address + nbytes < address || address + nbytes > 0xFFFFFFFFUL) {
+			message ("Invalid memory range on line %u.\n", lineno);
+			status = DC_STATUS_DATAFORMAT;
+			goto error;
+		}
+
+		if (count == capacity) {
+			unsigned int n = capacity ? capacity * 2 : 16;
+			dctool_range_t *tmp = (dctool_range_t *) realloc (ranges, n * sizeof (dctool_range_t));
+			if (tmp == NULL) {
+				status = DC_STATUS_NOMEMORY;
+				goto error;
+			}
+			ranges = tmp;
+			capacity = n;
+		}
+
+		ranges[count].address = address;
+		ranges[count].count = nbytes;
+		count++;
+	}
+
+	// Merge the overlapping and adjacent ranges.
+	if (count) {
+		qsort (ranges, count, sizeof (dctool_range_t), dctool_range_compare);
+
+		unsigned int n = 0;
+		for (unsigned int i = 1; i < count; ++i) {
+			unsigned long end = (unsigned long) ranges[n].address + ranges[n].count;
+			if (ranges[i].address <= end) {
+				unsigned long next = (unsigned long) ranges[i].address + ranges[i].count;
+				if (next > end)
+					ranges[n].count = next - ranges[n].address;
+			} else {
+				ranges[++n] = ranges[i];
+			}
+		}
+		count = n + 1;
+	}
+
+	fclose (fp);
+
+	*out = ranges;
+	*out_count = count;
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	fclose (fp);
+	free (ranges);
+	return status;
+}
+
 static dc_status_t
 dctool_usb_open (dc_iostream_t **out, dc_context_t *context, dc_descriptor_t *descriptor)
 {
@@ -579,3 +681,149 @@ dctool_iostream_open (dc_iostream_t **iostream, dc_context_t *context, dc_descri
 		return DC_STATUS_UNSUPPORTED;
 	}
 }
+
+void
+dctool_device_address (dc_transport_t transport, void *device, char *buffer, size_t size)
+{
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		snprintf (buffer, size, "%s", dc_serial_device_get_name (device));
+		break;
+	case DC_TRANSPORT_USB:
+		snprintf (buffer, size, "%04x:%04x", dc_usb_device_get_vid (device), dc_usb_device_get_pid (device));
+		break;
+	case DC_TRANSPORT_USBHID:
+		snprintf (buffer, size, "%04x:%04x", dc_usbhid_device_get_vid (device), dc_usbhid_device_get_pid (device));
+		break;
+	case DC_TRANSPORT_IRDA:
+		snprintf (buffer, size, "%08x", dc_irda_device_get_address (device));
+		break;
+	case DC_TRANSPORT_BLUETOOTH:
+		dc_bluetooth_addr2str (dc_bluetooth_device_get_address (device), buffer, size);
+		break;
+	default:
+		snprintf (buffer, size, "unknown");
+		break;
+	}
+}
+
+void
+dctool_device_free (dc_transport_t transport, void *device)
+{
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		dc_serial_device_free (device);
+		break;
+	case DC_TRANSPORT_USB:
+		dc_usb_device_free (device);
+		break;
+	case DC_TRANSPORT_USBHID:
+		dc_usbhid_device_free (device);
+		break;
+	case DC_TRANSPORT_IRDA:
+		dc_irda_device_free (device);
+		break;
+	case DC_TRANSPORT_BLUETOOTH:
+		dc_bluetooth_device_free (device);
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+dctool_device_open (dc_iostream_t **iostream, dc_context_t *context, dc_transport_t transport, void *device)
+{
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		return dc_serial_open (iostream, context, dc_serial_device_get_name (device));
+	case DC_TRANSPORT_USB:
+		return dc_usb_open (iostream, context, device);
+	case DC_TRANSPORT_USBHID:
+		return dc_usbhid_open (iostream, context, device);
+	case DC_TRANSPORT_IRDA:
+		return dc_irda_open (iostream, context, dc_irda_device_get_address (device), 1);
+	case DC_TRANSPORT_BLUETOOTH:
+		return dc_bluetooth_open (iostream, context, dc_bluetooth_device_get_address (device), 0);
+	default:
+		return DC_STATUS_UNSUPPORTED;
+	}
+}
+
+int
+dctool_manifest_line (char *line, char **filename, unsigned int *devtime, dc_ticks_t *systime, char **device)
+{
+	char *p = line;
+
+	while (isspace ((unsigned char) *p))
+		p++;
+	if (*p == 0 || *p == '#')
+		return 0;
+
+	*filename = p;
+	while (*p && !isspace ((unsigned char) *p))
+		p++;
+	if (*p)
+		*p++ = 0;
+
+	char *end = NULL;
+	unsigned long value = strtoul (p, &end, 0);
+	if (end != p) {
+		*devtime = value;
+		p = end;
+		long long ticks = strtoll (p, &end, 0);
+		if (end != p) {
+			*systime = ticks;
+			p = end;
+		}
+	}
+
+	while (isspace ((unsigned char) *p))
+		p++;
+
+	// Strip the trailing whitespace of the device name.
+	size_t length = strlen (p);
+	while (length && isspace ((unsigned char) p[length - 1]))
+		p[--length] = 0;
+
+	*device = length ? p : NULL;
+
+	return 1;
+}
+
+double
+dctool_time (void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceFrequency (&frequency);
+	QueryPerformanceCounter (&now);
+	return (double) now.QuadPart / frequency.QuadPart;
+#elif defined (HAVE_CLOCK_GETTIME) && defined (CLOCK_MONOTONIC)
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+#else
+	struct timeval now;
+	gettimeofday (&now, NULL);
+	return now.tv_sec + now.tv_usec / 1000000.0;
+#endif
+}
+
+unsigned long long
+dctool_peak_rss (void)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	// Reported in bytes instead of kilobytes.
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
@@ -31,6 +31,12 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#ifdef _WIN32
+#define DC_TICKS_FORMAT "%I64d"
+#else
+#define DC_TICKS_FORMAT "%lld"
+#endif
+
 const char *
 dctool_errmsg (dc_status_t status);
 
@@ -67,9 +73,49 @@ dctool_file_write (const char *filename, dc_buffer_t *buffer);
 dc_buffer_t *
 dctool_file_read (const char *filename);
 
+typedef struct dctool_range_t {
+	unsigned int address;
+	unsigned int count;
+} dctool_range_t;
+
+/*
+ * Read a list of memory ranges, with an address and a number of bytes
+ * per line. The ranges are sorted, and the overlapping and adjacent
+ * ranges are merged, such that every byte is transferred only once.
+ */
+dc_status_t
+dctool_ranges_read (const char *filename, dctool_range_t **ranges, unsigned int *count);
+
 dc_status_t
 dctool_iostream_open (dc_iostream_t **iostream, dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname);
 
+/*
+ * Helpers for the device objects of the iterators and the discovery,
+ * which have the type of the transport.
+ */
+void
+dctool_device_address (dc_transport_t transport, void *device, char *buffer, size_t size);
+
+void
+dctool_device_free (dc_transport_t transport, void *device);
+
+dc_status_t
+dctool_device_open (dc_iostream_t **iostream, dc_context_t *context, dc_transport_t transport, void *device);
+
+/*
+ * Split a manifest line in the filename, the optional device and system
+ * time, and the optional device name (which can contain spaces). Returns
+ * zero for empty lines and comments.
+ */
+int
+dctool_manifest_line (char *line, char **filename, unsigned int *devtime, dc_ticks_t *systime, char **device);
+
+double
+dctool_time (void);
+
+unsigned long long
+dctool_peak_rss (void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
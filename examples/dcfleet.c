@@ -0,0 +1,793 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/device.h>
+#include <libdivecomputer/discovery.h>
+#include <libdivecomputer/usb.h>
+
+#include "common.h"
+#include "utils.h"
+
+/*
+ * A long-running download daemon for a fleet of dive computers.
+ *
+ * The transports are scanned periodically with the device discovery,
+ * and every identified dive computer is downloaded once per visit, with
+ * the fingerprints kept in a fingerprint store. The downloads run in
+ * the worker threads of a session, and the dives are handed over as raw
+ * files in a spool directory. A USB hotplug event triggers a rescan
+ * immediately, instead of waiting for the next interval.
+ *
+ * A device is identified by its transport and address (the name of a
+ * serial port, the address of an irda or bluetooth device, or the USB
+ * vendor and product id). Until it disappears from the scans, it isn't
+ * downloaded again.
+ */
+
+// The number of failed downloads before a device is skipped.
+#define MAXFAILURES 3
+
+typedef enum fleet_state_t {
+	FLEET_IDLE,
+	FLEET_BUSY,
+	FLEET_DONE
+} fleet_state_t;
+
+typedef struct fleet_t fleet_t;
+
+typedef struct fleet_device_t {
+	struct fleet_device_t *next;
+	fleet_t *fleet;
+	dc_transport_t transport;
+	char address[64];
+	fleet_state_t state;
+	unsigned int generation;
+	unsigned int nfailures;
+	/* Owned by the worker thread while the device is busy. */
+	dc_device_t *device;
+	dc_iostream_t *iostream;
+	dc_event_devinfo_t devinfo;
+	unsigned int ndives;
+	unsigned long long nbytes;
+} fleet_device_t;
+
+typedef struct fleet_metrics_t {
+	unsigned long long nscans;
+	unsigned long long nsuccess;
+	unsigned long long nerrors;
+	unsigned long long ndives;
+	unsigned long long nbytes;
+} fleet_metrics_t;
+
+struct fleet_t {
+	dc_context_t *context;
+	dc_descriptor_t *descriptor;
+	unsigned int transports;
+	dc_session_t *session;
+	dc_fingerprint_store_t *store;
+	const char *spooldir;
+	const char *metrics;
+	unsigned int limit;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/* Protected by the mutex. */
+	fleet_device_t *devices;
+	unsigned int generation;
+	unsigned int nactive;
+	unsigned int nsession;
+	int rescan;
+	int quit;
+	fleet_metrics_t stats;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void
+sighandler (int signum)
+{
+	// Restore the default signal handler.
+	signal (signum, SIG_DFL);
+
+	g_stop = 1;
+}
+
+static int
+cancel_cb (void *userdata)
+{
+	return g_stop;
+}
+
+static void
+logfunc (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *msg, void *userdata)
+{
+	const char *loglevels[] = {"NONE", "ERROR", "WARNING", "INFO", "DEBUG", "ALL"};
+
+	if (loglevel == DC_LOGLEVEL_ERROR || loglevel == DC_LOGLEVEL_WARNING) {
+		message ("%s: %s [in %s:%d (%s)]\n", loglevels[loglevel], msg, file, line, function);
+	} else {
+		message ("%s: %s\n", loglevels[loglevel], msg);
+	}
+}
+
+/*
+ * Write a file to a temporary name first, and rename it afterwards, such
+ * that the consumers of the spool directory never see partial files.
+ */
+static int
+fleet_spool_write (const char *filename, const unsigned char data[], unsigned int size)
+{
+	char tmpname[1024];
+
+	int n = snprintf (tmpname, sizeof (tmpname), "%s.tmp", filename);
+	if (n < 0 || (size_t) n >= sizeof (tmpname))
+		return -1;
+
+	FILE *fp = fopen (tmpname, "wb");
+	if (fp == NULL)
+		return -1;
+
+	size_t nbytes = fwrite (data, 1, size, fp);
+	if (fclose (fp) != 0 || nbytes != size || rename (tmpname, filename) != 0) {
+		remove (tmpname);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+fleet_metrics_write (fleet_t *fleet)
+{
+	char buffer[1024];
+	fleet_metrics_t stats;
+	unsigned int ndevices = 0, nactive = 0;
+
+	if (fleet->metrics == NULL)
+		return;
+
+	pthread_mutex_lock (&fleet->mutex);
+	stats = fleet->stats;
+	nactive = fleet->nactive;
+	for (fleet_device_t *current = fleet->devices; current; current = current->next)
+		ndevices++;
+	pthread_mutex_unlock (&fleet->mutex);
+
+	// Prometheus text format, for the textfile collector.
+	int n = snprintf (buffer, sizeof (buffer),
+		"dcfleet_scans_total %llu\n"
+		"dcfleet_devices %u\n"
+		"dcfleet_downloads_active %u\n"
+		"dcfleet_downloads_total{status=\"success\"} %llu\n"
+		"dcfleet_downloads_total{status=\"error\"} %llu\n"
+		"dcfleet_dives_total %llu\n"
+		"dcfleet_bytes_total %llu\n",
+		stats.nscans, ndevices, nactive,
+		stats.nsuccess, stats.nerrors,
+		stats.ndives, stats.nbytes);
+	if (n < 0 || (size_t) n >= sizeof (buffer))
+		return;
+
+	if (fleet_spool_write (fleet->metrics, (const unsigned char *) buffer, n) != 0) {
+		WARNING ("Failed to write the metrics.");
+	}
+}
+
+static void
+event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata)
+{
+	fleet_device_t *entry = (fleet_device_t *) userdata;
+
+	if (event == DC_EVENT_DEVINFO) {
+		entry->devinfo = *(const dc_event_devinfo_t *) data;
+	}
+}
+
+static int
+dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	fleet_device_t *entry = (fleet_device_t *) userdata;
+	fleet_t *fleet = entry->fleet;
+	const char *family = dctool_family_name (dc_device_get_type (entry->device));
+	char filename[1024];
+
+	// The filename is unique for every dive, and doesn't depend on the
+	// order of the download.
+	int n = snprintf (filename, sizeof (filename), "%s/%s-%08X-",
+		fleet->spooldir, family ? family : "unknown", entry->devinfo.serial);
+	for (unsigned int i = 0; i < fsize && n > 0 && (size_t) n + 3 < sizeof (filename); ++i)
+		n += snprintf (filename + n, sizeof (filename) - n, "%02X", fingerprint[i]);
+	if (n < 0 || (size_t) n + 5 >= sizeof (filename)) {
+		ERROR ("Failed to generate the filename.");
+		return 0;
+	}
+	strcpy (filename + n, ".bin");
+
+	if (fleet_spool_write (filename, data, size) != 0) {
+		ERROR ("Failed to write the dive.");
+		return 0;
+	}
+
+	entry->ndives++;
+	entry->nbytes += size;
+
+	return !g_stop;
+}
+
+static void
+done_cb (dc_device_t *device, dc_status_t status, void *userdata)
+{
+	fleet_device_t *entry = (fleet_device_t *) userdata;
+	fleet_t *fleet = entry->fleet;
+
+	message ("%s %s: %s, %u dives, %llu bytes\n",
+		dctool_transport_name (entry->transport), entry->address,
+		dctool_errmsg (status), entry->ndives, entry->nbytes);
+
+	dc_device_close (entry->device);
+	dc_iostream_close (entry->iostream);
+	entry->device = NULL;
+	entry->iostream = NULL;
+
+	pthread_mutex_lock (&fleet->mutex);
+	if (status == DC_STATUS_SUCCESS) {
+		fleet->stats.nsuccess++;
+		entry->state = FLEET_DONE;
+	} else {
+		fleet->stats.nerrors++;
+		entry->nfailures++;
+		entry->state = entry->nfailures < MAXFAILURES ? FLEET_IDLE : FLEET_DONE;
+	}
+	fleet->stats.ndives += entry->ndives;
+	fleet->stats.nbytes += entry->nbytes;
+	fleet->nactive--;
+	fleet->nsession--;
+	pthread_mutex_unlock (&fleet->mutex);
+
+	fleet_metrics_write (fleet);
+}
+
+/*
+ * Open the device and hand it over to the session. The device object of
+ * the transport is only needed to open the connection.
+ */
+static dc_status_t
+fleet_start (fleet_t *fleet, fleet_device_t *entry, void *device, dc_descriptor_t *descriptor)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	message ("%s %s: downloading (%s %s).\n",
+		dctool_transport_name (entry->transport), entry->address,
+		dc_descriptor_get_vendor (descriptor),
+		dc_descriptor_get_product (descriptor));
+
+	entry->ndives = 0;
+	entry->nbytes = 0;
+	memset (&entry->devinfo, 0, sizeof (entry->devinfo));
+
+	status = dctool_device_open (&entry->iostream, fleet->context, entry->transport, device);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the I/O stream.");
+		goto error;
+	}
+
+	status = dc_device_open (&entry->device, fleet->context, descriptor, entry->iostream);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the device.");
+		goto error;
+	}
+
+	dc_device_set_events (entry->device, DC_EVENT_DEVINFO, event_cb, entry);
+	dc_device_set_cancel (entry->device, cancel_cb, NULL);
+	dc_device_set_fingerprint_store (entry->device, fleet->store);
+
+	// Count the download before it is added, because the done callback
+	// can run before dc_session_add returns.
+	pthread_mutex_lock (&fleet->mutex);
+	fleet->nsession++;
+	pthread_mutex_unlock (&fleet->mutex);
+
+	status = dc_session_add (fleet->session, entry->device, dive_cb, done_cb, entry);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error adding the device to the session.");
+		pthread_mutex_lock (&fleet->mutex);
+		fleet->nsession--;
+		pthread_mutex_unlock (&fleet->mutex);
+		goto error;
+	}
+
+	// Wake up the collector.
+	pthread_mutex_lock (&fleet->mutex);
+	pthread_cond_broadcast (&fleet->cond);
+	pthread_mutex_unlock (&fleet->mutex);
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	dc_device_close (entry->device);
+	dc_iostream_close (entry->iostream);
+	entry->device = NULL;
+	entry->iostream = NULL;
+	return status;
+}
+
+static void
+discovery_cb (dc_transport_t transport, void *device, dc_descriptor_t *descriptor, void *userdata)
+{
+	fleet_t *fleet = (fleet_t *) userdata;
+	fleet_device_t *entry = NULL;
+	char address[64];
+
+	// Serial ports can only be identified with a descriptor.
+	if (descriptor == NULL)
+		goto cleanup;
+
+	dctool_device_address (transport, device, address, sizeof (address));
+
+	pthread_mutex_lock (&fleet->mutex);
+
+	for (entry = fleet->devices; entry; entry = entry->next) {
+		if (entry->transport == transport && strcmp (entry->address, address) == 0)
+			break;
+	}
+
+	if (entry == NULL) {
+		entry = (fleet_device_t *) malloc (sizeof (fleet_device_t));
+		if (entry == NULL) {
+			pthread_mutex_unlock (&fleet->mutex);
+			ERROR ("Failed to allocate memory.");
+			goto cleanup;
+		}
+
+		memset (entry, 0, sizeof (fleet_device_t));
+		entry->fleet = fleet;
+		entry->transport = transport;
+		entry->state = FLEET_IDLE;
+		strcpy (entry->address, address);
+		entry->next = fleet->devices;
+		fleet->devices = entry;
+	}
+
+	entry->generation = fleet->generation;
+
+	// Leave the device for a later scan, when all workers are busy.
+	int start = entry->state == FLEET_IDLE && fleet->nactive < fleet->limit && !g_stop;
+	if (start) {
+		entry->state = FLEET_BUSY;
+		fleet->nactive++;
+	}
+
+	pthread_mutex_unlock (&fleet->mutex);
+
+	if (start && fleet_start (fleet, entry, device, descriptor) != DC_STATUS_SUCCESS) {
+		pthread_mutex_lock (&fleet->mutex);
+		fleet->stats.nerrors++;
+		entry->nfailures++;
+		entry->state = entry->nfailures < MAXFAILURES ? FLEET_IDLE : FLEET_DONE;
+		fleet->nactive--;
+		pthread_mutex_unlock (&fleet->mutex);
+	}
+
+cleanup:
+	dctool_device_free (transport, device);
+	dc_descriptor_free (descriptor);
+}
+
+static void
+hotplug_cb (dc_usb_hotplug_event_t event, dc_usb_device_t *device, void *userdata)
+{
+	fleet_t *fleet = (fleet_t *) userdata;
+
+	dc_usb_device_free (device);
+
+	pthread_mutex_lock (&fleet->mutex);
+	fleet->rescan = 1;
+	pthread_cond_broadcast (&fleet->cond);
+	pthread_mutex_unlock (&fleet->mutex);
+}
+
+/*
+ * Forget the devices which were not found by the last scan. They are
+ * downloaded again when they return.
+ */
+static void
+fleet_prune (fleet_t *fleet)
+{
+	pthread_mutex_lock (&fleet->mutex);
+
+	fleet_device_t **link = &fleet->devices;
+	while (*link) {
+		fleet_device_t *entry = *link;
+		if (entry->state != FLEET_BUSY && entry->generation != fleet->generation) {
+			message ("%s %s: gone.\n", dctool_transport_name (entry->transport), entry->address);
+			*link = entry->next;
+			free (entry);
+		} else {
+			link = &entry->next;
+		}
+	}
+
+	pthread_mutex_unlock (&fleet->mutex);
+}
+
+static dc_status_t
+fleet_scan (fleet_t *fleet)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_discovery_t *discovery = NULL;
+
+	pthread_mutex_lock (&fleet->mutex);
+	fleet->generation++;
+	fleet->rescan = 0;
+	fleet->stats.nscans++;
+	pthread_mutex_unlock (&fleet->mutex);
+
+	status = dc_discovery_new (&discovery, fleet->context, fleet->descriptor, fleet->transports, discovery_cb, fleet);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to start the device discovery.");
+		return status;
+	}
+
+	status = dc_discovery_wait (discovery);
+	dc_discovery_free (discovery);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to discover the devices.");
+		return status;
+	}
+
+	fleet_prune (fleet);
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The done callbacks of the session are invoked from dc_session_wait,
+ * which returns as soon as there are no more downloads. The collector
+ * waits for new downloads in between.
+ */
+static void *
+fleet_collector (void *userdata)
+{
+	fleet_t *fleet = (fleet_t *) userdata;
+
+	pthread_mutex_lock (&fleet->mutex);
+	while (1) {
+		while (!fleet->quit && fleet->nsession == 0)
+			pthread_cond_wait (&fleet->cond, &fleet->mutex);
+
+		if (fleet->nsession == 0)
+			break;
+
+		pthread_mutex_unlock (&fleet->mutex);
+		dc_session_wait (fleet->session);
+		pthread_mutex_lock (&fleet->mutex);
+	}
+	pthread_mutex_unlock (&fleet->mutex);
+
+	return NULL;
+}
+
+/*
+ * Wait for the next scan, until the interval has elapsed, a hotplug event
+ * arrives or the daemon is stopped. The signal handler can't wake up the
+ * condition variable, so the stop flag is checked every second.
+ */
+static void
+fleet_sleep (fleet_t *fleet, unsigned int interval)
+{
+	pthread_mutex_lock (&fleet->mutex);
+
+	for (unsigned int i = 0; i < interval && !fleet->rescan && !g_stop; ++i) {
+		struct timeval now;
+		gettimeofday (&now, NULL);
+
+		struct timespec timeout;
+		timeout.tv_sec = now.tv_sec + 1;
+		timeout.tv_nsec = now.tv_usec * 1000;
+
+		while (!fleet->rescan && !g_stop) {
+			if (pthread_cond_timedwait (&fleet->cond, &fleet->mutex, &timeout) == ETIMEDOUT)
+				break;
+		}
+	}
+
+	pthread_mutex_unlock (&fleet->mutex);
+}
+
+static int
+fleet_run (fleet_t *fleet, unsigned int nthreads, unsigned int interval, unsigned int once)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usb_hotplug_t *hotplug = NULL;
+	pthread_t collector;
+
+	status = dc_session_new (&fleet->session, fleet->context, nthreads);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("Failed to create the session.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (pthread_create (&collector, NULL, fleet_collector, fleet) != 0) {
+		message ("Failed to create the collector thread.\n");
+		dc_session_free (fleet->session);
+		return EXIT_FAILURE;
+	}
+
+	// Hotplug notifications are optional, the scans find the USB devices
+	// anyway.
+	if (!once && (fleet->transports & (DC_TRANSPORT_USB | DC_TRANSPORT_USBHID))) {
+		if (dc_usb_hotplug_new (&hotplug, fleet->context, NULL, hotplug_cb, fleet) != DC_STATUS_SUCCESS)
+			hotplug = NULL;
+	}
+
+	while (!g_stop) {
+		status = fleet_scan (fleet);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+			break;
+		}
+
+		fleet_metrics_write (fleet);
+
+		if (once)
+			break;
+
+		fleet_sleep (fleet, interval);
+	}
+
+	dc_usb_hotplug_free (hotplug);
+
+	// Finish the downloads in progress, unless the daemon is stopped.
+	pthread_mutex_lock (&fleet->mutex);
+	fleet->quit = 1;
+	pthread_cond_broadcast (&fleet->cond);
+	pthread_mutex_unlock (&fleet->mutex);
+	pthread_join (collector, NULL);
+
+	dc_session_free (fleet->session);
+	fleet->session = NULL;
+
+	fleet_metrics_write (fleet);
+
+	return exitcode;
+}
+
+static void
+usage (void)
+{
+	printf (
+		"A download daemon for a fleet of dive computers\n"
+		"\n"
+		"Usage:\n"
+		"   dcfleet [options] <directory>\n"
+		"\n"
+		"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+		"   -h, --help                 Show help message\n"
+		"   -d, --device <device>      Device name\n"
+		"   -t, --transport <name>     Transport type (can be repeated)\n"
+		"   -c, --cache <filename>     Fingerprint store\n"
+		"   -j, --jobs <count>         Number of concurrent downloads\n"
+		"   -q, --queue <count>        Number of queued downloads\n"
+		"   -i, --interval <seconds>   Time between two scans\n"
+		"   -m, --metrics <filename>   Metrics file\n"
+		"   -1, --once                 Scan only once\n"
+		"   -l, --logfile <logfile>    Logfile\n"
+		"   -v, --verbose              Verbose mode\n"
+#else
+		"   -h              Show help message\n"
+		"   -d <device>     Device name\n"
+		"   -t <name>       Transport type (can be repeated)\n"
+		"   -c <filename>   Fingerprint store\n"
+		"   -j <count>      Number of concurrent downloads\n"
+		"   -q <count>      Number of queued downloads\n"
+		"   -i <seconds>    Time between two scans\n"
+		"   -m <filename>   Metrics file\n"
+		"   -1              Scan only once\n"
+		"   -l <logfile>    Logfile\n"
+		"   -v              Verbose mode\n"
+#endif
+		"\n"
+		"The dives are written to the directory as raw (binary) files, named\n"
+		"after the family, the serial number and the fingerprint of the dive.\n"
+		"The files appear atomically, once they are complete. Without a\n"
+		"device name, all dive computers which can be identified are\n"
+		"downloaded. Serial ports can't be identified, and are only scanned\n"
+		"with a device name.\n"
+		"\n"
+		"The fingerprint store defaults to the .fingerprints file in the\n"
+		"directory. The metrics are written in the Prometheus text format.\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	fleet_t fleet;
+	char storename[1024];
+
+	// Default option values.
+	unsigned int help = 0;
+	dc_loglevel_t loglevel = DC_LOGLEVEL_WARNING;
+	const char *logfile = NULL;
+	const char *device = NULL;
+	const char *cache = NULL;
+	const char *metrics = NULL;
+	unsigned int transports = 0;
+	unsigned int nthreads = 4;
+	unsigned int nqueue = 0;
+	unsigned int interval = 30;
+	unsigned int once = 0;
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "hd:t:c:j:q:i:m:1l:v";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"device",      required_argument, 0, 'd'},
+		{"transport",   required_argument, 0, 't'},
+		{"cache",       required_argument, 0, 'c'},
+		{"jobs",        required_argument, 0, 'j'},
+		{"queue",       required_argument, 0, 'q'},
+		{"interval",    required_argument, 0, 'i'},
+		{"metrics",     required_argument, 0, 'm'},
+		{"once",        no_argument,       0, '1'},
+		{"logfile",     required_argument, 0, 'l'},
+		{"verbose",     no_argument,       0, 'v'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 'd':
+			device = optarg;
+			break;
+		case 't':
+			transports |= dctool_transport_type (optarg);
+			break;
+		case 'c':
+			cache = optarg;
+			break;
+		case 'j':
+			nthreads = strtoul (optarg, NULL, 0);
+			break;
+		case 'q':
+			nqueue = strtoul (optarg, NULL, 0);
+			break;
+		case 'i':
+			interval = strtoul (optarg, NULL, 0);
+			break;
+		case 'm':
+			metrics = optarg;
+			break;
+		case '1':
+			once = 1;
+			break;
+		case 'l':
+			logfile = optarg;
+			break;
+		case 'v':
+			loglevel++;
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (help || argc < 1) {
+		usage ();
+		return help ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	memset (&fleet, 0, sizeof (fleet));
+	fleet.spooldir = argv[0];
+	fleet.metrics = metrics;
+	fleet.limit = (nthreads ? nthreads : 1) + nqueue;
+	pthread_mutex_init (&fleet.mutex, NULL);
+	pthread_cond_init (&fleet.cond, NULL);
+
+	// Setup the signal handlers.
+	signal (SIGINT, sighandler);
+	signal (SIGTERM, sighandler);
+
+	// Initialize the logfile.
+	message_set_logfile (logfile);
+
+	// Initialize a library context.
+	status = dc_context_new (&fleet.context);
+	if (status != DC_STATUS_SUCCESS) {
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Setup the logging.
+	dc_context_set_loglevel (fleet.context, loglevel);
+	dc_context_set_logfunc (fleet.context, logfunc, NULL);
+
+	if (device) {
+		status = dctool_descriptor_search (&fleet.descriptor, device, DC_FAMILY_NULL, 0);
+		if (status != DC_STATUS_SUCCESS || fleet.descriptor == NULL) {
+			message ("No supported device found: %s\n", device);
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	fleet.transports = transports ? transports : dc_context_get_transports (fleet.context);
+
+	// Open the fingerprint store.
+	if (cache == NULL) {
+		snprintf (storename, sizeof (storename), "%s/.fingerprints", fleet.spooldir);
+		cache = storename;
+	}
+	status = dc_fingerprint_store_new (&fleet.store, fleet.context, cache);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("Failed to open the fingerprint store.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	exitcode = fleet_run (&fleet, nthreads, interval, once);
+
+cleanup:
+	while (fleet.devices) {
+		fleet_device_t *next = fleet.devices->next;
+		free (fleet.devices);
+		fleet.devices = next;
+	}
+	dc_fingerprint_store_free (fleet.store);
+	dc_descriptor_free (fleet.descriptor);
+	dc_context_free (fleet.context);
+	pthread_cond_destroy (&fleet.cond);
+	pthread_mutex_destroy (&fleet.mutex);
+	message_set_logfile (NULL);
+	return exitcode;
+}
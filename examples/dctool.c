@@ -60,12 +60,16 @@ static const dctool_command_t *g_commands[] = {
 	&dctool_list,
 	&dctool_scan,
 	&dctool_download,
+	&dctool_bench,
 	&dctool_dump,
 	&dctool_parse,
+	&dctool_parsebench,
+	&dctool_index,
 	&dctool_read,
 	&dctool_write,
 	&dctool_timesync,
 	&dctool_fwupdate,
+	&dctool_simulate,
 	NULL
 };
 
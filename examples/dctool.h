@@ -47,12 +47,16 @@ extern const dctool_command_t dctool_version;
 extern const dctool_command_t dctool_list;
 extern const dctool_command_t dctool_scan;
 extern const dctool_command_t dctool_download;
+extern const dctool_command_t dctool_bench;
 extern const dctool_command_t dctool_dump;
 extern const dctool_command_t dctool_parse;
+extern const dctool_command_t dctool_parsebench;
+extern const dctool_command_t dctool_index;
 extern const dctool_command_t dctool_read;
 extern const dctool_command_t dctool_write;
 extern const dctool_command_t dctool_timesync;
 extern const dctool_command_t dctool_fwupdate;
+extern const dctool_command_t dctool_simulate;
 
 const dctool_command_t *
 dctool_command_find (const char *name);
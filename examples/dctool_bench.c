@@ -0,0 +1,502 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/device.h>
+#include <libdivecomputer/parser.h>
+#include <libdivecomputer/serial.h>
+
+#include "dctool.h"
+#include "common.h"
+#include "simulator.h"
+#include "ptyloop.h"
+#include "wiretrace.h"
+#include "utils.h"
+
+typedef struct bench_t {
+	dc_device_t *device;
+	unsigned int parse;
+	double start;
+	// Download.
+	double first;
+	unsigned int ndives;
+	unsigned long long nbytes;
+	// Parsing.
+	unsigned int nparsed;
+	unsigned int nerrors;
+	unsigned long long nsamples;
+	double total, min, max;
+} bench_t;
+
+static void
+bench_sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	unsigned long long *nsamples = (unsigned long long *) userdata;
+
+	if (type == DC_SAMPLE_TIME)
+		(*nsamples)++;
+}
+
+static int
+bench_dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	bench_t *bench = (bench_t *) userdata;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+
+	if (bench->ndives == 0)
+		bench->first = dctool_time () - bench->start;
+
+	bench->ndives++;
+	bench->nbytes += size;
+
+	if (!bench->parse)
+		return 1;
+
+	double begin = dctool_time ();
+
+	rc = dc_parser_new (&parser, bench->device);
+	if (rc == DC_STATUS_SUCCESS)
+		rc = dc_parser_set_data (parser, data, size);
+	if (rc == DC_STATUS_SUCCESS) {
+		dc_datetime_t datetime = {0};
+		unsigned int divetime = 0;
+		double maxdepth = 0.0;
+		dc_parser_get_datetime (parser, &datetime);
+		dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &divetime);
+		dc_parser_get_field (parser, DC_FIELD_MAXDEPTH, 0, &maxdepth);
+		rc = dc_parser_samples_foreach (parser, bench_sample_cb, &bench->nsamples);
+	}
+	dc_parser_destroy (parser);
+
+	double elapsed = dctool_time () - begin;
+
+	if (rc != DC_STATUS_SUCCESS)
+		bench->nerrors++;
+
+	if (bench->nparsed == 0 || elapsed < bench->min)
+		bench->min = elapsed;
+	if (bench->nparsed == 0 || elapsed > bench->max)
+		bench->max = elapsed;
+	bench->total += elapsed;
+	bench->nparsed++;
+
+	return 1;
+}
+
+static void
+bench_string (FILE *fp, const char *str)
+{
+	fputc ('"', fp);
+	for (const char *p = str; p && *p; ++p) {
+		if (*p == '"' || *p == '\\')
+			fputc ('\\', fp);
+		fputc (*p, fp);
+	}
+	fputc ('"', fp);
+}
+
+/*
+ * The median of a latency histogram, as the lower bound of the bucket.
+ */
+static unsigned int
+bench_median (const unsigned int histogram[])
+{
+	unsigned long long total = 0, count = 0;
+
+	for (unsigned int i = 0; i < DC_IOSTREAM_HISTOGRAM_SIZE; ++i)
+		total += histogram[i];
+
+	for (unsigned int i = 0; i < DC_IOSTREAM_HISTOGRAM_SIZE; ++i) {
+		count += histogram[i];
+		if (total && count * 2 >= total)
+			return i ? 1u << i : 0;
+	}
+
+	return 0;
+}
+
+static dc_status_t
+bench (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, dctool_simulator_t *simulator, dctool_replay_t *replay, unsigned int pty, unsigned int parse, FILE *fp)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dctool_ptyloop_t *ptyloop = NULL;
+	dc_iostream_t *iostream = NULL;
+	dc_device_t *device = NULL;
+
+	bench_t bench = {0};
+	bench.parse = parse;
+	bench.start = dctool_time ();
+
+	unsigned long long syscalls = dctool_ptyloop_syscalls ();
+
+	// Open the I/O stream.
+	if (simulator && pty) {
+		transport = DC_TRANSPORT_SERIAL;
+		rc = dctool_ptyloop_new (&ptyloop, context, simulator);
+		if (rc == DC_STATUS_SUCCESS)
+			rc = dc_serial_open (&iostream, context, dctool_ptyloop_get_name (ptyloop));
+	} else if (simulator) {
+		transport = DC_TRANSPORT_SERIAL;
+		rc = dctool_simulator_open (&iostream, context, simulator);
+	} else if (replay) {
+		transport = dctool_replay_get_transport (replay);
+		rc = dctool_replay_open (&iostream, context, replay);
+	} else {
+		rc = dctool_iostream_open (&iostream, context, descriptor, transport, devname);
+	}
+	if (rc != DC_STATUS_SUCCESS) {
+		if (rc == DC_STATUS_UNSUPPORTED && pty)
+			message ("No pty support available (configure with --enable-pty).\n");
+		ERROR ("Error opening the I/O stream.");
+		goto cleanup;
+	}
+
+	// Open the device.
+	rc = dc_device_open (&device, context, descriptor, iostream);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the device.");
+		goto cleanup;
+	}
+
+	// Register the cancellation handler.
+	rc = dc_device_set_cancel (device, dctool_cancel_cb, NULL);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error registering the cancellation handler.");
+		goto cleanup;
+	}
+
+	// Download and parse the dives.
+	bench.device = device;
+	rc = dc_device_foreach (device, bench_dive_cb, &bench);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error downloading the dives.");
+	}
+
+	double elapsed = dctool_time () - bench.start;
+
+	dc_iostream_stats_t iostats;
+	dc_iostream_get_stats (iostream, &iostats);
+
+	// The system calls of the simulator side of the pty are excluded.
+	dctool_ptyloop_stats_t ptystats = {0};
+	if (ptyloop) {
+		dctool_ptyloop_get_stats (ptyloop, &ptystats);
+		syscalls = dctool_ptyloop_syscalls () - syscalls - ptystats.syscalls;
+	}
+
+	// With the simulator, the transfer rate is based on the
+	// simulated time on the link, instead of the real time, except
+	// behind a pty. A replay uses the recorded time of the replayed
+	// calls.
+	double linktime = elapsed - bench.total;
+	dctool_simulator_stats_t simstats = {0};
+	dctool_replay_stats_t replaystats = {0};
+	if (simulator) {
+		dctool_simulator_get_stats (simulator, &simstats);
+		if (!ptyloop)
+			linktime = simstats.clock / 1000000.0;
+	} else if (replay) {
+		dctool_replay_get_stats (replay, &replaystats);
+		linktime = replaystats.clock / 1000000.0;
+	}
+
+	fprintf (fp, "{\n");
+	fprintf (fp, "  \"vendor\": ");
+	bench_string (fp, dc_descriptor_get_vendor (descriptor));
+	fprintf (fp, ",\n  \"product\": ");
+	bench_string (fp, dc_descriptor_get_product (descriptor));
+	fprintf (fp, ",\n  \"transport\": ");
+	bench_string (fp, ptyloop ? "pty" : simulator ? "simulator" : replay ? "replay" : dctool_transport_name (transport));
+	fprintf (fp, ",\n  \"status\": ");
+	bench_string (fp, dctool_errmsg (rc));
+	fprintf (fp, ",\n");
+	fprintf (fp, "  \"elapsed\": %.6f,\n", elapsed);
+	fprintf (fp, "  \"download\": {\n");
+	fprintf (fp, "    \"time\": %.6f,\n", linktime);
+	fprintf (fp, "    \"bytes_in\": %llu,\n", iostats.bytes_in);
+	fprintf (fp, "    \"bytes_out\": %llu,\n", iostats.bytes_out);
+	fprintf (fp, "    \"throughput\": %.1f,\n", linktime > 0.0 ? iostats.bytes_in / linktime : 0.0);
+	fprintf (fp, "    \"roundtrips\": %u,\n", iostats.writes);
+	fprintf (fp, "    \"reads\": %u,\n", iostats.reads);
+	fprintf (fp, "    \"timeouts\": %u,\n", iostats.timeouts);
+	if (simulator)
+		fprintf (fp, "    \"injected\": %u,\n", simstats.injected);
+	if (replay)
+		fprintf (fp, "    \"diverged\": %u,\n", replaystats.diverged);
+	if (ptyloop) {
+		unsigned long long nbytes = iostats.bytes_in + iostats.bytes_out;
+		fprintf (fp, "    \"syscalls\": %llu,\n", syscalls);
+		fprintf (fp, "    \"syscalls_per_byte\": %.3f,\n", nbytes ? (double) syscalls / nbytes : 0.0);
+		fprintf (fp, "    \"read_latency\": %u,\n", bench_median (iostats.read_latency));
+		fprintf (fp, "    \"write_latency\": %u,\n", bench_median (iostats.write_latency));
+	}
+	fprintf (fp, "    \"first_dive\": %.6f,\n", bench.ndives ? bench.first : 0.0);
+	fprintf (fp, "    \"dives\": %u,\n", bench.ndives);
+	fprintf (fp, "    \"dive_bytes\": %llu\n", bench.nbytes);
+	fprintf (fp, "  },\n");
+	if (parse) {
+		fprintf (fp, "  \"parse\": {\n");
+		fprintf (fp, "    \"dives\": %u,\n", bench.nparsed);
+		fprintf (fp, "    \"errors\": %u,\n", bench.nerrors);
+		fprintf (fp, "    \"samples\": %llu,\n", bench.nsamples);
+		fprintf (fp, "    \"total\": %.6f,\n", bench.total);
+		fprintf (fp, "    \"min\": %.6f,\n", bench.min);
+		fprintf (fp, "    \"max\": %.6f,\n", bench.max);
+		fprintf (fp, "    \"mean\": %.6f\n", bench.nparsed ? bench.total / bench.nparsed : 0.0);
+		fprintf (fp, "  },\n");
+	}
+	fprintf (fp, "  \"peak_rss\": %llu\n", dctool_peak_rss ());
+	fprintf (fp, "}\n");
+
+cleanup:
+	dc_device_close (device);
+	dc_iostream_close (iostream);
+	dctool_ptyloop_free (ptyloop);
+	return rc;
+}
+
+static int
+dctool_bench_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_buffer_t *image = NULL;
+	dctool_simulator_t *simulator = NULL;
+	dctool_replay_t *replay = NULL;
+	dc_transport_t transport = dctool_transport_default (descriptor);
+	FILE *fp = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	unsigned int parse = 1;
+	unsigned int pty = 0;
+	const char *filename = NULL;
+	const char *imagename = NULL;
+	const char *tracename = NULL;
+	double timescale = 1.0;
+	dctool_simulator_params_t params = {NULL, 0, 0, 0.0, 1};
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "ht:o:ni:v:l:b:e:s:r:T:p";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"transport",   required_argument, 0, 't'},
+		{"output",      required_argument, 0, 'o'},
+		{"no-parse",    no_argument,       0, 'n'},
+		{"image",       required_argument, 0, 'i'},
+		{"version",     required_argument, 0, 'v'},
+		{"latency",     required_argument, 0, 'l'},
+		{"bandwidth",   required_argument, 0, 'b'},
+		{"errors",      required_argument, 0, 'e'},
+		{"seed",        required_argument, 0, 's'},
+		{"replay",      required_argument, 0, 'r'},
+		{"timescale",   required_argument, 0, 'T'},
+		{"pty",         no_argument,       0, 'p'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 't':
+			transport = dctool_transport_type (optarg);
+			break;
+		case 'o':
+			filename = optarg;
+			break;
+		case 'n':
+			parse = 0;
+			break;
+		case 'i':
+			imagename = optarg;
+			break;
+		case 'v':
+			params.version = optarg;
+			break;
+		case 'l':
+			params.latency = strtoul (optarg, NULL, 0);
+			break;
+		case 'b':
+			params.bandwidth = strtoul (optarg, NULL, 0);
+			break;
+		case 'e':
+			params.errors = strtod (optarg, NULL);
+			break;
+		case 's':
+			params.seed = strtoul (optarg, NULL, 0);
+			break;
+		case 'r':
+			tracename = optarg;
+			break;
+		case 'T':
+			timescale = strtod (optarg, NULL);
+			break;
+		case 'p':
+			pty = 1;
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		dctool_command_showhelp (&dctool_bench);
+		return EXIT_SUCCESS;
+	}
+
+	if (imagename) {
+		// Load the memory image.
+		image = dctool_file_read (imagename);
+		if (image == NULL) {
+			message ("No valid memory image specified.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		// Create the simulator.
+		status = dctool_simulator_new (&simulator, descriptor, image, &params);
+		if (status != DC_STATUS_SUCCESS) {
+			if (status == DC_STATUS_UNSUPPORTED)
+				message ("No simulator available for this dive computer.\n");
+			else
+				message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else if (tracename) {
+		// Load the wire trace.
+		status = dctool_replay_new (&replay, tracename, timescale);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("No valid wire trace specified.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else if (transport == DC_TRANSPORT_NONE) {
+		message ("No valid transport type specified.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Open the output file.
+	if (filename) {
+		fp = fopen (filename, "w");
+		if (fp == NULL) {
+			message ("Failed to open the output file.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	// Run the benchmark.
+	status = bench (context, descriptor, transport, argv[0], simulator, replay, pty, parse, fp ? fp : stdout);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+cleanup:
+	if (fp)
+		fclose (fp);
+	dctool_simulator_free (simulator);
+	dctool_replay_free (replay);
+	dc_buffer_free (image);
+	return exitcode;
+}
+
+const dctool_command_t dctool_bench = {
+	dctool_bench_run,
+	DCTOOL_CONFIG_DESCRIPTOR,
+	"bench",
+	"Benchmark the download and parsing of the dives",
+	"Usage:\n"
+	"   dctool bench [options] <devname>\n"
+	"   dctool bench [options] --image <filename>\n"
+	"   dctool bench [options] --replay <filename>\n"
+	"\n"
+	"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+	"   -h, --help                 Show help message\n"
+	"   -t, --transport <name>     Transport type\n"
+	"   -o, --output <filename>    Output filename\n"
+	"   -n, --no-parse             Download only\n"
+	"   -i, --image <filename>     Simulate the device from a memory image\n"
+	"   -v, --version <string>     Version string of the simulated device\n"
+	"   -l, --latency <ms>         Simulated latency per packet\n"
+	"   -b, --bandwidth <bytes>    Simulated bandwidth in bytes per second\n"
+	"   -e, --errors <rate>        Fraction of corrupted or lost packets\n"
+	"   -s, --seed <number>        Seed for the error injection\n"
+	"   -p, --pty                  Run the simulator behind a pty\n"
+	"   -r, --replay <filename>    Replay a recorded wire trace\n"
+	"   -T, --timescale <factor>   Time scale of the replay (0 for no delays)\n"
+#else
+	"   -h                 Show help message\n"
+	"   -t <transport>     Transport type\n"
+	"   -o <filename>      Output filename\n"
+	"   -n                 Download only\n"
+	"   -i <filename>      Simulate the device from a memory image\n"
+	"   -v <string>        Version string of the simulated device\n"
+	"   -l <ms>            Simulated latency per packet\n"
+	"   -b <bytes>         Simulated bandwidth in bytes per second\n"
+	"   -e <rate>          Fraction of corrupted or lost packets\n"
+	"   -s <number>        Seed for the error injection\n"
+	"   -p                 Run the simulator behind a pty\n"
+	"   -r <filename>      Replay a recorded wire trace\n"
+	"   -T <factor>        Time scale of the replay (0 for no delays)\n"
+#endif
+	"\n"
+	"The results are written in JSON format. All times are in seconds,\n"
+	"the throughput in bytes per second and the peak RSS in kilobytes.\n"
+	"\n"
+	"A wire trace, recorded with the download command, is replayed with\n"
+	"the original timing, or scaled with the time scale. The transfer\n"
+	"time is the recorded time of the replayed calls, and calls which\n"
+	"differ from the trace are counted as divergences.\n"
+	"\n"
+	"Behind a pty, the simulator answers on the master side of a pseudo\n"
+	"terminal, and the slave side is opened as a serial port. The transfer\n"
+	"time is the real time, and the number of read and write system calls\n"
+	"(on Linux) and the median read and write latencies (in microseconds)\n"
+	"are reported as well.\n"
+};
@@ -39,11 +39,14 @@
 #include "dctool.h"
 #include "common.h"
 #include "output.h"
+#include "profile.h"
 #include "utils.h"
+#include "wiretrace.h"
 
 typedef struct event_data_t {
 	const char *cachedir;
 	dc_event_devinfo_t devinfo;
+	dctool_profile_t *profile;
 } event_data_t;
 
 typedef struct dive_data_t {
@@ -51,30 +54,40 @@ typedef struct dive_data_t {
 	dc_buffer_t **fingerprint;
 	unsigned int number;
 	dctool_output_t *output;
+	dctool_profile_t *profile;
 } dive_data_t;
 
-static int
-dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+/*
+ * Render the dive on a worker thread, while the download continues. The
+ * outputs without rendering support write the dive from the done
+ * callback instead.
+ */
+static dc_status_t
+parse_cb (dc_parser_t *parser, const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void **result, void *userdata)
 {
 	dive_data_t *divedata = (dive_data_t *) userdata;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	dc_parser_t *parser = NULL;
+	FILE *fragment = NULL;
 
-	divedata->number++;
+	dc_status_t rc = dctool_output_render (divedata->output, &fragment, parser, data, size, fingerprint, fsize);
+	if (rc == DC_STATUS_UNSUPPORTED)
+		return DC_STATUS_SUCCESS;
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
 
-	message ("Dive: number=%u, size=%u, fingerprint=", divedata->number, size);
-	for (unsigned int i = 0; i < fsize; ++i)
-		message ("%02X", fingerprint[i]);
-	message ("\n");
+	*result = fragment;
 
-	// Keep a copy of the most recent fingerprint. Because dives are
-	// guaranteed to be downloaded in reverse order, the most recent
-	// dive is always the first dive.
-	if (divedata->number == 1) {
-		dc_buffer_t *fp = dc_buffer_new (fsize);
-		dc_buffer_append (fp, fingerprint, fsize);
-		*divedata->fingerprint = fp;
-	}
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+write_dive (dive_data_t *divedata, const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+
+	// Without a parser, the dive is written as-is.
+	if (!dctool_output_needs_parser (divedata->output))
+		goto write;
 
 	// Create the parser.
 	message ("Creating the parser.\n");
@@ -92,6 +105,9 @@ dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fing
 		goto cleanup;
 	}
 
+	dctool_profile_mark (divedata->profile, "parser", divedata->number);
+
+write:
 	// Parse the dive data.
 	message ("Parsing the dive data.\n");
 	rc = dctool_output_write (divedata->output, parser, data, size, fingerprint, fsize);
@@ -100,8 +116,76 @@ dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fing
 		goto cleanup;
 	}
 
+	dctool_profile_mark (divedata->profile, "output", divedata->number);
+
 cleanup:
 	dc_parser_destroy (parser);
+	return rc;
+}
+
+static void
+dive_report (dive_data_t *divedata, unsigned int size, const unsigned char *fingerprint, unsigned int fsize)
+{
+	divedata->number++;
+
+	message ("Dive: number=%u, size=%u, fingerprint=", divedata->number, size);
+	for (unsigned int i = 0; i < fsize; ++i)
+		message ("%02X", fingerprint[i]);
+	message ("\n");
+
+	// Keep a copy of the most recent fingerprint. Because dives are
+	// guaranteed to be downloaded in reverse order, the most recent
+	// dive is always the first dive.
+	if (divedata->number == 1) {
+		dc_buffer_t *fp = dc_buffer_new (fsize);
+		dc_buffer_append (fp, fingerprint, fsize);
+		*divedata->fingerprint = fp;
+	}
+}
+
+static int
+dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dive_data_t *divedata = (dive_data_t *) userdata;
+
+	dive_report (divedata, size, fingerprint, fsize);
+
+	// The logbook is read before the first dive is reported, so the
+	// first phase also contains the profile of the first dive.
+	dctool_profile_mark (divedata->profile,
+		divedata->number == 1 ? "logbook" : "profile", divedata->number);
+
+	write_dive (divedata, data, size, fingerprint, fsize);
+
+	return 1;
+}
+
+static int
+done_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, dc_status_t status, void *result, void *userdata)
+{
+	dive_data_t *divedata = (dive_data_t *) userdata;
+	FILE *fragment = (FILE *) result;
+
+	// The dives after a stop only release their fragment.
+	if (status == DC_STATUS_CANCELLED) {
+		if (fragment)
+			fclose (fragment);
+		return 0;
+	}
+
+	dive_report (divedata, size, fingerprint, fsize);
+
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error parsing the dive data.");
+	} else if (fragment) {
+		status = dctool_output_append (divedata->output, fragment);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR ("Error writing the dive data.");
+		}
+	} else {
+		write_dive (divedata, data, size, fingerprint, fsize);
+	}
+
 	return 1;
 }
 
@@ -145,6 +229,8 @@ event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *us
 		// Keep a copy of the event data. It will be used for generating
 		// the fingerprint filename again after a (successful) download.
 		eventdata->devinfo = *devinfo;
+
+		dctool_profile_mark (eventdata->profile, "version", 0);
 		break;
 	default:
 		break;
@@ -152,35 +238,65 @@ event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *us
 }
 
 static dc_status_t
-download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, const char *cachedir, dc_buffer_t *fingerprint, dctool_output_t *output)
+download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, dc_buffer_t *image, const char *cachedir, dc_buffer_t *fingerprint, unsigned int nthreads, dctool_output_t *output, dctool_profile_t *profile, const char *tracename, unsigned int timesync)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_iostream_t *iostream = NULL;
 	dc_device_t *device = NULL;
 	dc_buffer_t *ofingerprint = NULL;
 
-	// Open the I/O stream.
-	message ("Opening the I/O stream (%s, %s).\n",
-		dctool_transport_name (transport),
-		devname ? devname : "null");
-	rc = dctool_iostream_open (&iostream, context, descriptor, transport, devname);
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR ("Error opening the I/O stream.");
-		goto cleanup;
-	}
+	// Open the memory image, instead of the I/O stream and the device.
+	if (image) {
+		message ("Opening the memory image (%s %s).\n",
+			dc_descriptor_get_vendor (descriptor),
+			dc_descriptor_get_product (descriptor));
+		rc = dc_device_image_open (&device, context, descriptor,
+			dc_buffer_get_data (image), dc_buffer_get_size (image));
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error opening the memory image.");
+			goto cleanup;
+		}
+	} else {
+		// Open the I/O stream.
+		message ("Opening the I/O stream (%s, %s).\n",
+			dctool_transport_name (transport),
+			devname ? devname : "null");
+		rc = dctool_iostream_open (&iostream, context, descriptor, transport, devname);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error opening the I/O stream.");
+			goto cleanup;
+		}
 
-	// Open the device.
-	message ("Opening the device (%s %s).\n",
-		dc_descriptor_get_vendor (descriptor),
-		dc_descriptor_get_product (descriptor));
-	rc = dc_device_open (&device, context, descriptor, iostream);
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR ("Error opening the device.");
-		goto cleanup;
+		// Record the wire trace.
+		if (tracename) {
+			dc_iostream_t *recorder = NULL;
+			rc = dctool_wiretrace_open (&recorder, context, iostream, tracename);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR ("Error opening the wire trace.");
+				goto cleanup;
+			}
+			iostream = recorder;
+		}
+
+		dctool_profile_set_iostream (profile, iostream);
+		dctool_profile_mark (profile, "open", 0);
+
+		// Open the device.
+		message ("Opening the device (%s %s).\n",
+			dc_descriptor_get_vendor (descriptor),
+			dc_descriptor_get_product (descriptor));
+		rc = dc_device_open (&device, context, descriptor, iostream);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error opening the device.");
+			goto cleanup;
+		}
 	}
 
+	dctool_profile_mark (profile, "handshake", 0);
+
 	// Initialize the event data.
 	event_data_t eventdata = {0};
+	eventdata.profile = profile;
 	if (fingerprint) {
 		eventdata.cachedir = NULL;
 	} else {
@@ -189,7 +305,7 @@ download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t tra
 
 	// Register the event handler.
 	message ("Registering the event handler.\n");
-	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR;
+	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR | DC_EVENT_STATS;
 	rc = dc_device_set_events (device, events, event_cb, &eventdata);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error registering the event handler.");
@@ -220,15 +336,24 @@ download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t tra
 	divedata.fingerprint = &ofingerprint;
 	divedata.number = 0;
 	divedata.output = output;
+	divedata.profile = profile;
 
-	// Download the dives.
+	// Download the dives, and write them while the download continues.
+	// Without a parser, the dives are written directly. For the profile,
+	// the dives are also parsed on the download thread, to keep the
+	// phases apart.
 	message ("Downloading the dives.\n");
-	rc = dc_device_foreach (device, dive_cb, &divedata);
+	if (dctool_output_needs_parser (output) && profile == NULL)
+		rc = dc_device_foreach_parsed (device, nthreads, parse_cb, done_cb, &divedata);
+	else
+		rc = dc_device_foreach (device, dive_cb, &divedata);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error downloading the dives.");
 		goto cleanup;
 	}
 
+	dctool_profile_mark (profile, "finish", 0);
+
 	// Store the fingerprint data.
 	if (cachedir && ofingerprint) {
 		char filename[1024] = {0};
@@ -243,9 +368,29 @@ download (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t tra
 		dctool_file_write (filename, ofingerprint);
 	}
 
+	// Synchronize the clock, without a second handshake. The dives are
+	// already downloaded, so a failure isn't fatal.
+	if (timesync) {
+		dc_device_keepalive (device);
+
+		message ("Synchronizing the device clock.\n");
+		dc_datetime_t datetime = {0};
+		dc_datetime_localtime (&datetime, dc_datetime_now ());
+		rc = dc_device_timesync (device, &datetime);
+		if (rc != DC_STATUS_SUCCESS) {
+			WARNING ("Error synchronizing the device clock.");
+			rc = DC_STATUS_SUCCESS;
+		} else {
+			dctool_profile_mark (profile, "timesync", 0);
+		}
+	}
+
 cleanup:
 	dc_buffer_free (ofingerprint);
 	dc_device_close (device);
+	if (device)
+		dctool_profile_mark (profile, "close", 0);
+	dctool_profile_set_iostream (profile, NULL);
 	dc_iostream_close (iostream);
 	return rc;
 }
@@ -257,6 +402,7 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_buffer_t *fingerprint = NULL;
 	dctool_output_t *output = NULL;
+	dctool_profile_t *profile = NULL;
 	dctool_units_t units = DCTOOL_UNITS_METRIC;
 	dc_transport_t transport = dctool_transport_default (descriptor);
 
@@ -266,10 +412,16 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 	const char *filename = NULL;
 	const char *cachedir = NULL;
 	const char *format = "xml";
+	unsigned int nthreads = 1;
+	unsigned int timing = 0;
+	const char *tracename = NULL;
+	unsigned int timesync = 0;
+	const char *imagename = NULL;
+	dc_buffer_t *image = NULL;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:o:p:c:f:u:";
+	const char *optstring = "ht:o:p:c:f:u:j:Pr:Ti:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
@@ -279,6 +431,11 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		{"cache",       required_argument, 0, 'c'},
 		{"format",      required_argument, 0, 'f'},
 		{"units",       required_argument, 0, 'u'},
+		{"jobs",        required_argument, 0, 'j'},
+		{"profile",     no_argument,       0, 'P'},
+		{"record",      required_argument, 0, 'r'},
+		{"timesync",    no_argument,       0, 'T'},
+		{"image",       required_argument, 0, 'i'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -310,6 +467,21 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 			if (strcmp (optarg, "imperial") == 0)
 				units = DCTOOL_UNITS_IMPERIAL;
 			break;
+		case 'j':
+			nthreads = strtoul (optarg, NULL, 0);
+			break;
+		case 'P':
+			timing = 1;
+			break;
+		case 'r':
+			tracename = optarg;
+			break;
+		case 'T':
+			timesync = 1;
+			break;
+		case 'i':
+			imagename = optarg;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -324,8 +496,18 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		return EXIT_SUCCESS;
 	}
 
+	// Load the memory image.
+	if (imagename) {
+		image = dctool_file_read (imagename);
+		if (image == NULL) {
+			message ("No valid memory image specified.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
 	// Check the transport type.
-	if (transport == DC_TRANSPORT_NONE) {
+	if (image == NULL && transport == DC_TRANSPORT_NONE) {
 		message ("No valid transport type specified.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
@@ -339,6 +521,10 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		output = dctool_raw_output_new (filename);
 	} else if (strcasecmp(format, "xml") == 0) {
 		output = dctool_xml_output_new (filename, units);
+	} else if (strcasecmp(format, "json") == 0) {
+		output = dctool_json_output_new (filename, units);
+	} else if (strcasecmp(format, "columns") == 0) {
+		output = dctool_columns_output_new (filename, units);
 	} else {
 		message ("Unknown output format: %s\n", format);
 		exitcode = EXIT_FAILURE;
@@ -350,8 +536,19 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		goto cleanup;
 	}
 
+	// Create the profile.
+	if (timing) {
+		profile = dctool_profile_new ();
+		if (profile == NULL) {
+			message ("Failed to create the profile.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
 	// Download the dives.
-	status = download (context, descriptor, transport, argv[0], cachedir, fingerprint, output);
+	status = download (context, descriptor, transport, argv[0], image, cachedir, fingerprint, nthreads, output, profile, tracename, timesync);
+	dctool_profile_print (profile);
 	if (status != DC_STATUS_SUCCESS) {
 		message ("ERROR: %s\n", dctool_errmsg (status));
 		exitcode = EXIT_FAILURE;
@@ -359,8 +556,10 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 	}
 
 cleanup:
+	dctool_profile_free (profile);
 	dctool_output_free (output);
 	dc_buffer_free (fingerprint);
+	dc_buffer_free (image);
 	return exitcode;
 }
 
@@ -371,6 +570,7 @@ const dctool_command_t dctool_download = {
 	"Download the dives",
 	"Usage:\n"
 	"   dctool download [options] <devname>\n"
+	"   dctool download [options] --image <filename>\n"
 	"\n"
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
@@ -381,6 +581,11 @@ const dctool_command_t dctool_download = {
 	"   -c, --cache <directory>    Cache directory\n"
 	"   -f, --format <format>      Output format\n"
 	"   -u, --units <units>        Set units (metric or imperial)\n"
+	"   -j, --jobs <count>         Number of worker threads\n"
+	"   -P, --profile              Print a timing profile\n"
+	"   -r, --record <filename>    Record a wire trace\n"
+	"   -T, --timesync             Synchronize the clock afterwards\n"
+	"   -i, --image <filename>     Extract the dives from a memory image\n"
 #else
 	"   -h                 Show help message\n"
 	"   -t <transport>     Transport type\n"
@@ -389,6 +594,11 @@ const dctool_command_t dctool_download = {
 	"   -c <directory>     Cache directory\n"
 	"   -f <format>        Output format\n"
 	"   -u <units>         Set units (metric or imperial)\n"
+	"   -j <count>         Number of worker threads\n"
+	"   -P                 Print a timing profile\n"
+	"   -r <filename>      Record a wire trace\n"
+	"   -T                 Synchronize the clock afterwards\n"
+	"   -i <filename>      Extract the dives from a memory image\n"
 #endif
 	"\n"
 	"Supported output formats:\n"
@@ -397,6 +607,16 @@ const dctool_command_t dctool_download = {
 	"\n"
 	"      All dives are exported to a single xml file.\n"
 	"\n"
+	"   JSON\n"
+	"\n"
+	"      All dives are exported to a single file, with one JSON object\n"
+	"      per line (NDJSON).\n"
+	"\n"
+	"   COLUMNS\n"
+	"\n"
+	"      The samples of all dives are exported to one binary file per\n"
+	"      column, with the filename as the prefix, and a schema file.\n"
+	"\n"
 	"   RAW\n"
 	"\n"
 	"      Each dive is exported to a raw (binary) file. To output multiple\n"
@@ -408,4 +628,14 @@ const dctool_command_t dctool_download = {
 	"   %f   Fingerprint (hexadecimal format)\n"
 	"   %n   Number (4 digits)\n"
 	"   %t   Timestamp (basic ISO 8601 date/time format)\n"
+	"\n"
+	"The timing profile shows the elapsed time and the I/O traffic of every\n"
+	"phase of the download: opening the I/O stream, the handshake, the\n"
+	"version probe, the logbook (including the first dive), the profile of\n"
+	"every other dive, the parser setup and the output per dive, and\n"
+	"closing the device. With the profile, the dives are parsed on the\n"
+	"download thread.\n"
+	"\n"
+	"The wire trace contains every call on the I/O stream, with its timing,\n"
+	"and can be replayed with the bench command.\n"
 };
@@ -37,10 +37,23 @@
 
 #include "dctool.h"
 #include "common.h"
+#include "profile.h"
 #include "utils.h"
 
+static void
+event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata)
+{
+	dctool_profile_t *profile = (dctool_profile_t *) userdata;
+
+	// Forward to the default event handler.
+	dctool_event_cb (device, event, data, userdata);
+
+	if (event == DC_EVENT_DEVINFO)
+		dctool_profile_mark (profile, "version", 0);
+}
+
 static dc_status_t
-dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, dc_buffer_t *fingerprint, dc_buffer_t *buffer)
+dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, dc_buffer_t *fingerprint, dc_buffer_t *buffer, dctool_profile_t *profile)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_iostream_t *iostream = NULL;
@@ -56,6 +69,9 @@ dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 		goto cleanup;
 	}
 
+	dctool_profile_set_iostream (profile, iostream);
+	dctool_profile_mark (profile, "open", 0);
+
 	// Open the device.
 	message ("Opening the device (%s %s).\n",
 		dc_descriptor_get_vendor (descriptor),
@@ -66,10 +82,12 @@ dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 		goto cleanup;
 	}
 
+	dctool_profile_mark (profile, "handshake", 0);
+
 	// Register the event handler.
 	message ("Registering the event handler.\n");
-	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR;
-	rc = dc_device_set_events (device, events, dctool_event_cb, NULL);
+	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR | DC_EVENT_STATS;
+	rc = dc_device_set_events (device, events, event_cb, profile);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error registering the event handler.");
 		goto cleanup;
@@ -101,8 +119,13 @@ dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 		goto cleanup;
 	}
 
+	dctool_profile_mark (profile, "dump", 0);
+
 cleanup:
 	dc_device_close (device);
+	if (device)
+		dctool_profile_mark (profile, "close", 0);
+	dctool_profile_set_iostream (profile, NULL);
 	dc_iostream_close (iostream);
 	return rc;
 }
@@ -114,22 +137,25 @@ dctool_dump_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_buffer_t *fingerprint = NULL;
 	dc_buffer_t *buffer = NULL;
+	dctool_profile_t *profile = NULL;
 	dc_transport_t transport = dctool_transport_default (descriptor);
 
 	// Default option values.
 	unsigned int help = 0;
 	const char *fphex = NULL;
 	const char *filename = NULL;
+	unsigned int timing = 0;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:o:p:";
+	const char *optstring = "ht:o:p:P";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
 		{"transport",   required_argument, 0, 't'},
 		{"output",      required_argument, 0, 'o'},
 		{"fingerprint", required_argument, 0, 'p'},
+		{"profile",     no_argument,       0, 'P'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -149,6 +175,9 @@ dctool_dump_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'p':
 			fphex = optarg;
 			break;
+		case 'P':
+			timing = 1;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -173,21 +202,56 @@ dctool_dump_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	// Convert the fingerprint to binary.
 	fingerprint = dctool_convert_hex2bin (fphex);
 
-	// Allocate a memory buffer.
-	buffer = dc_buffer_new (0);
+	// Allocate a memory buffer. With an output file, the memory dump is
+	// downloaded directly into the file, which is only replaced once the
+	// download succeeded.
+	if (filename) {
+		buffer = dc_buffer_new_sink (filename);
+		if (buffer == NULL) {
+			message ("Failed to open the output file.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else {
+		buffer = dc_buffer_new (0);
+	}
+
+	// Create the profile.
+	if (timing) {
+		profile = dctool_profile_new ();
+		if (profile == NULL) {
+			message ("Failed to create the profile.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
 
 	// Download the memory dump.
-	status = dump (context, descriptor, transport, argv[0], fingerprint, buffer);
+	status = dump (context, descriptor, transport, argv[0], fingerprint, buffer, profile);
 	if (status != DC_STATUS_SUCCESS) {
+		dctool_profile_print (profile);
 		message ("ERROR: %s\n", dctool_errmsg (status));
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
-	// Write the memory dump to disk.
-	dctool_file_write (filename, buffer);
+	// Write the memory dump to stdout. The output file already contains
+	// the memory dump.
+	if (filename) {
+		if (!dc_buffer_commit (buffer)) {
+			message ("Failed to write the output file.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else {
+		dctool_file_write (NULL, buffer);
+	}
+
+	dctool_profile_mark (profile, "output", 0);
+	dctool_profile_print (profile);
 
 cleanup:
+	dctool_profile_free (profile);
 	dc_buffer_free (buffer);
 	dc_buffer_free (fingerprint);
 	return exitcode;
@@ -207,10 +271,12 @@ const dctool_command_t dctool_dump = {
 	"   -t, --transport <name>     Transport type\n"
 	"   -o, --output <filename>    Output filename\n"
 	"   -p, --fingerprint <data>   Fingerprint data (hexadecimal)\n"
+	"   -P, --profile              Print a timing profile\n"
 #else
 	"   -h                 Show help message\n"
 	"   -t <transport>     Transport type\n"
 	"   -o <filename>      Output filename\n"
 	"   -p <fingerprint>   Fingerprint data (hexadecimal)\n"
+	"   -P                 Print a timing profile\n"
 #endif
 };
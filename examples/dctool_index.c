@@ -0,0 +1,933 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/parser.h>
+
+#include "dctool.h"
+#include "common.h"
+#include "utils.h"
+
+/*
+ * The index file starts with a fixed header, followed by one fixed size
+ * record per dive, sorted on the dive time, and a table with the null
+ * terminated filenames. All values are stored in little endian, such
+ * that the file can be mapped into memory and searched directly.
+ *
+ * Header:
+ *    0  magic ("DCIX")
+ *    4  version
+ *    8  number of records
+ *   12  size of a record
+ *   16  offset of the string table
+ *   20  size of the string table
+ *
+ * Record:
+ *    0  dive time (seconds since the epoch, local time of the dive)
+ *    8  system time
+ *   16  dive duration (seconds)
+ *   20  maximum depth (millimeters)
+ *   24  family
+ *   28  model
+ *   32  serial number
+ *   36  device time
+ *   40  offset of the dive in the file
+ *   44  size of the dive
+ *   48  offset of the filename in the string table
+ *   52  available summary fields
+ *   56  size of the fingerprint
+ *   60  fingerprint
+ */
+
+#define INDEX_MAGIC   "DCIX"
+#define INDEX_VERSION 1
+#define INDEX_HEADER  32
+#define INDEX_RECORD  96
+#define INDEX_FPSIZE  32
+
+#define BATCH_SIZE 256
+
+typedef struct index_entry_t {
+	dc_ticks_t datetime;
+	dc_ticks_t systime;
+	unsigned int divetime;
+	unsigned int maxdepth;
+	unsigned int family;
+	unsigned int model;
+	unsigned int serial;
+	unsigned int devtime;
+	unsigned int offset;
+	unsigned int size;
+	unsigned int name;
+	unsigned int fields;
+	unsigned int fsize;
+	unsigned char fingerprint[INDEX_FPSIZE];
+} index_entry_t;
+
+typedef struct index_t {
+	index_entry_t *entries;
+	size_t count, capacity;
+	char *strings;
+	size_t length, available;
+} index_t;
+
+typedef struct index_item_t {
+	char *filename;
+	dc_buffer_t *buffer;
+	dc_descriptor_t *descriptor;
+	dc_summary_t summary;
+} index_item_t;
+
+typedef struct index_batch_t {
+	index_t *index;
+	const char *template;
+	unsigned int serial;
+	unsigned int nerrors;
+} index_batch_t;
+
+static void
+put_uint32 (unsigned char data[], unsigned int value)
+{
+	data[0] = value & 0xFF;
+	data[1] = (value >> 8) & 0xFF;
+	data[2] = (value >> 16) & 0xFF;
+	data[3] = (value >> 24) & 0xFF;
+}
+
+static void
+put_int64 (unsigned char data[], dc_ticks_t value)
+{
+	unsigned long long v = (unsigned long long) value;
+	put_uint32 (data, v & 0xFFFFFFFF);
+	put_uint32 (data + 4, v >> 32);
+}
+
+static unsigned int
+get_uint32 (const unsigned char data[])
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int) data[3] << 24);
+}
+
+static dc_ticks_t
+get_int64 (const unsigned char data[])
+{
+	return (dc_ticks_t) (get_uint32 (data) | ((unsigned long long) get_uint32 (data + 4) << 32));
+}
+
+static void
+index_init (index_t *index)
+{
+	memset (index, 0, sizeof (index_t));
+}
+
+static void
+index_cleanup (index_t *index)
+{
+	free (index->entries);
+	free (index->strings);
+}
+
+static int
+index_add (index_t *index, index_entry_t *entry, const char *filename)
+{
+	size_t n = strlen (filename) + 1;
+
+	if (index->count == index->capacity) {
+		size_t capacity = index->capacity ? index->capacity * 2 : 1024;
+		index_entry_t *entries = (index_entry_t *) realloc (index->entries, capacity * sizeof (index_entry_t));
+		if (entries == NULL)
+			return -1;
+		index->entries = entries;
+		index->capacity = capacity;
+	}
+
+	if (n > index->available - index->length) {
+		size_t available = index->available ? index->available * 2 : 65536;
+		while (n > available - index->length)
+			available *= 2;
+		char *strings = (char *) realloc (index->strings, available);
+		if (strings == NULL)
+			return -1;
+		index->strings = strings;
+		index->available = available;
+	}
+
+	entry->name = index->length;
+	memcpy (index->strings + index->length, filename, n);
+	index->length += n;
+
+	index->entries[index->count++] = *entry;
+
+	return 0;
+}
+
+/*
+ * Validate a mapped index file, and locate the records and the string
+ * table in it.
+ */
+static int
+index_check (dc_buffer_t *buffer, const unsigned char **records, unsigned int *count, const char **strings, unsigned int *length)
+{
+	const unsigned char *data = dc_buffer_get_data (buffer);
+	size_t size = dc_buffer_get_size (buffer);
+
+	if (size < INDEX_HEADER || memcmp (data, INDEX_MAGIC, 4) != 0 ||
+		get_uint32 (data + 4) != INDEX_VERSION ||
+		get_uint32 (data + 12) != INDEX_RECORD)
+		return -1;
+
+	unsigned int n = get_uint32 (data + 8);
+	unsigned int offset = get_uint32 (data + 16);
+	unsigned int nstrings = get_uint32 (data + 20);
+	if (n > (size - INDEX_HEADER) / INDEX_RECORD ||
+		offset != INDEX_HEADER + n * INDEX_RECORD ||
+		nstrings > size - offset ||
+		(nstrings && data[offset + nstrings - 1] != 0))
+		return -1;
+
+	*records = data + INDEX_HEADER;
+	*count = n;
+	*strings = (const char *) data + offset;
+	*length = nstrings;
+
+	return 0;
+}
+
+static void
+index_decode (const unsigned char record[], index_entry_t *entry)
+{
+	entry->datetime = get_int64 (record + 0);
+	entry->systime = get_int64 (record + 8);
+	entry->divetime = get_uint32 (record + 16);
+	entry->maxdepth = get_uint32 (record + 20);
+	entry->family = get_uint32 (record + 24);
+	entry->model = get_uint32 (record + 28);
+	entry->serial = get_uint32 (record + 32);
+	entry->devtime = get_uint32 (record + 36);
+	entry->offset = get_uint32 (record + 40);
+	entry->size = get_uint32 (record + 44);
+	entry->name = get_uint32 (record + 48);
+	entry->fields = get_uint32 (record + 52);
+	entry->fsize = record[56] <= INDEX_FPSIZE ? record[56] : INDEX_FPSIZE;
+	memcpy (entry->fingerprint, record + 60, INDEX_FPSIZE);
+}
+
+static void
+index_encode (unsigned char record[], const index_entry_t *entry)
+{
+	memset (record, 0, INDEX_RECORD);
+	put_int64 (record + 0, entry->datetime);
+	put_int64 (record + 8, entry->systime);
+	put_uint32 (record + 16, entry->divetime);
+	put_uint32 (record + 20, entry->maxdepth);
+	put_uint32 (record + 24, entry->family);
+	put_uint32 (record + 28, entry->model);
+	put_uint32 (record + 32, entry->serial);
+	put_uint32 (record + 36, entry->devtime);
+	put_uint32 (record + 40, entry->offset);
+	put_uint32 (record + 44, entry->size);
+	put_uint32 (record + 48, entry->name);
+	put_uint32 (record + 52, entry->fields);
+	record[56] = entry->fsize;
+	memcpy (record + 60, entry->fingerprint, INDEX_FPSIZE);
+}
+
+/*
+ * Load the records of an existing index, for an incremental update.
+ */
+static int
+index_load (index_t *index, const char *filename)
+{
+	const unsigned char *records = NULL;
+	const char *strings = NULL;
+	unsigned int count = 0, length = 0;
+	int rc = 0;
+
+	dc_buffer_t *buffer = dc_buffer_new_file (filename);
+	if (buffer == NULL)
+		return -1;
+
+	if (index_check (buffer, &records, &count, &strings, &length) != 0) {
+		dc_buffer_free (buffer);
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < count && rc == 0; ++i) {
+		index_entry_t entry;
+		index_decode (records + i * INDEX_RECORD, &entry);
+		if (entry.name >= length)
+			continue;
+		rc = index_add (index, &entry, strings + entry.name);
+	}
+
+	dc_buffer_free (buffer);
+
+	return rc;
+}
+
+static int
+index_cmp_entry (const void *a, const void *b)
+{
+	const index_entry_t *x = (const index_entry_t *) a;
+	const index_entry_t *y = (const index_entry_t *) b;
+
+	if (x->datetime != y->datetime)
+		return x->datetime < y->datetime ? -1 : 1;
+	if (x->serial != y->serial)
+		return x->serial < y->serial ? -1 : 1;
+	if (x->name != y->name)
+		return x->name < y->name ? -1 : 1;
+
+	return 0;
+}
+
+static int
+index_save (index_t *index, const char *filename)
+{
+	unsigned char header[INDEX_HEADER] = {0};
+	unsigned char record[INDEX_RECORD];
+
+	qsort (index->entries, index->count, sizeof (index_entry_t), index_cmp_entry);
+
+	FILE *fp = fopen (filename, "wb");
+	if (fp == NULL)
+		return -1;
+
+	memcpy (header, INDEX_MAGIC, 4);
+	put_uint32 (header + 4, INDEX_VERSION);
+	put_uint32 (header + 8, index->count);
+	put_uint32 (header + 12, INDEX_RECORD);
+	put_uint32 (header + 16, INDEX_HEADER + index->count * INDEX_RECORD);
+	put_uint32 (header + 20, index->length);
+
+	int rc = (fwrite (header, sizeof (header), 1, fp) == 1) ? 0 : -1;
+
+	for (size_t i = 0; i < index->count && rc == 0; ++i) {
+		index_encode (record, index->entries + i);
+		if (fwrite (record, sizeof (record), 1, fp) != 1)
+			rc = -1;
+	}
+
+	if (rc == 0 && index->length && fwrite (index->strings, index->length, 1, fp) != 1)
+		rc = -1;
+
+	if (fclose (fp) != 0)
+		rc = -1;
+
+	return rc;
+}
+
+static int
+index_cmp_name (const void *a, const void *b)
+{
+	return strcmp (*(const char * const *) a, *(const char * const *) b);
+}
+
+/*
+ * Recover the fingerprint from a filename, created by the raw output
+ * with the same template. Returns the number of fingerprint bytes, or
+ * zero if the filename doesn't match the template.
+ */
+static unsigned int
+index_template_match (const char *template, const char *filename, unsigned char fingerprint[])
+{
+	const char *t = template, *f = filename;
+	unsigned int fsize = 0;
+
+	// Without a directory in the template, match the basename only.
+	if (strchr (template, '/') == NULL) {
+		const char *p = strrchr (filename, '/');
+		if (p)
+			f = p + 1;
+	}
+
+	while (*t) {
+		if (*t != '%' || t[1] == '%') {
+			if (*f != *t)
+				return 0;
+			t += (*t == '%') ? 2 : 1;
+			f++;
+			continue;
+		}
+
+		size_t n = 0;
+		switch (t[1]) {
+		case 't': // Timestamp
+			while (n < 15 && (isdigit ((unsigned char) f[n]) || (n == 8 && f[n] == 'T')))
+				n++;
+			if (n != 15)
+				return 0;
+			break;
+		case 'n': // Number
+			while (isdigit ((unsigned char) f[n]))
+				n++;
+			if (n == 0)
+				return 0;
+			break;
+		case 'f': // Fingerprint
+			while (isxdigit ((unsigned char) f[n]))
+				n++;
+			if (n % 2 || n / 2 > INDEX_FPSIZE)
+				return 0;
+			for (size_t i = 0; i < n / 2; ++i) {
+				char hex[3] = {f[i * 2], f[i * 2 + 1], 0};
+				fingerprint[i] = strtoul (hex, NULL, 16);
+			}
+			fsize = n / 2;
+			break;
+		default:
+			return 0;
+		}
+
+		t += 2;
+		f += n;
+	}
+
+	return (*f == 0) ? fsize : 0;
+}
+
+static dc_status_t
+index_batch_parse (dc_parser_t *parser, const dc_parser_job_t *job, void *userdata)
+{
+	index_item_t *item = (index_item_t *) job->userdata;
+
+	// Only the header is parsed, the profile is never walked.
+	return dc_parser_get_summary (parser, &item->summary, 0);
+}
+
+static void
+index_batch_done (const dc_parser_job_t *job, dc_status_t status, void *userdata)
+{
+	index_batch_t *data = (index_batch_t *) userdata;
+	index_item_t *item = (index_item_t *) job->userdata;
+	index_entry_t entry;
+
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s: %s\n", item->filename, dctool_errmsg (status));
+		data->nerrors++;
+		return;
+	}
+
+	memset (&entry, 0, sizeof (entry));
+	entry.fields = item->summary.fields;
+	if (entry.fields & DC_SUMMARY_DATETIME) {
+		// Sort on the local time of the dive.
+		dc_datetime_t datetime = item->summary.datetime;
+		datetime.timezone = DC_TIMEZONE_NONE;
+		entry.datetime = dc_datetime_mktime (&datetime);
+	}
+	if (entry.fields & DC_SUMMARY_DIVETIME)
+		entry.divetime = item->summary.divetime;
+	if (entry.fields & DC_SUMMARY_MAXDEPTH)
+		entry.maxdepth = item->summary.maxdepth * 1000.0 + 0.5;
+	entry.family = dc_descriptor_get_type (job->descriptor);
+	entry.model = dc_descriptor_get_model (job->descriptor);
+	entry.serial = data->serial;
+	entry.devtime = job->devtime;
+	entry.systime = job->systime;
+	entry.offset = 0;
+	entry.size = job->size;
+	if (data->template)
+		entry.fsize = index_template_match (data->template, item->filename, entry.fingerprint);
+
+	if (index_add (data->index, &entry, item->filename) != 0) {
+		message ("ERROR: %s: %s\n", item->filename, dctool_errmsg (DC_STATUS_NOMEMORY));
+		data->nerrors++;
+	}
+}
+
+static int
+index_build (dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, unsigned int serial, const char *template, const char *manifest, int update, int argc, char *argv[], unsigned int nthreads, const char *filename)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parser_batch_t *batch = NULL;
+	FILE *fp = NULL;
+	index_t index;
+	index_item_t items[BATCH_SIZE];
+	dc_parser_job_t jobs[BATCH_SIZE];
+	index_batch_t data = {&index, template, serial, 0};
+	const char **names = NULL;
+	char *snapshot = NULL;
+	size_t nnames = 0;
+	unsigned int nskipped = 0;
+	int i = 0, eof = 0;
+
+	index_init (&index);
+
+	// Load the existing index, and skip the dives which are already
+	// indexed, such that only the new dives are parsed.
+	if (update && access (filename, F_OK) == 0) {
+		if (index_load (&index, filename) != 0) {
+			message ("Failed to load the index file.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		// The string table of the index moves while adding entries, so
+		// the lookup table points into a copy.
+		nnames = index.count;
+		if (nnames) {
+			names = (const char **) malloc (nnames * sizeof (const char *));
+			snapshot = (char *) malloc (index.length);
+			if (names == NULL || snapshot == NULL) {
+				message ("ERROR: %s\n", dctool_errmsg (DC_STATUS_NOMEMORY));
+				exitcode = EXIT_FAILURE;
+				goto cleanup;
+			}
+			memcpy (snapshot, index.strings, index.length);
+			for (size_t j = 0; j < nnames; ++j)
+				names[j] = snapshot + index.entries[j].name;
+			qsort (names, nnames, sizeof (const char *), index_cmp_name);
+		}
+	}
+
+	if (manifest) {
+		fp = fopen (manifest, "r");
+		if (fp == NULL) {
+			message ("Failed to open the manifest file.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	status = dc_parser_batch_new (&batch, context, nthreads);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	while (!eof) {
+		unsigned int count = 0;
+
+		// Read the next set of input files.
+		while (count < BATCH_SIZE) {
+			char line[1024];
+			char *name = NULL, *device = NULL;
+			unsigned int dt = devtime;
+			dc_ticks_t st = systime;
+
+			if (fp) {
+				if (fgets (line, sizeof (line), fp) == NULL) {
+					eof = 1;
+					break;
+				}
+				if (!dctool_manifest_line (line, &name, &dt, &st, &device))
+					continue;
+			} else {
+				if (i >= argc) {
+					eof = 1;
+					break;
+				}
+				name = argv[i++];
+			}
+
+			if (nnames && bsearch (&name, names, nnames, sizeof (const char *), index_cmp_name)) {
+				nskipped++;
+				continue;
+			}
+
+			index_item_t *item = items + count;
+			item->filename = NULL;
+			item->buffer = NULL;
+			item->descriptor = NULL;
+
+			if (device) {
+				status = dctool_descriptor_search (&item->descriptor, device, DC_FAMILY_NULL, 0);
+				if (status != DC_STATUS_SUCCESS || item->descriptor == NULL) {
+					message ("ERROR: %s: Unknown device '%s'.\n", name, device);
+					data.nerrors++;
+					continue;
+				}
+			} else if (descriptor == NULL) {
+				message ("ERROR: %s: No device specified.\n", name);
+				data.nerrors++;
+				continue;
+			}
+
+			item->buffer = dctool_file_read (name);
+			if (item->buffer == NULL) {
+				message ("ERROR: %s: Failed to open the input file.\n", name);
+				dc_descriptor_free (item->descriptor);
+				data.nerrors++;
+				continue;
+			}
+
+			item->filename = strdup (name);
+
+			dc_parser_job_t *job = jobs + count;
+			job->descriptor = item->descriptor ? item->descriptor : descriptor;
+			job->devtime = dt;
+			job->systime = st;
+			job->data = dc_buffer_get_data (item->buffer);
+			job->size = dc_buffer_get_size (item->buffer);
+			job->userdata = item;
+
+			count++;
+		}
+
+		// Parse the dive headers.
+		status = dc_parser_batch_run (batch, jobs, count, index_batch_parse, index_batch_done, &data);
+
+		for (unsigned int j = 0; j < count; ++j) {
+			dc_descriptor_free (items[j].descriptor);
+			dc_buffer_free (items[j].buffer);
+			free (items[j].filename);
+		}
+
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	if (index_save (&index, filename) != 0) {
+		message ("Failed to write the index file.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	message ("Indexed %u dive(s), skipped %u dive(s).\n", (unsigned int) index.count, nskipped);
+
+	if (data.nerrors) {
+		message ("Failed to index %u dive(s).\n", data.nerrors);
+		exitcode = EXIT_FAILURE;
+	}
+
+cleanup:
+	dc_parser_batch_free (batch);
+	if (fp)
+		fclose (fp);
+	free (names);
+	free (snapshot);
+	index_cleanup (&index);
+	return exitcode;
+}
+
+/*
+ * Parse a timestamp in the format of the raw output (YYYYMMDDThhmmss),
+ * where the time part is optional.
+ */
+static int
+index_parse_datetime (const char *str, dc_ticks_t *ticks)
+{
+	dc_datetime_t datetime = {0};
+
+	int n = sscanf (str, "%4d%2d%2dT%2d%2d%2d",
+		&datetime.year, &datetime.month, &datetime.day,
+		&datetime.hour, &datetime.minute, &datetime.second);
+	if (n != 3 && n != 6)
+		return -1;
+
+	datetime.timezone = DC_TIMEZONE_NONE;
+	*ticks = dc_datetime_mktime (&datetime);
+
+	return 0;
+}
+
+static int
+index_query (const char *filename, dc_descriptor_t *descriptor, const char *begin, const char *end, unsigned int serial, dc_buffer_t *fingerprint, int list)
+{
+	int exitcode = EXIT_SUCCESS;
+	const unsigned char *records = NULL;
+	const char *strings = NULL;
+	unsigned int count = 0, length = 0;
+	dc_ticks_t tbegin = 0, tend = 0;
+	dc_descriptor_t *device = NULL;
+	unsigned int matches = 0;
+
+	if ((begin && index_parse_datetime (begin, &tbegin) != 0) ||
+		(end && index_parse_datetime (end, &tend) != 0)) {
+		message ("Invalid timestamp.\n");
+		return EXIT_FAILURE;
+	}
+
+	// A date without a time includes the entire day.
+	if (end && strchr (end, 'T') == NULL)
+		tend += 24 * 3600 - 1;
+
+	dc_buffer_t *buffer = dc_buffer_new_file (filename);
+	if (buffer == NULL || index_check (buffer, &records, &count, &strings, &length) != 0) {
+		message ("Failed to open the index file.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Locate the first dive in the range.
+	unsigned int lo = 0, hi = count;
+	if (begin) {
+		while (lo < hi) {
+			unsigned int mid = lo + (hi - lo) / 2;
+			if (get_int64 (records + mid * INDEX_RECORD) < tbegin)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+	}
+
+	for (unsigned int i = lo; i < count; ++i) {
+		index_entry_t entry;
+		index_decode (records + i * INDEX_RECORD, &entry);
+
+		if (end && entry.datetime > tend)
+			break;
+
+		if (entry.name >= length)
+			continue;
+		if (descriptor && (entry.family != dc_descriptor_get_type (descriptor) ||
+			entry.model != dc_descriptor_get_model (descriptor)))
+			continue;
+		if (serial && entry.serial != serial)
+			continue;
+		if (fingerprint && (entry.fsize != dc_buffer_get_size (fingerprint) ||
+			memcmp (entry.fingerprint, dc_buffer_get_data (fingerprint), entry.fsize) != 0))
+			continue;
+
+		// Lookup the device name, once per device.
+		if (device == NULL || entry.family != dc_descriptor_get_type (device) ||
+			entry.model != dc_descriptor_get_model (device)) {
+			dc_descriptor_free (device);
+			device = NULL;
+			dctool_descriptor_search (&device, NULL, entry.family, entry.model);
+		}
+
+		const char *name = strings + entry.name;
+
+		if (list) {
+			dc_datetime_t datetime = {0};
+			char hex[2 * INDEX_FPSIZE + 1] = {0};
+			for (unsigned int j = 0; j < entry.fsize; ++j)
+				snprintf (hex + j * 2, 3, "%02X", entry.fingerprint[j]);
+			dc_datetime_gmtime (&datetime, entry.datetime);
+			printf ("%04i-%02i-%02i %02i:%02i:%02i %02u:%02u:%02u %7.2f %s %s %u %s %u+%u %s\n",
+				datetime.year, datetime.month, datetime.day,
+				datetime.hour, datetime.minute, datetime.second,
+				entry.divetime / 3600, (entry.divetime % 3600) / 60, entry.divetime % 60,
+				entry.maxdepth / 1000.0,
+				device ? dc_descriptor_get_vendor (device) : dctool_family_name (entry.family),
+				device ? dc_descriptor_get_product (device) : "?",
+				entry.serial, entry.fsize ? hex : "-",
+				entry.offset, entry.size, name);
+		} else {
+			// A manifest for the parse command.
+			printf ("%s %u " DC_TICKS_FORMAT, name, entry.devtime, entry.systime);
+			if (device)
+				printf (" %s %s", dc_descriptor_get_vendor (device), dc_descriptor_get_product (device));
+			printf ("\n");
+		}
+
+		matches++;
+	}
+
+	message ("Found %u of %u dive(s).\n", matches, count);
+
+cleanup:
+	dc_descriptor_free (device);
+	dc_buffer_free (buffer);
+	return exitcode;
+}
+
+static int
+dctool_index_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_buffer_t *fingerprint = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	const char *filename = NULL;
+	const char *query = NULL;
+	const char *manifest = NULL;
+	const char *template = NULL;
+	const char *begin = NULL, *end = NULL;
+	const char *fphex = NULL;
+	unsigned int devtime = 0;
+	dc_ticks_t systime = 0;
+	unsigned int serial = 0;
+	unsigned int nthreads = 0;
+	unsigned int update = 0;
+	unsigned int list = 0;
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "ho:q:m:r:d:s:S:j:ub:e:p:l";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"output",      required_argument, 0, 'o'},
+		{"query",       required_argument, 0, 'q'},
+		{"manifest",    required_argument, 0, 'm'},
+		{"template",    required_argument, 0, 'r'},
+		{"devtime",     required_argument, 0, 'd'},
+		{"systime",     required_argument, 0, 's'},
+		{"serial",      required_argument, 0, 'S'},
+		{"jobs",        required_argument, 0, 'j'},
+		{"update",      no_argument,       0, 'u'},
+		{"begin",       required_argument, 0, 'b'},
+		{"end",         required_argument, 0, 'e'},
+		{"fingerprint", required_argument, 0, 'p'},
+		{"list",        no_argument,       0, 'l'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 'o':
+			filename = optarg;
+			break;
+		case 'q':
+			query = optarg;
+			break;
+		case 'm':
+			manifest = optarg;
+			break;
+		case 'r':
+			template = optarg;
+			break;
+		case 'd':
+			devtime = strtoul (optarg, NULL, 0);
+			break;
+		case 's':
+			systime = strtoll (optarg, NULL, 0);
+			break;
+		case 'S':
+			serial = strtoul (optarg, NULL, 0);
+			break;
+		case 'j':
+			nthreads = strtoul (optarg, NULL, 0);
+			break;
+		case 'u':
+			update = 1;
+			break;
+		case 'b':
+			begin = optarg;
+			break;
+		case 'e':
+			end = optarg;
+			break;
+		case 'p':
+			fphex = optarg;
+			break;
+		case 'l':
+			list = 1;
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		dctool_command_showhelp (&dctool_index);
+		return EXIT_SUCCESS;
+	}
+
+	if (query) {
+		fingerprint = dctool_convert_hex2bin (fphex);
+		exitcode = index_query (query, descriptor, begin, end, serial, fingerprint, list);
+		dc_buffer_free (fingerprint);
+		return exitcode;
+	}
+
+	if (filename == NULL) {
+		message ("No index file specified.\n");
+		return EXIT_FAILURE;
+	}
+
+	return index_build (context, descriptor, devtime, systime, serial, template, manifest, update, argc, argv, nthreads, filename);
+}
+
+const dctool_command_t dctool_index = {
+	dctool_index_run,
+	DCTOOL_CONFIG_NONE,
+	"index",
+	"Index previously downloaded dives",
+	"Usage:\n"
+	"   dctool index [options] --output <index> <filename>...\n"
+	"   dctool index [options] --output <index> --manifest <filename>\n"
+	"   dctool index [options] --query <index>\n"
+	"\n"
+	"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+	"   -h, --help                 Show help message\n"
+	"   -o, --output <filename>    Index file to create\n"
+	"   -m, --manifest <filename>  Manifest with the input files\n"
+	"   -r, --template <template>  Raw output template of the input files\n"
+	"   -d, --devtime <timestamp>  Device time\n"
+	"   -s, --systime <timestamp>  System time\n"
+	"   -S, --serial <number>      Serial number\n"
+	"   -j, --jobs <count>         Number of worker threads\n"
+	"   -u, --update               Add only the new dives to the index\n"
+	"   -q, --query <filename>     Index file to search\n"
+	"   -b, --begin <timestamp>    First dive time\n"
+	"   -e, --end <timestamp>      Last dive time\n"
+	"   -p, --fingerprint <data>   Fingerprint data (hexadecimal)\n"
+	"   -l, --list                 List the dives instead of a manifest\n"
+#else
+	"   -h              Show help message\n"
+	"   -o <filename>   Index file to create\n"
+	"   -m <filename>   Manifest with the input files\n"
+	"   -r <template>   Raw output template of the input files\n"
+	"   -d <devtime>    Device time\n"
+	"   -s <systime>    System time\n"
+	"   -S <serial>     Serial number\n"
+	"   -j <count>      Number of worker threads\n"
+	"   -u              Add only the new dives to the index\n"
+	"   -q <filename>   Index file to search\n"
+	"   -b <timestamp>  First dive time\n"
+	"   -e <timestamp>  Last dive time\n"
+	"   -p <data>       Fingerprint data (hexadecimal)\n"
+	"   -l              List the dives instead of a manifest\n"
+#endif
+	"\n"
+	"The index contains the header summary of every dive, sorted on the\n"
+	"dive time, and is searched without parsing the dives again. The\n"
+	"manifest has the format of the parse command. With the template of\n"
+	"the raw output (e.g. dive_%n_%f.bin), the fingerprint is recovered\n"
+	"from the filenames. The query prints a manifest of the matching\n"
+	"dives, for the parse command. The timestamps have the format\n"
+	"YYYYMMDD or YYYYMMDDThhmmss. With a device or a serial number, only\n"
+	"the dives of that device are printed.\n"
+};
@@ -35,19 +35,23 @@
 #include <libdivecomputer/iterator.h>
 
 #include "dctool.h"
+#include "common.h"
+#include "utils.h"
 
 static int
 dctool_list_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *dummy)
 {
 	// Default option values.
 	unsigned int help = 0;
+	dc_transport_t transport = DC_TRANSPORT_NONE;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "h";
+	const char *optstring = "ht:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
+		{"transport",   required_argument, 0, 't'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -58,6 +62,13 @@ dctool_list_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'h':
 			help = 1;
 			break;
+		case 't':
+			transport = dctool_transport_type (optarg);
+			if (transport == DC_TRANSPORT_NONE) {
+				message ("Unknown transport '%s'.\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -74,7 +85,10 @@ dctool_list_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 
 	dc_iterator_t *iterator = NULL;
 	dc_descriptor_t *descriptor = NULL;
-	dc_descriptor_iterator (&iterator);
+	if (transport != DC_TRANSPORT_NONE)
+		dc_descriptor_iterator_transport (&iterator, transport);
+	else
+		dc_descriptor_iterator (&iterator);
 	while (dc_iterator_next (iterator, &descriptor) == DC_STATUS_SUCCESS) {
 		printf ("%s %s\n",
 			dc_descriptor_get_vendor (descriptor),
@@ -96,8 +110,10 @@ const dctool_command_t dctool_list = {
 	"\n"
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
-	"   -h, --help   Show help message\n"
+	"   -h, --help                 Show help message\n"
+	"   -t, --transport <name>     Only devices with this transport\n"
 #else
-	"   -h   Show help message\n"
+	"   -h              Show help message\n"
+	"   -t <name>       Only devices with this transport\n"
 #endif
 };
@@ -42,6 +42,20 @@
 
 #define REACTPROWHITE 0x4354
 
+#define BATCH_SIZE 256
+
+typedef struct batch_item_t {
+	char *filename;
+	dc_buffer_t *buffer;
+	dc_descriptor_t *descriptor;
+	FILE *fragment;
+} batch_item_t;
+
+typedef struct batch_data_t {
+	dctool_output_t *output;
+	unsigned int nerrors;
+} batch_data_t;
+
 static dc_status_t
 parse (dc_buffer_t *buffer, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dctool_output_t *output)
 {
@@ -79,6 +93,154 @@ cleanup:
 	return rc;
 }
 
+static dc_status_t
+batch_parse (dc_parser_t *parser, const dc_parser_job_t *job, void *userdata)
+{
+	batch_data_t *data = (batch_data_t *) userdata;
+	batch_item_t *item = (batch_item_t *) job->userdata;
+
+	// Only render the dive here. The fragments are appended to the output
+	// in the original order.
+	return dctool_output_render (data->output, &item->fragment, parser, job->data, job->size, NULL, 0);
+}
+
+static void
+batch_done (const dc_parser_job_t *job, dc_status_t status, void *userdata)
+{
+	batch_data_t *data = (batch_data_t *) userdata;
+	batch_item_t *item = (batch_item_t *) job->userdata;
+
+	if (status == DC_STATUS_SUCCESS) {
+		status = dctool_output_append (data->output, item->fragment);
+		item->fragment = NULL;
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s: %s\n", item->filename, dctool_errmsg (status));
+		data->nerrors++;
+	}
+}
+
+static int
+batch_run (dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, const char *manifest, int argc, char *argv[], unsigned int nthreads, dctool_output_t *output)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parser_batch_t *batch = NULL;
+	FILE *fp = NULL;
+	batch_item_t items[BATCH_SIZE];
+	dc_parser_job_t jobs[BATCH_SIZE];
+	batch_data_t data = {output, 0};
+	int i = 0, eof = 0;
+
+	if (manifest) {
+		fp = fopen (manifest, "r");
+		if (fp == NULL) {
+			message ("Failed to open the manifest file.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Create the parser batch. The parsers are reused for all the dives
+	// of the same model and clock.
+	status = dc_parser_batch_new (&batch, context, nthreads);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	while (!eof) {
+		unsigned int count = 0;
+
+		// Read the next set of input files.
+		while (count < BATCH_SIZE) {
+			char line[1024];
+			char *filename = NULL, *device = NULL;
+			unsigned int dt = devtime;
+			dc_ticks_t st = systime;
+
+			if (fp) {
+				if (fgets (line, sizeof (line), fp) == NULL) {
+					eof = 1;
+					break;
+				}
+				if (!dctool_manifest_line (line, &filename, &dt, &st, &device))
+					continue;
+			} else {
+				if (i >= argc) {
+					eof = 1;
+					break;
+				}
+				filename = argv[i++];
+			}
+
+			batch_item_t *item = items + count;
+			item->filename = NULL;
+			item->buffer = NULL;
+			item->descriptor = NULL;
+			item->fragment = NULL;
+
+			if (device) {
+				status = dctool_descriptor_search (&item->descriptor, device, DC_FAMILY_NULL, 0);
+				if (status != DC_STATUS_SUCCESS || item->descriptor == NULL) {
+					message ("ERROR: %s: Unknown device '%s'.\n", filename, device);
+					data.nerrors++;
+					continue;
+				}
+			}
+
+			item->buffer = dctool_file_read (filename);
+			if (item->buffer == NULL) {
+				message ("ERROR: %s: Failed to open the input file.\n", filename);
+				dc_descriptor_free (item->descriptor);
+				data.nerrors++;
+				continue;
+			}
+
+			item->filename = strdup (filename);
+
+			dc_parser_job_t *job = jobs + count;
+			job->descriptor = item->descriptor ? item->descriptor : descriptor;
+			job->devtime = dt;
+			job->systime = st;
+			job->data = dc_buffer_get_data (item->buffer);
+			job->size = dc_buffer_get_size (item->buffer);
+			job->userdata = item;
+
+			count++;
+		}
+
+		// Parse the dives.
+		status = dc_parser_batch_run (batch, jobs, count, batch_parse, batch_done, &data);
+
+		for (unsigned int j = 0; j < count; ++j) {
+			if (items[j].fragment)
+				fclose (items[j].fragment);
+			dc_descriptor_free (items[j].descriptor);
+			dc_buffer_free (items[j].buffer);
+			free (items[j].filename);
+		}
+
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	if (data.nerrors) {
+		message ("Failed to parse %u dive(s).\n", data.nerrors);
+		exitcode = EXIT_FAILURE;
+	}
+
+cleanup:
+	dc_parser_batch_free (batch);
+	if (fp)
+		fclose (fp);
+	return exitcode;
+}
+
 static int
 dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
 {
@@ -92,19 +254,26 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	// Default option values.
 	unsigned int help = 0;
 	const char *filename = NULL;
+	const char *format = "xml";
 	unsigned int devtime = 0;
 	dc_ticks_t systime = 0;
+	const char *manifest = NULL;
+	unsigned int nthreads = 0;
+	unsigned int batch = 0;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ho:d:s:u:";
+	const char *optstring = "ho:f:d:s:u:m:j:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
 		{"output",      required_argument, 0, 'o'},
+		{"format",      required_argument, 0, 'f'},
 		{"devtime",     required_argument, 0, 'd'},
 		{"systime",     required_argument, 0, 's'},
 		{"units",       required_argument, 0, 'u'},
+		{"manifest",    required_argument, 0, 'm'},
+		{"jobs",        required_argument, 0, 'j'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -118,6 +287,9 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'o':
 			filename = optarg;
 			break;
+		case 'f':
+			format = optarg;
+			break;
 		case 'd':
 			devtime = strtoul (optarg, NULL, 0);
 			break;
@@ -130,6 +302,14 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 			if (strcmp (optarg, "imperial") == 0)
 				units = DCTOOL_UNITS_IMPERIAL;
 			break;
+		case 'm':
+			manifest = optarg;
+			batch = 1;
+			break;
+		case 'j':
+			nthreads = strtoul (optarg, NULL, 0);
+			batch = 1;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -145,13 +325,29 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	}
 
 	// Create the output.
-	output = dctool_xml_output_new (filename, units);
+	if (strcasecmp(format, "xml") == 0) {
+		output = dctool_xml_output_new (filename, units);
+	} else if (strcasecmp(format, "json") == 0) {
+		output = dctool_json_output_new (filename, units);
+	} else if (strcasecmp(format, "columns") == 0) {
+		output = dctool_columns_output_new (filename, units);
+	} else {
+		message ("Unknown output format: %s\n", format);
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
 	if (output == NULL) {
 		message ("Failed to create the output.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
+	// Parse all dives with a parser batch.
+	if (batch) {
+		exitcode = batch_run (context, descriptor, devtime, systime, manifest, argc, argv, nthreads, output);
+		goto cleanup;
+	}
+
 	for (unsigned int i = 0; i < argc; ++i) {
 		// Read the input file.
 		buffer = dctool_file_read (argv[i]);
@@ -186,20 +382,33 @@ const dctool_command_t dctool_parse = {
 	"parse",
 	"Parse previously downloaded dives",
 	"Usage:\n"
-	"   dctool parse [options] <filename>\n"
+	"   dctool parse [options] <filename>...\n"
+	"   dctool parse [options] --manifest <filename>\n"
 	"\n"
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
 	"   -h, --help                 Show help message\n"
 	"   -o, --output <filename>    Output filename\n"
+	"   -f, --format <format>      Output format (xml, json or columns)\n"
 	"   -d, --devtime <timestamp>  Device time\n"
 	"   -s, --systime <timestamp>  System time\n"
 	"   -u, --units <units>        Set units (metric or imperial)\n"
+	"   -m, --manifest <filename>  Manifest with the input files\n"
+	"   -j, --jobs <count>         Number of worker threads\n"
 #else
 	"   -h              Show help message\n"
 	"   -o <filename>   Output filename\n"
+	"   -f <format>     Output format (xml, json or columns)\n"
 	"   -d <devtime>    Device time\n"
 	"   -s <systime>    System time\n"
 	"   -u <units>      Set units (metric or imperial)\n"
+	"   -m <filename>   Manifest with the input files\n"
+	"   -j <count>      Number of worker threads\n"
 #endif
+	"\n"
+	"With a manifest or worker threads, the dives are parsed in batch mode,\n"
+	"and the failed dives are skipped. Each line of the manifest contains\n"
+	"the input filename, optionally followed by the device time, the system\n"
+	"time and the device name. Empty lines and lines starting with # are\n"
+	"ignored.\n"
 };
@@ -0,0 +1,369 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/parser.h>
+
+#include "dctool.h"
+#include "common.h"
+#include "utils.h"
+
+/*
+ * The corpus is a directory with the raw dive data, and an index file
+ * (corpus.txt) with one line per dive:
+ *
+ *     <family> <model> <devtime> <systime> <filename>
+ *
+ * The family is the name used by the --family option, and the filename
+ * is relative to the corpus directory. Empty lines and lines starting
+ * with a '#' are ignored.
+ */
+
+#define INDEX "corpus.txt"
+#define MAXLINE 1024
+
+typedef struct family_stats_t {
+	dc_family_t family;
+	unsigned int ndives;
+	unsigned int nerrors;
+	unsigned long long nbytes;
+	unsigned long long nsamples;
+	double elapsed;
+} family_stats_t;
+
+typedef struct parsebench_t {
+	family_stats_t *stats;
+	size_t count, capacity;
+} parsebench_t;
+
+static family_stats_t *
+parsebench_stats (parsebench_t *bench, dc_family_t family)
+{
+	for (size_t i = 0; i < bench->count; ++i) {
+		if (bench->stats[i].family == family)
+			return bench->stats + i;
+	}
+
+	if (bench->count == bench->capacity) {
+		size_t capacity = bench->capacity ? bench->capacity * 2 : 16;
+		family_stats_t *stats = (family_stats_t *) realloc (bench->stats, capacity * sizeof (family_stats_t));
+		if (stats == NULL)
+			return NULL;
+		bench->stats = stats;
+		bench->capacity = capacity;
+	}
+
+	family_stats_t *stats = bench->stats + bench->count++;
+	memset (stats, 0, sizeof (family_stats_t));
+	stats->family = family;
+
+	return stats;
+}
+
+static void
+parsebench_sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	unsigned long long *nsamples = (unsigned long long *) userdata;
+
+	if (type == DC_SAMPLE_TIME)
+		(*nsamples)++;
+}
+
+static dc_status_t
+parsebench_dive (dc_parser_t *parser, const unsigned char data[], unsigned int size, unsigned long long *nsamples)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_datetime_t datetime = {0};
+	unsigned int divetime = 0, ngasmixes = 0;
+	double maxdepth = 0.0, avgdepth = 0.0, temperature = 0.0;
+
+	rc = dc_parser_set_data (parser, data, size);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// The fields are optional, so the result is ignored.
+	dc_parser_get_datetime (parser, &datetime);
+	dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &divetime);
+	dc_parser_get_field (parser, DC_FIELD_MAXDEPTH, 0, &maxdepth);
+	dc_parser_get_field (parser, DC_FIELD_AVGDEPTH, 0, &avgdepth);
+	dc_parser_get_field (parser, DC_FIELD_GASMIX_COUNT, 0, &ngasmixes);
+	dc_parser_get_field (parser, DC_FIELD_TEMPERATURE_MINIMUM, 0, &temperature);
+
+	return dc_parser_samples_foreach (parser, parsebench_sample_cb, nsamples);
+}
+
+static dc_status_t
+parsebench_entry (parsebench_t *bench, dc_context_t *context, const char *dirname, const char *line, unsigned int iterations)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_descriptor_t *descriptor = NULL;
+	dc_parser_t *parser = NULL;
+	dc_buffer_t *buffer = NULL;
+
+	char family[64], model[32], devtime[32], systime[32], filename[MAXLINE];
+	if (sscanf (line, "%63s %31s %31s %31s %1023s", family, model, devtime, systime, filename) != 5) {
+		message ("Invalid corpus entry: %s", line);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	// Lookup the descriptor.
+	dc_family_t type = dctool_family_type (family);
+	if (type != DC_FAMILY_NULL)
+		rc = dctool_descriptor_search (&descriptor, NULL, type, strtoul (model, NULL, 0));
+	if (rc != DC_STATUS_SUCCESS || descriptor == NULL) {
+		message ("No dive computer found for %s %s.\n", family, model);
+		rc = DC_STATUS_UNSUPPORTED;
+		goto cleanup;
+	}
+
+	// Load the dive data.
+	char path[2 * MAXLINE];
+	snprintf (path, sizeof (path), "%s/%s", dirname, filename);
+	buffer = dctool_file_read (path);
+	if (buffer == NULL) {
+		message ("Failed to read the dive data (%s).\n", path);
+		rc = DC_STATUS_IO;
+		goto cleanup;
+	}
+
+	const unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned int size = dc_buffer_get_size (buffer);
+
+	family_stats_t *stats = parsebench_stats (bench, type);
+	if (stats == NULL) {
+		message ("Failed to allocate memory.\n");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	rc = dc_parser_new2 (&parser, context, descriptor, strtoul (devtime, NULL, 0), strtoll (systime, NULL, 0));
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error creating the parser.");
+		goto cleanup;
+	}
+
+	// Parse once, to count the samples and detect broken dives.
+	unsigned long long nsamples = 0;
+	rc = parsebench_dive (parser, data, size, &nsamples);
+	if (rc != DC_STATUS_SUCCESS) {
+		message ("Failed to parse the dive data (%s): %s\n", path, dctool_errmsg (rc));
+		stats->nerrors++;
+		rc = DC_STATUS_SUCCESS;
+		goto cleanup;
+	}
+
+	unsigned long long dummy = 0;
+	double begin = dctool_time ();
+	for (unsigned int i = 0; i < iterations; ++i) {
+		parsebench_dive (parser, data, size, &dummy);
+	}
+	stats->elapsed += dctool_time () - begin;
+
+	stats->ndives++;
+	stats->nbytes += (unsigned long long) size * iterations;
+	stats->nsamples += nsamples * iterations;
+
+cleanup:
+	dc_parser_destroy (parser);
+	dc_buffer_free (buffer);
+	dc_descriptor_free (descriptor);
+	return rc;
+}
+
+static dc_status_t
+parsebench (dc_context_t *context, const char *dirname, unsigned int iterations, FILE *fp)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	parsebench_t bench = {NULL, 0, 0};
+
+	char filename[MAXLINE + sizeof (INDEX) + 1];
+	snprintf (filename, sizeof (filename), "%s/%s", dirname, INDEX);
+
+	FILE *index = fopen (filename, "r");
+	if (index == NULL) {
+		message ("Failed to open the corpus index (%s).\n", filename);
+		return DC_STATUS_IO;
+	}
+
+	char line[MAXLINE];
+	while (fgets (line, sizeof (line), index)) {
+		const char *p = line;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == 0)
+			continue;
+
+		rc = parsebench_entry (&bench, context, dirname, p, iterations);
+		if (rc == DC_STATUS_NOMEMORY)
+			break;
+		rc = DC_STATUS_SUCCESS;
+	}
+
+	fclose (index);
+
+	if (rc != DC_STATUS_SUCCESS)
+		goto cleanup;
+
+	fprintf (fp, "{\n");
+	fprintf (fp, "  \"iterations\": %u,\n", iterations);
+	fprintf (fp, "  \"families\": [");
+	for (size_t i = 0; i < bench.count; ++i) {
+		const family_stats_t *stats = bench.stats + i;
+		const char *name = dctool_family_name (stats->family);
+		fprintf (fp, "%s\n    {\n", i ? "," : "");
+		fprintf (fp, "      \"family\": \"%s\",\n", name ? name : "unknown");
+		fprintf (fp, "      \"dives\": %u,\n", stats->ndives);
+		fprintf (fp, "      \"errors\": %u,\n", stats->nerrors);
+		fprintf (fp, "      \"bytes\": %llu,\n", stats->nbytes);
+		fprintf (fp, "      \"samples\": %llu,\n", stats->nsamples);
+		fprintf (fp, "      \"time\": %.6f,\n", stats->elapsed);
+		fprintf (fp, "      \"ns_per_sample\": %.1f,\n",
+			stats->nsamples ? stats->elapsed * 1e9 / stats->nsamples : 0.0);
+		fprintf (fp, "      \"mb_per_s\": %.3f\n",
+			stats->elapsed > 0.0 ? stats->nbytes / stats->elapsed / 1e6 : 0.0);
+		fprintf (fp, "    }");
+	}
+	fprintf (fp, "\n  ]\n");
+	fprintf (fp, "}\n");
+
+cleanup:
+	free (bench.stats);
+	return rc;
+}
+
+static int
+dctool_parsebench_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	FILE *fp = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	const char *filename = NULL;
+	unsigned int iterations = 100;
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "ho:n:";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"output",      required_argument, 0, 'o'},
+		{"iterations",  required_argument, 0, 'n'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 'o':
+			filename = optarg;
+			break;
+		case 'n':
+			iterations = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		dctool_command_showhelp (&dctool_parsebench);
+		return EXIT_SUCCESS;
+	}
+
+	if (argc < 1) {
+		message ("No corpus directory specified.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Open the output file.
+	if (filename) {
+		fp = fopen (filename, "w");
+		if (fp == NULL) {
+			message ("Failed to open the output file.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	// Run the benchmark.
+	status = parsebench (context, argv[0], iterations, fp ? fp : stdout);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+cleanup:
+	if (fp)
+		fclose (fp);
+	return exitcode;
+}
+
+const dctool_command_t dctool_parsebench = {
+	dctool_parsebench_run,
+	DCTOOL_CONFIG_NONE,
+	"parsebench",
+	"Benchmark the parsing of a corpus of dives",
+	"Usage:\n"
+	"   dctool parsebench [options] <directory>\n"
+	"\n"
+	"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+	"   -h, --help                 Show help message\n"
+	"   -o, --output <filename>    Output filename\n"
+	"   -n, --iterations <count>   Number of iterations per dive\n"
+#else
+	"   -h              Show help message\n"
+	"   -o <filename>   Output filename\n"
+	"   -n <count>      Number of iterations per dive\n"
+#endif
+	"\n"
+	"The directory contains the raw dive data, and an index file\n"
+	"(" INDEX ") with one line per dive:\n"
+	"\n"
+	"   <family> <model> <devtime> <systime> <filename>\n"
+	"\n"
+	"The results are written in JSON format, per backend family.\n"
+};
@@ -39,11 +39,12 @@
 #include "utils.h"
 
 static dc_status_t
-doread (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, unsigned int address, dc_buffer_t *buffer)
+doread (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, const dctool_range_t ranges[], unsigned int nranges, unsigned int base, dc_buffer_t *buffer)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_iostream_t *iostream = NULL;
 	dc_device_t *device = NULL;
+	dc_device_range_t *vector = NULL;
 
 	// Open the I/O stream.
 	message ("Opening the I/O stream (%s, %s).\n",
@@ -82,15 +83,30 @@ doread (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t trans
 		goto cleanup;
 	}
 
-	// Read data from the internal memory.
-	message ("Reading data from the internal memory.\n");
-	rc = dc_device_read (device, address, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
+	// Read data from the internal memory. All ranges are read with a
+	// single vectored read, at their offset from the base address.
+	vector = (dc_device_range_t *) malloc (nranges * sizeof (dc_device_range_t));
+	if (vector == NULL) {
+		ERROR ("Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < nranges; ++i) {
+		vector[i].address = ranges[i].address;
+		vector[i].size = ranges[i].count;
+		vector[i].data = dc_buffer_get_data (buffer) + (ranges[i].address - base);
+	}
+
+	message ("Reading data from the internal memory (%u ranges).\n", nranges);
+	rc = dc_device_read_multi (device, vector, nranges);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error reading from the internal memory.");
 		goto cleanup;
 	}
 
 cleanup:
+	free (vector);
 	dc_device_close (device);
 	dc_iostream_close (iostream);
 	return rc;
@@ -102,17 +118,19 @@ dctool_read_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	int exitcode = EXIT_SUCCESS;
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_buffer_t *buffer = NULL;
+	dctool_range_t *ranges = NULL;
 	dc_transport_t transport = dctool_transport_default (descriptor);
 
 	// Default option values.
 	unsigned int help = 0;
 	const char *filename = NULL;
+	const char *rangefile = NULL;
 	unsigned int address = 0, have_address = 0;
 	unsigned int count = 0, have_count = 0;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:a:c:o:";
+	const char *optstring = "ht:a:c:o:r:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
@@ -120,6 +138,7 @@ dctool_read_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		{"address",     required_argument, 0, 'a'},
 		{"count",       required_argument, 0, 'c'},
 		{"output",      required_argument, 0, 'o'},
+		{"ranges",      required_argument, 0, 'r'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -144,6 +163,9 @@ dctool_read_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'o':
 			filename = optarg;
 			break;
+		case 'r':
+			rangefile = optarg;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -165,8 +187,28 @@ dctool_read_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		goto cleanup;
 	}
 
-	// Check mandatory arguments.
-	if (!have_address || !have_count) {
+	// Read the list of memory ranges, or use the single range.
+	dctool_range_t single = {address, count};
+	unsigned int nranges = 1, base = address;
+	if (rangefile) {
+		status = dctool_ranges_read (rangefile, &ranges, &nranges);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("Failed to read the memory ranges.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		if (nranges == 0) {
+			message ("No memory ranges specified.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		// The output is an image of the memory, up to the end of the
+		// last range.
+		base = 0;
+		count = ranges[nranges - 1].address + ranges[nranges - 1].count;
+	} else if (!have_address || !have_count) {
 		message ("No memory address or byte count specified.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
@@ -174,15 +216,14 @@ dctool_read_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 
 	// Allocate a memory buffer.
 	buffer = dc_buffer_new (count);
-	dc_buffer_resize (buffer, count);
-	if (buffer == NULL) {
+	if (buffer == NULL || !dc_buffer_resize (buffer, count)) {
 		message ("Failed to allocate a memory buffer.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
 	// Read data from the internal memory.
-	status = doread (context, descriptor, transport, argv[0], address, buffer);
+	status = doread (context, descriptor, transport, argv[0], ranges ? ranges : &single, nranges, base, buffer);
 	if (status != DC_STATUS_SUCCESS) {
 		message ("ERROR: %s\n", dctool_errmsg (status));
 		exitcode = EXIT_FAILURE;
@@ -193,6 +234,7 @@ dctool_read_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	dctool_file_write (filename, buffer);
 
 cleanup:
+	free (ranges);
 	dc_buffer_free (buffer);
 	return exitcode;
 }
@@ -212,11 +254,18 @@ const dctool_command_t dctool_read = {
 	"   -a, --address <address>    Memory address\n"
 	"   -c, --count <count>        Number of bytes\n"
 	"   -o, --output <filename>    Output filename\n"
+	"   -r, --ranges <filename>    Memory ranges\n"
 #else
 	"   -h              Show help message\n"
 	"   -t <transport>  Transport type\n"
 	"   -a <address>    Memory address\n"
 	"   -c <count>      Number of bytes\n"
 	"   -o <filename>   Output filename\n"
+	"   -r <filename>   Memory ranges\n"
 #endif
+	"\n"
+	"The memory ranges file contains an address and a number of bytes per\n"
+	"line. All ranges are read over a single connection, and the output is\n"
+	"an image of the memory, with every range at its own address. The\n"
+	"bytes outside the ranges are zero.\n"
 };
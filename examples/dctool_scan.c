@@ -32,6 +32,7 @@
 
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/discovery.h>
 #include <libdivecomputer/iterator.h>
 #include <libdivecomputer/serial.h>
 #include <libdivecomputer/irda.h>
@@ -43,6 +44,76 @@
 #include "common.h"
 #include "utils.h"
 
+static void
+device_print (dc_transport_t transport, void *device)
+{
+	char buffer[DC_BLUETOOTH_SIZE];
+
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		printf ("%s", dc_serial_device_get_name (device));
+		dc_serial_device_free (device);
+		break;
+	case DC_TRANSPORT_IRDA:
+		printf ("%08x\t%s", dc_irda_device_get_address (device), dc_irda_device_get_name (device));
+		dc_irda_device_free (device);
+		break;
+	case DC_TRANSPORT_BLUETOOTH:
+		printf ("%s\t%s",
+			dc_bluetooth_addr2str(dc_bluetooth_device_get_address (device), buffer, sizeof(buffer)),
+			dc_bluetooth_device_get_name (device));
+		dc_bluetooth_device_free (device);
+		break;
+	case DC_TRANSPORT_USB:
+		printf ("%04x:%04x", dc_usb_device_get_vid (device), dc_usb_device_get_pid (device));
+		dc_usb_device_free (device);
+		break;
+	case DC_TRANSPORT_USBHID:
+		printf ("%04x:%04x", dc_usbhid_device_get_vid (device), dc_usbhid_device_get_pid (device));
+		dc_usbhid_device_free (device);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+discovery_cb (dc_transport_t transport, void *device, dc_descriptor_t *descriptor, void *userdata)
+{
+	printf ("%s\t", dctool_transport_name (transport));
+	device_print (transport, device);
+	if (descriptor) {
+		printf ("\t%s %s", dc_descriptor_get_vendor (descriptor), dc_descriptor_get_product (descriptor));
+		dc_descriptor_free (descriptor);
+	}
+	printf ("\n");
+	fflush (stdout);
+}
+
+static dc_status_t
+discover (dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_discovery_t *discovery = NULL;
+
+	// Scan all transports at the same time.
+	status = dc_discovery_new (&discovery, context, descriptor, dc_context_get_transports (context), discovery_cb, NULL);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to start the device discovery.");
+		goto cleanup;
+	}
+
+	status = dc_discovery_wait (discovery);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to discover the devices.");
+		goto cleanup;
+	}
+
+cleanup:
+	dc_discovery_free (discovery);
+	return status;
+}
+
 static dc_status_t
 scan (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport)
 {
@@ -78,33 +149,8 @@ scan (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 	// Enumerate the devices.
 	void *device = NULL;
 	while ((status = dc_iterator_next (iterator, &device)) == DC_STATUS_SUCCESS) {
-		char buffer[DC_BLUETOOTH_SIZE];
-		switch (transport) {
-		case DC_TRANSPORT_SERIAL:
-			printf ("%s\n", dc_serial_device_get_name (device));
-			dc_serial_device_free (device);
-			break;
-		case DC_TRANSPORT_IRDA:
-			printf ("%08x\t%s\n", dc_irda_device_get_address (device), dc_irda_device_get_name (device));
-			dc_irda_device_free (device);
-			break;
-		case DC_TRANSPORT_BLUETOOTH:
-			printf ("%s\t%s\n",
-				dc_bluetooth_addr2str(dc_bluetooth_device_get_address (device), buffer, sizeof(buffer)),
-				dc_bluetooth_device_get_name (device));
-			dc_bluetooth_device_free (device);
-			break;
-		case DC_TRANSPORT_USB:
-			printf ("%04x:%04x\n", dc_usb_device_get_vid (device), dc_usb_device_get_pid (device));
-			dc_usb_device_free (device);
-			break;
-		case DC_TRANSPORT_USBHID:
-			printf ("%04x:%04x\n", dc_usbhid_device_get_vid (device), dc_usbhid_device_get_pid (device));
-			dc_usbhid_device_free (device);
-			break;
-		default:
-			break;
-		}
+		device_print (transport, device);
+		printf ("\n");
 	}
 	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_DONE) {
 		ERROR ("Failed to enumerate the devices.");
@@ -126,14 +172,16 @@ dctool_scan_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 
 	// Default option values.
 	unsigned int help = 0;
+	unsigned int all = 0;
 	dc_transport_t transport = dctool_transport_default (descriptor);
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:";
+	const char *optstring = "hat:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
+		{"all",         no_argument,       0, 'a'},
 		{"transport",   required_argument, 0, 't'},
 		{0,             0,                 0,  0 }
 	};
@@ -145,6 +193,9 @@ dctool_scan_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'h':
 			help = 1;
 			break;
+		case 'a':
+			all = 1;
+			break;
 		case 't':
 			transport = dctool_transport_type (optarg);
 			break;
@@ -162,6 +213,16 @@ dctool_scan_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		return EXIT_SUCCESS;
 	}
 
+	// Scan all transports.
+	if (all) {
+		status = discover (context, descriptor);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+		}
+		goto cleanup;
+	}
+
 	// Check the transport type.
 	if (transport == DC_TRANSPORT_NONE) {
 		message ("No valid transport type specified.\n");
@@ -192,9 +253,11 @@ const dctool_command_t dctool_scan = {
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
 	"   -h, --help               Show help message\n"
+	"   -a, --all                Scan all transports at the same time\n"
 	"   -t, --transport <name>   Transport type\n"
 #else
 	"   -h               Show help message\n"
+	"   -a               Scan all transports at the same time\n"
 	"   -t <transport>   Transport type\n"
 #endif
 };
@@ -0,0 +1,233 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/device.h>
+
+#include "dctool.h"
+#include "common.h"
+#include "simulator.h"
+#include "utils.h"
+
+static int
+simulate_dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	unsigned int *ndives = (unsigned int *) userdata;
+
+	(*ndives)++;
+
+	return 1;
+}
+
+static dc_status_t
+simulate (dc_context_t *context, dc_descriptor_t *descriptor, dctool_simulator_t *simulator)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_iostream_t *iostream = NULL;
+	dc_device_t *device = NULL;
+	unsigned int ndives = 0;
+
+	// Open the I/O stream.
+	rc = dctool_simulator_open (&iostream, context, simulator);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the I/O stream.");
+		goto cleanup;
+	}
+
+	clock_t start = clock ();
+
+	// Open the device.
+	message ("Opening the device (%s %s).\n",
+		dc_descriptor_get_vendor (descriptor),
+		dc_descriptor_get_product (descriptor));
+	rc = dc_device_open (&device, context, descriptor, iostream);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the device.");
+		goto cleanup;
+	}
+
+	// Download the dives.
+	message ("Downloading the dives.\n");
+	rc = dc_device_foreach (device, simulate_dive_cb, &ndives);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error downloading the dives.");
+	}
+
+	double cputime = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+	dctool_simulator_stats_t simstats;
+	dctool_simulator_get_stats (simulator, &simstats);
+
+	dc_iostream_stats_t iostats;
+	dc_iostream_get_stats (iostream, &iostats);
+
+	unsigned long long nbytes = iostats.bytes_in + iostats.bytes_out;
+	double linktime = simstats.clock / 1000000.0;
+
+	message ("Dives: %u\n", ndives);
+	message ("Commands: %u (%u errors injected)\n", simstats.commands, simstats.injected);
+	message ("Transferred: %llu bytes\n", nbytes);
+	message ("Simulated time: %.3f s (%.0f bytes/s)\n", linktime,
+		linktime > 0.0 ? nbytes / linktime : 0.0);
+	message ("CPU time: %.3f s\n", cputime);
+
+cleanup:
+	dc_device_close (device);
+	dc_iostream_close (iostream);
+	return rc;
+}
+
+static int
+dctool_simulate_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_buffer_t *image = NULL;
+	dctool_simulator_t *simulator = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	dctool_simulator_params_t params = {NULL, 0, 0, 0.0, 1};
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "hv:l:b:e:s:";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"version",     required_argument, 0, 'v'},
+		{"latency",     required_argument, 0, 'l'},
+		{"bandwidth",   required_argument, 0, 'b'},
+		{"errors",      required_argument, 0, 'e'},
+		{"seed",        required_argument, 0, 's'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 'v':
+			params.version = optarg;
+			break;
+		case 'l':
+			params.latency = strtoul (optarg, NULL, 0);
+			break;
+		case 'b':
+			params.bandwidth = strtoul (optarg, NULL, 0);
+			break;
+		case 'e':
+			params.errors = strtod (optarg, NULL);
+			break;
+		case 's':
+			params.seed = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		dctool_command_showhelp (&dctool_simulate);
+		return EXIT_SUCCESS;
+	}
+
+	// Load the memory image.
+	if (argc < 1 || (image = dctool_file_read (argv[0])) == NULL) {
+		message ("No valid memory image specified.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Create the simulator.
+	status = dctool_simulator_new (&simulator, descriptor, image, &params);
+	if (status != DC_STATUS_SUCCESS) {
+		if (status == DC_STATUS_UNSUPPORTED)
+			message ("No simulator available for this dive computer.\n");
+		else
+			message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Download the dives from the simulator.
+	status = simulate (context, descriptor, simulator);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+cleanup:
+	dctool_simulator_free (simulator);
+	dc_buffer_free (image);
+	return exitcode;
+}
+
+const dctool_command_t dctool_simulate = {
+	dctool_simulate_run,
+	DCTOOL_CONFIG_DESCRIPTOR,
+	"simulate",
+	"Download the dives from a simulated device",
+	"Usage:\n"
+	"   dctool simulate [options] <image>\n"
+	"\n"
+	"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+	"   -h, --help                Show help message\n"
+	"   -v, --version <string>    Version string of the device\n"
+	"   -l, --latency <ms>        Round-trip latency per packet\n"
+	"   -b, --bandwidth <bytes>   Bandwidth in bytes per second\n"
+	"   -e, --errors <rate>       Fraction of corrupted or lost packets\n"
+	"   -s, --seed <number>       Seed for the error injection\n"
+#else
+	"   -h              Show help message\n"
+	"   -v <string>     Version string of the device\n"
+	"   -l <ms>         Round-trip latency per packet\n"
+	"   -b <bytes>      Bandwidth in bytes per second\n"
+	"   -e <rate>       Fraction of corrupted or lost packets\n"
+	"   -s <number>     Seed for the error injection\n"
+#endif
+	"\n"
+	"The image is a memory dump of the device. Supported are:\n"
+	"   oceanic_atom2\n"
+};
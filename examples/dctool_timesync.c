@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 #ifdef HAVE_GETOPT_H
 #include <getopt.h>
 #endif
@@ -33,6 +34,7 @@
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/descriptor.h>
 #include <libdivecomputer/device.h>
+#include <libdivecomputer/discovery.h>
 
 #include "dctool.h"
 #include "common.h"
@@ -96,6 +98,219 @@ cleanup:
 	return rc;
 }
 
+typedef struct batch_item_t {
+	struct batch_item_t *next;
+	dc_transport_t transport;
+	char address[64];
+	void *object;
+	dc_iostream_t *iostream;
+	dc_device_t *device;
+	dc_event_devinfo_t devinfo;
+	dc_event_clock_t clock;
+	int have_clock;
+	double latency;
+	dc_status_t status;
+} batch_item_t;
+
+typedef struct batch_data_t {
+	batch_item_t *head;
+	batch_item_t **tail;
+	/* The reference clock, shared by all devices. */
+	dc_ticks_t reference;
+	double start;
+} batch_data_t;
+
+static void
+batch_discovery_cb (dc_transport_t transport, void *device, dc_descriptor_t *descriptor, void *userdata)
+{
+	batch_data_t *data = (batch_data_t *) userdata;
+
+	batch_item_t *item = (batch_item_t *) malloc (sizeof (batch_item_t));
+	if (item == NULL) {
+		ERROR ("Failed to allocate memory.");
+		dctool_device_free (transport, device);
+		return;
+	}
+
+	memset (item, 0, sizeof (batch_item_t));
+	item->transport = transport;
+	item->object = device;
+	item->status = DC_STATUS_SUCCESS;
+	dctool_device_address (transport, device, item->address, sizeof (item->address));
+
+	*data->tail = item;
+	data->tail = &item->next;
+}
+
+static void
+batch_event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata)
+{
+	batch_item_t *item = (batch_item_t *) userdata;
+
+	switch (event) {
+	case DC_EVENT_DEVINFO:
+		item->devinfo = *(const dc_event_devinfo_t *) data;
+		break;
+	case DC_EVENT_CLOCK:
+		item->clock = *(const dc_event_clock_t *) data;
+		item->have_clock = 1;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Synchronize the device clock to the reference clock, advanced with the
+ * time elapsed since the start of the batch. The latency of the command
+ * is the upper bound for the remaining difference between the devices.
+ */
+static dc_status_t
+batch_timesync (dc_device_t *device, void *userdata)
+{
+	batch_data_t *data = (batch_data_t *) userdata;
+	batch_item_t *item = NULL;
+	dc_datetime_t datetime = {0};
+
+	for (item = data->head; item; item = item->next) {
+		if (item->device == device)
+			break;
+	}
+
+	double begin = dctool_time ();
+	dc_ticks_t now = data->reference + (dc_ticks_t) (begin - data->start + 0.5);
+	if (!dc_datetime_localtime (&datetime, now))
+		return DC_STATUS_DATAFORMAT;
+
+	dc_status_t rc = dc_device_timesync (device, &datetime);
+	item->latency = dctool_time () - begin;
+
+	return rc;
+}
+
+static void
+batch_done (dc_device_t *device, dc_status_t status, void *userdata)
+{
+	batch_data_t *data = (batch_data_t *) userdata;
+
+	for (batch_item_t *item = data->head; item; item = item->next) {
+		if (item->device == device)
+			item->status = status;
+	}
+}
+
+static dc_status_t
+do_timesync_batch (dc_context_t *context, dc_descriptor_t *descriptor, unsigned int transports)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_discovery_t *discovery = NULL;
+	dc_session_t *session = NULL;
+	batch_data_t data = {0};
+	unsigned int count = 0, nerrors = 0;
+
+	data.head = NULL;
+	data.tail = &data.head;
+
+	// Detect all devices at once.
+	message ("Detecting the devices.\n");
+	rc = dc_discovery_new (&discovery, context, descriptor, transports, batch_discovery_cb, &data);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to start the device discovery.");
+		goto cleanup;
+	}
+
+	rc = dc_discovery_wait (discovery);
+	dc_discovery_free (discovery);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Failed to discover the devices.");
+		goto cleanup;
+	}
+
+	// Open all devices. The connections remain open until all clocks are
+	// synchronized.
+	for (batch_item_t *item = data.head; item; item = item->next) {
+		message ("Opening the device (%s, %s).\n",
+			dctool_transport_name (item->transport), item->address);
+
+		item->status = dctool_device_open (&item->iostream, context, item->transport, item->object);
+		if (item->status != DC_STATUS_SUCCESS) {
+			ERROR ("Error opening the I/O stream.");
+			continue;
+		}
+
+		item->status = dc_device_open (&item->device, context, descriptor, item->iostream);
+		if (item->status != DC_STATUS_SUCCESS) {
+			ERROR ("Error opening the device.");
+			continue;
+		}
+
+		dc_device_set_events (item->device, DC_EVENT_DEVINFO | DC_EVENT_CLOCK, batch_event_cb, item);
+		dc_device_set_cancel (item->device, dctool_cancel_cb, NULL);
+		count++;
+	}
+
+	if (count == 0) {
+		message ("No devices found.\n");
+		rc = DC_STATUS_NODEVICE;
+		goto cleanup;
+	}
+
+	// Synchronize all clocks at the same time, one thread per device.
+	rc = dc_session_new (&session, context, count);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error creating the session.");
+		goto cleanup;
+	}
+
+	data.reference = dc_datetime_now ();
+	data.start = dctool_time ();
+
+	message ("Syncronize the device clocks.\n");
+	for (batch_item_t *item = data.head; item; item = item->next) {
+		if (item->device == NULL)
+			continue;
+
+		item->status = dc_session_add_task (session, item->device, batch_timesync, batch_done, &data);
+	}
+
+	dc_session_wait (session);
+
+	// Report the result of every device.
+	for (batch_item_t *item = data.head; item; item = item->next) {
+		message ("Device: %s, %s, serial=%u, status=%s, latency=%.3fs",
+			dctool_transport_name (item->transport), item->address,
+			item->devinfo.serial, dctool_errmsg (item->status), item->latency);
+		if (item->have_clock) {
+			message (", skew=" DC_TICKS_FORMAT " (systime=" DC_TICKS_FORMAT ", devtime=%u)",
+				item->clock.systime - (dc_ticks_t) item->clock.devtime,
+				item->clock.systime, item->clock.devtime);
+		} else {
+			message (", skew=n/a");
+		}
+		message ("\n");
+
+		if (item->status != DC_STATUS_SUCCESS)
+			nerrors++;
+	}
+
+	if (nerrors) {
+		message ("Failed to synchronize %u device(s).\n", nerrors);
+		rc = DC_STATUS_IO;
+	}
+
+cleanup:
+	dc_session_free (session);
+	while (data.head) {
+		batch_item_t *next = data.head->next;
+		dc_device_close (data.head->device);
+		dc_iostream_close (data.head->iostream);
+		dctool_device_free (data.head->transport, data.head->object);
+		free (data.head);
+		data.head = next;
+	}
+	return rc;
+}
+
 static int
 dctool_timesync_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
 {
@@ -105,13 +320,16 @@ dctool_timesync_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 
 	// Default option values.
 	unsigned int help = 0;
+	unsigned int all = 0;
+	unsigned int transports = 0;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:";
+	const char *optstring = "hat:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
+		{"all",         no_argument,       0, 'a'},
 		{"transport",   required_argument, 0, 't'},
 		{0,             0,                 0,  0 }
 	};
@@ -123,8 +341,12 @@ dctool_timesync_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		case 'h':
 			help = 1;
 			break;
+		case 'a':
+			all = 1;
+			break;
 		case 't':
 			transport = dctool_transport_type (optarg);
+			transports |= transport;
 			break;
 		default:
 			return EXIT_FAILURE;
@@ -140,6 +362,16 @@ dctool_timesync_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		return EXIT_SUCCESS;
 	}
 
+	// Synchronize all detected devices.
+	if (all) {
+		status = do_timesync_batch (context, descriptor, transports ? transports : dc_context_get_transports (context));
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+		}
+		goto cleanup;
+	}
+
 	// Check the transport type.
 	if (transport == DC_TRANSPORT_NONE) {
 		message ("No valid transport type specified.\n");
@@ -179,9 +411,17 @@ const dctool_command_t dctool_timesync = {
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
 	"   -h, --help               Show help message\n"
+	"   -a, --all                All detected devices\n"
 	"   -t, --transport <name>   Transport type\n"
 #else
 	"   -h               Show help message\n"
+	"   -a               All detected devices\n"
 	"   -t <transport>   Transport type\n"
 #endif
+	"\n"
+	"With the -a option, all detected devices are opened, and their clocks\n"
+	"are synchronized at the same time, to the same reference clock. The -t\n"
+	"option can be repeated to scan several transports. For the devices\n"
+	"which report their clock, the skew is the system time minus the device\n"
+	"time, in device ticks.\n"
 };
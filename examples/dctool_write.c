@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 #ifdef HAVE_GETOPT_H
 #include <getopt.h>
 #endif
@@ -38,12 +39,63 @@
 #include "common.h"
 #include "utils.h"
 
+/*
+ * Write a memory range. With the current contents, only the runs of
+ * blocks which differ are written. The blocks are aligned to a multiple
+ * of the block size, so the writes respect the page size of the device.
+ */
+static dc_status_t
+write_range (dc_device_t *device, unsigned int address, const unsigned char data[], const unsigned char current[], unsigned int size, unsigned int blocksize, unsigned int *nwritten)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (current == NULL) {
+		message ("Writing data to the internal memory (0x%08x, %u bytes).\n",
+			address, size);
+		rc = dc_device_write (device, address, data, size);
+		if (rc == DC_STATUS_SUCCESS)
+			*nwritten += size;
+		return rc;
+	}
+
+	unsigned int offset = 0, begin = 0, changed = 0;
+	while (offset < size) {
+		unsigned int length = blocksize - (address + offset) % blocksize;
+		if (length > size - offset)
+			length = size - offset;
+
+		int differs = memcmp (current + offset, data + offset, length) != 0;
+		if (differs && !changed) {
+			begin = offset;
+			changed = 1;
+		}
+
+		offset += length;
+
+		// Write the run of changed blocks.
+		if (changed && (!differs || offset == size)) {
+			unsigned int end = differs ? offset : offset - length;
+			message ("Writing data to the internal memory (0x%08x, %u bytes).\n",
+				address + begin, end - begin);
+			rc = dc_device_write (device, address + begin, data + begin, end - begin);
+			if (rc != DC_STATUS_SUCCESS)
+				return rc;
+			*nwritten += end - begin;
+			changed = 0;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
-dowrite (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, unsigned int address, dc_buffer_t *buffer)
+dowrite (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, const dctool_range_t ranges[], unsigned int nranges, unsigned int base, dc_buffer_t *buffer, unsigned int blocksize)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_iostream_t *iostream = NULL;
 	dc_device_t *device = NULL;
+	dc_device_range_t *vector = NULL;
+	unsigned char *current = NULL;
 
 	// Open the I/O stream.
 	message ("Opening the I/O stream (%s, %s).\n",
@@ -82,15 +134,52 @@ dowrite (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t tran
 		goto cleanup;
 	}
 
-	// Write data to the internal memory.
-	message ("Writing data to the internal memory.\n");
-	rc = dc_device_write (device, address, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR ("Error writing to the internal memory.");
-		goto cleanup;
+	// Read the current contents of all ranges with a single vectored
+	// read, into a copy of the image.
+	if (blocksize) {
+		current = (unsigned char *) malloc (dc_buffer_get_size (buffer));
+		vector = (dc_device_range_t *) malloc (nranges * sizeof (dc_device_range_t));
+		if (current == NULL || vector == NULL) {
+			ERROR ("Failed to allocate memory.");
+			rc = DC_STATUS_NOMEMORY;
+			goto cleanup;
+		}
+
+		for (unsigned int i = 0; i < nranges; ++i) {
+			vector[i].address = ranges[i].address;
+			vector[i].size = ranges[i].count;
+			vector[i].data = current + (ranges[i].address - base);
+		}
+
+		message ("Reading data from the internal memory (%u ranges).\n", nranges);
+		rc = dc_device_read_multi (device, vector, nranges);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error reading from the internal memory.");
+			goto cleanup;
+		}
+	}
+
+	// Write data to the internal memory. All ranges are written over the
+	// same connection, from their offset to the base address.
+	unsigned int nbytes = 0, nwritten = 0;
+	for (unsigned int i = 0; i < nranges; ++i) {
+		unsigned int offset = ranges[i].address - base;
+		rc = write_range (device, ranges[i].address,
+			dc_buffer_get_data (buffer) + offset,
+			current ? current + offset : NULL,
+			ranges[i].count, blocksize, &nwritten);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error writing to the internal memory.");
+			goto cleanup;
+		}
+		nbytes += ranges[i].count;
 	}
 
+	message ("Written %u of %u bytes.\n", nwritten, nbytes);
+
 cleanup:
+	free (current);
+	free (vector);
 	dc_device_close (device);
 	dc_iostream_close (iostream);
 	return rc;
@@ -102,17 +191,20 @@ dctool_write_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	int exitcode = EXIT_SUCCESS;
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_buffer_t *buffer = NULL;
+	dctool_range_t *ranges = NULL;
 	dc_transport_t transport = dctool_transport_default (descriptor);
 
 	// Default option values.
 	unsigned int help = 0;
 	const char *filename = NULL;
+	const char *rangefile = NULL;
 	unsigned int address = 0, have_address = 0;
 	unsigned int count = 0, have_count = 0;
+	unsigned int blocksize = 0;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:a:c:i:";
+	const char *optstring = "ht:a:c:i:r:d:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
@@ -120,6 +212,8 @@ dctool_write_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		{"address",     required_argument, 0, 'a'},
 		{"count",       required_argument, 0, 'c'},
 		{"input",       required_argument, 0, 'i'},
+		{"ranges",      required_argument, 0, 'r'},
+		{"diff",        required_argument, 0, 'd'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -144,6 +238,12 @@ dctool_write_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 'i':
 			filename = optarg;
 			break;
+		case 'r':
+			rangefile = optarg;
+			break;
+		case 'd':
+			blocksize = strtoul (optarg, NULL, 0);
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -166,7 +266,7 @@ dctool_write_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	}
 
 	// Check mandatory arguments.
-	if (!have_address) {
+	if (!have_address && !rangefile) {
 		message ("No memory address specified.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
@@ -180,15 +280,34 @@ dctool_write_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		goto cleanup;
 	}
 
-	// Check the number of bytes (if provided)
-	if (have_count && count != dc_buffer_get_size (buffer)) {
+	// Read the list of memory ranges, or use the single range.
+	dctool_range_t single = {address, dc_buffer_get_size (buffer)};
+	unsigned int nranges = 1, base = address;
+	if (rangefile) {
+		status = dctool_ranges_read (rangefile, &ranges, &nranges);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("Failed to read the memory ranges.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		// The input is an image of the memory, which must contain all
+		// the ranges.
+		base = 0;
+		if (nranges == 0 || ranges[nranges - 1].address + ranges[nranges - 1].count > dc_buffer_get_size (buffer)) {
+			message ("Memory ranges don't match the image.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	} else if (have_count && count != dc_buffer_get_size (buffer)) {
+		// Check the number of bytes (if provided)
 		message ("Number of bytes doesn't match file length.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
 	// Write data to the internal memory.
-	status = dowrite (context, descriptor, transport, argv[0], address, buffer);
+	status = dowrite (context, descriptor, transport, argv[0], ranges ? ranges : &single, nranges, base, buffer, blocksize);
 	if (status != DC_STATUS_SUCCESS) {
 		message ("ERROR: %s\n", dctool_errmsg (status));
 		exitcode = EXIT_FAILURE;
@@ -196,6 +315,7 @@ dctool_write_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	}
 
 cleanup:
+	free (ranges);
 	dc_buffer_free (buffer);
 	return exitcode;
 }
@@ -215,11 +335,25 @@ const dctool_command_t dctool_write = {
 	"   -a, --address <address>   Memory address\n"
 	"   -c, --count <count>       Number of bytes\n"
 	"   -i, --input <filename>    Input filename\n"
+	"   -r, --ranges <filename>   Memory ranges\n"
+	"   -d, --diff <blocksize>    Only write the changed blocks\n"
 #else
 	"   -h              Show help message\n"
 	"   -t <transport>  Transport type\n"
 	"   -a <address>    Memory address\n"
 	"   -c <count>      Number of bytes\n"
 	"   -i <filename>   Input filename\n"
+	"   -r <filename>   Memory ranges\n"
+	"   -d <blocksize>  Only write the changed blocks\n"
 #endif
+	"\n"
+	"The memory ranges file contains an address and a number of bytes per\n"
+	"line. The input is then an image of the memory (for example from the\n"
+	"read command with the same ranges), and all ranges are written over a\n"
+	"single connection, each from its own address in the image.\n"
+	"\n"
+	"With the diff option, the memory is read first, and compared with the\n"
+	"input in blocks of the given size. Only the changed blocks are written.\n"
+	"Use the page size of the device as the block size, if it only accepts\n"
+	"aligned writes.\n"
 };
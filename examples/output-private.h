@@ -22,6 +22,8 @@
 #ifndef DCTOOL_OUTPUT_PRIVATE_H
 #define DCTOOL_OUTPUT_PRIVATE_H
 
+#include <stdio.h>
+
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/parser.h>
 
@@ -36,6 +38,7 @@ typedef struct dctool_output_vtable_t dctool_output_vtable_t;
 struct dctool_output_t {
 	const dctool_output_vtable_t *vtable;
 	unsigned int number;
+	int parser;
 };
 
 struct dctool_output_vtable_t {
@@ -43,6 +46,10 @@ struct dctool_output_vtable_t {
 
 	dc_status_t (*write) (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 
+	dc_status_t (*render) (dctool_output_t *output, FILE *ostream, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+
+	dc_status_t (*append) (dctool_output_t *output, FILE *fragment);
+
 	dc_status_t (*free) (dctool_output_t *output);
 };
 
@@ -52,6 +59,9 @@ dctool_output_allocate (const dctool_output_vtable_t *vtable);
 void
 dctool_output_deallocate (dctool_output_t *output);
 
+dc_status_t
+dctool_output_copy (FILE *ostream, FILE *fragment);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
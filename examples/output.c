@@ -40,6 +40,7 @@ dctool_output_allocate (const dctool_output_vtable_t *vtable)
 
 	output->vtable = vtable;
 	output->number = 0;
+	output->parser = 1;
 
 	return output;
 }
@@ -61,6 +62,81 @@ dctool_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigne
 	return output->vtable->write (output, parser, data, size, fingerprint, fsize);
 }
 
+int
+dctool_output_needs_parser (dctool_output_t *output)
+{
+	if (output == NULL)
+		return 0;
+
+	return output->parser;
+}
+
+dc_status_t
+dctool_output_render (dctool_output_t *output, FILE **fragment, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (output == NULL || fragment == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (output->vtable->render == NULL || output->vtable->append == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	FILE *ostream = tmpfile ();
+	if (ostream == NULL)
+		return DC_STATUS_IO;
+
+	status = output->vtable->render (output, ostream, parser, data, size, fingerprint, fsize);
+	if (status != DC_STATUS_SUCCESS) {
+		fclose (ostream);
+		return status;
+	}
+
+	*fragment = ostream;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dctool_output_append (dctool_output_t *output, FILE *fragment)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (output == NULL || fragment == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (output->vtable->append == NULL) {
+		fclose (fragment);
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	output->number++;
+
+	status = output->vtable->append (output, fragment);
+
+	fclose (fragment);
+
+	return status;
+}
+
+dc_status_t
+dctool_output_copy (FILE *ostream, FILE *fragment)
+{
+	char buffer[8192];
+	size_t n = 0;
+
+	rewind (fragment);
+	while ((n = fread (buffer, 1, sizeof (buffer), fragment)) > 0) {
+		if (fwrite (buffer, 1, n, ostream) != n)
+			return DC_STATUS_IO;
+	}
+
+	if (ferror (fragment))
+		return DC_STATUS_IO;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dctool_output_free (dctool_output_t *output)
 {
@@ -22,6 +22,8 @@
 #ifndef DCTOOL_OUTPUT_H
 #define DCTOOL_OUTPUT_H
 
+#include <stdio.h>
+
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/parser.h>
 
@@ -42,9 +44,34 @@ dctool_xml_output_new (const char *filename, dctool_units_t units);
 dctool_output_t *
 dctool_raw_output_new (const char *template);
 
+dctool_output_t *
+dctool_json_output_new (const char *filename, dctool_units_t units);
+
+dctool_output_t *
+dctool_columns_output_new (const char *prefix, dctool_units_t units);
+
 dc_status_t
 dctool_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 
+/*
+ * Check whether the output uses the parser. If not, the dives can be
+ * written with a NULL parser, and creating the parser can be skipped.
+ */
+int
+dctool_output_needs_parser (dctool_output_t *output);
+
+/*
+ * Render a dive into a temporary stream, and append it to the output
+ * later. Rendering doesn't modify the output, and can run on several
+ * threads at the same time. The dive number is assigned when the
+ * fragment is appended, and the fragment is closed.
+ */
+dc_status_t
+dctool_output_render (dctool_output_t *output, FILE **fragment, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+
+dc_status_t
+dctool_output_append (dctool_output_t *output, FILE *fragment);
+
 dc_status_t
 dctool_output_free (dctool_output_t *output);
 
@@ -0,0 +1,328 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "output-private.h"
+#include "utils.h"
+
+/*
+ * Columnar export of the samples. Each column is a separate file with a
+ * flat array of fixed size values in the native byte order, which maps
+ * directly onto the primitive arrays of columnar formats like Arrow.
+ * Missing values are stored as NAN. The rows of all dives are appended
+ * to the same files, with a dive column to tell them apart. The schema
+ * file lists the columns with their type and the byte order.
+ */
+
+#define NTANKS 8
+
+static dc_status_t dctool_columns_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_columns_output_free (dctool_output_t *output);
+
+typedef struct dctool_columns_output_t {
+	dctool_output_t base;
+	char *prefix;
+	dctool_units_t units;
+	unsigned long long nrows;
+	/* The column files. */
+	FILE *dive;
+	FILE *time;
+	FILE *depth;
+	FILE *temperature;
+	FILE *ppo2;
+	FILE *pressure[NTANKS];
+	/* The sample arrays, reused for all dives. */
+	unsigned int capacity;
+	unsigned int *divenum;
+	unsigned int *times;
+	double *depths;
+	double *temperatures;
+	double *ppo2s;
+	double *pressures[NTANKS];
+} dctool_columns_output_t;
+
+static const dctool_output_vtable_t columns_vtable = {
+	sizeof(dctool_columns_output_t), /* size */
+	dctool_columns_output_write, /* write */
+	NULL, /* render */
+	NULL, /* append */
+	dctool_columns_output_free, /* free */
+};
+
+static FILE *
+columns_open (const char *prefix, const char *name)
+{
+	char filename[1024];
+
+	int n = snprintf (filename, sizeof (filename), "%s.%s.bin", prefix, name);
+	if (n < 0 || (size_t) n >= sizeof (filename))
+		return NULL;
+
+	return fopen (filename, "wb");
+}
+
+static dc_status_t
+columns_grow (dctool_columns_output_t *output, unsigned int capacity)
+{
+	unsigned int *divenum = (unsigned int *) realloc (output->divenum, capacity * sizeof (unsigned int));
+	if (divenum == NULL)
+		return DC_STATUS_NOMEMORY;
+	output->divenum = divenum;
+
+	unsigned int *times = (unsigned int *) realloc (output->times, capacity * sizeof (unsigned int));
+	if (times == NULL)
+		return DC_STATUS_NOMEMORY;
+	output->times = times;
+
+	double **arrays[3 + NTANKS] = {&output->depths, &output->temperatures, &output->ppo2s};
+	for (unsigned int i = 0; i < NTANKS; ++i)
+		arrays[3 + i] = output->pressures + i;
+
+	for (unsigned int i = 0; i < 3 + NTANKS; ++i) {
+		double *array = (double *) realloc (*arrays[i], capacity * sizeof (double));
+		if (array == NULL)
+			return DC_STATUS_NOMEMORY;
+		*arrays[i] = array;
+	}
+
+	output->capacity = capacity;
+
+	return DC_STATUS_SUCCESS;
+}
+
+// Check whether all values of a column are missing.
+static int
+columns_empty (const double values[], unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		if (!isnan (values[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int
+columns_write (FILE *fp, const void *data, size_t size, unsigned int count)
+{
+	return fwrite (data, size, count, fp) == count;
+}
+
+static void
+columns_close (dctool_columns_output_t *output)
+{
+	FILE *files[5 + NTANKS] = {output->dive, output->time, output->depth, output->temperature, output->ppo2};
+	for (unsigned int i = 0; i < NTANKS; ++i)
+		files[5 + i] = output->pressure[i];
+
+	for (unsigned int i = 0; i < 5 + NTANKS; ++i) {
+		if (files[i])
+			fclose (files[i]);
+	}
+
+	free (output->divenum);
+	free (output->times);
+	free (output->depths);
+	free (output->temperatures);
+	free (output->ppo2s);
+	for (unsigned int i = 0; i < NTANKS; ++i)
+		free (output->pressures[i]);
+	free (output->prefix);
+}
+
+dctool_output_t *
+dctool_columns_output_new (const char *prefix, dctool_units_t units)
+{
+	dctool_columns_output_t *output = NULL;
+
+	if (prefix == NULL)
+		goto error_exit;
+
+	// Allocate memory.
+	output = (dctool_columns_output_t *) dctool_output_allocate (&columns_vtable);
+	if (output == NULL) {
+		goto error_exit;
+	}
+
+	output->units = units;
+	output->nrows = 0;
+	output->capacity = 0;
+	output->divenum = NULL;
+	output->times = NULL;
+	output->depths = NULL;
+	output->temperatures = NULL;
+	output->ppo2s = NULL;
+	output->dive = output->time = output->depth = output->temperature = output->ppo2 = NULL;
+	for (unsigned int i = 0; i < NTANKS; ++i) {
+		output->pressure[i] = NULL;
+		output->pressures[i] = NULL;
+	}
+
+	output->prefix = strdup (prefix);
+	if (output->prefix == NULL) {
+		goto error_free;
+	}
+
+	// Open the fixed columns. The tank pressure columns are opened once
+	// the first pressure for that tank shows up.
+	output->dive = columns_open (prefix, "dive");
+	output->time = columns_open (prefix, "time");
+	output->depth = columns_open (prefix, "depth");
+	output->temperature = columns_open (prefix, "temperature");
+	output->ppo2 = columns_open (prefix, "ppo2");
+	if (output->dive == NULL || output->time == NULL || output->depth == NULL ||
+		output->temperature == NULL || output->ppo2 == NULL) {
+		ERROR ("Failed to open the output files.");
+		columns_close (output);
+		goto error_free;
+	}
+
+	return (dctool_output_t *) output;
+
+error_free:
+	dctool_output_deallocate ((dctool_output_t *) output);
+error_exit:
+	return NULL;
+}
+
+static dc_status_t
+dctool_columns_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_columns_output_t *output = (dctool_columns_output_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Extract the samples, and retry with larger arrays if the dive
+	// doesn't fit.
+	dc_sample_columns_t columns = {0};
+	while (1) {
+		columns.capacity = output->capacity;
+		columns.time = output->times;
+		columns.depth = output->depths;
+		columns.temperature = output->temperatures;
+		columns.ppo2 = output->ppo2s;
+		columns.ntanks = NTANKS;
+		columns.pressure = output->pressures;
+
+		message ("Parsing the sample data.\n");
+		status = dc_parser_get_samples_columnar (parser, &columns);
+		if (status != DC_STATUS_NOMEMORY || columns.count <= output->capacity)
+			break;
+
+		status = columns_grow (output, columns.count);
+		if (status != DC_STATUS_SUCCESS)
+			break;
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error parsing the sample data.");
+		return status;
+	}
+
+	unsigned int count = columns.count;
+	if (count == 0)
+		return DC_STATUS_SUCCESS;
+
+	// Convert to the requested units.
+	dc_sample_conversion_t conversion = {0};
+	conversion.units = (output->units == DCTOOL_UNITS_IMPERIAL ? DC_UNITS_IMPERIAL : DC_UNITS_METRIC);
+	dc_sample_columns_convert (&columns, &conversion);
+
+	for (unsigned int i = 0; i < count; ++i)
+		output->divenum[i] = abstract->number;
+
+	int success =
+		columns_write (output->dive, output->divenum, sizeof (unsigned int), count) &&
+		columns_write (output->time, output->times, sizeof (unsigned int), count) &&
+		columns_write (output->depth, output->depths, sizeof (double), count) &&
+		columns_write (output->temperature, output->temperatures, sizeof (double), count) &&
+		columns_write (output->ppo2, output->ppo2s, sizeof (double), count);
+
+	for (unsigned int i = 0; i < NTANKS; ++i) {
+		if (output->pressure[i] == NULL) {
+			if (columns_empty (output->pressures[i], count))
+				continue;
+
+			char name[16];
+			snprintf (name, sizeof (name), "pressure%u", i);
+			output->pressure[i] = columns_open (output->prefix, name);
+			if (output->pressure[i] == NULL) {
+				ERROR ("Failed to open the output file.");
+				return DC_STATUS_IO;
+			}
+
+			// Fill the rows of the previous dives.
+			const double nan = NAN;
+			for (unsigned long long j = 0; j < output->nrows && success; ++j)
+				success = columns_write (output->pressure[i], &nan, sizeof (double), 1);
+		}
+
+		if (success)
+			success = columns_write (output->pressure[i], output->pressures[i], sizeof (double), count);
+	}
+
+	if (!success) {
+		ERROR ("Failed to write the output files.");
+		return DC_STATUS_IO;
+	}
+
+	output->nrows += count;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dctool_columns_output_free (dctool_output_t *abstract)
+{
+	dctool_columns_output_t *output = (dctool_columns_output_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Write the schema.
+	char filename[1024];
+	int n = snprintf (filename, sizeof (filename), "%s.schema", output->prefix);
+	FILE *schema = NULL;
+	if (n >= 0 && (size_t) n < sizeof (filename))
+		schema = fopen (filename, "w");
+	if (schema) {
+		const unsigned int one = 1;
+		fprintf (schema, "byteorder %s\n", *(const unsigned char *) &one ? "little" : "big");
+		fprintf (schema, "rows %llu\n", output->nrows);
+		fprintf (schema, "dive uint32\n");
+		fprintf (schema, "time uint32\n");
+		fprintf (schema, "depth float64\n");
+		fprintf (schema, "temperature float64\n");
+		fprintf (schema, "ppo2 float64\n");
+		for (unsigned int i = 0; i < NTANKS; ++i) {
+			if (output->pressure[i])
+				fprintf (schema, "pressure%u float64\n", i);
+		}
+		fclose (schema);
+	} else {
+		status = DC_STATUS_IO;
+	}
+
+	columns_close (output);
+
+	return status;
+}
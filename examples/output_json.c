@@ -0,0 +1,654 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <libdivecomputer/units.h>
+
+#include "output-private.h"
+#include "utils.h"
+#include "writer.h"
+
+static dc_status_t dctool_json_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_json_output_render (dctool_output_t *output, FILE *ostream, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_json_output_append (dctool_output_t *output, FILE *fragment);
+static dc_status_t dctool_json_output_free (dctool_output_t *output);
+
+typedef struct dctool_json_output_t {
+	dctool_output_t base;
+	FILE *ostream;
+	dctool_units_t units;
+} dctool_json_output_t;
+
+static const dctool_output_vtable_t json_vtable = {
+	sizeof(dctool_json_output_t), /* size */
+	dctool_json_output_write, /* write */
+	dctool_json_output_render, /* render */
+	dctool_json_output_append, /* append */
+	dctool_json_output_free, /* free */
+};
+
+/*
+ * The samples are written as they arrive. The sample types that can
+ * appear more than once per sample (pressures, events and vendor data)
+ * are collected in separate arrays, and appended when the sample is
+ * complete.
+ */
+typedef struct sample_data_t {
+	dctool_writer_t *writer;
+	dctool_units_t units;
+	unsigned int nsamples;
+	dctool_writer_t pressure;
+	dctool_writer_t event;
+	dctool_writer_t vendor;
+} sample_data_t;
+
+static double
+convert_depth (double value, dctool_units_t units)
+{
+	if (units == DCTOOL_UNITS_IMPERIAL) {
+		return value / FEET;
+	} else {
+		return value;
+	}
+}
+
+static double
+convert_temperature (double value, dctool_units_t units)
+{
+	if (units == DCTOOL_UNITS_IMPERIAL) {
+		return value * (9.0 / 5.0) + 32.0;
+	} else {
+		return value;
+	}
+}
+
+static double
+convert_pressure (double value, dctool_units_t units)
+{
+	if (units == DCTOOL_UNITS_IMPERIAL) {
+		return value * BAR / PSI;
+	} else {
+		return value;
+	}
+}
+
+static double
+convert_volume (double value, dctool_units_t units)
+{
+	if (units == DCTOOL_UNITS_IMPERIAL) {
+		return value / 1000.0 / CUFT;
+	} else {
+		return value;
+	}
+}
+
+static void
+json_number (dctool_writer_t *writer, double value, unsigned int decimals)
+{
+	// JSON has no representation for infinity and NaN.
+	if (isfinite (value))
+		dctool_writer_fixed (writer, value, decimals);
+	else
+		dctool_writer_literal (writer, "null");
+}
+
+static void
+json_string (dctool_writer_t *writer, const char *value)
+{
+	// All strings are fixed names, which never need escaping.
+	dctool_writer_literal (writer, "\"");
+	dctool_writer_string (writer, value, strlen (value));
+	dctool_writer_literal (writer, "\"");
+}
+
+static void
+json_array (dctool_writer_t *writer, const char *name, const dctool_writer_t *array)
+{
+	if (array->size == 0)
+		return;
+
+	dctool_writer_string (writer, name, strlen (name));
+	dctool_writer_append (writer, array);
+	dctool_writer_literal (writer, "]");
+}
+
+// Start a new element of an array, which is opened by the first one.
+static void
+json_element (dctool_writer_t *array)
+{
+	if (array->size)
+		dctool_writer_literal (array, ",{");
+	else
+		dctool_writer_literal (array, "[{");
+}
+
+static void
+sample_end (sample_data_t *sampledata)
+{
+	if (sampledata->nsamples == 0)
+		return;
+
+	json_array (sampledata->writer, ",\"pressure\":", &sampledata->pressure);
+	json_array (sampledata->writer, ",\"events\":", &sampledata->event);
+	json_array (sampledata->writer, ",\"vendor\":", &sampledata->vendor);
+	dctool_writer_literal (sampledata->writer, "}");
+
+	dctool_writer_clear (&sampledata->pressure);
+	dctool_writer_clear (&sampledata->event);
+	dctool_writer_clear (&sampledata->vendor);
+}
+
+static void
+sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	static const char *events[] = {
+		"none", "deco", "rbt", "ascent", "ceiling", "workload", "transmitter",
+		"violation", "bookmark", "surface", "safety stop", "gaschange",
+		"safety stop (voluntary)", "safety stop (mandatory)", "deepstop",
+		"ceiling (safety stop)", "floor", "divetime", "maxdepth",
+		"OLF", "PO2", "airtime", "rgbm", "heading", "tissue level warning",
+		"gaschange2"};
+	static const char *decostop[] = {
+		"ndl", "safety", "deco", "deep"};
+
+	sample_data_t *sampledata = (sample_data_t *) userdata;
+	dctool_writer_t *writer = sampledata->writer;
+
+	// Drop the values before the first time sample.
+	if (type != DC_SAMPLE_TIME && sampledata->nsamples == 0)
+		return;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		sample_end (sampledata);
+		if (sampledata->nsamples++)
+			dctool_writer_literal (writer, ",");
+		dctool_writer_literal (writer, "{\"time\":");
+		dctool_writer_uint (writer, value.time, 1);
+		break;
+	case DC_SAMPLE_DEPTH:
+		dctool_writer_literal (writer, ",\"depth\":");
+		json_number (writer, convert_depth(value.depth, sampledata->units), 2);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		json_element (&sampledata->pressure);
+		dctool_writer_literal (&sampledata->pressure, "\"tank\":");
+		dctool_writer_uint (&sampledata->pressure, value.pressure.tank, 1);
+		dctool_writer_literal (&sampledata->pressure, ",\"value\":");
+		json_number (&sampledata->pressure, convert_pressure(value.pressure.value, sampledata->units), 2);
+		dctool_writer_literal (&sampledata->pressure, "}");
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		dctool_writer_literal (writer, ",\"temperature\":");
+		json_number (writer, convert_temperature(value.temperature, sampledata->units), 2);
+		break;
+	case DC_SAMPLE_EVENT:
+		if (value.event.type != SAMPLE_EVENT_GASCHANGE && value.event.type != SAMPLE_EVENT_GASCHANGE2) {
+			json_element (&sampledata->event);
+			dctool_writer_literal (&sampledata->event, "\"type\":");
+			dctool_writer_uint (&sampledata->event, value.event.type, 1);
+			dctool_writer_literal (&sampledata->event, ",\"time\":");
+			dctool_writer_uint (&sampledata->event, value.event.time, 1);
+			dctool_writer_literal (&sampledata->event, ",\"flags\":");
+			dctool_writer_uint (&sampledata->event, value.event.flags, 1);
+			dctool_writer_literal (&sampledata->event, ",\"value\":");
+			dctool_writer_uint (&sampledata->event, value.event.value, 1);
+			dctool_writer_literal (&sampledata->event, ",\"name\":");
+			json_string (&sampledata->event, events[value.event.type]);
+			dctool_writer_literal (&sampledata->event, "}");
+		}
+		break;
+	case DC_SAMPLE_RBT:
+		dctool_writer_literal (writer, ",\"rbt\":");
+		dctool_writer_uint (writer, value.rbt, 1);
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		dctool_writer_literal (writer, ",\"heartbeat\":");
+		dctool_writer_uint (writer, value.heartbeat, 1);
+		break;
+	case DC_SAMPLE_BEARING:
+		dctool_writer_literal (writer, ",\"bearing\":");
+		dctool_writer_uint (writer, value.bearing, 1);
+		break;
+	case DC_SAMPLE_VENDOR:
+		json_element (&sampledata->vendor);
+		dctool_writer_literal (&sampledata->vendor, "\"type\":");
+		dctool_writer_uint (&sampledata->vendor, value.vendor.type, 1);
+		dctool_writer_literal (&sampledata->vendor, ",\"data\":\"");
+		dctool_writer_hex (&sampledata->vendor, (const unsigned char *) value.vendor.data, value.vendor.size);
+		dctool_writer_literal (&sampledata->vendor, "\"}");
+		break;
+	case DC_SAMPLE_SETPOINT:
+		dctool_writer_literal (writer, ",\"setpoint\":");
+		json_number (writer, value.setpoint, 2);
+		break;
+	case DC_SAMPLE_PPO2:
+		dctool_writer_literal (writer, ",\"ppo2\":");
+		json_number (writer, value.ppo2, 2);
+		break;
+	case DC_SAMPLE_CNS:
+		dctool_writer_literal (writer, ",\"cns\":");
+		json_number (writer, value.cns * 100.0, 1);
+		break;
+	case DC_SAMPLE_DECO:
+		dctool_writer_literal (writer, ",\"deco\":{\"type\":");
+		json_string (writer, decostop[value.deco.type]);
+		dctool_writer_literal (writer, ",\"time\":");
+		dctool_writer_uint (writer, value.deco.time, 1);
+		dctool_writer_literal (writer, ",\"depth\":");
+		json_number (writer, convert_depth(value.deco.depth, sampledata->units), 2);
+		dctool_writer_literal (writer, "}");
+		break;
+	case DC_SAMPLE_GASMIX:
+		dctool_writer_literal (writer, ",\"gasmix\":");
+		dctool_writer_uint (writer, value.gasmix, 1);
+		break;
+	default:
+		break;
+	}
+}
+
+dctool_output_t *
+dctool_json_output_new (const char *filename, dctool_units_t units)
+{
+	dctool_json_output_t *output = NULL;
+
+	if (filename == NULL)
+		goto error_exit;
+
+	// Allocate memory.
+	output = (dctool_json_output_t *) dctool_output_allocate (&json_vtable);
+	if (output == NULL) {
+		goto error_exit;
+	}
+
+	// Open the output file.
+	output->ostream = fopen (filename, "w");
+	if (output->ostream == NULL) {
+		goto error_free;
+	}
+
+	output->units = units;
+
+	return (dctool_output_t *) output;
+
+error_free:
+	dctool_output_deallocate ((dctool_output_t *) output);
+error_exit:
+	return NULL;
+}
+
+static void
+json_datetime (dctool_writer_t *writer, const dc_datetime_t *dt)
+{
+	dctool_writer_literal (writer, ",\"datetime\":\"");
+	dctool_writer_uint (writer, dt->year, 4);
+	dctool_writer_literal (writer, "-");
+	dctool_writer_uint (writer, dt->month, 2);
+	dctool_writer_literal (writer, "-");
+	dctool_writer_uint (writer, dt->day, 2);
+	dctool_writer_literal (writer, "T");
+	dctool_writer_uint (writer, dt->hour, 2);
+	dctool_writer_literal (writer, ":");
+	dctool_writer_uint (writer, dt->minute, 2);
+	dctool_writer_literal (writer, ":");
+	dctool_writer_uint (writer, dt->second, 2);
+
+	if ((unsigned int) dt->timezone != DC_TIMEZONE_NONE) {
+		int timezone = dt->timezone;
+		if (timezone < 0) {
+			dctool_writer_literal (writer, "-");
+			timezone = -timezone;
+		} else {
+			dctool_writer_literal (writer, "+");
+		}
+		dctool_writer_uint (writer, timezone / 3600, 2);
+		dctool_writer_literal (writer, ":");
+		dctool_writer_uint (writer, (timezone % 3600) / 60, 2);
+	}
+
+	dctool_writer_literal (writer, "\"");
+}
+
+static void
+dctool_json_write_number (FILE *ostream, unsigned int number)
+{
+	fprintf (ostream, "{\"number\":%u,", number);
+}
+
+/*
+ * Write a dive as a single line with a JSON object. The line is always
+ * a complete object, even if parsing fails halfway. The object starts
+ * with the dive number, which is written separately, because it isn't
+ * known yet for a rendered dive.
+ */
+static dc_status_t
+dctool_json_write_dive (FILE *ostream, dctool_units_t units, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_writer_t writer;
+
+	dctool_writer_init (&writer, ostream);
+
+	// Initialize the sample data.
+	sample_data_t sampledata = {0};
+	sampledata.writer = &writer;
+	sampledata.units = units;
+	sampledata.nsamples = 0;
+	dctool_writer_init (&sampledata.pressure, NULL);
+	dctool_writer_init (&sampledata.event, NULL);
+	dctool_writer_init (&sampledata.vendor, NULL);
+	int samples = 0, array = 0;
+
+	dctool_writer_literal (&writer, "\"size\":");
+	dctool_writer_uint (&writer, size, 1);
+
+	if (fingerprint) {
+		dctool_writer_literal (&writer, ",\"fingerprint\":\"");
+		dctool_writer_hex (&writer, fingerprint, fsize);
+		dctool_writer_literal (&writer, "\"");
+	}
+
+	// Parse the datetime.
+	message ("Parsing the datetime.\n");
+	dc_datetime_t dt = {0};
+	status = dc_parser_get_datetime (parser, &dt);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the datetime.");
+		goto cleanup;
+	}
+
+	json_datetime (&writer, &dt);
+
+	// Parse the divetime.
+	message ("Parsing the divetime.\n");
+	unsigned int divetime = 0;
+	status = dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &divetime);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the divetime.");
+		goto cleanup;
+	}
+
+	dctool_writer_literal (&writer, ",\"divetime\":");
+	dctool_writer_uint (&writer, divetime, 1);
+
+	// Parse the maxdepth.
+	message ("Parsing the maxdepth.\n");
+	double maxdepth = 0.0;
+	status = dc_parser_get_field (parser, DC_FIELD_MAXDEPTH, 0, &maxdepth);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the maxdepth.");
+		goto cleanup;
+	}
+
+	dctool_writer_literal (&writer, ",\"maxdepth\":");
+	json_number (&writer, convert_depth(maxdepth, units), 2);
+
+	// Parse the avgdepth.
+	message ("Parsing the avgdepth.\n");
+	double avgdepth = 0.0;
+	status = dc_parser_get_field (parser, DC_FIELD_AVGDEPTH, 0, &avgdepth);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the avgdepth.");
+		goto cleanup;
+	}
+
+	if (status != DC_STATUS_UNSUPPORTED) {
+		dctool_writer_literal (&writer, ",\"avgdepth\":");
+		json_number (&writer, convert_depth(avgdepth, units), 2);
+	}
+
+	// Parse the temperature.
+	message ("Parsing the temperature.\n");
+	unsigned int ntemperatures = 0;
+	for (unsigned int i = 0; i < 3; ++i) {
+		dc_field_type_t fields[] = {DC_FIELD_TEMPERATURE_SURFACE,
+			DC_FIELD_TEMPERATURE_MINIMUM,
+			DC_FIELD_TEMPERATURE_MAXIMUM};
+		const char *names[] = {"surface", "minimum", "maximum"};
+
+		double temperature = 0.0;
+		status = dc_parser_get_field (parser, fields[i], 0, &temperature);
+		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+			ERROR ("Error parsing the temperature.");
+			goto cleanup;
+		}
+
+		if (status != DC_STATUS_UNSUPPORTED) {
+			if (ntemperatures++)
+				dctool_writer_literal (&writer, ",");
+			else
+				dctool_writer_literal (&writer, ",\"temperature\":{");
+			json_string (&writer, names[i]);
+			dctool_writer_literal (&writer, ":");
+			json_number (&writer, convert_temperature(temperature, units), 1);
+		}
+	}
+
+	if (ntemperatures)
+		dctool_writer_literal (&writer, "}");
+
+	// Parse the gas mixes.
+	message ("Parsing the gas mixes.\n");
+	unsigned int ngases = 0;
+	status = dc_parser_get_field (parser, DC_FIELD_GASMIX_COUNT, 0, &ngases);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the gas mix count.");
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < ngases; ++i) {
+		dc_gasmix_t gasmix = {0};
+		status = dc_parser_get_field (parser, DC_FIELD_GASMIX, i, &gasmix);
+		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+			ERROR ("Error parsing the gas mix.");
+			goto cleanup;
+		}
+
+		if (i) {
+			dctool_writer_literal (&writer, ",");
+		} else {
+			dctool_writer_literal (&writer, ",\"gasmix\":[");
+			array = 1;
+		}
+		dctool_writer_literal (&writer, "{\"he\":");
+		json_number (&writer, gasmix.helium * 100.0, 1);
+		dctool_writer_literal (&writer, ",\"o2\":");
+		json_number (&writer, gasmix.oxygen * 100.0, 1);
+		dctool_writer_literal (&writer, ",\"n2\":");
+		json_number (&writer, gasmix.nitrogen * 100.0, 1);
+		dctool_writer_literal (&writer, "}");
+		if (i + 1 == ngases) {
+			dctool_writer_literal (&writer, "]");
+			array = 0;
+		}
+	}
+
+	// Parse the tanks.
+	message ("Parsing the tanks.\n");
+	unsigned int ntanks = 0;
+	status = dc_parser_get_field (parser, DC_FIELD_TANK_COUNT, 0, &ntanks);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the tank count.");
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < ntanks; ++i) {
+		const char *names[] = {"none", "metric", "imperial"};
+
+		dc_tank_t tank = {0};
+		status = dc_parser_get_field (parser, DC_FIELD_TANK, i, &tank);
+		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+			ERROR ("Error parsing the tank.");
+			goto cleanup;
+		}
+
+		if (i) {
+			dctool_writer_literal (&writer, ",");
+		} else {
+			dctool_writer_literal (&writer, ",\"tank\":[");
+			array = 1;
+		}
+		dctool_writer_literal (&writer, "{");
+		if (tank.gasmix != DC_GASMIX_UNKNOWN) {
+			dctool_writer_literal (&writer, "\"gasmix\":");
+			dctool_writer_uint (&writer, tank.gasmix, 1);
+			dctool_writer_literal (&writer, ",");
+		}
+		if (tank.type != DC_TANKVOLUME_NONE) {
+			dctool_writer_literal (&writer, "\"type\":");
+			json_string (&writer, names[tank.type]);
+			dctool_writer_literal (&writer, ",\"volume\":");
+			json_number (&writer, convert_volume(tank.volume, units), 1);
+			dctool_writer_literal (&writer, ",\"workpressure\":");
+			json_number (&writer, convert_pressure(tank.workpressure, units), 2);
+			dctool_writer_literal (&writer, ",");
+		}
+		dctool_writer_literal (&writer, "\"beginpressure\":");
+		json_number (&writer, convert_pressure(tank.beginpressure, units), 2);
+		dctool_writer_literal (&writer, ",\"endpressure\":");
+		json_number (&writer, convert_pressure(tank.endpressure, units), 2);
+		dctool_writer_literal (&writer, "}");
+		if (i + 1 == ntanks) {
+			dctool_writer_literal (&writer, "]");
+			array = 0;
+		}
+	}
+
+	// Parse the dive mode.
+	message ("Parsing the dive mode.\n");
+	dc_divemode_t divemode = DC_DIVEMODE_OC;
+	status = dc_parser_get_field (parser, DC_FIELD_DIVEMODE, 0, &divemode);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the dive mode.");
+		goto cleanup;
+	}
+
+	if (status != DC_STATUS_UNSUPPORTED) {
+		const char *names[] = {"freedive", "gauge", "oc", "ccr", "scr"};
+		dctool_writer_literal (&writer, ",\"divemode\":");
+		json_string (&writer, names[divemode]);
+	}
+
+	// Parse the salinity.
+	message ("Parsing the salinity.\n");
+	dc_salinity_t salinity = {DC_WATER_FRESH, 0.0};
+	status = dc_parser_get_field (parser, DC_FIELD_SALINITY, 0, &salinity);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the salinity.");
+		goto cleanup;
+	}
+
+	if (status != DC_STATUS_UNSUPPORTED) {
+		dctool_writer_literal (&writer, ",\"salinity\":{\"type\":");
+		dctool_writer_uint (&writer, salinity.type, 1);
+		dctool_writer_literal (&writer, ",\"density\":");
+		json_number (&writer, salinity.density, 1);
+		dctool_writer_literal (&writer, "}");
+	}
+
+	// Parse the atmospheric pressure.
+	message ("Parsing the atmospheric pressure.\n");
+	double atmospheric = 0.0;
+	status = dc_parser_get_field (parser, DC_FIELD_ATMOSPHERIC, 0, &atmospheric);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR ("Error parsing the atmospheric pressure.");
+		goto cleanup;
+	}
+
+	if (status != DC_STATUS_UNSUPPORTED) {
+		dctool_writer_literal (&writer, ",\"atmospheric\":");
+		json_number (&writer, convert_pressure(atmospheric, units), 5);
+	}
+
+	// Parse the sample data.
+	message ("Parsing the sample data.\n");
+	dctool_writer_literal (&writer, ",\"samples\":[");
+	samples = 1;
+	status = dc_parser_samples_foreach (parser, sample_cb, &sampledata);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error parsing the sample data.");
+		goto cleanup;
+	}
+
+cleanup:
+	// Close the array of an incompletely parsed field.
+	if (array)
+		dctool_writer_literal (&writer, "]");
+	if (samples) {
+		sample_end (&sampledata);
+		dctool_writer_literal (&writer, "]");
+	}
+	dctool_writer_literal (&writer, "}\n");
+
+	dctool_writer_flush (&writer);
+	dctool_writer_free (&writer);
+	dctool_writer_free (&sampledata.pressure);
+	dctool_writer_free (&sampledata.event);
+	dctool_writer_free (&sampledata.vendor);
+
+	if (status == DC_STATUS_SUCCESS && writer.error)
+		status = DC_STATUS_IO;
+
+	return status;
+}
+
+static dc_status_t
+dctool_json_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_json_output_t *output = (dctool_json_output_t *) abstract;
+
+	dctool_json_write_number (output->ostream, abstract->number);
+
+	return dctool_json_write_dive (output->ostream, output->units, parser, data, size, fingerprint, fsize);
+}
+
+static dc_status_t
+dctool_json_output_render (dctool_output_t *abstract, FILE *ostream, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_json_output_t *output = (dctool_json_output_t *) abstract;
+
+	return dctool_json_write_dive (ostream, output->units, parser, data, size, fingerprint, fsize);
+}
+
+static dc_status_t
+dctool_json_output_append (dctool_output_t *abstract, FILE *fragment)
+{
+	dctool_json_output_t *output = (dctool_json_output_t *) abstract;
+
+	dctool_json_write_number (output->ostream, abstract->number);
+
+	return dctool_output_copy (output->ostream, fragment);
+}
+
+static dc_status_t
+dctool_json_output_free (dctool_output_t *abstract)
+{
+	dctool_json_output_t *output = (dctool_json_output_t *) abstract;
+
+	fclose (output->ostream);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -37,6 +37,8 @@ typedef struct dctool_raw_output_t {
 static const dctool_output_vtable_t raw_vtable = {
 	sizeof(dctool_raw_output_t), /* size */
 	dctool_raw_output_write, /* write */
+	NULL, /* render */
+	NULL, /* append */
 	dctool_raw_output_free, /* free */
 };
 
@@ -73,6 +75,9 @@ mktemplate_datetime (char *buffer, size_t size, dc_parser_t *parser)
 	dc_datetime_t datetime = {0};
 	int n = 0;
 
+	if (parser == NULL)
+		return -1;
+
 	rc = dc_parser_get_datetime (parser, &datetime);
 	if (rc != DC_STATUS_SUCCESS)
 		return -1;
@@ -98,6 +103,30 @@ mktemplate_number (char *buffer, size_t size, unsigned int number)
 	return n;
 }
 
+/*
+ * Check whether the template contains a placeholder which needs the
+ * parser. Only the timestamp is parsed from the dive data.
+ */
+static int
+mktemplate_needs_parser (const char *format)
+{
+	const char *p = format;
+	char ch = 0;
+
+	while ((ch = *p++) != 0) {
+		if (ch != '%')
+			continue;
+
+		ch = *p++;
+		if (ch == 't')
+			return 1;
+		if (ch == 0)
+			break;
+	}
+
+	return 0;
+}
+
 static int
 mktemplate (char *buffer, size_t size, const char *format, dc_parser_t *parser, const unsigned char fingerprint[], size_t fsize, unsigned int number)
 {
@@ -173,6 +202,10 @@ dctool_raw_output_new (const char *template)
 		goto error_free;
 	}
 
+	// Without a timestamp in the template, the dives are written
+	// without parsing them.
+	output->base.parser = mktemplate_needs_parser (template);
+
 	return (dctool_output_t *) output;
 
 error_free:
@@ -27,8 +27,11 @@
 
 #include "output-private.h"
 #include "utils.h"
+#include "writer.h"
 
 static dc_status_t dctool_xml_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_xml_output_render (dctool_output_t *output, FILE *ostream, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_xml_output_append (dctool_output_t *output, FILE *fragment);
 static dc_status_t dctool_xml_output_free (dctool_output_t *output);
 
 typedef struct dctool_xml_output_t {
@@ -40,11 +43,13 @@ typedef struct dctool_xml_output_t {
 static const dctool_output_vtable_t xml_vtable = {
 	sizeof(dctool_xml_output_t), /* size */
 	dctool_xml_output_write, /* write */
+	dctool_xml_output_render, /* render */
+	dctool_xml_output_append, /* append */
 	dctool_xml_output_free, /* free */
 };
 
 typedef struct sample_data_t {
-	FILE *ostream;
+	dctool_writer_t writer;
 	dctool_units_t units;
 	unsigned int nsamples;
 } sample_data_t;
@@ -107,61 +112,97 @@ sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 	switch (type) {
 	case DC_SAMPLE_TIME:
 		if (sampledata->nsamples++)
-			fprintf (sampledata->ostream, "</sample>\n");
-		fprintf (sampledata->ostream, "<sample>\n");
-		fprintf (sampledata->ostream, "   <time>%02u:%02u</time>\n", value.time / 60, value.time % 60);
+			dctool_writer_literal (&sampledata->writer, "</sample>\n");
+		dctool_writer_literal (&sampledata->writer, "<sample>\n   <time>");
+		dctool_writer_uint (&sampledata->writer, value.time / 60, 2);
+		dctool_writer_literal (&sampledata->writer, ":");
+		dctool_writer_uint (&sampledata->writer, value.time % 60, 2);
+		dctool_writer_literal (&sampledata->writer, "</time>\n");
 		break;
 	case DC_SAMPLE_DEPTH:
-		fprintf (sampledata->ostream, "   <depth>%.2f</depth>\n",
-			convert_depth(value.depth, sampledata->units));
+		dctool_writer_literal (&sampledata->writer, "   <depth>");
+		dctool_writer_fixed (&sampledata->writer, convert_depth(value.depth, sampledata->units), 2);
+		dctool_writer_literal (&sampledata->writer, "</depth>\n");
 		break;
 	case DC_SAMPLE_PRESSURE:
-		fprintf (sampledata->ostream, "   <pressure tank=\"%u\">%.2f</pressure>\n",
-			value.pressure.tank,
-			convert_pressure(value.pressure.value, sampledata->units));
+		dctool_writer_literal (&sampledata->writer, "   <pressure tank=\"");
+		dctool_writer_uint (&sampledata->writer, value.pressure.tank, 1);
+		dctool_writer_literal (&sampledata->writer, "\">");
+		dctool_writer_fixed (&sampledata->writer, convert_pressure(value.pressure.value, sampledata->units), 2);
+		dctool_writer_literal (&sampledata->writer, "</pressure>\n");
 		break;
 	case DC_SAMPLE_TEMPERATURE:
-		fprintf (sampledata->ostream, "   <temperature>%.2f</temperature>\n",
-			convert_temperature(value.temperature, sampledata->units));
+		dctool_writer_literal (&sampledata->writer, "   <temperature>");
+		dctool_writer_fixed (&sampledata->writer, convert_temperature(value.temperature, sampledata->units), 2);
+		dctool_writer_literal (&sampledata->writer, "</temperature>\n");
 		break;
 	case DC_SAMPLE_EVENT:
 		if (value.event.type != SAMPLE_EVENT_GASCHANGE && value.event.type != SAMPLE_EVENT_GASCHANGE2) {
-			fprintf (sampledata->ostream, "   <event type=\"%u\" time=\"%u\" flags=\"%u\" value=\"%u\">%s</event>\n",
-				value.event.type, value.event.time, value.event.flags, value.event.value, events[value.event.type]);
+			dctool_writer_literal (&sampledata->writer, "   <event type=\"");
+			dctool_writer_uint (&sampledata->writer, value.event.type, 1);
+			dctool_writer_literal (&sampledata->writer, "\" time=\"");
+			dctool_writer_uint (&sampledata->writer, value.event.time, 1);
+			dctool_writer_literal (&sampledata->writer, "\" flags=\"");
+			dctool_writer_uint (&sampledata->writer, value.event.flags, 1);
+			dctool_writer_literal (&sampledata->writer, "\" value=\"");
+			dctool_writer_uint (&sampledata->writer, value.event.value, 1);
+			dctool_writer_literal (&sampledata->writer, "\">");
+			dctool_writer_string (&sampledata->writer, events[value.event.type], strlen (events[value.event.type]));
+			dctool_writer_literal (&sampledata->writer, "</event>\n");
 		}
 		break;
 	case DC_SAMPLE_RBT:
-		fprintf (sampledata->ostream, "   <rbt>%u</rbt>\n", value.rbt);
+		dctool_writer_literal (&sampledata->writer, "   <rbt>");
+		dctool_writer_uint (&sampledata->writer, value.rbt, 1);
+		dctool_writer_literal (&sampledata->writer, "</rbt>\n");
 		break;
 	case DC_SAMPLE_HEARTBEAT:
-		fprintf (sampledata->ostream, "   <heartbeat>%u</heartbeat>\n", value.heartbeat);
+		dctool_writer_literal (&sampledata->writer, "   <heartbeat>");
+		dctool_writer_uint (&sampledata->writer, value.heartbeat, 1);
+		dctool_writer_literal (&sampledata->writer, "</heartbeat>\n");
 		break;
 	case DC_SAMPLE_BEARING:
-		fprintf (sampledata->ostream, "   <bearing>%u</bearing>\n", value.bearing);
+		dctool_writer_literal (&sampledata->writer, "   <bearing>");
+		dctool_writer_uint (&sampledata->writer, value.bearing, 1);
+		dctool_writer_literal (&sampledata->writer, "</bearing>\n");
 		break;
 	case DC_SAMPLE_VENDOR:
-		fprintf (sampledata->ostream, "   <vendor type=\"%u\" size=\"%u\">", value.vendor.type, value.vendor.size);
-		for (unsigned int i = 0; i < value.vendor.size; ++i)
-			fprintf (sampledata->ostream, "%02X", ((const unsigned char *) value.vendor.data)[i]);
-		fprintf (sampledata->ostream, "</vendor>\n");
+		dctool_writer_literal (&sampledata->writer, "   <vendor type=\"");
+		dctool_writer_uint (&sampledata->writer, value.vendor.type, 1);
+		dctool_writer_literal (&sampledata->writer, "\" size=\"");
+		dctool_writer_uint (&sampledata->writer, value.vendor.size, 1);
+		dctool_writer_literal (&sampledata->writer, "\">");
+		dctool_writer_hex (&sampledata->writer, (const unsigned char *) value.vendor.data, value.vendor.size);
+		dctool_writer_literal (&sampledata->writer, "</vendor>\n");
 		break;
 	case DC_SAMPLE_SETPOINT:
-		fprintf (sampledata->ostream, "   <setpoint>%.2f</setpoint>\n", value.setpoint);
+		dctool_writer_literal (&sampledata->writer, "   <setpoint>");
+		dctool_writer_fixed (&sampledata->writer, value.setpoint, 2);
+		dctool_writer_literal (&sampledata->writer, "</setpoint>\n");
 		break;
 	case DC_SAMPLE_PPO2:
-		fprintf (sampledata->ostream, "   <ppo2>%.2f</ppo2>\n", value.ppo2);
+		dctool_writer_literal (&sampledata->writer, "   <ppo2>");
+		dctool_writer_fixed (&sampledata->writer, value.ppo2, 2);
+		dctool_writer_literal (&sampledata->writer, "</ppo2>\n");
 		break;
 	case DC_SAMPLE_CNS:
-		fprintf (sampledata->ostream, "   <cns>%.1f</cns>\n", value.cns * 100.0);
+		dctool_writer_literal (&sampledata->writer, "   <cns>");
+		dctool_writer_fixed (&sampledata->writer, value.cns * 100.0, 1);
+		dctool_writer_literal (&sampledata->writer, "</cns>\n");
 		break;
 	case DC_SAMPLE_DECO:
-		fprintf (sampledata->ostream, "   <deco time=\"%u\" depth=\"%.2f\">%s</deco>\n",
-			value.deco.time,
-			convert_depth(value.deco.depth, sampledata->units),
-			decostop[value.deco.type]);
+		dctool_writer_literal (&sampledata->writer, "   <deco time=\"");
+		dctool_writer_uint (&sampledata->writer, value.deco.time, 1);
+		dctool_writer_literal (&sampledata->writer, "\" depth=\"");
+		dctool_writer_fixed (&sampledata->writer, convert_depth(value.deco.depth, sampledata->units), 2);
+		dctool_writer_literal (&sampledata->writer, "\">");
+		dctool_writer_string (&sampledata->writer, decostop[value.deco.type], strlen (decostop[value.deco.type]));
+		dctool_writer_literal (&sampledata->writer, "</deco>\n");
 		break;
 	case DC_SAMPLE_GASMIX:
-		fprintf (sampledata->ostream, "   <gasmix>%u</gasmix>\n", value.gasmix);
+		dctool_writer_literal (&sampledata->writer, "   <gasmix>");
+		dctool_writer_uint (&sampledata->writer, value.gasmix, 1);
+		dctool_writer_literal (&sampledata->writer, "</gasmix>\n");
 		break;
 	default:
 		break;
@@ -200,25 +241,34 @@ error_exit:
 	return NULL;
 }
 
+static void
+dctool_xml_write_number (FILE *ostream, unsigned int number)
+{
+	fprintf (ostream, "<dive>\n<number>%u</number>\n", number);
+}
+
+/*
+ * Write the remainder of a dive, after the dive number. The number is
+ * written separately, because it isn't known yet for a rendered dive.
+ */
 static dc_status_t
-dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+dctool_xml_write_dive (FILE *ostream, dctool_units_t units, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
 {
-	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
 	dc_status_t status = DC_STATUS_SUCCESS;
 
 	// Initialize the sample data.
 	sample_data_t sampledata = {0};
 	sampledata.nsamples = 0;
-	sampledata.ostream = output->ostream;
-	sampledata.units = output->units;
+	sampledata.units = units;
+	dctool_writer_init (&sampledata.writer, ostream);
 
-	fprintf (output->ostream, "<dive>\n<number>%u</number>\n<size>%u</size>\n", abstract->number, size);
+	fprintf (ostream, "<size>%u</size>\n", size);
 
 	if (fingerprint) {
-		fprintf (output->ostream, "<fingerprint>");
+		fprintf (ostream, "<fingerprint>");
 		for (unsigned int i = 0; i < fsize; ++i)
-			fprintf (output->ostream, "%02X", fingerprint[i]);
-		fprintf (output->ostream, "</fingerprint>\n");
+			fprintf (ostream, "%02X", fingerprint[i]);
+		fprintf (ostream, "</fingerprint>\n");
 	}
 
 	// Parse the datetime.
@@ -231,11 +281,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (dt.timezone == DC_TIMEZONE_NONE) {
-		fprintf (output->ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
+		fprintf (ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
 			dt.year, dt.month, dt.day,
 			dt.hour, dt.minute, dt.second);
 	} else {
-		fprintf (output->ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i %+03i:%02i</datetime>\n",
+		fprintf (ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i %+03i:%02i</datetime>\n",
 			dt.year, dt.month, dt.day,
 			dt.hour, dt.minute, dt.second,
 			dt.timezone / 3600, (dt.timezone % 3600) / 60);
@@ -250,7 +300,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<divetime>%02u:%02u</divetime>\n",
+	fprintf (ostream, "<divetime>%02u:%02u</divetime>\n",
 		divetime / 60, divetime % 60);
 
 	// Parse the maxdepth.
@@ -262,8 +312,8 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<maxdepth>%.2f</maxdepth>\n",
-		convert_depth(maxdepth, output->units));
+	fprintf (ostream, "<maxdepth>%.2f</maxdepth>\n",
+		convert_depth(maxdepth, units));
 
 	// Parse the avgdepth.
 	message ("Parsing the avgdepth.\n");
@@ -275,8 +325,8 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<avgdepth>%.2f</avgdepth>\n",
-			convert_depth(avgdepth, output->units));
+		fprintf (ostream, "<avgdepth>%.2f</avgdepth>\n",
+			convert_depth(avgdepth, units));
 	}
 
 	// Parse the temperature.
@@ -295,9 +345,9 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		}
 
 		if (status != DC_STATUS_UNSUPPORTED) {
-			fprintf (output->ostream, "<temperature type=\"%s\">%.1f</temperature>\n",
+			fprintf (ostream, "<temperature type=\"%s\">%.1f</temperature>\n",
 				names[i],
-				convert_temperature(temperature, output->units));
+				convert_temperature(temperature, units));
 		}
 	}
 
@@ -318,7 +368,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream,
+		fprintf (ostream,
 			"<gasmix>\n"
 			"   <he>%.1f</he>\n"
 			"   <o2>%.1f</o2>\n"
@@ -348,27 +398,27 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream, "<tank>\n");
+		fprintf (ostream, "<tank>\n");
 		if (tank.gasmix != DC_GASMIX_UNKNOWN) {
-			fprintf (output->ostream,
+			fprintf (ostream,
 				"   <gasmix>%u</gasmix>\n",
 				tank.gasmix);
 		}
 		if (tank.type != DC_TANKVOLUME_NONE) {
-			fprintf (output->ostream,
+			fprintf (ostream,
 				"   <type>%s</type>\n"
 				"   <volume>%.1f</volume>\n"
 				"   <workpressure>%.2f</workpressure>\n",
 				names[tank.type],
-				convert_volume(tank.volume, output->units),
-				convert_pressure(tank.workpressure, output->units));
+				convert_volume(tank.volume, units),
+				convert_pressure(tank.workpressure, units));
 		}
-		fprintf (output->ostream,
+		fprintf (ostream,
 			"   <beginpressure>%.2f</beginpressure>\n"
 			"   <endpressure>%.2f</endpressure>\n"
 			"</tank>\n",
-			convert_pressure(tank.beginpressure, output->units),
-			convert_pressure(tank.endpressure, output->units));
+			convert_pressure(tank.beginpressure, units),
+			convert_pressure(tank.endpressure, units));
 	}
 
 	// Parse the dive mode.
@@ -382,7 +432,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"freedive", "gauge", "oc", "ccr", "scr"};
-		fprintf (output->ostream, "<divemode>%s</divemode>\n",
+		fprintf (ostream, "<divemode>%s</divemode>\n",
 			names[divemode]);
 	}
 
@@ -396,7 +446,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<salinity type=\"%u\">%.1f</salinity>\n",
+		fprintf (ostream, "<salinity type=\"%u\">%.1f</salinity>\n",
 			salinity.type, salinity.density);
 	}
 
@@ -410,8 +460,8 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<atmospheric>%.5f</atmospheric>\n",
-			convert_pressure(atmospheric, output->units));
+		fprintf (ostream, "<atmospheric>%.5f</atmospheric>\n",
+			convert_pressure(atmospheric, units));
 	}
 
 	// Parse the sample data.
@@ -423,14 +473,44 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 cleanup:
+	dctool_writer_flush (&sampledata.writer);
+	dctool_writer_free (&sampledata.writer);
 
 	if (sampledata.nsamples)
-		fprintf (output->ostream, "</sample>\n");
-	fprintf (output->ostream, "</dive>\n");
+		fprintf (ostream, "</sample>\n");
+	fprintf (ostream, "</dive>\n");
 
 	return status;
 }
 
+static dc_status_t
+dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	dctool_xml_write_number (output->ostream, abstract->number);
+
+	return dctool_xml_write_dive (output->ostream, output->units, parser, data, size, fingerprint, fsize);
+}
+
+static dc_status_t
+dctool_xml_output_render (dctool_output_t *abstract, FILE *ostream, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	return dctool_xml_write_dive (ostream, output->units, parser, data, size, fingerprint, fsize);
+}
+
+static dc_status_t
+dctool_xml_output_append (dctool_output_t *abstract, FILE *fragment)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	dctool_xml_write_number (output->ostream, abstract->number);
+
+	return dctool_output_copy (output->ostream, fragment);
+}
+
 static dc_status_t
 dctool_xml_output_free (dctool_output_t *abstract)
 {
@@ -0,0 +1,209 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "common.h"
+#include "utils.h"
+
+#define WATERFALL 32
+
+typedef struct dctool_phase_t {
+	const char *name;
+	unsigned int dive;
+	double begin;
+	double elapsed;
+	unsigned int writes;
+	unsigned int reads;
+	unsigned long long bytes_in;
+	unsigned long long bytes_out;
+} dctool_phase_t;
+
+struct dctool_profile_t {
+	dc_iostream_t *iostream;
+	dc_iostream_stats_t stats;
+	double start;
+	double last;
+	dctool_phase_t *phases;
+	size_t count;
+	size_t capacity;
+};
+
+dctool_profile_t *
+dctool_profile_new (void)
+{
+	dctool_profile_t *profile = (dctool_profile_t *) malloc (sizeof (dctool_profile_t));
+	if (profile == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return NULL;
+	}
+
+	memset (profile, 0, sizeof (dctool_profile_t));
+	profile->start = profile->last = dctool_time ();
+
+	return profile;
+}
+
+void
+dctool_profile_free (dctool_profile_t *profile)
+{
+	if (profile == NULL)
+		return;
+
+	free (profile->phases);
+	free (profile);
+}
+
+void
+dctool_profile_set_iostream (dctool_profile_t *profile, dc_iostream_t *iostream)
+{
+	if (profile == NULL)
+		return;
+
+	// The statistics of a new I/O stream start from zero.
+	profile->iostream = iostream;
+	memset (&profile->stats, 0, sizeof (profile->stats));
+}
+
+void
+dctool_profile_mark (dctool_profile_t *profile, const char *name, unsigned int dive)
+{
+	if (profile == NULL)
+		return;
+
+	double now = dctool_time ();
+
+	dc_iostream_stats_t stats = profile->stats;
+	if (profile->iostream)
+		dc_iostream_get_stats (profile->iostream, &stats);
+
+	if (profile->count == profile->capacity) {
+		size_t capacity = profile->capacity ? profile->capacity * 2 : 64;
+		dctool_phase_t *phases = (dctool_phase_t *) realloc (profile->phases, capacity * sizeof (dctool_phase_t));
+		if (phases == NULL) {
+			ERROR ("Failed to allocate memory.");
+			return;
+		}
+		profile->phases = phases;
+		profile->capacity = capacity;
+	}
+
+	dctool_phase_t *phase = profile->phases + profile->count++;
+	phase->name = name;
+	phase->dive = dive;
+	phase->begin = profile->last - profile->start;
+	phase->elapsed = now - profile->last;
+	phase->writes = stats.writes - profile->stats.writes;
+	phase->reads = stats.reads - profile->stats.reads;
+	phase->bytes_in = stats.bytes_in - profile->stats.bytes_in;
+	phase->bytes_out = stats.bytes_out - profile->stats.bytes_out;
+
+	profile->stats = stats;
+	profile->last = now;
+}
+
+static void
+dctool_profile_bar (double begin, double elapsed, double total)
+{
+	unsigned int offset = 0, length = 0;
+	if (total > 0.0) {
+		offset = begin / total * WATERFALL;
+		length = elapsed / total * WATERFALL + 0.5;
+	}
+	if (offset >= WATERFALL)
+		offset = WATERFALL - 1;
+	if (length == 0)
+		length = 1;
+	if (offset + length > WATERFALL)
+		length = WATERFALL - offset;
+
+	char bar[WATERFALL + 1];
+	memset (bar, ' ', WATERFALL);
+	memset (bar + offset, '#', length);
+	bar[WATERFALL] = 0;
+
+	message ("|%s|", bar);
+}
+
+void
+dctool_profile_print (dctool_profile_t *profile)
+{
+	if (profile == NULL || profile->count == 0)
+		return;
+
+	const dctool_phase_t *last = profile->phases + profile->count - 1;
+	double total = last->begin + last->elapsed;
+
+	message ("Profile:\n");
+	message ("   %-10s %5s %10s %10s %7s %7s %10s %10s  %s\n",
+		"Phase", "Dive", "Start [ms]", "Time [ms]", "Writes", "Reads", "Bytes in", "Bytes out", "Waterfall");
+	for (size_t i = 0; i < profile->count; ++i) {
+		const dctool_phase_t *phase = profile->phases + i;
+		if (phase->dive)
+			message ("   %-10s %5u", phase->name, phase->dive);
+		else
+			message ("   %-10s %5s", phase->name, "-");
+		message (" %10.3f %10.3f %7u %7u %10llu %10llu  ",
+			phase->begin * 1000.0, phase->elapsed * 1000.0, phase->writes, phase->reads,
+			phase->bytes_in, phase->bytes_out);
+		dctool_profile_bar (phase->begin, phase->elapsed, total);
+		message ("\n");
+	}
+
+	// The totals per phase name, in the order of the first occurrence.
+	message ("Totals:\n");
+	message ("   %-10s %5s %10s %10s %7s %7s %10s %10s\n",
+		"Phase", "Count", "Share", "Time [ms]", "Writes", "Reads", "Bytes in", "Bytes out");
+	for (size_t i = 0; i < profile->count; ++i) {
+		const char *name = profile->phases[i].name;
+
+		size_t j = 0;
+		while (j < i && strcmp (profile->phases[j].name, name) != 0)
+			j++;
+		if (j < i)
+			continue;
+
+		dctool_phase_t sum = {name, 0, 0.0, 0.0, 0, 0, 0, 0};
+		unsigned int count = 0;
+		for (j = i; j < profile->count; ++j) {
+			const dctool_phase_t *phase = profile->phases + j;
+			if (strcmp (phase->name, name) != 0)
+				continue;
+			sum.elapsed += phase->elapsed;
+			sum.writes += phase->writes;
+			sum.reads += phase->reads;
+			sum.bytes_in += phase->bytes_in;
+			sum.bytes_out += phase->bytes_out;
+			count++;
+		}
+
+		message ("   %-10s %5u %9.1f%% %10.3f %7u %7u %10llu %10llu\n",
+			name, count, total > 0.0 ? sum.elapsed / total * 100.0 : 0.0,
+			sum.elapsed * 1000.0, sum.writes, sum.reads, sum.bytes_in, sum.bytes_out);
+	}
+	message ("   %-10s %5s %10s %10.3f\n", "total", "", "", total * 1000.0);
+}
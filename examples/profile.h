@@ -0,0 +1,69 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_PROFILE_H
+#define DCTOOL_PROFILE_H
+
+#include <libdivecomputer/iostream.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Timing profile of a download, as a sequence of phases. Every mark ends
+ * the current phase, and records the elapsed time and the I/O traffic
+ * since the previous mark. All functions accept a NULL profile, and then
+ * do nothing, so the profile can be disabled without extra checks.
+ */
+typedef struct dctool_profile_t dctool_profile_t;
+
+dctool_profile_t *
+dctool_profile_new (void);
+
+void
+dctool_profile_free (dctool_profile_t *profile);
+
+/*
+ * Attach the I/O stream. The traffic of a phase is the difference
+ * between the statistics of the I/O stream at both marks.
+ */
+void
+dctool_profile_set_iostream (dctool_profile_t *profile, dc_iostream_t *iostream);
+
+/*
+ * End the current phase. The name must be a static string. The dive
+ * number is zero for the phases which don't belong to a dive.
+ */
+void
+dctool_profile_mark (dctool_profile_t *profile, const char *name, unsigned int dive);
+
+/*
+ * Print the waterfall of all phases, followed by the totals per phase
+ * name.
+ */
+void
+dctool_profile_print (dctool_profile_t *profile);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_PROFILE_H */
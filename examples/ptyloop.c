@@ -0,0 +1,298 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+// The pty functions need the X/Open extensions, and cfmakeraw the
+// default (or Darwin) extensions on top of that.
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ptyloop.h"
+
+#if !defined(_WIN32) && defined(HAVE_PTHREAD_H) && defined(ENABLE_PTY)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+ * The pump thread moves the commands from the master side of the pty
+ * into the simulator, and the answers back. The simulator answers
+ * immediately, so the measured time is spent in the pty and in the
+ * serial I/O of the library. A second file descriptor for the slave
+ * side is kept open, to avoid a hangup while the serial port is not
+ * open yet.
+ */
+
+#define PTY_BUFSIZE 4096
+#define PTY_POLL    50 // ms
+
+struct dctool_ptyloop_t {
+	dc_iostream_t *iostream;
+	int master;
+	int slave;
+	char name[128];
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	int stop;
+	// Statistics.
+	unsigned long long bytes;
+	unsigned int syscalls;
+};
+
+static int
+ptyloop_write (dctool_ptyloop_t *ptyloop, const unsigned char data[], size_t size, unsigned int *syscalls)
+{
+	size_t nbytes = 0;
+	while (nbytes < size) {
+		ssize_t n = write (ptyloop->master, data + nbytes, size - nbytes);
+		(*syscalls)++;
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -1;
+		}
+		nbytes += n;
+	}
+
+	return 0;
+}
+
+static void *
+ptyloop_run (void *userdata)
+{
+	dctool_ptyloop_t *ptyloop = (dctool_ptyloop_t *) userdata;
+	unsigned char command[PTY_BUFSIZE], answer[PTY_BUFSIZE];
+
+	for (;;) {
+		unsigned int syscalls = 0;
+		unsigned long long bytes = 0;
+
+		pthread_mutex_lock (&ptyloop->mutex);
+		int stop = ptyloop->stop;
+		pthread_mutex_unlock (&ptyloop->mutex);
+		if (stop)
+			break;
+
+		struct pollfd fds = {ptyloop->master, POLLIN, 0};
+		int rc = poll (&fds, 1, PTY_POLL);
+		if (rc <= 0 || (fds.revents & POLLIN) == 0)
+			continue;
+
+		ssize_t n = read (ptyloop->master, command, sizeof (command));
+		syscalls++;
+		if (n <= 0)
+			continue;
+		bytes += n;
+
+		size_t nbytes = 0;
+		dc_iostream_write (ptyloop->iostream, command, n, &nbytes);
+
+		// Send the complete answer in a single write.
+		size_t available = 0;
+		while (dc_iostream_get_available (ptyloop->iostream, &available) == DC_STATUS_SUCCESS && available) {
+			if (available > sizeof (answer))
+				available = sizeof (answer);
+			dc_iostream_read (ptyloop->iostream, answer, available, &nbytes);
+			if (nbytes == 0 || ptyloop_write (ptyloop, answer, nbytes, &syscalls) != 0)
+				break;
+			bytes += nbytes;
+		}
+
+		pthread_mutex_lock (&ptyloop->mutex);
+		ptyloop->syscalls += syscalls;
+		ptyloop->bytes += bytes;
+		pthread_mutex_unlock (&ptyloop->mutex);
+	}
+
+	return NULL;
+}
+
+dc_status_t
+dctool_ptyloop_new (dctool_ptyloop_t **out, dc_context_t *context, dctool_simulator_t *simulator)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_ptyloop_t *ptyloop = NULL;
+
+	if (out == NULL || simulator == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	ptyloop = (dctool_ptyloop_t *) malloc (sizeof (dctool_ptyloop_t));
+	if (ptyloop == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	memset (ptyloop, 0, sizeof (dctool_ptyloop_t));
+	ptyloop->master = -1;
+	ptyloop->slave = -1;
+
+	// Create the pseudo terminal.
+	ptyloop->master = posix_openpt (O_RDWR | O_NOCTTY);
+	if (ptyloop->master < 0 || grantpt (ptyloop->master) != 0 || unlockpt (ptyloop->master) != 0) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+
+	const char *name = ptsname (ptyloop->master);
+	if (name == NULL || strlen (name) >= sizeof (ptyloop->name)) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+	strcpy (ptyloop->name, name);
+
+	// Switch to raw mode, until the serial port is configured.
+	ptyloop->slave = open (ptyloop->name, O_RDWR | O_NOCTTY);
+	if (ptyloop->slave < 0) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+
+	struct termios tty;
+	if (tcgetattr (ptyloop->slave, &tty) != 0) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+	cfmakeraw (&tty);
+	if (tcsetattr (ptyloop->slave, TCSANOW, &tty) != 0) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+
+	status = dctool_simulator_open (&ptyloop->iostream, context, simulator);
+	if (status != DC_STATUS_SUCCESS)
+		goto error;
+
+	pthread_mutex_init (&ptyloop->mutex, NULL);
+	if (pthread_create (&ptyloop->thread, NULL, ptyloop_run, ptyloop) != 0) {
+		pthread_mutex_destroy (&ptyloop->mutex);
+		status = DC_STATUS_NOMEMORY;
+		goto error;
+	}
+
+	*out = ptyloop;
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	dc_iostream_close (ptyloop->iostream);
+	if (ptyloop->slave >= 0)
+		close (ptyloop->slave);
+	if (ptyloop->master >= 0)
+		close (ptyloop->master);
+	free (ptyloop);
+	return status;
+}
+
+const char *
+dctool_ptyloop_get_name (dctool_ptyloop_t *ptyloop)
+{
+	return ptyloop->name;
+}
+
+void
+dctool_ptyloop_get_stats (dctool_ptyloop_t *ptyloop, dctool_ptyloop_stats_t *stats)
+{
+	pthread_mutex_lock (&ptyloop->mutex);
+	stats->bytes = ptyloop->bytes;
+	stats->syscalls = ptyloop->syscalls;
+	pthread_mutex_unlock (&ptyloop->mutex);
+}
+
+unsigned long long
+dctool_ptyloop_syscalls (void)
+{
+	unsigned long long syscr = 0, syscw = 0;
+
+	FILE *fp = fopen ("/proc/self/io", "r");
+	if (fp == NULL)
+		return 0;
+
+	char line[128];
+	while (fgets (line, sizeof (line), fp)) {
+		sscanf (line, "syscr: %llu", &syscr);
+		sscanf (line, "syscw: %llu", &syscw);
+	}
+
+	fclose (fp);
+
+	return syscr + syscw;
+}
+
+void
+dctool_ptyloop_free (dctool_ptyloop_t *ptyloop)
+{
+	if (ptyloop == NULL)
+		return;
+
+	pthread_mutex_lock (&ptyloop->mutex);
+	ptyloop->stop = 1;
+	pthread_mutex_unlock (&ptyloop->mutex);
+
+	pthread_join (ptyloop->thread, NULL);
+	pthread_mutex_destroy (&ptyloop->mutex);
+
+	dc_iostream_close (ptyloop->iostream);
+	close (ptyloop->slave);
+	close (ptyloop->master);
+	free (ptyloop);
+}
+
+#else
+
+dc_status_t
+dctool_ptyloop_new (dctool_ptyloop_t **out, dc_context_t *context, dctool_simulator_t *simulator)
+{
+	return DC_STATUS_UNSUPPORTED;
+}
+
+const char *
+dctool_ptyloop_get_name (dctool_ptyloop_t *ptyloop)
+{
+	return NULL;
+}
+
+void
+dctool_ptyloop_get_stats (dctool_ptyloop_t *ptyloop, dctool_ptyloop_stats_t *stats)
+{
+	memset (stats, 0, sizeof (*stats));
+}
+
+unsigned long long
+dctool_ptyloop_syscalls (void)
+{
+	return 0;
+}
+
+void
+dctool_ptyloop_free (dctool_ptyloop_t *ptyloop)
+{
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_PTYLOOP_H
+#define DCTOOL_PTYLOOP_H
+
+#include <libdivecomputer/context.h>
+
+#include "simulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dctool_ptyloop_t dctool_ptyloop_t;
+
+typedef struct dctool_ptyloop_stats_t {
+	unsigned long long bytes; // Number of bytes passed through the pty
+	unsigned int syscalls;    // Number of read and write calls of the simulator side
+} dctool_ptyloop_stats_t;
+
+/*
+ * Run the simulator on the master side of a pseudo terminal, in a
+ * background thread. The slave side is opened as a regular serial
+ * port, such that the real serial I/O path of the library is used.
+ * Only available on POSIX systems with thread support, and with the
+ * pseudo terminal support of the library enabled.
+ */
+dc_status_t
+dctool_ptyloop_new (dctool_ptyloop_t **ptyloop, dc_context_t *context, dctool_simulator_t *simulator);
+
+const char *
+dctool_ptyloop_get_name (dctool_ptyloop_t *ptyloop);
+
+void
+dctool_ptyloop_get_stats (dctool_ptyloop_t *ptyloop, dctool_ptyloop_stats_t *stats);
+
+/*
+ * Number of read and write system calls made by the process so far,
+ * or zero if unknown.
+ */
+unsigned long long
+dctool_ptyloop_syscalls (void);
+
+void
+dctool_ptyloop_free (dctool_ptyloop_t *ptyloop);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_PTYLOOP_H */
@@ -0,0 +1,409 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/custom.h>
+
+#include "simulator.h"
+
+/*
+ * The simulator emulates the wire protocol of a dive computer on top of
+ * a memory image, behind a custom I/O stream. No real time passes: the
+ * latency, the transfer time at the configured bandwidth, and the
+ * timeouts are accumulated in a virtual clock instead. Errors are
+ * injected with a seeded pseudo random generator, so every run with
+ * the same settings is identical.
+ */
+
+#define SIM_MAXCOMMAND 16
+#define SIM_MAXANSWER  (1 + 256 + 2)
+
+typedef struct dctool_simulator_t simulator_t;
+
+typedef struct simulator_protocol_t {
+	dc_family_t family;
+	// Returns the length of the command, or zero if incomplete.
+	size_t (*length) (simulator_t *sim, const unsigned char command[], size_t size);
+	// Builds the answer to a complete command.
+	size_t (*answer) (simulator_t *sim, const unsigned char command[], size_t size, unsigned char answer[]);
+} simulator_protocol_t;
+
+struct dctool_simulator_t {
+	const simulator_protocol_t *protocol;
+	const unsigned char *image;
+	size_t size;
+	unsigned char version[16];
+	// Link settings.
+	unsigned int latency; // us
+	unsigned int bandwidth; // bytes per second
+	unsigned int fixed;
+	double errors;
+	unsigned int random;
+	int timeout;
+	// Pending command and answer.
+	unsigned char command[SIM_MAXCOMMAND];
+	size_t ncommand;
+	unsigned char queue[SIM_MAXANSWER];
+	size_t nqueue, offset;
+	// Statistics.
+	unsigned long long clock; // us
+	unsigned int ncommands;
+	unsigned int ninjected;
+};
+
+static unsigned int
+simulator_random (simulator_t *sim)
+{
+	sim->random = sim->random * 1103515245 + 12345;
+	return (sim->random >> 16) & 0x7FFF;
+}
+
+static void
+simulator_wait (simulator_t *sim, int timeout)
+{
+	if (timeout > 0)
+		sim->clock += (unsigned long long) timeout * 1000;
+}
+
+static void
+simulator_process (simulator_t *sim)
+{
+	for (;;) {
+		size_t length = sim->protocol->length (sim, sim->command, sim->ncommand);
+		if (length == 0 || length > sim->ncommand)
+			break;
+
+		sim->ncommands++;
+
+		unsigned char answer[SIM_MAXANSWER];
+		size_t n = sim->protocol->answer (sim, sim->command, length, answer);
+
+		// The command and the answer travel over the link.
+		sim->clock += sim->latency;
+		if (sim->bandwidth)
+			sim->clock += (unsigned long long) (length + n) * 1000000 / sim->bandwidth;
+
+		// Inject an error: either the answer is lost, or a byte is corrupted.
+		if (n && sim->errors > 0.0 && simulator_random (sim) < sim->errors * 0x8000) {
+			sim->ninjected++;
+			if (simulator_random (sim) % 2)
+				n = 0;
+			else
+				answer[simulator_random (sim) % n] ^= 0x01;
+		}
+
+		if (sim->offset + sim->nqueue + n > sizeof (sim->queue)) {
+			memmove (sim->queue, sim->queue + sim->offset, sim->nqueue);
+			sim->offset = 0;
+		}
+		if (sim->nqueue + n <= sizeof (sim->queue)) {
+			memcpy (sim->queue + sim->offset + sim->nqueue, answer, n);
+			sim->nqueue += n;
+		}
+
+		memmove (sim->command, sim->command + length, sim->ncommand - length);
+		sim->ncommand -= length;
+	}
+}
+
+/*
+ * Oceanic Atom 2 family.
+ */
+
+#define OCEANIC_PAGESIZE 0x10
+#define OCEANIC_ACK      0x5A
+#define OCEANIC_NAK      0xA5
+
+static size_t
+simulator_oceanic_length (simulator_t *sim, const unsigned char command[], size_t size)
+{
+	if (size < 1)
+		return 0;
+
+	switch (command[0]) {
+	case 0x84: // Version
+		return 1;
+	case 0xE5: // Handshake
+		return 10;
+	default:
+		return 3;
+	}
+}
+
+static size_t
+simulator_oceanic_answer (simulator_t *sim, const unsigned char command[], size_t size, unsigned char answer[])
+{
+	size_t pagesize = 0, crc_size = 1;
+	const unsigned char *data = NULL;
+
+	switch (command[0]) {
+	case 0x84: // Version
+		data = sim->version;
+		pagesize = OCEANIC_PAGESIZE;
+		break;
+	case 0xB1: // Read
+	case 0xB4: // Read (8 pages)
+	case 0xB8: // Read (16 pages)
+		pagesize = OCEANIC_PAGESIZE * (command[0] == 0xB1 ? 1 : command[0] == 0xB4 ? 8 : 16);
+		crc_size = command[0] == 0xB8 ? 2 : 1;
+		size_t address = ((command[1] << 8) | command[2]) * OCEANIC_PAGESIZE;
+		if (address + pagesize > sim->size) {
+			answer[0] = OCEANIC_NAK;
+			return 1;
+		}
+		data = sim->image + address;
+		break;
+	case 0x91: // Keepalive
+	case 0xE5: // Handshake
+		answer[0] = OCEANIC_ACK;
+		return 1;
+	default: // Quit, and all unsupported commands
+		answer[0] = OCEANIC_NAK;
+		return 1;
+	}
+
+	answer[0] = OCEANIC_ACK;
+	memcpy (answer + 1, data, pagesize);
+
+	unsigned int crc = 0;
+	for (size_t i = 0; i < pagesize; ++i)
+		crc += data[i];
+	answer[1 + pagesize] = crc & 0xFF;
+	if (crc_size == 2)
+		answer[1 + pagesize + 1] = (crc >> 8) & 0xFF;
+
+	return 1 + pagesize + crc_size;
+}
+
+static const simulator_protocol_t g_protocols[] = {
+	{DC_FAMILY_OCEANIC_ATOM2, simulator_oceanic_length, simulator_oceanic_answer},
+};
+
+/*
+ * Custom I/O stream.
+ */
+
+static dc_status_t
+simulator_set_timeout (void *userdata, int timeout)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+
+	sim->timeout = timeout;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+simulator_set_lines (void *userdata, unsigned int value)
+{
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+simulator_get_available (void *userdata, size_t *value)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+
+	*value = sim->nqueue;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+simulator_configure (void *userdata, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+
+	// Without an explicit bandwidth, follow the serial line settings.
+	if (!sim->fixed)
+		sim->bandwidth = baudrate / (1 + databits + (parity != DC_PARITY_NONE) + (stopbits == DC_STOPBITS_ONE ? 1 : 2));
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+simulator_poll (void *userdata, int timeout)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+
+	if (sim->nqueue)
+		return DC_STATUS_SUCCESS;
+
+	simulator_wait (sim, timeout);
+
+	return DC_STATUS_TIMEOUT;
+}
+
+static dc_status_t
+simulator_read (void *userdata, void *data, size_t size, size_t *actual)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+
+	size_t n = size < sim->nqueue ? size : sim->nqueue;
+	memcpy (data, sim->queue + sim->offset, n);
+	sim->offset += n;
+	sim->nqueue -= n;
+	if (sim->nqueue == 0)
+		sim->offset = 0;
+
+	*actual = n;
+
+	if (n < size) {
+		simulator_wait (sim, sim->timeout);
+		return DC_STATUS_TIMEOUT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+simulator_write (void *userdata, const void *data, size_t size, size_t *actual)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+	const unsigned char *p = (const unsigned char *) data;
+
+	for (size_t i = 0; i < size; ++i) {
+		// Drop commands that are too long to be valid.
+		if (sim->ncommand == sizeof (sim->command))
+			sim->ncommand = 0;
+		sim->command[sim->ncommand++] = p[i];
+		simulator_process (sim);
+	}
+
+	*actual = size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+simulator_purge (void *userdata, dc_direction_t direction)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+
+	if (direction & DC_DIRECTION_INPUT) {
+		sim->nqueue = 0;
+		sim->offset = 0;
+	}
+
+	if (direction & DC_DIRECTION_OUTPUT) {
+		sim->ncommand = 0;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+simulator_sleep (void *userdata, unsigned int milliseconds)
+{
+	simulator_t *sim = (simulator_t *) userdata;
+
+	simulator_wait (sim, milliseconds);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static const dc_custom_cbs_t g_callbacks = {
+	simulator_set_timeout, /* set_timeout */
+	simulator_set_lines, /* set_break */
+	simulator_set_lines, /* set_dtr */
+	simulator_set_lines, /* set_rts */
+	NULL, /* get_lines */
+	simulator_get_available, /* get_available */
+	simulator_configure, /* configure */
+	simulator_poll, /* poll */
+	simulator_read, /* read */
+	simulator_write, /* write */
+	NULL, /* ioctl */
+	NULL, /* flush */
+	simulator_purge, /* purge */
+	simulator_sleep, /* sleep */
+	NULL, /* close */
+};
+
+dc_status_t
+dctool_simulator_new (dctool_simulator_t **out, dc_descriptor_t *descriptor, dc_buffer_t *image, const dctool_simulator_params_t *params)
+{
+	simulator_t *sim = NULL;
+
+	if (out == NULL || descriptor == NULL || image == NULL || params == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Find the protocol of the dive computer.
+	const simulator_protocol_t *protocol = NULL;
+	for (size_t i = 0; i < sizeof (g_protocols) / sizeof (g_protocols[0]); ++i) {
+		if (g_protocols[i].family == dc_descriptor_get_type (descriptor)) {
+			protocol = g_protocols + i;
+			break;
+		}
+	}
+	if (protocol == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	sim = (simulator_t *) malloc (sizeof (simulator_t));
+	if (sim == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	memset (sim, 0, sizeof (simulator_t));
+	sim->protocol = protocol;
+	sim->image = dc_buffer_get_data (image);
+	sim->size = dc_buffer_get_size (image);
+	sim->latency = params->latency * 1000;
+	sim->bandwidth = params->bandwidth;
+	sim->fixed = params->bandwidth != 0;
+	sim->errors = params->errors;
+	sim->random = params->seed;
+	sim->timeout = -1;
+	memset (sim->version, ' ', sizeof (sim->version));
+	if (params->version) {
+		size_t length = strlen (params->version);
+		memcpy (sim->version, params->version, length < sizeof (sim->version) ? length : sizeof (sim->version));
+	}
+
+	*out = sim;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dctool_simulator_open (dc_iostream_t **iostream, dc_context_t *context, dctool_simulator_t *simulator)
+{
+	return dc_custom_open (iostream, context, DC_TRANSPORT_SERIAL, &g_callbacks, simulator);
+}
+
+void
+dctool_simulator_get_stats (dctool_simulator_t *simulator, dctool_simulator_stats_t *stats)
+{
+	stats->clock = simulator->clock;
+	stats->commands = simulator->ncommands;
+	stats->injected = simulator->ninjected;
+}
+
+void
+dctool_simulator_free (dctool_simulator_t *simulator)
+{
+	free (simulator);
+}
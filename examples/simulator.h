@@ -0,0 +1,65 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_SIMULATOR_H
+#define DCTOOL_SIMULATOR_H
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/iostream.h>
+#include <libdivecomputer/buffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dctool_simulator_t dctool_simulator_t;
+
+typedef struct dctool_simulator_params_t {
+	const char *version;    // Version string of the device
+	unsigned int latency;   // Latency per packet (milliseconds)
+	unsigned int bandwidth; // Bandwidth (bytes per second, zero for the line settings)
+	double errors;          // Fraction of corrupted or lost packets
+	unsigned int seed;      // Seed for the error injection
+} dctool_simulator_params_t;
+
+typedef struct dctool_simulator_stats_t {
+	unsigned long long clock; // Simulated time (microseconds)
+	unsigned int commands;    // Number of commands
+	unsigned int injected;    // Number of injected errors
+} dctool_simulator_stats_t;
+
+dc_status_t
+dctool_simulator_new (dctool_simulator_t **simulator, dc_descriptor_t *descriptor, dc_buffer_t *image, const dctool_simulator_params_t *params);
+
+dc_status_t
+dctool_simulator_open (dc_iostream_t **iostream, dc_context_t *context, dctool_simulator_t *simulator);
+
+void
+dctool_simulator_get_stats (dctool_simulator_t *simulator, dctool_simulator_stats_t *stats);
+
+void
+dctool_simulator_free (dctool_simulator_t *simulator);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_SIMULATOR_H */
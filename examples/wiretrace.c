@@ -0,0 +1,940 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <libdivecomputer/custom.h>
+
+#include "wiretrace.h"
+#include "common.h"
+#include "utils.h"
+
+/*
+ * The trace file starts with a header, with the magic "DCWT", the
+ * version and the transport type. Every call on the I/O stream is
+ * stored as a record, with the type, the status and the duration
+ * (microseconds), followed by the arguments of the call, and the data
+ * which was received, transmitted or returned by an ioctl. Apart from
+ * the type, all numbers are variable length integers (7 bits per byte,
+ * least significant first), and the signed numbers are zigzag encoded.
+ *
+ * The replay serves the received data as a byte stream, and compares
+ * the transmitted data against the trace, so a backend which reads or
+ * writes in different chunks still replays correctly. The other calls
+ * are matched against the records up to the next data record. Calls
+ * which differ from the trace are counted as divergences.
+ */
+
+#define WT_MAGIC   "DCWT"
+#define WT_VERSION 1
+#define WT_MAXARGS 5
+
+typedef enum wiretrace_type_t {
+	WT_SET_TIMEOUT = 1,
+	WT_SET_BREAK,
+	WT_SET_DTR,
+	WT_SET_RTS,
+	WT_GET_LINES,
+	WT_GET_AVAILABLE,
+	WT_CONFIGURE,
+	WT_POLL,
+	WT_READ,
+	WT_WRITE,
+	WT_IOCTL,
+	WT_FLUSH,
+	WT_PURGE,
+	WT_SLEEP,
+	WT_NTYPES
+} wiretrace_type_t;
+
+// Number of arguments per record type.
+static const unsigned int g_nargs[WT_NTYPES] = {
+	0, /* unused */
+	1, /* set_timeout */
+	1, /* set_break */
+	1, /* set_dtr */
+	1, /* set_rts */
+	1, /* get_lines */
+	1, /* get_available */
+	5, /* configure */
+	1, /* poll */
+	2, /* read: size, actual */
+	2, /* write: size, actual */
+	2, /* ioctl: request, size */
+	0, /* flush */
+	1, /* purge */
+	1, /* sleep */
+};
+
+static unsigned long long
+wiretrace_zigzag (long long value)
+{
+	return value < 0 ? ((unsigned long long) -(value + 1) << 1) | 1 : (unsigned long long) value << 1;
+}
+
+static long long
+wiretrace_unzigzag (unsigned long long value)
+{
+	return (value & 1) ? -(long long) (value >> 1) - 1 : (long long) (value >> 1);
+}
+
+static size_t
+wiretrace_varint_set (unsigned char data[], unsigned long long value)
+{
+	size_t n = 0;
+	while (value >= 0x80) {
+		data[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	data[n++] = value;
+	return n;
+}
+
+static int
+wiretrace_varint_get (const unsigned char **data, const unsigned char *end, unsigned long long *value)
+{
+	unsigned long long result = 0;
+	unsigned int shift = 0;
+
+	while (*data < end && shift < 64) {
+		unsigned char byte = *(*data)++;
+		result |= (unsigned long long) (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return 1;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+/*
+ * Recording I/O stream.
+ */
+
+typedef struct recorder_t {
+	dc_iostream_t *base;
+	FILE *fp;
+	unsigned int errors;
+} recorder_t;
+
+static void
+recorder_emit (recorder_t *recorder, wiretrace_type_t type, dc_status_t status, double begin, const unsigned long long args[], const void *data, size_t size)
+{
+	unsigned char header[1 + 10 * (2 + WT_MAXARGS)];
+	size_t n = 0;
+
+	double duration = (dctool_time () - begin) * 1000000.0;
+
+	header[n++] = type;
+	n += wiretrace_varint_set (header + n, wiretrace_zigzag (status));
+	n += wiretrace_varint_set (header + n, duration > 0.0 ? (unsigned long long) duration : 0);
+	for (unsigned int i = 0; i < g_nargs[type]; ++i)
+		n += wiretrace_varint_set (header + n, args[i]);
+
+	if (fwrite (header, 1, n, recorder->fp) != n ||
+		(size && fwrite (data, 1, size, recorder->fp) != size)) {
+		recorder->errors++;
+	}
+}
+
+static dc_status_t
+recorder_set_timeout (void *userdata, int timeout)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_set_timeout (recorder->base, timeout);
+	unsigned long long args[] = {wiretrace_zigzag (timeout)};
+	recorder_emit (recorder, WT_SET_TIMEOUT, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_set_break (void *userdata, unsigned int value)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_set_break (recorder->base, value);
+	unsigned long long args[] = {value};
+	recorder_emit (recorder, WT_SET_BREAK, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_set_dtr (void *userdata, unsigned int value)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_set_dtr (recorder->base, value);
+	unsigned long long args[] = {value};
+	recorder_emit (recorder, WT_SET_DTR, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_set_rts (void *userdata, unsigned int value)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_set_rts (recorder->base, value);
+	unsigned long long args[] = {value};
+	recorder_emit (recorder, WT_SET_RTS, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_get_lines (void *userdata, unsigned int *value)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	unsigned int lines = 0;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_get_lines (recorder->base, &lines);
+	unsigned long long args[] = {lines};
+	recorder_emit (recorder, WT_GET_LINES, status, begin, args, NULL, 0);
+	*value = lines;
+	return status;
+}
+
+static dc_status_t
+recorder_get_available (void *userdata, size_t *value)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	size_t available = 0;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_get_available (recorder->base, &available);
+	unsigned long long args[] = {available};
+	recorder_emit (recorder, WT_GET_AVAILABLE, status, begin, args, NULL, 0);
+	*value = available;
+	return status;
+}
+
+static dc_status_t
+recorder_configure (void *userdata, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_configure (recorder->base, baudrate, databits, parity, stopbits, flowcontrol);
+	unsigned long long args[] = {baudrate, databits, parity, stopbits, flowcontrol};
+	recorder_emit (recorder, WT_CONFIGURE, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_poll (void *userdata, int timeout)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_poll (recorder->base, timeout);
+	unsigned long long args[] = {wiretrace_zigzag (timeout)};
+	recorder_emit (recorder, WT_POLL, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_read (void *userdata, void *data, size_t size, size_t *actual)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	size_t nbytes = 0;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_read (recorder->base, data, size, &nbytes);
+	unsigned long long args[] = {size, nbytes};
+	recorder_emit (recorder, WT_READ, status, begin, args, data, nbytes);
+	*actual = nbytes;
+	return status;
+}
+
+static dc_status_t
+recorder_write (void *userdata, const void *data, size_t size, size_t *actual)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	size_t nbytes = 0;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_write (recorder->base, data, size, &nbytes);
+	unsigned long long args[] = {size, nbytes};
+	recorder_emit (recorder, WT_WRITE, status, begin, args, data, nbytes);
+	*actual = nbytes;
+	return status;
+}
+
+static dc_status_t
+recorder_ioctl (void *userdata, unsigned int request, void *data, size_t size)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_ioctl (recorder->base, request, data, size);
+	unsigned long long args[] = {request, data ? size : 0};
+	recorder_emit (recorder, WT_IOCTL, status, begin, args, data, data ? size : 0);
+	return status;
+}
+
+static dc_status_t
+recorder_flush (void *userdata)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_flush (recorder->base);
+	recorder_emit (recorder, WT_FLUSH, status, begin, NULL, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_purge (void *userdata, dc_direction_t direction)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_purge (recorder->base, direction);
+	unsigned long long args[] = {direction};
+	recorder_emit (recorder, WT_PURGE, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_sleep (void *userdata, unsigned int milliseconds)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+	double begin = dctool_time ();
+	dc_status_t status = dc_iostream_sleep (recorder->base, milliseconds);
+	unsigned long long args[] = {milliseconds};
+	recorder_emit (recorder, WT_SLEEP, status, begin, args, NULL, 0);
+	return status;
+}
+
+static dc_status_t
+recorder_close (void *userdata)
+{
+	recorder_t *recorder = (recorder_t *) userdata;
+
+	dc_status_t status = dc_iostream_close (recorder->base);
+
+	if (fclose (recorder->fp) != 0)
+		recorder->errors++;
+	if (recorder->errors)
+		message ("Failed to write the wire trace.\n");
+
+	free (recorder);
+
+	return status;
+}
+
+static const dc_custom_cbs_t g_recorder_callbacks = {
+	recorder_set_timeout, /* set_timeout */
+	recorder_set_break, /* set_break */
+	recorder_set_dtr, /* set_dtr */
+	recorder_set_rts, /* set_rts */
+	recorder_get_lines, /* get_lines */
+	recorder_get_available, /* get_available */
+	recorder_configure, /* configure */
+	recorder_poll, /* poll */
+	recorder_read, /* read */
+	recorder_write, /* write */
+	recorder_ioctl, /* ioctl */
+	recorder_flush, /* flush */
+	recorder_purge, /* purge */
+	recorder_sleep, /* sleep */
+	recorder_close, /* close */
+};
+
+dc_status_t
+dctool_wiretrace_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	recorder_t *recorder = NULL;
+
+	if (out == NULL || base == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	recorder = (recorder_t *) malloc (sizeof (recorder_t));
+	if (recorder == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	recorder->base = base;
+	recorder->errors = 0;
+	recorder->fp = fopen (filename, "wb");
+	if (recorder->fp == NULL) {
+		free (recorder);
+		return DC_STATUS_IO;
+	}
+
+	dc_transport_t transport = dc_iostream_get_transport (base);
+
+	unsigned char header[4 + 1 + 10];
+	size_t n = 0;
+	memcpy (header, WT_MAGIC, 4);
+	n += 4;
+	header[n++] = WT_VERSION;
+	n += wiretrace_varint_set (header + n, transport);
+	if (fwrite (header, 1, n, recorder->fp) != n) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+
+	status = dc_custom_open (out, context, transport, &g_recorder_callbacks, recorder);
+	if (status != DC_STATUS_SUCCESS)
+		goto error;
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	fclose (recorder->fp);
+	free (recorder);
+	return status;
+}
+
+/*
+ * Replaying I/O stream.
+ */
+
+typedef struct replay_record_t {
+	wiretrace_type_t type;
+	dc_status_t status;
+	unsigned long long duration;
+	unsigned long long args[WT_MAXARGS];
+	const unsigned char *data;
+	size_t size;
+} replay_record_t;
+
+struct dctool_replay_t {
+	unsigned char *buffer;
+	dc_transport_t transport;
+	replay_record_t *records;
+	size_t count;
+	double timescale;
+	// Replay state.
+	size_t index, offset;
+	int timeout;
+	double debt; // us
+	// Statistics.
+	unsigned long long clock; // us
+	unsigned int replayed;
+	unsigned int diverged;
+};
+
+static void
+replay_delay (dctool_replay_t *replay, unsigned long long duration)
+{
+	replay->clock += duration;
+
+	if (replay->timescale <= 0.0)
+		return;
+
+	// Short delays are accumulated, to avoid sleeping for every call.
+	replay->debt += duration * replay->timescale;
+	if (replay->debt < 1000.0)
+		return;
+
+#ifdef _WIN32
+	Sleep ((DWORD) (replay->debt / 1000.0));
+#else
+	struct timespec ts;
+	ts.tv_sec = (time_t) (replay->debt / 1000000.0);
+	ts.tv_nsec = (long) (replay->debt - ts.tv_sec * 1000000.0) * 1000;
+	nanosleep (&ts, NULL);
+#endif
+	replay->debt = 0.0;
+}
+
+static int
+replay_isdata (const replay_record_t *record)
+{
+	return record->type == WT_READ || record->type == WT_WRITE;
+}
+
+static replay_record_t *
+replay_current (dctool_replay_t *replay)
+{
+	return replay->index < replay->count ? replay->records + replay->index : NULL;
+}
+
+static void
+replay_next (dctool_replay_t *replay)
+{
+	replay->index++;
+	replay->offset = 0;
+	replay->replayed++;
+}
+
+/*
+ * Skip the calls before the next data record, which were not made
+ * during the replay.
+ */
+static replay_record_t *
+replay_skip (dctool_replay_t *replay)
+{
+	while (replay->index < replay->count && !replay_isdata (replay->records + replay->index)) {
+		replay->index++;
+		replay->offset = 0;
+		replay->diverged++;
+	}
+
+	return replay_current (replay);
+}
+
+/*
+ * Find the record of a call, before the next data record.
+ */
+static replay_record_t *
+replay_find (dctool_replay_t *replay, wiretrace_type_t type, unsigned long long request)
+{
+	for (size_t i = replay->index; i < replay->count; ++i) {
+		replay_record_t *record = replay->records + i;
+		if (replay_isdata (record))
+			break;
+
+		if (record->type == type && (type != WT_IOCTL || record->args[0] == request)) {
+			replay->diverged += i - replay->index;
+			replay->index = i;
+			replay_delay (replay, record->duration);
+			replay_next (replay);
+			return record;
+		}
+	}
+
+	replay->diverged++;
+
+	return NULL;
+}
+
+static dc_status_t
+replay_control (dctool_replay_t *replay, wiretrace_type_t type)
+{
+	replay_record_t *record = replay_find (replay, type, 0);
+	return record ? record->status : DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+replay_set_timeout (void *userdata, int timeout)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+
+	replay->timeout = timeout;
+
+	return replay_control (replay, WT_SET_TIMEOUT);
+}
+
+static dc_status_t
+replay_set_break (void *userdata, unsigned int value)
+{
+	return replay_control ((dctool_replay_t *) userdata, WT_SET_BREAK);
+}
+
+static dc_status_t
+replay_set_dtr (void *userdata, unsigned int value)
+{
+	return replay_control ((dctool_replay_t *) userdata, WT_SET_DTR);
+}
+
+static dc_status_t
+replay_set_rts (void *userdata, unsigned int value)
+{
+	return replay_control ((dctool_replay_t *) userdata, WT_SET_RTS);
+}
+
+static dc_status_t
+replay_get_lines (void *userdata, unsigned int *value)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+
+	replay_record_t *record = replay_find (replay, WT_GET_LINES, 0);
+	if (record == NULL) {
+		*value = 0;
+		return DC_STATUS_SUCCESS;
+	}
+
+	*value = record->args[0];
+
+	return record->status;
+}
+
+static dc_status_t
+replay_get_available (void *userdata, size_t *value)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+
+	replay_record_t *record = replay_find (replay, WT_GET_AVAILABLE, 0);
+	if (record == NULL) {
+		// Report the remainder of the pending read.
+		record = replay_current (replay);
+		*value = record && record->type == WT_READ ? record->size - replay->offset : 0;
+		return DC_STATUS_SUCCESS;
+	}
+
+	*value = record->args[0];
+
+	return record->status;
+}
+
+static dc_status_t
+replay_configure (void *userdata, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	return replay_control ((dctool_replay_t *) userdata, WT_CONFIGURE);
+}
+
+static dc_status_t
+replay_poll (void *userdata, int timeout)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+
+	replay_record_t *record = replay_find (replay, WT_POLL, 0);
+	if (record)
+		return record->status;
+
+	record = replay_current (replay);
+	if (record && record->type == WT_READ && record->size > replay->offset)
+		return DC_STATUS_SUCCESS;
+
+	replay_delay (replay, timeout > 0 ? timeout * 1000ULL : 0);
+
+	return DC_STATUS_TIMEOUT;
+}
+
+static dc_status_t
+replay_read (void *userdata, void *data, size_t size, size_t *actual)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned char *p = (unsigned char *) data;
+	size_t nbytes = 0;
+
+	while (nbytes < size) {
+		replay_record_t *record = replay_skip (replay);
+		if (record == NULL || record->type != WT_READ) {
+			// The device doesn't send anything until the next command.
+			replay->diverged++;
+			replay_delay (replay, replay->timeout > 0 ? replay->timeout * 1000ULL : 0);
+			status = DC_STATUS_TIMEOUT;
+			break;
+		}
+
+		if (replay->offset == 0)
+			replay_delay (replay, record->duration);
+
+		size_t n = record->size - replay->offset;
+		if (n > size - nbytes)
+			n = size - nbytes;
+		memcpy (p + nbytes, record->data + replay->offset, n);
+		replay->offset += n;
+		nbytes += n;
+
+		// A recorded read which returned less data than requested ends
+		// with a timeout (or an error), unless this read is satisfied.
+		if (replay->offset == record->size) {
+			replay_next (replay);
+			if (nbytes < size && (record->status != DC_STATUS_SUCCESS || record->size < record->args[0])) {
+				status = record->status;
+				break;
+			}
+		}
+	}
+
+	*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+replay_write (void *userdata, const void *data, size_t size, size_t *actual)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	const unsigned char *p = (const unsigned char *) data;
+	unsigned int mismatch = 0;
+	size_t nbytes = 0;
+
+	// The remaining data of the previous answer was never read.
+	replay_record_t *record = replay_skip (replay);
+	while (record && record->type == WT_READ) {
+		mismatch = 1;
+		replay_next (replay);
+		record = replay_skip (replay);
+	}
+
+	while (nbytes < size && record && record->type == WT_WRITE) {
+		if (replay->offset == 0)
+			replay_delay (replay, record->duration);
+
+		size_t n = record->size - replay->offset;
+		if (n > size - nbytes)
+			n = size - nbytes;
+		if (memcmp (p + nbytes, record->data + replay->offset, n) != 0)
+			mismatch = 1;
+		replay->offset += n;
+		nbytes += n;
+
+		if (replay->offset == record->size) {
+			replay_next (replay);
+			if (record->status != DC_STATUS_SUCCESS) {
+				status = record->status;
+				break;
+			}
+			record = replay_current (replay);
+		}
+	}
+
+	if (status == DC_STATUS_SUCCESS) {
+		if (nbytes < size)
+			mismatch = 1;
+		nbytes = size;
+	}
+
+	if (mismatch)
+		replay->diverged++;
+
+	*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+replay_ioctl (void *userdata, unsigned int request, void *data, size_t size)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+
+	replay_record_t *record = replay_find (replay, WT_IOCTL, request);
+	if (record == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (data && size) {
+		size_t n = record->size < size ? record->size : size;
+		memcpy (data, record->data, n);
+	}
+
+	return record->status;
+}
+
+static dc_status_t
+replay_flush (void *userdata)
+{
+	return replay_control ((dctool_replay_t *) userdata, WT_FLUSH);
+}
+
+static dc_status_t
+replay_purge (void *userdata, dc_direction_t direction)
+{
+	return replay_control ((dctool_replay_t *) userdata, WT_PURGE);
+}
+
+static dc_status_t
+replay_sleep (void *userdata, unsigned int milliseconds)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) userdata;
+
+	replay_record_t *record = replay_find (replay, WT_SLEEP, 0);
+	if (record == NULL) {
+		replay_delay (replay, milliseconds * 1000ULL);
+		return DC_STATUS_SUCCESS;
+	}
+
+	return record->status;
+}
+
+static const dc_custom_cbs_t g_replay_callbacks = {
+	replay_set_timeout, /* set_timeout */
+	replay_set_break, /* set_break */
+	replay_set_dtr, /* set_dtr */
+	replay_set_rts, /* set_rts */
+	replay_get_lines, /* get_lines */
+	replay_get_available, /* get_available */
+	replay_configure, /* configure */
+	replay_poll, /* poll */
+	replay_read, /* read */
+	replay_write, /* write */
+	replay_ioctl, /* ioctl */
+	replay_flush, /* flush */
+	replay_purge, /* purge */
+	replay_sleep, /* sleep */
+	NULL, /* close */
+};
+
+static dc_status_t
+replay_parse (dctool_replay_t *replay, const unsigned char *data, size_t size)
+{
+	const unsigned char *p = data, *end = data + size;
+	unsigned long long value = 0;
+	size_t capacity = 0;
+
+	if (size < 5 || memcmp (p, WT_MAGIC, 4) != 0 || p[4] != WT_VERSION)
+		return DC_STATUS_DATAFORMAT;
+	p += 5;
+
+	if (!wiretrace_varint_get (&p, end, &value))
+		return DC_STATUS_DATAFORMAT;
+	replay->transport = value;
+
+	while (p < end) {
+		if (replay->count == capacity) {
+			size_t n = capacity ? capacity * 2 : 1024;
+			replay_record_t *records = (replay_record_t *) realloc (replay->records, n * sizeof (replay_record_t));
+			if (records == NULL)
+				return DC_STATUS_NOMEMORY;
+			replay->records = records;
+			capacity = n;
+		}
+
+		replay_record_t *record = replay->records + replay->count;
+		memset (record, 0, sizeof (replay_record_t));
+
+		record->type = *p++;
+		if (record->type == 0 || record->type >= WT_NTYPES)
+			return DC_STATUS_DATAFORMAT;
+
+		if (!wiretrace_varint_get (&p, end, &value))
+			return DC_STATUS_DATAFORMAT;
+		record->status = wiretrace_unzigzag (value);
+
+		if (!wiretrace_varint_get (&p, end, &record->duration))
+			return DC_STATUS_DATAFORMAT;
+
+		for (unsigned int i = 0; i < g_nargs[record->type]; ++i) {
+			if (!wiretrace_varint_get (&p, end, &record->args[i]))
+				return DC_STATUS_DATAFORMAT;
+		}
+
+		if (record->type == WT_READ || record->type == WT_WRITE || record->type == WT_IOCTL) {
+			if (record->args[1] > (size_t) (end - p))
+				return DC_STATUS_DATAFORMAT;
+			record->data = p;
+			record->size = record->args[1];
+			p += record->size;
+		}
+
+		replay->count++;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dctool_replay_new (dctool_replay_t **out, const char *filename, double timescale)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_replay_t *replay = NULL;
+	FILE *fp = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	replay = (dctool_replay_t *) malloc (sizeof (dctool_replay_t));
+	if (replay == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	memset (replay, 0, sizeof (dctool_replay_t));
+	replay->timescale = timescale;
+	replay->timeout = -1;
+
+	// Read the entire trace file.
+	fp = fopen (filename, "rb");
+	if (fp == NULL) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+
+	size_t size = 0, capacity = 0;
+	for (;;) {
+		if (size == capacity) {
+			size_t n = capacity ? capacity * 2 : 65536;
+			unsigned char *buffer = (unsigned char *) realloc (replay->buffer, n);
+			if (buffer == NULL) {
+				status = DC_STATUS_NOMEMORY;
+				goto error;
+			}
+			replay->buffer = buffer;
+			capacity = n;
+		}
+
+		size_t n = fread (replay->buffer + size, 1, capacity - size, fp);
+		if (n == 0)
+			break;
+		size += n;
+	}
+
+	if (ferror (fp)) {
+		status = DC_STATUS_IO;
+		goto error;
+	}
+
+	status = replay_parse (replay, replay->buffer, size);
+	if (status != DC_STATUS_SUCCESS)
+		goto error;
+
+	fclose (fp);
+
+	*out = replay;
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	if (fp)
+		fclose (fp);
+	dctool_replay_free (replay);
+	return status;
+}
+
+dc_transport_t
+dctool_replay_get_transport (dctool_replay_t *replay)
+{
+	return replay->transport;
+}
+
+dc_status_t
+dctool_replay_open (dc_iostream_t **iostream, dc_context_t *context, dctool_replay_t *replay)
+{
+	replay->index = 0;
+	replay->offset = 0;
+	replay->timeout = -1;
+	replay->debt = 0.0;
+	replay->clock = 0;
+	replay->replayed = 0;
+	replay->diverged = 0;
+
+	return dc_custom_open (iostream, context, replay->transport, &g_replay_callbacks, replay);
+}
+
+void
+dctool_replay_get_stats (dctool_replay_t *replay, dctool_replay_stats_t *stats)
+{
+	stats->clock = replay->clock;
+	stats->records = replay->count;
+	stats->replayed = replay->replayed;
+	stats->diverged = replay->diverged;
+}
+
+void
+dctool_replay_free (dctool_replay_t *replay)
+{
+	if (replay == NULL)
+		return;
+
+	free (replay->records);
+	free (replay->buffer);
+	free (replay);
+}
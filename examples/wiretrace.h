@@ -0,0 +1,71 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_WIRETRACE_H
+#define DCTOOL_WIRETRACE_H
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/iostream.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dctool_replay_t dctool_replay_t;
+
+typedef struct dctool_replay_stats_t {
+	unsigned long long clock; // Recorded time of the replayed calls (microseconds)
+	unsigned int records;     // Number of records in the trace
+	unsigned int replayed;    // Number of replayed records
+	unsigned int diverged;    // Number of calls which differ from the trace
+} dctool_replay_stats_t;
+
+/*
+ * Record every call on the I/O stream, with its duration, to a trace
+ * file. The new I/O stream takes ownership of the base stream.
+ */
+dc_status_t
+dctool_wiretrace_open (dc_iostream_t **iostream, dc_context_t *context, dc_iostream_t *base, const char *filename);
+
+/*
+ * Load a trace file for replay. The time scale is applied to the
+ * recorded durations: one for the original timing, a smaller value to
+ * compress the timing, and zero to replay without any delays.
+ */
+dc_status_t
+dctool_replay_new (dctool_replay_t **replay, const char *filename, double timescale);
+
+dc_transport_t
+dctool_replay_get_transport (dctool_replay_t *replay);
+
+dc_status_t
+dctool_replay_open (dc_iostream_t **iostream, dc_context_t *context, dctool_replay_t *replay);
+
+void
+dctool_replay_get_stats (dctool_replay_t *replay, dctool_replay_stats_t *stats);
+
+void
+dctool_replay_free (dctool_replay_t *replay);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_WIRETRACE_H */
@@ -0,0 +1,202 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "writer.h"
+
+#define WRITER_SIZE 4096
+
+void
+dctool_writer_init (dctool_writer_t *writer, FILE *ostream)
+{
+	writer->ostream = ostream;
+	writer->data = NULL;
+	writer->size = 0;
+	writer->capacity = 0;
+	writer->error = 0;
+}
+
+void
+dctool_writer_free (dctool_writer_t *writer)
+{
+	free (writer->data);
+	writer->data = NULL;
+	writer->size = 0;
+	writer->capacity = 0;
+}
+
+void
+dctool_writer_clear (dctool_writer_t *writer)
+{
+	writer->size = 0;
+}
+
+void
+dctool_writer_flush (dctool_writer_t *writer)
+{
+	if (writer->ostream && writer->size) {
+		if (fwrite (writer->data, 1, writer->size, writer->ostream) != writer->size)
+			writer->error = 1;
+		writer->size = 0;
+	}
+}
+
+static char *
+dctool_writer_reserve (dctool_writer_t *writer, size_t n)
+{
+	if (n <= writer->capacity - writer->size)
+		return writer->data + writer->size;
+
+	// Flush the buffer to the output stream first, and only grow the
+	// buffer if that's not sufficient.
+	dctool_writer_flush (writer);
+	if (n <= writer->capacity - writer->size)
+		return writer->data + writer->size;
+
+	size_t capacity = writer->capacity ? writer->capacity * 2 : WRITER_SIZE;
+	if (capacity < writer->size + n)
+		capacity = writer->size + n;
+
+	char *data = (char *) realloc (writer->data, capacity);
+	if (data == NULL) {
+		writer->error = 1;
+		return NULL;
+	}
+
+	writer->data = data;
+	writer->capacity = capacity;
+
+	return writer->data + writer->size;
+}
+
+void
+dctool_writer_string (dctool_writer_t *writer, const char *s, size_t n)
+{
+	if (n == 0)
+		return;
+
+	char *p = dctool_writer_reserve (writer, n);
+	if (p == NULL)
+		return;
+
+	memcpy (p, s, n);
+	writer->size += n;
+}
+
+void
+dctool_writer_append (dctool_writer_t *writer, const dctool_writer_t *other)
+{
+	dctool_writer_string (writer, other->data, other->size);
+}
+
+/*
+ * Append an unsigned integer in decimal, padded with zeros to at least
+ * the requested number of digits (like the "%0*u" format).
+ */
+void
+dctool_writer_uint (dctool_writer_t *writer, unsigned long long value, unsigned int width)
+{
+	char digits[32];
+	unsigned int n = 0;
+
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	while (n < width && n < sizeof (digits))
+		digits[n++] = '0';
+
+	char *p = dctool_writer_reserve (writer, n);
+	if (p == NULL)
+		return;
+
+	for (unsigned int i = 0; i < n; ++i)
+		p[i] = digits[n - i - 1];
+	writer->size += n;
+}
+
+static void
+dctool_writer_fixed_libc (dctool_writer_t *writer, double value, unsigned int decimals)
+{
+	char *p = dctool_writer_reserve (writer, 64);
+	if (p == NULL)
+		return;
+
+	int n = snprintf (p, 64, "%.*f", (int) decimals, value);
+	if (n > 0)
+		writer->size += (n < 64 ? n : 63);
+}
+
+/*
+ * Append a floating point value with a fixed number of decimals (like
+ * the "%.*f" format), using integer arithmetic. The scaled value is
+ * rounded to the nearest integer, which gives the same result as the C
+ * library, except when it ends up exactly halfway. Those values, and the
+ * values that don't fit in the fixed point representation, fall back to
+ * the C library.
+ */
+void
+dctool_writer_fixed (dctool_writer_t *writer, double value, unsigned int decimals)
+{
+	static const unsigned int scale[] = {1, 10, 100, 1000, 10000, 100000};
+
+	if (decimals >= sizeof (scale) / sizeof (scale[0]) || !(value > -1e12 && value < 1e12)) {
+		dctool_writer_fixed_libc (writer, value, decimals);
+		return;
+	}
+
+	double scaled = (signbit (value) ? -value : value) * scale[decimals];
+	double integer = (double) (unsigned long long) scaled;
+	if (scaled - integer == 0.5) {
+		dctool_writer_fixed_libc (writer, value, decimals);
+		return;
+	}
+
+	unsigned long long fixed = (unsigned long long) integer + (scaled - integer > 0.5);
+	if (signbit (value))
+		dctool_writer_literal (writer, "-");
+
+	dctool_writer_uint (writer, fixed / scale[decimals], 1);
+	if (decimals) {
+		dctool_writer_literal (writer, ".");
+		dctool_writer_uint (writer, fixed % scale[decimals], decimals);
+	}
+}
+
+void
+dctool_writer_hex (dctool_writer_t *writer, const unsigned char data[], size_t size)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	char *p = dctool_writer_reserve (writer, size * 2);
+	if (p == NULL)
+		return;
+
+	for (size_t i = 0; i < size; ++i) {
+		p[i * 2 + 0] = hex[(data[i] >> 4) & 0x0F];
+		p[i * 2 + 1] = hex[data[i] & 0x0F];
+	}
+	writer->size += size * 2;
+}
@@ -0,0 +1,79 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_WRITER_H
+#define DCTOOL_WRITER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Buffered text writer for the output backends, which formats numbers
+ * without going through the printf family. With an output stream, the
+ * text is flushed to the stream once the buffer is full. Without an
+ * output stream, the buffer grows to hold all text.
+ */
+typedef struct dctool_writer_t {
+	FILE *ostream;
+	char *data;
+	size_t size;
+	size_t capacity;
+	int error;
+} dctool_writer_t;
+
+// Append a string literal, with its length known at compile time.
+#define dctool_writer_literal(writer, s) dctool_writer_string (writer, s, sizeof (s) - 1)
+
+void
+dctool_writer_init (dctool_writer_t *writer, FILE *ostream);
+
+void
+dctool_writer_free (dctool_writer_t *writer);
+
+void
+dctool_writer_clear (dctool_writer_t *writer);
+
+void
+dctool_writer_flush (dctool_writer_t *writer);
+
+void
+dctool_writer_string (dctool_writer_t *writer, const char *s, size_t n);
+
+void
+dctool_writer_append (dctool_writer_t *writer, const dctool_writer_t *other);
+
+void
+dctool_writer_uint (dctool_writer_t *writer, unsigned long long value, unsigned int width);
+
+void
+dctool_writer_fixed (dctool_writer_t *writer, double value, unsigned int decimals);
+
+void
+dctool_writer_hex (dctool_writer_t *writer, const unsigned char data[], size_t size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_WRITER_H */
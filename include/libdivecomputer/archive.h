@@ -0,0 +1,160 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_ARCHIVE_H
+#define DC_ARCHIVE_H
+
+#include "common.h"
+#include "context.h"
+#include "buffer.h"
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Opaque object representing an archive of raw dives.
+ */
+typedef struct dc_archive_t dc_archive_t;
+
+/**
+ * The maximum size of the fingerprint of an archived dive.
+ */
+#define DC_ARCHIVE_MAXFINGERPRINT 64
+
+/**
+ * Archive entry.
+ *
+ * The fingerprint is a copy, and remains valid as long as the entry.
+ */
+typedef struct dc_archive_entry_t {
+	dc_family_t family;
+	unsigned int model;
+	unsigned int serial;
+	unsigned int size;
+	unsigned char fingerprint[DC_ARCHIVE_MAXFINGERPRINT];
+	unsigned int fsize;
+} dc_archive_entry_t;
+
+/**
+ * Open an archive, or create a new one if the file doesn't exist.
+ *
+ * The archive is a single file with the raw dives, exactly as they are
+ * passed to the #dc_dive_callback_t callback. The dives are compressed
+ * with a dictionary per family, which is trained on the first dives of
+ * that family. The index of the archive is rebuilt when it's opened,
+ * and a partially written dive at the end of the file is ignored. An
+ * invalid record elsewhere in the file is skipped, and the archive is
+ * then opened for reading only: appending fails with
+ * #DC_STATUS_DATAFORMAT.
+ *
+ * @param[out]  archive   A location to store the archive.
+ * @param[in]   context   A valid context.
+ * @param[in]   filename  The name of the archive file.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_archive_open (dc_archive_t **archive, dc_context_t *context, const char *filename);
+
+/**
+ * Append a dive to the archive.
+ *
+ * @param[in]  archive      A valid archive.
+ * @param[in]  family       The family of the device.
+ * @param[in]  model        The model number of the device.
+ * @param[in]  serial       The serial number of the device.
+ * @param[in]  data         The raw dive data.
+ * @param[in]  size         The size of the raw dive data.
+ * @param[in]  fingerprint  The fingerprint of the dive.
+ * @param[in]  fsize        The size of the fingerprint, at most
+ *                          #DC_ARCHIVE_MAXFINGERPRINT bytes.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_archive_add (dc_archive_t *archive, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+
+/**
+ * Get the number of dives in the archive.
+ *
+ * @param[in]  archive  A valid archive.
+ * @returns The number of dives.
+ */
+unsigned int
+dc_archive_get_count (dc_archive_t *archive);
+
+/**
+ * Get the description of a dive, without decompressing it.
+ *
+ * @param[in]   archive  A valid archive.
+ * @param[in]   index    The index of the dive, in the order of the archive.
+ * @param[out]  entry    A location to store the description.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_archive_get_entry (dc_archive_t *archive, unsigned int index, dc_archive_entry_t *entry);
+
+/**
+ * Read and decompress a dive.
+ *
+ * @param[in]   archive  A valid archive.
+ * @param[in]   index    The index of the dive.
+ * @param[out]  buffer   The buffer to store the raw dive data.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_archive_read (dc_archive_t *archive, unsigned int index, dc_buffer_t *buffer);
+
+/**
+ * Decompress a dive directly into a parser, as with dc_parser_set_data.
+ *
+ * The decompressed data is owned by the archive, and remains valid
+ * until the next call to this function or until the archive is closed.
+ * Use #dc_archive_read with a separate buffer per thread to parse the
+ * dives of the same archive from several threads concurrently.
+ *
+ * @param[in]  archive  A valid archive.
+ * @param[in]  index    The index of the dive.
+ * @param[in]  parser   A valid parser for the family of the dive.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_archive_set_parser_data (dc_archive_t *archive, unsigned int index, dc_parser_t *parser);
+
+/**
+ * Close the archive and free all resources.
+ *
+ * @param[in]  archive  A valid archive.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_archive_close (dc_archive_t *archive);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_ARCHIVE_H */
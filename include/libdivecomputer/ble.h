@@ -33,6 +33,32 @@ extern "C" {
  */
 #define DC_IOCTL_BLE_GET_NAME   DC_IOCTL_IOR('b', 0, DC_IOCTL_SIZE_VARIABLE)
 
+/**
+ * Get the maximum payload size of a single packet (the negotiated ATT
+ * MTU minus the 3 byte header).
+ */
+#define DC_IOCTL_BLE_GET_MTU    DC_IOCTL_IOR('b', 1, sizeof(unsigned int))
+
+/**
+ * Request a larger maximum payload size of a single packet (the ATT
+ * MTU minus the 3 byte header). The negotiated value can be smaller,
+ * and is available with #DC_IOCTL_BLE_GET_MTU.
+ */
+#define DC_IOCTL_BLE_SET_MTU    DC_IOCTL_IOW('b', 2, sizeof(unsigned int))
+
+/**
+ * Request a preferred connection interval (microseconds). The BLE
+ * stack can round it to the nearest supported value, or to a
+ * connection priority.
+ */
+#define DC_IOCTL_BLE_SET_INTERVAL DC_IOCTL_IOW('b', 3, sizeof(unsigned int))
+
+/**
+ * Send the data with write-without-response (non-zero), or with write
+ * requests (zero, the default).
+ */
+#define DC_IOCTL_BLE_SET_NORESPONSE DC_IOCTL_IOW('b', 4, sizeof(unsigned int))
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
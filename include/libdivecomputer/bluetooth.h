@@ -129,6 +129,37 @@ dc_bluetooth_iterator_new (dc_iterator_t **iterator, dc_context_t *context, dc_d
 dc_status_t
 dc_bluetooth_open (dc_iostream_t **iostream, dc_context_t *context, dc_bluetooth_address_t address, unsigned int port);
 
+/**
+ * Bluetooth connection request.
+ */
+typedef struct dc_bluetooth_request_t {
+	dc_bluetooth_address_t address; /**< The bluetooth device address. */
+	unsigned int port;              /**< The bluetooth port number. */
+	dc_iostream_t *iostream;        /**< The bluetooth connection, or NULL. */
+	dc_status_t status;             /**< The result of the request. */
+} dc_bluetooth_request_t;
+
+/**
+ * Open several bluetooth connections at once.
+ *
+ * The SDP queries and the connections of all requests proceed at the
+ * same time from the calling thread, so their latencies overlap instead
+ * of adding up. Each request receives its own status, and a connection
+ * on success. Requests which are not finished within the timeout fail
+ * with #DC_STATUS_TIMEOUT. On platforms without support for concurrent
+ * connections, the requests are processed one after the other.
+ *
+ * @param[in]  context   A valid context object.
+ * @param[in]  requests  The connection requests.
+ * @param[in]  count     The number of requests.
+ * @param[in]  timeout   The timeout in milliseconds for all requests
+ *                       together, or a negative value for no timeout.
+ * @returns #DC_STATUS_SUCCESS if all connections are opened, or the
+ * error of the first failed request.
+ */
+dc_status_t
+dc_bluetooth_open_multi (dc_context_t *context, dc_bluetooth_request_t requests[], unsigned int count, int timeout);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
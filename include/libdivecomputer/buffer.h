@@ -29,10 +29,74 @@ extern "C" {
 #endif /* __cplusplus */
 
 typedef struct dc_buffer_t dc_buffer_t;
+typedef struct dc_arena_t dc_arena_t;
+
+dc_arena_t *
+dc_arena_new (size_t blocksize);
+
+void
+dc_arena_free (dc_arena_t *arena);
+
+void
+dc_arena_reset (dc_arena_t *arena);
+
+void *
+dc_arena_alloc (dc_arena_t *arena, size_t size);
 
 dc_buffer_t *
 dc_buffer_new (size_t capacity);
 
+dc_buffer_t *
+dc_buffer_new_arena (dc_arena_t *arena, size_t capacity);
+
+/**
+ * Create a buffer with the contents of a file.
+ *
+ * The file is mapped into memory instead of being read, so the data is
+ * available without copying it. Modifying the buffer, except for
+ * slicing and clearing, first copies the data into memory owned by the
+ * buffer. The file itself is never modified. Empty files, and files
+ * that can't be mapped (e.g. pipes) are not supported.
+ *
+ * @param[in]  filename  The name of the file.
+ * @returns The new buffer on success, or NULL on failure.
+ */
+dc_buffer_t *
+dc_buffer_new_file (const char *filename);
+
+/**
+ * Create a buffer that stores its data in a file.
+ *
+ * The data is stored in a temporary file next to the file (with the
+ * ".part" suffix), which is mapped into memory as the buffer grows.
+ * Data written into the buffer goes directly to the file, and the pages
+ * are written back by the operating system instead of occupying heap
+ * memory. This allows to download a full memory dump with
+ * dc_device_dump without holding a copy of the entire memory in the
+ * heap. The disk space is reserved before the buffer grows, so a full
+ * disk is reported as a failure to grow the buffer.
+ *
+ * The file is only created, or replaced, by #dc_buffer_commit. When the
+ * buffer is destroyed without a commit, the temporary file is removed
+ * and an existing file is left untouched.
+ *
+ * @param[in]  filename  The name of the file.
+ * @returns The new buffer on success, or NULL on failure.
+ */
+dc_buffer_t *
+dc_buffer_new_sink (const char *filename);
+
+/**
+ * Replace the file of a sink buffer with the final contents of the
+ * buffer. The buffer is empty afterwards, and no longer backed by a
+ * file.
+ *
+ * @param[in]  buffer  A sink buffer.
+ * @returns Non-zero on success, or zero on failure.
+ */
+int
+dc_buffer_commit (dc_buffer_t *buffer);
+
 void
 dc_buffer_free (dc_buffer_t *buffer);
 
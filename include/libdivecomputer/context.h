@@ -22,6 +22,7 @@
 #ifndef DC_CONTEXT_H
 #define DC_CONTEXT_H
 
+#include <stddef.h>
 #include "common.h"
 
 #ifdef __cplusplus
@@ -41,6 +42,28 @@ typedef enum dc_loglevel_t {
 
 typedef void (*dc_logfunc_t) (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *message, void *userdata);
 
+/*
+ * Receives the raw data of a hexdump, instead of a formatted message.
+ * The data is only valid for the duration of the call.
+ */
+typedef void *(*dc_malloc_t) (size_t size);
+
+typedef void *(*dc_realloc_t) (void *ptr, size_t size);
+
+typedef void (*dc_free_t) (void *ptr);
+
+typedef void (*dc_datafunc_t) (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *prefix, const unsigned char data[], unsigned int size, void *userdata);
+
+/*
+ * A context can be shared between threads. The log callbacks are
+ * serialized, and the shared caches and transport sessions of the
+ * context are protected internally. Changing the log level or the log
+ * callbacks is safe at any time, but messages from other threads which
+ * already passed the log level check may still be delivered at the old
+ * level. The objects created with a context (devices, parsers and
+ * iostreams) are not thread-safe themselves, and must only be used by
+ * one thread at a time. The context must outlive all of them.
+ */
 dc_status_t
 dc_context_new (dc_context_t **context);
 
@@ -53,9 +76,51 @@ dc_context_set_loglevel (dc_context_t *context, dc_loglevel_t loglevel);
 dc_status_t
 dc_context_set_logfunc (dc_context_t *context, dc_logfunc_t logfunc, void *userdata);
 
+dc_status_t
+dc_context_set_datafunc (dc_context_t *context, dc_datafunc_t datafunc, void *userdata);
+
+/*
+ * Deliver the log messages from a background thread, instead of from
+ * the thread that logs them, so a slow log callback never delays the
+ * communication with the device. At most the maximum number of
+ * messages are queued, and the messages that don't fit are dropped and
+ * reported with a warning. The timestamps of the default log callback
+ * are the time of delivery. A zero maximum restores the synchronous
+ * delivery, after the queued messages are delivered. The data callback
+ * is always invoked synchronously.
+ */
+dc_status_t
+dc_context_set_logqueue (dc_context_t *context, unsigned int maximum);
+
+/*
+ * Replace the memory allocation functions of the library. This is a
+ * process-wide setting, not a property of a context: the functions are
+ * used for the buffers, and for the device, parser, iterator and I/O
+ * stream objects, of all contexts. The call is not synchronized with
+ * the rest of the library, and must be made before any other library
+ * function is called, from a single thread. The functions must stay
+ * valid until the last object is freed. Passing NULL for all three
+ * functions restores the functions of the C library.
+ */
+dc_status_t
+dc_set_allocator (dc_malloc_t mallocfunc, dc_realloc_t reallocfunc, dc_free_t freefunc);
+
 unsigned int
 dc_context_get_transports (dc_context_t *context);
 
+/*
+ * Enable or disable the cache of the connection profiles. With the
+ * cache enabled, the parameters negotiated during the handshake (like
+ * the model and the memory layout) are remembered per device address,
+ * and a reconnect to the same address skips the probing. Only enable
+ * the cache when the same address always identifies the same dive
+ * computer. Only bluetooth (RFCOMM) and IrDA connections have an
+ * address, so the profiles of serial and BLE connections are never
+ * cached. The cache is disabled by default.
+ */
+dc_status_t
+dc_context_set_profile_cache (dc_context_t *context, unsigned int enable);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -48,6 +48,18 @@ typedef struct dc_custom_cbs_t {
 	dc_status_t (*close) (void *userdata);
 } dc_custom_cbs_t;
 
+/*
+ * Optional zero-copy reads. The read_lend function returns a pointer
+ * to the next received packet, which stays owned by the application.
+ * The library hands every lent buffer back with read_return, once it
+ * is done with the data. Buffers that are still lent when the stream
+ * is closed are returned before the close callback is called.
+ */
+typedef struct dc_custom_lend_cbs_t {
+	dc_status_t (*read_lend) (void *userdata, const void **data, size_t *size);
+	dc_status_t (*read_return) (void *userdata, const void *data);
+} dc_custom_lend_cbs_t;
+
 /**
  * Create a custom I/O stream.
  *
@@ -61,6 +73,20 @@ typedef struct dc_custom_cbs_t {
 dc_status_t
 dc_custom_open (dc_iostream_t **iostream, dc_context_t *context, dc_transport_t transport, const dc_custom_cbs_t *callbacks, void *userdata);
 
+/**
+ * Enable zero-copy reads on a custom I/O stream.
+ *
+ * Both callback functions are required. The user data is the one
+ * passed to #dc_custom_open.
+ *
+ * @param[in]   iostream   A valid custom I/O stream.
+ * @param[in]   callbacks  The callback functions to call.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_custom_set_lend (dc_iostream_t *iostream, const dc_custom_lend_cbs_t *callbacks);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,158 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_DECO_H
+#define DC_DECO_H
+
+#include "common.h"
+#include "context.h"
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define DC_DECO_NCOMPARTMENTS 16
+
+/**
+ * Opaque object representing a decompression model.
+ *
+ * The model is the Buhlmann ZH-L16C algorithm with gradient factors,
+ * for open circuit dives. The depths are converted to pressures with
+ * 10 meters of water per bar.
+ */
+typedef struct dc_deco_t dc_deco_t;
+
+/**
+ * Decompression status.
+ */
+typedef struct dc_deco_status_t {
+	double ceiling;     /* Ceiling (m), zero without decompression obligation */
+	unsigned int ndl;   /* No decompression limit (s), zero in deco, at most 99 minutes */
+	double cns;         /* Central nervous system oxygen toxicity (fraction) */
+	double otu;         /* Oxygen toxicity units */
+	double tissues[DC_DECO_NCOMPARTMENTS]; /* Inert gas pressure (bar) */
+} dc_deco_status_t;
+
+/**
+ * Decompression callback, invoked after every depth sample.
+ *
+ * @param[in]  time      The time of the sample (s).
+ * @param[in]  depth     The depth of the sample (m).
+ * @param[in]  status    The decompression status.
+ * @param[in]  userdata  The user data passed to #dc_deco_process.
+ */
+typedef void (*dc_deco_callback_t) (unsigned int time, double depth, const dc_deco_status_t *status, void *userdata);
+
+/**
+ * Create a new decompression model.
+ *
+ * The model starts at the surface, saturated with air at the standard
+ * atmospheric pressure, and breathing air.
+ *
+ * @param[out]  deco     A location to store the decompression model.
+ * @param[in]   context  A valid context.
+ * @param[in]   gflow    The low gradient factor (percent).
+ * @param[in]   gfhigh   The high gradient factor (percent).
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_deco_new (dc_deco_t **deco, dc_context_t *context, unsigned int gflow, unsigned int gfhigh);
+
+/**
+ * Reset the model to the start of a new dive, saturated with air at the
+ * surface pressure.
+ *
+ * @param[in]  deco     A valid decompression model.
+ * @param[in]  surface  The surface pressure (bar), or zero for the
+ *                      standard atmospheric pressure.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_deco_reset (dc_deco_t *deco, double surface);
+
+/**
+ * Switch to another breathing gas.
+ *
+ * @param[in]  deco    A valid decompression model.
+ * @param[in]  gasmix  The gas mix.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_deco_set_gasmix (dc_deco_t *deco, const dc_gasmix_t *gasmix);
+
+/**
+ * Move from the current depth to a new depth, at a constant rate.
+ *
+ * @param[in]  deco      A valid decompression model.
+ * @param[in]  depth     The new depth (m).
+ * @param[in]  duration  The duration (s).
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_deco_update (dc_deco_t *deco, double depth, unsigned int duration);
+
+/**
+ * Get the decompression status at the current depth.
+ *
+ * @param[in]   deco    A valid decompression model.
+ * @param[out]  status  A location to store the status.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_deco_get_status (dc_deco_t *deco, dc_deco_status_t *status);
+
+/**
+ * Run the model over the profile of a dive.
+ *
+ * The model is reset with the surface pressure and the first gas mix of
+ * the dive, and follows the depth and gas mix samples. Afterwards, the
+ * model is left at the end of the dive.
+ *
+ * @param[in]  deco      A valid decompression model.
+ * @param[in]  parser    A parser with the dive data.
+ * @param[in]  callback  The decompression callback, or NULL.
+ * @param[in]  userdata  The user data for the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_deco_process (dc_deco_t *deco, dc_parser_t *parser, dc_deco_callback_t callback, void *userdata);
+
+/**
+ * Free the decompression model.
+ *
+ * @param[in]  deco  A valid decompression model.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_deco_free (dc_deco_t *deco);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_DECO_H */
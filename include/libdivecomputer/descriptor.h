@@ -34,6 +34,29 @@ typedef struct dc_descriptor_t dc_descriptor_t;
 dc_status_t
 dc_descriptor_iterator (dc_iterator_t **iterator);
 
+/*
+ * Iterate over the descriptors which support at least one of the
+ * transports in the bitmask, in the same order as the full iterator.
+ */
+dc_status_t
+dc_descriptor_iterator_transport (dc_iterator_t **iterator, unsigned int transports);
+
+/*
+ * Find the descriptor of a model. If none of the descriptors of the
+ * family has the exact model number, the first one of the family is
+ * returned. Returns #DC_STATUS_NODEVICE if there is no such family.
+ */
+dc_status_t
+dc_descriptor_find (dc_descriptor_t **descriptor, dc_family_t family, unsigned int model);
+
+/*
+ * Find the descriptor with the (case insensitive) vendor and product
+ * name. Without a vendor name, only the product name is compared.
+ * Returns #DC_STATUS_NODEVICE if there is no such descriptor.
+ */
+dc_status_t
+dc_descriptor_find_name (dc_descriptor_t **descriptor, const char *vendor, const char *product);
+
 void
 dc_descriptor_free (dc_descriptor_t *descriptor);
 
@@ -38,9 +38,16 @@ typedef enum dc_event_type_t {
 	DC_EVENT_PROGRESS = (1 << 1),
 	DC_EVENT_DEVINFO = (1 << 2),
 	DC_EVENT_CLOCK = (1 << 3),
-	DC_EVENT_VENDOR = (1 << 4)
+	DC_EVENT_VENDOR = (1 << 4),
+	DC_EVENT_STATS = (1 << 5)
 } dc_event_type_t;
 
+typedef enum dc_event_phase_t {
+	DC_PHASE_HANDSHAKE,
+	DC_PHASE_LOGBOOK,
+	DC_PHASE_PROFILE
+} dc_event_phase_t;
+
 typedef struct dc_device_t dc_device_t;
 
 typedef struct dc_event_progress_t {
@@ -64,15 +71,75 @@ typedef struct dc_event_vendor_t {
 	unsigned int size;
 } dc_event_vendor_t;
 
+/*
+ * Transfer statistics, emitted together with the progress events, but
+ * at most once per interval (see dc_device_set_stats). The rates are
+ * measured since the previous statistics event, and the remaining time
+ * is estimated from the progress rate. The byte counts and retries,
+ * which are the timeouts and input purges of the I/O stream, are
+ * totals since the start of the transfer. Without access to the I/O
+ * stream, for example for a memory image, these are all zero.
+ */
+typedef struct dc_event_stats_t {
+	dc_event_phase_t phase;
+	unsigned int elapsed;    /* Time since the start (ms) */
+	unsigned int remaining;  /* Estimated remaining time (ms), or UINT_MAX if unknown */
+	double bytes;            /* Bytes per second, in both directions */
+	double roundtrips;       /* Round trips (writes) per second */
+	unsigned int retries;
+	unsigned long long bytes_in;
+	unsigned long long bytes_out;
+} dc_event_stats_t;
+
 typedef int (*dc_cancel_callback_t) (void *userdata);
 
 typedef void (*dc_event_callback_t) (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata);
 
 typedef int (*dc_dive_callback_t) (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata);
 
+typedef struct dc_session_t dc_session_t;
+
+typedef struct dc_fingerprint_store_t dc_fingerprint_store_t;
+
+typedef struct dc_journal_t dc_journal_t;
+
+/*
+ * The dive callback, and the event callbacks of the device, are invoked
+ * from the worker threads. The done callback is invoked from the thread
+ * calling dc_session_wait, once per device in order of completion.
+ */
+typedef void (*dc_session_done_t) (dc_device_t *device, dc_status_t status, void *userdata);
+
+/*
+ * A custom session task, for example a firmware update, invoked from a
+ * worker thread instead of the download.
+ */
+typedef dc_status_t (*dc_session_task_t) (dc_device_t *device, void *userdata);
+
+/*
+ * Open the device. Any number of operations (dc_device_foreach,
+ * dc_device_dump, dc_device_timesync, dc_device_read, dc_device_write
+ * and the backend specific functions) can be performed on the same
+ * device. For the dive computers with an explicit handshake, it is done
+ * once, here, and the device stays in download mode until it is closed,
+ * without repeating the handshake. Use dc_device_keepalive between
+ * operations. For the dive computers where the transfer is started on
+ * the device itself (for example the Mares Nemo and the Uwatec Aladin),
+ * the user has to start the transfer again for each operation.
+ */
 dc_status_t
 dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descriptor, dc_iostream_t *iostream);
 
+/*
+ * Open a memory image, previously saved with dc_device_dump, as a
+ * device. The dives are extracted from the image with dc_device_foreach,
+ * exactly as during the original download. The image data is not copied,
+ * and must remain valid until the device is closed. Only the dive
+ * computers with a full memory dump are supported.
+ */
+dc_status_t
+dc_device_image_open (dc_device_t **device, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], unsigned int size);
+
 dc_family_t
 dc_device_get_type (dc_device_t *device);
 
@@ -82,12 +149,103 @@ dc_device_set_cancel (dc_device_t *device, dc_cancel_callback_t callback, void *
 dc_status_t
 dc_device_set_events (dc_device_t *device, unsigned int events, dc_event_callback_t callback, void *userdata);
 
+/*
+ * Coalesce the progress events. A progress event is only delivered
+ * after at least the interval (in milliseconds) has elapsed since the
+ * previously delivered event, or the progress has increased by at least
+ * the delta (in permille of the maximum). The first and the final event
+ * are always delivered. Zero disables a condition, and disabling both
+ * (the default) delivers every event.
+ */
+dc_status_t
+dc_device_set_progress (dc_device_t *device, unsigned int interval, unsigned int permille);
+
+/*
+ * Set the minimum interval (in milliseconds) between two statistics
+ * events. The default is one second. The final event, together with
+ * the last progress event, is always delivered.
+ */
+dc_status_t
+dc_device_set_stats (dc_device_t *device, unsigned int interval);
+
 dc_status_t
 dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsigned int size);
 
+/*
+ * Attach a fingerprint store to the device. The fingerprint of the
+ * device is looked up as soon as the device reports its serial number
+ * (the #DC_EVENT_DEVINFO event), and replaces the fingerprint set with
+ * dc_device_set_fingerprint. After a successful dc_device_foreach, the
+ * fingerprint of the most recent dive is stored. The store must remain
+ * valid until the device is closed.
+ */
+dc_status_t
+dc_device_set_fingerprint_store (dc_device_t *device, dc_fingerprint_store_t *store);
+
+/*
+ * Attach a download journal to the device. Every dive delivered by
+ * dc_device_foreach is recorded in the journal, until the download
+ * completes successfully. When a download is interrupted, the next
+ * dc_device_foreach skips the dives that are already in the journal.
+ * Several backends skip the transfer of those dives as well. Combined
+ * with a fingerprint store, the fingerprint of the most recent dive is
+ * stored, even when that dive was skipped. The journal must remain
+ * valid until the device is closed.
+ */
+dc_status_t
+dc_device_set_journal (dc_device_t *device, dc_journal_t *journal);
+
+/*
+ * Limit the dives downloaded by dc_device_foreach, in addition to the
+ * fingerprint. The download stops after the most recent maxdives dives
+ * (zero for no limit), or at the first dive older than the since time
+ * (NULL for no limit, compared with the local time of the dives).
+ * Several backends check the limits on the logbook headers, and skip
+ * the transfer of the other dives entirely. The other backends stop
+ * as soon as a delivered dive is outside the limits.
+ */
+dc_status_t
+dc_device_set_limits (dc_device_t *device, unsigned int maxdives, const dc_datetime_t *since);
+
+/*
+ * Page cache statistics, in pages.
+ */
+typedef struct dc_device_cache_stats_t {
+	unsigned int hits;
+	unsigned int misses;
+} dc_device_cache_stats_t;
+
+/*
+ * Enable a page cache for dc_device_read, with a capacity of npages
+ * pages of pagesize bytes each. Misses are read from the device in whole
+ * pages, and memory written with dc_device_write is dropped from the
+ * cache. The vectored reads of dc_device_read_multi and the memory dumps
+ * bypass the cache. Setting npages to zero disables the cache. Any
+ * previously cached data and statistics are discarded.
+ */
+dc_status_t
+dc_device_set_cache (dc_device_t *device, unsigned int pagesize, unsigned int npages);
+
+dc_status_t
+dc_device_get_cache_stats (dc_device_t *device, dc_device_cache_stats_t *stats);
+
 dc_status_t
 dc_device_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size);
 
+/*
+ * Read several memory ranges at once. Devices with support for
+ * vectored reads transfer the ranges with as few requests as possible,
+ * the other devices read the ranges one by one.
+ */
+typedef struct dc_device_range_t {
+	unsigned int address;
+	unsigned int size;
+	unsigned char *data;
+} dc_device_range_t;
+
+dc_status_t
+dc_device_read_multi (dc_device_t *device, const dc_device_range_t ranges[], unsigned int count);
+
 dc_status_t
 dc_device_write (dc_device_t *device, unsigned int address, const unsigned char data[], unsigned int size);
 
@@ -97,12 +255,91 @@ dc_device_dump (dc_device_t *device, dc_buffer_t *buffer);
 dc_status_t
 dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
+/*
+ * Size of the canonical dive hash, in bytes.
+ */
+#define DC_DIVE_HASH_SIZE 8
+
+/*
+ * Compute the canonical hash of a dive, from within the dive callback
+ * of dc_device_foreach. The hash covers the family, model and serial
+ * number of the device, and the fingerprint of the dive. The
+ * fingerprint identifies the dive on the device without parsing, and
+ * doesn't change when the dive is downloaded again. Only for dives
+ * without a fingerprint, the raw dive data is hashed instead. The same
+ * dive downloaded twice from the same device always has the same hash,
+ * and can be dropped before it is parsed or stored.
+ */
+dc_status_t
+dc_device_get_hash (dc_device_t *device, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, unsigned char hash[DC_DIVE_HASH_SIZE]);
+
 dc_status_t
 dc_device_timesync (dc_device_t *device, const dc_datetime_t *datetime);
 
+/*
+ * Keep the device in download mode while no other operation is running,
+ * for the dive computers which leave it after a period of inactivity.
+ * Call it periodically, for example once per second. Several backends
+ * skip the command when the device was accessed recently. Returns
+ * DC_STATUS_UNSUPPORTED if the dive computer doesn't need a keepalive.
+ */
+dc_status_t
+dc_device_keepalive (dc_device_t *device);
+
 dc_status_t
 dc_device_close (dc_device_t *device);
 
+dc_status_t
+dc_session_new (dc_session_t **session, dc_context_t *context, unsigned int nthreads);
+
+dc_status_t
+dc_session_add (dc_session_t *session, dc_device_t *device, dc_dive_callback_t callback, dc_session_done_t done, void *userdata);
+
+dc_status_t
+dc_session_add_task (dc_session_t *session, dc_device_t *device, dc_session_task_t task, dc_session_done_t done, void *userdata);
+
+dc_status_t
+dc_session_cancel (dc_session_t *session, dc_device_t *device);
+
+dc_status_t
+dc_session_wait (dc_session_t *session);
+
+dc_status_t
+dc_session_free (dc_session_t *session);
+
+/*
+ * The fingerprint store keeps the fingerprint of the most recent dive
+ * for each device, identified by the family, model and serial number.
+ * The fingerprints are kept in the file, which is created if it doesn't
+ * exist yet, and rewritten after every update. A store can be shared
+ * between the devices of a session.
+ */
+dc_status_t
+dc_fingerprint_store_new (dc_fingerprint_store_t **store, dc_context_t *context, const char *filename);
+
+dc_status_t
+dc_fingerprint_store_get (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, dc_buffer_t *fingerprint);
+
+dc_status_t
+dc_fingerprint_store_set (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size);
+
+dc_status_t
+dc_fingerprint_store_free (dc_fingerprint_store_t *store);
+
+/*
+ * The download journal keeps the fingerprints of the dives delivered by
+ * an unfinished download, for each device, identified by the family,
+ * model and serial number. The fingerprint of every dive is appended to
+ * the file as soon as the dive is delivered, and the entries of a device
+ * are removed after its download completes. A journal can be shared
+ * between the devices of a session.
+ */
+dc_status_t
+dc_journal_new (dc_journal_t **journal, dc_context_t *context, const char *filename);
+
+dc_status_t
+dc_journal_free (dc_journal_t *journal);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,102 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_DISCOVERY_H
+#define DC_DISCOVERY_H
+
+#include "common.h"
+#include "context.h"
+#include "descriptor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Opaque object representing a device discovery.
+ */
+typedef struct dc_discovery_t dc_discovery_t;
+
+/**
+ * Discovery callback.
+ *
+ * The device object has the type of the transport (for example a
+ * #dc_usbhid_device_t for #DC_TRANSPORT_USBHID), and is owned by the
+ * callback. It must be freed with the free function of the transport.
+ * The callbacks are serialized, but they are called from the threads
+ * of the discovery.
+ *
+ * @param[in]  transport   The transport type.
+ * @param[in]  device      The device object.
+ * @param[in]  descriptor  The matching descriptor, or NULL for serial
+ *                         ports discovered without a descriptor, because
+ *                         they can't be identified.
+ * @param[in]  userdata    The user data passed to the discovery.
+ */
+typedef void (*dc_discovery_callback_t) (dc_transport_t transport, void *device, dc_descriptor_t *descriptor, void *userdata);
+
+/**
+ * Start the device discovery.
+ *
+ * The devices of all requested transports, restricted to the transports
+ * supported by the context, are enumerated at the same time, and are
+ * reported as soon as they are found. With a descriptor, only the
+ * devices accepted by the descriptor are reported. Without a
+ * descriptor, the devices are matched against all descriptors, and
+ * only the devices which match a descriptor (and all serial ports) are
+ * reported.
+ *
+ * @param[out]  discovery   A location to store the discovery.
+ * @param[in]   context     A valid context.
+ * @param[in]   descriptor  A device descriptor, or NULL.
+ * @param[in]   transports  A bitmask with the transports to scan.
+ * @param[in]   callback    The discovery callback.
+ * @param[in]   userdata    The user data for the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_discovery_new (dc_discovery_t **discovery, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int transports, dc_discovery_callback_t callback, void *userdata);
+
+/**
+ * Wait until the discovery of all transports is finished.
+ *
+ * @param[in]  discovery  A valid discovery.
+ * @returns #DC_STATUS_SUCCESS if at least one transport finished
+ * successfully, or the error of the first failed transport otherwise.
+ */
+dc_status_t
+dc_discovery_wait (dc_discovery_t *discovery);
+
+/**
+ * Wait for the discovery and free all resources.
+ *
+ * @param[in]  discovery  A valid discovery.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_discovery_free (dc_discovery_t *discovery);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_DISCOVERY_H */
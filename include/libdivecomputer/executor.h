@@ -0,0 +1,151 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_EXECUTOR_H
+#define DC_EXECUTOR_H
+
+#include "common.h"
+#include "context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Opaque object representing an executor.
+ *
+ * The executor runs the work of the parallel features of the library,
+ * such as #dc_parser_batch_run and #dc_device_foreach_parsed, on a
+ * shared set of worker threads. Each worker keeps a cache of parsers,
+ * which is reused by all the work that runs on it.
+ */
+typedef struct dc_executor_t dc_executor_t;
+
+/**
+ * Run function of a task, for an application supplied executor.
+ *
+ * @param[in]  task  The task passed to the submit function.
+ */
+typedef void (*dc_executor_run_t) (void *task);
+
+/**
+ * Submit function of an application supplied executor.
+ *
+ * The function must arrange for the run function to be called exactly
+ * once with the task, from one of the threads of the application. It
+ * must not call it directly.
+ *
+ * @param[in]  run       The run function.
+ * @param[in]  task      The task.
+ * @param[in]  userdata  The user data passed to #dc_executor_new_custom.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+typedef dc_status_t (*dc_executor_submit_t) (dc_executor_run_t run, void *task, void *userdata);
+
+/**
+ * Create a work-stealing executor.
+ *
+ * Each worker thread has its own queue of tasks, and an idle worker
+ * takes the tasks from the queues of the other workers.
+ *
+ * The worker threads log to the context, so the context must remain
+ * valid until the executor is destroyed.
+ *
+ * @param[out]  executor  A location to store the executor.
+ * @param[in]   context   A valid context, or NULL.
+ * @param[in]   nthreads  The number of worker threads, or zero for one
+ *                        thread per processor.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED without
+ * thread support, or another #dc_status_t code on failure.
+ */
+dc_status_t
+dc_executor_new (dc_executor_t **executor, dc_context_t *context, unsigned int nthreads);
+
+/**
+ * Create an executor on top of the thread pool of the application.
+ *
+ * The tasks are handed to the submit function. Up to nthreads tasks
+ * run at the same time, each with its own parser cache. Additional
+ * tasks wait until another one has finished.
+ * The context must remain valid until the executor is destroyed.
+ *
+ * @param[out]  executor  A location to store the executor.
+ * @param[in]   context   A valid context, or NULL.
+ * @param[in]   nthreads  The number of threads of the application pool.
+ * @param[in]   submit    The submit function.
+ * @param[in]   userdata  The user data for the submit function.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_executor_new_custom (dc_executor_t **executor, dc_context_t *context, unsigned int nthreads, dc_executor_submit_t submit, void *userdata);
+
+/**
+ * Get the number of worker threads of the executor.
+ *
+ * @param[in]  executor  A valid executor.
+ * @returns The number of worker threads.
+ */
+unsigned int
+dc_executor_get_nthreads (dc_executor_t *executor);
+
+/**
+ * Release the executor.
+ *
+ * The executor stays alive while it's still in use by a context, and
+ * is destroyed when the last user releases it. The worker threads
+ * finish the remaining tasks first.
+ *
+ * @param[in]  executor  A valid executor, or NULL.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_executor_free (dc_executor_t *executor);
+
+/**
+ * Set the executor of the context.
+ *
+ * All the parallel features of the context use this executor, such
+ * that the number of threads is controlled in one place. The executor
+ * can be shared by several contexts. Without an executor, the context
+ * creates one on first use, with one thread per processor. Passing NULL
+ * restores that default. The executor should not be replaced while a
+ * parallel operation is running.
+ *
+ * The number of threads passed to the parallel features limits how
+ * many workers of the executor they use at the same time, and zero
+ * still runs them sequentially on the calling thread. The parsers of
+ * the worker caches log to the context of the executor.
+ *
+ * @param[in]  context   A valid context.
+ * @param[in]  executor  A valid executor, or NULL.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_context_set_executor (dc_context_t *context, dc_executor_t *executor);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_EXECUTOR_H */
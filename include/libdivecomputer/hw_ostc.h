@@ -34,12 +34,22 @@ extern "C" {
 #define HW_OSTC_MD2HASH_SIZE 18
 #define HW_OSTC_EEPROM_SIZE  256
 
+#define HW_OSTC_SCREENSHOT_WIDTH  320
+#define HW_OSTC_SCREENSHOT_HEIGHT 240
+
 typedef enum hw_ostc_format_t {
 	HW_OSTC_FORMAT_RAW,
 	HW_OSTC_FORMAT_RGB16,
 	HW_OSTC_FORMAT_RGB24
 } hw_ostc_format_t;
 
+/*
+ * Screenshot progress callback. The image is stored row by row, but the
+ * OSTC sends it column by column, so the callback reports the range of
+ * columns which are complete. The other columns are still incomplete.
+ */
+typedef void (*hw_ostc_screenshot_callback_t) (const unsigned char data[], unsigned int size, unsigned int column, unsigned int count, void *userdata);
+
 dc_status_t
 hw_ostc_device_md2hash (dc_device_t *device, unsigned char data[], unsigned int size);
 
@@ -55,6 +65,13 @@ hw_ostc_device_reset (dc_device_t *device);
 dc_status_t
 hw_ostc_device_screenshot (dc_device_t *device, dc_buffer_t *buffer, hw_ostc_format_t format);
 
+/*
+ * Download a screenshot, and decode it while the data arrives. Only the
+ * RGB formats are supported.
+ */
+dc_status_t
+hw_ostc_device_screenshot_stream (dc_device_t *device, dc_buffer_t *buffer, hw_ostc_format_t format, hw_ostc_screenshot_callback_t callback, void *userdata);
+
 dc_status_t
 hw_ostc_device_fwupdate (dc_device_t *abstract, const char *filename);
 
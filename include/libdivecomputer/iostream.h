@@ -83,6 +83,44 @@ typedef enum dc_line_t {
 	DC_LINE_RNG = 0x08, /**< Ring indicator */
 } dc_line_t;
 
+/**
+ * Number of buckets in the latency histograms.
+ */
+#define DC_IOSTREAM_HISTOGRAM_SIZE 24
+
+/**
+ * I/O statistics.
+ *
+ * The latency histograms have logarithmic buckets: bucket i counts the
+ * operations that took between 2^i and 2^(i+1) microseconds, with the
+ * first bucket also counting anything faster, and the last one anything
+ * slower.
+ */
+typedef struct dc_iostream_stats_t {
+	unsigned long long bytes_in;  /**< Number of bytes received */
+	unsigned long long bytes_out; /**< Number of bytes transmitted */
+	unsigned int reads;    /**< Number of read calls */
+	unsigned int writes;   /**< Number of write calls */
+	unsigned int polls;    /**< Number of poll calls */
+	unsigned int timeouts; /**< Number of read, write and poll timeouts */
+	unsigned int purges;   /**< Number of purge calls */
+	unsigned int errors;   /**< Number of other failures */
+	unsigned int read_latency[DC_IOSTREAM_HISTOGRAM_SIZE];  /**< Read latencies */
+	unsigned int write_latency[DC_IOSTREAM_HISTOGRAM_SIZE]; /**< Write latencies */
+	unsigned int poll_latency[DC_IOSTREAM_HISTOGRAM_SIZE];  /**< Poll latencies */
+} dc_iostream_stats_t;
+
+/**
+ * Completion callback of an asynchronous read.
+ *
+ * @param[in]  iostream  The I/O stream.
+ * @param[in]  status    The status of the read operation.
+ * @param[in]  data      The memory buffer passed to the read.
+ * @param[in]  actual    The number of bytes received.
+ * @param[in]  userdata  The user data passed to the read.
+ */
+typedef void (*dc_iostream_callback_t) (dc_iostream_t *iostream, dc_status_t status, void *data, size_t actual, void *userdata);
+
 /**
  * Get the transport type.
  *
@@ -92,6 +130,20 @@ typedef enum dc_line_t {
 dc_transport_t
 dc_iostream_get_transport (dc_iostream_t *iostream);
 
+/**
+ * Get the I/O statistics.
+ *
+ * The statistics are collected for every transport from the moment the
+ * I/O stream is opened.
+ *
+ * @param[in]   iostream  A valid I/O stream.
+ * @param[out]  stats     A location to store the statistics.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_iostream_get_stats (dc_iostream_t *iostream, dc_iostream_stats_t *stats);
+
 /**
  * Set the read timeout.
  *
@@ -225,6 +277,61 @@ dc_iostream_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned
 dc_status_t
 dc_iostream_poll (dc_iostream_t *iostream, int timeout);
 
+/**
+ * Get the native file descriptor of the I/O stream.
+ *
+ * The file descriptor can be watched for readability by an external
+ * event loop, to call #dc_iostream_dispatch once data is available.
+ * Only the serial port and socket based transports on POSIX systems
+ * have a native file descriptor. For the other transports, including
+ * the custom I/O streams, the application is responsible for calling
+ * #dc_iostream_dispatch when data may have arrived.
+ *
+ * @param[in]   iostream  A valid I/O stream.
+ * @param[out]  fd        A location to store the file descriptor.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if
+ * there is no file descriptor, or another #dc_status_t code on failure.
+ */
+dc_status_t
+dc_iostream_get_fd (dc_iostream_t *iostream, int *fd);
+
+/**
+ * Start an asynchronous read from the I/O stream.
+ *
+ * No data is read until #dc_iostream_dispatch is called. The callback
+ * is invoked from within #dc_iostream_dispatch once the requested
+ * number of bytes has been received, or an error occurs. A pending read
+ * is completed with #DC_STATUS_CANCELLED when the I/O stream is closed.
+ * Only one asynchronous read can be pending at a time, but the callback
+ * may start the next one. The buffer must remain valid until the read
+ * is completed.
+ *
+ * @param[in]  iostream  A valid I/O stream.
+ * @param[out] data      The memory buffer to read the data into.
+ * @param[in]  size      The number of bytes to read.
+ * @param[in]  callback  The completion callback.
+ * @param[in]  userdata  User data to pass to the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_iostream_read_async (dc_iostream_t *iostream, void *data, size_t size, dc_iostream_callback_t callback, void *userdata);
+
+/**
+ * Make progress on the pending asynchronous read, without blocking.
+ *
+ * All data that is already available is read into the buffer of the
+ * pending read. Readiness is checked with a non-blocking poll, or with
+ * the number of available bytes if the I/O stream doesn't support poll.
+ * Custom I/O streams need to implement one of them for asynchronous use.
+ *
+ * @param[in]  iostream  A valid I/O stream.
+ * @returns #DC_STATUS_SUCCESS on success, or the error the pending read
+ * was completed with.
+ */
+dc_status_t
+dc_iostream_dispatch (dc_iostream_t *iostream);
+
 /**
  * Read data from the I/O stream.
  *
@@ -300,6 +407,22 @@ dc_iostream_purge (dc_iostream_t *iostream, dc_direction_t direction);
 dc_status_t
 dc_iostream_sleep (dc_iostream_t *iostream, unsigned int milliseconds);
 
+/**
+ * Interrupt the I/O stream from another thread.
+ *
+ * A blocking read, write, poll or sleep returns immediately, and so do
+ * all later calls, with #DC_STATUS_CANCELLED. Afterwards, the I/O
+ * stream can only be closed. This is intended to abort a download
+ * without waiting for the timeouts of the protocol.
+ *
+ * @param[in]  iostream  A valid I/O stream.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if
+ * the transport can't be interrupted, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_iostream_interrupt (dc_iostream_t *iostream);
+
 /**
  * Close the I/O stream and free all resources.
  *
@@ -203,6 +203,12 @@ typedef union dc_sample_value_t {
 	unsigned int rbt;
 	unsigned int heartbeat;
 	unsigned int bearing;
+	/*
+	 * The vendor data is not copied, but points directly into the
+	 * buffer passed to dc_parser_set_data() or dc_parser_new(). It
+	 * remains valid until the next dc_parser_set_data() call, or until
+	 * the parser is destroyed. Copy it to keep it any longer.
+	 */
 	struct {
 		unsigned int type;
 		unsigned int size;
@@ -223,12 +229,226 @@ typedef struct dc_parser_t dc_parser_t;
 
 typedef void (*dc_sample_callback_t) (dc_sample_type_t type, dc_sample_value_t value, void *userdata);
 
+typedef struct dc_sample_event_t {
+	unsigned int sample; /* Index of the sample row */
+	unsigned int type;
+	unsigned int time;
+	unsigned int flags;
+	unsigned int value;
+} dc_sample_event_t;
+
+/*
+ * Caller provided arrays for the columnar sample extraction. Each sample
+ * row starts with a DC_SAMPLE_TIME value. Arrays can be NULL to skip that
+ * column, and values that are missing in a row are set to NAN. The count
+ * fields are set to the total number of rows and events, even if that
+ * exceeds the capacity.
+ */
+typedef struct dc_sample_columns_t {
+	unsigned int capacity;
+	unsigned int count;
+	unsigned int *time;
+	double *depth;
+	double *temperature;
+	double *ppo2;
+	unsigned int ntanks;
+	double **pressure; /* pressure[tank][row] */
+	unsigned int ecapacity;
+	unsigned int ecount;
+	dc_sample_event_t *events;
+} dc_sample_columns_t;
+
+typedef struct dc_sample_pressure_t {
+	unsigned int tank;
+	double value;
+} dc_sample_pressure_t;
+
+/*
+ * All values of one sample row, from a DC_SAMPLE_TIME value up to the
+ * next one. The fields bitmask has one bit per sample type (1 <<
+ * DC_SAMPLE_DEPTH) for the values present in the row. If a type appears
+ * more than once in a row, the last value is kept, except for the tank
+ * pressures and the events which are collected in arrays. The vendor
+ * samples are not reported. The arrays are only valid during the
+ * callback.
+ */
+typedef struct dc_sample_record_t {
+	unsigned int fields;
+	unsigned int index; /* Index of the sample row */
+	unsigned int time;
+	double depth;
+	double temperature;
+	unsigned int rbt;
+	unsigned int heartbeat;
+	unsigned int bearing;
+	double setpoint;
+	double ppo2;
+	double cns;
+	struct {
+		unsigned int type;
+		unsigned int time;
+		double depth;
+	} deco;
+	unsigned int gasmix;
+	unsigned int npressures;
+	const dc_sample_pressure_t *pressures;
+	unsigned int nevents;
+	const dc_sample_event_t *events;
+} dc_sample_record_t;
+
+typedef void (*dc_sample_record_callback_t) (const dc_sample_record_t *record, void *userdata);
+
+/*
+ * A complete dive, with all the fields and the sample rows, stored in a
+ * single memory block. The fields bitmask has one bit per field type
+ * (1 << DC_FIELD_MAXDEPTH) for the fields reported by the parser. The
+ * gasmixes and tanks are only available when all of them could be
+ * retrieved. The sample rows are the same as those of
+ * dc_parser_samples_foreach_record, and their pressures and events
+ * point into the pressures and events arrays. All arrays are part of
+ * the same block, which is released with dc_dive_free.
+ */
+typedef struct dc_dive_t {
+	unsigned int fields;
+	unsigned int have_datetime;
+	dc_datetime_t datetime;
+	unsigned int divetime;
+	double maxdepth;
+	double avgdepth;
+	dc_salinity_t salinity;
+	double atmospheric;
+	double temperature_surface;
+	double temperature_minimum;
+	double temperature_maximum;
+	dc_divemode_t divemode;
+	unsigned int ngasmixes;
+	const dc_gasmix_t *gasmixes;
+	unsigned int ntanks;
+	const dc_tank_t *tanks;
+	unsigned int nsamples;
+	const dc_sample_record_t *samples;
+	unsigned int npressures;
+	const dc_sample_pressure_t *pressures;
+	unsigned int nevents;
+	const dc_sample_event_t *events;
+} dc_dive_t;
+
+typedef enum dc_units_t {
+	DC_UNITS_METRIC,  /* Meters, degrees Celsius and bar */
+	DC_UNITS_IMPERIAL /* Feet, degrees Fahrenheit and psi */
+} dc_units_t;
+
+/*
+ * Post-processing of the columnar sample arrays. The depth values are
+ * recomputed for a different water density (in kg/m3) and atmospheric
+ * pressure (in bar), assuming the parser used the reference values. A
+ * zero density or pressure leaves that correction out, and without a
+ * density the pressure correction assumes sea water (1025 kg/m3). Next,
+ * the depth, temperature and tank pressure columns are converted from
+ * the metric units to the requested unit system. The ppo2 column stays
+ * in bar.
+ */
+typedef struct dc_sample_conversion_t {
+	dc_units_t units;
+	double density_ref;
+	double density;
+	double atmospheric_ref;
+	double atmospheric;
+} dc_sample_conversion_t;
+
+typedef enum dc_summary_field_t {
+	DC_SUMMARY_DATETIME     = (1 << 0),
+	DC_SUMMARY_DIVETIME     = (1 << 1),
+	DC_SUMMARY_MAXDEPTH     = (1 << 2),
+	DC_SUMMARY_AVGDEPTH     = (1 << 3),
+	DC_SUMMARY_GASMIX_COUNT = (1 << 4),
+	DC_SUMMARY_DIVEMODE     = (1 << 5)
+} dc_summary_field_t;
+
+/*
+ * The fields bitmask contains the available fields, and the profile
+ * bitmask the fields that required walking the profile. For a header-only
+ * summary, those fields are left out of the fields bitmask instead.
+ */
+typedef struct dc_summary_t {
+	unsigned int fields;
+	unsigned int profile;
+	dc_datetime_t datetime;
+	unsigned int divetime;
+	double maxdepth;
+	double avgdepth;
+	unsigned int gasmixes;
+	dc_divemode_t divemode;
+} dc_summary_t;
+
+/*
+ * A request for dc_parser_get_fields. The type, flags and value are the
+ * arguments of dc_parser_get_field, and the status receives its result.
+ */
+typedef struct dc_field_request_t {
+	dc_field_type_t type;
+	unsigned int flags;
+	void *value;
+	dc_status_t status;
+} dc_field_request_t;
+
+typedef struct dc_parser_pool_t dc_parser_pool_t;
+
+typedef struct dc_parser_cache_t dc_parser_cache_t;
+
+typedef struct dc_parser_sample_cursor_t dc_parser_sample_cursor_t;
+
+typedef struct dc_parser_batch_t dc_parser_batch_t;
+
+typedef struct dc_parser_job_t {
+	dc_descriptor_t *descriptor;
+	unsigned int devtime;
+	dc_ticks_t systime;
+	const unsigned char *data;
+	unsigned int size;
+	void *userdata;
+} dc_parser_job_t;
+
+/*
+ * The parse callback is invoked from the worker threads, in no particular
+ * order, with a parser that is already loaded with the job data. The done
+ * callback is invoked from the calling thread, once per job and in the
+ * original order.
+ */
+typedef dc_status_t (*dc_parser_batch_parse_t) (dc_parser_t *parser, const dc_parser_job_t *job, void *userdata);
+
+typedef void (*dc_parser_batch_done_t) (const dc_parser_job_t *job, dc_status_t status, void *userdata);
+
 dc_status_t
 dc_parser_new (dc_parser_t **parser, dc_device_t *device);
 
 dc_status_t
 dc_parser_new2 (dc_parser_t **parser, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime);
 
+/*
+ * Get the size of the scratch memory for a parser created with
+ * dc_parser_new_scratch. The size covers the parser itself and its
+ * working memory. To determine the size, a parser is created on the
+ * heap once, so call this function during initialization.
+ */
+dc_status_t
+dc_parser_get_scratch_size (dc_context_t *context, dc_descriptor_t *descriptor, size_t *size);
+
+/*
+ * Create a parser in caller provided scratch memory, aligned like the
+ * memory returned by malloc, and of at least the size reported by
+ * dc_parser_get_scratch_size. The memory must stay valid until the
+ * parser is destroyed, and isn't freed by dc_parser_destroy.
+ *
+ * Such a parser doesn't allocate any memory in dc_parser_set_data,
+ * dc_parser_get_datetime, dc_parser_get_field(s) and the sample walks.
+ * A dive that needs more working memory than is available fails with
+ * DC_STATUS_NOMEMORY. The other functions still use the heap, such as
+ * the parser cache, dc_parser_feed and dc_parser_materialize.
+ */
+dc_status_t
+dc_parser_new_scratch (dc_parser_t **parser, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, void *scratch, size_t size);
+
 dc_family_t
 dc_parser_get_type (dc_parser_t *parser);
 
@@ -241,12 +461,219 @@ dc_parser_get_datetime (dc_parser_t *parser, dc_datetime_t *datetime);
 dc_status_t
 dc_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int flags, void *value);
 
+/*
+ * Fetch several fields in one call. Every request is processed, and
+ * receives its own status. The return value is the first error other
+ * than DC_STATUS_UNSUPPORTED, or DC_STATUS_SUCCESS.
+ */
+dc_status_t
+dc_parser_get_fields (dc_parser_t *parser, dc_field_request_t requests[], unsigned int count);
+
 dc_status_t
 dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+/*
+ * Walk the samples, and report only the sample types in the mask, with
+ * one bit per type (1 << DC_SAMPLE_TIME | 1 << DC_SAMPLE_DEPTH). Some
+ * backends skip the decoding of the other types, for example the vendor
+ * data of the Oceanic parsers.
+ */
+dc_status_t
+dc_parser_samples_foreach_filtered (dc_parser_t *parser, unsigned int mask, dc_sample_callback_t callback, void *userdata);
+
+/*
+ * Enable or disable the vendor samples (enabled by default). Without
+ * vendor samples, the backends which support it skip the extraction of
+ * the vendor data entirely, for all the sample walks of the parser.
+ */
+dc_status_t
+dc_parser_set_vendor_samples (dc_parser_t *parser, int enable);
+
+dc_status_t
+dc_parser_get_summary (dc_parser_t *parser, dc_summary_t *summary, int profile);
+
+dc_status_t
+dc_parser_get_samples_columnar (dc_parser_t *parser, dc_sample_columns_t *columns);
+
+/*
+ * Walk the samples, and report them with one callback per sample row,
+ * instead of one callback per value. The values before the first
+ * DC_SAMPLE_TIME value are ignored.
+ */
+dc_status_t
+dc_parser_samples_foreach_record (dc_parser_t *parser, dc_sample_record_callback_t callback, void *userdata);
+
+/*
+ * Walk the samples, and report a reduced profile for plotting. The dive
+ * is divided in buckets of the given interval (in seconds), and only the
+ * sample rows with the minimum and maximum depth of each bucket are
+ * reported, including all their values. The first and last rows, and
+ * the rows with an event or a gas switch, are always reported.
+ */
+dc_status_t
+dc_parser_samples_foreach_decimated (dc_parser_t *parser, unsigned int interval, dc_sample_callback_t callback, void *userdata);
+
+/*
+ * Parse the entire dive at once. This is intended for language bindings,
+ * which need only a single call and a single dc_dive_free per dive,
+ * instead of one call per field and one callback per sample.
+ */
+dc_status_t
+dc_parser_materialize (dc_parser_t *parser, dc_dive_t **dive);
+
+void
+dc_dive_free (dc_dive_t *dive);
+
+dc_status_t
+dc_sample_columns_convert (dc_sample_columns_t *columns, const dc_sample_conversion_t *conversion);
+
+/*
+ * Resample the columnar sample arrays on a uniform time grid, starting
+ * at the time of the first row, with the given interval (in seconds).
+ * The depth, temperature, ppo2 and tank pressure columns, when present
+ * in both the input and the output, are interpolated linearly between
+ * the nearest values before and after each grid point. Grid points
+ * outside the first and last value of a column are set to NAN. The
+ * events are copied, and their sample index is snapped to the nearest
+ * grid row. As with dc_parser_get_samples_columnar, the count fields
+ * are set to the total number of rows and events, and
+ * #DC_STATUS_NOMEMORY is returned if they exceed the capacity.
+ */
+dc_status_t
+dc_sample_columns_resample (const dc_sample_columns_t *input, unsigned int interval, dc_sample_columns_t *output);
+
 dc_status_t
 dc_parser_destroy (dc_parser_t *parser);
 
+/*
+ * Incremental parsing, while the dive data is still being downloaded.
+ * Every call appends the next chunk of the dive, and reports the sample
+ * rows which are complete in the data received so far, each exactly
+ * once. A chunk with a zero size marks the end of the dive: the
+ * remaining samples are reported, and the parser is left with the
+ * complete dive, as if it was passed to dc_parser_set_data. Only the
+ * formats which are stored sequentially are supported (Suunto EON
+ * Steel, Shearwater and Heinrichs Weikamp).
+ */
+dc_status_t
+dc_parser_feed (dc_parser_t *parser, const unsigned char data[], unsigned int size, dc_sample_callback_t callback, void *userdata);
+
+/*
+ * A pool of idle parsers, keyed by model and clock. A parser that is
+ * returned to the pool is handed out again by the next get with the same
+ * descriptor, devtime and systime. The pool itself is not thread-safe.
+ *
+ * On return to the pool, the parser is restored to its default
+ * configuration: the cache and the vendor samples are reset. A parser
+ * with a changed calibration is destroyed instead.
+ */
+dc_status_t
+dc_parser_pool_new (dc_parser_pool_t **pool, dc_context_t *context);
+
+dc_status_t
+dc_parser_pool_get (dc_parser_pool_t *pool, dc_parser_t **parser, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime);
+
+dc_status_t
+dc_parser_pool_put (dc_parser_pool_t *pool, dc_parser_t *parser);
+
+dc_status_t
+dc_parser_pool_free (dc_parser_pool_t *pool);
+
+/*
+ * A cache of decoded dives, keyed by family, model, the device and
+ * system clock (devtime and systime) of the parser, the calibration
+ * settings and a checksum of the dive data. A parser with a cache
+ * attached serves repeated datetime, field and sample requests for the
+ * same data from the cache. Parsers with a different clock or
+ * calibration never share an entry, and changing the calibration of a
+ * parser invalidates its cached entry. The cache must outlive the
+ * parsers using it, and is not thread-safe.
+ */
+dc_status_t
+dc_parser_cache_new (dc_parser_cache_t **cache, dc_context_t *context, unsigned int capacity);
+
+dc_status_t
+dc_parser_cache_free (dc_parser_cache_t *cache);
+
+dc_status_t
+dc_parser_set_cache (dc_parser_t *parser, dc_parser_cache_t *cache);
+
+/*
+ * Random access to the samples of a dive. The samples are decoded once
+ * when the cursor is created, with a sparse index of the sample rows.
+ * Seeking positions the cursor at the first sample row with a time at
+ * or after the requested time, and next returns the samples one by one
+ * until DC_STATUS_DONE. The cursor doesn't reference the parser, and
+ * vendor sample data remains valid until the cursor is freed.
+ */
+dc_status_t
+dc_parser_sample_cursor_new (dc_parser_sample_cursor_t **cursor, dc_parser_t *parser);
+
+dc_status_t
+dc_parser_sample_cursor_seek (dc_parser_sample_cursor_t *cursor, unsigned int time);
+
+dc_status_t
+dc_parser_sample_cursor_next (dc_parser_sample_cursor_t *cursor, dc_sample_type_t *type, dc_sample_value_t *value);
+
+dc_status_t
+dc_parser_sample_cursor_free (dc_parser_sample_cursor_t *cursor);
+
+/*
+ * Compact, lossless binary serialization of the sample data. The buffer
+ * is cleared and filled with the encoded samples of the parser, and the
+ * decoder delivers them again through the sample callback.
+ */
+dc_status_t
+dc_profile_encode (dc_parser_t *parser, dc_buffer_t *buffer);
+
+dc_status_t
+dc_profile_decode (const unsigned char data[], unsigned int size, dc_sample_callback_t callback, void *userdata);
+
+/*
+ * The jobs of a batch are parsed by up to nthreads workers of the
+ * executor of the context (see dc_context_set_executor). With zero
+ * threads, the jobs are parsed by the calling thread. A batch can also
+ * run within a task of the executor. The worker then runs the pending
+ * tasks while waiting, or with an application supplied executor, parses
+ * the jobs itself.
+ */
+dc_status_t
+dc_parser_batch_new (dc_parser_batch_t **batch, dc_context_t *context, unsigned int nthreads);
+
+dc_status_t
+dc_parser_batch_run (dc_parser_batch_t *batch, const dc_parser_job_t jobs[], unsigned int count, dc_parser_batch_parse_t parse, dc_parser_batch_done_t done, void *userdata);
+
+dc_status_t
+dc_parser_batch_free (dc_parser_batch_t *batch);
+
+/*
+ * Download the dives, and parse them in the background. The download
+ * continues while up to nthreads workers of the executor of the context
+ * (see dc_context_set_executor) run the parse callback on a parser loaded
+ * with each downloaded dive. The parse callback is invoked
+ * from the worker threads, in no particular order. The done callback is
+ * invoked from the downloading thread, in dive order, and stops the
+ * download by returning zero, like the dive callback. Without worker
+ * threads, the dives are parsed on the downloading thread.
+ *
+ * The parse callback can store a result for the dive, which is passed to
+ * the done callback. The download waits for the oldest dive once too
+ * many parsed dives are pending. After the download stops, the remaining
+ * dives are still reported with #DC_STATUS_CANCELLED, so their results
+ * can be released.
+ *
+ * For a memory image, opened with dc_device_image_open, the dives which
+ * are stored contiguously in the image are passed without a copy. The
+ * extraction also runs ahead of the parsing, such that reprocessing an
+ * archived image scales with the number of worker threads.
+ */
+typedef dc_status_t (*dc_dive_parse_t) (dc_parser_t *parser, const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void **result, void *userdata);
+
+typedef int (*dc_dive_parsed_t) (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, dc_status_t status, void *result, void *userdata);
+
+dc_status_t
+dc_device_foreach_parsed (dc_device_t *device, unsigned int nthreads, dc_dive_parse_t parse, dc_dive_parsed_t done, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
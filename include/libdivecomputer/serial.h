@@ -83,8 +83,10 @@ dc_serial_open (dc_iostream_t **iostream, dc_context_t *context, const char *nam
  *
  * The effect of this setting is highly platform and driver specific. On
  * Windows it does nothing at all, on Linux it controls the low latency
- * flag (e.g. only zero vs non-zero latency), and on Mac OS X it sets
- * the receive latency as requested.
+ * flag (e.g. only zero vs non-zero latency) and the latency timer of
+ * USB serial converters (e.g. FTDI) when it is writable through sysfs,
+ * and on Mac OS X it sets the receive latency as requested. The
+ * original latency timer is restored when the serial port is closed.
  */
 #define DC_IOCTL_SERIAL_SET_LATENCY DC_IOCTL_IOW('s', 0, sizeof(unsigned int))
 
@@ -0,0 +1,171 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_STATISTICS_H
+#define DC_STATISTICS_H
+
+#include "common.h"
+#include "context.h"
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define DC_STATISTICS_NBANDS 8
+#define DC_STATISTICS_NTANKS 8
+
+/**
+ * Opaque object representing a dive statistics aggregator.
+ *
+ * The aggregator computes all statistics of a dive in a single pass
+ * over the samples. It can be fed directly from a sample callback, or
+ * run over the profile of a parser.
+ */
+typedef struct dc_statistics_t dc_statistics_t;
+
+/**
+ * Statistics configuration.
+ *
+ * The depth bands are given by their ascending upper limits (m). With n
+ * limits, the time at depth is reported for n + 1 bands, the last band
+ * without an upper limit. An ascent rate of zero disables the ascent
+ * rate checks.
+ */
+typedef struct dc_statistics_config_t {
+	unsigned int nbands;
+	double bands[DC_STATISTICS_NBANDS];
+	double ascentrate;  /* Maximum ascent rate (m/min) */
+} dc_statistics_config_t;
+
+typedef struct dc_statistics_tank_t {
+	unsigned int tank;     /* Tank index */
+	double beginpressure;  /* First pressure sample (bar) */
+	double endpressure;    /* Last pressure sample (bar) */
+	double volume;         /* Volume (liter), or zero if unknown */
+} dc_statistics_tank_t;
+
+/**
+ * Dive statistics.
+ *
+ * The average depth is time weighted. Values without any matching
+ * samples are set to NAN.
+ */
+typedef struct dc_statistics_result_t {
+	unsigned int divetime;        /* Time of the last sample (s) */
+	double maxdepth;              /* Maximum depth (m) */
+	double avgdepth;              /* Average depth (m) */
+	double mintemperature;        /* Minimum temperature (C) */
+	double maxtemperature;        /* Maximum temperature (C) */
+	unsigned int bands[DC_STATISTICS_NBANDS + 1]; /* Time at depth (s) */
+	double maxascentrate;         /* Fastest ascent (m/min) */
+	unsigned int ascents;         /* Number of ascent rate violations */
+	unsigned int ascenttime;      /* Time above the ascent rate (s) */
+	unsigned int ntanks;
+	dc_statistics_tank_t tanks[DC_STATISTICS_NTANKS];
+	double sac;                   /* Surface air consumption (liter/min) */
+} dc_statistics_result_t;
+
+/**
+ * Create a new statistics aggregator.
+ *
+ * @param[out]  statistics  A location to store the aggregator.
+ * @param[in]   context     A valid context.
+ * @param[in]   config      The configuration, or NULL for no depth bands
+ *                          and no ascent rate checks.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_statistics_new (dc_statistics_t **statistics, dc_context_t *context, const dc_statistics_config_t *config);
+
+/**
+ * Reset the aggregator to the start of a new dive.
+ *
+ * @param[in]  statistics   A valid statistics aggregator.
+ * @param[in]  atmospheric  The surface pressure (bar), or zero for the
+ *                          standard atmospheric pressure.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_statistics_reset (dc_statistics_t *statistics, double atmospheric);
+
+/**
+ * Set the volume of a tank, for the surface air consumption.
+ *
+ * @param[in]  statistics  A valid statistics aggregator.
+ * @param[in]  tank        The tank index, as in the pressure samples.
+ * @param[in]  volume      The volume (liter).
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_statistics_set_volume (dc_statistics_t *statistics, unsigned int tank, double volume);
+
+/**
+ * Sample callback, with the aggregator as the user data. This can be
+ * passed directly to #dc_parser_samples_foreach, or called from another
+ * sample callback.
+ */
+void
+dc_statistics_sample (dc_sample_type_t type, dc_sample_value_t value, void *userdata);
+
+/**
+ * Get the statistics of the samples so far.
+ *
+ * @param[in]   statistics  A valid statistics aggregator.
+ * @param[out]  result      A location to store the statistics.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_statistics_get (dc_statistics_t *statistics, dc_statistics_result_t *result);
+
+/**
+ * Compute the statistics of a dive.
+ *
+ * The aggregator is reset with the surface pressure and the tank
+ * volumes of the dive, and then walks the profile once.
+ *
+ * @param[in]   statistics  A valid statistics aggregator.
+ * @param[in]   parser      A parser with the dive data.
+ * @param[out]  result      A location to store the statistics.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_statistics_process (dc_statistics_t *statistics, dc_parser_t *parser, dc_statistics_result_t *result);
+
+/**
+ * Free the statistics aggregator.
+ *
+ * @param[in]  statistics  A valid statistics aggregator.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_statistics_free (dc_statistics_t *statistics);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_STATISTICS_H */
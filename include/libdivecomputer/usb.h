@@ -86,6 +86,28 @@ typedef enum dc_usb_recipient_t {
 	DC_USB_RECIPIENT_OTHER = 0x03,
 } dc_usb_recipient_t;
 
+/**
+ * Get the statistics of the asynchronous bulk transfers.
+ *
+ * The statistics are only available when the USB connection uses the
+ * asynchronous transfers. The latencies are measured from the
+ * submission of a transfer until its completion, in microseconds.
+ */
+#define DC_IOCTL_USB_STATISTICS DC_IOCTL_IOR('u', 1, sizeof(dc_usb_statistics_t))
+
+/**
+ * USB transfer statistics.
+ */
+typedef struct dc_usb_statistics_t {
+	unsigned int transfers;
+	unsigned int errors;
+	unsigned int queued_max;
+	unsigned long long bytes;
+	unsigned long long latency_total;
+	unsigned int latency_min;
+	unsigned int latency_max;
+} dc_usb_statistics_t;
+
 /**
  * Opaque object representing a USB device.
  */
@@ -127,6 +149,66 @@ dc_usb_device_free(dc_usb_device_t *device);
 dc_status_t
 dc_usb_iterator_new (dc_iterator_t **iterator, dc_context_t *context, dc_descriptor_t *descriptor);
 
+/**
+ * Opaque object representing a USB hotplug subscription.
+ */
+typedef struct dc_usb_hotplug_t dc_usb_hotplug_t;
+
+/**
+ * USB hotplug events.
+ */
+typedef enum dc_usb_hotplug_event_t {
+	DC_USB_HOTPLUG_ARRIVED,
+	DC_USB_HOTPLUG_LEFT
+} dc_usb_hotplug_event_t;
+
+/**
+ * USB hotplug callback.
+ *
+ * The device is owned by the callback, and must be freed with
+ * #dc_usb_device_free. The callback is called from the event thread of
+ * the subscription, except for the devices which are already connected
+ * when the subscription is created.
+ *
+ * @param[in]  event     The hotplug event.
+ * @param[in]  device    The USB device.
+ * @param[in]  userdata  The user data passed to the subscription.
+ */
+typedef void (*dc_usb_hotplug_callback_t) (dc_usb_hotplug_event_t event, dc_usb_device_t *device, void *userdata);
+
+/**
+ * Subscribe to the USB hotplug events.
+ *
+ * Instead of enumerating the USB devices again and again, the callback
+ * is notified as soon as a device arrives or leaves. Only the devices
+ * accepted by the descriptor are reported, in the same way as with the
+ * USB iterator. The devices which are already connected are reported
+ * first, before this function returns.
+ *
+ * @param[out] hotplug     A location to store the subscription.
+ * @param[in]  context     A valid context object.
+ * @param[in]  descriptor  A valid device descriptor or NULL.
+ * @param[in]  callback    The hotplug callback.
+ * @param[in]  userdata    The user data for the callback.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if
+ * hotplug notifications are not available on the platform, or another
+ * #dc_status_t code on failure.
+ */
+dc_status_t
+dc_usb_hotplug_new (dc_usb_hotplug_t **hotplug, dc_context_t *context, dc_descriptor_t *descriptor, dc_usb_hotplug_callback_t callback, void *userdata);
+
+/**
+ * Cancel the subscription and free all resources.
+ *
+ * No more callbacks are called after this function returns.
+ *
+ * @param[in]  hotplug  A valid subscription.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_usb_hotplug_free (dc_usb_hotplug_t *hotplug);
+
 /**
  * Open a USB connection.
  *
@@ -0,0 +1,69 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <libdivecomputer/context.h>
+
+#include "allocator.h"
+
+static dc_malloc_t g_malloc = malloc;
+static dc_realloc_t g_realloc = realloc;
+static dc_free_t g_free = free;
+
+dc_status_t
+dc_set_allocator (dc_malloc_t mallocfunc, dc_realloc_t reallocfunc, dc_free_t freefunc)
+{
+	if ((mallocfunc == NULL) != (reallocfunc == NULL) ||
+		(mallocfunc == NULL) != (freefunc == NULL))
+		return DC_STATUS_INVALIDARGS;
+
+	if (mallocfunc == NULL) {
+		// Restore the standard C library functions.
+		g_malloc = malloc;
+		g_realloc = realloc;
+		g_free = free;
+	} else {
+		g_malloc = mallocfunc;
+		g_realloc = reallocfunc;
+		g_free = freefunc;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+void *
+dc_malloc (size_t size)
+{
+	return g_malloc (size);
+}
+
+void *
+dc_realloc (void *ptr, size_t size)
+{
+	return g_realloc (ptr, size);
+}
+
+void
+dc_free (void *ptr)
+{
+	g_free (ptr);
+}
@@ -0,0 +1,48 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_ALLOCATOR_H
+#define DC_ALLOCATOR_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The memory allocation functions of the library, which forward to the
+ * functions installed with dc_set_allocator. Memory allocated
+ * with these functions must be released with dc_free.
+ */
+void *
+dc_malloc (size_t size);
+
+void *
+dc_realloc (void *ptr, size_t size);
+
+void
+dc_free (void *ptr);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_ALLOCATOR_H */
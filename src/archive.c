@@ -0,0 +1,829 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_ZLIB
+#define ZLIB_CONST
+#include <zlib.h>
+#endif
+
+#include <libdivecomputer/archive.h>
+
+#include "context-private.h"
+#include "thread.h"
+#include "array.h"
+#include "checksum.h"
+
+/*
+ * The archive starts with an 8 byte header (the "DCAR" magic, a version
+ * byte and three reserved bytes), followed by a sequence of records.
+ * Every record has a 28 byte header:
+ *
+ *     0  type (dive or dictionary)
+ *     1  compression method
+ *     2  size of the fingerprint
+ *     3  reserved
+ *     4  family, model and serial number (32 bit each)
+ *    16  uncompressed size
+ *    20  compressed size
+ *    24  CRC-32 of the uncompressed data
+ *
+ * followed by the fingerprint and the compressed data. All numbers are
+ * little endian. Records are only ever appended, so an interrupted
+ * write can only leave an incomplete record at the end of the file.
+ *
+ * Raw dives of the same family share a lot of structure: the same
+ * header layout and the same sample encoding. Compressing every dive
+ * on its own misses most of that, because a single dive is small. Once
+ * enough dives of a family are available, a dictionary is built from
+ * those dives and stored in the archive, and all further dives of that
+ * family are compressed with that dictionary.
+ */
+
+#define MAGIC           "DCAR"
+#define ARCHIVE_VERSION 1
+
+#define SZ_HEADER       8
+#define SZ_RECORD       28
+#define MAXFINGERPRINT  DC_ARCHIVE_MAXFINGERPRINT
+
+#define SZ_DICTIONARY   32768
+#define NTRAINING       8
+
+typedef enum dc_archive_type_t {
+	RECORD_DIVE = 1,
+	RECORD_DICTIONARY = 2,
+} dc_archive_type_t;
+
+typedef enum dc_archive_method_t {
+	METHOD_STORED = 0,
+	METHOD_DEFLATE = 1,
+	METHOD_DICTIONARY = 2,
+} dc_archive_method_t;
+
+typedef struct dc_archive_record_t {
+	long offset;
+	dc_archive_method_t method;
+	dc_family_t family;
+	unsigned int model;
+	unsigned int serial;
+	unsigned int size;
+	unsigned int csize;
+	unsigned int crc;
+	unsigned int fsize;
+	unsigned char fingerprint[MAXFINGERPRINT];
+} dc_archive_record_t;
+
+typedef struct dc_archive_dictionary_t {
+	struct dc_archive_dictionary_t *next;
+	dc_family_t family;
+	long offset;
+	unsigned int size;
+	unsigned char *data;
+} dc_archive_dictionary_t;
+
+struct dc_archive_t {
+	dc_context_t *context;
+	dc_mutex_t *mutex;
+	FILE *fp;
+	long end;
+	int damaged;
+	dc_archive_record_t *records;
+	unsigned int count;
+	unsigned int capacity;
+	dc_archive_dictionary_t *dictionaries;
+	dc_buffer_t *parserdata;
+};
+
+static dc_archive_dictionary_t *
+dc_archive_find_dictionary (dc_archive_t *archive, dc_family_t family)
+{
+	for (dc_archive_dictionary_t *dictionary = archive->dictionaries; dictionary; dictionary = dictionary->next) {
+		if (dictionary->family == family)
+			return dictionary;
+	}
+
+	return NULL;
+}
+
+static dc_status_t
+dc_archive_add_dictionary (dc_archive_t *archive, dc_family_t family, long offset, unsigned int size)
+{
+	// Only the first dictionary of a family is used.
+	if (dc_archive_find_dictionary (archive, family))
+		return DC_STATUS_SUCCESS;
+
+	dc_archive_dictionary_t *dictionary = (dc_archive_dictionary_t *) malloc (sizeof (dc_archive_dictionary_t));
+	if (dictionary == NULL) {
+		ERROR (archive->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	dictionary->family = family;
+	dictionary->offset = offset;
+	dictionary->size = size;
+	dictionary->data = NULL;
+	dictionary->next = archive->dictionaries;
+	archive->dictionaries = dictionary;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_archive_add_record (dc_archive_t *archive, const dc_archive_record_t *record)
+{
+	if (archive->count == archive->capacity) {
+		unsigned int capacity = archive->capacity ? archive->capacity * 2 : 64;
+		dc_archive_record_t *records = (dc_archive_record_t *) realloc (archive->records, capacity * sizeof (dc_archive_record_t));
+		if (records == NULL) {
+			ERROR (archive->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+		archive->records = records;
+		archive->capacity = capacity;
+	}
+
+	archive->records[archive->count++] = *record;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_archive_load (dc_archive_t *archive)
+{
+	unsigned char header[SZ_RECORD];
+
+	if (fseek (archive->fp, 0, SEEK_END) != 0) {
+		ERROR (archive->context, "Failed to seek the archive file.");
+		return DC_STATUS_IO;
+	}
+
+	long length = ftell (archive->fp);
+	if (length < 0) {
+		ERROR (archive->context, "Failed to seek the archive file.");
+		return DC_STATUS_IO;
+	}
+
+	// A new archive.
+	if (length == 0) {
+		memset (header, 0, SZ_HEADER);
+		memcpy (header, MAGIC, 4);
+		header[4] = ARCHIVE_VERSION;
+		if (fwrite (header, 1, SZ_HEADER, archive->fp) != SZ_HEADER || fflush (archive->fp) != 0) {
+			ERROR (archive->context, "Failed to write the archive file.");
+			return DC_STATUS_IO;
+		}
+		archive->end = SZ_HEADER;
+		return DC_STATUS_SUCCESS;
+	}
+
+	if (fseek (archive->fp, 0, SEEK_SET) != 0 ||
+		fread (header, 1, SZ_HEADER, archive->fp) != SZ_HEADER ||
+		memcmp (header, MAGIC, 4) != 0) {
+		ERROR (archive->context, "Unrecognized archive file.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	if (header[4] != ARCHIVE_VERSION) {
+		ERROR (archive->context, "Unsupported archive version (%u).", header[4]);
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	long offset = SZ_HEADER;
+	while (offset < length) {
+		dc_archive_record_t record;
+
+		if (length - offset < SZ_RECORD) {
+			WARNING (archive->context, "Ignoring incomplete record at the end of the archive.");
+			break;
+		}
+
+		if (fseek (archive->fp, offset, SEEK_SET) != 0 ||
+			fread (header, 1, SZ_RECORD, archive->fp) != SZ_RECORD) {
+			ERROR (archive->context, "Failed to read the archive file.");
+			return DC_STATUS_IO;
+		}
+
+		unsigned int type = header[0];
+		record.method = (dc_archive_method_t) header[1];
+		record.fsize = header[2];
+		record.family = (dc_family_t) array_uint32_le (header + 4);
+		record.model = array_uint32_le (header + 8);
+		record.serial = array_uint32_le (header + 12);
+		record.size = array_uint32_le (header + 16);
+		record.csize = array_uint32_le (header + 20);
+		record.crc = array_uint32_le (header + 24);
+		record.offset = offset + SZ_RECORD + record.fsize;
+
+		// Records are only appended, so a record extending beyond the
+		// end of the file can only be an interrupted write.
+		if (record.fsize > (unsigned long) (length - offset - SZ_RECORD) ||
+			record.csize > (unsigned long) (length - record.offset)) {
+			WARNING (archive->context, "Ignoring incomplete record at the end of the archive.");
+			break;
+		}
+
+		// An invalid record in the middle of the archive is skipped. The
+		// archive can no longer be trusted for appending, because the
+		// dictionary of a family may be missing.
+		if ((type != RECORD_DIVE && type != RECORD_DICTIONARY) ||
+			record.method > METHOD_DICTIONARY ||
+			record.fsize > MAXFINGERPRINT ||
+			(type == RECORD_DICTIONARY && (record.method != METHOD_STORED || record.size != record.csize))) {
+			WARNING (archive->context, "Skipping invalid record at offset %ld.", offset);
+			archive->damaged = 1;
+			offset = record.offset + record.csize;
+			continue;
+		}
+
+		if (fread (record.fingerprint, 1, record.fsize, archive->fp) != record.fsize) {
+			ERROR (archive->context, "Failed to read the archive file.");
+			return DC_STATUS_IO;
+		}
+
+		dc_status_t status = DC_STATUS_SUCCESS;
+		if (type == RECORD_DICTIONARY) {
+			status = dc_archive_add_dictionary (archive, record.family, record.offset, record.size);
+		} else {
+			status = dc_archive_add_record (archive, &record);
+		}
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		offset = record.offset + record.csize;
+	}
+
+	// New records overwrite an incomplete record at the end.
+	archive->end = offset;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_archive_read_payload (dc_archive_t *archive, long offset, unsigned char data[], unsigned int size)
+{
+	if (fseek (archive->fp, offset, SEEK_SET) != 0 ||
+		fread (data, 1, size, archive->fp) != size) {
+		ERROR (archive->context, "Failed to read the archive file.");
+		return DC_STATUS_IO;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_archive_write_record (dc_archive_t *archive, dc_archive_type_t type, dc_archive_record_t *record, const unsigned char data[])
+{
+	unsigned char header[SZ_RECORD] = {0};
+	header[0] = type;
+	header[1] = record->method;
+	header[2] = record->fsize;
+	array_uint32_le_set (header + 4, record->family);
+	array_uint32_le_set (header + 8, record->model);
+	array_uint32_le_set (header + 12, record->serial);
+	array_uint32_le_set (header + 16, record->size);
+	array_uint32_le_set (header + 20, record->csize);
+	array_uint32_le_set (header + 24, record->crc);
+
+	if (fseek (archive->fp, archive->end, SEEK_SET) != 0 ||
+		fwrite (header, 1, SZ_RECORD, archive->fp) != SZ_RECORD ||
+		fwrite (record->fingerprint, 1, record->fsize, archive->fp) != record->fsize ||
+		fwrite (data, 1, record->csize, archive->fp) != record->csize ||
+		fflush (archive->fp) != 0) {
+		ERROR (archive->context, "Failed to write the archive file.");
+		return DC_STATUS_IO;
+	}
+
+	record->offset = archive->end + SZ_RECORD + record->fsize;
+	archive->end = record->offset + record->csize;
+
+	return DC_STATUS_SUCCESS;
+}
+
+#ifdef HAVE_ZLIB
+static dc_status_t
+dc_archive_deflate (dc_archive_t *archive, const dc_archive_dictionary_t *dictionary, const unsigned char data[], unsigned int size, dc_buffer_t *output)
+{
+	z_stream stream;
+	memset (&stream, 0, sizeof (stream));
+
+	// Raw deflate, without the zlib header and checksum.
+	if (deflateInit2 (&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+		ERROR (archive->context, "Failed to initialize the compression.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (dictionary && deflateSetDictionary (&stream, dictionary->data, dictionary->size) != Z_OK) {
+		ERROR (archive->context, "Failed to set the compression dictionary.");
+		status = DC_STATUS_IO;
+		goto error_end;
+	}
+
+	unsigned long bound = deflateBound (&stream, size);
+	if (!dc_buffer_resize (output, bound)) {
+		ERROR (archive->context, "Insufficient buffer space available.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_end;
+	}
+
+	stream.next_in = data;
+	stream.avail_in = size;
+	stream.next_out = dc_buffer_get_data (output);
+	stream.avail_out = bound;
+	if (deflate (&stream, Z_FINISH) != Z_STREAM_END) {
+		ERROR (archive->context, "Failed to compress the dive.");
+		status = DC_STATUS_IO;
+		goto error_end;
+	}
+
+	dc_buffer_resize (output, stream.total_out);
+
+error_end:
+	deflateEnd (&stream);
+	return status;
+}
+
+static dc_status_t
+dc_archive_inflate (dc_archive_t *archive, const dc_archive_dictionary_t *dictionary, const unsigned char data[], unsigned int csize, unsigned char output[], unsigned int size)
+{
+	z_stream stream;
+	memset (&stream, 0, sizeof (stream));
+
+	if (inflateInit2 (&stream, -15) != Z_OK) {
+		ERROR (archive->context, "Failed to initialize the decompression.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// A raw inflate needs the dictionary before the first byte.
+	if (dictionary && inflateSetDictionary (&stream, dictionary->data, dictionary->size) != Z_OK) {
+		ERROR (archive->context, "Failed to set the compression dictionary.");
+		status = DC_STATUS_IO;
+		goto error_end;
+	}
+
+	stream.next_in = data;
+	stream.avail_in = csize;
+	stream.next_out = output;
+	stream.avail_out = size;
+	if (inflate (&stream, Z_FINISH) != Z_STREAM_END || stream.total_out != size) {
+		ERROR (archive->context, "Failed to decompress the dive.");
+		status = DC_STATUS_DATAFORMAT;
+		goto error_end;
+	}
+
+error_end:
+	inflateEnd (&stream);
+	return status;
+}
+#endif
+
+static dc_status_t
+dc_archive_get_dictionary (dc_archive_t *archive, dc_family_t family, dc_archive_dictionary_t **out)
+{
+	dc_archive_dictionary_t *dictionary = dc_archive_find_dictionary (archive, family);
+	if (dictionary && dictionary->data == NULL) {
+		unsigned char *data = (unsigned char *) malloc (dictionary->size ? dictionary->size : 1);
+		if (data == NULL) {
+			ERROR (archive->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		dc_status_t status = dc_archive_read_payload (archive, dictionary->offset, data, dictionary->size);
+		if (status != DC_STATUS_SUCCESS) {
+			free (data);
+			return status;
+		}
+
+		dictionary->data = data;
+	}
+
+	*out = dictionary;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_archive_decode (dc_archive_t *archive, const dc_archive_record_t *record, dc_buffer_t *buffer)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (!dc_buffer_resize (buffer, record->size)) {
+		ERROR (archive->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+
+	if (record->method == METHOD_STORED) {
+		status = dc_archive_read_payload (archive, record->offset, data, record->size);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	} else {
+#ifdef HAVE_ZLIB
+		dc_archive_dictionary_t *dictionary = NULL;
+		if (record->method == METHOD_DICTIONARY) {
+			status = dc_archive_get_dictionary (archive, record->family, &dictionary);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+			if (dictionary == NULL) {
+				ERROR (archive->context, "Missing compression dictionary.");
+				return DC_STATUS_DATAFORMAT;
+			}
+		}
+
+		unsigned char *compressed = (unsigned char *) malloc (record->csize ? record->csize : 1);
+		if (compressed == NULL) {
+			ERROR (archive->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		status = dc_archive_read_payload (archive, record->offset, compressed, record->csize);
+		if (status == DC_STATUS_SUCCESS)
+			status = dc_archive_inflate (archive, dictionary, compressed, record->csize, data, record->size);
+		free (compressed);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+#else
+		ERROR (archive->context, "Compressed dives are not supported.");
+		return DC_STATUS_UNSUPPORTED;
+#endif
+	}
+
+	if (checksum_crc32 (data, record->size) != record->crc) {
+		ERROR (archive->context, "Unexpected dive checksum.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+#ifdef HAVE_ZLIB
+static dc_status_t
+dc_archive_train (dc_archive_t *archive, dc_family_t family)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Count the dives of the family.
+	unsigned int nsamples = 0;
+	for (unsigned int i = 0; i < archive->count; ++i) {
+		if (archive->records[i].family == family)
+			nsamples++;
+	}
+
+	if (nsamples < NTRAINING)
+		return DC_STATUS_SUCCESS;
+
+	dc_buffer_t *dictionary = dc_buffer_new (SZ_DICTIONARY);
+	dc_buffer_t *sample = dc_buffer_new (0);
+	if (dictionary == NULL || sample == NULL) {
+		ERROR (archive->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	// Every training dive contributes an equal part of the dictionary.
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < archive->count && n < NTRAINING; ++i) {
+		const dc_archive_record_t *record = archive->records + i;
+		if (record->family != family)
+			continue;
+
+		status = dc_archive_decode (archive, record, sample);
+		if (status != DC_STATUS_SUCCESS)
+			goto error_free;
+
+		unsigned int length = dc_buffer_get_size (sample);
+		if (length > SZ_DICTIONARY / NTRAINING)
+			length = SZ_DICTIONARY / NTRAINING;
+
+		if (!dc_buffer_append (dictionary, dc_buffer_get_data (sample), length)) {
+			ERROR (archive->context, "Insufficient buffer space available.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_free;
+		}
+
+		n++;
+	}
+
+	dc_archive_record_t record;
+	memset (&record, 0, sizeof (record));
+	record.method = METHOD_STORED;
+	record.family = family;
+	record.size = record.csize = dc_buffer_get_size (dictionary);
+	record.crc = checksum_crc32 (dc_buffer_get_data (dictionary), record.size);
+
+	status = dc_archive_write_record (archive, RECORD_DICTIONARY, &record, dc_buffer_get_data (dictionary));
+	if (status != DC_STATUS_SUCCESS)
+		goto error_free;
+
+	status = dc_archive_add_dictionary (archive, family, record.offset, record.size);
+
+error_free:
+	dc_buffer_free (sample);
+	dc_buffer_free (dictionary);
+	return status;
+}
+#endif
+
+dc_status_t
+dc_archive_open (dc_archive_t **out, dc_context_t *context, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_archive_t *archive = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	archive = (dc_archive_t *) malloc (sizeof (dc_archive_t));
+	if (archive == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	archive->context = context;
+	archive->mutex = NULL;
+	archive->end = 0;
+	archive->damaged = 0;
+	archive->records = NULL;
+	archive->count = 0;
+	archive->capacity = 0;
+	archive->dictionaries = NULL;
+
+	archive->parserdata = dc_buffer_new (0);
+	if (archive->parserdata == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	status = dc_mutex_new (&archive->mutex);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create the mutex.");
+		goto error_free_buffer;
+	}
+
+	archive->fp = fopen (filename, "r+b");
+	if (archive->fp == NULL && errno == ENOENT)
+		archive->fp = fopen (filename, "w+b");
+	if (archive->fp == NULL) {
+		ERROR (context, "Failed to open the archive file (%s).", filename);
+		status = DC_STATUS_IO;
+		goto error_free_mutex;
+	}
+
+	status = dc_archive_load (archive);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_close;
+	}
+
+	*out = archive;
+
+	return DC_STATUS_SUCCESS;
+
+error_close:
+	fclose (archive->fp);
+	while (archive->dictionaries) {
+		dc_archive_dictionary_t *next = archive->dictionaries->next;
+		free (archive->dictionaries);
+		archive->dictionaries = next;
+	}
+	free (archive->records);
+error_free_mutex:
+	dc_mutex_free (archive->mutex);
+error_free_buffer:
+	dc_buffer_free (archive->parserdata);
+error_free:
+	free (archive);
+	return status;
+}
+
+dc_status_t
+dc_archive_add (dc_archive_t *archive, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (archive == NULL || (data == NULL && size) || (fingerprint == NULL && fsize) || fsize > MAXFINGERPRINT)
+		return DC_STATUS_INVALIDARGS;
+
+	// The damaged flag is only set while opening the archive.
+	if (archive->damaged) {
+		ERROR (archive->context, "Refusing to append to a damaged archive.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	dc_archive_record_t record;
+	memset (&record, 0, sizeof (record));
+	record.method = METHOD_STORED;
+	record.family = family;
+	record.model = model;
+	record.serial = serial;
+	record.size = size;
+	record.csize = size;
+	record.crc = checksum_crc32 (data, size);
+	record.fsize = fsize;
+	if (fsize)
+		memcpy (record.fingerprint, fingerprint, fsize);
+
+	dc_mutex_lock (archive->mutex);
+
+	const unsigned char *payload = data;
+
+#ifdef HAVE_ZLIB
+	dc_buffer_t *compressed = dc_buffer_new (0);
+	if (compressed == NULL) {
+		ERROR (archive->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_unlock;
+	}
+
+	dc_archive_dictionary_t *dictionary = NULL;
+	status = dc_archive_get_dictionary (archive, family, &dictionary);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_free;
+
+	status = dc_archive_deflate (archive, dictionary, data, size, compressed);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_free;
+
+	// Incompressible dives are stored as is.
+	if (dc_buffer_get_size (compressed) < size) {
+		record.method = dictionary ? METHOD_DICTIONARY : METHOD_DEFLATE;
+		record.csize = dc_buffer_get_size (compressed);
+		payload = dc_buffer_get_data (compressed);
+	}
+#endif
+
+	status = dc_archive_write_record (archive, RECORD_DIVE, &record, payload);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_free;
+
+	status = dc_archive_add_record (archive, &record);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_free;
+
+#ifdef HAVE_ZLIB
+	// Train the dictionary as soon as enough dives are available. A
+	// failure only affects the compression of the next dives.
+	if (dictionary == NULL && dc_archive_train (archive, family) != DC_STATUS_SUCCESS) {
+		WARNING (archive->context, "Failed to train the compression dictionary.");
+	}
+#endif
+
+error_free:
+#ifdef HAVE_ZLIB
+	dc_buffer_free (compressed);
+error_unlock:
+#endif
+	dc_mutex_unlock (archive->mutex);
+	return status;
+}
+
+unsigned int
+dc_archive_get_count (dc_archive_t *archive)
+{
+	if (archive == NULL)
+		return 0;
+
+	dc_mutex_lock (archive->mutex);
+	unsigned int count = archive->count;
+	dc_mutex_unlock (archive->mutex);
+
+	return count;
+}
+
+dc_status_t
+dc_archive_get_entry (dc_archive_t *archive, unsigned int index, dc_archive_entry_t *entry)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (archive == NULL || entry == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (archive->mutex);
+
+	if (index >= archive->count) {
+		status = DC_STATUS_INVALIDARGS;
+		goto error_unlock;
+	}
+
+	const dc_archive_record_t *record = archive->records + index;
+	entry->family = record->family;
+	entry->model = record->model;
+	entry->serial = record->serial;
+	entry->size = record->size;
+	memcpy (entry->fingerprint, record->fingerprint, record->fsize);
+	entry->fsize = record->fsize;
+
+error_unlock:
+	dc_mutex_unlock (archive->mutex);
+	return status;
+}
+
+dc_status_t
+dc_archive_read (dc_archive_t *archive, unsigned int index, dc_buffer_t *buffer)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (archive == NULL || buffer == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (archive->mutex);
+
+	if (index >= archive->count) {
+		status = DC_STATUS_INVALIDARGS;
+		goto error_unlock;
+	}
+
+	status = dc_archive_decode (archive, archive->records + index, buffer);
+
+error_unlock:
+	dc_mutex_unlock (archive->mutex);
+	return status;
+}
+
+dc_status_t
+dc_archive_set_parser_data (dc_archive_t *archive, unsigned int index, dc_parser_t *parser)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (archive == NULL || parser == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (archive->mutex);
+
+	if (index >= archive->count) {
+		status = DC_STATUS_INVALIDARGS;
+		goto error_unlock;
+	}
+
+	status = dc_archive_decode (archive, archive->records + index, archive->parserdata);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_unlock;
+
+	status = dc_parser_set_data (parser,
+		dc_buffer_get_data (archive->parserdata),
+		dc_buffer_get_size (archive->parserdata));
+
+error_unlock:
+	dc_mutex_unlock (archive->mutex);
+	return status;
+}
+
+dc_status_t
+dc_archive_close (dc_archive_t *archive)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (archive == NULL)
+		return DC_STATUS_SUCCESS;
+
+	if (fclose (archive->fp) != 0) {
+		ERROR (archive->context, "Failed to close the archive file.");
+		status = DC_STATUS_IO;
+	}
+
+	dc_archive_dictionary_t *dictionary = archive->dictionaries;
+	while (dictionary) {
+		dc_archive_dictionary_t *next = dictionary->next;
+		free (dictionary->data);
+		free (dictionary);
+		dictionary = next;
+	}
+
+	free (archive->records);
+	dc_buffer_free (archive->parserdata);
+	dc_mutex_free (archive->mutex);
+	free (archive);
+
+	return status;
+}
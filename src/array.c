@@ -21,6 +21,10 @@
 
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "array.h"
 
 void
@@ -38,15 +42,11 @@ void
 array_reverse_bits (unsigned char data[], unsigned int size)
 {
 	for (unsigned int i = 0; i < size; ++i) {
-		unsigned char j = 0;
-		j  = (data[i] & 0x01) << 7;
-		j += (data[i] & 0x02) << 5;
-		j += (data[i] & 0x04) << 3;
-		j += (data[i] & 0x08) << 1;
-		j += (data[i] & 0x10) >> 1;
-		j += (data[i] & 0x20) >> 3;
-		j += (data[i] & 0x40) >> 5;
-		j += (data[i] & 0x80) >> 7;
+		// Swap the nibbles, then the bit pairs, and finally the bits.
+		unsigned int j = data[i];
+		j = ((j & 0xF0) >> 4) | ((j & 0x0F) << 4);
+		j = ((j & 0xCC) >> 2) | ((j & 0x33) << 2);
+		j = ((j & 0xAA) >> 1) | ((j & 0x55) << 1);
 		data[i] = j;
 	}
 }
@@ -55,12 +55,16 @@ array_reverse_bits (unsigned char data[], unsigned int size)
 int
 array_isequal (const unsigned char data[], unsigned int size, unsigned char value)
 {
-	for (unsigned int i = 0; i < size; ++i) {
-		if (data[i] != value)
-			return 0;
-	}
+	if (size == 0)
+		return 1;
+
+	// If the first byte matches, the data is uniform if it equals itself
+	// shifted by one byte. This lets the optimized memcmp of the C library
+	// do the work on large memory dumps.
+	if (data[0] != value)
+		return 0;
 
-	return 1;
+	return memcmp (data, data + 1, size - 1) == 0;
 }
 
 
@@ -68,11 +72,19 @@ const unsigned char *
 array_search_forward (const unsigned char *data, unsigned int size,
                       const unsigned char *marker, unsigned int msize)
 {
+	if (msize == 0)
+		return data;
+
+	// Skip ahead to the candidates with the optimized memchr of the C
+	// library, and compare the full marker only at those positions.
 	while (size >= msize) {
-		if (memcmp (data, marker, msize) == 0)
-			return data;
-		size--;
-		data++;
+		const unsigned char *p = (const unsigned char *) memchr (data, marker[0], size - msize + 1);
+		if (p == NULL)
+			break;
+		if (memcmp (p, marker, msize) == 0)
+			return p;
+		size -= p - data + 1;
+		data = p + 1;
 	}
 	return NULL;
 }
@@ -83,8 +95,11 @@ array_search_backward (const unsigned char *data, unsigned int size,
                        const unsigned char *marker, unsigned int msize)
 {
 	data += size;
+	if (msize == 0)
+		return data;
+
 	while (size >= msize) {
-		if (memcmp (data - msize, marker, msize) == 0)
+		if (*(data - msize) == marker[0] && memcmp (data - msize, marker, msize) == 0)
 			return data;
 		size--;
 		data--;
@@ -93,8 +108,114 @@ array_search_backward (const unsigned char *data, unsigned int size,
 }
 
 
+#ifdef __SSE2__
+/*
+ * Convert blocks of 16 bytes to 32 hexadecimal digits. The digits are
+ * calculated as '0' + n, plus the distance to 'A' for the values above
+ * nine, and interleaved into the output. Returns the number of bytes
+ * converted.
+ */
+static unsigned int
+array_convert_bin2hex_sse2 (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned char *sum)
+{
+	const __m128i mask = _mm_set1_epi8 (0x0F);
+	const __m128i nine = _mm_set1_epi8 (9);
+	const __m128i zero = _mm_set1_epi8 ('0');
+	const __m128i letter = _mm_set1_epi8 ('A' - '0' - 10);
+	__m128i total = _mm_setzero_si128 ();
+
+	unsigned int i = 0;
+	for (; i + 16 <= isize; i += 16) {
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (input + i));
+		__m128i hi = _mm_and_si128 (_mm_srli_epi16 (v, 4), mask);
+		__m128i lo = _mm_and_si128 (v, mask);
+
+		hi = _mm_add_epi8 (_mm_add_epi8 (hi, zero), _mm_and_si128 (_mm_cmpgt_epi8 (hi, nine), letter));
+		lo = _mm_add_epi8 (_mm_add_epi8 (lo, zero), _mm_and_si128 (_mm_cmpgt_epi8 (lo, nine), letter));
+
+		__m128i a = _mm_unpacklo_epi8 (hi, lo);
+		__m128i b = _mm_unpackhi_epi8 (hi, lo);
+		_mm_storeu_si128 ((__m128i *) (output + i * 2), a);
+		_mm_storeu_si128 ((__m128i *) (output + i * 2 + 16), b);
+
+		total = _mm_add_epi64 (total, _mm_add_epi64 (_mm_sad_epu8 (a, _mm_setzero_si128 ()), _mm_sad_epu8 (b, _mm_setzero_si128 ())));
+	}
+
+	if (sum)
+		*sum += (unsigned char) (_mm_cvtsi128_si32 (total) + _mm_cvtsi128_si32 (_mm_srli_si128 (total, 8)));
+
+	return i;
+}
+
+/*
+ * Convert blocks of 32 hexadecimal digits to 16 bytes. Upper and lower
+ * case digits are accepted. The conversion stops at the first block
+ * with an invalid character, which is left for the scalar code to
+ * report. Returns the number of bytes converted.
+ */
+static unsigned int
+array_convert_hex2bin_sse2 (const unsigned char input[], unsigned int osize, unsigned char output[], unsigned char *sum)
+{
+	const __m128i case_bit = _mm_set1_epi8 (0x20);
+	const __m128i digit_lo = _mm_set1_epi8 ('0' - 1);
+	const __m128i digit_hi = _mm_set1_epi8 ('9' + 1);
+	const __m128i alpha_lo = _mm_set1_epi8 ('a' - 1);
+	const __m128i alpha_hi = _mm_set1_epi8 ('f' + 1);
+	const __m128i digit_offset = _mm_set1_epi8 ('0');
+	const __m128i alpha_offset = _mm_set1_epi8 ('a' - 10);
+	const __m128i lsb = _mm_set1_epi16 (0x00FF);
+	__m128i total = _mm_setzero_si128 ();
+
+	unsigned int i = 0;
+	for (; i + 16 <= osize; i += 16) {
+		__m128i v[2], value[2];
+		int valid = 1;
+
+		for (unsigned int j = 0; j < 2; ++j) {
+			v[j] = _mm_loadu_si128 ((const __m128i *) (input + i * 2 + j * 16));
+
+			// The signed comparisons reject all characters above 0x7F.
+			__m128i w = _mm_or_si128 (v[j], case_bit);
+			__m128i digit = _mm_and_si128 (_mm_cmpgt_epi8 (v[j], digit_lo), _mm_cmplt_epi8 (v[j], digit_hi));
+			__m128i alpha = _mm_and_si128 (_mm_cmpgt_epi8 (w, alpha_lo), _mm_cmplt_epi8 (w, alpha_hi));
+			if (_mm_movemask_epi8 (_mm_or_si128 (digit, alpha)) != 0xFFFF)
+				valid = 0;
+
+			value[j] = _mm_or_si128 (
+				_mm_and_si128 (digit, _mm_sub_epi8 (v[j], digit_offset)),
+				_mm_and_si128 (alpha, _mm_sub_epi8 (w, alpha_offset)));
+
+			// Combine the pairs of nibbles into 16 bit lanes.
+			value[j] = _mm_or_si128 (
+				_mm_slli_epi16 (_mm_and_si128 (value[j], lsb), 4),
+				_mm_srli_epi16 (value[j], 8));
+		}
+
+		if (!valid)
+			break;
+
+		_mm_storeu_si128 ((__m128i *) (output + i), _mm_packus_epi16 (value[0], value[1]));
+
+		total = _mm_add_epi64 (total, _mm_add_epi64 (_mm_sad_epu8 (v[0], _mm_setzero_si128 ()), _mm_sad_epu8 (v[1], _mm_setzero_si128 ())));
+	}
+
+	if (sum)
+		*sum += (unsigned char) (_mm_cvtsi128_si32 (total) + _mm_cvtsi128_si32 (_mm_srli_si128 (total, 8)));
+
+	return i;
+}
+#endif
+
+
 int
 array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
+{
+	return array_convert_bin2hex_sum (input, isize, output, osize, NULL);
+}
+
+
+int
+array_convert_bin2hex_sum (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize, unsigned char *sum)
 {
 	if (osize != 2 * isize)
 		return -1;
@@ -103,7 +224,13 @@ array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned
 		'0', '1', '2', '3', '4', '5', '6', '7',
 		'8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
 
-	for (unsigned int i = 0; i < isize; ++i) {
+	unsigned int i = 0;
+#ifdef __SSE2__
+	i = array_convert_bin2hex_sse2 (input, isize, output, sum);
+#endif
+
+	unsigned char total = 0;
+	for (; i < isize; ++i) {
 		// Set the most-significant nibble.
 		unsigned char msn = (input[i] >> 4) & 0x0F;
 		output[i * 2 + 0] = ascii[msn];
@@ -111,38 +238,70 @@ array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned
 		// Set the least-significant nibble.
 		unsigned char lsn = input[i] & 0x0F;
 		output[i * 2 + 1] = ascii[lsn];
+
+		total += ascii[msn] + ascii[lsn];
 	}
 
+	if (sum)
+		*sum += total;
+
 	return 0;
 }
 
 
+/* The value of every hexadecimal digit, or 0xFF for invalid characters. */
+static const unsigned char hex2bin[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
 int
 array_convert_hex2bin (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
+{
+	return array_convert_hex2bin_sum (input, isize, output, osize, NULL);
+}
+
+
+int
+array_convert_hex2bin_sum (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize, unsigned char *sum)
 {
 	if (isize != 2 * osize)
 		return -1;
 
-	for (unsigned int i = 0; i < osize; ++i) {
-		unsigned char value = 0;
-		for (unsigned int j = 0; j < 2; ++j) {
-			unsigned char number = 0;
-			unsigned char ascii = input[i * 2 + j];
-			if (ascii >= '0' && ascii <= '9')
-				number = ascii - '0';
-			else if (ascii >= 'A' && ascii <= 'F')
-				number = 10 + ascii - 'A';
-			else if (ascii >= 'a' && ascii <= 'f')
-				number = 10 + ascii - 'a';
-			else
-				return -1; /* Invalid character */
-
-			value <<= 4;
-			value += number;
-		}
-		output[i] = value;
+	unsigned int i = 0;
+#ifdef __SSE2__
+	i = array_convert_hex2bin_sse2 (input, osize, output, sum);
+#endif
+
+	unsigned char total = 0;
+	for (; i < osize; ++i) {
+		unsigned char hi = hex2bin[input[i * 2 + 0]];
+		unsigned char lo = hex2bin[input[i * 2 + 1]];
+		if ((hi | lo) & 0xF0)
+			return -1; /* Invalid character */
+
+		output[i] = (hi << 4) | lo;
+
+		total += input[i * 2 + 0] + input[i * 2 + 1];
 	}
 
+	if (sum)
+		*sum += total;
+
 	return 0;
 }
 
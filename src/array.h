@@ -49,6 +49,17 @@ array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned
 int
 array_convert_hex2bin (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize);
 
+/*
+ * Same as the conversions above, but also add all hexadecimal digits to
+ * an 8 bit additive checksum, as if checksum_add_uint8() was applied to
+ * the ascii buffer.
+ */
+int
+array_convert_bin2hex_sum (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize, unsigned char *sum);
+
+int
+array_convert_hex2bin_sum (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize, unsigned char *sum);
+
 unsigned int
 array_convert_str2num (const unsigned char data[], unsigned int size);
 
@@ -44,6 +44,7 @@
 #define SZ_MEMORY1 (29 * 64 * 1024) // Cobalt 1
 #define SZ_MEMORY2 (41 * 64 * 1024) // Cobalt 2
 #define SZ_VERSION 14
+#define SZ_PACKET  (8 * 1024)
 
 typedef struct atomics_cobalt_device_t {
 	dc_device_t base;
@@ -61,10 +62,12 @@ static const dc_device_vtable_t atomics_cobalt_device_vtable = {
 	DC_FAMILY_ATOMICS_COBALT,
 	atomics_cobalt_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	atomics_cobalt_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -196,7 +199,7 @@ atomics_cobalt_device_version (dc_device_t *abstract, unsigned char data[], unsi
 
 
 static dc_status_t
-atomics_cobalt_read_dive (dc_device_t *abstract, dc_buffer_t *buffer, int init, dc_event_progress_t *progress)
+atomics_cobalt_request_dive (dc_device_t *abstract, int init)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	atomics_cobalt_device_t *device = (atomics_cobalt_device_t *) abstract;
@@ -204,12 +207,6 @@ atomics_cobalt_read_dive (dc_device_t *abstract, dc_buffer_t *buffer, int init,
 	if (device_is_cancelled (abstract))
 		return DC_STATUS_CANCELLED;
 
-	// Erase the current contents of the buffer.
-	if (!dc_buffer_clear (buffer)) {
-		ERROR (abstract->context, "Insufficient buffer space available.");
-		return DC_STATUS_NOMEMORY;
-	}
-
 	// Send the command to the dive computer.
 	unsigned char bRequest = 0;
 	if (device->simulation)
@@ -231,12 +228,39 @@ atomics_cobalt_read_dive (dc_device_t *abstract, dc_buffer_t *buffer, int init,
 		return status;
 	}
 
+	return DC_STATUS_SUCCESS;
+}
+
+
+/*
+ * Receive a dive, which must have been requested already with
+ * atomics_cobalt_request_dive. The data is received directly into the
+ * buffer, until a short packet marks the end of the dive.
+ */
+static dc_status_t
+atomics_cobalt_read_dive (dc_device_t *abstract, dc_buffer_t *buffer, dc_event_progress_t *progress)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	atomics_cobalt_device_t *device = (atomics_cobalt_device_t *) abstract;
+
+	// Erase the current contents of the buffer.
+	if (!dc_buffer_clear (buffer)) {
+		ERROR (abstract->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
 	unsigned int nbytes = 0;
 	while (1) {
+		// Make room for the next packet.
+		if (!dc_buffer_resize (buffer, nbytes + SZ_PACKET)) {
+			ERROR (abstract->context, "Insufficient buffer space available.");
+			return DC_STATUS_NOMEMORY;
+		}
+
 		// Receive the answer from the dive computer.
 		size_t length = 0;
-		unsigned char packet[8 * 1024] = {0};
-		status = dc_iostream_read (device->iostream, packet, sizeof(packet), &length);
+		unsigned char *packet = dc_buffer_get_data (buffer) + nbytes;
+		status = dc_iostream_read (device->iostream, packet, SZ_PACKET, &length);
 		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT) {
 			ERROR (abstract->context, "Failed to receive the answer.");
 			return status;
@@ -248,20 +272,15 @@ atomics_cobalt_read_dive (dc_device_t *abstract, dc_buffer_t *buffer, int init,
 			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 		}
 
-		// Append the packet to the output buffer.
-		dc_buffer_append (buffer, packet, length);
 		nbytes += length;
 
 		// If we received fewer bytes than requested, the transfer is finished.
-		if (length < sizeof (packet))
+		if (length < SZ_PACKET)
 			break;
 	}
 
-	// Check for a buffer error.
-	if (dc_buffer_get_size (buffer) != nbytes) {
-		ERROR (abstract->context, "Insufficient buffer space available.");
-		return DC_STATUS_NOMEMORY;
-	}
+	// Remove the unused space.
+	dc_buffer_resize (buffer, nbytes);
 
 	// Check for the minimum length.
 	if (nbytes < 2) {
@@ -327,9 +346,13 @@ atomics_cobalt_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
-	unsigned int ndives = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = atomics_cobalt_read_dive (abstract, buffer, (ndives == 0), &progress)) == DC_STATUS_SUCCESS) {
+	// Request the first dive.
+	dc_status_t rc = atomics_cobalt_request_dive (abstract, 1);
+	while (rc == DC_STATUS_SUCCESS) {
+		rc = atomics_cobalt_read_dive (abstract, buffer, &progress);
+		if (rc != DC_STATUS_SUCCESS)
+			break;
+
 		unsigned char *data = dc_buffer_get_data (buffer);
 		unsigned int size = dc_buffer_get_size (buffer);
 
@@ -343,7 +366,17 @@ atomics_cobalt_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 			return DC_STATUS_SUCCESS;
 		}
 
+		// Request the next dive already, such that it streams in
+		// through the queued bulk transfers while the application
+		// processes this dive.
+		rc = atomics_cobalt_request_dive (abstract, 0);
+		if (rc != DC_STATUS_SUCCESS)
+			break;
+
 		if (callback && !callback (data, size, data + FP_OFFSET, sizeof (device->fingerprint), userdata)) {
+			// Receive the next dive anyway, to leave the dive
+			// computer in a clean state.
+			atomics_cobalt_read_dive (abstract, buffer, NULL);
 			dc_buffer_free (buffer);
 			return DC_STATUS_SUCCESS;
 		}
@@ -353,8 +386,6 @@ atomics_cobalt_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 		// advance, we can't calculate the total number of checksum bytes and
 		// adjust the maximum on the fly.
 		progress.maximum += 2;
-
-		ndives++;
 	}
 
 	dc_buffer_free (buffer);
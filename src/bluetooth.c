@@ -43,6 +43,8 @@
 #include <bluetooth/hci_lib.h>
 #include <bluetooth/sdp.h>
 #include <bluetooth/sdp_lib.h>
+#include "poller.h"
+#include "timer.h"
 #endif
 #endif
 
@@ -106,12 +108,16 @@ static const dc_iostream_vtable_t dc_bluetooth_vtable = {
 	dc_socket_get_available, /* get_available */
 	NULL, /* configure */
 	dc_socket_poll, /* poll */
+	dc_socket_get_fd, /* get_fd */
 	dc_socket_read, /* read */
+	NULL, /* read_lend */
+	NULL, /* read_return */
 	dc_socket_write, /* write */
 	dc_socket_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	dc_socket_sleep, /* sleep */
+	NULL, /* interrupt */
 	dc_socket_close, /* close */
 };
 
@@ -141,23 +147,13 @@ dc_address_set (bdaddr_t *ba, dc_bluetooth_address_t address)
 }
 
 static dc_status_t
-dc_bluetooth_sdp (uint8_t *port, dc_context_t *context, const bdaddr_t *ba)
+dc_bluetooth_sdp_search (uint8_t *port, dc_context_t *context, sdp_session_t *session)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
-	sdp_session_t *session = NULL;
 	sdp_list_t *search = NULL, *attrid = NULL;
 	sdp_list_t *records = NULL;
 	uint8_t channel = 0;
 
-	// Connect to the SDP server on the remote device.
-	session = sdp_connect (BDADDR_ANY, ba, SDP_RETRY_IF_BUSY);
-	if (session == NULL) {
-		s_errcode_t errcode = S_ERRNO;
-		SYSERROR (context, errcode);
-		status = dc_socket_syserror(errcode);
-		goto error;
-	}
-
 	// Specify the UUID of the serial port service with all attributes.
 	uuid_t uuid = {0};
 	uint32_t range = 0x0000FFFF;
@@ -218,6 +214,26 @@ error:
 	sdp_list_free (records, (sdp_free_func_t) sdp_record_free);
 	sdp_list_free (attrid, NULL);
 	sdp_list_free (search, NULL);
+
+	return status;
+}
+
+static dc_status_t
+dc_bluetooth_sdp (uint8_t *port, dc_context_t *context, const bdaddr_t *ba)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	sdp_session_t *session = NULL;
+
+	// Connect to the SDP server on the remote device.
+	session = sdp_connect (BDADDR_ANY, ba, SDP_RETRY_IF_BUSY);
+	if (session == NULL) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	status = dc_bluetooth_sdp_search (port, context, session);
+
 	sdp_close (session);
 
 	return status;
@@ -442,15 +458,22 @@ dc_bluetooth_iterator_next (dc_iterator_t *abstract, void *out)
 
 		dc_bluetooth_address_t address = dc_address_get (&dev->bdaddr);
 
-		// Get the user friendly name.
+		// Get the user friendly name. The remote name request takes
+		// a connection to the device, so the names are cached.
 		char buf[HCI_MAX_NAME_LENGTH], *name = buf;
-		int rc = hci_read_remote_name (iterator->fd, &dev->bdaddr, sizeof(buf), buf, 0);
-		if (rc < 0) {
-			name = NULL;
-		}
+		if (!dc_context_get_bluetooth_name (abstract->context, address, buf, sizeof(buf))) {
+			int rc = hci_read_remote_name (iterator->fd, &dev->bdaddr, sizeof(buf), buf, 0);
+			if (rc < 0) {
+				name = NULL;
+			}
+
+			// Null terminate the string.
+			buf[sizeof(buf) - 1] = '\0';
 
-		// Null terminate the string.
-		buf[sizeof(buf) - 1] = '\0';
+			if (name) {
+				dc_context_set_bluetooth_name (abstract->context, address, name);
+			}
+		}
 #endif
 
 		INFO (abstract->context, "Discover: address=" DC_ADDRESS_FORMAT ", name=%s",
@@ -545,6 +568,28 @@ dc_bluetooth_open (dc_iostream_t **out, dc_context_t *context, dc_bluetooth_addr
 	sa.rc_family = AF_BLUETOOTH;
 	dc_address_set (&sa.rc_bdaddr, address);
 	if (port == 0) {
+		// Try the channel of a previous SDP query first. If the
+		// connection fails, the channel may have changed, and the
+		// cached value is discarded.
+		unsigned int cached = dc_context_get_bluetooth_port (context, address);
+		if (cached) {
+			sa.rc_channel = cached;
+			status = dc_socket_connect (&device->base, (struct sockaddr *) &sa, sizeof (sa));
+			if (status == DC_STATUS_SUCCESS) {
+				goto done;
+			}
+
+			WARNING (context, "Failed to connect to the cached channel %u.", cached);
+			dc_context_set_bluetooth_port (context, address, 0);
+
+			// Re-open the socket.
+			dc_socket_close (&device->base);
+			status = dc_socket_open (&device->base, AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
+			if (status != DC_STATUS_SUCCESS) {
+				goto error_free;
+			}
+		}
+
 		status = dc_bluetooth_sdp (&sa.rc_channel, context, &sa.rc_bdaddr);
 		if (status != DC_STATUS_SUCCESS) {
 			goto error_close;
@@ -559,6 +604,15 @@ dc_bluetooth_open (dc_iostream_t **out, dc_context_t *context, dc_bluetooth_addr
 		goto error_close;
 	}
 
+#ifndef _WIN32
+	if (port == 0) {
+		dc_context_set_bluetooth_port (context, address, sa.rc_channel);
+	}
+
+done:
+#endif
+	dc_iostream_set_address ((dc_iostream_t *) device, DC_ADDRESS_FORMAT, address);
+
 	*out = (dc_iostream_t *) device;
 
 	return DC_STATUS_SUCCESS;
@@ -572,3 +626,319 @@ error_free:
 	return DC_STATUS_UNSUPPORTED;
 #endif
 }
+
+#ifdef HAVE_BLUEZ
+typedef enum dc_bluetooth_state_t {
+	STATE_SDP,
+	STATE_CONNECT,
+	STATE_DONE,
+} dc_bluetooth_state_t;
+
+typedef struct dc_bluetooth_pending_t {
+	dc_bluetooth_request_t *request;
+	dc_socket_t *device;
+	struct sockaddr_rc sa;
+	sdp_session_t *session;
+	dc_bluetooth_state_t state;
+	unsigned int cached;
+	unsigned int opened;
+	int fd;
+} dc_bluetooth_pending_t;
+
+static void
+dc_bluetooth_multi_done (dc_bluetooth_pending_t *pending, dc_status_t status)
+{
+	if (pending->session) {
+		sdp_close (pending->session);
+		pending->session = NULL;
+	}
+
+	if (status == DC_STATUS_SUCCESS) {
+		dc_iostream_set_address ((dc_iostream_t *) pending->device, DC_ADDRESS_FORMAT, pending->request->address);
+		pending->request->iostream = (dc_iostream_t *) pending->device;
+	} else if (pending->device) {
+		if (pending->opened)
+			dc_socket_close (&pending->device->base);
+		dc_iostream_deallocate ((dc_iostream_t *) pending->device);
+	}
+
+	pending->device = NULL;
+	pending->request->status = status;
+	pending->state = STATE_DONE;
+}
+
+static dc_status_t
+dc_bluetooth_multi_sdp (dc_bluetooth_pending_t *pending, dc_poller_t *poller, dc_context_t *context)
+{
+	// Start the connection to the SDP server on the remote device.
+	pending->session = sdp_connect (BDADDR_ANY, &pending->sa.rc_bdaddr, SDP_NON_BLOCKING);
+	if (pending->session == NULL) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	pending->fd = sdp_get_socket (pending->session);
+	if (dc_poller_add (poller, pending->fd, DC_POLLER_WRITE, pending) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	pending->state = STATE_SDP;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_bluetooth_multi_connect (dc_bluetooth_pending_t *pending, dc_poller_t *poller, dc_context_t *context)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	int inprogress = 0;
+
+	status = dc_socket_connect_start (&pending->device->base, (struct sockaddr *) &pending->sa, sizeof (pending->sa), &inprogress);
+	if (status != DC_STATUS_SUCCESS || !inprogress) {
+		return status;
+	}
+
+	pending->fd = pending->device->fd;
+	if (dc_poller_add (poller, pending->fd, DC_POLLER_WRITE, pending) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	pending->state = STATE_CONNECT;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_bluetooth_multi_begin (dc_bluetooth_pending_t *pending, dc_poller_t *poller, dc_context_t *context)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_bluetooth_request_t *request = pending->request;
+
+	INFO (context, "Open: address=" DC_ADDRESS_FORMAT ", port=%u", request->address, request->port);
+
+	// Allocate memory.
+	pending->device = (dc_socket_t *) dc_iostream_allocate (context, &dc_bluetooth_vtable, DC_TRANSPORT_BLUETOOTH);
+	if (pending->device == NULL) {
+		SYSERROR (context, S_ENOMEM);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Open the socket.
+	status = dc_socket_open (&pending->device->base, AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
+	if (status != DC_STATUS_SUCCESS) {
+		return status;
+	}
+	pending->opened = 1;
+
+	pending->sa.rc_family = AF_BLUETOOTH;
+	dc_address_set (&pending->sa.rc_bdaddr, request->address);
+	if (request->port == 0) {
+		// Try the channel of a previous SDP query first.
+		pending->cached = dc_context_get_bluetooth_port (context, request->address);
+		if (pending->cached == 0) {
+			return dc_bluetooth_multi_sdp (pending, poller, context);
+		}
+		pending->sa.rc_channel = pending->cached;
+	} else {
+		pending->sa.rc_channel = request->port;
+	}
+
+	return dc_bluetooth_multi_connect (pending, poller, context);
+}
+
+static dc_status_t
+dc_bluetooth_multi_step (dc_bluetooth_pending_t *pending, dc_poller_t *poller, dc_context_t *context)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_bluetooth_request_t *request = pending->request;
+
+	dc_poller_remove (poller, pending->fd);
+
+	if (pending->state == STATE_SDP) {
+		// Check the result of the connection to the SDP server.
+		int error = 0;
+		s_socklen_t size = sizeof (error);
+		if (getsockopt (pending->fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0) {
+			error = S_ERRNO;
+		}
+		if (error != 0) {
+			SYSERROR (context, error);
+			return dc_socket_syserror(error);
+		}
+
+		status = dc_bluetooth_sdp_search (&pending->sa.rc_channel, context, pending->session);
+		sdp_close (pending->session);
+		pending->session = NULL;
+		if (status != DC_STATUS_SUCCESS) {
+			return status;
+		}
+
+		return dc_bluetooth_multi_connect (pending, poller, context);
+	}
+
+	status = dc_socket_connect_finish (&pending->device->base);
+	if (status != DC_STATUS_SUCCESS && pending->cached) {
+		// The channel may have changed, so the cached value is
+		// discarded and a new SDP query is started.
+		WARNING (context, "Failed to connect to the cached channel %u.", pending->cached);
+		dc_context_set_bluetooth_port (context, request->address, 0);
+		pending->cached = 0;
+
+		// Re-open the socket.
+		dc_socket_close (&pending->device->base);
+		pending->opened = 0;
+		status = dc_socket_open (&pending->device->base, AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
+		if (status != DC_STATUS_SUCCESS) {
+			return status;
+		}
+		pending->opened = 1;
+
+		return dc_bluetooth_multi_sdp (pending, poller, context);
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		return status;
+	}
+
+	if (request->port == 0) {
+		dc_context_set_bluetooth_port (context, request->address, pending->sa.rc_channel);
+	}
+
+	pending->state = STATE_DONE;
+
+	return DC_STATUS_SUCCESS;
+}
+#endif
+
+dc_status_t
+dc_bluetooth_open_multi (dc_context_t *context, dc_bluetooth_request_t requests[], unsigned int count, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (requests == NULL && count)
+		return DC_STATUS_INVALIDARGS;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		requests[i].iostream = NULL;
+		requests[i].status = DC_STATUS_UNSUPPORTED;
+	}
+
+#if defined(HAVE_BLUEZ)
+	dc_bluetooth_pending_t *pendings = NULL;
+	dc_poller_t *poller = NULL;
+	dc_timer_t *timer = NULL;
+	dc_usecs_t begin = 0, now = 0;
+	unsigned int remaining = 0;
+
+	if (count == 0)
+		return DC_STATUS_SUCCESS;
+
+	pendings = (dc_bluetooth_pending_t *) calloc (count, sizeof (dc_bluetooth_pending_t));
+	if (pendings == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	if (dc_poller_new (&poller) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (context, errcode);
+		status = dc_socket_syserror(errcode);
+		goto error_free;
+	}
+
+	if (timeout >= 0) {
+		status = dc_timer_new (&timer);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to create a timer.");
+			goto error_poller;
+		}
+		dc_timer_now (timer, &begin);
+	}
+
+	// Start the SDP queries and connections of all requests.
+	for (unsigned int i = 0; i < count; ++i) {
+		dc_bluetooth_pending_t *pending = pendings + i;
+		pending->request = requests + i;
+		pending->fd = -1;
+
+		dc_status_t rc = dc_bluetooth_multi_begin (pending, poller, context);
+		if (rc != DC_STATUS_SUCCESS || pending->state == STATE_DONE) {
+			dc_bluetooth_multi_done (pending, rc);
+		} else {
+			remaining++;
+		}
+	}
+
+	// Advance each request as soon as its socket becomes writable,
+	// which indicates the connection is established or has failed.
+	while (remaining) {
+		int wait = -1;
+		if (timer) {
+			dc_timer_now (timer, &now);
+			dc_usecs_t elapsed = (now - begin) / 1000;
+			if (elapsed >= (dc_usecs_t) timeout)
+				break;
+			wait = timeout - elapsed;
+		}
+
+		dc_poller_event_t events[16];
+		int n = dc_poller_wait (poller, events, C_ARRAY_SIZE (events), wait);
+		if (n < 0) {
+			s_errcode_t errcode = S_ERRNO;
+			SYSERROR (context, errcode);
+			status = dc_socket_syserror(errcode);
+			break;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			dc_bluetooth_pending_t *pending = (dc_bluetooth_pending_t *) events[i].userdata;
+			if (pending->state == STATE_DONE)
+				continue;
+
+			dc_status_t rc = dc_bluetooth_multi_step (pending, poller, context);
+			if (rc != DC_STATUS_SUCCESS || pending->state == STATE_DONE) {
+				dc_bluetooth_multi_done (pending, rc);
+				remaining--;
+			}
+		}
+	}
+
+	// Abort the requests which didn't finish in time.
+	for (unsigned int i = 0; i < count; ++i) {
+		dc_bluetooth_pending_t *pending = pendings + i;
+		if (pending->state != STATE_DONE) {
+			ERROR (context, "Connection to " DC_ADDRESS_FORMAT " timed out.", pending->request->address);
+			dc_poller_remove (poller, pending->fd);
+			dc_bluetooth_multi_done (pending, status != DC_STATUS_SUCCESS ? status : DC_STATUS_TIMEOUT);
+		}
+	}
+
+	dc_timer_free (timer);
+error_poller:
+	dc_poller_free (poller);
+error_free:
+	free (pendings);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+#elif defined(BLUETOOTH)
+	// Without an event loop, the connections are opened one after the
+	// other, and the timeout is ignored.
+	for (unsigned int i = 0; i < count; ++i) {
+		requests[i].status = dc_bluetooth_open (&requests[i].iostream, context, requests[i].address, requests[i].port);
+	}
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (requests[i].status != DC_STATUS_SUCCESS)
+			return requests[i].status;
+	}
+
+	return status;
+}
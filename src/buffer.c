@@ -19,31 +19,257 @@
  * MA 02110-1301 USA
  */
 
-#include <stdlib.h> // malloc, realloc, free
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>  // rename, remove
 #include <string.h> // memcpy, memmove
+#include <errno.h>
+
+#ifdef _WIN32
+#define NOGDI
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include <libdivecomputer/buffer.h>
 
+#include "allocator.h"
+
+typedef union dc_arena_align_t {
+	void *p;
+	long long l;
+	double d;
+} dc_arena_align_t;
+
+#define ARENA_ALIGN(n) (((n) + sizeof (dc_arena_align_t) - 1) & ~(sizeof (dc_arena_align_t) - 1))
+#define ARENA_HEADER ARENA_ALIGN (sizeof (dc_arena_block_t))
+
+// Small buffers store their data inside the buffer object itself.
+#define BUFFER_INLINE 64
+
+// The suffix of the temporary file of a sink buffer.
+#define SINK_SUFFIX ".part"
+
+typedef struct dc_buffer_sink_t {
+#ifdef _WIN32
+	HANDLE hFile;
+#else
+	int fd;
+#endif
+	// The final and the temporary name of the file.
+	char *filename;
+	char *tmpname;
+} dc_buffer_sink_t;
+
+typedef struct dc_arena_block_t {
+	struct dc_arena_block_t *next;
+	size_t capacity, used;
+} dc_arena_block_t;
+
+struct dc_arena_t {
+	dc_arena_block_t *blocks;
+	size_t blocksize;
+	// The most recent allocation, which can be resized in place.
+	unsigned char *last;
+};
+
 struct dc_buffer_t {
 	unsigned char *data;
 	size_t capacity, offset, size;
+	dc_arena_t *arena;
+	// The data is not owned by the buffer (a mapped file).
+	int borrowed;
+	// The memory mapped file.
+	void *mapping;
+	size_t mapsize;
+	// The file backing a sink buffer.
+	dc_buffer_sink_t *sink;
+	// The inline storage for small buffers.
+	union {
+		dc_arena_align_t align;
+		unsigned char data[BUFFER_INLINE];
+	} storage;
 };
 
-dc_buffer_t *
-dc_buffer_new (size_t capacity)
+static dc_arena_block_t *
+dc_arena_block_new (size_t capacity)
+{
+	dc_arena_block_t *block = (dc_arena_block_t *) dc_malloc (ARENA_HEADER + capacity);
+	if (block == NULL)
+		return NULL;
+
+	block->next = NULL;
+	block->capacity = capacity;
+	block->used = 0;
+
+	return block;
+}
+
+
+dc_arena_t *
+dc_arena_new (size_t blocksize)
+{
+	dc_arena_t *arena = (dc_arena_t *) dc_malloc (sizeof (dc_arena_t));
+	if (arena == NULL)
+		return NULL;
+
+	arena->blocks = NULL;
+	arena->blocksize = ARENA_ALIGN (blocksize ? blocksize : 4096);
+	arena->last = NULL;
+
+	return arena;
+}
+
+
+void
+dc_arena_free (dc_arena_t *arena)
+{
+	if (arena == NULL)
+		return;
+
+	dc_arena_block_t *block = arena->blocks;
+	while (block) {
+		dc_arena_block_t *next = block->next;
+		dc_free (block);
+		block = next;
+	}
+
+	dc_free (arena);
+}
+
+
+void
+dc_arena_reset (dc_arena_t *arena)
+{
+	if (arena == NULL)
+		return;
+
+	arena->last = NULL;
+
+	if (arena->blocks == NULL)
+		return;
+
+	if (arena->blocks->next == NULL) {
+		arena->blocks->used = 0;
+		return;
+	}
+
+	// Replace all blocks with a single block that is large enough to
+	// hold everything, so the next round needs no more allocations.
+	size_t capacity = 0;
+	dc_arena_block_t *block = arena->blocks;
+	while (block) {
+		dc_arena_block_t *next = block->next;
+		capacity += block->capacity;
+		dc_free (block);
+		block = next;
+	}
+
+	arena->blocks = dc_arena_block_new (capacity);
+}
+
+
+void *
+dc_arena_alloc (dc_arena_t *arena, size_t size)
 {
-	dc_buffer_t *buffer = (dc_buffer_t *) malloc (sizeof (dc_buffer_t));
+	if (arena == NULL)
+		return NULL;
+
+	size_t n = ARENA_ALIGN (size ? size : 1);
+
+	dc_arena_block_t *block = arena->blocks;
+	if (block == NULL || n > block->capacity - block->used) {
+		block = dc_arena_block_new (n > arena->blocksize ? n : arena->blocksize);
+		if (block == NULL)
+			return NULL;
+
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+
+	unsigned char *data = (unsigned char *) block + ARENA_HEADER + block->used;
+	block->used += n;
+	arena->last = data;
+
+	return data;
+}
+
+
+static int
+dc_arena_extend (dc_arena_t *arena, unsigned char *data, size_t oldsize, size_t newsize)
+{
+	dc_arena_block_t *block = arena->blocks;
+
+	// Only the most recent allocation can grow in place.
+	if (block == NULL || data == NULL || data != arena->last)
+		return 0;
+
+	size_t used = block->used - ARENA_ALIGN (oldsize ? oldsize : 1);
+	size_t n = ARENA_ALIGN (newsize);
+	if (n > block->capacity - used)
+		return 0;
+
+	block->used = used + n;
+
+	return 1;
+}
+
+
+static unsigned char *
+dc_buffer_allocate (dc_buffer_t *buffer, size_t size)
+{
+	if (buffer->arena)
+		return (unsigned char *) dc_arena_alloc (buffer->arena, size);
+
+	return (unsigned char *) dc_malloc (size);
+}
+
+
+static void
+dc_buffer_release (dc_buffer_t *buffer, unsigned char *data)
+{
+	// Arena memory is released in bulk, and the memory of a sink
+	// buffer is a mapping of the file.
+	if (buffer->arena == NULL && buffer->sink == NULL && data != buffer->storage.data)
+		dc_free (data);
+}
+
+
+static dc_buffer_t *
+dc_buffer_new_internal (dc_arena_t *arena, size_t capacity)
+{
+	dc_buffer_t *buffer = NULL;
+
+	if (arena)
+		buffer = (dc_buffer_t *) dc_arena_alloc (arena, sizeof (dc_buffer_t));
+	else
+		buffer = (dc_buffer_t *) dc_malloc (sizeof (dc_buffer_t));
 	if (buffer == NULL)
 		return NULL;
 
-	if (capacity) {
-		buffer->data = (unsigned char *) malloc (capacity);
+	buffer->arena = arena;
+	buffer->borrowed = 0;
+	buffer->mapping = NULL;
+	buffer->mapsize = 0;
+	buffer->sink = NULL;
+
+	if (capacity <= BUFFER_INLINE) {
+		buffer->data = buffer->storage.data;
+		capacity = BUFFER_INLINE;
+	} else {
+		buffer->data = dc_buffer_allocate (buffer, capacity);
 		if (buffer->data == NULL) {
-			free (buffer);
+			if (arena == NULL)
+				dc_free (buffer);
 			return NULL;
 		}
-	} else {
-		buffer->data = NULL;
 	}
 
 	buffer->capacity = capacity;
@@ -54,16 +280,374 @@ dc_buffer_new (size_t capacity)
 }
 
 
+dc_buffer_t *
+dc_buffer_new (size_t capacity)
+{
+	return dc_buffer_new_internal (NULL, capacity);
+}
+
+
+dc_buffer_t *
+dc_buffer_new_arena (dc_arena_t *arena, size_t capacity)
+{
+	if (arena == NULL)
+		return NULL;
+
+	return dc_buffer_new_internal (arena, capacity);
+}
+
+
+static void *
+dc_buffer_map (const char *filename, size_t *size)
+{
+	void *mapping = NULL;
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA (filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx (hFile, &length) || (unsigned long long) length.QuadPart > (size_t) -1) {
+		CloseHandle (hFile);
+		return NULL;
+	}
+
+	*size = (size_t) length.QuadPart;
+	if (*size == 0) {
+		CloseHandle (hFile);
+		return NULL;
+	}
+
+	HANDLE hMapping = CreateFileMappingA (hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (hMapping != NULL) {
+		mapping = MapViewOfFile (hMapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle (hMapping);
+	}
+
+	CloseHandle (hFile);
+#else
+	int fd = open (filename, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	struct stat st;
+	if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || (unsigned long long) st.st_size > (size_t) -1) {
+		close (fd);
+		return NULL;
+	}
+
+	*size = (size_t) st.st_size;
+	if (*size == 0) {
+		close (fd);
+		return NULL;
+	}
+
+	// A private mapping turns writes into private copies of the pages,
+	// so modifying the data never changes the file.
+	mapping = mmap (NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED)
+		mapping = NULL;
+
+	close (fd);
+#endif
+
+	return mapping;
+}
+
+
+static void
+dc_buffer_unmap (void *mapping, size_t size)
+{
+#ifdef _WIN32
+	UnmapViewOfFile (mapping);
+#else
+	munmap (mapping, size);
+#endif
+}
+
+
+dc_buffer_t *
+dc_buffer_new_file (const char *filename)
+{
+	if (filename == NULL)
+		return NULL;
+
+	size_t size = 0;
+	void *mapping = dc_buffer_map (filename, &size);
+	if (mapping == NULL)
+		return NULL;
+
+	dc_buffer_t *buffer = (dc_buffer_t *) dc_malloc (sizeof (dc_buffer_t));
+	if (buffer == NULL) {
+		dc_buffer_unmap (mapping, size);
+		return NULL;
+	}
+
+	buffer->data = (unsigned char *) mapping;
+	buffer->capacity = size;
+	buffer->offset = 0;
+	buffer->size = size;
+	buffer->arena = NULL;
+	buffer->borrowed = 1;
+	buffer->mapping = mapping;
+	buffer->mapsize = size;
+	buffer->sink = NULL;
+
+	return buffer;
+}
+
+
+#ifndef _WIN32
+/*
+ * Allocate the disk space for the file, such that writing to the
+ * mapping can't fail once the disk is full. Writing to a page beyond
+ * the allocated space would raise a SIGBUS signal instead of an error.
+ */
+static int
+dc_buffer_sink_reserve (dc_buffer_sink_t *sink, size_t capacity)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+	int rc = posix_fallocate (sink->fd, 0, (off_t) capacity);
+	if (rc == 0)
+		return 1;
+
+	// Fall back to writing zeros, if the filesystem has no support.
+	if (rc != EINVAL && rc != EOPNOTSUPP)
+		return 0;
+#endif
+
+	struct stat st;
+	if (fstat (sink->fd, &st) != 0)
+		return 0;
+
+	static const unsigned char zeros[4096] = {0};
+	size_t offset = (size_t) st.st_size;
+	while (offset < capacity) {
+		size_t len = capacity - offset;
+		if (len > sizeof (zeros))
+			len = sizeof (zeros);
+
+		ssize_t n = pwrite (sink->fd, zeros, len, (off_t) offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+
+		offset += n;
+	}
+
+	return 1;
+}
+#endif
+
+
+/*
+ * Extend the file and map it again. On failure, the buffer keeps the
+ * existing mapping and contents.
+ */
+static int
+dc_buffer_sink_grow (dc_buffer_t *buffer, size_t capacity)
+{
+	dc_buffer_sink_t *sink = buffer->sink;
+
+	void *mapping = NULL;
+
+#ifdef _WIN32
+	// Creating a larger mapping extends the file, and fails if the disk
+	// space is not available.
+	LARGE_INTEGER length;
+	length.QuadPart = (LONGLONG) capacity;
+	HANDLE hMapping = CreateFileMappingA (sink->hFile, NULL, PAGE_READWRITE, (DWORD) (length.QuadPart >> 32), (DWORD) (length.QuadPart & 0xFFFFFFFF), NULL);
+	if (hMapping != NULL) {
+		mapping = MapViewOfFile (hMapping, FILE_MAP_WRITE, 0, 0, capacity);
+		CloseHandle (hMapping);
+	}
+#else
+	if (dc_buffer_sink_reserve (sink, capacity)) {
+		mapping = mmap (NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, sink->fd, 0);
+		if (mapping == MAP_FAILED)
+			mapping = NULL;
+	}
+#endif
+
+	if (mapping == NULL)
+		return 0;
+
+	// Both mappings share the pages of the file, so the contents are
+	// already available in the new mapping.
+	if (buffer->mapping)
+		dc_buffer_unmap (buffer->mapping, buffer->mapsize);
+
+	buffer->data = (unsigned char *) mapping;
+	buffer->capacity = capacity;
+	buffer->mapping = mapping;
+	buffer->mapsize = capacity;
+
+	return 1;
+}
+
+
+/*
+ * Close the file, after cutting it to the final contents of the buffer
+ * if the file is kept. The buffer is empty afterwards.
+ */
+static int
+dc_buffer_sink_close (dc_buffer_t *buffer, int keep)
+{
+	dc_buffer_sink_t *sink = buffer->sink;
+	int success = 1;
+
+	// Move the contents to the start of the file, and cut off the
+	// unused capacity, such that the file contains the final data.
+	if (keep && buffer->offset && buffer->size)
+		memmove (buffer->data, buffer->data + buffer->offset, buffer->size);
+
+	if (buffer->mapping)
+		dc_buffer_unmap (buffer->mapping, buffer->mapsize);
+
+#ifdef _WIN32
+	if (keep) {
+		LARGE_INTEGER length;
+		length.QuadPart = (LONGLONG) buffer->size;
+		if (!SetFilePointerEx (sink->hFile, length, NULL, FILE_BEGIN) ||
+			!SetEndOfFile (sink->hFile))
+			success = 0;
+	}
+	if (!CloseHandle (sink->hFile))
+		success = 0;
+	if (keep && success && !MoveFileExA (sink->tmpname, sink->filename, MOVEFILE_REPLACE_EXISTING))
+		success = 0;
+#else
+	if (keep && ftruncate (sink->fd, (off_t) buffer->size) != 0)
+		success = 0;
+	if (close (sink->fd) != 0)
+		success = 0;
+	if (keep && success && rename (sink->tmpname, sink->filename) != 0)
+		success = 0;
+#endif
+
+	// Without a successful commit, the existing file is left untouched.
+	if (!keep || !success)
+		remove (sink->tmpname);
+
+	dc_free (sink->filename);
+	dc_free (sink);
+
+	buffer->data = NULL;
+	buffer->capacity = 0;
+	buffer->offset = 0;
+	buffer->size = 0;
+	buffer->mapping = NULL;
+	buffer->mapsize = 0;
+	buffer->sink = NULL;
+
+	return success;
+}
+
+
+dc_buffer_t *
+dc_buffer_new_sink (const char *filename)
+{
+	if (filename == NULL)
+		return NULL;
+
+	dc_buffer_sink_t *sink = (dc_buffer_sink_t *) dc_malloc (sizeof (dc_buffer_sink_t));
+	if (sink == NULL)
+		return NULL;
+
+	// The data is written to a temporary file next to the final one,
+	// which is only replaced when the buffer is committed.
+	size_t length = strlen (filename);
+	sink->filename = (char *) dc_malloc (2 * length + sizeof (SINK_SUFFIX) + 1);
+	if (sink->filename == NULL) {
+		dc_free (sink);
+		return NULL;
+	}
+
+	memcpy (sink->filename, filename, length + 1);
+	sink->tmpname = sink->filename + length + 1;
+	memcpy (sink->tmpname, filename, length);
+	memcpy (sink->tmpname + length, SINK_SUFFIX, sizeof (SINK_SUFFIX));
+
+#ifdef _WIN32
+	sink->hFile = CreateFileA (sink->tmpname, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (sink->hFile == INVALID_HANDLE_VALUE) {
+		dc_free (sink->filename);
+		dc_free (sink);
+		return NULL;
+	}
+#else
+	sink->fd = open (sink->tmpname, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (sink->fd == -1) {
+		dc_free (sink->filename);
+		dc_free (sink);
+		return NULL;
+	}
+#endif
+
+	dc_buffer_t *buffer = (dc_buffer_t *) dc_malloc (sizeof (dc_buffer_t));
+	if (buffer == NULL) {
+#ifdef _WIN32
+		CloseHandle (sink->hFile);
+#else
+		close (sink->fd);
+#endif
+		remove (sink->tmpname);
+		dc_free (sink->filename);
+		dc_free (sink);
+		return NULL;
+	}
+
+	// The file is mapped once the first data arrives.
+	buffer->data = NULL;
+	buffer->capacity = 0;
+	buffer->offset = 0;
+	buffer->size = 0;
+	buffer->arena = NULL;
+	buffer->borrowed = 0;
+	buffer->mapping = NULL;
+	buffer->mapsize = 0;
+	buffer->sink = sink;
+
+	return buffer;
+}
+
+
+int
+dc_buffer_commit (dc_buffer_t *buffer)
+{
+	if (buffer == NULL || buffer->sink == NULL)
+		return 0;
+
+	return dc_buffer_sink_close (buffer, 1);
+}
+
+
 void
 dc_buffer_free (dc_buffer_t *buffer)
 {
 	if (buffer == NULL)
 		return;
 
-	if (buffer->data)
-		free (buffer->data);
+	// Arena memory is released in bulk.
+	if (buffer->arena)
+		return;
+
+	if (buffer->sink) {
+		dc_buffer_sink_close (buffer, 0);
+		dc_free (buffer);
+		return;
+	}
 
-	free (buffer);
+	if (!buffer->borrowed)
+		dc_buffer_release (buffer, buffer->data);
+
+	if (buffer->mapping)
+		dc_buffer_unmap (buffer->mapping, buffer->mapsize);
+
+	dc_free (buffer);
 }
 
 
@@ -80,13 +664,46 @@ dc_buffer_clear (dc_buffer_t *buffer)
 }
 
 
+static int
+dc_buffer_detach (dc_buffer_t *buffer)
+{
+	if (!buffer->borrowed)
+		return 1;
+
+	// Copy the borrowed data into memory owned by the buffer.
+	size_t capacity = buffer->size;
+	unsigned char *data = NULL;
+	if (capacity <= BUFFER_INLINE) {
+		capacity = BUFFER_INLINE;
+		data = buffer->storage.data;
+	} else {
+		data = (unsigned char *) dc_malloc (capacity);
+		if (data == NULL)
+			return 0;
+	}
+
+	if (buffer->size)
+		memmove (data, buffer->data + buffer->offset, buffer->size);
+
+	buffer->data = data;
+	buffer->capacity = capacity;
+	buffer->offset = 0;
+	buffer->borrowed = 0;
+
+	return 1;
+}
+
+
 static size_t
 dc_buffer_expand_calc (dc_buffer_t *buffer, size_t n)
 {
+	// Double the capacity, to keep repeated appends cheap, but never
+	// overshoot a single large request. Growing a small buffer to the
+	// size of a full memory dump allocates exactly that size.
 	size_t oldsize = buffer->capacity;
-	size_t newsize = (oldsize ? oldsize : n);
-	while (newsize < n)
-		newsize *= 2;
+	size_t newsize = (oldsize <= (size_t) -1 / 2 ? oldsize * 2 : n);
+	if (newsize < n)
+		newsize = n;
 
 	return newsize;
 }
@@ -96,17 +713,34 @@ static int
 dc_buffer_expand_append (dc_buffer_t *buffer, size_t n)
 {
 	if (n > buffer->capacity - buffer->offset) {
+		// A sink buffer grows the file in place.
+		if (buffer->sink && n > buffer->capacity) {
+			if (!dc_buffer_sink_grow (buffer, dc_buffer_expand_calc (buffer, n)))
+				return 0;
+		}
+
 		if (n > buffer->capacity) {
 			size_t capacity = dc_buffer_expand_calc (buffer, n);
 
-			unsigned char *data = (unsigned char *) malloc (capacity);
+			// Try to grow the arena memory in place first.
+			if (buffer->arena && dc_arena_extend (buffer->arena, buffer->data, buffer->capacity, capacity)) {
+				if (buffer->size)
+					memmove (buffer->data, buffer->data + buffer->offset, buffer->size);
+
+				buffer->capacity = capacity;
+				buffer->offset = 0;
+
+				return 1;
+			}
+
+			unsigned char *data = dc_buffer_allocate (buffer, capacity);
 			if (data == NULL)
 				return 0;
 
 			if (buffer->size)
 				memcpy (data, buffer->data + buffer->offset, buffer->size);
 
-			free (buffer->data);
+			dc_buffer_release (buffer, buffer->data);
 
 			buffer->data = data;
 			buffer->capacity = capacity;
@@ -126,20 +760,25 @@ dc_buffer_expand_append (dc_buffer_t *buffer, size_t n)
 static int
 dc_buffer_expand_prepend (dc_buffer_t *buffer, size_t n)
 {
+	if (buffer->sink && n > buffer->capacity) {
+		if (!dc_buffer_sink_grow (buffer, dc_buffer_expand_calc (buffer, n)))
+			return 0;
+	}
+
 	size_t available = buffer->capacity - buffer->size;
 
 	if (n > buffer->offset + buffer->size) {
 		if (n > buffer->capacity) {
 			size_t capacity = dc_buffer_expand_calc (buffer, n);
 
-			unsigned char *data = (unsigned char *) malloc (capacity);
+			unsigned char *data = dc_buffer_allocate (buffer, capacity);
 			if (data == NULL)
 				return 0;
 
 			if (buffer->size)
 				memcpy (data + capacity - buffer->size, buffer->data + buffer->offset, buffer->size);
 
-			free (buffer->data);
+			dc_buffer_release (buffer, buffer->data);
 
 			buffer->data = data;
 			buffer->capacity = capacity;
@@ -162,10 +801,37 @@ dc_buffer_reserve (dc_buffer_t *buffer, size_t capacity)
 	if (buffer == NULL)
 		return 0;
 
+	if (!dc_buffer_detach (buffer))
+		return 0;
+
 	if (capacity <= buffer->capacity)
 		return 1;
 
-	unsigned char *data = (unsigned char *) realloc (buffer->data, capacity);
+	if (buffer->sink)
+		return dc_buffer_sink_grow (buffer, capacity);
+
+	// Arena memory and the inline storage can't be reallocated.
+	if (buffer->arena || buffer->data == buffer->storage.data) {
+		// Grow the arena memory in place if possible.
+		if (buffer->arena && dc_arena_extend (buffer->arena, buffer->data, buffer->capacity, capacity)) {
+			buffer->capacity = capacity;
+			return 1;
+		}
+
+		unsigned char *data = dc_buffer_allocate (buffer, capacity);
+		if (data == NULL)
+			return 0;
+
+		if (buffer->capacity)
+			memcpy (data, buffer->data, buffer->capacity);
+
+		buffer->data = data;
+		buffer->capacity = capacity;
+
+		return 1;
+	}
+
+	unsigned char *data = (unsigned char *) dc_realloc (buffer->data, capacity);
 	if (data == NULL)
 		return 0;
 
@@ -182,6 +848,9 @@ dc_buffer_resize (dc_buffer_t *buffer, size_t size)
 	if (buffer == NULL)
 		return 0;
 
+	if (!dc_buffer_detach (buffer))
+		return 0;
+
 	if (!dc_buffer_expand_append (buffer, size))
 		return 0;
 
@@ -200,6 +869,9 @@ dc_buffer_append (dc_buffer_t *buffer, const unsigned char data[], size_t size)
 	if (buffer == NULL)
 		return 0;
 
+	if (!dc_buffer_detach (buffer))
+		return 0;
+
 	if (!dc_buffer_expand_append (buffer, buffer->size + size))
 		return 0;
 
@@ -218,6 +890,9 @@ dc_buffer_prepend (dc_buffer_t *buffer, const unsigned char data[], size_t size)
 	if (buffer == NULL)
 		return 0;
 
+	if (!dc_buffer_detach (buffer))
+		return 0;
+
 	if (!dc_buffer_expand_prepend (buffer, buffer->size + size))
 		return 0;
 
@@ -0,0 +1,596 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/buffer.h>
+
+#include "cache.h"
+#include "checksum.h"
+#include "context-private.h"
+
+#define DEFAULT_CAPACITY 256
+
+typedef enum dc_parser_cache_samples_t {
+	SAMPLES_NONE,
+	SAMPLES_RECORDING,
+	SAMPLES_COMPLETE
+} dc_parser_cache_samples_t;
+
+typedef union dc_parser_cache_value_t {
+	unsigned int uint;
+	double real;
+	dc_gasmix_t gasmix;
+	dc_salinity_t salinity;
+	dc_tank_t tank;
+	dc_divemode_t divemode;
+} dc_parser_cache_value_t;
+
+typedef struct dc_parser_cache_field_t {
+	dc_field_type_t type;
+	unsigned int flags;
+	dc_status_t status;
+	dc_parser_cache_value_t value;
+} dc_parser_cache_field_t;
+
+struct dc_parser_cache_entry_t {
+	dc_parser_cache_entry_t *chain;
+	dc_parser_cache_entry_t *prev;
+	dc_parser_cache_entry_t *next;
+	unsigned int refcount;
+	/* Key */
+	dc_parser_cache_key_t key;
+	unsigned int size;
+	unsigned int crc32;
+	unsigned int crc32b;
+	/* Datetime */
+	int have_datetime;
+	dc_status_t datetime_status;
+	dc_datetime_t datetime;
+	/* Fields */
+	dc_parser_cache_field_t *fields;
+	unsigned int nfields;
+	unsigned int maxfields;
+	/* Samples */
+	dc_parser_cache_samples_t samples;
+	dc_buffer_t *buffer;
+};
+
+struct dc_parser_cache_t {
+	dc_context_t *context;
+	unsigned int capacity;
+	unsigned int count;
+	unsigned int nbuckets;
+	dc_parser_cache_entry_t **buckets;
+	/* Least recently used list, with the most recent entry at the head. */
+	dc_parser_cache_entry_t *head;
+	dc_parser_cache_entry_t *tail;
+};
+
+static size_t
+dc_parser_cache_field_size (dc_field_type_t type)
+{
+	switch (type) {
+	case DC_FIELD_DIVETIME:
+	case DC_FIELD_GASMIX_COUNT:
+	case DC_FIELD_TANK_COUNT:
+		return sizeof (unsigned int);
+	case DC_FIELD_MAXDEPTH:
+	case DC_FIELD_AVGDEPTH:
+	case DC_FIELD_ATMOSPHERIC:
+	case DC_FIELD_TEMPERATURE_SURFACE:
+	case DC_FIELD_TEMPERATURE_MINIMUM:
+	case DC_FIELD_TEMPERATURE_MAXIMUM:
+		return sizeof (double);
+	case DC_FIELD_GASMIX:
+		return sizeof (dc_gasmix_t);
+	case DC_FIELD_SALINITY:
+		return sizeof (dc_salinity_t);
+	case DC_FIELD_TANK:
+		return sizeof (dc_tank_t);
+	case DC_FIELD_DIVEMODE:
+		return sizeof (dc_divemode_t);
+	default:
+		return 0;
+	}
+}
+
+static void
+dc_parser_cache_unlink (dc_parser_cache_t *cache, dc_parser_cache_entry_t *entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		cache->head = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+
+	entry->prev = entry->next = NULL;
+}
+
+static void
+dc_parser_cache_link (dc_parser_cache_t *cache, dc_parser_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->head;
+	if (cache->head)
+		cache->head->prev = entry;
+	else
+		cache->tail = entry;
+	cache->head = entry;
+}
+
+static void
+dc_parser_cache_entry_free (dc_parser_cache_entry_t *entry)
+{
+	dc_buffer_free (entry->buffer);
+	free (entry->fields);
+	free (entry);
+}
+
+static void
+dc_parser_cache_evict (dc_parser_cache_t *cache)
+{
+	// Remove the least recently used entries that are not in use.
+	dc_parser_cache_entry_t *entry = cache->tail;
+	while (entry && cache->count >= cache->capacity) {
+		dc_parser_cache_entry_t *prev = entry->prev;
+
+		if (entry->refcount == 0) {
+			dc_parser_cache_entry_t **p = &cache->buckets[entry->crc32 & (cache->nbuckets - 1)];
+			while (*p != entry)
+				p = &(*p)->chain;
+			*p = entry->chain;
+
+			dc_parser_cache_unlink (cache, entry);
+			dc_parser_cache_entry_free (entry);
+			cache->count--;
+		}
+
+		entry = prev;
+	}
+}
+
+dc_status_t
+dc_parser_cache_new (dc_parser_cache_t **out, dc_context_t *context, unsigned int capacity)
+{
+	dc_parser_cache_t *cache = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (capacity == 0)
+		capacity = DEFAULT_CAPACITY;
+
+	cache = (dc_parser_cache_t *) malloc (sizeof (dc_parser_cache_t));
+	if (cache == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	cache->context = context;
+	cache->capacity = capacity;
+	cache->count = 0;
+	cache->head = NULL;
+	cache->tail = NULL;
+
+	// Use a power of two for the number of hash buckets.
+	cache->nbuckets = 16;
+	while (cache->nbuckets < capacity)
+		cache->nbuckets *= 2;
+
+	cache->buckets = (dc_parser_cache_entry_t **) calloc (cache->nbuckets, sizeof (dc_parser_cache_entry_t *));
+	if (cache->buckets == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		free (cache);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	*out = cache;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parser_cache_free (dc_parser_cache_t *cache)
+{
+	if (cache == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_parser_cache_entry_t *entry = cache->head;
+	while (entry) {
+		dc_parser_cache_entry_t *next = entry->next;
+		dc_parser_cache_entry_free (entry);
+		entry = next;
+	}
+
+	free (cache->buckets);
+	free (cache);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_parser_cache_entry_t *
+dc_parser_cache_acquire (dc_parser_cache_t *cache, const dc_parser_cache_key_t *key, const unsigned char data[], unsigned int size)
+{
+	unsigned int crc32 = checksum_crc32 (data, size);
+	unsigned int crc32b = checksum_crc32b (data, size);
+
+	dc_parser_cache_entry_t **bucket = &cache->buckets[crc32 & (cache->nbuckets - 1)];
+
+	dc_parser_cache_entry_t *entry = *bucket;
+	while (entry) {
+		if (entry->crc32 == crc32 && entry->crc32b == crc32b &&
+			entry->size == size &&
+			entry->key.family == key->family &&
+			entry->key.model == key->model &&
+			entry->key.devtime == key->devtime &&
+			entry->key.systime == key->systime &&
+			entry->key.settings == key->settings) {
+			dc_parser_cache_unlink (cache, entry);
+			dc_parser_cache_link (cache, entry);
+			entry->refcount++;
+			return entry;
+		}
+		entry = entry->chain;
+	}
+
+	if (cache->count >= cache->capacity)
+		dc_parser_cache_evict (cache);
+
+	entry = (dc_parser_cache_entry_t *) malloc (sizeof (dc_parser_cache_entry_t));
+	if (entry == NULL) {
+		ERROR (cache->context, "Failed to allocate memory.");
+		return NULL;
+	}
+
+	entry->refcount = 1;
+	entry->key = *key;
+	entry->size = size;
+	entry->crc32 = crc32;
+	entry->crc32b = crc32b;
+	entry->have_datetime = 0;
+	entry->datetime_status = DC_STATUS_SUCCESS;
+	memset (&entry->datetime, 0, sizeof (entry->datetime));
+	entry->fields = NULL;
+	entry->nfields = 0;
+	entry->maxfields = 0;
+	entry->samples = SAMPLES_NONE;
+	entry->buffer = NULL;
+
+	entry->chain = *bucket;
+	*bucket = entry;
+	dc_parser_cache_link (cache, entry);
+	cache->count++;
+
+	return entry;
+}
+
+void
+dc_parser_cache_release (dc_parser_cache_t *cache, dc_parser_cache_entry_t *entry)
+{
+	if (cache == NULL || entry == NULL)
+		return;
+
+	entry->refcount--;
+
+	if (cache->count > cache->capacity)
+		dc_parser_cache_evict (cache);
+}
+
+int
+dc_parser_cache_get_datetime (dc_parser_cache_entry_t *entry, dc_datetime_t *datetime, dc_status_t *status)
+{
+	if (!entry->have_datetime)
+		return 0;
+
+	if (datetime)
+		*datetime = entry->datetime;
+	*status = entry->datetime_status;
+
+	return 1;
+}
+
+void
+dc_parser_cache_set_datetime (dc_parser_cache_entry_t *entry, const dc_datetime_t *datetime, dc_status_t status)
+{
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED)
+		return;
+
+	if (status == DC_STATUS_SUCCESS)
+		entry->datetime = *datetime;
+	entry->datetime_status = status;
+	entry->have_datetime = 1;
+}
+
+int
+dc_parser_cache_get_field (dc_parser_cache_entry_t *entry, dc_field_type_t type, unsigned int flags, void *value, dc_status_t *status)
+{
+	size_t size = dc_parser_cache_field_size (type);
+	if (size == 0 || value == NULL)
+		return 0;
+
+	for (unsigned int i = 0; i < entry->nfields; ++i) {
+		dc_parser_cache_field_t *field = entry->fields + i;
+		if (field->type == type && field->flags == flags) {
+			if (field->status == DC_STATUS_SUCCESS)
+				memcpy (value, &field->value, size);
+			*status = field->status;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void
+dc_parser_cache_set_field (dc_parser_cache_entry_t *entry, dc_field_type_t type, unsigned int flags, const void *value, dc_status_t status)
+{
+	size_t size = dc_parser_cache_field_size (type);
+	if (size == 0 || value == NULL)
+		return;
+
+	// Only cache results that don't depend on the caller.
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED)
+		return;
+
+	if (entry->nfields == entry->maxfields) {
+		unsigned int maxfields = entry->maxfields ? entry->maxfields * 2 : 8;
+		dc_parser_cache_field_t *fields = (dc_parser_cache_field_t *) realloc (entry->fields, maxfields * sizeof (dc_parser_cache_field_t));
+		if (fields == NULL)
+			return;
+
+		entry->fields = fields;
+		entry->maxfields = maxfields;
+	}
+
+	dc_parser_cache_field_t *field = entry->fields + entry->nfields++;
+	field->type = type;
+	field->flags = flags;
+	field->status = status;
+	memset (&field->value, 0, sizeof (field->value));
+	if (status == DC_STATUS_SUCCESS)
+		memcpy (&field->value, value, size);
+}
+
+/*
+ * The samples are stored as a sequence of records, each with a one byte
+ * sample type followed by only the members of dc_sample_value_t that are
+ * used by that type. Vendor samples are followed by a copy of their data.
+ */
+
+size_t
+dc_parser_cache_sample_encode (unsigned char buffer[], dc_sample_type_t type, const dc_sample_value_t *value)
+{
+	size_t n = 0;
+
+	buffer[n++] = type;
+
+#define PUT(member) memcpy (buffer + n, &(member), sizeof (member)); n += sizeof (member)
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		PUT (value->time);
+		break;
+	case DC_SAMPLE_DEPTH:
+		PUT (value->depth);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		PUT (value->pressure.tank);
+		PUT (value->pressure.value);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		PUT (value->temperature);
+		break;
+	case DC_SAMPLE_EVENT:
+		PUT (value->event.type);
+		PUT (value->event.time);
+		PUT (value->event.flags);
+		PUT (value->event.value);
+		break;
+	case DC_SAMPLE_RBT:
+		PUT (value->rbt);
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		PUT (value->heartbeat);
+		break;
+	case DC_SAMPLE_BEARING:
+		PUT (value->bearing);
+		break;
+	case DC_SAMPLE_VENDOR:
+		PUT (value->vendor.type);
+		PUT (value->vendor.size);
+		break;
+	case DC_SAMPLE_SETPOINT:
+		PUT (value->setpoint);
+		break;
+	case DC_SAMPLE_PPO2:
+		PUT (value->ppo2);
+		break;
+	case DC_SAMPLE_CNS:
+		PUT (value->cns);
+		break;
+	case DC_SAMPLE_DECO:
+		PUT (value->deco.type);
+		PUT (value->deco.time);
+		PUT (value->deco.depth);
+		break;
+	case DC_SAMPLE_GASMIX:
+		PUT (value->gasmix);
+		break;
+	}
+#undef PUT
+
+	return n;
+}
+
+size_t
+dc_parser_cache_sample_decode (const unsigned char buffer[], size_t size, dc_sample_type_t *type, dc_sample_value_t *value)
+{
+	size_t n = 0;
+
+	if (size < 1)
+		return 0;
+
+	*type = (dc_sample_type_t) buffer[n++];
+
+#define GET(member) \
+	if (n + sizeof (member) > size) return 0; \
+	memcpy (&(member), buffer + n, sizeof (member)); n += sizeof (member)
+	switch (*type) {
+	case DC_SAMPLE_TIME:
+		GET (value->time);
+		break;
+	case DC_SAMPLE_DEPTH:
+		GET (value->depth);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		GET (value->pressure.tank);
+		GET (value->pressure.value);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		GET (value->temperature);
+		break;
+	case DC_SAMPLE_EVENT:
+		GET (value->event.type);
+		GET (value->event.time);
+		GET (value->event.flags);
+		GET (value->event.value);
+		break;
+	case DC_SAMPLE_RBT:
+		GET (value->rbt);
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		GET (value->heartbeat);
+		break;
+	case DC_SAMPLE_BEARING:
+		GET (value->bearing);
+		break;
+	case DC_SAMPLE_VENDOR:
+		GET (value->vendor.type);
+		GET (value->vendor.size);
+		if (n + value->vendor.size > size)
+			return 0;
+		value->vendor.data = buffer + n;
+		n += value->vendor.size;
+		break;
+	case DC_SAMPLE_SETPOINT:
+		GET (value->setpoint);
+		break;
+	case DC_SAMPLE_PPO2:
+		GET (value->ppo2);
+		break;
+	case DC_SAMPLE_CNS:
+		GET (value->cns);
+		break;
+	case DC_SAMPLE_DECO:
+		GET (value->deco.type);
+		GET (value->deco.time);
+		GET (value->deco.depth);
+		break;
+	case DC_SAMPLE_GASMIX:
+		GET (value->gasmix);
+		break;
+	default:
+		return 0;
+	}
+#undef GET
+
+	return n;
+}
+
+int
+dc_parser_cache_samples_foreach (dc_parser_cache_entry_t *entry, dc_sample_callback_t callback, void *userdata)
+{
+	if (entry->samples != SAMPLES_COMPLETE)
+		return 0;
+
+	const unsigned char *data = dc_buffer_get_data (entry->buffer);
+	size_t size = dc_buffer_get_size (entry->buffer);
+
+	size_t offset = 0;
+	while (offset < size) {
+		dc_sample_type_t type;
+		dc_sample_value_t value;
+		size_t n = dc_parser_cache_sample_decode (data + offset, size - offset, &type, &value);
+		if (n == 0)
+			break;
+
+		if (callback)
+			callback (type, value, userdata);
+
+		offset += n;
+	}
+
+	return 1;
+}
+
+int
+dc_parser_cache_samples_begin (dc_parser_cache_entry_t *entry)
+{
+	if (entry->samples != SAMPLES_NONE)
+		return 0;
+
+	if (entry->buffer == NULL) {
+		entry->buffer = dc_buffer_new (0);
+		if (entry->buffer == NULL)
+			return 0;
+	}
+
+	dc_buffer_clear (entry->buffer);
+	entry->samples = SAMPLES_RECORDING;
+
+	return 1;
+}
+
+dc_status_t
+dc_parser_cache_samples_record (dc_parser_cache_entry_t *entry, dc_sample_type_t type, dc_sample_value_t value)
+{
+	unsigned char record[DC_PARSER_CACHE_RECORD_MAX];
+
+	if (entry->samples != SAMPLES_RECORDING)
+		return DC_STATUS_SUCCESS;
+
+	size_t n = dc_parser_cache_sample_encode (record, type, &value);
+	if (!dc_buffer_append (entry->buffer, record, n) ||
+		(type == DC_SAMPLE_VENDOR && value.vendor.size &&
+		!dc_buffer_append (entry->buffer, (const unsigned char *) value.vendor.data, value.vendor.size))) {
+		dc_buffer_clear (entry->buffer);
+		entry->samples = SAMPLES_NONE;
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+dc_parser_cache_samples_commit (dc_parser_cache_entry_t *entry, dc_status_t status)
+{
+	if (status == DC_STATUS_SUCCESS && entry->samples == SAMPLES_RECORDING) {
+		entry->samples = SAMPLES_COMPLETE;
+	} else if (entry->samples == SAMPLES_RECORDING) {
+		dc_buffer_clear (entry->buffer);
+		entry->samples = SAMPLES_NONE;
+	}
+}
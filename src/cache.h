@@ -0,0 +1,91 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_CACHE_H
+#define DC_CACHE_H
+
+#include <libdivecomputer/parser.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dc_parser_cache_entry_t dc_parser_cache_entry_t;
+
+/*
+ * Everything besides the data that affects the decoded results: the
+ * backend, the clock for the datetime, and a checksum of the backend
+ * settings (like the calibration).
+ */
+typedef struct dc_parser_cache_key_t {
+	dc_family_t family;
+	unsigned int model;
+	unsigned int devtime;
+	dc_ticks_t systime;
+	unsigned int settings;
+} dc_parser_cache_key_t;
+
+/*
+ * Maximum size of an encoded sample record, excluding the data of
+ * vendor samples, which follows the record.
+ */
+#define DC_PARSER_CACHE_RECORD_MAX (1 + 4 * sizeof (unsigned int) + sizeof (double))
+
+dc_parser_cache_entry_t *
+dc_parser_cache_acquire (dc_parser_cache_t *cache, const dc_parser_cache_key_t *key, const unsigned char data[], unsigned int size);
+
+void
+dc_parser_cache_release (dc_parser_cache_t *cache, dc_parser_cache_entry_t *entry);
+
+int
+dc_parser_cache_get_datetime (dc_parser_cache_entry_t *entry, dc_datetime_t *datetime, dc_status_t *status);
+
+void
+dc_parser_cache_set_datetime (dc_parser_cache_entry_t *entry, const dc_datetime_t *datetime, dc_status_t status);
+
+int
+dc_parser_cache_get_field (dc_parser_cache_entry_t *entry, dc_field_type_t type, unsigned int flags, void *value, dc_status_t *status);
+
+void
+dc_parser_cache_set_field (dc_parser_cache_entry_t *entry, dc_field_type_t type, unsigned int flags, const void *value, dc_status_t status);
+
+int
+dc_parser_cache_samples_foreach (dc_parser_cache_entry_t *entry, dc_sample_callback_t callback, void *userdata);
+
+int
+dc_parser_cache_samples_begin (dc_parser_cache_entry_t *entry);
+
+dc_status_t
+dc_parser_cache_samples_record (dc_parser_cache_entry_t *entry, dc_sample_type_t type, dc_sample_value_t value);
+
+void
+dc_parser_cache_samples_commit (dc_parser_cache_entry_t *entry, dc_status_t status);
+
+size_t
+dc_parser_cache_sample_encode (unsigned char buffer[], dc_sample_type_t type, const dc_sample_value_t *value);
+
+size_t
+dc_parser_cache_sample_decode (const unsigned char buffer[], size_t size, dc_sample_type_t *type, dc_sample_value_t *value);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_CACHE_H */
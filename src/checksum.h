@@ -26,27 +26,72 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#define CHECKSUM_CRC32_INIT  0xffffffff
+#define CHECKSUM_CRC32B_INIT 0xffffffff
+
 unsigned char
 checksum_add_uint4 (const unsigned char data[], unsigned int size, unsigned char init);
 
+unsigned char
+checksum_add_uint4_update (const unsigned char data[], unsigned int size, unsigned char crc);
+
+unsigned char
+checksum_add_uint4_final (unsigned char crc);
+
 unsigned char
 checksum_add_uint8 (const unsigned char data[], unsigned int size, unsigned char init);
 
+unsigned char
+checksum_add_uint8_update (const unsigned char data[], unsigned int size, unsigned char crc);
+
+unsigned char
+checksum_add_uint8_final (unsigned char crc);
+
 unsigned short
 checksum_add_uint16 (const unsigned char data[], unsigned int size, unsigned short init);
 
+unsigned short
+checksum_add_uint16_update (const unsigned char data[], unsigned int size, unsigned short crc);
+
+unsigned short
+checksum_add_uint16_final (unsigned short crc);
+
 unsigned char
 checksum_xor_uint8 (const unsigned char data[], unsigned int size, unsigned char init);
 
+unsigned char
+checksum_xor_uint8_update (const unsigned char data[], unsigned int size, unsigned char crc);
+
+unsigned char
+checksum_xor_uint8_final (unsigned char crc);
+
 unsigned short
 checksum_crc16_ccitt (const unsigned char data[], unsigned int size, unsigned short init);
 
+unsigned short
+checksum_crc16_ccitt_update (const unsigned char data[], unsigned int size, unsigned short crc);
+
+unsigned short
+checksum_crc16_ccitt_final (unsigned short crc);
+
 unsigned int
 checksum_crc32 (const unsigned char data[], unsigned int size);
 
+unsigned int
+checksum_crc32_update (const unsigned char data[], unsigned int size, unsigned int crc);
+
+unsigned int
+checksum_crc32_final (unsigned int crc);
+
 unsigned int
 checksum_crc32b (const unsigned char data[], unsigned int size);
 
+unsigned int
+checksum_crc32b_update (const unsigned char data[], unsigned int size, unsigned int crc);
+
+unsigned int
+checksum_crc32b_final (unsigned int crc);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
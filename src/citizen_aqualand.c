@@ -46,10 +46,12 @@ static const dc_device_vtable_t citizen_aqualand_device_vtable = {
 	DC_FAMILY_CITIZEN_AQUALAND,
 	citizen_aqualand_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	citizen_aqualand_device_dump, /* dump */
 	citizen_aqualand_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
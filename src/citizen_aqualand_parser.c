@@ -32,8 +32,12 @@
 
 #define SZ_HEADER 32
 
+// The maximum number of samples without the heap.
+#define MAXSAMPLES 8192
+
 typedef struct citizen_aqualand_parser_t {
 	dc_parser_t base;
+	unsigned short *samples;
 } citizen_aqualand_parser_t;
 
 static dc_status_t citizen_aqualand_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
@@ -67,6 +71,12 @@ citizen_aqualand_parser_create (dc_parser_t **out, dc_context_t *context)
 		return DC_STATUS_NOMEMORY;
 	}
 
+	dc_status_t status = dc_parser_reserve ((dc_parser_t *) parser, MAXSAMPLES * sizeof (unsigned short), (void **) &parser->samples);
+	if (status != DC_STATUS_SUCCESS) {
+		dc_parser_deallocate ((dc_parser_t *) parser);
+		return status;
+	}
+
 	*out = (dc_parser_t*) parser;
 
 	return DC_STATUS_SUCCESS;
@@ -142,6 +152,7 @@ citizen_aqualand_parser_get_field (dc_parser_t *abstract, dc_field_type_t type,
 static dc_status_t
 citizen_aqualand_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
 {
+	citizen_aqualand_parser_t *parser = (citizen_aqualand_parser_t *) abstract;
 	const unsigned char *data = abstract->data;
 	unsigned int size = abstract->size;
 
@@ -154,10 +165,19 @@ citizen_aqualand_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callba
 	// due to the presence of at least two end markers.
 	unsigned int maxcount = (2 * (size - SZ_HEADER) + 2) / 3;
 
-	// Allocate storage for the processed 16 bit samples.
-	unsigned short *samples = (unsigned short *) malloc(maxcount * sizeof(unsigned short));
-	if (samples == NULL) {
-		return DC_STATUS_NOMEMORY;
+	// Allocate storage for the processed 16 bit samples, unless the
+	// parser has working memory of its own.
+	unsigned short *samples = parser->samples;
+	if (samples) {
+		if (maxcount > MAXSAMPLES) {
+			ERROR (abstract->context, "Too many samples (%u).", maxcount);
+			return DC_STATUS_NOMEMORY;
+		}
+	} else {
+		samples = (unsigned short *) malloc(maxcount * sizeof(unsigned short));
+		if (samples == NULL) {
+			return DC_STATUS_NOMEMORY;
+		}
 	}
 
 	// Pre-process the depth and temperature tables. The 12 bit BCD encoded
@@ -205,7 +225,8 @@ citizen_aqualand_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callba
 		// Verify the end marker.
 		if (offset + 2 > length || data[offset / 2] != marker) {
 			ERROR (abstract->context, "No end marker found.");
-			free(samples);
+			if (samples != parser->samples)
+				free(samples);
 			return DC_STATUS_DATAFORMAT;
 		}
 
@@ -262,7 +283,8 @@ citizen_aqualand_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callba
 		}
 	}
 
-	free(samples);
+	if (samples != parser->samples)
+		free(samples);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -34,6 +34,9 @@
 
 #define MAXRETRIES 2
 
+// The number of logbook entries in the first logbook read.
+#define LOGBOOK_CHUNK 32
+
 #define COCHRAN_MODEL_COMMANDER_TM 0
 #define COCHRAN_MODEL_COMMANDER_PRE21000 1
 #define COCHRAN_MODEL_COMMANDER_AIR_NITROX 2
@@ -109,10 +112,12 @@ static const dc_device_vtable_t cochran_commander_device_vtable = {
 	DC_FAMILY_COCHRAN_COMMANDER,
 	cochran_commander_device_set_fingerprint,/* set_fingerprint */
 	cochran_commander_device_read, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	cochran_commander_device_dump, /* dump */
 	cochran_commander_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -344,7 +349,7 @@ cochran_commander_serial_setup (cochran_commander_device_t *device)
 static dc_status_t
 cochran_commander_packet (cochran_commander_device_t *device, dc_event_progress_t *progress,
 	const unsigned char command[], unsigned int csize,
-	unsigned char answer[], unsigned int asize, int high_speed)
+	unsigned char answer[], unsigned int asize, unsigned int *actual, int high_speed)
 {
 	dc_device_t *abstract = (dc_device_t *) device;
 	dc_status_t status = DC_STATUS_SUCCESS;
@@ -366,6 +371,9 @@ cochran_commander_packet (cochran_commander_device_t *device, dc_event_progress_
 		}
 	}
 
+	if (actual)
+		*actual = 0;
+
 	if (high_speed && device->layout->baudrate != 9600) {
 		// Give the DC time to process the command.
 		dc_iostream_sleep(device->iostream, 45);
@@ -379,7 +387,8 @@ cochran_commander_packet (cochran_commander_device_t *device, dc_event_progress_
 	}
 
 	// Receive the answer from the device.
-	// Use 1024 byte "packets" so we can display progress.
+	// Use 1024 byte "packets" so we can display progress, and resume
+	// a failed transfer after the last complete packet.
 	unsigned int nbytes = 0;
 	while (nbytes < asize) {
 		unsigned int len = asize - nbytes;
@@ -393,6 +402,8 @@ cochran_commander_packet (cochran_commander_device_t *device, dc_event_progress_
 		}
 
 		nbytes += len;
+		if (actual)
+			*actual = nbytes;
 
 		if (progress) {
 			progress->current += len;
@@ -411,7 +422,7 @@ cochran_commander_read_id (cochran_commander_device_t *device, unsigned char id[
 
 	unsigned char command[6] = {0x05, 0x9D, 0xFF, 0x00, 0x43, 0x00};
 
-	rc = cochran_commander_packet(device, NULL, command, sizeof(command), id, size, 0);
+	rc = cochran_commander_packet(device, NULL, command, sizeof(command), id, size, NULL, 0);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
@@ -420,7 +431,7 @@ cochran_commander_read_id (cochran_commander_device_t *device, unsigned char id[
 		command[1] = 0xBD;
 		command[2] = 0x7F;
 
-		rc = cochran_commander_packet(device, NULL, command, sizeof(command), id, size, 0);
+		rc = cochran_commander_packet(device, NULL, command, sizeof(command), id, size, NULL, 0);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 	}
@@ -446,7 +457,7 @@ cochran_commander_read_config (cochran_commander_device_t *device, dc_event_prog
 		if (device->layout->model == COCHRAN_MODEL_COMMANDER_TM)
 			command_size = 1;
 
-		rc = cochran_commander_packet(device, progress, command, command_size, data + i * 512, 512, 0);
+		rc = cochran_commander_packet(device, progress, command, command_size, data + i * 512, 512, NULL, 0);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
@@ -461,10 +472,13 @@ cochran_commander_read_config (cochran_commander_device_t *device, dc_event_prog
 
 
 static dc_status_t
-cochran_commander_read (cochran_commander_device_t *device, dc_event_progress_t *progress, unsigned int address, unsigned char data[], unsigned int size)
+cochran_commander_read (cochran_commander_device_t *device, dc_event_progress_t *progress, unsigned int address, unsigned char data[], unsigned int size, unsigned int *actual)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	if (actual)
+		*actual = 0;
+
 	// Build the command
 	unsigned char command[10];
 	unsigned char command_size;
@@ -529,7 +543,7 @@ cochran_commander_read (cochran_commander_device_t *device, dc_event_progress_t
 		return rc;
 
 	// Read data at high speed
-	rc = cochran_commander_packet (device, progress, command, command_size, data, size, 1);
+	rc = cochran_commander_packet (device, progress, command, command_size, data, size, actual, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
@@ -540,28 +554,35 @@ cochran_commander_read (cochran_commander_device_t *device, dc_event_progress_t
 static dc_status_t
 cochran_commander_read_retry (cochran_commander_device_t *device, dc_event_progress_t *progress, unsigned int address, unsigned char data[], unsigned int size)
 {
-	// Save the state of the progress events.
-	unsigned int saved = 0;
-	if (progress) {
-		saved = progress->current;
-	}
-
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = cochran_commander_read (device, progress, address, data, size)) != DC_STATUS_SUCCESS) {
+
+	// A failed read is resumed after the last complete packet, instead
+	// of starting again from the beginning. The packets that were
+	// already received are not downloaded again, and the progress
+	// events remain valid.
+	unsigned int nbytes = 0;
+	while (nbytes < size) {
+		unsigned int len = 0;
+		rc = cochran_commander_read (device, progress, address + nbytes, data + nbytes, size - nbytes, &len);
+		nbytes += len;
+		if (rc == DC_STATUS_SUCCESS)
+			break;
+
 		// Automatically discard a corrupted packet,
 		// and request a new one.
 		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
 			return rc;
 
+		// Reset the retry counter as long as the transfer makes progress.
+		if (len)
+			nretries = 0;
+
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
 			return rc;
 
-		// Restore the state of the progress events.
-		if (progress) {
-			progress->current = saved;
-		}
+		WARNING (device->base.context, "Resuming the transfer at address 0x%08x.", address + nbytes);
 	}
 
 	return rc;
@@ -608,12 +629,11 @@ cochran_commander_profile_size(cochran_commander_device_t *device, cochran_data_
 
 
 /*
- * Do several things. Find the log that matches the fingerprint,
- * calculate the total read size for progress indicator,
- * Determine the most recent dive without profile data.
+ * Do several things. Find the log that matches the fingerprint, and
+ * determine the most recent dive without profile data.
  */
 
-static unsigned int
+static void
 cochran_commander_find_fingerprint(cochran_commander_device_t *device, cochran_data_t *data)
 {
 	unsigned int base = device->layout->rb_logbook_begin;
@@ -631,7 +651,6 @@ cochran_commander_find_fingerprint(cochran_commander_device_t *device, cochran_d
 		dive_count = device->layout->rb_logbook_entry_count;
 	dive_count--;
 
-	unsigned int sample_read_size = 0;
 	data->invalid_profile_dive_num = -1;
 
 	// Remove the pre-dive events that occur after the last dive
@@ -704,12 +723,127 @@ cochran_commander_find_fingerprint(cochran_commander_device_t *device, cochran_d
 				// Save the last dive that is missing profile data
 				data->invalid_profile_dive_num = idx;
 			}
-			// Accumulate read size for progress bar
-			sample_read_size += sample_size;
 		}
 	}
+}
+
+
+/*
+ * Read the logbook, from the most recent entry backwards, until the
+ * entry matching the fingerprint is found. Every read command has a
+ * large fixed cost, so the chunks double in size. A download with only
+ * a few new dives reads just the first chunk, and a full download needs
+ * only a few more commands. The entries are stored at their index in
+ * the logbook buffer, and the older entries are left unread. Only
+ * cochran_commander_find_fingerprint and the dives newer than the
+ * fingerprint access the logbook afterwards, so they never see them.
+ */
+static dc_status_t
+cochran_commander_read_logbook (cochran_commander_device_t *device, dc_event_progress_t *progress, cochran_data_t *data)
+{
+	const cochran_device_layout_t *layout = device->layout;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	unsigned int nentries = layout->rb_logbook_entry_count;
+	unsigned int size = layout->rb_logbook_entry_size;
+
+	unsigned int count = 0, head = 0;
+	if (data->dive_count <= nentries) {
+		count = data->dive_count;
+		head = data->dive_count;
+	} else {
+		// Log wrapped
+		count = nentries;
+		head = data->dive_count % nentries;
+	}
+
+	unsigned int nread = 0;
+	unsigned int chunk = LOGBOOK_CHUNK;
+	while (nread < count) {
+		unsigned int n = count - nread;
+		if (n > chunk)
+			n = chunk;
+
+		// The newest and oldest entry of this chunk.
+		unsigned int hi = (nentries + head - 1 - nread) % nentries;
+		unsigned int lo = (nentries + head - nread - n) % nentries;
+
+		if (lo <= hi) {
+			rc = cochran_commander_read_retry (device, progress,
+				layout->rb_logbook_begin + lo * size, data->logbook + lo * size, (hi - lo + 1) * size);
+		} else {
+			// The chunk wraps around the end of the logbook.
+			rc = cochran_commander_read_retry (device, progress,
+				layout->rb_logbook_begin, data->logbook, (hi + 1) * size);
+			if (rc == DC_STATUS_SUCCESS) {
+				rc = cochran_commander_read_retry (device, progress,
+					layout->rb_logbook_begin + lo * size, data->logbook + lo * size, (nentries - lo) * size);
+			}
+		}
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
+		// Stop at the fingerprint entry.
+		for (unsigned int i = 0; i < n; ++i) {
+			unsigned int idx = (nentries + hi - i) % nentries;
+			if (memcmp (device->fingerprint, data->logbook + idx * size + layout->pt_fingerprint, layout->fingerprint_size) == 0)
+				return DC_STATUS_SUCCESS;
+		}
 
-	return sample_read_size;
+		nread += n;
+		chunk *= 2;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+/*
+ * Get the profile addresses and sizes of a dive. The dives are processed
+ * from the most recent one backwards, and the pre-dive events of a dive
+ * run up to the profile of the next dive. Returns zero for a corrupt
+ * logbook entry.
+ */
+static int
+cochran_commander_dive_extent (cochran_commander_device_t *device, cochran_data_t *data, unsigned int idx,
+	unsigned int *last_start_address, int *invalid_profile_flag, unsigned int *sample_size, unsigned int *pre_size)
+{
+	const cochran_device_layout_t *layout = device->layout;
+	unsigned int base = layout->rb_logbook_begin;
+
+	const unsigned char *log_entry = data->logbook + idx * layout->rb_logbook_entry_size;
+
+	unsigned int sample_start_address = 0;
+	unsigned int sample_end_address = 0;
+	if (layout->model == COCHRAN_MODEL_COMMANDER_TM) {
+		sample_start_address = base + array_uint16_le (log_entry + layout->pt_profile_begin);
+		sample_end_address = *last_start_address;
+		// Commander TM has SRAM which seems to randomize when they lose power for too long
+		// Check for bad entries.
+		if (sample_start_address < layout->rb_profile_begin || sample_start_address > layout->rb_profile_end ||
+			sample_end_address < layout->rb_profile_begin || sample_end_address > layout->rb_profile_end ||
+			array_uint16_le(log_entry + layout->pt_dive_number) % layout->rb_logbook_entry_count != idx) {
+			return 0;
+		}
+	} else {
+		sample_start_address = base + array_uint32_le (log_entry + layout->pt_profile_begin);
+		sample_end_address = base + array_uint32_le (log_entry + layout->pt_profile_end);
+	}
+
+	*sample_size = 0;
+	*pre_size = 0;
+
+	// Determine if profile exists
+	if (idx == data->invalid_profile_dive_num)
+		*invalid_profile_flag = 1;
+
+	if (!*invalid_profile_flag) {
+		*sample_size = cochran_commander_profile_size(device, data, idx, sample_start_address, sample_end_address);
+		*pre_size = cochran_commander_profile_size(device, data, idx, sample_end_address, *last_start_address);
+		*last_start_address = sample_start_address;
+	}
+
+	return 1;
 }
 
 
@@ -916,19 +1050,15 @@ cochran_commander_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Request log book
-	rc = cochran_commander_read_retry(device, &progress, layout->rb_logbook_begin, data.logbook, data.logbook_size);
+	// Request the new part of the log book
+	rc = cochran_commander_read_logbook (device, &progress, &data);
 	if (rc != DC_STATUS_SUCCESS) {
 		status = rc;
 		goto error;
 	}
 
-	// Locate fingerprint, recent dive with invalid profile and calc read size
-	unsigned int profile_read_size = cochran_commander_find_fingerprint(device, &data);
-
-	// Update progress indicator with new maximum
-	progress.maximum -= (max_sample - profile_read_size);
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	// Locate fingerprint and recent dive with invalid profile
+	cochran_commander_find_fingerprint(device, &data);
 
 	// Emit a device info event.
 	dc_event_devinfo_t devinfo;
@@ -965,14 +1095,33 @@ cochran_commander_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 	else
 		last_start_address = base + array_uint32_le(data.config + layout->cf_last_log );
 
-	// Create the ringbuffer stream.
-	status = dc_rbstream_new (&rbstream, abstract, 1, layout->rbstream_size, layout->rb_profile_begin, layout->rb_profile_end, last_start_address);
+	// Calculate the amount of profile data of the new dives.
+	unsigned int profile_read_size = 0;
+	unsigned int address = last_start_address;
+	int invalid_profile_flag = 0;
+	for (unsigned int i = 0; i < dive_count; ++i) {
+		unsigned int idx = (layout->rb_logbook_entry_count + head_dive - (i + 1)) % layout->rb_logbook_entry_count;
+
+		unsigned int sample_size = 0, pre_size = 0;
+		if (cochran_commander_dive_extent (device, &data, idx, &address, &invalid_profile_flag, &sample_size, &pre_size) && sample_size)
+			profile_read_size += sample_size + pre_size;
+	}
+
+	// Update progress indicator with new maximum
+	progress.maximum = progress.current + profile_read_size;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Create the ringbuffer stream. The stream reads no further than the
+	// profile of the oldest new dive.
+	status = dc_rbstream_new2 (&rbstream, abstract, 1, 1, layout->rbstream_size, layout->rb_profile_begin, layout->rb_profile_end, last_start_address);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		goto error;
 	}
 
-	int invalid_profile_flag = 0;
+	dc_rbstream_limit (rbstream, profile_read_size);
+
+	invalid_profile_flag = 0;
 
 	// Loop through each dive
 	for (unsigned int i = 0; i < dive_count; ++i) {
@@ -980,34 +1129,10 @@ cochran_commander_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 
 		unsigned char *log_entry = data.logbook + idx * layout->rb_logbook_entry_size;
 
-		unsigned int sample_start_address = 0;
-		unsigned int sample_end_address = 0;
-		if (layout->model == COCHRAN_MODEL_COMMANDER_TM) {
-			sample_start_address = base + array_uint16_le (log_entry + layout->pt_profile_begin);
-			sample_end_address = last_start_address;
-			// Commander TM has SRAM which seems to randomize when they lose power for too long
-			// Check for bad entries.
-			if (sample_start_address < layout->rb_profile_begin || sample_start_address > layout->rb_profile_end ||
-				sample_end_address < layout->rb_profile_begin || sample_end_address > layout->rb_profile_end ||
-				array_uint16_le(log_entry + layout->pt_dive_number) % layout->rb_logbook_entry_count != idx) {
-				ERROR(abstract->context, "Corrupt dive (%d).", idx);
-				continue;
-			}
-		} else {
-			sample_start_address = base + array_uint32_le (log_entry + layout->pt_profile_begin);
-			sample_end_address = base + array_uint32_le (log_entry + layout->pt_profile_end);
-		}
-
-		int sample_size = 0, pre_size = 0;
-
-		// Determine if profile exists
-		if (idx == data.invalid_profile_dive_num)
-			invalid_profile_flag = 1;
-
-		if (!invalid_profile_flag) {
-			sample_size = cochran_commander_profile_size(device, &data, idx, sample_start_address, sample_end_address);
-			pre_size = cochran_commander_profile_size(device, &data, idx, sample_end_address, last_start_address);
-			last_start_address = sample_start_address;
+		unsigned int sample_size = 0, pre_size = 0;
+		if (!cochran_commander_dive_extent (device, &data, idx, &last_start_address, &invalid_profile_flag, &sample_size, &pre_size)) {
+			ERROR(abstract->context, "Corrupt dive (%d).", idx);
+			continue;
 		}
 
 		// Build dive blob
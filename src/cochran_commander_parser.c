@@ -216,6 +216,7 @@ static const cochran_parser_layout_t cochran_emc_parser_layout = {
 	407,         // max_temp, 1 byte, /2+20=F
 };
 
+// Sorted by event code.
 static const cochran_events_t cochran_events[] = {
 	{0xA8, 1, SAMPLE_EVENT_SURFACE,  SAMPLE_FLAGS_BEGIN}, // Entered PDI mode
 	{0xA9, 1, SAMPLE_EVENT_SURFACE,  SAMPLE_FLAGS_END},   // Exited PDI mode
@@ -233,9 +234,9 @@ static const cochran_events_t cochran_events[] = {
 	{0xC7, 1, SAMPLE_EVENT_VIOLATION,SAMPLE_FLAGS_BEGIN}, // Entered Gauge mode (e.g. locked out)
 	{0xC8, 1, SAMPLE_EVENT_PO2,      SAMPLE_FLAGS_BEGIN}, // PO2 too high
 	{0xCC, 1, SAMPLE_EVENT_NONE,     SAMPLE_FLAGS_BEGIN}, // Low Cylinder 1 pressure
+	{0xCD, 1, SAMPLE_EVENT_NONE,     SAMPLE_FLAGS_NONE},  // Switched to deco blend
 	{0xCE, 1, SAMPLE_EVENT_NONE,     SAMPLE_FLAGS_BEGIN}, // Non-decompression warning
 	{0xCF, 1, SAMPLE_EVENT_OLF,      SAMPLE_FLAGS_BEGIN}, // O2 Toxicity
-	{0xCD, 1, SAMPLE_EVENT_NONE,     SAMPLE_FLAGS_NONE},  // Switched to deco blend
 	{0xD0, 1, SAMPLE_EVENT_WORKLOAD, SAMPLE_FLAGS_BEGIN}, // Breathing rate alarm
 	{0xD3, 1, SAMPLE_EVENT_NONE,     SAMPLE_FLAGS_NONE},  // Low gas 1 flow rate
 	{0xD6, 1, SAMPLE_EVENT_CEILING,  SAMPLE_FLAGS_BEGIN}, // Depth is less than ceiling
@@ -273,9 +274,15 @@ cochran_commander_handle_event (cochran_commander_parser_t *parser, unsigned cha
 	dc_parser_t *abstract = (dc_parser_t *) parser;
 
 	const cochran_events_t *event = NULL;
-	for (unsigned int i = 0; i < C_ARRAY_SIZE(cochran_events); ++i) {
-		if (cochran_events[i].code == code) {
-			event = cochran_events + i;
+	unsigned int lo = 0, hi = C_ARRAY_SIZE(cochran_events);
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (cochran_events[mid].code < code) {
+			lo = mid + 1;
+		} else if (cochran_events[mid].code > code) {
+			hi = mid;
+		} else {
+			event = cochran_events + mid;
 			break;
 		}
 	}
@@ -27,6 +27,7 @@
 #endif
 
 #include <libdivecomputer/context.h>
+#include <libdivecomputer/bluetooth.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,13 +48,23 @@ extern "C" {
 #endif
 
 #ifdef ENABLE_LOGGING
-#define HEXDUMP(context, loglevel, prefix, data, size) dc_context_hexdump (context, loglevel, __FILE__, __LINE__, FUNCTION, prefix, data, size)
-#define SYSERROR(context, errcode) dc_context_syserror (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, errcode)
-#define ERROR(context, ...) dc_context_log (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
-#define WARNING(context, ...) dc_context_log (context, DC_LOGLEVEL_WARNING, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
-#define INFO(context, ...) dc_context_log (context, DC_LOGLEVEL_INFO, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
-#define DEBUG(context, ...) dc_context_log (context, DC_LOGLEVEL_DEBUG, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
+/*
+ * The messages above the maximum log level are removed at compile time,
+ * and the messages above the log level of the context are skipped before
+ * the arguments are evaluated.
+ */
+#ifndef LOGLEVEL_MAX
+#define LOGLEVEL_MAX DC_LOGLEVEL_ALL
+#endif
+#define LOGGING(context, loglevel) ((loglevel) <= LOGLEVEL_MAX && dc_context_is_enabled (context, loglevel))
+#define HEXDUMP(context, loglevel, prefix, data, size) do { if (LOGGING (context, loglevel)) dc_context_hexdump (context, loglevel, __FILE__, __LINE__, FUNCTION, prefix, data, size); } while (0)
+#define SYSERROR(context, errcode) do { if (LOGGING (context, DC_LOGLEVEL_ERROR)) dc_context_syserror (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, errcode); } while (0)
+#define ERROR(context, ...) do { if (LOGGING (context, DC_LOGLEVEL_ERROR)) dc_context_log (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, __VA_ARGS__); } while (0)
+#define WARNING(context, ...) do { if (LOGGING (context, DC_LOGLEVEL_WARNING)) dc_context_log (context, DC_LOGLEVEL_WARNING, __FILE__, __LINE__, FUNCTION, __VA_ARGS__); } while (0)
+#define INFO(context, ...) do { if (LOGGING (context, DC_LOGLEVEL_INFO)) dc_context_log (context, DC_LOGLEVEL_INFO, __FILE__, __LINE__, FUNCTION, __VA_ARGS__); } while (0)
+#define DEBUG(context, ...) do { if (LOGGING (context, DC_LOGLEVEL_DEBUG)) dc_context_log (context, DC_LOGLEVEL_DEBUG, __FILE__, __LINE__, FUNCTION, __VA_ARGS__); } while (0)
 #else
+#define LOGGING(context, loglevel) 0
 #define HEXDUMP(context, loglevel, prefix, data, size) UNUSED(context)
 #define SYSERROR(context, errcode) UNUSED(context)
 #define ERROR(context, ...) UNUSED(context)
@@ -62,6 +73,9 @@ extern "C" {
 #define DEBUG(context, ...) UNUSED(context)
 #endif
 
+int
+dc_context_is_enabled (dc_context_t *context, dc_loglevel_t loglevel);
+
 dc_status_t
 dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *format, ...) ATTR_FORMAT_PRINTF(6, 7);
 
@@ -71,6 +85,68 @@ dc_context_syserror (dc_context_t *context, dc_loglevel_t loglevel, const char *
 dc_status_t
 dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *prefix, const unsigned char data[], unsigned int size);
 
+/*
+ * Cache of the bluetooth devices, shared by all connections of the
+ * context. It remembers the RFCOMM channel and the name of the most
+ * recently used addresses, to avoid the slow SDP queries and remote
+ * name requests. A channel of zero means unknown, and an empty name is
+ * a valid name.
+ */
+unsigned int
+dc_context_get_bluetooth_port (dc_context_t *context, dc_bluetooth_address_t address);
+
+void
+dc_context_set_bluetooth_port (dc_context_t *context, dc_bluetooth_address_t address, unsigned int port);
+
+int
+dc_context_get_bluetooth_name (dc_context_t *context, dc_bluetooth_address_t address, char *name, size_t size);
+
+void
+dc_context_set_bluetooth_name (dc_context_t *context, dc_bluetooth_address_t address, const char *name);
+
+/*
+ * Objects shared by all users of the context, and kept alive until the
+ * context is freed. The object is created on first use, and every call
+ * returns a new reference. Without a context, a new object is created
+ * every time.
+ */
+typedef enum dc_resource_t {
+	DC_RESOURCE_USB,
+	DC_RESOURCE_USBHID,
+	DC_RESOURCE_SOCKET,
+	DC_RESOURCE_EXECUTOR,
+	DC_RESOURCE_MAX
+} dc_resource_t;
+
+typedef struct dc_resource_vtable_t {
+	dc_status_t (*create) (void **resource, dc_context_t *context);
+	void *(*ref) (void *resource);
+	dc_status_t (*unref) (void *resource);
+} dc_resource_vtable_t;
+
+dc_status_t
+dc_context_get_resource (dc_context_t *context, dc_resource_t type, const dc_resource_vtable_t *vtable, void **resource);
+
+/*
+ * Replace the object with a new reference to the given object, or with
+ * nothing, such that the next use creates a new one again.
+ */
+dc_status_t
+dc_context_set_resource (dc_context_t *context, dc_resource_t type, const dc_resource_vtable_t *vtable, void *resource);
+
+/*
+ * Cache of the connection profiles, keyed by the family and the address
+ * of the device. The profile is an opaque structure of the backend, and
+ * is only returned if the size matches. Storing a profile of size zero
+ * removes the entry. Without an address, or with the cache disabled,
+ * nothing is cached.
+ */
+int
+dc_context_get_profile (dc_context_t *context, dc_family_t family, const char *address, void *data, size_t size);
+
+void
+dc_context_set_profile (dc_context_t *context, dc_family_t family, const char *address, const void *data, size_t size);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
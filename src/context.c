@@ -36,14 +36,66 @@
 
 #include "context-private.h"
 #include "timer.h"
+#include "thread.h"
+
+#define NBLUETOOTH 16
+#define NPROFILES  8
+
+typedef struct dc_context_bluetooth_t {
+	dc_bluetooth_address_t address;
+	unsigned int port;
+	unsigned int hasname;
+	unsigned int sequence;
+	char name[248];
+} dc_context_bluetooth_t;
+
+typedef struct dc_context_profile_t {
+	dc_family_t family;
+	char address[64];
+	unsigned int sequence;
+	size_t size;
+	unsigned char data[256];
+} dc_context_profile_t;
+
+/*
+ * A log message waiting for the log thread. The file and function names
+ * are string literals, and are not copied.
+ */
+typedef struct dc_context_record_t {
+	struct dc_context_record_t *next;
+	dc_loglevel_t loglevel;
+	const char *file;
+	unsigned int line;
+	const char *function;
+	char msg[1];
+} dc_context_record_t;
 
 struct dc_context_t {
 	dc_loglevel_t loglevel;
 	dc_logfunc_t logfunc;
 	void *userdata;
+	dc_datafunc_t datafunc;
+	void *datauserdata;
+	dc_context_bluetooth_t bluetooth[NBLUETOOTH];
+	unsigned int sequence;
+	dc_context_profile_t profiles[NPROFILES];
+	unsigned int profile_cache;
+	void *resources[DC_RESOURCE_MAX];
+	const dc_resource_vtable_t *vtables[DC_RESOURCE_MAX];
+	dc_mutex_t *cache;
 #ifdef ENABLE_LOGGING
 	char msg[16384 + 32];
 	dc_timer_t *timer;
+	dc_mutex_t *mutex;
+	/* The queue of the asynchronous log messages. */
+	dc_thread_t *logthread;
+	dc_cond_t *logcond;
+	dc_context_record_t *head;
+	dc_context_record_t *tail;
+	unsigned int nqueued;
+	unsigned int maxqueued;
+	unsigned int ndropped;
+	int logquit;
 #endif
 };
 
@@ -150,6 +202,95 @@ logfunc (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsign
 			loglevels[loglevel], msg);
 	}
 }
+/*
+ * Deliver a formatted message, either directly or through the queue of
+ * the log thread. Must be called with the log mutex locked.
+ */
+static void
+dc_context_dispatch (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *msg)
+{
+	if (context->logthread == NULL) {
+		context->logfunc (context, loglevel, file, line, function, msg, context->userdata);
+		return;
+	}
+
+	if (context->nqueued >= context->maxqueued) {
+		context->ndropped++;
+		return;
+	}
+
+	size_t length = strlen (msg);
+	dc_context_record_t *record = (dc_context_record_t *) malloc (sizeof (dc_context_record_t) + length);
+	if (record == NULL) {
+		context->ndropped++;
+		return;
+	}
+
+	record->next = NULL;
+	record->loglevel = loglevel;
+	record->file = file;
+	record->line = line;
+	record->function = function;
+	memcpy (record->msg, msg, length + 1);
+
+	if (context->tail)
+		context->tail->next = record;
+	else
+		context->head = record;
+	context->tail = record;
+	context->nqueued++;
+
+	dc_cond_broadcast (context->logcond);
+}
+
+static void
+dc_context_logthread (void *userdata)
+{
+	dc_context_t *context = (dc_context_t *) userdata;
+
+	dc_mutex_lock (context->mutex);
+
+	while (1) {
+		while (!context->logquit && context->head == NULL && context->ndropped == 0)
+			dc_cond_wait (context->logcond, context->mutex);
+
+		dc_context_record_t *record = context->head;
+		unsigned int ndropped = context->ndropped;
+		if (record == NULL && ndropped == 0)
+			break;
+
+		if (record) {
+			context->head = record->next;
+			if (context->head == NULL)
+				context->tail = NULL;
+			context->nqueued--;
+		}
+		context->ndropped = 0;
+
+		dc_logfunc_t func = context->logfunc;
+		void *funcdata = context->userdata;
+
+		// Invoke the callback without the lock, so the logging
+		// threads never wait for a slow callback.
+		dc_mutex_unlock (context->mutex);
+
+		if (func && ndropped) {
+			char msg[64];
+			l_snprintf (msg, sizeof (msg), "%u log messages dropped.", ndropped);
+			func (context, DC_LOGLEVEL_WARNING, __FILE__, __LINE__, FUNCTION, msg, funcdata);
+		}
+
+		if (func && record) {
+			func (context, record->loglevel, record->file, record->line, record->function, record->msg, funcdata);
+		}
+
+		free (record);
+
+		dc_mutex_lock (context->mutex);
+	}
+
+	dc_mutex_unlock (context->mutex);
+}
 #endif
 
 dc_status_t
@@ -172,11 +313,45 @@ dc_context_new (dc_context_t **out)
 	context->logfunc = NULL;
 #endif
 	context->userdata = NULL;
+	context->datafunc = NULL;
+	context->datauserdata = NULL;
+
+	memset (context->bluetooth, 0, sizeof (context->bluetooth));
+	memset (context->profiles, 0, sizeof (context->profiles));
+	context->profile_cache = 0;
+	context->sequence = 0;
+	for (size_t i = 0; i < DC_RESOURCE_MAX; ++i) {
+		context->resources[i] = NULL;
+		context->vtables[i] = NULL;
+	}
+	context->cache = NULL;
+	if (dc_mutex_new (&context->cache) != DC_STATUS_SUCCESS) {
+		free (context);
+		return DC_STATUS_NOMEMORY;
+	}
 
 #ifdef ENABLE_LOGGING
 	memset (context->msg, 0, sizeof (context->msg));
 	context->timer = NULL;
 	dc_timer_new (&context->timer);
+
+	context->logthread = NULL;
+	context->logcond = NULL;
+	context->head = NULL;
+	context->tail = NULL;
+	context->nqueued = 0;
+	context->maxqueued = 0;
+	context->ndropped = 0;
+	context->logquit = 0;
+
+	/* The message buffer is shared, so logging must be serialized. */
+	context->mutex = NULL;
+	if (dc_mutex_new (&context->mutex) != DC_STATUS_SUCCESS) {
+		dc_timer_free (context->timer);
+		dc_mutex_free (context->cache);
+		free (context);
+		return DC_STATUS_NOMEMORY;
+	}
 #endif
 
 	*out = context;
@@ -190,9 +365,22 @@ dc_context_free (dc_context_t *context)
 	if (context == NULL)
 		return DC_STATUS_SUCCESS;
 
+	// Release the shared objects, while logging is still possible.
+	for (size_t i = 0; i < DC_RESOURCE_MAX; ++i) {
+		if (context->resources[i]) {
+			context->vtables[i]->unref (context->resources[i]);
+		}
+	}
+
 #ifdef ENABLE_LOGGING
+	// Deliver the remaining queued messages.
+	dc_context_set_logqueue (context, 0);
+	dc_cond_free (context->logcond);
+
+	dc_mutex_free (context->mutex);
 	dc_timer_free (context->timer);
 #endif
+	dc_mutex_free (context->cache);
 	free (context);
 
 	return DC_STATUS_SUCCESS;
@@ -205,7 +393,9 @@ dc_context_set_loglevel (dc_context_t *context, dc_loglevel_t loglevel)
 		return DC_STATUS_INVALIDARGS;
 
 #ifdef ENABLE_LOGGING
+	dc_mutex_lock (context->mutex);
 	context->loglevel = loglevel;
+	dc_mutex_unlock (context->mutex);
 #endif
 
 	return DC_STATUS_SUCCESS;
@@ -218,13 +408,105 @@ dc_context_set_logfunc (dc_context_t *context, dc_logfunc_t logfunc, void *userd
 		return DC_STATUS_INVALIDARGS;
 
 #ifdef ENABLE_LOGGING
+	dc_mutex_lock (context->mutex);
 	context->logfunc = logfunc;
 	context->userdata = userdata;
+	dc_mutex_unlock (context->mutex);
 #endif
 
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_context_set_datafunc (dc_context_t *context, dc_datafunc_t datafunc, void *userdata)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+#ifdef ENABLE_LOGGING
+	dc_mutex_lock (context->mutex);
+	context->datafunc = datafunc;
+	context->datauserdata = userdata;
+	dc_mutex_unlock (context->mutex);
+#endif
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_set_logqueue (dc_context_t *context, unsigned int maximum)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+#ifdef ENABLE_LOGGING
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_mutex_lock (context->mutex);
+
+	if (maximum)
+		context->maxqueued = maximum;
+
+	if (maximum && context->logthread == NULL) {
+		if (context->logcond == NULL) {
+			status = dc_cond_new (&context->logcond);
+			if (status != DC_STATUS_SUCCESS) {
+				context->logcond = NULL;
+				goto error_unlock;
+			}
+		}
+
+		status = dc_thread_new (&context->logthread, dc_context_logthread, context);
+		if (status != DC_STATUS_SUCCESS) {
+			context->logthread = NULL;
+			goto error_unlock;
+		}
+	} else if (maximum == 0 && context->logthread) {
+		// The log thread exits after the queue is empty.
+		dc_thread_t *thread = context->logthread;
+		context->logquit = 1;
+		dc_cond_broadcast (context->logcond);
+		dc_mutex_unlock (context->mutex);
+
+		dc_thread_join (thread);
+
+		dc_mutex_lock (context->mutex);
+		context->logthread = NULL;
+		context->logquit = 0;
+		context->maxqueued = 0;
+
+		// Deliver the messages queued after the thread finished.
+		while (context->head) {
+			dc_context_record_t *record = context->head;
+			context->head = record->next;
+			if (context->logfunc)
+				context->logfunc (context, record->loglevel, record->file, record->line, record->function, record->msg, context->userdata);
+			free (record);
+		}
+		context->tail = NULL;
+		context->nqueued = 0;
+		context->ndropped = 0;
+	}
+
+error_unlock:
+	dc_mutex_unlock (context->mutex);
+	return status;
+#else
+	return DC_STATUS_SUCCESS;
+#endif
+}
+
+int
+dc_context_is_enabled (dc_context_t *context, dc_loglevel_t loglevel)
+{
+#ifdef ENABLE_LOGGING
+	return context != NULL && loglevel <= context->loglevel &&
+		(context->logfunc != NULL || context->datafunc != NULL);
+#else
+	return 0;
+#endif
+}
+
 dc_status_t
 dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *format, ...)
 {
@@ -239,14 +521,17 @@ dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file,
 	if (loglevel > context->loglevel)
 		return DC_STATUS_SUCCESS;
 
-	if (context->logfunc == NULL)
-		return DC_STATUS_SUCCESS;
+	dc_mutex_lock (context->mutex);
 
-	va_start (ap, format);
-	l_vsnprintf (context->msg, sizeof (context->msg), format, ap);
-	va_end (ap);
+	if (context->logfunc) {
+		va_start (ap, format);
+		l_vsnprintf (context->msg, sizeof (context->msg), format, ap);
+		va_end (ap);
+
+		dc_context_dispatch (context, loglevel, file, line, function, context->msg);
+	}
 
-	context->logfunc (context, loglevel, file, line, function, context->msg, context->userdata);
+	dc_mutex_unlock (context->mutex);
 #endif
 
 	return DC_STATUS_SUCCESS;
@@ -306,16 +591,22 @@ dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *f
 	if (loglevel > context->loglevel)
 		return DC_STATUS_SUCCESS;
 
-	if (context->logfunc == NULL)
-		return DC_STATUS_SUCCESS;
+	dc_mutex_lock (context->mutex);
+
+	if (context->datafunc) {
+		// Pass the raw data, without formatting it first.
+		context->datafunc (context, loglevel, file, line, function, prefix, data, size, context->datauserdata);
+	} else if (context->logfunc) {
+		n = l_snprintf (context->msg, sizeof (context->msg), "%s: size=%u, data=", prefix, size);
 
-	n = l_snprintf (context->msg, sizeof (context->msg), "%s: size=%u, data=", prefix, size);
+		if (n >= 0) {
+			n = l_hexdump (context->msg + n, sizeof (context->msg) - n, data, size);
+		}
 
-	if (n >= 0) {
-		n = l_hexdump (context->msg + n, sizeof (context->msg) - n, data, size);
+		dc_context_dispatch (context, loglevel, file, line, function, context->msg);
 	}
 
-	context->logfunc (context, loglevel, file, line, function, context->msg, context->userdata);
+	dc_mutex_unlock (context->mutex);
 #endif
 
 	return DC_STATUS_SUCCESS;
@@ -352,3 +643,237 @@ dc_context_get_transports (dc_context_t *context)
 #endif /* _WIN32 */
 	;
 }
+
+/*
+ * Find the cache entry of the address. If there is no entry yet, and
+ * create is set, the least recently used entry is replaced.
+ */
+static dc_context_bluetooth_t *
+dc_context_bluetooth_find (dc_context_t *context, dc_bluetooth_address_t address, int create)
+{
+	dc_context_bluetooth_t *oldest = NULL;
+
+	for (size_t i = 0; i < NBLUETOOTH; ++i) {
+		dc_context_bluetooth_t *entry = context->bluetooth + i;
+		if (entry->sequence && entry->address == address) {
+			entry->sequence = ++context->sequence;
+			return entry;
+		}
+
+		if (oldest == NULL || entry->sequence < oldest->sequence) {
+			oldest = entry;
+		}
+	}
+
+	if (!create)
+		return NULL;
+
+	memset (oldest, 0, sizeof (*oldest));
+	oldest->address = address;
+	oldest->sequence = ++context->sequence;
+
+	return oldest;
+}
+
+unsigned int
+dc_context_get_bluetooth_port (dc_context_t *context, dc_bluetooth_address_t address)
+{
+	unsigned int port = 0;
+
+	if (context == NULL)
+		return 0;
+
+	dc_mutex_lock (context->cache);
+	dc_context_bluetooth_t *entry = dc_context_bluetooth_find (context, address, 0);
+	if (entry) {
+		port = entry->port;
+	}
+	dc_mutex_unlock (context->cache);
+
+	return port;
+}
+
+void
+dc_context_set_bluetooth_port (dc_context_t *context, dc_bluetooth_address_t address, unsigned int port)
+{
+	if (context == NULL)
+		return;
+
+	dc_mutex_lock (context->cache);
+	dc_context_bluetooth_t *entry = dc_context_bluetooth_find (context, address, port != 0);
+	if (entry) {
+		entry->port = port;
+	}
+	dc_mutex_unlock (context->cache);
+}
+
+int
+dc_context_get_bluetooth_name (dc_context_t *context, dc_bluetooth_address_t address, char *name, size_t size)
+{
+	int found = 0;
+
+	if (context == NULL || name == NULL || size == 0)
+		return 0;
+
+	dc_mutex_lock (context->cache);
+	dc_context_bluetooth_t *entry = dc_context_bluetooth_find (context, address, 0);
+	if (entry && entry->hasname) {
+		strncpy (name, entry->name, size - 1);
+		name[size - 1] = '\0';
+		found = 1;
+	}
+	dc_mutex_unlock (context->cache);
+
+	return found;
+}
+
+void
+dc_context_set_bluetooth_name (dc_context_t *context, dc_bluetooth_address_t address, const char *name)
+{
+	if (context == NULL || name == NULL)
+		return;
+
+	dc_mutex_lock (context->cache);
+	dc_context_bluetooth_t *entry = dc_context_bluetooth_find (context, address, 1);
+	strncpy (entry->name, name, sizeof (entry->name) - 1);
+	entry->name[sizeof (entry->name) - 1] = '\0';
+	entry->hasname = 1;
+	dc_mutex_unlock (context->cache);
+}
+
+dc_status_t
+dc_context_get_resource (dc_context_t *context, dc_resource_t type, const dc_resource_vtable_t *vtable, void **resource)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (type >= DC_RESOURCE_MAX || vtable == NULL || resource == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (context == NULL)
+		return vtable->create (resource, NULL);
+
+	dc_mutex_lock (context->cache);
+
+	if (context->resources[type] == NULL) {
+		status = vtable->create (&context->resources[type], context);
+		if (status != DC_STATUS_SUCCESS) {
+			context->resources[type] = NULL;
+			goto error_unlock;
+		}
+		context->vtables[type] = vtable;
+	}
+
+	*resource = vtable->ref (context->resources[type]);
+
+error_unlock:
+	dc_mutex_unlock (context->cache);
+	return status;
+}
+
+dc_status_t
+dc_context_set_resource (dc_context_t *context, dc_resource_t type, const dc_resource_vtable_t *vtable, void *resource)
+{
+	if (context == NULL || type >= DC_RESOURCE_MAX || vtable == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (context->cache);
+
+	void *previous = context->resources[type];
+	const dc_resource_vtable_t *pvtable = context->vtables[type];
+
+	context->resources[type] = resource ? vtable->ref (resource) : NULL;
+	context->vtables[type] = vtable;
+
+	dc_mutex_unlock (context->cache);
+
+	// Release the previous object outside the lock, because that may
+	// have to wait for its threads.
+	if (previous)
+		pvtable->unref (previous);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_set_profile_cache (dc_context_t *context, unsigned int enable)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (context->cache);
+	context->profile_cache = enable;
+	if (!enable) {
+		memset (context->profiles, 0, sizeof (context->profiles));
+	}
+	dc_mutex_unlock (context->cache);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_context_profile_t *
+dc_context_profile_find (dc_context_t *context, dc_family_t family, const char *address)
+{
+	for (size_t i = 0; i < NPROFILES; ++i) {
+		dc_context_profile_t *entry = context->profiles + i;
+		if (entry->size && entry->family == family &&
+			strcmp (entry->address, address) == 0) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+int
+dc_context_get_profile (dc_context_t *context, dc_family_t family, const char *address, void *data, size_t size)
+{
+	int found = 0;
+
+	if (context == NULL || address == NULL || data == NULL)
+		return 0;
+
+	dc_mutex_lock (context->cache);
+	if (context->profile_cache) {
+		dc_context_profile_t *entry = dc_context_profile_find (context, family, address);
+		if (entry && entry->size == size) {
+			memcpy (data, entry->data, size);
+			entry->sequence = ++context->sequence;
+			found = 1;
+		}
+	}
+	dc_mutex_unlock (context->cache);
+
+	return found;
+}
+
+void
+dc_context_set_profile (dc_context_t *context, dc_family_t family, const char *address, const void *data, size_t size)
+{
+	if (context == NULL || address == NULL || size > sizeof (context->profiles[0].data))
+		return;
+
+	dc_mutex_lock (context->cache);
+	if (context->profile_cache) {
+		dc_context_profile_t *entry = dc_context_profile_find (context, family, address);
+		if (entry == NULL && size) {
+			// Replace the least recently used entry.
+			entry = context->profiles;
+			for (size_t i = 1; i < NPROFILES; ++i) {
+				if (context->profiles[i].sequence < entry->sequence)
+					entry = context->profiles + i;
+			}
+		}
+
+		if (entry) {
+			memset (entry, 0, sizeof (*entry));
+			if (size) {
+				entry->family = family;
+				strncpy (entry->address, address, sizeof (entry->address) - 1);
+				entry->sequence = ++context->sequence;
+				entry->size = size;
+				memcpy (entry->data, data, size);
+			}
+		}
+	}
+	dc_mutex_unlock (context->cache);
+}
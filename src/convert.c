@@ -0,0 +1,218 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <libdivecomputer/parser.h>
+#include <libdivecomputer/units.h>
+
+/*
+ * Apply the linear transformation y = x * scale + offset to all values
+ * of a column. Missing values (NAN) remain missing. The vector paths
+ * use a separate multiply and add, to get exactly the same results as
+ * the scalar code.
+ */
+static void
+dc_sample_column_transform (double values[], unsigned int count, double scale, double offset)
+{
+	unsigned int i = 0;
+
+	if (values == NULL || (scale == 1.0 && offset == 0.0))
+		return;
+
+#if defined(__SSE2__)
+	__m128d s = _mm_set1_pd (scale);
+	__m128d o = _mm_set1_pd (offset);
+	for (; i + 4 <= count; i += 4) {
+		__m128d a = _mm_loadu_pd (values + i);
+		__m128d b = _mm_loadu_pd (values + i + 2);
+		_mm_storeu_pd (values + i,     _mm_add_pd (_mm_mul_pd (a, s), o));
+		_mm_storeu_pd (values + i + 2, _mm_add_pd (_mm_mul_pd (b, s), o));
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	float64x2_t s = vdupq_n_f64 (scale);
+	float64x2_t o = vdupq_n_f64 (offset);
+	for (; i + 4 <= count; i += 4) {
+		float64x2_t a = vld1q_f64 (values + i);
+		float64x2_t b = vld1q_f64 (values + i + 2);
+		vst1q_f64 (values + i,     vaddq_f64 (vmulq_f64 (a, s), o));
+		vst1q_f64 (values + i + 2, vaddq_f64 (vmulq_f64 (b, s), o));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		values[i] = values[i] * scale + offset;
+	}
+}
+
+dc_status_t
+dc_sample_columns_convert (dc_sample_columns_t *columns, const dc_sample_conversion_t *conversion)
+{
+	if (columns == NULL || conversion == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (conversion->units != DC_UNITS_METRIC &&
+		conversion->units != DC_UNITS_IMPERIAL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned int count = columns->count < columns->capacity ?
+		columns->count : columns->capacity;
+
+	// Depth correction for the water density and atmospheric pressure.
+	// The depth was calculated as (p - atm_ref) / (rho_ref * g), and is
+	// recalculated as (p - atm) / (rho * g).
+	double density_ref = conversion->density_ref;
+	double density = conversion->density;
+	if (density_ref == 0.0 || density == 0.0) {
+		density_ref = density = 1.0;
+	}
+
+	double depthscale = density_ref / density;
+	double depthoffset = 0.0;
+	if (conversion->atmospheric_ref != 0.0 && conversion->atmospheric != 0.0) {
+		double hydrostatic = (conversion->density != 0.0 && conversion->density_ref != 0.0 ?
+			conversion->density : 1025.0) * GRAVITY;
+		depthoffset = (conversion->atmospheric_ref - conversion->atmospheric) * BAR / hydrostatic;
+	}
+
+	if (conversion->units == DC_UNITS_IMPERIAL) {
+		dc_sample_column_transform (columns->depth, count,
+			depthscale / FEET, depthoffset / FEET);
+		dc_sample_column_transform (columns->temperature, count,
+			9.0 / 5.0, 32.0);
+		if (columns->pressure) {
+			for (unsigned int i = 0; i < columns->ntanks; ++i) {
+				dc_sample_column_transform (columns->pressure[i], count,
+					BAR / PSI, 0.0);
+			}
+		}
+	} else {
+		dc_sample_column_transform (columns->depth, count,
+			depthscale, depthoffset);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Interpolate a column on the time grid, with a single sweep over the
+ * input rows. The input times must be non-decreasing.
+ */
+static void
+dc_sample_column_resample (const unsigned int time[], const double values[], unsigned int count,
+	unsigned int start, unsigned int interval, double out[], unsigned int n)
+{
+	unsigned int prev = count; // Last value at or before the grid point.
+	unsigned int next = 0;     // First value after the grid point.
+	unsigned int j = 0;
+
+	for (unsigned int k = 0; k < n; ++k) {
+		unsigned int t = start + k * interval;
+
+		while (j < count && time[j] <= t) {
+			if (!isnan (values[j]))
+				prev = j;
+			j++;
+		}
+
+		if (next < j)
+			next = j;
+		while (next < count && isnan (values[next]))
+			next++;
+
+		if (prev < count && time[prev] == t) {
+			out[k] = values[prev];
+		} else if (prev < count && next < count) {
+			double fraction = (double) (t - time[prev]) / (time[next] - time[prev]);
+			out[k] = values[prev] + (values[next] - values[prev]) * fraction;
+		} else {
+			out[k] = NAN;
+		}
+	}
+}
+
+dc_status_t
+dc_sample_columns_resample (const dc_sample_columns_t *input, unsigned int interval, dc_sample_columns_t *output)
+{
+	if (input == NULL || output == NULL || input->time == NULL || interval == 0)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned int count = input->count < input->capacity ?
+		input->count : input->capacity;
+
+	// The number of grid rows, from the first up to the last time.
+	unsigned int start = count ? input->time[0] : 0;
+	for (unsigned int i = 1; i < count; ++i) {
+		if (input->time[i] < input->time[i - 1])
+			return DC_STATUS_INVALIDARGS;
+	}
+	output->count = count ? (input->time[count - 1] - start) / interval + 1 : 0;
+
+	unsigned int n = output->count < output->capacity ?
+		output->count : output->capacity;
+
+	if (output->time) {
+		for (unsigned int k = 0; k < n; ++k)
+			output->time[k] = start + k * interval;
+	}
+
+	if (input->depth && output->depth)
+		dc_sample_column_resample (input->time, input->depth, count, start, interval, output->depth, n);
+	if (input->temperature && output->temperature)
+		dc_sample_column_resample (input->time, input->temperature, count, start, interval, output->temperature, n);
+	if (input->ppo2 && output->ppo2)
+		dc_sample_column_resample (input->time, input->ppo2, count, start, interval, output->ppo2, n);
+	if (input->pressure && output->pressure) {
+		for (unsigned int i = 0; i < input->ntanks && i < output->ntanks; ++i) {
+			if (input->pressure[i] && output->pressure[i])
+				dc_sample_column_resample (input->time, input->pressure[i], count, start, interval, output->pressure[i], n);
+		}
+	}
+
+	// Snap the events to the nearest grid row.
+	unsigned int ecount = input->events == NULL || count == 0 ? 0 :
+		input->ecount < input->ecapacity ? input->ecount : input->ecapacity;
+	output->ecount = ecount;
+	if (output->events) {
+		for (unsigned int i = 0; i < ecount && i < output->ecapacity; ++i) {
+			dc_sample_event_t event = input->events[i];
+			unsigned int row = event.sample < count ? event.sample : count - 1;
+			unsigned int k = (input->time[row] - start + interval / 2) / interval;
+			event.sample = k < output->count ? k : output->count - 1;
+			output->events[i] = event;
+		}
+	}
+
+	if (output->count > output->capacity ||
+		(output->events && output->ecount > output->ecapacity)) {
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
@@ -30,6 +30,7 @@
 #include "array.h"
 #include "ringbuffer.h"
 #include "rbstream.h"
+#include "retry.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &cressi_edy_device_vtable)
 
@@ -71,10 +72,12 @@ static const dc_device_vtable_t cressi_edy_device_vtable = {
 	DC_FAMILY_CRESSI_EDY,
 	cressi_edy_device_set_fingerprint, /* set_fingerprint */
 	cressi_edy_device_read, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	cressi_edy_device_dump, /* dump */
 	cressi_edy_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	cressi_edy_device_close /* close */
 };
 
@@ -150,22 +153,18 @@ cressi_edy_packet (cressi_edy_device_t *device, const unsigned char command[], u
 	return DC_STATUS_SUCCESS;
 }
 
+static const dc_retry_policy_t cressi_edy_retry = {MAXRETRIES, 300, DC_DIRECTION_INPUT, DC_RETRY_BACKOFF};
+
 static dc_status_t
 cressi_edy_transfer (cressi_edy_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, int trailer)
 {
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &cressi_edy_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = cressi_edy_packet (device, command, csize, answer, asize, trailer)) != DC_STATUS_SUCCESS) {
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
+		if (!dc_retry_again (&retry, device->iostream, rc))
 			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 300);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -25,6 +25,7 @@
 
 #include "cressi_goa.h"
 #include "context-private.h"
+#include "iostream-private.h"
 #include "device-private.h"
 #include "checksum.h"
 #include "array.h"
@@ -65,10 +66,12 @@ static const dc_device_vtable_t cressi_goa_device_vtable = {
 	DC_FAMILY_CRESSI_GOA,
 	cressi_goa_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	cressi_goa_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -201,6 +204,16 @@ cressi_goa_device_download (cressi_goa_device_t *device, dc_buffer_t *buffer, dc
 			return status;
 		}
 
+		// Send the ack byte to the device. The device sends the next
+		// packet only after the ack, so it's sent before processing
+		// the packet. There is no retransmission, so a corrupt packet
+		// aborts the download anyway.
+		status = dc_iostream_write (device->iostream, ack, sizeof(ack), NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to send the ack byte.");
+			return status;
+		}
+
 		// Verify the checksum of the packet.
 		unsigned short crc = array_uint16_le (packet + sizeof(packet) - 2);
 		unsigned short ccrc = checksum_crc16_ccitt (packet + 3, sizeof(packet) - 5, 0x0000);
@@ -209,16 +222,14 @@ cressi_goa_device_download (cressi_goa_device_t *device, dc_buffer_t *buffer, dc
 			return DC_STATUS_PROTOCOL;
 		}
 
-		// Send the ack byte to the device.
-		status = dc_iostream_write (device->iostream, ack, sizeof(ack), NULL);
-		if (status != DC_STATUS_SUCCESS) {
-			ERROR (abstract->context, "Failed to send the ack byte.");
-			return status;
-		}
-
-		// Get the total size from the first data packet.
+		// Get the total size from the first data packet, and reserve
+		// the space for the entire payload.
 		if (nbytes == 0) {
 			size += array_uint16_le (packet + 3);
+			if (!dc_buffer_reserve (buffer, size - skip)) {
+				ERROR (abstract->context, "Insufficient buffer space available.");
+				return DC_STATUS_NOMEMORY;
+			}
 		}
 
 		// Calculate the payload size of the packet.
@@ -321,6 +332,9 @@ cressi_goa_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t
 	device->iostream = iostream;
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
 
+	// Request a short BLE connection interval.
+	dc_iostream_ble_prefer (iostream, 0, BLE_INTERVAL_MIN, 0);
+
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_iostream_configure (device->iostream, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -124,10 +124,10 @@ cressi_goa_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsign
 
 	const unsigned char *data = abstract->data;
 
-	if (!parser->cached) {
+	if (!parser->cached && type == DC_FIELD_MAXDEPTH) {
 		sample_statistics_t statistics = SAMPLE_STATISTICS_INITIALIZER;
-		dc_status_t rc = cressi_goa_parser_samples_foreach (
-			abstract, sample_statistics_cb, &statistics);
+		dc_status_t rc = sample_statistics_walk (abstract,
+			cressi_goa_parser_samples_foreach, &statistics);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
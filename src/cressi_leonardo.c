@@ -29,6 +29,7 @@
 #include "checksum.h"
 #include "array.h"
 #include "ringbuffer.h"
+#include "retry.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &cressi_leonardo_device_vtable)
 
@@ -62,16 +63,15 @@ static const dc_device_vtable_t cressi_leonardo_device_vtable = {
 	DC_FAMILY_CRESSI_LEONARDO,
 	cressi_leonardo_device_set_fingerprint, /* set_fingerprint */
 	cressi_leonardo_device_read, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	cressi_leonardo_device_dump, /* dump */
 	cressi_leonardo_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
-static dc_status_t
-cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static void
 cressi_leonardo_make_ascii (const unsigned char raw[], unsigned int rsize, unsigned char ascii[], unsigned int asize)
 {
@@ -138,24 +138,18 @@ cressi_leonardo_packet (cressi_leonardo_device_t *device, const unsigned char co
 	return DC_STATUS_SUCCESS;
 }
 
+static const dc_retry_policy_t cressi_leonardo_retry = {MAXRETRIES, 100, DC_DIRECTION_INPUT, DC_RETRY_BACKOFF};
+
 static dc_status_t
 cressi_leonardo_transfer (cressi_leonardo_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &cressi_leonardo_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = cressi_leonardo_packet (device, command, csize, answer, asize)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
+		if (!dc_retry_again (&retry, device->iostream, rc))
 			return rc;
-
-		// Discard any garbage bytes.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
 	}
 
 	return rc;
@@ -409,7 +403,7 @@ cressi_leonardo_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 	return rc;
 }
 
-static dc_status_t
+dc_status_t
 cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	cressi_leonardo_device_t *device = (cressi_leonardo_device_t *) abstract;
@@ -497,14 +491,7 @@ cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[]
 			}
 
 			// Copy the profile data.
-			if (address + length > RB_PROFILE_END) {
-				unsigned int len_a = RB_PROFILE_END - address;
-				unsigned int len_b = length - len_a;
-				memcpy (buffer + RB_LOGBOOK_SIZE, data + address, len_a);
-				memcpy (buffer + RB_LOGBOOK_SIZE + len_a, data + RB_PROFILE_BEGIN, len_b);
-			} else {
-				memcpy (buffer + RB_LOGBOOK_SIZE, data + address, length);
-			}
+			ringbuffer_copy (buffer + RB_LOGBOOK_SIZE, data, address, length, RB_PROFILE_BEGIN, RB_PROFILE_END);
 
 			remaining -= length + 4;
 		} else {
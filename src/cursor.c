@@ -0,0 +1,231 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/buffer.h>
+
+#include "cache.h"
+#include "context-private.h"
+#include "parser-private.h"
+
+/* Number of time samples between two checkpoints. */
+#define INTERVAL 64
+
+typedef struct dc_parser_sample_checkpoint_t {
+	unsigned int time;
+	size_t offset;
+} dc_parser_sample_checkpoint_t;
+
+struct dc_parser_sample_cursor_t {
+	dc_context_t *context;
+	dc_buffer_t *buffer;
+	size_t offset;
+	/* Checkpoint index */
+	dc_parser_sample_checkpoint_t *checkpoints;
+	unsigned int ncheckpoints;
+	unsigned int maxcheckpoints;
+	/* State of the first pass */
+	unsigned int ntimes;
+	int error;
+};
+
+static void
+dc_parser_sample_cursor_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_parser_sample_cursor_t *cursor = (dc_parser_sample_cursor_t *) userdata;
+	unsigned char record[DC_PARSER_CACHE_RECORD_MAX];
+
+	if (cursor->error)
+		return;
+
+	// Add a checkpoint at the start of every INTERVAL sample rows.
+	if (type == DC_SAMPLE_TIME && (cursor->ntimes++ % INTERVAL) == 0) {
+		if (cursor->ncheckpoints == cursor->maxcheckpoints) {
+			unsigned int capacity = cursor->maxcheckpoints ? cursor->maxcheckpoints * 2 : 16;
+			dc_parser_sample_checkpoint_t *checkpoints = (dc_parser_sample_checkpoint_t *) realloc (cursor->checkpoints, capacity * sizeof (*checkpoints));
+			if (checkpoints == NULL) {
+				cursor->error = 1;
+				return;
+			}
+			cursor->checkpoints = checkpoints;
+			cursor->maxcheckpoints = capacity;
+		}
+
+		cursor->checkpoints[cursor->ncheckpoints].time = value.time;
+		cursor->checkpoints[cursor->ncheckpoints].offset = dc_buffer_get_size (cursor->buffer);
+		cursor->ncheckpoints++;
+	}
+
+	size_t n = dc_parser_cache_sample_encode (record, type, &value);
+	if (!dc_buffer_append (cursor->buffer, record, n) ||
+		(type == DC_SAMPLE_VENDOR && value.vendor.size &&
+		!dc_buffer_append (cursor->buffer, (const unsigned char *) value.vendor.data, value.vendor.size))) {
+		cursor->error = 1;
+	}
+}
+
+dc_status_t
+dc_parser_sample_cursor_new (dc_parser_sample_cursor_t **out, dc_parser_t *parser)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parser_sample_cursor_t *cursor = NULL;
+
+	if (out == NULL || parser == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Allocate memory.
+	cursor = (dc_parser_sample_cursor_t *) malloc (sizeof (dc_parser_sample_cursor_t));
+	if (cursor == NULL) {
+		ERROR (parser->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	cursor->context = parser->context;
+	cursor->offset = 0;
+	cursor->checkpoints = NULL;
+	cursor->ncheckpoints = 0;
+	cursor->maxcheckpoints = 0;
+	cursor->ntimes = 0;
+	cursor->error = 0;
+
+	cursor->buffer = dc_buffer_new (0);
+	if (cursor->buffer == NULL) {
+		ERROR (parser->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	// Decode all samples once, and build the checkpoint index.
+	status = dc_parser_samples_foreach (parser, dc_parser_sample_cursor_cb, cursor);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_free_buffer;
+	}
+
+	if (cursor->error) {
+		ERROR (parser->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free_buffer;
+	}
+
+	*out = cursor;
+
+	return DC_STATUS_SUCCESS;
+
+error_free_buffer:
+	free (cursor->checkpoints);
+	dc_buffer_free (cursor->buffer);
+error_free:
+	free (cursor);
+	return status;
+}
+
+dc_status_t
+dc_parser_sample_cursor_seek (dc_parser_sample_cursor_t *cursor, unsigned int time)
+{
+	if (cursor == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	const unsigned char *data = dc_buffer_get_data (cursor->buffer);
+	size_t size = dc_buffer_get_size (cursor->buffer);
+
+	// Find the last checkpoint at or before the requested time.
+	unsigned int lo = 0, hi = cursor->ncheckpoints;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (cursor->checkpoints[mid].time <= time)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0) {
+		// Before the first sample row.
+		cursor->offset = 0;
+		return DC_STATUS_SUCCESS;
+	}
+
+	// Resume from the checkpoint, up to the first sample row at or
+	// after the requested time.
+	size_t offset = cursor->checkpoints[lo - 1].offset;
+	while (offset < size) {
+		dc_sample_type_t type;
+		dc_sample_value_t value;
+		size_t n = dc_parser_cache_sample_decode (data + offset, size - offset, &type, &value);
+		if (n == 0)
+			break;
+
+		if (type == DC_SAMPLE_TIME && value.time >= time)
+			break;
+
+		offset += n;
+	}
+
+	cursor->offset = offset;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parser_sample_cursor_next (dc_parser_sample_cursor_t *cursor, dc_sample_type_t *type, dc_sample_value_t *value)
+{
+	dc_sample_type_t t;
+	dc_sample_value_t v;
+
+	if (cursor == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	const unsigned char *data = dc_buffer_get_data (cursor->buffer);
+	size_t size = dc_buffer_get_size (cursor->buffer);
+
+	if (cursor->offset >= size)
+		return DC_STATUS_DONE;
+
+	memset (&v, 0, sizeof (v));
+	size_t n = dc_parser_cache_sample_decode (data + cursor->offset, size - cursor->offset, &t, &v);
+	if (n == 0) {
+		ERROR (cursor->context, "Invalid sample record.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	cursor->offset += n;
+
+	if (type)
+		*type = t;
+	if (value)
+		*value = v;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parser_sample_cursor_free (dc_parser_sample_cursor_t *cursor)
+{
+	if (cursor == NULL)
+		return DC_STATUS_SUCCESS;
+
+	free (cursor->checkpoints);
+	dc_buffer_free (cursor->buffer);
+	free (cursor);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h> // malloc, free
+#include <string.h> // memset
 
 #include <libdivecomputer/custom.h>
 
@@ -27,6 +28,8 @@
 #include "common-private.h"
 #include "context-private.h"
 
+#define MAXLENT 4
+
 static dc_status_t dc_custom_set_timeout (dc_iostream_t *abstract, int timeout);
 static dc_status_t dc_custom_set_break (dc_iostream_t *abstract, unsigned int value);
 static dc_status_t dc_custom_set_dtr (dc_iostream_t *abstract, unsigned int value);
@@ -36,6 +39,8 @@ static dc_status_t dc_custom_get_available (dc_iostream_t *abstract, size_t *val
 static dc_status_t dc_custom_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
 static dc_status_t dc_custom_poll (dc_iostream_t *abstract, int timeout);
 static dc_status_t dc_custom_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
+static dc_status_t dc_custom_read_lend (dc_iostream_t *abstract, const unsigned char **data, size_t *size);
+static dc_status_t dc_custom_read_return (dc_iostream_t *abstract, const unsigned char *data);
 static dc_status_t dc_custom_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
 static dc_status_t dc_custom_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size);
 static dc_status_t dc_custom_flush (dc_iostream_t *abstract);
@@ -48,6 +53,9 @@ typedef struct dc_custom_t {
 	dc_iostream_t base;
 	/* Internal state. */
 	dc_custom_cbs_t callbacks;
+	dc_custom_lend_cbs_t lend;
+	const void *lent[MAXLENT];
+	unsigned int nlent;
 	void *userdata;
 } dc_custom_t;
 
@@ -61,12 +69,16 @@ static const dc_iostream_vtable_t dc_custom_vtable = {
 	dc_custom_get_available, /* get_available */
 	dc_custom_configure, /* configure */
 	dc_custom_poll, /* poll */
+	NULL, /* get_fd */
 	dc_custom_read, /* read */
+	dc_custom_read_lend, /* read_lend */
+	dc_custom_read_return, /* read_return */
 	dc_custom_write, /* write */
 	dc_custom_ioctl, /* ioctl */
 	dc_custom_flush, /* flush */
 	dc_custom_purge, /* purge */
 	dc_custom_sleep, /* sleep */
+	NULL, /* interrupt */
 	dc_custom_close, /* close */
 };
 
@@ -88,6 +100,8 @@ dc_custom_open (dc_iostream_t **out, dc_context_t *context, dc_transport_t trans
 	}
 
 	custom->callbacks = *callbacks;
+	memset (&custom->lend, 0, sizeof (custom->lend));
+	custom->nlent = 0;
 	custom->userdata = userdata;
 
 	*out = (dc_iostream_t *) custom;
@@ -95,6 +109,25 @@ dc_custom_open (dc_iostream_t **out, dc_context_t *context, dc_transport_t trans
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_custom_set_lend (dc_iostream_t *abstract, const dc_custom_lend_cbs_t *callbacks)
+{
+	dc_custom_t *custom = (dc_custom_t *) abstract;
+
+	if (!dc_iostream_isinstance (abstract, &dc_custom_vtable))
+		return DC_STATUS_INVALIDARGS;
+
+	if (callbacks == NULL || callbacks->read_lend == NULL || callbacks->read_return == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (custom->nlent)
+		return DC_STATUS_INVALIDARGS;
+
+	custom->lend = *callbacks;
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dc_custom_set_timeout (dc_iostream_t *abstract, int timeout)
 {
@@ -194,6 +227,47 @@ dc_custom_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 	return custom->callbacks.read (custom->userdata, data, size, actual);
 }
 
+static dc_status_t
+dc_custom_read_lend (dc_iostream_t *abstract, const unsigned char **data, size_t *size)
+{
+	dc_custom_t *custom = (dc_custom_t *) abstract;
+
+	// Without a free slot, the caller falls back to a regular read.
+	if (custom->lend.read_lend == NULL || custom->nlent >= MAXLENT)
+		return DC_STATUS_UNSUPPORTED;
+
+	const void *buffer = NULL;
+	dc_status_t status = custom->lend.read_lend (custom->userdata, &buffer, size);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	// Keep track of the buffer, to return it on close.
+	custom->lent[custom->nlent++] = buffer;
+
+	*data = (const unsigned char *) buffer;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_custom_read_return (dc_iostream_t *abstract, const unsigned char *data)
+{
+	dc_custom_t *custom = (dc_custom_t *) abstract;
+
+	unsigned int i = 0;
+	while (i < custom->nlent && custom->lent[i] != data)
+		i++;
+
+	if (i == custom->nlent) {
+		ERROR (abstract->context, "Unknown lent buffer.");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	custom->lent[i] = custom->lent[--custom->nlent];
+
+	return custom->lend.read_return (custom->userdata, data);
+}
+
 static dc_status_t
 dc_custom_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual)
 {
@@ -252,10 +326,19 @@ dc_custom_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
 static dc_status_t
 dc_custom_close (dc_iostream_t *abstract)
 {
+	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
-	if (custom->callbacks.close == NULL)
-		return DC_STATUS_SUCCESS;
+	// Return the buffers that are still lent.
+	while (custom->nlent) {
+		dc_status_t rc = custom->lend.read_return (custom->userdata, custom->lent[--custom->nlent]);
+		dc_status_set_error (&status, rc);
+	}
+
+	if (custom->callbacks.close) {
+		dc_status_t rc = custom->callbacks.close (custom->userdata);
+		dc_status_set_error (&status, rc);
+	}
 
-	return custom->callbacks.close (custom->userdata);
+	return status;
 }
@@ -24,6 +24,7 @@
 #endif
 
 #include <time.h>
+#include <limits.h>
 
 #include <libdivecomputer/datetime.h>
 
@@ -44,62 +45,56 @@ dc_localtime_r (const time_t *t, struct tm *tm)
 #endif
 }
 
-static struct tm *
-dc_gmtime_r (const time_t *t, struct tm *tm)
+/*
+ * Conversion between a date in the proleptic Gregorian calendar and the
+ * number of days since 1970-01-01, with the eras of 400 years (146097
+ * days) after which the calendar repeats itself. Both directions are
+ * plain integer arithmetic, without any calls into the C library, and
+ * they work for all dates, including the ones before 1970. Unlike the
+ * gmtime_r and timegm functions, they don't need the lock of the time
+ * zone data either.
+ */
+static dc_ticks_t
+dc_days_from_civil (dc_ticks_t y, unsigned int m, unsigned int d)
 {
-#ifdef HAVE_GMTIME_R
-	return gmtime_r (t, tm);
-#else
-	struct tm *p = gmtime (t);
-	if (p == NULL)
-		return NULL;
-
-	if (tm)
-		*tm = *p;
+	y -= (m <= 2);
+	dc_ticks_t era = (y >= 0 ? y : y - 399) / 400;
+	unsigned int yoe = (unsigned int) (y - era * 400);
+	unsigned int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
 
-	return tm;
-#endif
+static dc_ticks_t
+dc_civil_from_days (dc_ticks_t z, unsigned int *m, unsigned int *d)
+{
+	z += 719468;
+	dc_ticks_t era = (z >= 0 ? z : z - 146096) / 146097;
+	unsigned int doe = (unsigned int) (z - era * 146097);
+	unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned int mp = (5 * doy + 2) / 153;
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp < 10 ? mp + 3 : mp - 9;
+	return era * 400 + yoe + (*m <= 2);
 }
 
-static time_t
-dc_timegm (struct tm *tm)
+/*
+ * Out of range fields are normalized, in the same way as timegm does.
+ */
+static dc_ticks_t
+dc_timegm (const struct tm *tm)
 {
-#if defined(HAVE_TIMEGM)
-	return timegm (tm);
-#elif defined (HAVE__MKGMTIME)
-	return _mkgmtime (tm);
-#else
-	static const unsigned int mdays[] = {
-		0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
-	};
-
-	if (tm == NULL ||
-		tm->tm_mon  < 0 || tm->tm_mon  > 11 ||
-		tm->tm_mday < 1 || tm->tm_mday > 31 ||
-		tm->tm_hour < 0 || tm->tm_hour > 23 ||
-		tm->tm_min  < 0 || tm->tm_min  > 59 ||
-		tm->tm_sec  < 0 || tm->tm_sec  > 60)
-		return (time_t) -1;
-
-	/* Number of leap days since 1970-01-01. */
-	int year = tm->tm_year + 1900 - (tm->tm_mon < 2);
-	int leapdays =
-		((year / 4) - (year / 100) + (year / 400)) -
-		((1969 / 4) - (1969 / 100) + (1969 / 400));
-
-	time_t result = 0;
-	result += (tm->tm_year - 70) * 365;
-	result += leapdays;
-	result += mdays[tm->tm_mon];
-	result += tm->tm_mday - 1;
-	result *= 24;
-	result += tm->tm_hour;
-	result *= 60;
-	result += tm->tm_min;
-	result *= 60;
-	result += tm->tm_sec;
-	return result;
-#endif
+	dc_ticks_t year = (dc_ticks_t) tm->tm_year + 1900 + tm->tm_mon / 12;
+	int month = tm->tm_mon % 12;
+	if (month < 0) {
+		month += 12;
+		year--;
+	}
+
+	dc_ticks_t days = dc_days_from_civil (year, month + 1, 1) + tm->tm_mday - 1;
+
+	return ((days * 24 + tm->tm_hour) * 60 + tm->tm_min) * 60 + tm->tm_sec;
 }
 
 dc_ticks_t
@@ -122,12 +117,7 @@ dc_datetime_localtime (dc_datetime_t *result,
 #ifdef HAVE_STRUCT_TM_TM_GMTOFF
 	offset = tm.tm_gmtoff;
 #else
-	struct tm tmp = tm;
-	time_t t_local = dc_timegm (&tmp);
-	if (t_local == (time_t) -1)
-		return NULL;
-
-	offset = t_local - t;
+	offset = dc_timegm (&tm) - t;
 #endif
 
 	if (result) {
@@ -147,19 +137,25 @@ dc_datetime_t *
 dc_datetime_gmtime (dc_datetime_t *result,
                     dc_ticks_t ticks)
 {
-	time_t t = ticks;
+	dc_ticks_t days = ticks / 86400;
+	int seconds = ticks % 86400;
+	if (seconds < 0) {
+		seconds += 86400;
+		days--;
+	}
 
-	struct tm tm;
-	if (dc_gmtime_r (&t, &tm) == NULL)
+	unsigned int month = 0, day = 0;
+	dc_ticks_t year = dc_civil_from_days (days, &month, &day);
+	if (year < INT_MIN || year > INT_MAX)
 		return NULL;
 
 	if (result) {
-		result->year = tm.tm_year + 1900;
-		result->month = tm.tm_mon + 1;
-		result->day = tm.tm_mday;
-		result->hour = tm.tm_hour;
-		result->minute = tm.tm_min;
-		result->second = tm.tm_sec;
+		result->year = year;
+		result->month = month;
+		result->day = day;
+		result->hour = seconds / 3600;
+		result->minute = seconds / 60 % 60;
+		result->second = seconds % 60;
 		result->timezone = 0;
 	}
 
@@ -181,9 +177,7 @@ dc_datetime_mktime (const dc_datetime_t *dt)
 	tm.tm_sec = dt->second;
 	tm.tm_isdst = 0;
 
-	time_t t = dc_timegm (&tm);
-	if (t == (time_t) -1)
-		return t;
+	dc_ticks_t t = dc_timegm (&tm);
 
 	if (dt->timezone != DC_TIMEZONE_NONE) {
 		t -= dt->timezone;
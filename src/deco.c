@@ -0,0 +1,439 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libdivecomputer/deco.h>
+
+#include "context-private.h"
+
+#define NCOMPARTMENTS DC_DECO_NCOMPARTMENTS
+
+#define SURFACE      1.01325 // bar
+#define WATERVAPOUR  0.0627  // bar
+#define AIR_N2       0.79
+#define AIR_O2       0.21
+#define NDL_MAX      99      // minutes
+
+/*
+ * The ZH-L16C coefficients, for compartment 1b. The half-times are in
+ * minutes.
+ */
+static const double n2_halftime[NCOMPARTMENTS] = {
+	5.0, 8.0, 12.5, 18.5, 27.0, 38.3, 54.3, 77.0,
+	109.0, 146.0, 187.0, 239.0, 305.0, 390.0, 498.0, 635.0};
+static const double n2_a[NCOMPARTMENTS] = {
+	1.1696, 1.0000, 0.8618, 0.7562, 0.6200, 0.5043, 0.4410, 0.4000,
+	0.3750, 0.3500, 0.3295, 0.3065, 0.2835, 0.2610, 0.2480, 0.2327};
+static const double n2_b[NCOMPARTMENTS] = {
+	0.5578, 0.6514, 0.7222, 0.7825, 0.8126, 0.8434, 0.8693, 0.8910,
+	0.9092, 0.9222, 0.9319, 0.9403, 0.9477, 0.9544, 0.9602, 0.9653};
+static const double he_halftime[NCOMPARTMENTS] = {
+	1.88, 3.02, 4.72, 6.99, 10.21, 14.48, 20.53, 29.11,
+	41.20, 55.19, 70.69, 90.34, 115.29, 147.42, 188.24, 240.03};
+static const double he_a[NCOMPARTMENTS] = {
+	1.6189, 1.3830, 1.1919, 1.0458, 0.9220, 0.8205, 0.7305, 0.6502,
+	0.5950, 0.5545, 0.5333, 0.5189, 0.5181, 0.5176, 0.5172, 0.5119};
+static const double he_b[NCOMPARTMENTS] = {
+	0.4770, 0.5747, 0.6527, 0.7223, 0.7582, 0.7957, 0.8279, 0.8553,
+	0.8757, 0.8903, 0.8997, 0.9073, 0.9122, 0.9171, 0.9217, 0.9267};
+
+/*
+ * The NOAA single exposure limits (minutes), for every 0.1 bar of oxygen
+ * partial pressure from 0.6 to 1.6 bar.
+ */
+static const double cns_limit[] = {
+	720, 570, 450, 360, 300, 240, 210, 180, 150, 120, 45};
+
+/*
+ * The compartments are stored as separate arrays, and the exponential
+ * factors are cached for the last duration. Profiles are almost always
+ * sampled at a fixed interval, so the update of all compartments is a
+ * plain loop of multiplications and additions, which the compiler can
+ * vectorize.
+ */
+struct dc_deco_t {
+	dc_context_t *context;
+	double gflow, gfhigh;
+	double surface;
+	double depth;
+	double anchor;
+	double fn2, fhe, fo2;
+	double cns, otu;
+	double n2[NCOMPARTMENTS];
+	double he[NCOMPARTMENTS];
+	double n2_tau[NCOMPARTMENTS];
+	double he_tau[NCOMPARTMENTS];
+	unsigned int duration;
+	double n2_factor[NCOMPARTMENTS];
+	double he_factor[NCOMPARTMENTS];
+	double n2_minute[NCOMPARTMENTS];
+	double he_minute[NCOMPARTMENTS];
+};
+
+static double
+dc_deco_pressure (const dc_deco_t *deco, double depth)
+{
+	return deco->surface + depth / 10.0;
+}
+
+/*
+ * Get the lowest tolerated ambient pressure of all compartments, for the
+ * given gradient factor.
+ */
+static double
+dc_deco_tolerance (const double n2[], const double he[], double gf)
+{
+	double tolerance = 0.0;
+
+	for (unsigned int i = 0; i < NCOMPARTMENTS; ++i) {
+		double p = n2[i] + he[i];
+		if (p <= 0.0)
+			continue;
+
+		double a = (n2_a[i] * n2[i] + he_a[i] * he[i]) / p;
+		double b = (n2_b[i] * n2[i] + he_b[i] * he[i]) / p;
+		double value = (p - a * gf) / (gf / b + 1.0 - gf);
+		if (value > tolerance)
+			tolerance = value;
+	}
+
+	return tolerance;
+}
+
+/*
+ * Get the ceiling, as an ambient pressure. The gradient factor changes
+ * linearly from the low value at the deepest ceiling of the dive (the
+ * anchor) to the high value at the surface.
+ */
+static double
+dc_deco_ceiling (const dc_deco_t *deco, const double n2[], const double he[], double anchor)
+{
+	// Without a ceiling for the high value, a direct ascent is possible.
+	double ceiling = dc_deco_tolerance (n2, he, deco->gfhigh);
+	if (ceiling <= deco->surface || anchor <= deco->surface)
+		return ceiling;
+
+	ceiling = dc_deco_tolerance (n2, he, deco->gflow);
+	for (unsigned int i = 0; i < 4; ++i) {
+		double gf = deco->gfhigh;
+		if (ceiling > deco->surface) {
+			gf += (deco->gflow - deco->gfhigh) * (ceiling - deco->surface) / (anchor - deco->surface);
+			if (gf < deco->gflow)
+				gf = deco->gflow;
+		}
+		ceiling = dc_deco_tolerance (n2, he, gf);
+	}
+
+	return ceiling;
+}
+
+static void
+dc_deco_oxygen (dc_deco_t *deco, double pressure, double minutes)
+{
+	double ppo2 = deco->fo2 * pressure;
+	if (ppo2 <= 0.5)
+		return;
+
+	deco->otu += minutes * pow ((ppo2 - 0.5) / 0.5, 0.83);
+
+	if (ppo2 < 0.6)
+		return;
+
+	// Interpolate the limit, and extrapolate above 1.6 bar.
+	unsigned int n = sizeof (cns_limit) / sizeof (cns_limit[0]);
+	double x = (ppo2 - 0.6) * 10.0;
+	unsigned int i = (unsigned int) x;
+	if (i > n - 2)
+		i = n - 2;
+	double limit = cns_limit[i] + (cns_limit[i + 1] - cns_limit[i]) * (x - i);
+	if (limit < 1.0)
+		limit = 1.0;
+
+	deco->cns += minutes / limit;
+}
+
+dc_status_t
+dc_deco_new (dc_deco_t **out, dc_context_t *context, unsigned int gflow, unsigned int gfhigh)
+{
+	dc_deco_t *deco = NULL;
+
+	if (out == NULL || gflow == 0 || gflow > gfhigh || gfhigh > 100)
+		return DC_STATUS_INVALIDARGS;
+
+	deco = (dc_deco_t *) malloc (sizeof (dc_deco_t));
+	if (deco == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	deco->context = context;
+	deco->gflow = gflow / 100.0;
+	deco->gfhigh = gfhigh / 100.0;
+
+	for (unsigned int i = 0; i < NCOMPARTMENTS; ++i) {
+		deco->n2_tau[i] = n2_halftime[i] / M_LN2;
+		deco->he_tau[i] = he_halftime[i] / M_LN2;
+		deco->n2_minute[i] = exp (-1.0 / deco->n2_tau[i]);
+		deco->he_minute[i] = exp (-1.0 / deco->he_tau[i]);
+	}
+
+	deco->duration = 0;
+	memset (deco->n2_factor, 0, sizeof (deco->n2_factor));
+	memset (deco->he_factor, 0, sizeof (deco->he_factor));
+
+	dc_deco_reset (deco, 0.0);
+
+	*out = deco;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_deco_reset (dc_deco_t *deco, double surface)
+{
+	if (deco == NULL || surface < 0.0)
+		return DC_STATUS_INVALIDARGS;
+
+	deco->surface = surface > 0.0 ? surface : SURFACE;
+	deco->depth = 0.0;
+	deco->anchor = 0.0;
+	deco->fn2 = AIR_N2;
+	deco->fhe = 0.0;
+	deco->fo2 = AIR_O2;
+	deco->cns = 0.0;
+	deco->otu = 0.0;
+
+	for (unsigned int i = 0; i < NCOMPARTMENTS; ++i) {
+		deco->n2[i] = (deco->surface - WATERVAPOUR) * AIR_N2;
+		deco->he[i] = 0.0;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_deco_set_gasmix (dc_deco_t *deco, const dc_gasmix_t *gasmix)
+{
+	if (deco == NULL || gasmix == NULL ||
+		gasmix->oxygen < 0.0 || gasmix->helium < 0.0 ||
+		gasmix->oxygen + gasmix->helium > 1.0)
+		return DC_STATUS_INVALIDARGS;
+
+	deco->fo2 = gasmix->oxygen;
+	deco->fhe = gasmix->helium;
+	deco->fn2 = 1.0 - gasmix->oxygen - gasmix->helium;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_deco_update (dc_deco_t *deco, double depth, unsigned int duration)
+{
+	if (deco == NULL || depth < 0.0)
+		return DC_STATUS_INVALIDARGS;
+
+	if (duration == 0) {
+		deco->depth = depth;
+		return DC_STATUS_SUCCESS;
+	}
+
+	double t = duration / 60.0;
+
+	if (duration != deco->duration) {
+		for (unsigned int i = 0; i < NCOMPARTMENTS; ++i) {
+			deco->n2_factor[i] = exp (-t / deco->n2_tau[i]);
+			deco->he_factor[i] = exp (-t / deco->he_tau[i]);
+		}
+		deco->duration = duration;
+	}
+
+	// The inspired pressure changes linearly with the depth (Schreiner).
+	double begin = dc_deco_pressure (deco, deco->depth) - WATERVAPOUR;
+	double end = dc_deco_pressure (deco, depth) - WATERVAPOUR;
+	double n2_begin = begin * deco->fn2, n2_rate = (end - begin) * deco->fn2 / t;
+	double he_begin = begin * deco->fhe, he_rate = (end - begin) * deco->fhe / t;
+
+	for (unsigned int i = 0; i < NCOMPARTMENTS; ++i) {
+		double n2_tau = deco->n2_tau[i];
+		double he_tau = deco->he_tau[i];
+		deco->n2[i] = n2_begin + n2_rate * (t - n2_tau) -
+			(n2_begin - deco->n2[i] - n2_rate * n2_tau) * deco->n2_factor[i];
+		deco->he[i] = he_begin + he_rate * (t - he_tau) -
+			(he_begin - deco->he[i] - he_rate * he_tau) * deco->he_factor[i];
+	}
+
+	dc_deco_oxygen (deco, (dc_deco_pressure (deco, deco->depth) + dc_deco_pressure (deco, depth)) / 2.0, t);
+
+	deco->depth = depth;
+
+	// Remember the deepest ceiling for the gradient factors.
+	double ceiling = dc_deco_tolerance (deco->n2, deco->he, deco->gflow);
+	if (ceiling > deco->anchor)
+		deco->anchor = ceiling;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_deco_get_status (dc_deco_t *deco, dc_deco_status_t *status)
+{
+	if (deco == NULL || status == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	double ceiling = dc_deco_ceiling (deco, deco->n2, deco->he, deco->anchor);
+
+	status->ceiling = ceiling > deco->surface ? (ceiling - deco->surface) * 10.0 : 0.0;
+	status->cns = deco->cns;
+	status->otu = deco->otu;
+	for (unsigned int i = 0; i < NCOMPARTMENTS; ++i)
+		status->tissues[i] = deco->n2[i] + deco->he[i];
+
+	// Stay at the current depth, one minute at a time, until a direct
+	// ascent is no longer possible.
+	status->ndl = 0;
+	if (ceiling <= deco->surface) {
+		double n2[NCOMPARTMENTS], he[NCOMPARTMENTS];
+		memcpy (n2, deco->n2, sizeof (n2));
+		memcpy (he, deco->he, sizeof (he));
+
+		double inspired = dc_deco_pressure (deco, deco->depth) - WATERVAPOUR;
+		double n2_inspired = inspired * deco->fn2;
+		double he_inspired = inspired * deco->fhe;
+
+		unsigned int minutes = 0;
+		while (minutes < NDL_MAX) {
+			for (unsigned int i = 0; i < NCOMPARTMENTS; ++i) {
+				n2[i] = n2_inspired + (n2[i] - n2_inspired) * deco->n2_minute[i];
+				he[i] = he_inspired + (he[i] - he_inspired) * deco->he_minute[i];
+			}
+
+			if (dc_deco_tolerance (n2, he, deco->gfhigh) > deco->surface)
+				break;
+
+			minutes++;
+		}
+
+		status->ndl = minutes * 60;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+typedef struct dc_deco_profile_t {
+	dc_deco_t *deco;
+	dc_deco_callback_t callback;
+	void *userdata;
+	dc_gasmix_t *gasmixes;
+	unsigned int ngasmixes;
+	unsigned int time;
+	unsigned int previous;
+} dc_deco_profile_t;
+
+static void
+dc_deco_sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_deco_profile_t *profile = (dc_deco_profile_t *) userdata;
+	dc_deco_t *deco = profile->deco;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		profile->time = value.time;
+		break;
+	case DC_SAMPLE_DEPTH:
+		if (value.depth < 0.0)
+			break;
+		dc_deco_update (deco, value.depth,
+			profile->time > profile->previous ? profile->time - profile->previous : 0);
+		profile->previous = profile->time;
+		if (profile->callback) {
+			dc_deco_status_t status;
+			dc_deco_get_status (deco, &status);
+			profile->callback (profile->time, value.depth, &status, profile->userdata);
+		}
+		break;
+	case DC_SAMPLE_GASMIX:
+		if (value.gasmix < profile->ngasmixes)
+			dc_deco_set_gasmix (deco, profile->gasmixes + value.gasmix);
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+dc_deco_process (dc_deco_t *deco, dc_parser_t *parser, dc_deco_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (deco == NULL || parser == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	double atmospheric = 0.0;
+	if (dc_parser_get_field (parser, DC_FIELD_ATMOSPHERIC, 0, &atmospheric) != DC_STATUS_SUCCESS ||
+		atmospheric < 0.0)
+		atmospheric = 0.0;
+
+	dc_deco_reset (deco, atmospheric);
+
+	dc_deco_profile_t profile;
+	profile.deco = deco;
+	profile.callback = callback;
+	profile.userdata = userdata;
+	profile.gasmixes = NULL;
+	profile.ngasmixes = 0;
+	profile.time = 0;
+	profile.previous = 0;
+
+	unsigned int ngasmixes = 0;
+	if (dc_parser_get_field (parser, DC_FIELD_GASMIX_COUNT, 0, &ngasmixes) == DC_STATUS_SUCCESS && ngasmixes) {
+		profile.gasmixes = (dc_gasmix_t *) malloc (ngasmixes * sizeof (dc_gasmix_t));
+		if (profile.gasmixes == NULL) {
+			ERROR (deco->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		for (unsigned int i = 0; i < ngasmixes; ++i) {
+			if (dc_parser_get_field (parser, DC_FIELD_GASMIX, i, profile.gasmixes + i) != DC_STATUS_SUCCESS)
+				break;
+			profile.ngasmixes++;
+		}
+
+		if (profile.ngasmixes)
+			dc_deco_set_gasmix (deco, profile.gasmixes);
+	}
+
+	status = dc_parser_samples_foreach (parser, dc_deco_sample_cb, &profile);
+
+	free (profile.gasmixes);
+
+	return status;
+}
+
+dc_status_t
+dc_deco_free (dc_deco_t *deco)
+{
+	free (deco);
+
+	return DC_STATUS_SUCCESS;
+}
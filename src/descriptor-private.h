@@ -42,6 +42,14 @@ typedef struct dc_usb_params_t {
 int
 dc_descriptor_filter (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata, void *params);
 
+/*
+ * Find the first descriptor with a filter that accepts the device.
+ * Descriptors without a filter can't identify a device, and are
+ * skipped.
+ */
+dc_descriptor_t *
+dc_descriptor_match (dc_transport_t transport, const void *userdata, void *params);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
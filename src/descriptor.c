@@ -25,7 +25,9 @@
 
 #include "descriptor-private.h"
 #include "iterator-private.h"
+#include "registry.h"
 #include "platform.h"
+#include "shared.h"
 
 #define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
 #define C_ARRAY_ITEMSIZE(array) (sizeof *(array))
@@ -36,17 +38,7 @@
 		values, \
 		C_ARRAY_SIZE(values) - isnullterminated, \
 		C_ARRAY_ITEMSIZE(values), \
-		match, \
-		NULL, NULL, 0)
-
-#define DC_FILTER_INTERNAL_WITH_PARAMS(key, values, isnullterminated, match, params_dst, params_src) \
-	dc_filter_internal( \
-		key, \
-		values, \
-		C_ARRAY_SIZE(values) - isnullterminated, \
-		C_ARRAY_ITEMSIZE(values), \
-		match, \
-		params_dst, params_src, sizeof *(params_src))
+		match)
 
 typedef int (*dc_match_t)(const void *, const void *);
 
@@ -64,6 +56,7 @@ static int dc_filter_mclean (dc_transport_t transport, const void *userdata, voi
 static int dc_filter_atomic (dc_transport_t transport, const void *userdata, void *params);
 
 static dc_status_t dc_descriptor_iterator_next (dc_iterator_t *iterator, void *item);
+static int dc_descriptor_isenabled (const dc_descriptor_t *descriptor);
 
 struct dc_descriptor_t {
 	const char *vendor;
@@ -77,6 +70,7 @@ struct dc_descriptor_t {
 typedef struct dc_descriptor_iterator_t {
 	dc_iterator_t base;
 	size_t current;
+	unsigned int transports;
 } dc_descriptor_iterator_t;
 
 static const dc_iterator_vtable_t dc_descriptor_iterator_vtable = {
@@ -402,6 +396,31 @@ static const dc_descriptor_t g_descriptors[] = {
 	{"Liquivision", "Kaon", DC_FAMILY_LIQUIVISION_LYNX, 3, DC_TRANSPORT_SERIAL, NULL},
 };
 
+#define NDESCRIPTORS C_ARRAY_SIZE (g_descriptors)
+#define NWORDS       ((NDESCRIPTORS + 31) / 32)
+#define NTRANSPORTS  6
+
+/*
+ * Compact indexes of the descriptor table, built once on first use, and
+ * shared by all contexts as process-wide shared data.
+ * The bitmaps contain only the descriptors of the enabled backends,
+ * such that a scan over a set of transports is a few bitwise operations
+ * per 32 descriptors, instead of a look at every entry (and a lookup of
+ * its backend). The sorted arrays contain the table indexes of the
+ * enabled descriptors, in the original table order for equal keys.
+ */
+typedef struct dc_descriptor_index_t {
+	unsigned int enabled[NWORDS];
+	unsigned int filter[NWORDS];
+	unsigned int transport[NTRANSPORTS][NWORDS];
+	unsigned short model[NDESCRIPTORS];   // Sorted on family and model.
+	unsigned short product[NDESCRIPTORS]; // Sorted on product name.
+	size_t count;
+} dc_descriptor_index_t;
+
+static dc_descriptor_index_t g_index;
+static dc_shared_t g_index_shared = DC_SHARED_INIT;
+
 static int
 dc_match_name (const void *key, const void *value)
 {
@@ -429,15 +448,6 @@ dc_match_devname (const void *key, const void *value)
 	return strncmp (k, v, strlen (v)) == 0;
 }
 
-static int
-dc_match_usb (const void *key, const void *value)
-{
-	const dc_usb_desc_t *k = (const dc_usb_desc_t *) key;
-	const dc_usb_desc_t *v = (const dc_usb_desc_t *) value;
-
-	return k->vid == v->vid && k->pid == v->pid;
-}
-
 static int
 dc_match_number_with_prefix (const void *key, const void *value)
 {
@@ -476,16 +486,13 @@ dc_match_oceanic (const void *key, const void *value)
 }
 
 static int
-dc_filter_internal (const void *key, const void *values, size_t count, size_t size, dc_match_t match, void *params_dst, const void *params_src, size_t params_size)
+dc_filter_internal (const void *key, const void *values, size_t count, size_t size, dc_match_t match)
 {
 	if (key == NULL)
 		return 0;
 
 	for (size_t i = 0; i < count; ++i) {
 		if (match (key, (const unsigned char *) values + i * size)) {
-			if (params_src && params_dst) {
-				memcpy (params_dst, params_src, params_size);
-			}
 			return 1;
 		}
 	}
@@ -493,6 +500,63 @@ dc_filter_internal (const void *key, const void *values, size_t count, size_t si
 	return count == 0;
 }
 
+typedef struct dc_usb_index_t {
+	dc_usb_desc_t desc;
+	dc_family_t type;
+	const dc_usb_params_t *params;
+} dc_usb_index_t;
+
+static const dc_usb_params_t usb_params_atomic = {
+	0, 0x82, 0x02
+};
+
+/*
+ * All known USB and USB HID devices, sorted on the vendor and product
+ * id, such that a device can be found with a binary search, instead of
+ * a linear scan of each backend specific list.
+ */
+static const dc_usb_index_t g_usb[] = {
+	{{0x0471, 0x0888}, DC_FAMILY_ATOMICS_COBALT,  &usb_params_atomic}, // Atomic Aquatics Cobalt
+	{{0x1493, 0x0030}, DC_FAMILY_SUUNTO_EONSTEEL, NULL}, // Eon Steel
+	{{0x1493, 0x0033}, DC_FAMILY_SUUNTO_EONSTEEL, NULL}, // Eon Core
+	{{0x1493, 0x0035}, DC_FAMILY_SUUNTO_EONSTEEL, NULL}, // D5
+	{{0x2e6c, 0x3201}, DC_FAMILY_UWATEC_SMART,    NULL}, // G2
+	{{0x2e6c, 0x3211}, DC_FAMILY_UWATEC_SMART,    NULL}, // G2 Console
+	{{0x2e6c, 0x4201}, DC_FAMILY_UWATEC_SMART,    NULL}, // G2 HUD
+	{{0xc251, 0x2006}, DC_FAMILY_UWATEC_SMART,    NULL}, // Aladin Square
+};
+
+static int
+dc_usb_index_cmp (const void *key, const void *value)
+{
+	const dc_usb_desc_t *k = (const dc_usb_desc_t *) key;
+	const dc_usb_index_t *v = (const dc_usb_index_t *) value;
+
+	if (k->vid != v->desc.vid)
+		return k->vid < v->desc.vid ? -1 : 1;
+	if (k->pid != v->desc.pid)
+		return k->pid < v->desc.pid ? -1 : 1;
+	return 0;
+}
+
+static int
+dc_filter_usb (const void *key, dc_family_t type, void *params)
+{
+	if (key == NULL)
+		return 0;
+
+	const dc_usb_index_t *entry = (const dc_usb_index_t *) bsearch (key,
+		g_usb, C_ARRAY_SIZE (g_usb), C_ARRAY_ITEMSIZE (g_usb), dc_usb_index_cmp);
+	if (entry == NULL || entry->type != type)
+		return 0;
+
+	if (params && entry->params) {
+		memcpy (params, entry->params, sizeof (dc_usb_params_t));
+	}
+
+	return 1;
+}
+
 static const char * const rfcomm[] = {
 #if defined (__linux__)
 	"/dev/rfcomm",
@@ -511,12 +575,6 @@ static int dc_filter_uwatec (dc_transport_t transport, const void *userdata, voi
 		"UWATEC Galileo",
 		"UWATEC Galileo Sol",
 	};
-	static const dc_usb_desc_t usbhid[] = {
-		{0x2e6c, 0x3201}, // G2
-		{0x2e6c, 0x3211}, // G2 Console
-		{0x2e6c, 0x4201}, // G2 HUD
-		{0xc251, 0x2006}, // Aladin Square
-	};
 	static const char * const bluetooth[] = {
 		"G2",
 		"Aladin",
@@ -528,7 +586,7 @@ static int dc_filter_uwatec (dc_transport_t transport, const void *userdata, voi
 	if (transport == DC_TRANSPORT_IRDA) {
 		return DC_FILTER_INTERNAL (userdata, irda, 0, dc_match_name);
 	} else if (transport == DC_TRANSPORT_USBHID) {
-		return DC_FILTER_INTERNAL (userdata, usbhid, 0, dc_match_usb);
+		return dc_filter_usb (userdata, DC_FAMILY_UWATEC_SMART, NULL);
 	} else if (transport == DC_TRANSPORT_BLE) {
 		return DC_FILTER_INTERNAL (userdata, bluetooth, 0, dc_match_name);
 	}
@@ -538,11 +596,6 @@ static int dc_filter_uwatec (dc_transport_t transport, const void *userdata, voi
 
 static int dc_filter_suunto (dc_transport_t transport, const void *userdata, void *params)
 {
-	static const dc_usb_desc_t usbhid[] = {
-		{0x1493, 0x0030}, // Eon Steel
-		{0x1493, 0x0033}, // Eon Core
-		{0x1493, 0x0035}, // D5
-	};
 	static const char * const bluetooth[] = {
 		"EON Steel",
 		"EON Core",
@@ -550,7 +603,7 @@ static int dc_filter_suunto (dc_transport_t transport, const void *userdata, voi
 	};
 
 	if (transport == DC_TRANSPORT_USBHID) {
-		return DC_FILTER_INTERNAL (userdata, usbhid, 0, dc_match_usb);
+		return dc_filter_usb (userdata, DC_FAMILY_SUUNTO_EONSTEEL, NULL);
 	} else if (transport == DC_TRANSPORT_BLE) {
 		return DC_FILTER_INTERNAL (userdata, bluetooth, 0, dc_match_prefix);
 	}
@@ -676,23 +729,135 @@ static int dc_filter_mclean(dc_transport_t transport, const void *userdata, void
 
 static int dc_filter_atomic (dc_transport_t transport, const void *userdata, void *params)
 {
-	static const dc_usb_desc_t usb[] = {
-		{0x0471, 0x0888}, // Atomic Aquatics Cobalt
-	};
-
-	static const dc_usb_params_t usb_params = {
-		0, 0x82, 0x02
-	};
-
 	if (transport == DC_TRANSPORT_USB) {
-		return DC_FILTER_INTERNAL_WITH_PARAMS (userdata, usb, 0, dc_match_usb, params, &usb_params);
+		return dc_filter_usb (userdata, DC_FAMILY_ATOMICS_COBALT, params);
 	}
 
 	return 1;
 }
 
-dc_status_t
-dc_descriptor_iterator (dc_iterator_t **out)
+static int
+dc_descriptor_model_cmp (const void *a, const void *b)
+{
+	unsigned int i = *(const unsigned short *) a;
+	unsigned int j = *(const unsigned short *) b;
+	const dc_descriptor_t *x = &g_descriptors[i];
+	const dc_descriptor_t *y = &g_descriptors[j];
+
+	if (x->type != y->type)
+		return (unsigned int) x->type < (unsigned int) y->type ? -1 : 1;
+	if (x->model != y->model)
+		return x->model < y->model ? -1 : 1;
+	return i < j ? -1 : (i > j);
+}
+
+static int
+dc_descriptor_product_cmp (const void *a, const void *b)
+{
+	unsigned int i = *(const unsigned short *) a;
+	unsigned int j = *(const unsigned short *) b;
+
+	int rc = strcasecmp (g_descriptors[i].product, g_descriptors[j].product);
+	if (rc != 0)
+		return rc;
+	return i < j ? -1 : (i > j);
+}
+
+static dc_status_t
+dc_descriptor_index_build (const void **data)
+{
+	dc_descriptor_index_t *index = &g_index;
+
+	for (size_t i = 0; i < NDESCRIPTORS; ++i) {
+		const dc_descriptor_t *descriptor = &g_descriptors[i];
+		if (!dc_descriptor_isenabled (descriptor))
+			continue;
+
+		unsigned int bit = 1u << (i % 32);
+		index->enabled[i / 32] |= bit;
+		if (descriptor->filter)
+			index->filter[i / 32] |= bit;
+		for (unsigned int t = 0; t < NTRANSPORTS; ++t) {
+			if (descriptor->transports & (1u << t))
+				index->transport[t][i / 32] |= bit;
+		}
+
+		index->model[index->count] = i;
+		index->product[index->count] = i;
+		index->count++;
+	}
+
+	qsort (index->model, index->count, sizeof (index->model[0]), dc_descriptor_model_cmp);
+	qsort (index->product, index->count, sizeof (index->product[0]), dc_descriptor_product_cmp);
+
+	*data = index;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static const dc_descriptor_index_t *
+dc_descriptor_index (void)
+{
+	// The index is built in static storage, so this can't fail.
+	const void *index = &g_index;
+	dc_shared_get (&g_index_shared, dc_descriptor_index_build, &index);
+	return (const dc_descriptor_index_t *) index;
+}
+
+/*
+ * The bitmap word with the enabled descriptors of any of the transports.
+ * A zero mask selects all enabled descriptors.
+ */
+static unsigned int
+dc_descriptor_index_word (const dc_descriptor_index_t *index, unsigned int transports, size_t n)
+{
+	if (transports == 0)
+		return index->enabled[n];
+
+	unsigned int word = 0;
+	for (unsigned int t = 0; t < NTRANSPORTS; ++t) {
+		if (transports & (1u << t))
+			word |= index->transport[t][n];
+	}
+
+	return word;
+}
+
+/*
+ * Find the first descriptor, starting at the given table index, in the
+ * bitmap of the transports and the optional extra bitmap. Returns
+ * NDESCRIPTORS if there is none.
+ */
+static size_t
+dc_descriptor_index_next (const dc_descriptor_index_t *index, unsigned int transports, const unsigned int *mask, size_t start)
+{
+	if (start >= NDESCRIPTORS)
+		return NDESCRIPTORS;
+
+	size_t n = start / 32;
+	unsigned int word = dc_descriptor_index_word (index, transports, n) & (~0u << (start % 32));
+	if (mask)
+		word &= mask[n];
+
+	while (word == 0) {
+		if (++n >= NWORDS)
+			return NDESCRIPTORS;
+		word = dc_descriptor_index_word (index, transports, n);
+		if (mask)
+			word &= mask[n];
+	}
+
+	size_t i = n * 32;
+	while ((word & 1) == 0) {
+		word >>= 1;
+		i++;
+	}
+
+	return i;
+}
+
+static dc_status_t
+dc_descriptor_iterator_create (dc_iterator_t **out, unsigned int transports)
 {
 	dc_descriptor_iterator_t *iterator = NULL;
 
@@ -704,29 +869,149 @@ dc_descriptor_iterator (dc_iterator_t **out)
 		return DC_STATUS_NOMEMORY;
 
 	iterator->current = 0;
+	iterator->transports = transports;
 
 	*out = (dc_iterator_t *) iterator;
 
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_descriptor_iterator (dc_iterator_t **out)
+{
+	return dc_descriptor_iterator_create (out, 0);
+}
+
+dc_status_t
+dc_descriptor_iterator_transport (dc_iterator_t **out, unsigned int transports)
+{
+	if (transports == DC_TRANSPORT_NONE)
+		return DC_STATUS_INVALIDARGS;
+
+	return dc_descriptor_iterator_create (out, transports);
+}
+
+/*
+ * Binary search in the model index for the first enabled descriptor
+ * with the family and at least the model number.
+ */
+static size_t
+dc_descriptor_index_model (const dc_descriptor_index_t *index, dc_family_t family, unsigned int model)
+{
+	size_t lo = 0, hi = index->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const dc_descriptor_t *descriptor = &g_descriptors[index->model[mid]];
+		if ((unsigned int) descriptor->type < (unsigned int) family ||
+			(descriptor->type == family && descriptor->model < model))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * The explicit cast from a const to a non-const pointer is safe here. The
+ * public interface doesn't support write access, and therefore descriptor
+ * objects are always read-only. However, the cast allows to return a direct
+ * reference to the entries in the table, avoiding the overhead of
+ * allocating (and freeing) memory for a deep copy.
+ */
+static dc_descriptor_t *
+dc_descriptor_entry (size_t i)
+{
+	return (dc_descriptor_t *) &g_descriptors[i];
+}
+
+dc_status_t
+dc_descriptor_find (dc_descriptor_t **out, dc_family_t family, unsigned int model)
+{
+	const dc_descriptor_index_t *index = dc_descriptor_index ();
+	size_t first = NDESCRIPTORS;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	size_t i = dc_descriptor_index_model (index, family, model);
+	if (i < index->count &&
+		g_descriptors[index->model[i]].type == family &&
+		g_descriptors[index->model[i]].model == model) {
+		first = index->model[i];
+	} else {
+		// Without an exact match, the first one of the family in the
+		// table is returned, which is not necessarily the one with the
+		// lowest model number.
+		for (i = dc_descriptor_index_model (index, family, 0); i < index->count; ++i) {
+			if (g_descriptors[index->model[i]].type != family)
+				break;
+			if (index->model[i] < first)
+				first = index->model[i];
+		}
+	}
+
+	if (first >= NDESCRIPTORS)
+		return DC_STATUS_NODEVICE;
+
+	*out = dc_descriptor_entry (first);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_descriptor_find_name (dc_descriptor_t **out, const char *vendor, const char *product)
+{
+	const dc_descriptor_index_t *index = dc_descriptor_index ();
+
+	if (out == NULL || product == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Binary search for the first descriptor with the product name.
+	size_t lo = 0, hi = index->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strcasecmp (g_descriptors[index->product[mid]].product, product) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	// The descriptors with the same product name are in table order.
+	for (size_t i = lo; i < index->count; ++i) {
+		const dc_descriptor_t *descriptor = &g_descriptors[index->product[i]];
+		if (strcasecmp (descriptor->product, product) != 0)
+			break;
+
+		if (vendor == NULL || strcasecmp (descriptor->vendor, vendor) == 0) {
+			*out = dc_descriptor_entry (index->product[i]);
+			return DC_STATUS_SUCCESS;
+		}
+	}
+
+	return DC_STATUS_NODEVICE;
+}
+
+static int
+dc_descriptor_isenabled (const dc_descriptor_t *descriptor)
+{
+	return dc_backend_find (descriptor->type) != NULL;
+}
+
 static dc_status_t
 dc_descriptor_iterator_next (dc_iterator_t *abstract, void *out)
 {
 	dc_descriptor_iterator_t *iterator = (dc_descriptor_iterator_t *) abstract;
 	dc_descriptor_t **item = (dc_descriptor_t **) out;
 
-	if (iterator->current >= C_ARRAY_SIZE (g_descriptors))
+	// The descriptors of the backends left out of the build, and those
+	// of other transports, are not in the bitmaps.
+	iterator->current = dc_descriptor_index_next (dc_descriptor_index (),
+		iterator->transports, NULL, iterator->current);
+	if (iterator->current >= NDESCRIPTORS)
 		return DC_STATUS_DONE;
 
-	/*
-	 * The explicit cast from a const to a non-const pointer is safe here. The
-	 * public interface doesn't support write access, and therefore descriptor
-	 * objects are always read-only. However, the cast allows to return a direct
-	 * reference to the entries in the table, avoiding the overhead of
-	 * allocating (and freeing) memory for a deep copy.
-	 */
-	*item = (dc_descriptor_t *) &g_descriptors[iterator->current++];
+	*item = dc_descriptor_entry (iterator->current++);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -782,6 +1067,26 @@ dc_descriptor_get_transports (dc_descriptor_t *descriptor)
 	return descriptor->transports;
 }
 
+dc_descriptor_t *
+dc_descriptor_match (dc_transport_t transport, const void *userdata, void *params)
+{
+	const dc_descriptor_index_t *index = dc_descriptor_index ();
+
+	if (transport == DC_TRANSPORT_NONE)
+		return NULL;
+
+	for (size_t i = dc_descriptor_index_next (index, transport, index->filter, 0);
+		i < NDESCRIPTORS;
+		i = dc_descriptor_index_next (index, transport, index->filter, i + 1)) {
+		const dc_descriptor_t *descriptor = &g_descriptors[i];
+		if (descriptor->filter (transport, userdata, params)) {
+			return dc_descriptor_entry (i);
+		}
+	}
+
+	return NULL;
+}
+
 int
 dc_descriptor_filter (dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata, void *params)
 {
@@ -28,6 +28,7 @@
 #include <libdivecomputer/device.h>
 
 #include "common-private.h"
+#include "timer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,12 +49,43 @@ struct dc_device_t {
 	unsigned int event_mask;
 	dc_event_callback_t event_callback;
 	void *event_userdata;
+	// Progress event coalescing.
+	unsigned int progress_interval;
+	unsigned int progress_delta;
+	unsigned int progress_current;
+	unsigned int progress_maximum;
+	dc_usecs_t progress_time;
+	dc_timer_t *progress_timer;
 	// Cancellation support.
 	dc_cancel_callback_t cancel_callback;
 	void *cancel_userdata;
 	// Cached events for the parsers.
 	dc_event_devinfo_t devinfo;
 	dc_event_clock_t clock;
+	int have_devinfo;
+	// Persistent fingerprints.
+	dc_fingerprint_store_t *store;
+	// Download journal, and the state of the active download.
+	dc_journal_t *journal;
+	struct device_foreach_data_t *foreach;
+	// Download limits.
+	unsigned int limit_dives;
+	int limit_have_since;
+	dc_ticks_t limit_since;
+	// Page cache for the memory reads.
+	struct dc_pagecache_t *cache;
+	// Statistics events.
+	dc_iostream_t *iostream;
+	dc_event_phase_t phase;
+	unsigned int stats_interval;
+	int stats_started;
+	dc_timer_t *stats_timer;
+	dc_usecs_t stats_start;
+	dc_usecs_t stats_time;
+	dc_iostream_stats_t stats_first;
+	dc_iostream_stats_t stats_last;
+	unsigned int stats_current;
+	double stats_rate;
 };
 
 struct dc_device_vtable_t {
@@ -65,6 +97,8 @@ struct dc_device_vtable_t {
 
 	dc_status_t (*read) (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size);
 
+	dc_status_t (*read_multi) (dc_device_t *device, const dc_device_range_t ranges[], unsigned int count);
+
 	dc_status_t (*write) (dc_device_t *device, unsigned int address, const unsigned char data[], unsigned int size);
 
 	dc_status_t (*dump) (dc_device_t *device, dc_buffer_t *buffer);
@@ -73,6 +107,8 @@ struct dc_device_vtable_t {
 
 	dc_status_t (*timesync) (dc_device_t *device, const dc_datetime_t *datetime);
 
+	dc_status_t (*keepalive) (dc_device_t *device);
+
 	dc_status_t (*close) (dc_device_t *device);
 };
 
@@ -91,9 +127,47 @@ device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 int
 device_is_cancelled (dc_device_t *device);
 
+/*
+ * Report the phase of the transfer for the statistics events. Without
+ * a hint from the backend, the handshake ends with the first progress
+ * or device info event, and the rest is reported as the logbook phase.
+ */
+void
+device_set_phase (dc_device_t *device, dc_event_phase_t phase);
+
+/*
+ * Check whether a dive was already delivered by an interrupted download,
+ * based on its fingerprint. The backends can use this to skip the
+ * transfer of the dive.
+ */
+int
+device_journal_skip (dc_device_t *device, const unsigned char fingerprint[], unsigned int size);
+
+/*
+ * Check the download limits for the next dive, before its profile is
+ * downloaded. The count is the number of dives already selected for
+ * the download, and the datetime is the local time of the dive, from
+ * the logbook header (or NULL if unknown). Returns non-zero if the dive,
+ * and all older dives, are outside the limits.
+ */
+int
+device_limits_reached (dc_device_t *device, unsigned int count, const dc_datetime_t *datetime);
+
+/*
+ * Get the memory image of a device opened with dc_device_image_open.
+ * The image remains valid as long as the device is open, so the dives
+ * extracted from it don't need to be copied. Returns zero for all other
+ * devices.
+ */
+int
+device_image_get (dc_device_t *device, const unsigned char **data, unsigned int *size);
+
 dc_status_t
 device_dump_read (dc_device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize);
 
+dc_status_t
+device_dump_read_adaptive (dc_device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize, unsigned int maxsize);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -23,45 +23,24 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "suunto_d9.h"
-#include "suunto_eon.h"
-#include "suunto_eonsteel.h"
-#include "suunto_solution.h"
-#include "suunto_vyper2.h"
-#include "suunto_vyper.h"
-#include "reefnet_sensus.h"
-#include "reefnet_sensuspro.h"
-#include "reefnet_sensusultra.h"
-#include "uwatec_aladin.h"
-#include "uwatec_memomouse.h"
-#include "uwatec_smart.h"
-#include "oceanic_atom2.h"
-#include "oceanic_veo250.h"
-#include "oceanic_vtpro.h"
-#include "mares_darwin.h"
-#include "mares_iconhd.h"
-#include "mares_nemo.h"
-#include "mares_puck.h"
-#include "hw_frog.h"
-#include "hw_ostc.h"
-#include "hw_ostc3.h"
-#include "cressi_edy.h"
-#include "cressi_leonardo.h"
-#include "cressi_goa.h"
-#include "zeagle_n2ition3.h"
-#include "atomics_cobalt.h"
-#include "shearwater_petrel.h"
-#include "shearwater_predator.h"
-#include "diverite_nitekq.h"
-#include "citizen_aqualand.h"
-#include "divesystem_idive.h"
-#include "cochran_commander.h"
-#include "tecdiving_divecomputereu.h"
-#include "mclean_extreme.h"
-#include "liquivision_lynx.h"
+#include <libdivecomputer/parser.h>
 
 #include "device-private.h"
+#include "registry.h"
 #include "context-private.h"
+#include "journal.h"
+#include "pagecache.h"
+#include "array.h"
+#include "timer.h"
+#include "allocator.h"
+#include "trace.h"
+
+#define DUMP_BATCH 16
+
+#define ADAPTIVE_MAXRETRIES 3
+#define ADAPTIVE_MAXLATENCY 1000000 /* us */
+#define ADAPTIVE_GROWTH     4
+#define ADAPTIVE_PURGEDELAY 100 /* ms */
 
 dc_device_t *
 dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
@@ -72,7 +51,7 @@ dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
 	assert(vtable->size >= sizeof(dc_device_t));
 
 	// Allocate memory.
-	device = (dc_device_t *) malloc (vtable->size);
+	device = (dc_device_t *) dc_malloc (vtable->size);
 	if (device == NULL) {
 		ERROR (context, "Failed to allocate memory.");
 		return device;
@@ -86,11 +65,40 @@ dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
 	device->event_callback = NULL;
 	device->event_userdata = NULL;
 
+	device->progress_interval = 0;
+	device->progress_delta = 0;
+	device->progress_current = 0;
+	device->progress_maximum = 0;
+	device->progress_time = 0;
+	device->progress_timer = NULL;
+
 	device->cancel_callback = NULL;
 	device->cancel_userdata = NULL;
 
 	memset (&device->devinfo, 0, sizeof (device->devinfo));
 	memset (&device->clock, 0, sizeof (device->clock));
+	device->have_devinfo = 0;
+
+	device->store = NULL;
+	device->journal = NULL;
+	device->foreach = NULL;
+	device->cache = NULL;
+
+	device->limit_dives = 0;
+	device->limit_have_since = 0;
+	device->limit_since = 0;
+
+	device->iostream = NULL;
+	device->phase = DC_PHASE_HANDSHAKE;
+	device->stats_interval = 1000;
+	device->stats_started = 0;
+	device->stats_timer = NULL;
+	device->stats_start = 0;
+	device->stats_time = 0;
+	memset (&device->stats_first, 0, sizeof (device->stats_first));
+	memset (&device->stats_last, 0, sizeof (device->stats_last));
+	device->stats_current = 0;
+	device->stats_rate = 0.0;
 
 	return device;
 }
@@ -98,7 +106,13 @@ dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
 void
 dc_device_deallocate (dc_device_t *device)
 {
-	free (device);
+	if (device == NULL)
+		return;
+
+	dc_pagecache_free (device->cache);
+	dc_timer_free (device->stats_timer);
+	dc_timer_free (device->progress_timer);
+	dc_free (device);
 }
 
 dc_status_t
@@ -110,118 +124,13 @@ dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descr
 	if (out == NULL || descriptor == NULL)
 		return DC_STATUS_INVALIDARGS;
 
-	switch (dc_descriptor_get_type (descriptor)) {
-	case DC_FAMILY_SUUNTO_SOLUTION:
-		rc = suunto_solution_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_SUUNTO_EON:
-		rc = suunto_eon_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_SUUNTO_VYPER:
-		rc = suunto_vyper_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_SUUNTO_VYPER2:
-		rc = suunto_vyper2_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_SUUNTO_D9:
-		rc = suunto_d9_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
-		break;
-	case DC_FAMILY_SUUNTO_EONSTEEL:
-		rc = suunto_eonsteel_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
-		break;
-	case DC_FAMILY_UWATEC_ALADIN:
-		rc = uwatec_aladin_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_UWATEC_MEMOMOUSE:
-		rc = uwatec_memomouse_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_UWATEC_SMART:
-		rc = uwatec_smart_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_REEFNET_SENSUS:
-		rc = reefnet_sensus_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_REEFNET_SENSUSPRO:
-		rc = reefnet_sensuspro_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_REEFNET_SENSUSULTRA:
-		rc = reefnet_sensusultra_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_OCEANIC_VTPRO:
-		rc = oceanic_vtpro_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
-		break;
-	case DC_FAMILY_OCEANIC_VEO250:
-		rc = oceanic_veo250_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_OCEANIC_ATOM2:
-		rc = oceanic_atom2_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
-		break;
-	case DC_FAMILY_MARES_NEMO:
-		rc = mares_nemo_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_MARES_PUCK:
-		rc = mares_puck_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_MARES_DARWIN:
-		rc = mares_darwin_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
-		break;
-	case DC_FAMILY_MARES_ICONHD:
-		rc = mares_iconhd_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_HW_OSTC:
-		rc = hw_ostc_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_HW_FROG:
-		rc = hw_frog_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_HW_OSTC3:
-		rc = hw_ostc3_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_CRESSI_EDY:
-		rc = cressi_edy_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_CRESSI_LEONARDO:
-		rc = cressi_leonardo_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_CRESSI_GOA:
-		rc = cressi_goa_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_ZEAGLE_N2ITION3:
-		rc = zeagle_n2ition3_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_ATOMICS_COBALT:
-		rc = atomics_cobalt_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_SHEARWATER_PREDATOR:
-		rc = shearwater_predator_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_SHEARWATER_PETREL:
-		rc = shearwater_petrel_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_DIVERITE_NITEKQ:
-		rc = diverite_nitekq_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_CITIZEN_AQUALAND:
-		rc = citizen_aqualand_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_DIVESYSTEM_IDIVE:
-		rc = divesystem_idive_device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
-		break;
-	case DC_FAMILY_COCHRAN_COMMANDER:
-		rc = cochran_commander_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_TECDIVING_DIVECOMPUTEREU:
-		rc = tecdiving_divecomputereu_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_MCLEAN_EXTREME:
-		rc = mclean_extreme_device_open (&device, context, iostream);
-		break;
-	case DC_FAMILY_LIQUIVISION_LYNX:
-		rc = liquivision_lynx_device_open (&device, context, iostream);
-		break;
-	default:
+	const dc_backend_t *backend = dc_backend_find (dc_descriptor_get_type (descriptor));
+	if (backend == NULL)
 		return DC_STATUS_INVALIDARGS;
-	}
+
+	rc = backend->device_open (&device, context, iostream, dc_descriptor_get_model (descriptor));
+	if (rc == DC_STATUS_SUCCESS && device)
+		device->iostream = iostream;
 
 	*out = device;
 
@@ -268,6 +177,14 @@ dc_device_set_events (dc_device_t *device, unsigned int events, dc_event_callbac
 	if (device == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
+	if ((events & DC_EVENT_STATS) && device->stats_timer == NULL) {
+		dc_status_t status = dc_timer_new (&device->stats_timer);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->context, "Failed to create a timer.");
+			return status;
+		}
+	}
+
 	device->event_mask = events;
 	device->event_callback = callback;
 	device->event_userdata = userdata;
@@ -276,6 +193,178 @@ dc_device_set_events (dc_device_t *device, unsigned int events, dc_event_callbac
 }
 
 
+dc_status_t
+dc_device_set_progress (dc_device_t *device, unsigned int interval, unsigned int permille)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (permille > 1000)
+		return DC_STATUS_INVALIDARGS;
+
+	if (interval && device->progress_timer == NULL) {
+		dc_status_t status = dc_timer_new (&device->progress_timer);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->context, "Failed to create a timer.");
+			return status;
+		}
+	}
+
+	device->progress_interval = interval;
+	device->progress_delta = permille;
+	device->progress_maximum = 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Check whether a progress event should be delivered. The first event,
+ * the final event and every event after a change of the maximum are
+ * always delivered. The others only after the interval has elapsed, or
+ * the progress has increased by the minimum delta.
+ */
+static int
+device_progress_deliver (dc_device_t *device, const dc_event_progress_t *progress)
+{
+	if (device->progress_interval == 0 && device->progress_delta == 0)
+		return 1;
+
+	dc_usecs_t now = 0;
+	if (device->progress_interval)
+		dc_timer_now (device->progress_timer, &now);
+
+	int deliver = 0;
+	if (progress->current >= progress->maximum ||
+		progress->maximum != device->progress_maximum ||
+		progress->current < device->progress_current) {
+		deliver = 1;
+	} else if (device->progress_interval &&
+		now - device->progress_time >= (dc_usecs_t) device->progress_interval * 1000) {
+		deliver = 1;
+	} else if (device->progress_delta &&
+		(unsigned long long) (progress->current - device->progress_current) * 1000 >=
+		(unsigned long long) progress->maximum * device->progress_delta) {
+		deliver = 1;
+	}
+
+	if (deliver) {
+		device->progress_current = progress->current;
+		device->progress_maximum = progress->maximum;
+		device->progress_time = now;
+	}
+
+	return deliver;
+}
+
+
+dc_status_t
+dc_device_set_stats (dc_device_t *device, unsigned int interval)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->stats_interval = interval;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+void
+device_set_phase (dc_device_t *device, dc_event_phase_t phase)
+{
+	if (device == NULL)
+		return;
+
+	device->phase = phase;
+}
+
+
+static void
+device_stats_reset (dc_device_t *device)
+{
+	device->phase = DC_PHASE_HANDSHAKE;
+	device->stats_started = 0;
+}
+
+
+/*
+ * Start the statistics clock, at the start of the transfer.
+ */
+static void
+device_stats_start (dc_device_t *device, const dc_event_progress_t *progress)
+{
+	if (device->stats_started || device->stats_timer == NULL)
+		return;
+
+	dc_timer_now (device->stats_timer, &device->stats_start);
+	device->stats_time = device->stats_start;
+	if (device->iostream)
+		dc_iostream_get_stats (device->iostream, &device->stats_first);
+	device->stats_last = device->stats_first;
+	device->stats_current = progress ? progress->current : 0;
+	device->stats_rate = 0.0;
+	device->stats_started = 1;
+}
+
+static void
+device_stats_emit (dc_device_t *device, const dc_event_progress_t *progress)
+{
+	dc_usecs_t now = 0;
+	dc_timer_now (device->stats_timer, &now);
+
+	int final = progress->current >= progress->maximum;
+	if (!final && now - device->stats_time < (dc_usecs_t) device->stats_interval * 1000)
+		return;
+
+	dc_iostream_stats_t stats = device->stats_last;
+	if (device->iostream)
+		dc_iostream_get_stats (device->iostream, &stats);
+
+	double seconds = (now - device->stats_time) / 1000000.0;
+
+	dc_event_stats_t event;
+	event.phase = device->phase;
+	event.elapsed = (now - device->stats_start) / 1000;
+	event.bytes = 0.0;
+	event.roundtrips = 0.0;
+	event.retries = (stats.timeouts - device->stats_first.timeouts) +
+		(stats.purges - device->stats_first.purges);
+	event.bytes_in = stats.bytes_in - device->stats_first.bytes_in;
+	event.bytes_out = stats.bytes_out - device->stats_first.bytes_out;
+
+	// The progress rate is smoothed, because the progress of several
+	// backends advances in large and irregular steps.
+	if (seconds > 0.0) {
+		event.bytes = ((stats.bytes_in - device->stats_last.bytes_in) +
+			(stats.bytes_out - device->stats_last.bytes_out)) / seconds;
+		event.roundtrips = (stats.writes - device->stats_last.writes) / seconds;
+
+		if (progress->current >= device->stats_current) {
+			double rate = (progress->current - device->stats_current) / seconds;
+			if (device->stats_rate == 0.0)
+				device->stats_rate = rate;
+			else
+				device->stats_rate = 0.3 * rate + 0.7 * device->stats_rate;
+		}
+	}
+
+	if (final) {
+		event.remaining = 0;
+	} else if (progress->maximum == UINT_MAX || device->stats_rate <= 0.0) {
+		event.remaining = UINT_MAX;
+	} else {
+		double remaining = (progress->maximum - progress->current) * 1000.0 / device->stats_rate;
+		event.remaining = remaining < UINT_MAX ? (unsigned int) remaining : UINT_MAX;
+	}
+
+	device->stats_time = now;
+	device->stats_last = stats;
+	device->stats_current = progress->current;
+
+	device->event_callback (device, DC_EVENT_STATS, &event, device->event_userdata);
+}
+
+
 dc_status_t
 dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsigned int size)
 {
@@ -289,6 +378,50 @@ dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsi
 }
 
 
+static void
+device_fingerprint_load (dc_device_t *device)
+{
+	if (device->vtable->set_fingerprint == NULL)
+		return;
+
+	dc_buffer_t *fingerprint = dc_buffer_new (0);
+	if (fingerprint == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		return;
+	}
+
+	// Register the stored fingerprint. Without a stored fingerprint,
+	// the registered fingerprint is cleared.
+	dc_status_t rc = dc_fingerprint_store_get (device->store, device->vtable->type,
+		device->devinfo.model, device->devinfo.serial, fingerprint);
+	if (rc == DC_STATUS_SUCCESS) {
+		rc = device->vtable->set_fingerprint (device,
+			dc_buffer_get_data (fingerprint), dc_buffer_get_size (fingerprint));
+	}
+	if (rc != DC_STATUS_SUCCESS) {
+		WARNING (device->context, "Failed to register the stored fingerprint.");
+	}
+
+	dc_buffer_free (fingerprint);
+}
+
+
+dc_status_t
+dc_device_set_fingerprint_store (dc_device_t *device, dc_fingerprint_store_t *store)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->store = store;
+
+	// The serial number may already be known when the device was opened.
+	if (device->store && device->have_devinfo)
+		device_fingerprint_load (device);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_device_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size)
 {
@@ -298,7 +431,17 @@ dc_device_read (dc_device_t *device, unsigned int address, unsigned char data[],
 	if (device->vtable->read == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return device->vtable->read (device, address, data, size);
+	TRACE3 (device_read_entry, device, address, size);
+
+	dc_status_t status = DC_STATUS_SUCCESS;
+	if (device->cache)
+		status = dc_pagecache_read (device->cache, device, device->vtable->read, address, data, size);
+	else
+		status = device->vtable->read (device, address, data, size);
+
+	TRACE2 (device_read_return, device, status);
+
+	return status;
 }
 
 
@@ -311,10 +454,48 @@ dc_device_write (dc_device_t *device, unsigned int address, const unsigned char
 	if (device->vtable->write == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
+	// Drop the pages even if the write fails, because the memory may
+	// have been partially written.
+	dc_pagecache_invalidate (device->cache, address, size);
+
 	return device->vtable->write (device, address, data, size);
 }
 
 
+dc_status_t
+dc_device_set_cache (dc_device_t *device, unsigned int pagesize, unsigned int npages)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (npages && pagesize == 0)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_pagecache_free (device->cache);
+	device->cache = NULL;
+
+	if (npages == 0)
+		return DC_STATUS_SUCCESS;
+
+	return dc_pagecache_new (&device->cache, device->context, pagesize, npages);
+}
+
+
+dc_status_t
+dc_device_get_cache_stats (dc_device_t *device, dc_device_cache_stats_t *stats)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (stats == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_pagecache_get_stats (device->cache, stats);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_device_dump (dc_device_t *device, dc_buffer_t *buffer)
 {
@@ -329,19 +510,47 @@ dc_device_dump (dc_device_t *device, dc_buffer_t *buffer)
 
 	dc_buffer_clear (buffer);
 
+	device_stats_reset (device);
+
 	return device->vtable->dump (device, buffer);
 }
 
 
 dc_status_t
-device_dump_read (dc_device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize)
+dc_device_read_multi (dc_device_t *device, const dc_device_range_t ranges[], unsigned int count)
 {
 	if (device == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
+	if (ranges == NULL && count)
+		return DC_STATUS_INVALIDARGS;
+
+	if (device->vtable->read_multi)
+		return device->vtable->read_multi (device, ranges, count);
+
 	if (device->vtable->read == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
+	// Fallback to reading the ranges one by one.
+	for (unsigned int i = 0; i < count; ++i) {
+		dc_status_t rc = device->vtable->read (device, ranges[i].address, ranges[i].data, ranges[i].size);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+device_dump_read (dc_device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (device->vtable->read == NULL && device->vtable->read_multi == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
 	// Enable progress notifications.
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
 	progress.maximum = size;
@@ -349,13 +558,27 @@ device_dump_read (dc_device_t *device, unsigned char data[], unsigned int size,
 
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
-		// Calculate the packet size.
-		unsigned int len = size - nbytes;
-		if (len > blocksize)
-			len = blocksize;
-
-		// Read the packet.
-		dc_status_t rc = device->vtable->read (device, nbytes, data + nbytes, len);
+		// Split the next part of the dump into blocks. Without
+		// vectored read support, the blocks are read one by one.
+		dc_device_range_t ranges[DUMP_BATCH];
+		unsigned int count = 0;
+		unsigned int len = 0;
+		while (nbytes + len < size && count < (device->vtable->read_multi ? DUMP_BATCH : 1)) {
+			// Calculate the packet size.
+			unsigned int n = size - nbytes - len;
+			if (n > blocksize)
+				n = blocksize;
+
+			ranges[count].address = nbytes + len;
+			ranges[count].size = n;
+			ranges[count].data = data + nbytes + len;
+			count++;
+
+			len += n;
+		}
+
+		// Read the packets.
+		dc_status_t rc = dc_device_read_multi (device, ranges, count);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
@@ -370,6 +593,277 @@ device_dump_read (dc_device_t *device, unsigned char data[], unsigned int size,
 }
 
 
+static unsigned int
+device_dump_shrink (unsigned int current, unsigned int blocksize)
+{
+	// Halve the size, rounded down to a multiple of the blocksize.
+	unsigned int size = (current / 2 / blocksize) * blocksize;
+	if (size < blocksize)
+		size = blocksize;
+
+	return size;
+}
+
+
+/*
+ * The block size starts at the maximum size, shrinks after transfer
+ * errors or slow blocks, and grows again after a number of successful
+ * blocks. All block sizes are a multiple of the minimum block size.
+ */
+dc_status_t
+device_dump_read_adaptive (dc_device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize, unsigned int maxsize)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_timer_t *timer = NULL;
+
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (device->vtable->read == NULL && device->vtable->read_multi == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (blocksize == 0 || maxsize < blocksize || maxsize % blocksize != 0) {
+		ERROR (device->context, "Invalid block size (%u %u).", blocksize, maxsize);
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	// Without a timer, the block size is adjusted based on errors only.
+	if (dc_timer_new (&timer) != DC_STATUS_SUCCESS) {
+		WARNING (device->context, "Failed to create a timer.");
+		timer = NULL;
+	}
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = size;
+	device_event_emit (device, DC_EVENT_PROGRESS, &progress);
+
+	// Start with the largest block size.
+	unsigned int current = maxsize;
+	unsigned int retries = 0;
+	unsigned int count = 0;
+
+	unsigned int nbytes = 0;
+	while (nbytes < size) {
+		// Calculate the packet size.
+		unsigned int len = size - nbytes;
+		if (len > current)
+			len = current;
+
+		dc_device_range_t range = {nbytes, len, data + nbytes};
+
+		// Read the packet and measure the latency.
+		dc_timer_scope_t scope;
+		dc_timer_scope_begin (&scope, timer);
+		dc_status_t rc = dc_device_read_multi (device, &range, 1);
+		dc_usecs_t elapsed = dc_timer_scope_end (&scope);
+
+		if (rc != DC_STATUS_SUCCESS) {
+			// Only transfer errors are worth retrying.
+			if (rc != DC_STATUS_IO && rc != DC_STATUS_TIMEOUT &&
+				rc != DC_STATUS_PROTOCOL) {
+				status = rc;
+				goto error_free;
+			}
+
+			// Retry with a smaller block size, or give up after too
+			// many failures with the smallest block size.
+			if (current > blocksize) {
+				current = device_dump_shrink (current, blocksize);
+			} else if (retries++ >= ADAPTIVE_MAXRETRIES) {
+				status = rc;
+				goto error_free;
+			}
+
+			// Discard the remainder of the failed answer, to prevent it
+			// from being taken for the answer of the next request.
+			if (device->iostream) {
+				dc_iostream_sleep (device->iostream, ADAPTIVE_PURGEDELAY);
+				dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+			}
+
+			INFO (device->context, "Retrying with block size %u.", current);
+			count = 0;
+			continue;
+		}
+
+		// Update and emit a progress event.
+		progress.current += len;
+		device_event_emit (device, DC_EVENT_PROGRESS, &progress);
+
+		nbytes += len;
+		retries = 0;
+
+		if (elapsed > ADAPTIVE_MAXLATENCY && current > blocksize) {
+			// Shrink the block size when a single block takes too long,
+			// to keep the progress events and cancellation responsive.
+			current = device_dump_shrink (current, blocksize);
+			count = 0;
+		} else if (++count >= ADAPTIVE_GROWTH && current < maxsize) {
+			// Grow the block size again after a number of successful
+			// blocks.
+			current *= 2;
+			if (current > maxsize)
+				current = maxsize;
+			count = 0;
+		}
+	}
+
+error_free:
+	dc_timer_free (timer);
+	return status;
+}
+
+
+dc_status_t
+dc_device_set_journal (dc_device_t *device, dc_journal_t *journal)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->journal = journal;
+
+	return DC_STATUS_SUCCESS;
+}
+
+typedef struct device_foreach_data_t {
+	dc_device_t *device;
+	dc_dive_callback_t callback;
+	void *userdata;
+	dc_buffer_t *fingerprint;
+	int ndives;
+	// Download limits.
+	unsigned int ndelivered;
+	int limited;
+	dc_parser_t *parser;
+} device_foreach_data_t;
+
+static void
+device_foreach_record (device_foreach_data_t *foreach, const unsigned char *fingerprint, unsigned int fsize)
+{
+	// Keep a copy of the most recent fingerprint. Because dives are
+	// downloaded in reverse order, the most recent dive is always the
+	// first dive.
+	if (foreach->ndives++ == 0) {
+		dc_buffer_append (foreach->fingerprint, fingerprint, fsize);
+	}
+}
+
+int
+device_journal_skip (dc_device_t *device, const unsigned char fingerprint[], unsigned int size)
+{
+	if (device == NULL || device->journal == NULL || !device->have_devinfo)
+		return 0;
+
+	if (!dc_journal_contains (device->journal, device->vtable->type,
+		device->devinfo.model, device->devinfo.serial, fingerprint, size))
+		return 0;
+
+	// A skipped dive still counts for the most recent fingerprint.
+	if (device->foreach)
+		device_foreach_record (device->foreach, fingerprint, size);
+
+	return 1;
+}
+
+dc_status_t
+dc_device_set_limits (dc_device_t *device, unsigned int maxdives, const dc_datetime_t *since)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->limit_dives = maxdives;
+	device->limit_have_since = 0;
+	device->limit_since = 0;
+
+	if (since) {
+		// Compare the local time of the dives.
+		dc_datetime_t datetime = *since;
+		datetime.timezone = DC_TIMEZONE_NONE;
+		device->limit_since = dc_datetime_mktime (&datetime);
+		device->limit_have_since = 1;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static int
+device_limits_since (dc_device_t *device, const dc_datetime_t *datetime)
+{
+	dc_datetime_t local = *datetime;
+	local.timezone = DC_TIMEZONE_NONE;
+
+	return dc_datetime_mktime (&local) < device->limit_since;
+}
+
+int
+device_limits_reached (dc_device_t *device, unsigned int count, const dc_datetime_t *datetime)
+{
+	if (device == NULL)
+		return 0;
+
+	// The backend checks the limits itself, so the dives it delivers
+	// don't need to be parsed.
+	if (device->foreach && datetime)
+		device->foreach->limited = 1;
+
+	if (device->limit_dives && count >= device->limit_dives)
+		return 1;
+
+	if (device->limit_have_since && datetime && device_limits_since (device, datetime))
+		return 1;
+
+	return 0;
+}
+
+static int
+device_foreach_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	device_foreach_data_t *foreach = (device_foreach_data_t *) userdata;
+	dc_device_t *device = foreach->device;
+
+	// Don't deliver the dives of an interrupted download again, for the
+	// backends that don't skip them already.
+	if (device_journal_skip (device, fingerprint, fsize))
+		return 1;
+
+	// For the backends without a check on the logbook headers, the date
+	// limit is checked on the downloaded dive. Since the dives arrive
+	// newest first, the download stops at the first older dive.
+	if (device->limit_have_since && !foreach->limited) {
+		dc_datetime_t datetime = {0};
+		if (foreach->parser == NULL &&
+			dc_parser_new (&foreach->parser, device) != DC_STATUS_SUCCESS)
+			foreach->parser = NULL;
+		if (foreach->parser &&
+			dc_parser_set_data (foreach->parser, data, size) == DC_STATUS_SUCCESS &&
+			dc_parser_get_datetime (foreach->parser, &datetime) == DC_STATUS_SUCCESS &&
+			device_limits_since (device, &datetime))
+			return 0;
+	}
+
+	device_foreach_record (foreach, fingerprint, fsize);
+
+	int rc = 1;
+	if (foreach->callback)
+		rc = foreach->callback (data, size, fingerprint, fsize, foreach->userdata);
+
+	if (device->journal && device->have_devinfo) {
+		dc_status_t status = dc_journal_append (device->journal, device->vtable->type,
+			device->devinfo.model, device->devinfo.serial, fingerprint, fsize);
+		if (status != DC_STATUS_SUCCESS) {
+			WARNING (device->context, "Failed to record the dive in the journal.");
+		}
+	}
+
+	// Stop after the maximum number of dives.
+	if (device->limit_dives && ++foreach->ndelivered >= device->limit_dives)
+		return 0;
+
+	return rc;
+}
+
+
 dc_status_t
 dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata)
 {
@@ -379,7 +873,95 @@ dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userd
 	if (device->vtable->foreach == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return device->vtable->foreach (device, callback, userdata);
+	device_stats_reset (device);
+
+	if (device->store == NULL && device->journal == NULL &&
+		device->limit_dives == 0 && !device->limit_have_since)
+		return device->vtable->foreach (device, callback, userdata);
+
+	device_foreach_data_t foreach;
+	foreach.device = device;
+	foreach.callback = callback;
+	foreach.userdata = userdata;
+	foreach.ndives = 0;
+	foreach.ndelivered = 0;
+	foreach.limited = 0;
+	foreach.parser = NULL;
+	foreach.fingerprint = dc_buffer_new (0);
+	if (foreach.fingerprint == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	device->foreach = &foreach;
+	dc_status_t rc = device->vtable->foreach (device, device_foreach_cb, &foreach);
+	device->foreach = NULL;
+
+	// Store the new fingerprint only after a complete download, such that
+	// the next download still contains the dives that were missed.
+	if (rc == DC_STATUS_SUCCESS && device->store && device->have_devinfo && dc_buffer_get_size (foreach.fingerprint)) {
+		dc_status_t status = dc_fingerprint_store_set (device->store, device->vtable->type,
+			device->devinfo.model, device->devinfo.serial,
+			dc_buffer_get_data (foreach.fingerprint), dc_buffer_get_size (foreach.fingerprint));
+		if (status != DC_STATUS_SUCCESS) {
+			WARNING (device->context, "Failed to store the fingerprint.");
+		}
+	}
+
+	// A complete download no longer needs the journal.
+	if (rc == DC_STATUS_SUCCESS && device->journal && device->have_devinfo) {
+		dc_status_t status = dc_journal_clear (device->journal, device->vtable->type,
+			device->devinfo.model, device->devinfo.serial);
+		if (status != DC_STATUS_SUCCESS) {
+			WARNING (device->context, "Failed to clear the journal.");
+		}
+	}
+
+	dc_parser_destroy (foreach.parser);
+	dc_buffer_free (foreach.fingerprint);
+
+	return rc;
+}
+
+static unsigned long long
+device_hash_update (unsigned long long hash, const unsigned char data[], unsigned int size)
+{
+	// 64 bit FNV-1a.
+	for (unsigned int i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+dc_status_t
+dc_device_get_hash (dc_device_t *device, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, unsigned char hash[DC_DIVE_HASH_SIZE])
+{
+	if (device == NULL || hash == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (fsize == 0 && size == 0)
+		return DC_STATUS_INVALIDARGS;
+
+	// The device identity, in a byte order independent of the host.
+	unsigned char identity[12] = {0};
+	array_uint32_le_set (identity + 0, device->vtable->type);
+	array_uint32_le_set (identity + 4, device->devinfo.model);
+	array_uint32_le_set (identity + 8, device->devinfo.serial);
+
+	unsigned long long value = 0xcbf29ce484222325ULL;
+	value = device_hash_update (value, identity, sizeof (identity));
+	if (fsize)
+		value = device_hash_update (value, fingerprint, fsize);
+	else
+		value = device_hash_update (value, data, size);
+
+	for (unsigned int i = 0; i < DC_DIVE_HASH_SIZE; ++i) {
+		hash[i] = (value >> (8 * (DC_DIVE_HASH_SIZE - 1 - i))) & 0xFF;
+	}
+
+	return DC_STATUS_SUCCESS;
 }
 
 
@@ -396,6 +978,19 @@ dc_device_timesync (dc_device_t *device, const dc_datetime_t *datetime)
 }
 
 
+dc_status_t
+dc_device_keepalive (dc_device_t *device)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (device->vtable->keepalive == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	return device->vtable->keepalive (device);
+}
+
+
 dc_status_t
 dc_device_close (dc_device_t *device)
 {
@@ -446,10 +1041,15 @@ device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 	if (device == NULL)
 		return;
 
+	TRACE3 (device_event, device, event, data);
+
 	// Cache the event data.
 	switch (event) {
 	case DC_EVENT_DEVINFO:
 		device->devinfo = *(const dc_event_devinfo_t *) data;
+		device->have_devinfo = 1;
+		if (device->store)
+			device_fingerprint_load (device);
 		break;
 	case DC_EVENT_CLOCK:
 		device->clock = *(const dc_event_clock_t *) data;
@@ -458,15 +1058,27 @@ device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 		break;
 	}
 
+	// The handshake is finished once the transfer starts, or the device
+	// has identified itself.
+	if (device->phase == DC_PHASE_HANDSHAKE &&
+		(event == DC_EVENT_DEVINFO || (event == DC_EVENT_PROGRESS && progress->current))) {
+		device->phase = DC_PHASE_LOGBOOK;
+	}
+
 	// Check if there is a callback function registered.
 	if (device->event_callback == NULL)
 		return;
 
-	// Check the event mask.
-	if ((event & device->event_mask) == 0)
-		return;
+	// Check the event mask, and coalesce the progress events.
+	if ((event & device->event_mask) &&
+		(event != DC_EVENT_PROGRESS || device_progress_deliver (device, progress)))
+		device->event_callback (device, event, data, device->event_userdata);
 
-	device->event_callback (device, event, data, device->event_userdata);
+	// The statistics are sampled together with the progress.
+	if (event == DC_EVENT_PROGRESS && (device->event_mask & DC_EVENT_STATS) && device->stats_timer) {
+		device_stats_start (device, progress);
+		device_stats_emit (device, progress);
+	}
 }
 
 
@@ -0,0 +1,268 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <libdivecomputer/discovery.h>
+#include <libdivecomputer/serial.h>
+#include <libdivecomputer/irda.h>
+#include <libdivecomputer/bluetooth.h>
+#include <libdivecomputer/usb.h>
+#include <libdivecomputer/usbhid.h>
+
+#include "descriptor-private.h"
+#include "context-private.h"
+#include "thread.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+static const dc_transport_t g_transports[] = {
+	DC_TRANSPORT_SERIAL,
+	DC_TRANSPORT_USB,
+	DC_TRANSPORT_USBHID,
+	DC_TRANSPORT_IRDA,
+	DC_TRANSPORT_BLUETOOTH,
+};
+
+typedef struct dc_discovery_scan_t {
+	dc_discovery_t *discovery;
+	dc_transport_t transport;
+	dc_thread_t *thread;
+	dc_status_t status;
+} dc_discovery_scan_t;
+
+struct dc_discovery_t {
+	dc_context_t *context;
+	dc_descriptor_t *descriptor;
+	dc_discovery_callback_t callback;
+	void *userdata;
+	dc_mutex_t *mutex;
+	dc_discovery_scan_t scans[C_ARRAY_SIZE (g_transports)];
+	unsigned int count;
+};
+
+static dc_status_t
+dc_discovery_iterator_new (dc_iterator_t **iterator, dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport)
+{
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		return dc_serial_iterator_new (iterator, context, descriptor);
+	case DC_TRANSPORT_USB:
+		return dc_usb_iterator_new (iterator, context, descriptor);
+	case DC_TRANSPORT_USBHID:
+		return dc_usbhid_iterator_new (iterator, context, descriptor);
+	case DC_TRANSPORT_IRDA:
+		return dc_irda_iterator_new (iterator, context, descriptor);
+	case DC_TRANSPORT_BLUETOOTH:
+		return dc_bluetooth_iterator_new (iterator, context, descriptor);
+	default:
+		return DC_STATUS_UNSUPPORTED;
+	}
+}
+
+static void
+dc_discovery_device_free (dc_transport_t transport, void *device)
+{
+	switch (transport) {
+	case DC_TRANSPORT_SERIAL:
+		dc_serial_device_free ((dc_serial_device_t *) device);
+		break;
+	case DC_TRANSPORT_USB:
+		dc_usb_device_free ((dc_usb_device_t *) device);
+		break;
+	case DC_TRANSPORT_USBHID:
+		dc_usbhid_device_free ((dc_usbhid_device_t *) device);
+		break;
+	case DC_TRANSPORT_IRDA:
+		dc_irda_device_free ((dc_irda_device_t *) device);
+		break;
+	case DC_TRANSPORT_BLUETOOTH:
+		dc_bluetooth_device_free ((dc_bluetooth_device_t *) device);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Find the descriptor of a device, using the same keys as the filters
+ * of the iterators. Serial ports are never identified, because most
+ * filters accept every serial port.
+ */
+static dc_descriptor_t *
+dc_discovery_match (dc_transport_t transport, void *device)
+{
+	dc_usb_desc_t usb = {0, 0};
+	dc_usb_params_t params = {0, 0, 0};
+
+	switch (transport) {
+	case DC_TRANSPORT_USB:
+		usb.vid = dc_usb_device_get_vid ((dc_usb_device_t *) device);
+		usb.pid = dc_usb_device_get_pid ((dc_usb_device_t *) device);
+		return dc_descriptor_match (transport, &usb, &params);
+	case DC_TRANSPORT_USBHID:
+		usb.vid = dc_usbhid_device_get_vid ((dc_usbhid_device_t *) device);
+		usb.pid = dc_usbhid_device_get_pid ((dc_usbhid_device_t *) device);
+		return dc_descriptor_match (transport, &usb, NULL);
+	case DC_TRANSPORT_IRDA:
+		return dc_descriptor_match (transport, dc_irda_device_get_name ((dc_irda_device_t *) device), NULL);
+	case DC_TRANSPORT_BLUETOOTH:
+		return dc_descriptor_match (transport, dc_bluetooth_device_get_name ((dc_bluetooth_device_t *) device), NULL);
+	default:
+		return NULL;
+	}
+}
+
+static void
+dc_discovery_scan (void *userdata)
+{
+	dc_discovery_scan_t *scan = (dc_discovery_scan_t *) userdata;
+	dc_discovery_t *discovery = scan->discovery;
+	dc_iterator_t *iterator = NULL;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	status = dc_discovery_iterator_new (&iterator, discovery->context, discovery->descriptor, scan->transport);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (discovery->context, "Failed to create the device iterator.");
+		goto cleanup;
+	}
+
+	void *device = NULL;
+	while ((status = dc_iterator_next (iterator, &device)) == DC_STATUS_SUCCESS) {
+		// The iterator already applied the filter of the descriptor.
+		dc_descriptor_t *descriptor = discovery->descriptor;
+		if (descriptor == NULL) {
+			descriptor = dc_discovery_match (scan->transport, device);
+			if (descriptor == NULL && scan->transport != DC_TRANSPORT_SERIAL) {
+				dc_discovery_device_free (scan->transport, device);
+				continue;
+			}
+		}
+
+		dc_mutex_lock (discovery->mutex);
+		discovery->callback (scan->transport, device, descriptor, discovery->userdata);
+		dc_mutex_unlock (discovery->mutex);
+	}
+
+	if (status == DC_STATUS_DONE)
+		status = DC_STATUS_SUCCESS;
+
+cleanup:
+	dc_iterator_free (iterator);
+	scan->status = status;
+}
+
+dc_status_t
+dc_discovery_new (dc_discovery_t **out, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int transports, dc_discovery_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_discovery_t *discovery = NULL;
+
+	if (out == NULL || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	discovery = (dc_discovery_t *) malloc (sizeof (dc_discovery_t));
+	if (discovery == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	discovery->context = context;
+	discovery->descriptor = descriptor;
+	discovery->callback = callback;
+	discovery->userdata = userdata;
+	discovery->count = 0;
+
+	status = dc_mutex_new (&discovery->mutex);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create the mutex.");
+		free (discovery);
+		return status;
+	}
+
+	// Only the transports supported by the library and the descriptor.
+	transports &= dc_context_get_transports (context);
+	if (descriptor)
+		transports &= dc_descriptor_get_transports (descriptor);
+
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_transports); ++i) {
+		if ((transports & g_transports[i]) == 0)
+			continue;
+
+		dc_discovery_scan_t *scan = discovery->scans + discovery->count++;
+		scan->discovery = discovery;
+		scan->transport = g_transports[i];
+		scan->thread = NULL;
+		scan->status = DC_STATUS_SUCCESS;
+
+		// Without thread support, the transports are scanned one
+		// after the other.
+		if (dc_thread_new (&scan->thread, dc_discovery_scan, scan) != DC_STATUS_SUCCESS) {
+			scan->thread = NULL;
+			dc_discovery_scan (scan);
+		}
+	}
+
+	*out = discovery;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_discovery_wait (dc_discovery_t *discovery)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned int nsuccess = 0;
+
+	if (discovery == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	for (unsigned int i = 0; i < discovery->count; ++i) {
+		dc_discovery_scan_t *scan = discovery->scans + i;
+
+		dc_thread_join (scan->thread);
+		scan->thread = NULL;
+
+		if (scan->status == DC_STATUS_SUCCESS)
+			nsuccess++;
+		else if (status == DC_STATUS_SUCCESS)
+			status = scan->status;
+	}
+
+	if (nsuccess)
+		return DC_STATUS_SUCCESS;
+
+	return status;
+}
+
+dc_status_t
+dc_discovery_free (dc_discovery_t *discovery)
+{
+	if (discovery == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_discovery_wait (discovery);
+
+	dc_mutex_free (discovery->mutex);
+	free (discovery);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -28,6 +28,7 @@
 #include "device-private.h"
 #include "checksum.h"
 #include "array.h"
+#include "ringbuffer.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &diverite_nitekq_device_vtable)
 
@@ -65,16 +66,15 @@ static const dc_device_vtable_t diverite_nitekq_device_vtable = {
 	DC_FAMILY_DIVERITE_NITEKQ,
 	diverite_nitekq_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	diverite_nitekq_device_dump, /* dump */
 	diverite_nitekq_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	diverite_nitekq_device_close /* close */
 };
 
-static dc_status_t
-diverite_nitekq_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 diverite_nitekq_send (diverite_nitekq_device_t *device, unsigned char cmd)
 {
@@ -235,8 +235,51 @@ diverite_nitekq_device_set_fingerprint (dc_device_t *abstract, const unsigned ch
 }
 
 
+/*
+ * Get the amount of memory that needs to be downloaded to extract all
+ * dives newer than the fingerprint. The logbook and the pointers are
+ * stored in front of the profile ringbuffer, so they are available long
+ * before the end of the transfer. Only the profile data of the new dives
+ * is needed, unless it wraps around the end of the ringbuffer.
+ */
+static unsigned int
+diverite_nitekq_limit (diverite_nitekq_device_t *device, const unsigned char data[])
+{
+	unsigned int eop = array_uint16_be(data + EOP);
+	if (eop < RB_PROFILE_BEGIN || eop >= RB_PROFILE_END)
+		return SZ_MEMORY;
+
+	unsigned int limit = RB_PROFILE_BEGIN;
+	unsigned int previous = eop;
+	for (unsigned int i = 0; i < 10; ++i) {
+		const unsigned char *p = data + LOGBOOK + i * SZ_LOGBOOK;
+
+		if (array_isequal (p, SZ_LOGBOOK, 0x00))
+			break;
+
+		// Let the extraction report invalid pointers.
+		unsigned int address = array_uint16_be(data + ADDRESS + i * 2);
+		if (address < RB_PROFILE_BEGIN || address >= RB_PROFILE_END)
+			return SZ_MEMORY;
+
+		if (memcmp (p, device->fingerprint, sizeof (device->fingerprint)) == 0)
+			break;
+
+		if (previous <= address)
+			return SZ_MEMORY;
+
+		if (limit < previous)
+			limit = previous;
+
+		previous = address;
+	}
+
+	return limit;
+}
+
+
 static dc_status_t
-diverite_nitekq_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
+diverite_nitekq_transfer (dc_device_t *abstract, dc_buffer_t *buffer, int incremental)
 {
 	diverite_nitekq_device_t *device = (diverite_nitekq_device_t*) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
@@ -293,7 +336,8 @@ diverite_nitekq_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 		return rc;
 	}
 
-	for (unsigned int i = 0; i < 128; ++i) {
+	unsigned int nblocks = SZ_MEMORY / SZ_PACKET;
+	for (unsigned int i = 0; i < nblocks; ++i) {
 		// Request the next memory block.
 		rc = diverite_nitekq_send (device, BLOCK);
 		if (rc != DC_STATUS_SUCCESS) {
@@ -308,6 +352,15 @@ diverite_nitekq_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 		dc_buffer_append (buffer, packet, sizeof (packet));
 
+		// Once the end of profile pointer is available, stop the
+		// transfer after the last block with new profile data.
+		if (incremental && i == (EOP + 1) / SZ_PACKET) {
+			unsigned int limit = diverite_nitekq_limit (device,
+				dc_buffer_get_data (buffer) + SZ_PACKET);
+			nblocks = (limit + SZ_PACKET - 1) / SZ_PACKET;
+			progress.maximum = SZ_PACKET + nblocks * SZ_PACKET;
+		}
+
 		// Update and emit a progress event.
 		progress.current += SZ_PACKET;
 		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
@@ -317,6 +370,13 @@ diverite_nitekq_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 }
 
 
+static dc_status_t
+diverite_nitekq_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
+{
+	return diverite_nitekq_transfer (abstract, buffer, 0);
+}
+
+
 static dc_status_t
 diverite_nitekq_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
@@ -324,12 +384,20 @@ diverite_nitekq_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
-	dc_status_t rc = diverite_nitekq_device_dump (abstract, buffer);
+	dc_status_t rc = diverite_nitekq_transfer (abstract, buffer, 1);
 	if (rc != DC_STATUS_SUCCESS) {
 		dc_buffer_free (buffer);
 		return rc;
 	}
 
+	// The memory after the last new dive is not downloaded. It's never
+	// accessed by the extraction, but it still expects a full image.
+	if (!dc_buffer_resize (buffer, SZ_PACKET + SZ_MEMORY)) {
+		ERROR (abstract->context, "Insufficient buffer space available.");
+		dc_buffer_free (buffer);
+		return DC_STATUS_NOMEMORY;
+	}
+
 	rc = diverite_nitekq_extract_dives (abstract,
 		dc_buffer_get_data (buffer), dc_buffer_get_size (buffer), callback, userdata);
 
@@ -339,7 +407,7 @@ diverite_nitekq_device_foreach (dc_device_t *abstract, dc_dive_callback_t callba
 }
 
 
-static dc_status_t
+dc_status_t
 diverite_nitekq_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	diverite_nitekq_device_t *device = (diverite_nitekq_device_t *) abstract;
@@ -401,17 +469,8 @@ diverite_nitekq_extract_dives (dc_device_t *abstract, const unsigned char data[]
 		memcpy (buffer, p, SZ_LOGBOOK);
 
 		// Copy the profile data.
-		unsigned int length = 0;
-		if (previous > address) {
-			length = previous - address;
-			memcpy (buffer + SZ_LOGBOOK, data + address, length);
-		} else {
-			unsigned int len_a = RB_PROFILE_END - address;
-			unsigned int len_b = previous - RB_PROFILE_BEGIN;
-			length = len_a + len_b;
-			memcpy (buffer + SZ_LOGBOOK, data + address, len_a);
-			memcpy (buffer + SZ_LOGBOOK + len_a, data + RB_PROFILE_BEGIN, len_b);
-		}
+		unsigned int length = ringbuffer_distance (address, previous, 1, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		ringbuffer_copy (buffer + SZ_LOGBOOK, data, address, length, RB_PROFILE_BEGIN, RB_PROFILE_END);
 
 		if (callback && !callback (buffer, length + SZ_LOGBOOK, buffer, SZ_LOGBOOK, userdata)) {
 			break;
@@ -29,6 +29,7 @@
 #include "platform.h"
 #include "checksum.h"
 #include "array.h"
+#include "retry.h"
 
 #define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
 
@@ -110,10 +111,12 @@ static const dc_device_vtable_t divesystem_idive_device_vtable = {
 	DC_FAMILY_DIVESYSTEM_IDIVE,
 	divesystem_idive_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	divesystem_idive_device_foreach, /* foreach */
 	divesystem_idive_device_timesync, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -372,29 +375,24 @@ error:
 }
 
 
+static const dc_retry_policy_t divesystem_idive_retry = {MAXRETRIES, 100, 0, DC_RETRY_BACKOFF};
+
 static dc_status_t
 divesystem_idive_transfer (divesystem_idive_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int *errorcode)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	unsigned int errcode = 0;
 
-	unsigned int nretries = 0;
-	while ((status = divesystem_idive_packet (device, command, csize, answer, asize, &errcode)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (status != DC_STATUS_PROTOCOL && status != DC_STATUS_TIMEOUT)
-			break;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &divesystem_idive_retry);
 
+	while ((status = divesystem_idive_packet (device, command, csize, answer, asize, &errcode)) != DC_STATUS_SUCCESS) {
 		// Abort if the device reports a fatal error.
 		if (errcode && errcode != ERR_BUSY)
 			break;
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
+		if (!dc_retry_again (&retry, device->iostream, status))
 			break;
-
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 100);
 	}
 
 	if (errorcode) {
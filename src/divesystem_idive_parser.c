@@ -274,7 +274,8 @@ divesystem_idive_parser_get_field (dc_parser_t *abstract, dc_field_type_t type,
 		return DC_STATUS_DATAFORMAT;
 
 	if (!parser->cached) {
-		dc_status_t rc = divesystem_idive_parser_samples_foreach (abstract, NULL, NULL);
+		dc_status_t rc = sample_profile_walk (abstract, divesystem_idive_parser_samples_foreach,
+			~(PARSER_FIELD (DC_FIELD_ATMOSPHERIC) | PARSER_FIELD (DC_FIELD_SALINITY)), type);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 	}
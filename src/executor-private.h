@@ -0,0 +1,79 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifndef DC_EXECUTOR_PRIVATE_H
+#define DC_EXECUTOR_PRIVATE_H
+
+#include <libdivecomputer/executor.h>
+#include <libdivecomputer/parser.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dc_executor_worker_t dc_executor_worker_t;
+
+typedef void (*dc_executor_func_t) (dc_executor_worker_t *worker, void *userdata);
+
+/*
+ * Get a reference to the executor of the context. Without an executor,
+ * the context creates its own one. Release it with dc_executor_free.
+ */
+dc_status_t
+dc_executor_get (dc_executor_t **executor, dc_context_t *context);
+
+/*
+ * Run the function on one of the workers. The function must not wait
+ * for other tasks, because all the workers may be busy, unless it runs
+ * the pending tasks with dc_executor_help while waiting.
+ */
+dc_status_t
+dc_executor_submit (dc_executor_t *executor, dc_executor_func_t func, void *userdata);
+
+/*
+ * Check whether the calling thread can wait for the tasks it submitted.
+ * That's not the case within a task of an application supplied
+ * executor, because all its workers may be busy.
+ */
+int
+dc_executor_can_wait (dc_executor_t *executor);
+
+/*
+ * Run one pending task on the worker of the calling thread, instead of
+ * blocking the worker while waiting for other tasks. Returns zero if no
+ * task was run, because there is none, or the calling thread isn't a
+ * worker thread of the executor.
+ */
+int
+dc_executor_help (dc_executor_t *executor);
+
+/*
+ * The parser cache of the worker. Only the task running on the worker
+ * may use it, and it must return the parsers before it finishes.
+ */
+dc_parser_pool_t *
+dc_executor_worker_get_pool (dc_executor_worker_t *worker);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_EXECUTOR_PRIVATE_H */
@@ -0,0 +1,590 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#include <windows.h>
+#elif defined (HAVE_UNISTD_H)
+#include <unistd.h>
+#endif
+
+#include "executor-private.h"
+#include "context-private.h"
+#include "parser-private.h"
+#include "platform.h"
+#include "thread.h"
+
+// The maximum number of idle parsers in the cache of a worker.
+#define MAXPARSERS 8
+
+// The initial capacity of the task queue of a worker thread.
+#define QUEUESIZE 16
+
+typedef struct dc_executor_task_t {
+	dc_executor_func_t func;
+	void *userdata;
+	dc_executor_t *executor;
+} dc_executor_task_t;
+
+/*
+ * A worker is a worker thread, or a slot for a task running on an
+ * application supplied executor. The queue is only used by the worker
+ * threads, and is a ring buffer with the oldest task first.
+ *
+ * The parser cache of a worker outlives the tasks. A parser returned to
+ * the cache loses its configuration, such that a task never sees the
+ * settings of another one. Once a top-level task is finished, parsers it
+ * didn't return are reclaimed. Not after a task run by dc_executor_help,
+ * because the waiting task may still use its parsers.
+ */
+struct dc_executor_worker_t {
+	dc_executor_t *executor;
+	dc_executor_worker_t *next;
+	dc_parser_pool_t *pool;
+	dc_thread_t *thread;
+	unsigned int index;
+	dc_mutex_t *mutex;
+	dc_executor_task_t *tasks;
+	size_t capacity;
+	size_t first;
+	size_t count;
+};
+
+/*
+ * The lock order is the queue of a worker first, and the executor
+ * second. The number of pending tasks is the total number of tasks in
+ * the queues for the worker threads, and the number of unfinished
+ * tasks for an application supplied executor.
+ */
+struct dc_executor_t {
+	dc_context_t *context;
+	dc_mutex_t *mutex;
+	dc_cond_t *cond;
+	size_t refcount;
+	unsigned int nthreads;
+	dc_executor_worker_t *workers;
+	unsigned int pending;
+	unsigned int next;
+	int quit;
+	/* The application supplied executor, and its idle workers. */
+	dc_executor_submit_t submit;
+	void *userdata;
+	dc_executor_worker_t *idle;
+};
+
+// The worker of the current thread, if any.
+static DC_THREAD_LOCAL dc_executor_worker_t *g_worker = NULL;
+
+static unsigned int
+dc_executor_nprocessors (void)
+{
+#if defined (_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo (&info);
+	return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+#elif defined (_SC_NPROCESSORS_ONLN)
+	long n = sysconf (_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+#else
+	return 1;
+#endif
+}
+
+static void
+dc_executor_destroy (dc_executor_t *executor)
+{
+	if (executor->workers) {
+		// Let the worker threads finish the remaining tasks, and wait
+		// for the tasks of an application supplied executor.
+		dc_mutex_lock (executor->mutex);
+		executor->quit = 1;
+		dc_cond_broadcast (executor->cond);
+		if (executor->submit) {
+			while (executor->pending)
+				dc_cond_wait (executor->cond, executor->mutex);
+		}
+		dc_mutex_unlock (executor->mutex);
+
+		for (unsigned int i = 0; i < executor->nthreads; ++i) {
+			dc_thread_join (executor->workers[i].thread);
+		}
+
+		for (unsigned int i = 0; i < executor->nthreads; ++i) {
+			dc_parser_pool_free (executor->workers[i].pool);
+			dc_mutex_free (executor->workers[i].mutex);
+			free (executor->workers[i].tasks);
+		}
+	}
+
+	dc_cond_free (executor->cond);
+	dc_mutex_free (executor->mutex);
+	free (executor->workers);
+	free (executor);
+}
+
+static dc_status_t
+dc_executor_allocate (dc_executor_t **out, dc_context_t *context, unsigned int nthreads)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_executor_t *executor = NULL;
+
+	executor = (dc_executor_t *) malloc (sizeof (dc_executor_t));
+	if (executor == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	executor->context = context;
+	executor->mutex = NULL;
+	executor->cond = NULL;
+	executor->refcount = 1;
+	executor->nthreads = nthreads;
+	executor->workers = NULL;
+	executor->pending = 0;
+	executor->next = 0;
+	executor->quit = 0;
+	executor->submit = NULL;
+	executor->userdata = NULL;
+	executor->idle = NULL;
+
+	if (dc_mutex_new (&executor->mutex) != DC_STATUS_SUCCESS ||
+		dc_cond_new (&executor->cond) != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	executor->workers = (dc_executor_worker_t *) malloc (nthreads * sizeof (dc_executor_worker_t));
+	if (executor->workers == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	for (unsigned int i = 0; i < nthreads; ++i) {
+		dc_executor_worker_t *worker = executor->workers + i;
+		worker->executor = executor;
+		worker->next = NULL;
+		worker->pool = NULL;
+		worker->thread = NULL;
+		worker->index = i;
+		worker->mutex = NULL;
+		worker->tasks = NULL;
+		worker->capacity = 0;
+		worker->first = 0;
+		worker->count = 0;
+	}
+
+	for (unsigned int i = 0; i < nthreads; ++i) {
+		dc_executor_worker_t *worker = executor->workers + i;
+		status = dc_parser_pool_new (&worker->pool, context);
+		if (status != DC_STATUS_SUCCESS)
+			goto error_free;
+	}
+
+	*out = executor;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_executor_destroy (executor);
+	return status;
+}
+
+static void
+dc_executor_execute (dc_executor_worker_t *worker, const dc_executor_task_t *task)
+{
+	task->func (worker, task->userdata);
+
+	// Keep only the most recently used parsers.
+	dc_parser_pool_trim (worker->pool, MAXPARSERS);
+}
+
+/*
+ * Take the oldest task from the own queue, or else steal the newest
+ * task from the queue of another worker.
+ */
+static int
+dc_executor_take (dc_executor_t *executor, dc_executor_worker_t *worker, dc_executor_task_t *task)
+{
+	for (unsigned int i = 0; i < executor->nthreads; ++i) {
+		dc_executor_worker_t *queue = executor->workers + (worker->index + i) % executor->nthreads;
+
+		dc_mutex_lock (queue->mutex);
+
+		if (queue->count == 0) {
+			dc_mutex_unlock (queue->mutex);
+			continue;
+		}
+
+		if (queue == worker) {
+			*task = queue->tasks[queue->first];
+			queue->first = (queue->first + 1) % queue->capacity;
+		} else {
+			*task = queue->tasks[(queue->first + queue->count - 1) % queue->capacity];
+		}
+		queue->count--;
+
+		dc_mutex_lock (executor->mutex);
+		executor->pending--;
+		dc_mutex_unlock (executor->mutex);
+
+		dc_mutex_unlock (queue->mutex);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static void
+dc_executor_worker_main (void *userdata)
+{
+	dc_executor_worker_t *worker = (dc_executor_worker_t *) userdata;
+	dc_executor_t *executor = worker->executor;
+
+	g_worker = worker;
+
+	while (1) {
+		dc_executor_task_t task;
+		if (dc_executor_take (executor, worker, &task)) {
+			dc_executor_execute (worker, &task);
+			dc_parser_pool_reclaim (worker->pool);
+			continue;
+		}
+
+		dc_mutex_lock (executor->mutex);
+		while (!executor->quit && executor->pending == 0)
+			dc_cond_wait (executor->cond, executor->mutex);
+		int quit = executor->quit && executor->pending == 0;
+		dc_mutex_unlock (executor->mutex);
+
+		if (quit)
+			break;
+	}
+
+	g_worker = NULL;
+}
+
+static void
+dc_executor_run (void *data)
+{
+	dc_executor_task_t *task = (dc_executor_task_t *) data;
+	dc_executor_t *executor = task->executor;
+
+	dc_mutex_lock (executor->mutex);
+	while (executor->idle == NULL)
+		dc_cond_wait (executor->cond, executor->mutex);
+	dc_executor_worker_t *worker = executor->idle;
+	executor->idle = worker->next;
+	dc_mutex_unlock (executor->mutex);
+
+	// The application may run the task on a thread that is already
+	// running another task.
+	dc_executor_worker_t *previous = g_worker;
+	g_worker = worker;
+	dc_executor_execute (worker, task);
+	dc_parser_pool_reclaim (worker->pool);
+	g_worker = previous;
+	free (task);
+
+	dc_mutex_lock (executor->mutex);
+	worker->next = executor->idle;
+	executor->idle = worker;
+	executor->pending--;
+	dc_cond_broadcast (executor->cond);
+	dc_mutex_unlock (executor->mutex);
+}
+
+dc_status_t
+dc_executor_new (dc_executor_t **out, dc_context_t *context, unsigned int nthreads)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_executor_t *executor = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (nthreads == 0)
+		nthreads = dc_executor_nprocessors ();
+
+	status = dc_executor_allocate (&executor, context, nthreads);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	for (unsigned int i = 0; i < nthreads; ++i) {
+		if (dc_mutex_new (&executor->workers[i].mutex) != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to allocate memory.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_free;
+		}
+	}
+
+	for (unsigned int i = 0; i < nthreads; ++i) {
+		status = dc_thread_new (&executor->workers[i].thread, dc_executor_worker_main, executor->workers + i);
+		if (status != DC_STATUS_SUCCESS) {
+			if (status != DC_STATUS_UNSUPPORTED)
+				ERROR (context, "Failed to create the worker thread.");
+			goto error_free;
+		}
+	}
+
+	*out = executor;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_executor_destroy (executor);
+	return status;
+}
+
+dc_status_t
+dc_executor_new_custom (dc_executor_t **out, dc_context_t *context, unsigned int nthreads, dc_executor_submit_t submit, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_executor_t *executor = NULL;
+
+	if (out == NULL || nthreads == 0 || submit == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	status = dc_executor_allocate (&executor, context, nthreads);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	executor->submit = submit;
+	executor->userdata = userdata;
+
+	for (unsigned int i = nthreads; i > 0; --i) {
+		dc_executor_worker_t *worker = executor->workers + i - 1;
+		worker->next = executor->idle;
+		executor->idle = worker;
+	}
+
+	*out = executor;
+
+	return DC_STATUS_SUCCESS;
+}
+
+unsigned int
+dc_executor_get_nthreads (dc_executor_t *executor)
+{
+	if (executor == NULL)
+		return 0;
+
+	return executor->nthreads;
+}
+
+static dc_executor_t *
+dc_executor_ref (dc_executor_t *executor)
+{
+	if (executor == NULL)
+		return NULL;
+
+	dc_mutex_lock (executor->mutex);
+	executor->refcount++;
+	dc_mutex_unlock (executor->mutex);
+
+	return executor;
+}
+
+dc_status_t
+dc_executor_free (dc_executor_t *executor)
+{
+	if (executor == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_mutex_lock (executor->mutex);
+	size_t refcount = --executor->refcount;
+	dc_mutex_unlock (executor->mutex);
+
+	if (refcount == 0)
+		dc_executor_destroy (executor);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_executor_submit (dc_executor_t *executor, dc_executor_func_t func, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (executor == NULL || func == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (executor->submit) {
+		dc_executor_task_t *task = (dc_executor_task_t *) malloc (sizeof (dc_executor_task_t));
+		if (task == NULL) {
+			ERROR (executor->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		task->func = func;
+		task->userdata = userdata;
+		task->executor = executor;
+
+		dc_mutex_lock (executor->mutex);
+		executor->pending++;
+		dc_mutex_unlock (executor->mutex);
+
+		status = executor->submit (dc_executor_run, task, executor->userdata);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (executor->context, "Failed to submit the task.");
+			dc_mutex_lock (executor->mutex);
+			executor->pending--;
+			dc_cond_broadcast (executor->cond);
+			dc_mutex_unlock (executor->mutex);
+			free (task);
+		}
+
+		return status;
+	}
+
+	// A task submitted from a worker thread stays on that worker, other
+	// tasks are spread over all the workers.
+	dc_executor_worker_t *queue = g_worker;
+	if (queue == NULL || queue->executor != executor) {
+		dc_mutex_lock (executor->mutex);
+		queue = executor->workers + executor->next++ % executor->nthreads;
+		dc_mutex_unlock (executor->mutex);
+	}
+
+	dc_mutex_lock (queue->mutex);
+
+	if (queue->count == queue->capacity) {
+		size_t capacity = queue->capacity ? queue->capacity * 2 : QUEUESIZE;
+		dc_executor_task_t *tasks = (dc_executor_task_t *) malloc (capacity * sizeof (dc_executor_task_t));
+		if (tasks == NULL) {
+			dc_mutex_unlock (queue->mutex);
+			ERROR (executor->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		for (size_t i = 0; i < queue->count; ++i) {
+			tasks[i] = queue->tasks[(queue->first + i) % queue->capacity];
+		}
+
+		free (queue->tasks);
+		queue->tasks = tasks;
+		queue->capacity = capacity;
+		queue->first = 0;
+	}
+
+	dc_executor_task_t *task = queue->tasks + (queue->first + queue->count) % queue->capacity;
+	task->func = func;
+	task->userdata = userdata;
+	task->executor = executor;
+	queue->count++;
+
+	dc_mutex_lock (executor->mutex);
+	executor->pending++;
+	dc_cond_broadcast (executor->cond);
+	dc_mutex_unlock (executor->mutex);
+
+	dc_mutex_unlock (queue->mutex);
+
+	return DC_STATUS_SUCCESS;
+}
+
+int
+dc_executor_can_wait (dc_executor_t *executor)
+{
+	// The tasks of an application supplied executor are queued by the
+	// application, and can't be run by dc_executor_help.
+	return executor->submit == NULL || g_worker == NULL || g_worker->executor != executor;
+}
+
+int
+dc_executor_help (dc_executor_t *executor)
+{
+	dc_executor_worker_t *worker = g_worker;
+	dc_executor_task_t task;
+
+	if (worker == NULL || worker->executor != executor || executor->submit)
+		return 0;
+
+	if (!dc_executor_take (executor, worker, &task))
+		return 0;
+
+	dc_executor_execute (worker, &task);
+
+	return 1;
+}
+
+dc_parser_pool_t *
+dc_executor_worker_get_pool (dc_executor_worker_t *worker)
+{
+	return worker->pool;
+}
+
+static dc_status_t
+dc_executor_vcreate (void **executor, dc_context_t *context)
+{
+	dc_status_t status = dc_executor_new ((dc_executor_t **) executor, context, 0);
+	if (status == DC_STATUS_UNSUPPORTED)
+		WARNING (context, "Threads not supported, running sequentially.");
+	return status;
+}
+
+static void *
+dc_executor_vref (void *executor)
+{
+	return dc_executor_ref ((dc_executor_t *) executor);
+}
+
+static dc_status_t
+dc_executor_vunref (void *executor)
+{
+	return dc_executor_free ((dc_executor_t *) executor);
+}
+
+static const dc_resource_vtable_t dc_executor_vtable = {
+	dc_executor_vcreate,
+	dc_executor_vref,
+	dc_executor_vunref,
+};
+
+dc_status_t
+dc_executor_get (dc_executor_t **executor, dc_context_t *context)
+{
+	void *resource = NULL;
+
+	dc_status_t status = dc_context_get_resource (context, DC_RESOURCE_EXECUTOR, &dc_executor_vtable, &resource);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*executor = (dc_executor_t *) resource;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_set_executor (dc_context_t *context, dc_executor_t *executor)
+{
+	return dc_context_set_resource (context, DC_RESOURCE_EXECUTOR, &dc_executor_vtable, executor);
+}
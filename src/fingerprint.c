@@ -0,0 +1,223 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/device.h>
+
+#include "context-private.h"
+#include "recordfile.h"
+#include "thread.h"
+
+/*
+ * The fingerprints are stored in a record file, with one line per
+ * device. See recordfile.h for the format.
+ */
+
+struct dc_fingerprint_store_t {
+	dc_context_t *context;
+	dc_mutex_t *mutex;
+	char *filename;
+	dc_record_t *entries;
+};
+
+static dc_record_t *
+dc_fingerprint_store_find (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial)
+{
+	for (dc_record_t *entry = store->entries; entry; entry = entry->next) {
+		if (entry->family == family && entry->model == model && entry->serial == serial)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static dc_record_t *
+dc_fingerprint_store_insert (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial)
+{
+	dc_record_t *entry = (dc_record_t *) malloc (sizeof (dc_record_t));
+	if (entry == NULL) {
+		ERROR (store->context, "Failed to allocate memory.");
+		return NULL;
+	}
+
+	entry->family = family;
+	entry->model = model;
+	entry->serial = serial;
+	entry->size = 0;
+	entry->next = store->entries;
+	store->entries = entry;
+
+	return entry;
+}
+
+static dc_status_t
+dc_fingerprint_store_load_cb (const dc_record_t *record, void *userdata)
+{
+	dc_fingerprint_store_t *store = (dc_fingerprint_store_t *) userdata;
+
+	// A later line replaces the fingerprint of the same device.
+	dc_record_t *entry = dc_fingerprint_store_find (store, record->family, record->model, record->serial);
+	if (entry == NULL) {
+		entry = dc_fingerprint_store_insert (store, record->family, record->model, record->serial);
+		if (entry == NULL)
+			return DC_STATUS_NOMEMORY;
+	}
+
+	memcpy (entry->data, record->data, record->size);
+	entry->size = record->size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_fingerprint_store_clear (dc_fingerprint_store_t *store)
+{
+	dc_record_t *entry = store->entries;
+	while (entry) {
+		dc_record_t *next = entry->next;
+		free (entry);
+		entry = next;
+	}
+	store->entries = NULL;
+}
+
+dc_status_t
+dc_fingerprint_store_new (dc_fingerprint_store_t **out, dc_context_t *context, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_fingerprint_store_t *store = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	store = (dc_fingerprint_store_t *) malloc (sizeof (dc_fingerprint_store_t));
+	if (store == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	store->context = context;
+	store->mutex = NULL;
+	store->entries = NULL;
+
+	size_t length = strlen (filename);
+	store->filename = (char *) malloc (length + 1);
+	if (store->filename == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+	memcpy (store->filename, filename, length + 1);
+
+	status = dc_mutex_new (&store->mutex);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create the mutex.");
+		goto error_free_filename;
+	}
+
+	status = dc_recordfile_load (context, store->filename, "fingerprint", dc_fingerprint_store_load_cb, store);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_free_entries;
+	}
+
+	*out = store;
+
+	return DC_STATUS_SUCCESS;
+
+error_free_entries:
+	dc_fingerprint_store_clear (store);
+	dc_mutex_free (store->mutex);
+error_free_filename:
+	free (store->filename);
+error_free:
+	free (store);
+	return status;
+}
+
+dc_status_t
+dc_fingerprint_store_get (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, dc_buffer_t *fingerprint)
+{
+	if (store == NULL || fingerprint == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_buffer_clear (fingerprint);
+
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_mutex_lock (store->mutex);
+
+	dc_record_t *entry = dc_fingerprint_store_find (store, family, model, serial);
+	if (entry && !dc_buffer_append (fingerprint, entry->data, entry->size)) {
+		ERROR (store->context, "Insufficient buffer space available.");
+		status = DC_STATUS_NOMEMORY;
+	}
+
+	dc_mutex_unlock (store->mutex);
+
+	return status;
+}
+
+dc_status_t
+dc_fingerprint_store_set (dc_fingerprint_store_t *store, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size)
+{
+	if (store == NULL || (data == NULL && size) || size > DC_RECORD_MAXSIZE)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_mutex_lock (store->mutex);
+
+	dc_record_t *entry = dc_fingerprint_store_find (store, family, model, serial);
+	if (entry == NULL) {
+		entry = dc_fingerprint_store_insert (store, family, model, serial);
+		if (entry == NULL) {
+			status = DC_STATUS_NOMEMORY;
+			goto error_unlock;
+		}
+	}
+
+	// An empty fingerprint removes the entry from the file.
+	if (size)
+		memcpy (entry->data, data, size);
+	entry->size = size;
+
+	status = dc_recordfile_save (store->context, store->filename, "fingerprint", store->entries);
+
+error_unlock:
+	dc_mutex_unlock (store->mutex);
+	return status;
+}
+
+dc_status_t
+dc_fingerprint_store_free (dc_fingerprint_store_t *store)
+{
+	if (store == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_fingerprint_store_clear (store);
+	dc_mutex_free (store->mutex);
+	free (store->filename);
+	free (store);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -68,10 +68,12 @@ static const dc_device_vtable_t hw_frog_device_vtable = {
 	DC_FAMILY_HW_FROG,
 	hw_frog_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	hw_frog_device_foreach, /* foreach */
 	hw_frog_device_timesync, /* timesync */
+	NULL, /* keepalive */
 	hw_frog_device_close /* close */
 };
 
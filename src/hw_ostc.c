@@ -76,16 +76,15 @@ static const dc_device_vtable_t hw_ostc_device_vtable = {
 	DC_FAMILY_HW_OSTC,
 	hw_ostc_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	hw_ostc_device_dump, /* dump */
 	hw_ostc_device_foreach, /* foreach */
 	hw_ostc_device_timesync, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
-static dc_status_t
-hw_ostc_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 hw_ostc_send (hw_ostc_device_t *device, unsigned char cmd, unsigned int echo)
 {
@@ -463,15 +462,12 @@ hw_ostc_device_reset (dc_device_t *abstract)
 }
 
 
-dc_status_t
-hw_ostc_device_screenshot (dc_device_t *abstract, dc_buffer_t *buffer, hw_ostc_format_t format)
+static dc_status_t
+hw_ostc_device_screenshot_internal (dc_device_t *abstract, dc_buffer_t *buffer, hw_ostc_format_t format, hw_ostc_screenshot_callback_t callback, void *userdata)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	hw_ostc_device_t *device = (hw_ostc_device_t *) abstract;
 
-	if (!ISINSTANCE (abstract))
-		return DC_STATUS_INVALIDARGS;
-
 	// Erase the current contents of the buffer.
 	if (!dc_buffer_clear (buffer)) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
@@ -519,90 +515,137 @@ hw_ostc_device_screenshot (dc_device_t *abstract, dc_buffer_t *buffer, hw_ostc_f
 	// of the pixel coordinates.
 	unsigned int x = 0, y = 0;
 
+	// The run length encoded data is received in chunks. Every byte
+	// encodes at most 128 pixels, so the number of remaining bytes is at
+	// least the number of remaining pixels divided by 128. Reading no
+	// more than that never consumes any data past the end of the image.
+	unsigned char chunk[1024];
+	unsigned char raw[3] = {0};
+	unsigned int nraw = 0;
+	unsigned int ncolumns = 0;
+
 	unsigned int npixels = 0;
 	while (npixels < WIDTH * HEIGHT) {
-		unsigned char raw[3] = {0};
-		status = dc_iostream_read (device->iostream, raw, 1, NULL);
+		// A pending color pixel already has its count.
+		unsigned int pending = nraw ? 3 - nraw : 0;
+		unsigned int remaining = WIDTH * HEIGHT - npixels;
+		unsigned int npending = nraw ? (raw[0] & 0x3F) + 1 : 0;
+		remaining = remaining > npending ? remaining - npending : 0;
+		unsigned int len = pending + (remaining + 127) / 128;
+		if (len > sizeof (chunk))
+			len = sizeof (chunk);
+
+		status = dc_iostream_read (device->iostream, chunk, len, NULL);
 		if (status != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to receive the packet.");
 			return status;
 		}
 
-		unsigned int nbytes = 1;
-		unsigned int count = raw[0];
-		if ((count & 0x80) == 0x00) {
-			// Black pixel.
-			raw[1] = raw[2] = BLACK;
-			count &= 0x7F;
-		} else if ((count & 0xC0) == 0xC0) {
-			// White pixel.
-			raw[1] = raw[2] = WHITE;
-			count &= 0x3F;
-		} else {
-			// Color pixel.
-			status = dc_iostream_read (device->iostream, raw + 1, 2, NULL);
-			if (status != DC_STATUS_SUCCESS) {
-				ERROR (abstract->context, "Failed to receive the packet.");
-				return status;
+		for (unsigned int n = 0; n < len; ++n) {
+			raw[nraw++] = chunk[n];
+
+			unsigned int nbytes = nraw;
+			unsigned int count = raw[0];
+			if ((count & 0x80) == 0x00) {
+				// Black pixel.
+				raw[1] = raw[2] = BLACK;
+				count &= 0x7F;
+			} else if ((count & 0xC0) == 0xC0) {
+				// White pixel.
+				raw[1] = raw[2] = WHITE;
+				count &= 0x3F;
+			} else {
+				// Color pixel.
+				if (nraw < 3)
+					continue;
+				count &= 0x3F;
 			}
+			count++;
+			nraw = 0;
 
-			nbytes += 2;
-			count &= 0x3F;
-		}
-		count++;
-
-		// Check for buffer overflows.
-		if (npixels + count > WIDTH * HEIGHT) {
-			ERROR (abstract->context, "Unexpected number of pixels received.");
-			return DC_STATUS_DATAFORMAT;
-		}
-
-		if (format == HW_OSTC_FORMAT_RAW) {
-			// Append the raw data to the output buffer.
-			if (!dc_buffer_append (buffer, raw, nbytes)) {
-				ERROR (abstract->context, "Insufficient buffer space available.");
-				return DC_STATUS_NOMEMORY;
+			// Check for buffer overflows.
+			if (npixels + count > WIDTH * HEIGHT) {
+				ERROR (abstract->context, "Unexpected number of pixels received.");
+				return DC_STATUS_DATAFORMAT;
 			}
-		} else {
-			// Store the decompressed data in the output buffer.
-			for (unsigned int i = 0; i < count; ++i) {
-				// Calculate the offset to the current pixel (row layout)
-				unsigned int offset = (y * WIDTH + x) * bpp;
-
-				if (format == HW_OSTC_FORMAT_RGB16) {
-					image[offset + 0] = raw[1];
-					image[offset + 1] = raw[2];
-				} else {
+
+			if (format == HW_OSTC_FORMAT_RAW) {
+				// Append the raw data to the output buffer.
+				if (!dc_buffer_append (buffer, raw, nbytes)) {
+					ERROR (abstract->context, "Insufficient buffer space available.");
+					return DC_STATUS_NOMEMORY;
+				}
+			} else {
+				// All pixels of a run have the same color, which is
+				// converted only once.
+				unsigned char pixel[3] = {raw[1], raw[2], 0};
+				if (format == HW_OSTC_FORMAT_RGB24) {
 					unsigned int value = (raw[1] << 8) + raw[2];
 					unsigned char r = (value & 0xF800) >> 11;
 					unsigned char g = (value & 0x07E0) >> 5;
 					unsigned char b = (value & 0x001F);
-					image[offset + 0] = 255 * r / 31;
-					image[offset + 1] = 255 * g / 63;
-					image[offset + 2] = 255 * b / 31;
+					pixel[0] = 255 * r / 31;
+					pixel[1] = 255 * g / 63;
+					pixel[2] = 255 * b / 31;
 				}
 
-				// Move to the next pixel coordinate (column layout).
-				y++;
-				if (y == HEIGHT) {
-					y = 0;
-					x++;
+				// Store the decompressed data in the output buffer.
+				for (unsigned int i = 0; i < count; ++i) {
+					// Calculate the offset to the current pixel (row layout)
+					unsigned int offset = (y * WIDTH + x) * bpp;
+					memcpy (image + offset, pixel, bpp);
+
+					// Move to the next pixel coordinate (column layout).
+					y++;
+					if (y == HEIGHT) {
+						y = 0;
+						x++;
+					}
 				}
 			}
-		}
 
-		// Update and emit a progress event.
-		progress.current += count;
-		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+			// Update and emit a progress event.
+			progress.current += count;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+			npixels += count;
+		}
 
-		npixels += count;
+		// Report the columns which are complete now.
+		if (callback && x > ncolumns) {
+			callback (image, WIDTH * HEIGHT * bpp, ncolumns, x - ncolumns, userdata);
+			ncolumns = x;
+		}
 	}
 
 	return DC_STATUS_SUCCESS;
 }
 
 
-static dc_status_t
+dc_status_t
+hw_ostc_device_screenshot (dc_device_t *abstract, dc_buffer_t *buffer, hw_ostc_format_t format)
+{
+	if (!ISINSTANCE (abstract))
+		return DC_STATUS_INVALIDARGS;
+
+	return hw_ostc_device_screenshot_internal (abstract, buffer, format, NULL, NULL);
+}
+
+
+dc_status_t
+hw_ostc_device_screenshot_stream (dc_device_t *abstract, dc_buffer_t *buffer, hw_ostc_format_t format, hw_ostc_screenshot_callback_t callback, void *userdata)
+{
+	if (!ISINSTANCE (abstract))
+		return DC_STATUS_INVALIDARGS;
+
+	if (format == HW_OSTC_FORMAT_RAW || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	return hw_ostc_device_screenshot_internal (abstract, buffer, format, callback, userdata);
+}
+
+
+dc_status_t
 hw_ostc_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	hw_ostc_device_t *device = (hw_ostc_device_t *) abstract;
@@ -24,9 +24,12 @@
 #include <stdlib.h> // malloc, free
 #include <stdio.h>  // FILE, fopen
 
+#include <libdivecomputer/ble.h>
+
 #include "hw_ostc3.h"
 #include "context-private.h"
 #include "device-private.h"
+#include "iostream-private.h"
 #include "array.h"
 #include "aes.h"
 #include "platform.h"
@@ -43,8 +46,11 @@
 #define SZ_FWINFO     4
 #define SZ_FIRMWARE   0x01E000        // 120KB
 #define SZ_FIRMWARE_BLOCK    0x1000   //   4KB
+#define SZ_DUMP_BLOCK        0x10000  //  64KB
 #define SZ_FIRMWARE_BLOCK2   0x0100   //  256B
 #define FIRMWARE_AREA      0x3E0000
+#define SZ_PACKET_BLE      20
+#define SZ_PACKET_MAX      512
 
 #define RB_LOGBOOK_SIZE_COMPACT  16
 #define RB_LOGBOOK_SIZE_FULL     256
@@ -102,7 +108,9 @@ typedef struct hw_ostc3_device_t {
 	unsigned int firmware;
 	unsigned char fingerprint[5];
 	hw_ostc3_state_t state;
-	unsigned char cache[20];
+	unsigned char cache[SZ_PACKET_MAX];
+	unsigned int packetsize;
+	const unsigned char *packet;
 	unsigned int available;
 	unsigned int offset;
 } hw_ostc3_device_t;
@@ -131,6 +139,7 @@ static const unsigned char ostc3_key[16] = {
 
 static dc_status_t hw_ostc3_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
 static dc_status_t hw_ostc3_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
+static dc_status_t hw_ostc3_device_read_multi (dc_device_t *abstract, const dc_device_range_t ranges[], unsigned int count);
 static dc_status_t hw_ostc3_device_write (dc_device_t *abstract, unsigned int address, const unsigned char data[], unsigned int size);
 static dc_status_t hw_ostc3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 static dc_status_t hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
@@ -142,10 +151,12 @@ static const dc_device_vtable_t hw_ostc3_device_vtable = {
 	DC_FAMILY_HW_OSTC3,
 	hw_ostc3_device_set_fingerprint, /* set_fingerprint */
 	hw_ostc3_device_read, /* read */
+	hw_ostc3_device_read_multi, /* read_multi */
 	hw_ostc3_device_write, /* write */
 	hw_ostc3_device_dump, /* dump */
 	hw_ostc3_device_foreach, /* foreach */
 	hw_ostc3_device_timesync, /* timesync */
+	NULL, /* keepalive */
 	hw_ostc3_device_close /* close */
 };
 
@@ -183,6 +194,16 @@ hw_ostc3_strncpy (unsigned char *data, unsigned int size, const char *text)
 	return 0;
 }
 
+static void
+hw_ostc3_packet_return (hw_ostc3_device_t *device)
+{
+	// Hand a lent packet back to the I/O stream.
+	if (device->packet != device->cache) {
+		dc_iostream_read_return (device->iostream, device->packet);
+		device->packet = device->cache;
+	}
+}
+
 static dc_status_t
 hw_ostc3_read (hw_ostc3_device_t *device, dc_event_progress_t *progress, unsigned char data[], size_t size)
 {
@@ -193,12 +214,19 @@ hw_ostc3_read (hw_ostc3_device_t *device, dc_event_progress_t *progress, unsigne
 	while (nbytes < size) {
 		if (transport == DC_TRANSPORT_BLE) {
 			if (device->available == 0) {
-				// Read a packet into the cache.
+				// Borrow the packet from the I/O stream if possible,
+				// otherwise read it into the cache.
+				const unsigned char *packet = NULL;
 				size_t len = 0;
-				rc = dc_iostream_read (device->iostream, device->cache, sizeof(device->cache), &len);
+				rc = dc_iostream_read_lend (device->iostream, &packet, &len);
+				if (rc == DC_STATUS_UNSUPPORTED) {
+					packet = device->cache;
+					rc = dc_iostream_read (device->iostream, device->cache, device->packetsize, &len);
+				}
 				if (rc != DC_STATUS_SUCCESS)
 					return rc;
 
+				device->packet = packet;
 				device->available = len;
 				device->offset = 0;
 			}
@@ -213,9 +241,11 @@ hw_ostc3_read (hw_ostc3_device_t *device, dc_event_progress_t *progress, unsigne
 
 		if (transport == DC_TRANSPORT_BLE) {
 			// Copy the data from the cached packet.
-			memcpy (data + nbytes, device->cache + device->offset, length);
+			memcpy (data + nbytes, device->packet + device->offset, length);
 			device->available -= length;
 			device->offset += length;
+			if (device->available == 0)
+				hw_ostc3_packet_return (device);
 		} else {
 			// Read the packet.
 			rc = dc_iostream_read (device->iostream, data + nbytes, length, NULL);
@@ -244,7 +274,7 @@ hw_ostc3_write (hw_ostc3_device_t *device, dc_event_progress_t *progress, const
 	size_t nbytes = 0;
 	while (nbytes < size) {
 		// Set the maximum packet size.
-		size_t length = (transport == DC_TRANSPORT_BLE) ? sizeof(device->cache) : 64;
+		size_t length = (transport == DC_TRANSPORT_BLE) ? SZ_PACKET_BLE : 64;
 
 		// Limit the packet size to the total size.
 		if (nbytes + length > size)
@@ -380,9 +410,27 @@ hw_ostc3_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *i
 	device->firmware = 0;
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
 	memset (device->cache, 0, sizeof (device->cache));
+	device->packet = device->cache;
+	device->packetsize = SZ_PACKET_BLE;
 	device->available = 0;
 	device->offset = 0;
 
+	// Request the largest notifications the firmware can send, and a
+	// short connection interval.
+	dc_iostream_ble_prefer (iostream, SZ_PACKET_MAX, BLE_INTERVAL_MIN, 0);
+
+	// With a larger BLE MTU, the firmware sends the data in larger
+	// notifications. Read them in one go, instead of assuming the
+	// minimum packet size.
+	if (dc_iostream_get_transport (iostream) == DC_TRANSPORT_BLE) {
+		unsigned int mtu = 0;
+		status = dc_iostream_ioctl (iostream, DC_IOCTL_BLE_GET_MTU, &mtu, sizeof(mtu));
+		if (status == DC_STATUS_SUCCESS && mtu > SZ_PACKET_BLE) {
+			device->packetsize = mtu < SZ_PACKET_MAX ? mtu : SZ_PACKET_MAX;
+		}
+		status = DC_STATUS_SUCCESS;
+	}
+
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_iostream_configure (device->iostream, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -685,6 +733,10 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 	// Download the compact logbook headers. If the firmware doesn't support
 	// compact headers yet, fallback to downloading the full logbook headers.
 	// This is slower, but also works for older firmware versions.
+	// Both commands always return the entire table. There is no command to
+	// read a single header slot, so a copy of the table from a previous
+	// download can't reduce the transfer: the table is needed to find the
+	// slots which changed. With the compact headers, it's only 4KB.
 	unsigned int compact = 1;
 	rc = hw_ostc3_transfer (device, &progress, COMPACT,
               NULL, 0, header, RB_LOGBOOK_SIZE_COMPACT * RB_LOGBOOK_COUNT, NODELAY);
@@ -761,6 +813,24 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 		if (memcmp (header + offset + logbook->fingerprint, device->fingerprint, sizeof (device->fingerprint)) == 0)
 			break;
 
+		// Skip the dives of an interrupted download.
+		if (device_journal_skip (abstract, header + offset + logbook->fingerprint, sizeof (device->fingerprint)))
+			continue;
+
+		// Check the download limits. The fingerprint is the date and
+		// time of the dive, which is the end of the dive for the older
+		// logbook versions.
+		const unsigned char *p = header + offset + logbook->fingerprint;
+		dc_datetime_t datetime = {0};
+		datetime.year = p[0] + 2000;
+		datetime.month = p[1];
+		datetime.day = p[2];
+		datetime.hour = p[3];
+		datetime.minute = p[4];
+		datetime.timezone = DC_TIMEZONE_NONE;
+		if (device_limits_reached (abstract, ndives, &datetime))
+			break;
+
 		if (length > maxsize)
 			maxsize = length;
 		size += length;
@@ -770,6 +840,7 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 
 	// Update and emit a progress event.
 	progress.maximum = (logbook->size * RB_LOGBOOK_COUNT) + size + ndives;
+	device_set_phase (abstract, DC_PHASE_PROFILE);
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
 	// Finish immediately if there are no dives available.
@@ -786,7 +857,12 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Download the dives.
+	// Download the dives. The block read command could fetch the profile
+	// data in larger chunks, but it's only available in service mode,
+	// and the layout of the profile ringbuffer in the external flash is
+	// not documented. The per dive command also returns only the data
+	// of the dive itself, so the only overhead is a single command per
+	// dive.
 	for (unsigned int i = 0; i < ndives; ++i) {
 		unsigned int idx = dive[i];
 		unsigned int offset = idx * logbook->size;
@@ -1577,6 +1653,59 @@ hw_ostc3_device_read (dc_device_t *abstract, unsigned int address, unsigned char
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+hw_ostc3_device_read_multi (dc_device_t *abstract, const dc_device_range_t ranges[], unsigned int count)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if ((ranges[i].address % SZ_FIRMWARE_BLOCK != 0) ||
+			(ranges[i].size % SZ_FIRMWARE_BLOCK != 0)) {
+			ERROR (abstract->context, "Address or size not aligned to the page size!");
+			return DC_STATUS_INVALIDARGS;
+		}
+	}
+
+	// Make sure the device is in service mode.
+	status = hw_ostc3_device_init (device, SERVICE);
+	if (status != DC_STATUS_SUCCESS) {
+		return status;
+	}
+
+	if (device->hardware == OSTC4) {
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	unsigned int i = 0;
+	while (i < count) {
+		unsigned int address = ranges[i].address;
+		unsigned char *data = ranges[i].data;
+		unsigned int size = ranges[i].size;
+
+		// Merge adjacent ranges into a single block read. The size of a
+		// block read is limited to 24 bits.
+		unsigned int n = i + 1;
+		while (n < count &&
+			ranges[n].address == address + size &&
+			ranges[n].data == data + size &&
+			size + ranges[n].size <= 0xFFFFFF) {
+			size += ranges[n].size;
+			n++;
+		}
+
+		status = hw_ostc3_firmware_block_read (device, address, data, size);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read block.");
+			return status;
+		}
+
+		i = n;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 hw_ostc3_device_write (dc_device_t *abstract, unsigned int address, const unsigned char data[], unsigned int size)
 {
@@ -1622,36 +1751,22 @@ hw_ostc3_device_write (dc_device_t *abstract, unsigned int address, const unsign
 }
 
 static dc_status_t
-hw_ostc3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
+hw_ostc3_device_dump_fixed (hw_ostc3_device_t *device, unsigned char data[], unsigned int size)
 {
-	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+	dc_device_t *abstract = (dc_device_t *) device;
 
 	// Enable progress notifications.
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = SZ_MEMORY;
+	progress.maximum = size;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	// Make sure the device is in service mode
-	dc_status_t rc = hw_ostc3_device_init (device, SERVICE);
-	if (rc != DC_STATUS_SUCCESS) {
-		return rc;
-	}
-
-	// Allocate the required amount of memory.
-	if (!dc_buffer_resize (buffer, SZ_MEMORY)) {
-		ERROR (abstract->context, "Insufficient buffer space available.");
-		return DC_STATUS_NOMEMORY;
-	}
-
-	unsigned char *data = dc_buffer_get_data (buffer);
-
 	unsigned int nbytes = 0;
-	while (nbytes < SZ_MEMORY) {
+	while (nbytes < size) {
 		// packet size. Can be almost arbitrary size.
 		unsigned int len = SZ_FIRMWARE_BLOCK;
 
 		// Read a block
-		rc = hw_ostc3_firmware_block_read (device, nbytes, data + nbytes, len);
+		dc_status_t rc = hw_ostc3_firmware_block_read (device, nbytes, data + nbytes, len);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read block.");
 			return rc;
@@ -1666,3 +1781,33 @@ hw_ostc3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	return DC_STATUS_SUCCESS;
 }
+
+static dc_status_t
+hw_ostc3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
+{
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+
+	// Make sure the device is in service mode
+	dc_status_t rc = hw_ostc3_device_init (device, SERVICE);
+	if (rc != DC_STATUS_SUCCESS) {
+		return rc;
+	}
+
+	// Allocate the required amount of memory.
+	if (!dc_buffer_resize (buffer, SZ_MEMORY)) {
+		ERROR (abstract->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// The adaptive block size has not been verified with the OSTC4, which
+	// keeps the fixed size blocks.
+	if (device->hardware == OSTC4) {
+		return hw_ostc3_device_dump_fixed (device,
+			dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
+	}
+
+	// The block read command supports almost arbitrary sizes, so let the
+	// block size adapt to the speed and reliability of the transport.
+	return device_dump_read_adaptive (abstract, dc_buffer_get_data (buffer),
+		dc_buffer_get_size (buffer), SZ_FIRMWARE_BLOCK, SZ_DUMP_BLOCK);
+}
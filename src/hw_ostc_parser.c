@@ -28,6 +28,8 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "array.h"
+#include "reader.h"
+#include "cache.h"
 
 #define ISINSTANCE(parser) dc_parser_isinstance((parser), &hw_ostc_parser_vtable)
 
@@ -119,12 +121,22 @@ typedef struct hw_ostc_parser_t {
 	unsigned int initial_setpoint;
 	unsigned int initial_cns;
 	hw_ostc_gasmix_t gasmix[NGASMIXES];
+	// Samples recorded during the first pass over the profile.
+	dc_buffer_t *samples;
+	unsigned int recorded;
 } hw_ostc_parser_t;
 
+typedef struct hw_ostc_recorder_t {
+	dc_buffer_t *buffer;
+	dc_sample_callback_t callback;
+	void *userdata;
+} hw_ostc_recorder_t;
+
 static dc_status_t hw_ostc_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
 static dc_status_t hw_ostc_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t hw_ostc_parser_destroy (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	sizeof(hw_ostc_parser_t),
@@ -133,7 +145,7 @@ static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	hw_ostc_parser_get_datetime, /* datetime */
 	hw_ostc_parser_get_field, /* fields */
 	hw_ostc_parser_samples_foreach, /* samples_foreach */
-	NULL /* destroy */
+	hw_ostc_parser_destroy /* destroy */
 };
 
 static const hw_ostc_layout_t hw_ostc_layout_ostc = {
@@ -342,6 +354,16 @@ hw_ostc_parser_create_internal (dc_parser_t **out, dc_context_t *context, unsign
 		parser->gasmix[i].oxygen = 0;
 		parser->gasmix[i].helium = 0;
 	}
+	parser->recorded = 0;
+
+	// Allocate the sample buffer. Without the heap, the samples are
+	// decoded again instead of being replayed.
+	parser->samples = NULL;
+	if (!parser->base.scratch && (parser->samples = dc_buffer_new (0)) == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		dc_parser_deallocate ((dc_parser_t *) parser);
+		return DC_STATUS_NOMEMORY;
+	}
 
 	*out = (dc_parser_t *) parser;
 
@@ -380,6 +402,19 @@ hw_ostc_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsig
 		parser->gasmix[i].oxygen = 0;
 		parser->gasmix[i].helium = 0;
 	}
+	parser->recorded = 0;
+	dc_buffer_clear (parser->samples);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+hw_ostc_parser_destroy (dc_parser_t *abstract)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
+	dc_buffer_free (parser->samples);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -458,9 +493,11 @@ hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	// Cache the profile data.
+	// Cache the profile data. The manual gas mixes are only found in
+	// the profile.
 	if (parser->cached < PROFILE) {
-		rc = hw_ostc_parser_samples_foreach (abstract, NULL, NULL);
+		rc = sample_profile_walk (abstract, hw_ostc_parser_samples_foreach,
+			PARSER_FIELD (DC_FIELD_GASMIX_COUNT) | PARSER_FIELD (DC_FIELD_GASMIX), type);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 	}
@@ -580,7 +617,7 @@ hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned
 
 
 static dc_status_t
-hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+hw_ostc_parser_decode (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
 {
 	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
 	const unsigned char *data = abstract->data;
@@ -692,7 +729,11 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 	unsigned int offset = header;
 	if (version == 0x23 || version == 0x24)
 		offset += 5 + 3 * nconfig;
-	while (offset + 3 <= size) {
+
+	dc_reader_t reader;
+	dc_reader_init (&reader, data, size);
+	dc_reader_skip (&reader, offset);
+	while (dc_reader_remaining (&reader) >= 3) {
 		dc_sample_value_t sample = {0};
 
 		nsamples++;
@@ -721,17 +762,17 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 		}
 
 		// Depth (1/100 m).
-		unsigned int depth = array_uint16_le (data + offset);
+		unsigned int depth = dc_reader_u16le (&reader);
 		sample.depth = depth / 100.0;
 		if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
-		offset += 2;
 
 		// Extended sample info.
-		unsigned int length =  data[offset] & 0x7F;
-		offset += 1;
+		unsigned int flags = dc_reader_u8 (&reader);
+		unsigned int length = flags & 0x7F;
 
 		// Check for buffer overflows.
-		if (offset + length > size) {
+		dc_reader_t record;
+		if (!dc_reader_split (&reader, &record, length)) {
 			ERROR (abstract->context, "Buffer overflow detected!");
 			return DC_STATUS_DATAFORMAT;
 		}
@@ -739,17 +780,16 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 		// Get the event byte(s).
 		unsigned int nbits = 0;
 		unsigned int events = 0;
-		while (data[offset - 1] & 0x80) {
+		while (flags & 0x80) {
 			if (nbits && version != 0x23 && version != 0x24)
 				break;
-			if (length < 1) {
+			if (dc_reader_remaining (&record) < 1) {
 				ERROR (abstract->context, "Buffer overflow detected!");
 				return DC_STATUS_DATAFORMAT;
 			}
-			events |= data[offset] << nbits;
+			flags = dc_reader_u8 (&record);
+			events |= flags << nbits;
 			nbits += 8;
-			offset++;
-			length--;
 		}
 
 		// Alarms
@@ -786,12 +826,12 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 		// Manual Gas Set & Change
 		if (events & 0x10) {
-			if (length < 2) {
+			if (dc_reader_remaining (&record) < 2) {
 				ERROR (abstract->context, "Buffer overflow detected!");
 				return DC_STATUS_DATAFORMAT;
 			}
-			unsigned int o2 = data[offset];
-			unsigned int he = data[offset + 1];
+			unsigned int o2 = dc_reader_u8 (&record);
+			unsigned int he = dc_reader_u8 (&record);
 			unsigned int idx = hw_ostc_find_gasmix (parser, o2, he, MANUAL);
 			if (idx >= parser->ngasmixes) {
 				if (idx >= NGASMIXES) {
@@ -805,17 +845,15 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 			sample.gasmix = idx;
 			if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
-			offset += 2;
-			length -= 2;
 		}
 
 		// Gas Change
 		if (events & 0x20) {
-			if (length < 1) {
+			if (dc_reader_remaining (&record) < 1) {
 				ERROR (abstract->context, "Buffer overflow detected!");
 				return DC_STATUS_DATAFORMAT;
 			}
-			unsigned int idx = data[offset];
+			unsigned int idx = dc_reader_u8 (&record);
 			if (idx < 1 || idx > parser->ngasmixes) {
 				ERROR(abstract->context, "Invalid gas mix.");
 				return DC_STATUS_DATAFORMAT;
@@ -824,32 +862,28 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 			sample.gasmix = idx;
 			if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
 			tank = idx;
-			offset++;
-			length--;
 		}
 
 		if (version == 0x23 || version == 0x24) {
 			// SetPoint Change
 			if (events & 0x40) {
-				if (length < 1) {
+				if (dc_reader_remaining (&record) < 1) {
 					ERROR (abstract->context, "Buffer overflow detected!");
 					return DC_STATUS_DATAFORMAT;
 				}
-				sample.setpoint = data[offset] / 100.0;
+				sample.setpoint = dc_reader_u8 (&record) / 100.0;
 				if (callback) callback (DC_SAMPLE_SETPOINT, sample, userdata);
-				offset++;
-				length--;
 			}
 
 			// Bailout Event
 			if (events & 0x0100) {
-				if (length < 2) {
+				if (dc_reader_remaining (&record) < 2) {
 					ERROR (abstract->context, "Buffer overflow detected!");
 					return DC_STATUS_DATAFORMAT;
 				}
 
-				unsigned int o2 = data[offset];
-				unsigned int he = data[offset + 1];
+				unsigned int o2 = dc_reader_u8 (&record);
+				unsigned int he = dc_reader_u8 (&record);
 				unsigned int idx = hw_ostc_find_gasmix (parser, o2, he, MANUAL);
 				if (idx >= parser->ngasmixes) {
 					if (idx >= NGASMIXES) {
@@ -863,15 +897,13 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 				sample.gasmix = idx;
 				if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
-				offset += 2;
-				length -= 2;
 			}
 		}
 
 		// Extended sample info.
 		for (unsigned int i = 0; i < nconfig; ++i) {
 			if (info[i].divisor && (nsamples % info[i].divisor) == 0) {
-				if (length < info[i].size) {
+				if (dc_reader_remaining (&record) < info[i].size) {
 					// Due to a bug in the hwOS Tech firmware v3.03 to v3.08, and
 					// the hwOS Sport firmware v10.57 to v10.63, the ppO2 divisor
 					// is sometimes not correctly reset to zero when no ppO2
@@ -887,12 +919,15 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 					return DC_STATUS_DATAFORMAT;
 				}
 
+				dc_reader_t field;
+				dc_reader_split (&record, &field, info[i].size);
+
 				unsigned int ppo2[3] = {0};
 				unsigned int count = 0;
 				unsigned int value = 0;
 				switch (info[i].type) {
 				case TEMPERATURE:
-					value = array_uint16_le (data + offset);
+					value = dc_reader_u16le (&field);
 					sample.temperature = value / 10.0;
 					if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
 					break;
@@ -901,22 +936,22 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 					// all OSTC4 dives with a firmware older than version 1.0.8.
 					if (parser->model == OSTC4 && firmware < OSTC4FW(1,0,8,0))
 						break;
-					if (data[offset]) {
+					value = dc_reader_u8 (&field);
+					if (value) {
 						sample.deco.type = DC_DECO_DECOSTOP;
-						sample.deco.depth = data[offset];
+						sample.deco.depth = value;
 					} else {
 						sample.deco.type = DC_DECO_NDL;
 						sample.deco.depth = 0.0;
 					}
-					sample.deco.time = data[offset + 1] * 60;
+					sample.deco.time = dc_reader_u8 (&field) * 60;
 					if (callback) callback (DC_SAMPLE_DECO, sample, userdata);
 					break;
 				case PPO2:
 					for (unsigned int j = 0; j < 3; ++j) {
-						if (info[i].size == 3) {
-							ppo2[j] = data[offset + j];
-						} else {
-							ppo2[j] = data[offset + j * 3];
+						ppo2[j] = dc_reader_u8 (&field);
+						if (info[i].size != 3) {
+							dc_reader_skip (&field, 2);
 						}
 						if (ppo2[j] != 0)
 							count++;
@@ -930,13 +965,13 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 					break;
 				case CNS:
 					if (info[i].size == 2)
-						sample.cns = array_uint16_le (data + offset) / 100.0;
+						sample.cns = dc_reader_u16le (&field) / 100.0;
 					else
-						sample.cns = data[offset] / 100.0;
+						sample.cns = dc_reader_u8 (&field) / 100.0;
 					if (callback) callback (DC_SAMPLE_CNS, sample, userdata);
 					break;
 				case TANK:
-					value = array_uint16_le (data + offset);
+					value = dc_reader_u16le (&field);
 					if (value != 0) {
 						sample.pressure.tank = tank;
 						sample.pressure.value = value;
@@ -952,34 +987,29 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 				default: // Not yet used.
 					break;
 				}
-
-				offset += info[i].size;
-				length -= info[i].size;
 			}
 		}
 
 		if (version != 0x23 && version != 0x24) {
 			// SetPoint Change
 			if (events & 0x40) {
-				if (length < 1) {
+				if (dc_reader_remaining (&record) < 1) {
 					ERROR (abstract->context, "Buffer overflow detected!");
 					return DC_STATUS_DATAFORMAT;
 				}
-				sample.setpoint = data[offset] / 100.0;
+				sample.setpoint = dc_reader_u8 (&record) / 100.0;
 				if (callback) callback (DC_SAMPLE_SETPOINT, sample, userdata);
-				offset++;
-				length--;
 			}
 
 			// Bailout Event
 			if (events & 0x80) {
-				if (length < 2) {
+				if (dc_reader_remaining (&record) < 2) {
 					ERROR (abstract->context, "Buffer overflow detected!");
 					return DC_STATUS_DATAFORMAT;
 				}
 
-				unsigned int o2 = data[offset];
-				unsigned int he = data[offset + 1];
+				unsigned int o2 = dc_reader_u8 (&record);
+				unsigned int he = dc_reader_u8 (&record);
 				unsigned int idx = hw_ostc_find_gasmix (parser, o2, he, MANUAL);
 				if (idx >= parser->ngasmixes) {
 					if (idx >= NGASMIXES) {
@@ -993,18 +1023,17 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 				sample.gasmix = idx;
 				if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
-				offset += 2;
-				length -= 2;
 			}
 		}
 
 		// Skip remaining sample bytes (if any).
-		if (length) {
-			WARNING (abstract->context, "Remaining %u bytes skipped.", length);
+		if (dc_reader_remaining (&record)) {
+			WARNING (abstract->context, "Remaining %u bytes skipped.", dc_reader_remaining (&record));
 		}
-		offset += length;
 	}
 
+	offset = dc_reader_offset (&reader);
+
 	if (offset + 2 > size || data[offset] != 0xFD || data[offset + 1] != 0xFD) {
 		ERROR (abstract->context, "Invalid end marker found!");
 		return DC_STATUS_DATAFORMAT;
@@ -1014,3 +1043,63 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 	return DC_STATUS_SUCCESS;
 }
+
+
+static void
+hw_ostc_parser_record (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	hw_ostc_recorder_t *recorder = (hw_ostc_recorder_t *) userdata;
+
+	if (recorder->buffer) {
+		unsigned char record[DC_PARSER_CACHE_RECORD_MAX];
+		size_t n = dc_parser_cache_sample_encode (record, type, &value);
+		if (!dc_buffer_append (recorder->buffer, record, n) ||
+			(type == DC_SAMPLE_VENDOR && value.vendor.size &&
+			!dc_buffer_append (recorder->buffer, (const unsigned char *) value.vendor.data, value.vendor.size))) {
+			// Stop recording, but keep passing the samples.
+			dc_buffer_clear (recorder->buffer);
+			recorder->buffer = NULL;
+		}
+	}
+
+	if (recorder->callback)
+		recorder->callback (type, value, recorder->userdata);
+}
+
+
+static dc_status_t
+hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
+	// Replay the samples of a previous pass over the profile, for example
+	// the one needed by the fields, instead of decoding them again.
+	if (parser->recorded) {
+		const unsigned char *data = dc_buffer_get_data (parser->samples);
+		size_t size = dc_buffer_get_size (parser->samples);
+		size_t offset = 0;
+		while (offset < size) {
+			dc_sample_type_t type;
+			dc_sample_value_t value;
+			size_t n = dc_parser_cache_sample_decode (data + offset, size - offset, &type, &value);
+			if (n == 0)
+				break;
+
+			if (callback)
+				callback (type, value, userdata);
+
+			offset += n;
+		}
+
+		return DC_STATUS_SUCCESS;
+	}
+
+	hw_ostc_recorder_t recorder = {parser->samples, callback, userdata};
+	dc_buffer_clear (parser->samples);
+
+	dc_status_t rc = hw_ostc_parser_decode (abstract, hw_ostc_parser_record, &recorder);
+	if (rc == DC_STATUS_SUCCESS && recorder.buffer != NULL)
+		parser->recorded = 1;
+
+	return rc;
+}
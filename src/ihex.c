@@ -24,14 +24,22 @@
 #include <string.h>
 #include <stdio.h>
 
+#include <libdivecomputer/buffer.h>
+
 #include "ihex.h"
 #include "context-private.h"
 #include "checksum.h"
 #include "array.h"
 
+/*
+ * The file is small, and is read into memory at once. The records are
+ * parsed directly from the buffer, instead of with a number of small
+ * reads for every record.
+ */
 struct dc_ihex_file_t {
 	dc_context_t *context;
-	FILE *fp;
+	dc_buffer_t *buffer;
+	size_t offset;
 };
 
 dc_status_t
@@ -51,14 +59,46 @@ dc_ihex_file_open (dc_ihex_file_t **result, dc_context_t *context, const char *f
 	}
 
 	file->context = context;
+	file->offset = 0;
 
-	file->fp = fopen (filename, "rb");
-	if (file->fp == NULL) {
+	file->buffer = dc_buffer_new (0);
+	if (file->buffer == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		free (file);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	FILE *fp = fopen (filename, "rb");
+	if (fp == NULL) {
 		ERROR (context, "Failed to open the file.");
+		dc_buffer_free (file->buffer);
 		free (file);
 		return DC_STATUS_IO;
 	}
 
+	// Read the entire file into the buffer.
+	size_t n = 0;
+	unsigned char block[4096] = {0};
+	while ((n = fread (block, 1, sizeof (block), fp)) > 0) {
+		if (!dc_buffer_append (file->buffer, block, n)) {
+			ERROR (context, "Insufficient buffer space available.");
+			fclose (fp);
+			dc_buffer_free (file->buffer);
+			free (file);
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	if (ferror (fp)) {
+		ERROR (context, "Failed to read the file.");
+		fclose (fp);
+		dc_buffer_free (file->buffer);
+		free (file);
+		return DC_STATUS_IO;
+	}
+
+	fclose (fp);
+
 	*result = file;
 
 	return DC_STATUS_SUCCESS;
@@ -67,42 +107,40 @@ dc_ihex_file_open (dc_ihex_file_t **result, dc_context_t *context, const char *f
 dc_status_t
 dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 {
-	unsigned char ascii[9 + 2 * 255 + 2] = {0};
 	unsigned char data[4 + 255 + 1] = {0};
 	unsigned int type, length, address;
 	unsigned char csum_a, csum_b;
-	size_t n;
 
 	if (file == NULL || entry == NULL) {
 		ERROR (file ? file->context : NULL, "Invalid arguments.");
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	/* Read the start code. */
+	const unsigned char *ascii = dc_buffer_get_data (file->buffer);
+	size_t size = dc_buffer_get_size (file->buffer);
+
+	/* Find the start code. */
 	while (1) {
-		n = fread (ascii, 1, 1, file->fp);
-		if (n != 1) {
-			if (feof (file->fp)) {
-				return DC_STATUS_DONE;
-			} else {
-				ERROR (file->context, "Failed to read the start code.");
-				return DC_STATUS_IO;
-			}
-		}
+		if (file->offset >= size)
+			return DC_STATUS_DONE;
 
-		if (ascii[0] == ':')
+		if (ascii[file->offset] == ':')
 			break;
 
 		/* Ignore CR and LF characters. */
-		if (ascii[0] != '\n' && ascii[0] != '\r') {
-			ERROR (file->context, "Unexpected character (0x%02x).", ascii[0]);
+		if (ascii[file->offset] != '\n' && ascii[file->offset] != '\r') {
+			ERROR (file->context, "Unexpected character (0x%02x).", ascii[file->offset]);
 			return DC_STATUS_DATAFORMAT;
 		}
+
+		file->offset++;
 	}
 
-	/* Read the record length, address and type. */
-	n = fread (ascii + 1, 1, 8, file->fp);
-	if (n != 8) {
+	ascii += file->offset;
+	size -= file->offset;
+
+	/* Check the record length, address and type. */
+	if (size < 9) {
 		ERROR (file->context, "Failed to read the header.");
 		return DC_STATUS_IO;
 	}
@@ -116,9 +154,8 @@ dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 	/* Get the record length. */
 	length = data[0];
 
-	/* Read the record payload. */
-	n = fread (ascii + 9, 1, 2 * length + 2, file->fp);
-	if (n != 2 * length + 2) {
+	/* Check the record payload. */
+	if (size < 9 + 2 * length + 2) {
 		ERROR (file->context, "Failed to read the data.");
 		return DC_STATUS_IO;
 	}
@@ -169,6 +206,9 @@ dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 		}
 	}
 
+	/* Advance to the next record. */
+	file->offset += 9 + 2 * length + 2;
+
 	/* Set the record fields. */
 	entry->type = type;
 	entry->address = address;
@@ -189,7 +229,7 @@ dc_ihex_file_reset (dc_ihex_file_t *file)
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	rewind (file->fp);
+	file->offset = 0;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -198,7 +238,7 @@ dc_status_t
 dc_ihex_file_close (dc_ihex_file_t *file)
 {
 	if (file) {
-		fclose (file->fp);
+		dc_buffer_free (file->buffer);
 		free (file);
 	}
 
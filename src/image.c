@@ -0,0 +1,213 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "context-private.h"
+#include "device-private.h"
+#include "registry.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+#define SZ_FINGERPRINT 32
+
+/*
+ * The image device replays a memory dump, previously saved with
+ * dc_device_dump, through the dive extraction of the backend. Only the
+ * backends where the dives are extracted from the memory dump are
+ * supported. The extraction runs without the backend device, so the
+ * fingerprint is checked here, against the fingerprint reported for
+ * each dive.
+ */
+
+typedef dc_status_t (*dc_image_extract_t) (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
+
+typedef struct dc_image_device_t {
+	dc_device_t base;
+	const unsigned char *data;
+	unsigned int size;
+	dc_image_extract_t extract;
+	unsigned char fingerprint[SZ_FINGERPRINT];
+	unsigned int fsize;
+} dc_image_device_t;
+
+typedef struct dc_image_foreach_t {
+	dc_image_device_t *device;
+	dc_dive_callback_t callback;
+	void *userdata;
+} dc_image_foreach_t;
+
+static dc_status_t dc_image_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
+static dc_status_t dc_image_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
+static dc_status_t dc_image_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
+static dc_status_t dc_image_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+
+#define DC_IMAGE_VTABLE(family) { \
+	sizeof(dc_image_device_t), \
+	family, \
+	dc_image_device_set_fingerprint, /* set_fingerprint */ \
+	dc_image_device_read, /* read */ \
+	NULL, /* read_multi */ \
+	NULL, /* write */ \
+	dc_image_device_dump, /* dump */ \
+	dc_image_device_foreach, /* foreach */ \
+	NULL, /* timesync */ \
+	NULL, /* keepalive */ \
+	NULL /* close */ \
+}
+
+static const dc_device_vtable_t dc_image_device_vtables[] = {
+	DC_IMAGE_VTABLE (DC_FAMILY_SUUNTO_SOLUTION),
+	DC_IMAGE_VTABLE (DC_FAMILY_REEFNET_SENSUS),
+	DC_IMAGE_VTABLE (DC_FAMILY_REEFNET_SENSUSPRO),
+	DC_IMAGE_VTABLE (DC_FAMILY_UWATEC_ALADIN),
+	DC_IMAGE_VTABLE (DC_FAMILY_UWATEC_MEMOMOUSE),
+	DC_IMAGE_VTABLE (DC_FAMILY_UWATEC_SMART),
+	DC_IMAGE_VTABLE (DC_FAMILY_HW_OSTC),
+	DC_IMAGE_VTABLE (DC_FAMILY_CRESSI_LEONARDO),
+	DC_IMAGE_VTABLE (DC_FAMILY_SHEARWATER_PREDATOR),
+	DC_IMAGE_VTABLE (DC_FAMILY_DIVERITE_NITEKQ),
+};
+
+dc_status_t
+dc_device_image_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descriptor, const unsigned char data[], unsigned int size)
+{
+	dc_image_device_t *device = NULL;
+
+	if (out == NULL || descriptor == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	// Find the backend of the dive computer.
+	dc_family_t family = dc_descriptor_get_type (descriptor);
+	unsigned int i = 0;
+	while (i < C_ARRAY_SIZE (dc_image_device_vtables) && dc_image_device_vtables[i].type != family)
+		i++;
+	const dc_backend_t *backend = dc_backend_find (family);
+	if (i == C_ARRAY_SIZE (dc_image_device_vtables) || backend == NULL || backend->extract_dives == NULL) {
+		ERROR (context, "Memory images are not supported for this dive computer.");
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	// Allocate memory.
+	device = (dc_image_device_t *) dc_device_allocate (context, &dc_image_device_vtables[i]);
+	if (device == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Set the default values.
+	device->data = data;
+	device->size = size;
+	device->extract = backend->extract_dives;
+	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+	device->fsize = 0;
+
+	*out = (dc_device_t *) device;
+
+	return DC_STATUS_SUCCESS;
+}
+
+int
+device_image_get (dc_device_t *abstract, const unsigned char **data, unsigned int *size)
+{
+	dc_image_device_t *device = (dc_image_device_t *) abstract;
+
+	if (abstract == NULL ||
+		abstract->vtable < dc_image_device_vtables ||
+		abstract->vtable >= dc_image_device_vtables + C_ARRAY_SIZE (dc_image_device_vtables))
+		return 0;
+
+	*data = device->data;
+	*size = device->size;
+
+	return 1;
+}
+
+static dc_status_t
+dc_image_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size)
+{
+	dc_image_device_t *device = (dc_image_device_t *) abstract;
+
+	if (size > sizeof (device->fingerprint))
+		return DC_STATUS_INVALIDARGS;
+
+	if (size)
+		memcpy (device->fingerprint, data, size);
+	device->fsize = size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_image_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size)
+{
+	dc_image_device_t *device = (dc_image_device_t *) abstract;
+
+	if (address > device->size || size > device->size - address)
+		return DC_STATUS_INVALIDARGS;
+
+	memcpy (data, device->data + address, size);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_image_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
+{
+	dc_image_device_t *device = (dc_image_device_t *) abstract;
+
+	if (!dc_buffer_append (buffer, device->data, device->size)) {
+		ERROR (abstract->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static int
+dc_image_device_foreach_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dc_image_foreach_t *foreach = (dc_image_foreach_t *) userdata;
+	dc_image_device_t *device = foreach->device;
+
+	// Stop at the most recent dive of the previous download.
+	if (device->fsize && device->fsize == fsize &&
+		memcmp (device->fingerprint, fingerprint, fsize) == 0)
+		return 0;
+
+	if (foreach->callback)
+		return foreach->callback (data, size, fingerprint, fsize, foreach->userdata);
+
+	return 1;
+}
+
+static dc_status_t
+dc_image_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	dc_image_device_t *device = (dc_image_device_t *) abstract;
+
+	dc_image_foreach_t foreach;
+	foreach.device = device;
+	foreach.callback = callback;
+	foreach.userdata = userdata;
+
+	return device->extract (NULL, device->data, device->size, dc_image_device_foreach_cb, &foreach);
+}
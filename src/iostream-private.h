@@ -26,6 +26,9 @@
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/iostream.h>
 
+#include "context-private.h"
+#include "timer.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -36,6 +39,21 @@ struct dc_iostream_t {
 	const dc_iostream_vtable_t *vtable;
 	dc_context_t *context;
 	dc_transport_t transport;
+	/* The I/O statistics. */
+	dc_timer_t *timer;
+	dc_iostream_stats_t stats;
+	/* The pending asynchronous read. */
+	unsigned char *async_data;
+	size_t async_size;
+	size_t async_nbytes;
+	dc_iostream_callback_t async_callback;
+	void *async_userdata;
+	/* The buffered write data. */
+	unsigned char *wbuffer;
+	size_t wcapacity;
+	size_t wlength;
+	/* The address of the remote device, or empty if unknown. */
+	char address[64];
 };
 
 struct dc_iostream_vtable_t {
@@ -57,8 +75,14 @@ struct dc_iostream_vtable_t {
 
 	dc_status_t (*poll) (dc_iostream_t *iostream, int timeout);
 
+	dc_status_t (*get_fd) (dc_iostream_t *iostream, int *fd);
+
 	dc_status_t (*read) (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 
+	dc_status_t (*read_lend) (dc_iostream_t *iostream, const unsigned char **data, size_t *size);
+
+	dc_status_t (*read_return) (dc_iostream_t *iostream, const unsigned char *data);
+
 	dc_status_t (*write) (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 
 	dc_status_t (*ioctl) (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
@@ -69,6 +93,8 @@ struct dc_iostream_vtable_t {
 
 	dc_status_t (*sleep) (dc_iostream_t *iostream, unsigned int milliseconds);
 
+	dc_status_t (*interrupt) (dc_iostream_t *iostream);
+
 	dc_status_t (*close) (dc_iostream_t *iostream);
 };
 
@@ -81,6 +107,56 @@ dc_iostream_deallocate (dc_iostream_t *iostream);
 int
 dc_iostream_isinstance (dc_iostream_t *iostream, const dc_iostream_vtable_t *vtable);
 
+/*
+ * Read the next packet without copying, from a buffer owned by the I/O
+ * stream. The buffer remains valid until it is handed back with
+ * dc_iostream_read_return. Streams without support for lending buffers
+ * return DC_STATUS_UNSUPPORTED, and need a regular read instead.
+ */
+dc_status_t
+dc_iostream_read_lend (dc_iostream_t *iostream, const unsigned char **data, size_t *size);
+
+dc_status_t
+dc_iostream_read_return (dc_iostream_t *iostream, const unsigned char *data);
+
+/*
+ * Enable or disable (size zero) the write buffering. Small writes are
+ * collected in a buffer of the given size, and sent together with a
+ * single write before the next read, poll, flush, sleep or change of
+ * the line settings. Buffering is disabled by default, such that
+ * protocols relying on the timing of individual writes are unaffected.
+ */
+dc_status_t
+dc_iostream_set_buffering (dc_iostream_t *iostream, size_t size);
+
+/*
+ * The address which identifies the remote device, for example the
+ * bluetooth address. Connections where the remote device can change
+ * without the address changing (like a serial port) have no address.
+ * BLE connections have no address either, because the name of the
+ * device is shared by all units of the same model.
+ */
+void
+dc_iostream_set_address (dc_iostream_t *iostream, const char *format, ...) ATTR_FORMAT_PRINTF(2, 3);
+
+const char *
+dc_iostream_get_address (dc_iostream_t *iostream);
+
+/*
+ * The shortest connection interval (microseconds) allowed for BLE.
+ */
+#define BLE_INTERVAL_MIN 7500
+
+/*
+ * Ask the BLE stack for the preferred connection parameters of a
+ * backend, with the DC_IOCTL_BLE_SET_* requests. The parameters are
+ * only hints: zero values are not requested, and the requests are
+ * ignored for other transports, or when the application doesn't
+ * support them.
+ */
+void
+dc_iostream_ble_prefer (dc_iostream_t *iostream, unsigned int mtu, unsigned int interval, unsigned int noresponse);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -21,13 +21,20 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
 #include <assert.h>
 
 #include <libdivecomputer/ioctl.h>
+#include <libdivecomputer/ble.h>
 
+#include "common-private.h"
 #include "iostream-private.h"
 #include "context-private.h"
 #include "platform.h"
+#include "allocator.h"
+#include "trace.h"
 
 dc_iostream_t *
 dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable, dc_transport_t transport)
@@ -38,7 +45,7 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 	assert(vtable->size >= sizeof(dc_iostream_t));
 
 	// Allocate memory.
-	iostream = (dc_iostream_t *) malloc (vtable->size);
+	iostream = (dc_iostream_t *) dc_malloc (vtable->size);
 	if (iostream == NULL) {
 		ERROR (context, "Failed to allocate memory.");
 		return iostream;
@@ -48,6 +55,22 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 	iostream->vtable = vtable;
 	iostream->context = context;
 	iostream->transport = transport;
+	memset (&iostream->stats, 0, sizeof (iostream->stats));
+	iostream->async_data = NULL;
+	iostream->async_size = 0;
+	iostream->async_nbytes = 0;
+	iostream->async_callback = NULL;
+	iostream->async_userdata = NULL;
+	iostream->wbuffer = NULL;
+	iostream->wcapacity = 0;
+	iostream->wlength = 0;
+	memset (iostream->address, 0, sizeof (iostream->address));
+
+	// Without a timer, the latencies are not recorded.
+	if (dc_timer_new (&iostream->timer) != DC_STATUS_SUCCESS) {
+		WARNING (context, "Failed to create a high resolution timer.");
+		iostream->timer = NULL;
+	}
 
 	return iostream;
 }
@@ -55,7 +78,124 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 void
 dc_iostream_deallocate (dc_iostream_t *iostream)
 {
-	free (iostream);
+	if (iostream == NULL)
+		return;
+
+	dc_timer_free (iostream->timer);
+	dc_free (iostream->wbuffer);
+	dc_free (iostream);
+}
+
+static void
+dc_iostream_stats_end (dc_iostream_t *iostream, unsigned int histogram[], const dc_timer_scope_t *scope, dc_status_t status)
+{
+	if (status == DC_STATUS_TIMEOUT)
+		iostream->stats.timeouts++;
+	else if (status != DC_STATUS_SUCCESS)
+		iostream->stats.errors++;
+
+	if (scope->timer == NULL)
+		return;
+
+	dc_usecs_t elapsed = dc_timer_scope_end (scope);
+
+	unsigned int i = 0;
+	while (elapsed >= 2 && i < DC_IOSTREAM_HISTOGRAM_SIZE - 1) {
+		elapsed >>= 1;
+		i++;
+	}
+
+	histogram[i]++;
+}
+
+dc_status_t
+dc_iostream_get_stats (dc_iostream_t *iostream, dc_iostream_stats_t *stats)
+{
+	if (iostream == NULL || stats == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	*stats = iostream->stats;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_iostream_write_raw (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual)
+{
+	dc_timer_scope_t scope;
+	dc_timer_scope_begin (&scope, iostream->timer);
+
+	TRACE2 (iostream_write_entry, iostream, size);
+
+	size_t nbytes = 0;
+	dc_status_t status = iostream->vtable->write (iostream, data, size, &nbytes);
+
+	TRACE3 (iostream_write_return, iostream, status, nbytes);
+
+	iostream->stats.writes++;
+	iostream->stats.bytes_out += nbytes;
+	dc_iostream_stats_end (iostream, iostream->stats.write_latency, &scope, status);
+
+	HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Write", (const unsigned char *) data, nbytes);
+
+	*actual = nbytes;
+
+	return status;
+}
+
+/*
+ * Send the buffered write data. The buffer is emptied, even on failure,
+ * because the data can't be resent reliably after a partial write.
+ */
+static dc_status_t
+dc_iostream_drain (dc_iostream_t *iostream)
+{
+	if (iostream == NULL || iostream->wlength == 0)
+		return DC_STATUS_SUCCESS;
+
+	size_t nbytes = 0;
+	dc_status_t status = dc_iostream_write_raw (iostream, iostream->wbuffer, iostream->wlength, &nbytes);
+	if (status == DC_STATUS_SUCCESS && nbytes != iostream->wlength) {
+		status = DC_STATUS_IO;
+	}
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (iostream->context, "Failed to send the buffered data (" DC_PRINTF_SIZE " of " DC_PRINTF_SIZE " bytes).",
+			nbytes, iostream->wlength);
+	}
+
+	iostream->wlength = 0;
+
+	return status;
+}
+
+dc_status_t
+dc_iostream_set_buffering (dc_iostream_t *iostream, size_t size)
+{
+	if (iostream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (size == iostream->wcapacity)
+		return DC_STATUS_SUCCESS;
+
+	unsigned char *buffer = NULL;
+	if (size) {
+		buffer = (unsigned char *) dc_malloc (size);
+		if (buffer == NULL) {
+			ERROR (iostream->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	dc_free (iostream->wbuffer);
+	iostream->wbuffer = buffer;
+	iostream->wcapacity = size;
+	iostream->wlength = 0;
+
+	return DC_STATUS_SUCCESS;
 }
 
 int
@@ -93,6 +233,10 @@ dc_iostream_set_break (dc_iostream_t *iostream, unsigned int value)
 	if (iostream == NULL || iostream->vtable->set_break == NULL)
 		return DC_STATUS_SUCCESS;
 
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	INFO (iostream->context, "Break: value=%i", value);
 
 	return iostream->vtable->set_break (iostream, value);
@@ -104,6 +248,10 @@ dc_iostream_set_dtr (dc_iostream_t *iostream, unsigned int value)
 	if (iostream == NULL || iostream->vtable->set_dtr == NULL)
 		return DC_STATUS_SUCCESS;
 
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	INFO (iostream->context, "DTR: value=%i", value);
 
 	return iostream->vtable->set_dtr (iostream, value);
@@ -115,6 +263,10 @@ dc_iostream_set_rts (dc_iostream_t *iostream, unsigned int value)
 	if (iostream == NULL || iostream->vtable->set_rts == NULL)
 		return DC_STATUS_SUCCESS;
 
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	INFO (iostream->context, "RTS: value=%i", value);
 
 	return iostream->vtable->set_rts (iostream, value);
@@ -151,6 +303,10 @@ dc_iostream_get_available (dc_iostream_t *iostream, size_t *value)
 		goto out;
 	}
 
+	status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		goto out;
+
 	status = iostream->vtable->get_available (iostream, &available);
 
 	INFO (iostream->context, "Available: value=" DC_PRINTF_SIZE, available);
@@ -168,6 +324,10 @@ dc_iostream_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned
 	if (iostream == NULL || iostream->vtable->configure == NULL)
 		return DC_STATUS_SUCCESS;
 
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	INFO (iostream->context, "Configure: baudrate=%i, databits=%i, parity=%i, stopbits=%i, flowcontrol=%i",
 		baudrate, databits, parity, stopbits, flowcontrol);
 
@@ -180,9 +340,21 @@ dc_iostream_poll (dc_iostream_t *iostream, int timeout)
 	if (iostream == NULL || iostream->vtable->poll == NULL)
 		return DC_STATUS_SUCCESS;
 
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	INFO (iostream->context, "Poll: value=%i", timeout);
 
-	return iostream->vtable->poll (iostream, timeout);
+	dc_timer_scope_t scope;
+	dc_timer_scope_begin (&scope, iostream->timer);
+
+	status = iostream->vtable->poll (iostream, timeout);
+
+	iostream->stats.polls++;
+	dc_iostream_stats_end (iostream, iostream->stats.poll_latency, &scope, status);
+
+	return status;
 }
 
 dc_status_t
@@ -195,8 +367,23 @@ dc_iostream_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actu
 		goto out;
 	}
 
+	status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		goto out;
+
+	dc_timer_scope_t scope;
+	dc_timer_scope_begin (&scope, iostream->timer);
+
+	TRACE2 (iostream_read_entry, iostream, size);
+
 	status = iostream->vtable->read (iostream, data, size, &nbytes);
 
+	TRACE3 (iostream_read_return, iostream, status, nbytes);
+
+	iostream->stats.reads++;
+	iostream->stats.bytes_in += nbytes;
+	dc_iostream_stats_end (iostream, iostream->stats.read_latency, &scope, status);
+
 	HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Read", (unsigned char *) data, nbytes);
 
 out:
@@ -206,6 +393,50 @@ out:
 	return status;
 }
 
+dc_status_t
+dc_iostream_read_lend (dc_iostream_t *iostream, const unsigned char **data, size_t *size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	const unsigned char *buffer = NULL;
+	size_t nbytes = 0;
+
+	if (iostream == NULL || iostream->vtable->read_lend == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_timer_scope_t scope;
+	dc_timer_scope_begin (&scope, iostream->timer);
+
+	status = iostream->vtable->read_lend (iostream, &buffer, &nbytes);
+
+	iostream->stats.reads++;
+	dc_iostream_stats_end (iostream, iostream->stats.read_latency, &scope, status);
+
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	iostream->stats.bytes_in += nbytes;
+
+	HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Read", buffer, nbytes);
+
+	*data = buffer;
+	*size = nbytes;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_iostream_read_return (dc_iostream_t *iostream, const unsigned char *data)
+{
+	if (iostream == NULL || iostream->vtable->read_return == NULL)
+		return DC_STATUS_SUCCESS;
+
+	return iostream->vtable->read_return (iostream, data);
+}
+
 dc_status_t
 dc_iostream_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual)
 {
@@ -216,9 +447,25 @@ dc_iostream_write (dc_iostream_t *iostream, const void *data, size_t size, size_
 		goto out;
 	}
 
-	status = iostream->vtable->write (iostream, data, size, &nbytes);
+	if (iostream->wcapacity) {
+		// Send the buffered data first, if the new data doesn't fit.
+		if (size > iostream->wcapacity - iostream->wlength) {
+			status = dc_iostream_drain (iostream);
+			if (status != DC_STATUS_SUCCESS)
+				goto out;
+		}
+
+		// Append small writes to the buffer. Large writes are sent
+		// immediately, without the extra copy.
+		if (size < iostream->wcapacity) {
+			memcpy (iostream->wbuffer + iostream->wlength, data, size);
+			iostream->wlength += size;
+			nbytes = size;
+			goto out;
+		}
+	}
 
-	HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Write", (const unsigned char *) data, nbytes);
+	status = dc_iostream_write_raw (iostream, data, size, &nbytes);
 
 out:
 	if (actual)
@@ -227,6 +474,129 @@ out:
 	return status;
 }
 
+dc_status_t
+dc_iostream_get_fd (dc_iostream_t *iostream, int *fd)
+{
+	if (iostream == NULL || fd == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (iostream->vtable->get_fd == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	return iostream->vtable->get_fd (iostream, fd);
+}
+
+dc_status_t
+dc_iostream_read_async (dc_iostream_t *iostream, void *data, size_t size, dc_iostream_callback_t callback, void *userdata)
+{
+	if (iostream == NULL || callback == NULL || (data == NULL && size != 0))
+		return DC_STATUS_INVALIDARGS;
+
+	if (iostream->vtable->read == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	// Only a single read can be pending at any time.
+	if (iostream->async_callback != NULL) {
+		ERROR (iostream->context, "Asynchronous read already pending.");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	iostream->async_data = (unsigned char *) data;
+	iostream->async_size = size;
+	iostream->async_nbytes = 0;
+	iostream->async_callback = callback;
+	iostream->async_userdata = userdata;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_iostream_complete (dc_iostream_t *iostream, dc_status_t status)
+{
+	unsigned char *data = iostream->async_data;
+	size_t nbytes = iostream->async_nbytes;
+	dc_iostream_callback_t callback = iostream->async_callback;
+	void *userdata = iostream->async_userdata;
+
+	// Clear the pending read first, such that the callback can start
+	// the next one.
+	iostream->async_data = NULL;
+	iostream->async_size = 0;
+	iostream->async_nbytes = 0;
+	iostream->async_callback = NULL;
+	iostream->async_userdata = NULL;
+
+	callback (iostream, status, data, nbytes, userdata);
+}
+
+dc_status_t
+dc_iostream_dispatch (dc_iostream_t *iostream)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (iostream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	while (iostream->async_callback != NULL) {
+		size_t remaining = iostream->async_size - iostream->async_nbytes;
+		if (remaining == 0) {
+			dc_iostream_complete (iostream, DC_STATUS_SUCCESS);
+			break;
+		}
+
+		// Check whether data is available, without blocking. Streams
+		// without a poll function are checked for the number of
+		// available bytes instead.
+		size_t available = 0;
+		if (iostream->vtable->poll) {
+			status = iostream->vtable->poll (iostream, 0);
+		} else {
+			status = DC_STATUS_UNSUPPORTED;
+		}
+		if (status == DC_STATUS_UNSUPPORTED) {
+			status = dc_iostream_get_available (iostream, &available);
+			if (status == DC_STATUS_SUCCESS && available == 0)
+				status = DC_STATUS_TIMEOUT;
+		}
+
+		if (status == DC_STATUS_TIMEOUT) {
+			// Not ready yet.
+			return DC_STATUS_SUCCESS;
+		} else if (status != DC_STATUS_SUCCESS) {
+			dc_iostream_complete (iostream, status);
+			return status;
+		}
+
+		// Read no more than the number of available bytes, if known,
+		// such that the read doesn't block. Packet based streams have
+		// a packet ready, which is returned immediately.
+		if (available == 0)
+			dc_iostream_get_available (iostream, &available);
+		if (available != 0 && available < remaining)
+			remaining = available;
+
+		size_t nbytes = 0;
+		status = dc_iostream_read (iostream,
+			iostream->async_data + iostream->async_nbytes, remaining, &nbytes);
+		iostream->async_nbytes += nbytes;
+		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT) {
+			dc_iostream_complete (iostream, status);
+			return status;
+		}
+
+		if (nbytes == 0) {
+			// Nothing received after all.
+			return DC_STATUS_SUCCESS;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_iostream_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size)
 {
@@ -235,6 +605,10 @@ dc_iostream_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, si
 	if (iostream == NULL || iostream->vtable->ioctl == NULL)
 		return DC_STATUS_SUCCESS;
 
+	status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	// The size should match the size encoded in the ioctl request,
 	// unless it's a variable size request.
 	if (size != DC_IOCTL_SIZE(request) &&
@@ -264,6 +638,10 @@ dc_iostream_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, si
 dc_status_t
 dc_iostream_flush (dc_iostream_t *iostream)
 {
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (iostream == NULL || iostream->vtable->flush == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -275,17 +653,28 @@ dc_iostream_flush (dc_iostream_t *iostream)
 dc_status_t
 dc_iostream_purge (dc_iostream_t *iostream, dc_direction_t direction)
 {
+	// Discard the buffered data, together with the output buffer.
+	if (iostream != NULL && (direction & DC_DIRECTION_OUTPUT)) {
+		iostream->wlength = 0;
+	}
+
 	if (iostream == NULL || iostream->vtable->purge == NULL)
 		return DC_STATUS_SUCCESS;
 
 	INFO (iostream->context, "Purge: direction=%u", direction);
 
+	iostream->stats.purges++;
+
 	return iostream->vtable->purge (iostream, direction);
 }
 
 dc_status_t
 dc_iostream_sleep (dc_iostream_t *iostream, unsigned int milliseconds)
 {
+	dc_status_t status = dc_iostream_drain (iostream);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (iostream == NULL || iostream->vtable->sleep == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -294,6 +683,18 @@ dc_iostream_sleep (dc_iostream_t *iostream, unsigned int milliseconds)
 	return iostream->vtable->sleep (iostream, milliseconds);
 }
 
+dc_status_t
+dc_iostream_interrupt (dc_iostream_t *iostream)
+{
+	if (iostream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (iostream->vtable->interrupt == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	return iostream->vtable->interrupt (iostream);
+}
+
 dc_status_t
 dc_iostream_close (dc_iostream_t *iostream)
 {
@@ -302,11 +703,65 @@ dc_iostream_close (dc_iostream_t *iostream)
 	if (iostream == NULL)
 		return DC_STATUS_SUCCESS;
 
+	// Send the buffered data.
+	dc_status_set_error (&status, dc_iostream_drain (iostream));
+
+	// Abort the pending asynchronous read.
+	if (iostream->async_callback) {
+		dc_iostream_complete (iostream, DC_STATUS_CANCELLED);
+	}
+
 	if (iostream->vtable->close) {
-		status = iostream->vtable->close (iostream);
+		dc_status_set_error (&status, iostream->vtable->close (iostream));
 	}
 
 	dc_iostream_deallocate (iostream);
 
 	return status;
 }
+
+void
+dc_iostream_set_address (dc_iostream_t *iostream, const char *format, ...)
+{
+	va_list ap;
+
+	if (iostream == NULL || format == NULL)
+		return;
+
+	va_start (ap, format);
+#ifdef _MSC_VER
+	_vsnprintf (iostream->address, sizeof (iostream->address) - 1, format, ap);
+	iostream->address[sizeof (iostream->address) - 1] = '\0';
+#else
+	vsnprintf (iostream->address, sizeof (iostream->address), format, ap);
+#endif
+	va_end (ap);
+}
+
+void
+dc_iostream_ble_prefer (dc_iostream_t *iostream, unsigned int mtu, unsigned int interval, unsigned int noresponse)
+{
+	if (iostream == NULL || iostream->transport != DC_TRANSPORT_BLE)
+		return;
+
+	if (mtu && dc_iostream_ioctl (iostream, DC_IOCTL_BLE_SET_MTU, &mtu, sizeof (mtu)) != DC_STATUS_SUCCESS)
+		DEBUG (iostream->context, "BLE MTU request not supported.");
+
+	if (interval && dc_iostream_ioctl (iostream, DC_IOCTL_BLE_SET_INTERVAL, &interval, sizeof (interval)) != DC_STATUS_SUCCESS)
+		DEBUG (iostream->context, "BLE connection interval request not supported.");
+
+	if (noresponse && dc_iostream_ioctl (iostream, DC_IOCTL_BLE_SET_NORESPONSE, &noresponse, sizeof (noresponse)) != DC_STATUS_SUCCESS)
+		DEBUG (iostream->context, "BLE write without response not supported.");
+}
+
+const char *
+dc_iostream_get_address (dc_iostream_t *iostream)
+{
+	if (iostream == NULL)
+		return NULL;
+
+	if (iostream->address[0] == '\0')
+		return NULL;
+
+	return iostream->address;
+}
@@ -98,12 +98,16 @@ static const dc_iostream_vtable_t dc_irda_vtable = {
 	dc_socket_get_available, /* get_available */
 	NULL, /* configure */
 	dc_socket_poll, /* poll */
+	dc_socket_get_fd, /* get_fd */
 	dc_socket_read, /* read */
+	NULL, /* read_lend */
+	NULL, /* read_return */
 	dc_socket_write, /* write */
 	dc_socket_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	dc_socket_sleep, /* sleep */
+	NULL, /* interrupt */
 	dc_socket_close, /* close */
 };
 #endif
@@ -332,6 +336,8 @@ dc_irda_open (dc_iostream_t **out, dc_context_t *context, unsigned int address,
 		goto error_close;
 	}
 
+	dc_iostream_set_address ((dc_iostream_t *) device, "%08x", address);
+
 	*out = (dc_iostream_t *) device;
 
 	return DC_STATUS_SUCCESS;
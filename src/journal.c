@@ -0,0 +1,246 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/device.h>
+
+#include "journal.h"
+#include "context-private.h"
+#include "recordfile.h"
+#include "thread.h"
+
+/*
+ * The journal is stored in a record file, in the same format as the
+ * fingerprint store, with one line per delivered dive. New dives are
+ * appended to the end of the file, such that a crash in the middle of
+ * a download loses at most the last dive. The file is only rewritten
+ * when the entries of a device are removed.
+ */
+
+struct dc_journal_t {
+	dc_context_t *context;
+	dc_mutex_t *mutex;
+	char *filename;
+	dc_record_t *entries;
+	dc_record_t **tail;
+};
+
+static dc_record_t *
+dc_journal_find (dc_journal_t *journal, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size)
+{
+	for (dc_record_t *entry = journal->entries; entry; entry = entry->next) {
+		if (entry->family == family && entry->model == model && entry->serial == serial &&
+			entry->size == size && memcmp (entry->data, data, size) == 0)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static dc_record_t *
+dc_journal_insert (dc_journal_t *journal, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size)
+{
+	dc_record_t *entry = (dc_record_t *) malloc (sizeof (dc_record_t));
+	if (entry == NULL) {
+		ERROR (journal->context, "Failed to allocate memory.");
+		return NULL;
+	}
+
+	// The entries are kept in their original order.
+	entry->family = family;
+	entry->model = model;
+	entry->serial = serial;
+	entry->size = size;
+	memcpy (entry->data, data, size);
+	entry->next = NULL;
+	*journal->tail = entry;
+	journal->tail = &entry->next;
+
+	return entry;
+}
+
+static dc_status_t
+dc_journal_load_cb (const dc_record_t *record, void *userdata)
+{
+	dc_journal_t *journal = (dc_journal_t *) userdata;
+
+	if (dc_journal_find (journal, record->family, record->model, record->serial, record->data, record->size))
+		return DC_STATUS_SUCCESS;
+
+	if (dc_journal_insert (journal, record->family, record->model, record->serial, record->data, record->size) == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_journal_free_entries (dc_journal_t *journal)
+{
+	dc_record_t *entry = journal->entries;
+	while (entry) {
+		dc_record_t *next = entry->next;
+		free (entry);
+		entry = next;
+	}
+	journal->entries = NULL;
+	journal->tail = &journal->entries;
+}
+
+dc_status_t
+dc_journal_new (dc_journal_t **out, dc_context_t *context, const char *filename)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_journal_t *journal = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	journal = (dc_journal_t *) malloc (sizeof (dc_journal_t));
+	if (journal == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	journal->context = context;
+	journal->mutex = NULL;
+	journal->entries = NULL;
+	journal->tail = &journal->entries;
+
+	size_t length = strlen (filename);
+	journal->filename = (char *) malloc (length + 1);
+	if (journal->filename == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+	memcpy (journal->filename, filename, length + 1);
+
+	status = dc_mutex_new (&journal->mutex);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create the mutex.");
+		goto error_free_filename;
+	}
+
+	status = dc_recordfile_load (context, journal->filename, "journal", dc_journal_load_cb, journal);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_free_entries;
+	}
+
+	*out = journal;
+
+	return DC_STATUS_SUCCESS;
+
+error_free_entries:
+	dc_journal_free_entries (journal);
+	dc_mutex_free (journal->mutex);
+error_free_filename:
+	free (journal->filename);
+error_free:
+	free (journal);
+	return status;
+}
+
+int
+dc_journal_contains (dc_journal_t *journal, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size)
+{
+	if (journal == NULL || data == NULL || size == 0)
+		return 0;
+
+	dc_mutex_lock (journal->mutex);
+	int found = dc_journal_find (journal, family, model, serial, data, size) != NULL;
+	dc_mutex_unlock (journal->mutex);
+
+	return found;
+}
+
+dc_status_t
+dc_journal_append (dc_journal_t *journal, dc_family_t family, unsigned int model, unsigned int serial, const unsigned char data[], unsigned int size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (journal == NULL || data == NULL || size == 0 || size > DC_RECORD_MAXSIZE)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (journal->mutex);
+
+	if (dc_journal_find (journal, family, model, serial, data, size))
+		goto error_unlock;
+
+	dc_record_t *entry = dc_journal_insert (journal, family, model, serial, data, size);
+	if (entry == NULL) {
+		status = DC_STATUS_NOMEMORY;
+		goto error_unlock;
+	}
+
+	status = dc_recordfile_append (journal->context, journal->filename, "journal", entry);
+
+error_unlock:
+	dc_mutex_unlock (journal->mutex);
+	return status;
+}
+
+dc_status_t
+dc_journal_clear (dc_journal_t *journal, dc_family_t family, unsigned int model, unsigned int serial)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (journal == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (journal->mutex);
+
+	unsigned int nremoved = 0;
+	dc_record_t **link = &journal->entries;
+	while (*link) {
+		dc_record_t *entry = *link;
+		if (entry->family == family && entry->model == model && entry->serial == serial) {
+			*link = entry->next;
+			free (entry);
+			nremoved++;
+		} else {
+			link = &entry->next;
+		}
+	}
+	journal->tail = link;
+
+	if (nremoved)
+		status = dc_recordfile_save (journal->context, journal->filename, "journal", journal->entries);
+
+	dc_mutex_unlock (journal->mutex);
+
+	return status;
+}
+
+dc_status_t
+dc_journal_free (dc_journal_t *journal)
+{
+	if (journal == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_journal_free_entries (journal);
+	dc_mutex_free (journal->mutex);
+	free (journal->filename);
+	free (journal);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -31,6 +31,7 @@
 #include "ringbuffer.h"
 #include "rbstream.h"
 #include "checksum.h"
+#include "retry.h"
 #include "array.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &liquivision_lynx_device_vtable)
@@ -95,10 +96,12 @@ static const dc_device_vtable_t liquivision_lynx_device_vtable = {
 	DC_FAMILY_LIQUIVISION_LYNX,
 	liquivision_lynx_device_set_fingerprint, /* set_fingerprint */
 	liquivision_lynx_device_read, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	liquivision_lynx_device_dump, /* dump */
 	liquivision_lynx_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	liquivision_lynx_device_close /* close */
 };
 
@@ -195,22 +198,18 @@ liquivision_lynx_packet (liquivision_lynx_device_t *device, const unsigned char
 	return DC_STATUS_SUCCESS;
 }
 
+static const dc_retry_policy_t liquivision_lynx_retry = {MAXRETRIES, 100, DC_DIRECTION_INPUT, DC_RETRY_BACKOFF};
+
 static dc_status_t
 liquivision_lynx_transfer (liquivision_lynx_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &liquivision_lynx_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = liquivision_lynx_packet (device, command, csize, answer, asize)) != DC_STATUS_SUCCESS) {
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
+		if (!dc_retry_again (&retry, device->iostream, rc))
 			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -225,7 +225,9 @@ liquivision_lynx_parser_get_field (dc_parser_t *abstract, dc_field_type_t type,
 		return DC_STATUS_DATAFORMAT;
 
 	if (!parser->cached) {
-		dc_status_t rc = liquivision_lynx_parser_samples_foreach (abstract, NULL, NULL);
+		dc_status_t rc = sample_profile_walk (abstract, liquivision_lynx_parser_samples_foreach,
+			PARSER_FIELD (DC_FIELD_GASMIX_COUNT) | PARSER_FIELD (DC_FIELD_GASMIX) |
+			PARSER_FIELD (DC_FIELD_TANK_COUNT) | PARSER_FIELD (DC_FIELD_TANK), type);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 	}
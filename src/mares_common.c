@@ -25,8 +25,9 @@
 
 #include "context-private.h"
 #include "mares_common.h"
-#include "checksum.h"
 #include "array.h"
+#include "rbstream.h"
+#include "retry.h"
 
 #define MAXRETRIES 4
 
@@ -66,11 +67,9 @@ mares_common_make_ascii (const unsigned char raw[], unsigned int rsize, unsigned
 	// Header
 	ascii[0] = '<';
 
-	// Data
-	array_convert_bin2hex (raw, rsize, ascii + 1, 2 * rsize);
-
-	// Checksum
-	unsigned char checksum = checksum_add_uint8 (ascii + 1, 2 * rsize, 0x00);
+	// Data and checksum
+	unsigned char checksum = 0x00;
+	array_convert_bin2hex_sum (raw, rsize, ascii + 1, 2 * rsize, &checksum);
 	array_convert_bin2hex (&checksum, 1, ascii + 1 + 2 * rsize, 2);
 
 	// Trailer
@@ -79,7 +78,7 @@ mares_common_make_ascii (const unsigned char raw[], unsigned int rsize, unsigned
 
 
 static dc_status_t
-mares_common_packet (mares_common_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
+mares_common_packet (mares_common_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned char data[])
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
@@ -126,9 +125,16 @@ mares_common_packet (mares_common_device_t *device, const unsigned char command[
 		return DC_STATUS_PROTOCOL;
 	}
 
+	// Extract the raw data from the packet, and calculate the checksum
+	// of the ascii data in the same pass.
+	unsigned char ccrc = 0x00;
+	if (array_convert_hex2bin_sum (answer + 1, asize - 4, data, (asize - 4) / 2, &ccrc) != 0) {
+		ERROR (abstract->context, "Unexpected answer data.");
+		return DC_STATUS_PROTOCOL;
+	}
+
 	// Verify the checksum of the packet.
 	unsigned char crc = 0;
-	unsigned char ccrc = checksum_add_uint8 (answer + 1, asize - 4, 0x00);
 	array_convert_hex2bin (answer + asize - 3, 2, &crc, 1);
 	if (crc != ccrc) {
 		ERROR (abstract->context, "Unexpected answer checksum.");
@@ -139,24 +145,18 @@ mares_common_packet (mares_common_device_t *device, const unsigned char command[
 }
 
 
+static const dc_retry_policy_t mares_common_retry = {MAXRETRIES, 100, DC_DIRECTION_INPUT, DC_RETRY_BACKOFF};
+
 static dc_status_t
-mares_common_transfer (mares_common_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
+mares_common_transfer (mares_common_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned char data[])
 {
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = mares_common_packet (device, command, csize, answer, asize)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &mares_common_retry);
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	while ((rc = mares_common_packet (device, command, csize, answer, asize, data)) != DC_STATUS_SUCCESS) {
+		if (!dc_retry_again (&retry, device->iostream, rc))
 			return rc;
-
-		// Discard any garbage bytes.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
 	}
 
 	return rc;
@@ -187,13 +187,10 @@ mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned
 
 		// Send the command and receive the answer.
 		unsigned char answer[2 * (PACKETSIZE + 2)] = {0};
-		dc_status_t rc = mares_common_transfer (device, command, sizeof (command), answer, 2 * (len + 2));
+		dc_status_t rc = mares_common_transfer (device, command, sizeof (command), answer, 2 * (len + 2), data);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
-		// Extract the raw data from the packet.
-		array_convert_hex2bin (answer + 1, 2 * len, data, len);
-
 		nbytes += len;
 		address += len;
 		data += len;
@@ -203,38 +200,22 @@ mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned
 }
 
 
-dc_status_t
-mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata)
+/*
+ * Walk the dives in the linear profile buffer, from the newest to the
+ * oldest. Only the bytes from the begin offset onwards are available.
+ * With the incomplete flag, the walk only checks whether those bytes
+ * contain all the dives newer than the fingerprint, and sets the flag if
+ * more data is needed.
+ */
+static dc_status_t
+mares_common_walk (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], unsigned char buffer[], unsigned int begin, int *incomplete, dc_dive_callback_t callback, void *userdata)
 {
-	assert (layout != NULL);
-
 	// Get the freedive mode for this model.
 	unsigned int model = data[1];
 	unsigned int freedive = FREEDIVE;
 	if (model == NEMOWIDE || model == NEMOAIR || model == PUCK || model == PUCKAIR)
 		freedive = GAUGE;
 
-	// Get the end of the profile ring buffer.
-	unsigned int eop = array_uint16_le (data + 0x6B);
-	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
-		ERROR (context, "Ringbuffer pointer out of range (0x%04x).", eop);
-		return DC_STATUS_DATAFORMAT;
-	}
-
-	// Make the ringbuffer linear, to avoid having to deal
-	// with the wrap point. The buffer has extra space to
-	// store the profile data for the freedives.
-	unsigned char *buffer = (unsigned char *) malloc (
-		layout->rb_profile_end - layout->rb_profile_begin +
-		layout->rb_freedives_end - layout->rb_freedives_begin);
-	if (buffer == NULL) {
-		ERROR (context, "Failed to allocate memory.");
-		return DC_STATUS_NOMEMORY;
-	}
-
-	memcpy (buffer + 0, data + eop, layout->rb_profile_end - eop);
-	memcpy (buffer + layout->rb_profile_end - eop, data + layout->rb_profile_begin, eop - layout->rb_profile_begin);
-
 	// For a freedive session, the Mares Nemo stores all the freedives of
 	// that session in a single logbook entry, and each sample is actually
 	// a summary for each individual freedive in the session. The profile
@@ -245,6 +226,9 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 
 	unsigned int offset = layout->rb_profile_end - layout->rb_profile_begin;
 	while (offset >= 3) {
+		if (offset - 3 < begin)
+			goto incomplete;
+
 		// Check for the presence of extra header bytes, which can be detected
 		// by means of a three byte marker sequence.
 		unsigned int extra = 0;
@@ -260,6 +244,9 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 		if (offset < extra + 3)
 			break;
 
+		if (offset - extra - 3 < begin)
+			goto incomplete;
+
 		// Check the dive mode of the logbook entry. Valid modes are
 		// 0 (air), 1 (EANx), 2 (freedive) or 3 (bottom timer).
 		// If the ringbuffer has never reached the wrap point before,
@@ -296,6 +283,9 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 		if (offset < nbytes)
 			break;
 
+		if (offset - nbytes < begin)
+			goto incomplete;
+
 		// Move to the start of the dive.
 		offset -= nbytes;
 
@@ -304,11 +294,19 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 		// something is wrong and an error is returned.
 		unsigned int length = array_uint16_le (buffer + offset);
 		if (length != nbytes) {
+			if (incomplete)
+				break;
 			ERROR (context, "Calculated and stored size are not equal (%u %u).", length, nbytes);
-			free (buffer);
 			return DC_STATUS_DATAFORMAT;
 		}
 
+		unsigned int fp_offset = offset + length - extra - FP_OFFSET;
+		if (fingerprint && memcmp (buffer + fp_offset, fingerprint, FP_SIZE) == 0)
+			break;
+
+		if (incomplete)
+			continue;
+
 		// Process the profile data for the most recent freedive entry.
 		// Since we are processing the entries backwards (newest to oldest),
 		// this entry will always be the first one.
@@ -333,7 +331,6 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 			// both values are different, the profile data is incomplete.
 			if (count != nsamples) {
 				ERROR (context, "Unexpected number of freedive sessions (%u %u).", count, nsamples);
-				free (buffer);
 				return DC_STATUS_DATAFORMAT;
 			}
 
@@ -344,19 +341,153 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 			nbytes += idx - layout->rb_freedives_begin;
 		}
 
-		unsigned int fp_offset = offset + length - extra - FP_OFFSET;
-		if (fingerprint && memcmp (buffer + fp_offset, fingerprint, FP_SIZE) == 0) {
-			free (buffer);
-			return DC_STATUS_SUCCESS;
+		if (callback && !callback (buffer + offset, nbytes, buffer + fp_offset, FP_SIZE, userdata))
+			break;
+	}
+
+	return DC_STATUS_SUCCESS;
+
+incomplete:
+	if (incomplete)
+		*incomplete = 1;
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata)
+{
+	assert (layout != NULL);
+
+	// Get the end of the profile ring buffer.
+	unsigned int eop = array_uint16_le (data + 0x6B);
+	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
+		ERROR (context, "Ringbuffer pointer out of range (0x%04x).", eop);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	// Make the ringbuffer linear, to avoid having to deal
+	// with the wrap point. The buffer has extra space to
+	// store the profile data for the freedives.
+	unsigned char *buffer = (unsigned char *) malloc (
+		layout->rb_profile_end - layout->rb_profile_begin +
+		layout->rb_freedives_end - layout->rb_freedives_begin);
+	if (buffer == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	memcpy (buffer + 0, data + eop, layout->rb_profile_end - eop);
+	memcpy (buffer + layout->rb_profile_end - eop, data + layout->rb_profile_begin, eop - layout->rb_profile_begin);
+
+	dc_status_t rc = mares_common_walk (context, layout, fingerprint, data, buffer, 0, NULL, callback, userdata);
+
+	free (buffer);
+
+	return rc;
+}
+
+
+dc_status_t
+mares_common_device_foreach (dc_device_t *abstract, const mares_common_layout_t *layout, const unsigned char fingerprint[], dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_rbstream_t *rbstream = NULL;
+
+	assert (layout != NULL);
+
+	unsigned int rb_profile_size = layout->rb_profile_end - layout->rb_profile_begin;
+	unsigned int rb_freedives_size = layout->rb_freedives_end - layout->rb_freedives_begin;
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = layout->rb_profile_begin + rb_freedives_size + rb_profile_size;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Only the header, the freedives and the part of the profile
+	// ringbuffer with the new dives are read. The ringbuffer is kept in
+	// the linear buffer, with extra space for the freedives.
+	unsigned char *data = (unsigned char *) malloc (layout->memsize);
+	unsigned char *buffer = (unsigned char *) malloc (rb_profile_size + rb_freedives_size);
+	if (data == NULL || buffer == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	// Read the header.
+	rc = dc_device_read (abstract, 0, data, layout->rb_profile_begin);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to read the header.");
+		goto error_free;
+	}
+
+	progress.current += layout->rb_profile_begin;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Emit a device info event.
+	dc_event_devinfo_t devinfo;
+	devinfo.model = data[1];
+	devinfo.firmware = 0;
+	devinfo.serial = array_uint16_be (data + 8);
+	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
+
+	// Read the freedive profiles.
+	if (rb_freedives_size) {
+		rc = dc_device_read (abstract, layout->rb_freedives_begin, data + layout->rb_freedives_begin, rb_freedives_size);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the freedives.");
+			goto error_free;
 		}
 
-		if (callback && !callback (buffer + offset, nbytes, buffer + fp_offset, FP_SIZE, userdata)) {
-			free (buffer);
-			return DC_STATUS_SUCCESS;
+		progress.current += rb_freedives_size;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	}
+
+	// Get the end of the profile ring buffer.
+	unsigned int eop = array_uint16_le (data + 0x6B);
+	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
+		ERROR (abstract->context, "Ringbuffer pointer out of range (0x%04x).", eop);
+		rc = DC_STATUS_DATAFORMAT;
+		goto error_free;
+	}
+
+	rc = dc_rbstream_new (&rbstream, abstract, 1, PACKETSIZE, layout->rb_profile_begin, layout->rb_profile_end, eop);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+		goto error_free;
+	}
+
+	// Read the ringbuffer backwards, until it contains all the new dives.
+	unsigned int available = 0;
+	int incomplete = 1;
+	while (incomplete && available < rb_profile_size) {
+		unsigned int len = rb_profile_size - available;
+		if (len > 8 * PACKETSIZE)
+			len = 8 * PACKETSIZE;
+
+		rc = dc_rbstream_read (rbstream, &progress, buffer + rb_profile_size - available - len, len);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the profile.");
+			goto error_free;
 		}
+
+		available += len;
+
+		incomplete = 0;
+		rc = mares_common_walk (abstract->context, layout, fingerprint, data, buffer, rb_profile_size - available, &incomplete, NULL, NULL);
+		if (rc != DC_STATUS_SUCCESS)
+			goto error_free;
 	}
 
-	free (buffer);
+	progress.maximum = progress.current;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	return DC_STATUS_SUCCESS;
+	rc = mares_common_walk (abstract->context, layout, fingerprint, data, buffer, rb_profile_size - available, NULL, callback, userdata);
+
+error_free:
+	dc_rbstream_free (rbstream);
+	free (buffer);
+	free (data);
+	return rc;
 }
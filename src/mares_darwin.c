@@ -30,6 +30,7 @@
 #include "context-private.h"
 #include "device-private.h"
 #include "array.h"
+#include "ringbuffer.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &mares_darwin_device_vtable)
 
@@ -66,10 +67,12 @@ static const dc_device_vtable_t mares_darwin_device_vtable = {
 	DC_FAMILY_MARES_DARWIN,
 	mares_darwin_device_set_fingerprint, /* set_fingerprint */
 	mares_common_device_read, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	mares_darwin_device_dump, /* dump */
 	mares_darwin_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -293,16 +296,8 @@ mares_darwin_extract_dives (dc_device_t *abstract, const unsigned char data[], u
 		memcpy (buffer, data + offset, layout->rb_logbook_size);
 
 		// Copy the profile data.
-		if (current < layout->rb_profile_begin + length) {
-			unsigned int a = current - layout->rb_profile_begin;
-			unsigned int b = length - a;
-			memcpy (buffer + layout->rb_logbook_size, data + layout->rb_profile_end - b, b);
-			memcpy (buffer + layout->rb_logbook_size + b, data + layout->rb_profile_begin, a);
-			current = layout->rb_profile_end - b;
-		} else {
-			memcpy (buffer + layout->rb_logbook_size, data + current - length, length);
-			current -= length;
-		}
+		current = ringbuffer_decrement (current, length, layout->rb_profile_begin, layout->rb_profile_end);
+		ringbuffer_copy (buffer + layout->rb_logbook_size, data, current, length, layout->rb_profile_begin, layout->rb_profile_end);
 
 		if (memcmp (buffer, device->fingerprint, sizeof (device->fingerprint)) == 0) {
 			free (buffer);
@@ -26,9 +26,11 @@
 #include "mares_iconhd.h"
 #include "context-private.h"
 #include "device-private.h"
+#include "iostream-private.h"
 #include "array.h"
 #include "rbstream.h"
 #include "platform.h"
+#include "retry.h"
 
 #define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
 
@@ -51,6 +53,7 @@
 #define QUAD      0x29
 
 #define MAXRETRIES 4
+#define MAXPACKET  4096
 
 #define ACK 0xAA
 #define EOF 0xEA
@@ -85,6 +88,11 @@ typedef struct mares_iconhd_model_t {
 	unsigned int id;
 } mares_iconhd_model_t;
 
+typedef struct mares_iconhd_profile_t {
+	unsigned char version[140];
+	unsigned int memsize;
+} mares_iconhd_profile_t;
+
 typedef struct mares_iconhd_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
@@ -92,9 +100,11 @@ typedef struct mares_iconhd_device_t {
 	unsigned char fingerprint[10];
 	unsigned int fingerprint_size;
 	unsigned char version[140];
+	unsigned int profile;
 	unsigned int model;
 	unsigned int packetsize;
 	unsigned char cache[20];
+	const unsigned char *packet;
 	unsigned int available;
 	unsigned int offset;
 } mares_iconhd_device_t;
@@ -109,10 +119,12 @@ static const dc_device_vtable_t mares_iconhd_device_vtable = {
 	DC_FAMILY_MARES_ICONHD,
 	mares_iconhd_device_set_fingerprint, /* set_fingerprint */
 	mares_iconhd_device_read, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	mares_iconhd_device_dump, /* dump */
 	mares_iconhd_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -171,6 +183,16 @@ mares_iconhd_get_model (mares_iconhd_device_t *device)
 	return model;
 }
 
+static void
+mares_iconhd_packet_return (mares_iconhd_device_t *device)
+{
+	// Hand a lent packet back to the I/O stream.
+	if (device->packet != device->cache) {
+		dc_iostream_read_return (device->iostream, device->packet);
+		device->packet = device->cache;
+	}
+}
+
 static dc_status_t
 mares_iconhd_read (mares_iconhd_device_t *device, unsigned char data[], size_t size)
 {
@@ -181,12 +203,19 @@ mares_iconhd_read (mares_iconhd_device_t *device, unsigned char data[], size_t s
 	while (nbytes < size) {
 		if (transport == DC_TRANSPORT_BLE) {
 			if (device->available == 0) {
-				// Read a packet into the cache.
+				// Borrow the packet from the I/O stream if possible,
+				// otherwise read it into the cache.
+				const unsigned char *packet = NULL;
 				size_t len = 0;
-				rc = dc_iostream_read (device->iostream, device->cache, sizeof(device->cache), &len);
+				rc = dc_iostream_read_lend (device->iostream, &packet, &len);
+				if (rc == DC_STATUS_UNSUPPORTED) {
+					packet = device->cache;
+					rc = dc_iostream_read (device->iostream, device->cache, sizeof(device->cache), &len);
+				}
 				if (rc != DC_STATUS_SUCCESS)
 					return rc;
 
+				device->packet = packet;
 				device->available = len;
 				device->offset = 0;
 			}
@@ -201,9 +230,11 @@ mares_iconhd_read (mares_iconhd_device_t *device, unsigned char data[], size_t s
 
 		if (transport == DC_TRANSPORT_BLE) {
 			// Copy the data from the cached packet.
-			memcpy (data + nbytes, device->cache + device->offset, length);
+			memcpy (data + nbytes, device->packet + device->offset, length);
 			device->available -= length;
 			device->offset += length;
+			if (device->available == 0)
+				mares_iconhd_packet_return (device);
 		} else {
 			// Read the packet.
 			rc = dc_iostream_read (device->iostream, data + nbytes, length, &length);
@@ -286,19 +317,31 @@ mares_iconhd_packet (mares_iconhd_device_t *device,
 		}
 	}
 
-	// Read the packet.
-	status = mares_iconhd_read (device, answer, asize);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Failed to receive the answer.");
-		return status;
-	}
-
-	// Receive the trailer byte.
+	// Receive the packet and the trailer byte. Except for BLE, where
+	// the data is already buffered, both are read with a single call.
 	unsigned char trailer[1] = {0};
-	status = mares_iconhd_read (device, trailer, sizeof (trailer));
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Failed to receive the answer.");
-		return status;
+	if (dc_iostream_get_transport (device->iostream) != DC_TRANSPORT_BLE && asize <= MAXPACKET) {
+		unsigned char packet[MAXPACKET + 1];
+		status = mares_iconhd_read (device, packet, asize + 1);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to receive the answer.");
+			return status;
+		}
+
+		memcpy (answer, packet, asize);
+		trailer[0] = packet[asize];
+	} else {
+		status = mares_iconhd_read (device, answer, asize);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to receive the answer.");
+			return status;
+		}
+
+		status = mares_iconhd_read (device, trailer, sizeof (trailer));
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to receive the answer.");
+			return status;
+		}
 	}
 
 	// Verify the trailer byte.
@@ -310,24 +353,37 @@ mares_iconhd_packet (mares_iconhd_device_t *device,
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Forget the cached profile after a failure, because the device may
+ * not be the one the profile was negotiated with.
+ */
+static dc_status_t
+mares_iconhd_failure (mares_iconhd_device_t *device, dc_status_t rc)
+{
+	if (device->profile) {
+		dc_context_set_profile (device->base.context, DC_FAMILY_MARES_ICONHD,
+			dc_iostream_get_address (device->iostream), NULL, 0);
+		device->profile = 0;
+	}
+
+	return rc;
+}
+
+static const dc_retry_policy_t mares_iconhd_retry = {MAXRETRIES, 100, DC_DIRECTION_INPUT, DC_RETRY_BACKOFF};
+
 static dc_status_t
 mares_iconhd_transfer (mares_iconhd_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &mares_iconhd_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = mares_iconhd_packet (device, command, csize, answer, asize)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
+		if (!dc_retry_again (&retry, device->iostream, rc))
+			return mares_iconhd_failure (device, rc);
 
-		// Discard any garbage bytes.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+		// Discard the buffered data.
+		mares_iconhd_packet_return (device);
 		device->available = 0;
 		device->offset = 0;
 	}
@@ -379,6 +435,12 @@ mares_iconhd_read_object(mares_iconhd_device_t *device, dc_event_progress_t *pro
 		// data packets. The first packet contains only the total size
 		// of the payload.
 		size = array_uint32_le (rsp_init + 4);
+
+		// Reserve the space for the entire payload upfront.
+		if (!dc_buffer_reserve (buffer, dc_buffer_get_size (buffer) + size)) {
+			ERROR (abstract->context, "Insufficient buffer space available.");
+			return DC_STATUS_NOMEMORY;
+		}
 	} else if (rsp_init[0] == 0x42) {
 		// A short (and fixed size) payload is embedded into the first
 		// data packet.
@@ -470,12 +532,18 @@ mares_iconhd_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
 	device->fingerprint_size = sizeof (device->fingerprint);
 	memset (device->version, 0, sizeof (device->version));
+	device->profile = 0;
 	device->model = 0;
 	device->packetsize = 0;
 	memset (device->cache, 0, sizeof (device->cache));
+	device->packet = device->cache;
 	device->available = 0;
 	device->offset = 0;
 
+	// The BLE packets are limited to a fixed size, but a short
+	// connection interval still reduces the latency of each command.
+	dc_iostream_ble_prefer (iostream, 0, BLE_INTERVAL_MIN, 0);
+
 	// Set the serial communication protocol (115200 8E1).
 	status = dc_iostream_configure (device->iostream, 115200, 8, DC_PARITY_EVEN, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -507,20 +575,31 @@ mares_iconhd_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 	// Make sure everything is in a sane state.
 	dc_iostream_purge (device->iostream, DC_DIRECTION_ALL);
 
-	// Send the version command.
-	unsigned char command[] = {CMD_VERSION, CMD_VERSION ^ XOR};
-	status = mares_iconhd_transfer (device, command, sizeof (command),
-		device->version, sizeof (device->version));
-	if (status != DC_STATUS_SUCCESS) {
-		goto error_free;
+	// Use the profile of a previous connection to the same device,
+	// instead of probing the device again.
+	mares_iconhd_profile_t profile;
+	const char *address = dc_iostream_get_address (device->iostream);
+	unsigned int memsize = 0;
+	if (dc_context_get_profile (context, DC_FAMILY_MARES_ICONHD, address, &profile, sizeof (profile))) {
+		DEBUG (context, "Using the cached profile for %s.", address);
+		memcpy (device->version, profile.version, sizeof (device->version));
+		memsize = profile.memsize;
+		device->profile = 1;
+	} else {
+		// Send the version command.
+		unsigned char command[] = {CMD_VERSION, CMD_VERSION ^ XOR};
+		status = mares_iconhd_transfer (device, command, sizeof (command),
+			device->version, sizeof (device->version));
+		if (status != DC_STATUS_SUCCESS) {
+			goto error_free;
+		}
 	}
 
 	// Autodetect the model using the version packet.
 	device->model = mares_iconhd_get_model (device);
 
 	// Read the size of the flash memory.
-	unsigned int memsize = 0;
-	if (device->model == QUAD) {
+	if (device->model == QUAD && !device->profile) {
 		unsigned char cmd_flash[] = {CMD_FLASHSIZE, CMD_FLASHSIZE ^ XOR};
 		unsigned char rsp_flash[4] = {0};
 		status = mares_iconhd_transfer (device, cmd_flash, sizeof (cmd_flash), rsp_flash, sizeof (rsp_flash));
@@ -532,6 +611,13 @@ mares_iconhd_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 		}
 	}
 
+	// Remember the profile, unless some of the probing failed.
+	if (!device->profile && (device->model != QUAD || memsize)) {
+		memcpy (profile.version, device->version, sizeof (profile.version));
+		profile.memsize = memsize;
+		dc_context_set_profile (context, DC_FAMILY_MARES_ICONHD, address, &profile, sizeof (profile));
+	}
+
 	// Load the correct memory layout.
 	switch (device->model) {
 	case MATRIX:
@@ -716,7 +802,7 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 
 	// Create the ringbuffer stream.
 	dc_rbstream_t *rbstream = NULL;
-	rc = dc_rbstream_new (&rbstream, abstract, 1, device->packetsize, layout->rb_profile_begin, layout->rb_profile_end, eop);
+	rc = dc_rbstream_new2 (&rbstream, abstract, 1, device->packetsize, MAXPACKET / device->packetsize, layout->rb_profile_begin, layout->rb_profile_end, eop);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		return rc;
@@ -732,7 +818,9 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 
 	unsigned int offset = layout->rb_profile_end - layout->rb_profile_begin;
 	while (offset >= header + 4) {
-		// Read the first part of the dive header.
+		// Read the first part of the dive header. Without knowing the
+		// size of the dive, there is no read-ahead.
+		dc_rbstream_limit (rbstream, header);
 		rc = dc_rbstream_read (rbstream, &progress, buffer + offset - header, header);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
@@ -814,7 +902,9 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 		if (offset < nbytes)
 			break;
 
-		// Read the remainder of the dive.
+		// Read the remainder of the dive, without reading ahead into the
+		// next one.
+		dc_rbstream_limit (rbstream, nbytes - headersize);
 		rc = dc_rbstream_read (rbstream, &progress, buffer + offset - nbytes, nbytes - headersize);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
@@ -849,6 +939,86 @@ mares_iconhd_device_foreach_raw (dc_device_t *abstract, dc_dive_callback_t callb
 	return rc;
 }
 
+/*
+ * Get a sort key from the packed timestamp of a Genius dive. The hour is
+ * stored in the least significant bits, so the raw value is not ordered
+ * in time.
+ */
+static unsigned int
+mares_genius_timestamp_key (const unsigned char data[])
+{
+	unsigned int timestamp = array_uint32_le (data);
+	unsigned int hour   = (timestamp     ) & 0x1F;
+	unsigned int minute = (timestamp >> 5) & 0x3F;
+	unsigned int day    = (timestamp >> 11) & 0x1F;
+	unsigned int month  = (timestamp >> 16) & 0x0F;
+	unsigned int year   = (timestamp >> 20) & 0x0FFF;
+
+	return (year << 20) | (month << 16) | (day << 11) | (hour << 6) | minute;
+}
+
+/*
+ * Locate the fingerprint dive, and return the number of new dives. The
+ * dives are stored newest first, so instead of reading every dive header
+ * in turn, the headers are bisected on their timestamp. Only an exact
+ * match of the fingerprint is accepted. If the fingerprint dive isn't
+ * found, for example because the clock was changed, all dives are new.
+ */
+static dc_status_t
+mares_iconhd_locate_object (mares_iconhd_device_t *device, dc_event_progress_t *progress, dc_buffer_t *buffer, unsigned int ndives, unsigned int *count)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	unsigned int key = mares_genius_timestamp_key (device->fingerprint);
+	unsigned int cached = ndives;
+
+	*count = ndives;
+
+	// Find the first dive which is not newer than the fingerprint dive.
+	unsigned int lo = 0, hi = ndives;
+	while (lo <= hi && lo < ndives) {
+		unsigned int mid = (lo < hi) ? lo + (hi - lo) / 2 : lo;
+
+		if (mid != cached) {
+			dc_buffer_clear (buffer);
+			rc = mares_iconhd_read_object (device, progress, buffer, OBJ_DIVE + mid, OBJ_DIVE_HEADER);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to read the dive header.");
+				return rc;
+			}
+
+			if (dc_buffer_get_size (buffer) < 0x08 + device->fingerprint_size) {
+				ERROR (abstract->context, "Unexpected number of bytes received (" DC_PRINTF_SIZE ").",
+					dc_buffer_get_size (buffer));
+				return DC_STATUS_PROTOCOL;
+			}
+
+			cached = mid;
+		}
+
+		const unsigned char *fp = dc_buffer_get_data (buffer) + 0x08;
+		unsigned int current = mares_genius_timestamp_key (fp);
+
+		if (lo == hi) {
+			// Check the dives with the same timestamp.
+			if (current != key)
+				break;
+			if (memcmp (fp, device->fingerprint, device->fingerprint_size) == 0) {
+				INFO (abstract->context, "Stopping due to detecting a matching fingerprint");
+				*count = lo;
+				break;
+			}
+			lo = hi = lo + 1;
+		} else if (current > key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
@@ -884,13 +1054,28 @@ mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t ca
 	// Get the number of dives.
 	unsigned int ndives = array_uint16_le (dc_buffer_get_data(buffer));
 
-	// Update and emit a progress event.
+	// Update and emit a progress event. The number of header reads to
+	// locate the fingerprint dive is unknown, so assume the worst case.
 	progress.current = 1 * NSTEPS;
 	progress.maximum = (1 + ndives * 2) * NSTEPS;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
+	// Locate the fingerprint dive.
+	unsigned int count = ndives;
+	if (!array_isequal (device->fingerprint, device->fingerprint_size, 0)) {
+		rc = mares_iconhd_locate_object (device, &progress, buffer, ndives, &count);
+		if (rc != DC_STATUS_SUCCESS) {
+			dc_buffer_free (buffer);
+			return rc;
+		}
+	}
+
+	// Update and emit a progress event.
+	progress.maximum = progress.current + count * 2 * NSTEPS;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
 	// Download the dives.
-	for (unsigned int i = 0; i < ndives; ++i) {
+	for (unsigned int i = 0; i < count; ++i) {
 		// Erase the buffer.
 		dc_buffer_clear (buffer);
 
@@ -901,12 +1086,6 @@ mares_iconhd_device_foreach_object (dc_device_t *abstract, dc_dive_callback_t ca
 			break;
 		}
 
-		// Check the fingerprint data.
-		if (memcmp (dc_buffer_get_data (buffer) + 0x08, device->fingerprint, device->fingerprint_size) == 0) {
-			INFO (abstract->context, "Stopping due to detecting a matching fingerprint");
-			break;
-		}
-
 		// Read the dive data.
 		rc = mares_iconhd_read_object (device, &progress, buffer, OBJ_DIVE + i, OBJ_DIVE_DATA);
 		if (rc != DC_STATUS_SUCCESS) {
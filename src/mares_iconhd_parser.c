@@ -128,6 +128,7 @@ struct mares_iconhd_parser_t {
 	unsigned int model;
 	// Cached fields.
 	unsigned int cached;
+	unsigned int validated;
 	unsigned int mode;
 	unsigned int nsamples;
 	unsigned int samplesize;
@@ -461,6 +462,72 @@ mares_genius_cache (mares_iconhd_parser_t *parser)
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Validate all records of the profile in a single pass, before any
+ * sample is decoded. The records have a fixed size, and are stored back
+ * to back in the same order as the samples loop processes them. The
+ * result is cached until the next dive is set.
+ */
+static dc_status_t
+mares_genius_validate (mares_iconhd_parser_t *parser)
+{
+	dc_parser_t *abstract = (dc_parser_t *) parser;
+	const unsigned char *data = parser->base.data + parser->headersize;
+
+	if (parser->validated) {
+		return DC_STATUS_SUCCESS;
+	}
+
+	// Check the profile type and version.
+	unsigned int type = array_uint16_le (data);
+	unsigned int major = data[2];
+	unsigned int minor = data[3];
+	if (type != 0 || major != 2 || minor != 0) {
+		ERROR (abstract->context, "Unsupported object type (%u) or version (%u.%u).",
+			type, major, minor);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	unsigned int offset = 4;
+
+	if (!mares_genius_isvalid (data + offset, DSTR_SIZE, DSTR_TYPE)) {
+		ERROR (abstract->context, "Invalid DSTR record.");
+		return DC_STATUS_DATAFORMAT;
+	}
+	offset += DSTR_SIZE;
+
+	if (!mares_genius_isvalid (data + offset, TISS_SIZE, TISS_TYPE)) {
+		ERROR (abstract->context, "Invalid TISS record.");
+		return DC_STATUS_DATAFORMAT;
+	}
+	offset += TISS_SIZE;
+
+	for (unsigned int i = 1; i <= parser->nsamples; ++i) {
+		if (!mares_genius_isvalid (data + offset, DPRS_SIZE, DPRS_TYPE)) {
+			ERROR (abstract->context, "Invalid DPRS record.");
+			return DC_STATUS_DATAFORMAT;
+		}
+		offset += DPRS_SIZE;
+
+		if ((i % 4) == 0) {
+			if (!mares_genius_isvalid (data + offset, AIRS_SIZE, AIRS_TYPE)) {
+				ERROR (abstract->context, "Invalid AIRS record.");
+				return DC_STATUS_DATAFORMAT;
+			}
+			offset += AIRS_SIZE;
+		}
+	}
+
+	if (!mares_genius_isvalid (data + offset, DEND_SIZE, DEND_TYPE)) {
+		ERROR (abstract->context, "Invalid DEND record.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	parser->validated = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 mares_iconhd_parser_cache (mares_iconhd_parser_t *parser)
 {
@@ -493,6 +560,7 @@ mares_iconhd_parser_create (dc_parser_t **out, dc_context_t *context, unsigned i
 	// Set the default values.
 	parser->model = model;
 	parser->cached = 0;
+	parser->validated = 0;
 	parser->mode = (model == GENIUS) ? GENIUS_AIR : ICONHD_AIR;
 	parser->nsamples = 0;
 	parser->samplesize = 0;
@@ -526,6 +594,7 @@ mares_iconhd_parser_set_data (dc_parser_t *abstract, const unsigned char *data,
 
 	// Reset the cache.
 	parser->cached = 0;
+	parser->validated = 0;
 	parser->mode = (parser->model == GENIUS) ? GENIUS_AIR : ICONHD_AIR;
 	parser->nsamples = 0;
 	parser->samplesize = 0;
@@ -828,32 +897,16 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 	unsigned int offset = 4;
 	unsigned int marker = 0;
 	if (parser->model == GENIUS) {
+		// Validate all records at once.
+		rc = mares_genius_validate (parser);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
 		// Skip the dive header.
 		data += parser->headersize;
 
-		// Check the profile type and version.
-		unsigned int type = array_uint16_le (data);
-		unsigned int major = data[2];
-		unsigned int minor = data[3];
-		if (type != 0 || major != 2 || minor != 0) {
-			ERROR (abstract->context, "Unsupported object type (%u) or version (%u.%u).",
-				type, major, minor);
-			return DC_STATUS_DATAFORMAT;
-		}
-
-		// Skip the DSTR record.
-		if (!mares_genius_isvalid (data + offset, DSTR_SIZE, DSTR_TYPE)) {
-			ERROR (abstract->context, "Invalid DSTR record.");
-			return DC_STATUS_DATAFORMAT;
-		}
-		offset += DSTR_SIZE;
-
-		// Skip the TISS record.
-		if (!mares_genius_isvalid (data + offset, TISS_SIZE, TISS_TYPE)) {
-			ERROR (abstract->context, "Invalid TISS record.");
-			return DC_STATUS_DATAFORMAT;
-		}
-		offset += TISS_SIZE;
+		// Skip the DSTR and TISS records.
+		offset += DSTR_SIZE + TISS_SIZE;
 
 		// Size of the record type marker.
 		marker = 4;
@@ -923,11 +976,6 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 			unsigned int depth = 0, temperature = 0;
 			unsigned int gasmix = 0, misc = 0, alarms = 0;
 			if (parser->model == GENIUS) {
-				if (!mares_genius_isvalid (data + offset, DPRS_SIZE, DPRS_TYPE)) {
-					ERROR (abstract->context, "Invalid DPRS record.");
-					return DC_STATUS_DATAFORMAT;
-				}
-
 				depth = array_uint16_le (data + offset + marker + 0);
 				temperature = array_uint16_le (data + offset + marker + 4);
 				alarms = array_uint32_le (data + offset + marker + 0x0C);
@@ -1013,11 +1061,6 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 
 			// Some extra data.
 			if (isairintegrated && (nsamples % 4) == 0) {
-				if (parser->model == GENIUS && !mares_genius_isvalid (data + offset, AIRS_SIZE, AIRS_TYPE)) {
-					ERROR (abstract->context, "Invalid AIRS record.");
-					return DC_STATUS_DATAFORMAT;
-				}
-
 				// Pressure (1/100 bar).
 				unsigned int pressure = array_uint16_le(data + offset + marker + 0);
 				if (gasmix < parser->ntanks) {
@@ -1033,14 +1076,5 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 		}
 	}
 
-	if (parser->model == GENIUS) {
-		// Skip the DEND record.
-		if (!mares_genius_isvalid (data + offset, DEND_SIZE, DEND_TYPE)) {
-			ERROR (abstract->context, "Invalid DEND record.");
-			return DC_STATUS_DATAFORMAT;
-		}
-		offset += DEND_SIZE;
-	}
-
 	return DC_STATUS_SUCCESS;
 }
@@ -22,6 +22,8 @@
 #include <string.h> // memcpy, memcmp
 #include <stdlib.h> // malloc, free
 
+#include <libdivecomputer/serial.h>
+
 #include "mares_nemo.h"
 #include "mares_common.h"
 #include "context-private.h"
@@ -57,10 +59,12 @@ static const dc_device_vtable_t mares_nemo_device_vtable = {
 	DC_FAMILY_MARES_NEMO,
 	mares_nemo_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	mares_nemo_device_dump, /* dump */
 	mares_nemo_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -115,6 +119,14 @@ mares_nemo_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t
 		goto error_free;
 	}
 
+	// Enable the low latency mode. This is a best effort setting, and
+	// not every serial port supports it.
+	unsigned int latency = 0;
+	status = dc_iostream_ioctl (device->iostream, DC_IOCTL_SERIAL_SET_LATENCY, &latency, sizeof(latency));
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		WARNING (context, "Failed to set the latency.");
+	}
+
 	// Set the DTR line.
 	status = dc_iostream_set_dtr (device->iostream, 1);
 	if (status != DC_STATUS_SUCCESS) {
@@ -176,7 +188,10 @@ mares_nemo_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	progress.maximum = MEMORYSIZE + 20;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	// Wait until some data arrives.
+	// Wait until some data arrives. The transfer is started by the user
+	// on the dive computer, and always contains the entire memory. There
+	// is no command to read only the pages that changed since the last
+	// download.
 	while (dc_iostream_poll (device->iostream, 100) == DC_STATUS_TIMEOUT) {
 		if (device_is_cancelled (abstract))
 			return DC_STATUS_CANCELLED;
@@ -28,7 +28,6 @@
 #include "context-private.h"
 #include "device-private.h"
 #include "checksum.h"
-#include "array.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &mares_puck_device_vtable)
 
@@ -52,10 +51,12 @@ static const dc_device_vtable_t mares_puck_device_vtable = {
 	DC_FAMILY_MARES_PUCK,
 	mares_puck_device_set_fingerprint, /* set_fingerprint */
 	mares_common_device_read, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	mares_puck_device_dump, /* dump */
 	mares_puck_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -214,27 +215,5 @@ mares_puck_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, v
 
 	assert (device->layout != NULL);
 
-	dc_buffer_t *buffer = dc_buffer_new (device->layout->memsize);
-	if (buffer == NULL)
-		return DC_STATUS_NOMEMORY;
-
-	dc_status_t rc = mares_puck_device_dump (abstract, buffer);
-	if (rc != DC_STATUS_SUCCESS) {
-		dc_buffer_free (buffer);
-		return rc;
-	}
-
-	// Emit a device info event.
-	unsigned char *data = dc_buffer_get_data (buffer);
-	dc_event_devinfo_t devinfo;
-	devinfo.model = data[1];
-	devinfo.firmware = 0;
-	devinfo.serial = array_uint16_be (data + 8);
-	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
-
-	rc = mares_common_extract_dives (abstract->context, device->layout, device->fingerprint, data, callback, userdata);
-
-	dc_buffer_free (buffer);
-
-	return rc;
+	return mares_common_device_foreach (abstract, device->layout, device->fingerprint, callback, userdata);
 }
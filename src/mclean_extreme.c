@@ -69,10 +69,12 @@ static const dc_device_vtable_t mclean_extreme_device_vtable = {
 	DC_FAMILY_MCLEAN_EXTREME,
 	mclean_extreme_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	mclean_extreme_device_foreach, /* foreach */
 	mclean_extreme_device_timesync, /* timesync */
+	NULL, /* keepalive */
 	mclean_extreme_device_close, /* close */
 };
 
@@ -295,27 +297,17 @@ mclean_extreme_transfer(mclean_extreme_device_t *device, unsigned char cmd, cons
 }
 
 static dc_status_t
-mclean_extreme_readdive (dc_device_t *abstract, dc_event_progress_t *progress, unsigned int idx, dc_buffer_t *buffer)
+mclean_extreme_requestdive (dc_device_t *abstract, unsigned int idx)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	mclean_extreme_device_t *device = (mclean_extreme_device_t *) abstract;
 
-	// Erase the buffer.
-	dc_buffer_clear (buffer);
-
 	// Encode the logbook ID.
 	unsigned char id[] = {
 		(idx     ) & 0xFF,
 		(idx >> 8) & 0xFF,
 	};
 
-	// Update and emit a progress event.
-	unsigned int initial = 0;
-	if (progress) {
-		initial = progress->current;
-		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
-	}
-
 	// Request the dive.
 	status = mclean_extreme_send (device, CMD_DIVE, id, sizeof(id));
 	if (status != DC_STATUS_SUCCESS) {
@@ -323,6 +315,29 @@ mclean_extreme_readdive (dc_device_t *abstract, dc_event_progress_t *progress, u
 		return status;
 	}
 
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Receive a dive, which must have been requested already with
+ * mclean_extreme_requestdive.
+ */
+static dc_status_t
+mclean_extreme_readdive (dc_device_t *abstract, dc_event_progress_t *progress, dc_buffer_t *buffer)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	mclean_extreme_device_t *device = (mclean_extreme_device_t *) abstract;
+
+	// Erase the buffer.
+	dc_buffer_clear (buffer);
+
+	// Update and emit a progress event.
+	unsigned int initial = 0;
+	if (progress) {
+		initial = progress->current;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+	}
+
 	// Read the dive header.
 	unsigned char header[SZ_HEADER];
 	status = mclean_extreme_receive (device, CMD_DIVE, header, sizeof(header), NULL);
@@ -566,12 +581,20 @@ mclean_extreme_device_foreach(dc_device_t *abstract, dc_dive_callback_t callback
 		goto error_exit;
 	}
 
+	// Request the most recent dive.
+	if (ndives) {
+		status = mclean_extreme_requestdive (abstract, ndives - 1);
+		if (status != DC_STATUS_SUCCESS) {
+			goto error_buffer_free;
+		}
+	}
+
 	for (unsigned int i = 0; i < ndives; ++i) {
 		// Download in reverse order (newest first).
 		unsigned int idx = ndives - 1 - i;
 
 		// Read the dive.
-		status = mclean_extreme_readdive (abstract, &progress, idx, buffer);
+		status = mclean_extreme_readdive (abstract, &progress, buffer);
 		if (status != DC_STATUS_SUCCESS) {
 			goto error_buffer_free;
 		}
@@ -583,7 +606,23 @@ mclean_extreme_device_foreach(dc_device_t *abstract, dc_dive_callback_t callback
 		if (memcmp(data, device->fingerprint, sizeof(device->fingerprint)) == 0)
 			break;
 
+		// Request the next dive already, so the dive computer can
+		// prepare it while the application processes this dive.
+		unsigned int pending = 0;
+		if (idx) {
+			status = mclean_extreme_requestdive (abstract, idx - 1);
+			if (status != DC_STATUS_SUCCESS) {
+				goto error_buffer_free;
+			}
+			pending = 1;
+		}
+
 		if (callback && !callback (data, size, data, sizeof(device->fingerprint), userdata)) {
+			// Receive the next dive anyway, to keep the stream in
+			// sync for the close command.
+			if (pending) {
+				mclean_extreme_readdive (abstract, NULL, buffer);
+			}
 			break;
 		}
 	}
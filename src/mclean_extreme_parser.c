@@ -144,7 +144,8 @@ mclean_extreme_parser_get_field(dc_parser_t *abstract, dc_field_type_t type, uns
 	}
 
 	if (!parser->cached) {
-		dc_status_t rc = mclean_extreme_parser_samples_foreach (abstract, NULL, NULL);
+		dc_status_t rc = sample_profile_walk (abstract, mclean_extreme_parser_samples_foreach,
+			PARSER_FIELD (DC_FIELD_GASMIX_COUNT) | PARSER_FIELD (DC_FIELD_GASMIX), type);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 	}
@@ -28,13 +28,17 @@
 #include "oceanic_common.h"
 #include "context-private.h"
 #include "device-private.h"
+#include "iostream-private.h"
 #include "array.h"
 #include "ringbuffer.h"
 #include "checksum.h"
 #include "platform.h"
+#include "retry.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &oceanic_atom2_device_vtable.base)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define PROPLUSX   0x4552
 #define VTX        0x4557
 #define I750TC     0x455A
@@ -82,10 +86,12 @@ static const oceanic_common_device_vtable_t oceanic_atom2_device_vtable = {
 		DC_FAMILY_OCEANIC_ATOM2,
 		oceanic_common_device_set_fingerprint, /* set_fingerprint */
 		oceanic_atom2_device_read, /* read */
+		NULL, /* read_multi */
 		oceanic_atom2_device_write, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
 		NULL, /* timesync */
+		oceanic_atom2_device_keepalive, /* keepalive */
 		oceanic_atom2_device_close /* close */
 	},
 	oceanic_common_device_logbook,
@@ -762,6 +768,8 @@ oceanic_atom2_packet (oceanic_atom2_device_t *device, const unsigned char comman
 }
 
 
+static const dc_retry_policy_t oceanic_atom2_retry = {MAXRETRIES, 100, DC_DIRECTION_INPUT, DC_RETRY_BACKOFF};
+
 static dc_status_t
 oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char command[], unsigned int csize, unsigned char ack, unsigned char answer[], unsigned int asize, unsigned int crc_size)
 {
@@ -771,23 +779,17 @@ oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char comm
 	// a NAK byte, we try to resend the command a number of times before
 	// returning an error.
 
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &oceanic_atom2_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = oceanic_atom2_packet (device, command, csize, ack, answer, asize, crc_size)) != DC_STATUS_SUCCESS) {
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
+		if (!dc_retry_again (&retry, device->iostream, rc))
 			return rc;
 
 		// Increase the inter packet delay.
 		if (device->delay < MAXDELAY)
 			device->delay++;
-
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -853,6 +855,51 @@ oceanic_atom2_ble_handshake(oceanic_atom2_device_t *device)
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Find the largest page size supported by the read commands of an
+ * unknown model, by reading the first (big) page. Without retries, to
+ * avoid increasing the inter packet delay for the rest of the session.
+ */
+static unsigned int
+oceanic_atom2_probe_bigpage (oceanic_atom2_device_t *device)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+
+	static const struct {
+		unsigned int bigpage;
+		unsigned char cmd;
+		unsigned int crc_size;
+	} modes[] = {
+		{16, CMD_READ16, 2},
+		{8,  CMD_READ8,  1},
+	};
+
+	for (unsigned int i = 0; i < C_ARRAY_SIZE(modes); ++i) {
+		unsigned char command[] = {modes[i].cmd, 0x00, 0x00};
+		dc_status_t rc = oceanic_atom2_packet (device, command, sizeof (command), ACK,
+			device->cache, modes[i].bigpage * PAGESIZE, modes[i].crc_size);
+		if (rc == DC_STATUS_SUCCESS) {
+			INFO (abstract->context, "Detected big page size: %u", modes[i].bigpage);
+
+			// Keep the page in the cache.
+			device->cached_page = 0;
+			device->cached_highmem = 0;
+
+			return modes[i].bigpage;
+		}
+
+		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
+			break;
+
+		// Discard the remainder of the answer.
+		dc_iostream_sleep (device->iostream, 100);
+		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+	}
+
+	return 1;
+}
+
+
 dc_status_t
 oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream, unsigned int model)
 {
@@ -888,6 +935,10 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 		baudrate = 115200;
 	}
 
+	// Every page is a separate command over BLE, so a short connection
+	// interval speeds up the download.
+	dc_iostream_ble_prefer (iostream, 0, BLE_INTERVAL_MIN, 0);
+
 	// Set the serial communication protocol (38400 8N1).
 	status = dc_iostream_configure (device->iostream, baudrate, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -1025,6 +1076,9 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 		} else {
 			device->base.layout = &oceanic_default_layout;
 		}
+
+		// Use the largest pages the firmware accepts.
+		device->bigpage = oceanic_atom2_probe_bigpage (device);
 	}
 
 	*out = (dc_device_t*) device;
@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <libdivecomputer/units.h>
 
@@ -107,13 +108,66 @@
 #define HEADER  1
 #define PROFILE 2
 
+// Sample encodings.
+#define TEMPERATURE_NONE   0
+#define TEMPERATURE_BYTE   1
+#define TEMPERATURE_PACKED 2
+#define TEMPERATURE_DELTA  3
+
+#define PRESSURE_NONE   0
+#define PRESSURE_WORD   1
+#define PRESSURE_PACKED 2
+#define PRESSURE_DELTA  3
+
+#define TANK_1PSI         0
+#define TANK_1PSI_INDEXED 1
+#define TANK_2PSI_INDEXED 2
+
+#define DEPTH_WORD 0
+#define DEPTH_BYTE 1
+
 typedef struct oceanic_atom2_parser_t oceanic_atom2_parser_t;
 
+/*
+ * The sample layout of a model. The models share only a handful of
+ * encodings for each sample field, which differ mainly in the position
+ * of the bits. The layout is resolved once for each model, such that
+ * the samples loop doesn't need to check the model for every sample.
+ */
+typedef struct oceanic_atom2_layout_t {
+	unsigned int samplesize;
+	unsigned int timestamp;
+	unsigned int temperature;
+	unsigned int temperature_offset;
+	unsigned int sign_offset;
+	unsigned int sign_mask;
+	unsigned int sign_invert;
+	unsigned int pressure;
+	unsigned int pressure_offset;
+	unsigned int pressure_mask;
+	unsigned int tank;
+	unsigned int tank_offset;
+	unsigned int depth;
+	unsigned int depth_offset;
+	unsigned int gasmix;
+	unsigned int deco;
+	unsigned int decostop_offset;
+	unsigned int decostop_mask;
+	unsigned int decostop_shift;
+	unsigned int decotime_offset;
+	unsigned int decotime_mask;
+	unsigned int rbt;
+	unsigned int rbt_offset;
+	unsigned int rbt_mask;
+	unsigned int bookmark;
+} oceanic_atom2_layout_t;
+
 struct oceanic_atom2_parser_t {
 	dc_parser_t base;
 	unsigned int model;
 	unsigned int headersize;
 	unsigned int footersize;
+	oceanic_atom2_layout_t layout;
 	// Cached fields.
 	unsigned int cached;
 	unsigned int header;
@@ -142,6 +196,225 @@ static const dc_parser_vtable_t oceanic_atom2_parser_vtable = {
 };
 
 
+
+static void
+oceanic_atom2_parser_layout (oceanic_atom2_layout_t *layout, unsigned int model)
+{
+	memset (layout, 0, sizeof (*layout));
+
+	// Sample size.
+	layout->samplesize = PAGESIZE / 2;
+	if (model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI ||
+		model == TX1 || model == A300CS ||
+		model == VTX || model == I450T ||
+		model == I750TC || model == PROPLUSX ||
+		model == I770R || model == I470TC) {
+		layout->samplesize = PAGESIZE;
+	}
+
+	// Time (BCD encoded timestamp).
+	layout->timestamp = (model == I450T || model == I470TC);
+
+	// Temperature (°F)
+	if (model == GEO || model == ATOM1 ||
+		model == ELEMENT2 || model == MANTA ||
+		model == ZEN) {
+		layout->temperature = TEMPERATURE_BYTE;
+		layout->temperature_offset = 6;
+	} else if (model == TALIS) {
+		layout->temperature = TEMPERATURE_BYTE;
+		layout->temperature_offset = 7;
+	} else if (model == GEO20 || model == VEO20 ||
+		model == VEO30 || model == OC1A ||
+		model == OC1B || model == OC1C ||
+		model == OCI || model == A300 ||
+		model == I450T || model == I300 ||
+		model == I200 || model == I100 ||
+		model == I300C || model == I200C ||
+		model == GEO40 || model == VEO40 ||
+		model == I470TC) {
+		layout->temperature = TEMPERATURE_BYTE;
+		layout->temperature_offset = 3;
+	} else if (model == OCS || model == TX1) {
+		layout->temperature = TEMPERATURE_BYTE;
+		layout->temperature_offset = 1;
+	} else if (model == VT4 || model == VT41 ||
+		model == ATOM3 || model == ATOM31 ||
+		model == A300AI || model == VISION ||
+		model == XPAIR) {
+		layout->temperature = TEMPERATURE_PACKED;
+	} else if (model == A300CS || model == VTX ||
+		model == I750TC || model == PROPLUSX ||
+		model == I770R) {
+		layout->temperature = TEMPERATURE_BYTE;
+		layout->temperature_offset = 11;
+	} else {
+		layout->temperature = TEMPERATURE_DELTA;
+		if (model == DG03 || model == PROPLUS3 ||
+			model == I550 || model == I550C ||
+			model == PROPLUS4 || model == WISDOM4) {
+			layout->sign_offset = 5;
+			layout->sign_mask = 0x04;
+			layout->sign_invert = 1;
+		} else if (model == VOYAGER2G || model == AMPHOS ||
+			model == AMPHOSAIR || model == ZENAIR) {
+			layout->sign_offset = 5;
+			layout->sign_mask = 0x04;
+			layout->sign_invert = 0;
+		} else if (model == ATOM2 || model == PROPLUS21 ||
+			model == EPICA || model == EPICB ||
+			model == ATMOSAI2 ||
+			model == WISDOM2 || model == WISDOM3) {
+			layout->sign_offset = 0;
+			layout->sign_mask = 0x80;
+			layout->sign_invert = 0;
+		} else {
+			layout->sign_offset = 0;
+			layout->sign_mask = 0x80;
+			layout->sign_invert = 1;
+		}
+	}
+
+	// Tank Pressure (psi)
+	if (model == VEO30 || model == OCS ||
+		model == ELEMENT2 || model == VEO20 ||
+		model == A300 || model == ZEN ||
+		model == GEO || model == GEO20 ||
+		model == MANTA || model == I300 ||
+		model == I200 || model == I100 ||
+		model == I300C || model == TALIS ||
+		model == I200C || model == GEO40 ||
+		model == VEO40) {
+		layout->pressure = PRESSURE_NONE;
+	} else if (model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI ||
+		model == I450T || model == I470TC) {
+		layout->pressure = PRESSURE_WORD;
+		layout->pressure_offset = 10;
+		layout->pressure_mask = 0x0FFF;
+	} else if (model == VT4 || model == VT41||
+		model == ATOM3 || model == ATOM31 ||
+		model == ZENAIR ||model == A300AI ||
+		model == DG03 || model == PROPLUS3 ||
+		model == AMPHOSAIR || model == I550 ||
+		model == VISION || model == XPAIR ||
+		model == I550C || model == PROPLUS4 ||
+		model == WISDOM4) {
+		layout->pressure = PRESSURE_PACKED;
+	} else if (model == TX1 || model == A300CS ||
+		model == VTX || model == I750TC ||
+		model == PROPLUSX || model == I770R) {
+		layout->pressure = PRESSURE_WORD;
+		layout->pressure_offset = 4;
+		layout->pressure_mask = 0xFFFF;
+	} else {
+		layout->pressure = PRESSURE_DELTA;
+	}
+
+	// Tank switch.
+	if (model == DATAMASK || model == COMPUMASK) {
+		layout->tank = TANK_1PSI;
+	} else if (model == A300CS || model == VTX ||
+		model == I750TC) {
+		layout->tank = TANK_1PSI_INDEXED;
+	} else {
+		layout->tank = TANK_2PSI_INDEXED;
+		if (model == ATOM2 || model == EPICA || model == EPICB)
+			layout->tank_offset = 3;
+		else
+			layout->tank_offset = 4;
+	}
+
+	// Depth (1/16 ft)
+	if (model == GEO20 || model == VEO20 ||
+		model == VEO30 || model == OC1A ||
+		model == OC1B || model == OC1C ||
+		model == OCI || model == A300 ||
+		model == I450T || model == I300 ||
+		model == I200 || model == I100 ||
+		model == I300C || model == I200C ||
+		model == GEO40 || model == VEO40 ||
+		model == I470TC) {
+		layout->depth = DEPTH_WORD;
+		layout->depth_offset = 4;
+	} else if (model == ATOM1) {
+		layout->depth = DEPTH_BYTE;
+		layout->depth_offset = 3;
+	} else {
+		layout->depth = DEPTH_WORD;
+		layout->depth_offset = 2;
+	}
+
+	// Gas mix
+	layout->gasmix = (model == TX1);
+
+	// NDL / Deco
+	layout->deco = 1;
+	layout->decostop_mask = 0xF0;
+	layout->decostop_shift = 4;
+	if (model == A300CS || model == VTX ||
+		model == I750TC ||
+		model == PROPLUSX || model == I770R) {
+		layout->decostop_offset = 15;
+		layout->decostop_mask = 0x70;
+		layout->decotime_offset = 6;
+		layout->decotime_mask = 0x03FF;
+	} else if (model == ZEN || model == DG03) {
+		layout->decostop_offset = 5;
+		layout->decotime_offset = 4;
+		layout->decotime_mask = 0x0FFF;
+	} else if (model == TX1) {
+		layout->decostop_offset = 10;
+		layout->decostop_mask = 0xFF;
+		layout->decostop_shift = 0;
+		layout->decotime_offset = 6;
+		layout->decotime_mask = 0xFFFF;
+	} else if (model == ATOM31 || model == VISION ||
+		model == XPAIR || model == I550 ||
+		model == I550C || model == WISDOM4) {
+		layout->decostop_offset = 5;
+		layout->decotime_offset = 4;
+		layout->decotime_mask = 0x03FF;
+	} else if (model == I200 || model == I300 ||
+		model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI ||
+		model == I100 || model == I300C ||
+		model == I450T || model == I200C ||
+		model == GEO40 || model == VEO40 ||
+		model == I470TC) {
+		layout->decostop_offset = 7;
+		layout->decotime_offset = 6;
+		layout->decotime_mask = 0x0FFF;
+	} else {
+		layout->deco = 0;
+	}
+
+	// Remaining bottom time.
+	layout->rbt = 1;
+	if (model == ATOM31) {
+		layout->rbt_offset = 6;
+		layout->rbt_mask = 0x01FF;
+	} else if (model == I450T || model == OC1A ||
+		model == OC1B || model == OC1C ||
+		model == OCI || model == PROPLUSX ||
+		model == I770R || model == I470TC) {
+		layout->rbt_offset = 8;
+		layout->rbt_mask = 0x01FF;
+	} else if (model == VISION || model == XPAIR ||
+		model == I550 || model == I550C ||
+		model == WISDOM4) {
+		layout->rbt_offset = 6;
+		layout->rbt_mask = 0x03FF;
+	} else {
+		layout->rbt = 0;
+	}
+
+	// Bookmarks
+	layout->bookmark = (model == OC1A || model == OC1B ||
+		model == OC1C || model == OCI);
+}
+
 dc_status_t
 oceanic_atom2_parser_create (dc_parser_t **out, dc_context_t *context, unsigned int model)
 {
@@ -196,6 +469,8 @@ oceanic_atom2_parser_create (dc_parser_t **out, dc_context_t *context, unsigned
 		parser->headersize = 5 * PAGESIZE / 2;
 	}
 
+	oceanic_atom2_parser_layout (&parser->layout, model);
+
 	parser->cached = 0;
 	parser->header = 0;
 	parser->footer = 0;
@@ -535,10 +810,10 @@ oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 		return status;
 
 	// Cache the profile data.
-	if (parser->cached < PROFILE) {
+	if (parser->cached < PROFILE && type == DC_FIELD_DIVETIME) {
 		sample_statistics_t statistics = SAMPLE_STATISTICS_INITIALIZER;
-		status = oceanic_atom2_parser_samples_foreach (
-			abstract, sample_statistics_cb, &statistics);
+		status = sample_statistics_walk (abstract,
+			oceanic_atom2_parser_samples_foreach, &statistics);
 		if (status != DC_STATUS_SUCCESS)
 			return status;
 
@@ -615,6 +890,9 @@ oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 static void
 oceanic_atom2_parser_vendor (oceanic_atom2_parser_t *parser, const unsigned char *data, unsigned int size, unsigned int samplesize, dc_sample_callback_t callback, void *userdata)
 {
+	if (callback == NULL || !PARSER_SAMPLE_WANTED (&parser->base, DC_SAMPLE_VENDOR))
+		return;
+
 	unsigned int offset = 0;
 	while (offset + samplesize <= size) {
 		dc_sample_value_t sample = {0};
@@ -712,57 +990,42 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 		}
 	}
 
-	unsigned int samplesize = PAGESIZE / 2;
+	// The freedive samples contain only the depth.
+	oceanic_atom2_layout_t layout = parser->layout;
 	if (parser->mode == FREEDIVE) {
 		if (parser->model == F10A || parser->model == F10B ||
 			parser->model == F11A || parser->model == F11B ||
 			parser->model == MUNDIAL2 || parser->model == MUNDIAL3) {
-			samplesize = 2;
+			layout.samplesize = 2;
 		} else {
-			samplesize = 4;
+			layout.samplesize = 4;
 		}
-	} else if (parser->model == OC1A || parser->model == OC1B ||
-		parser->model == OC1C || parser->model == OCI ||
-		parser->model == TX1 || parser->model == A300CS ||
-		parser->model == VTX || parser->model == I450T ||
-		parser->model == I750TC || parser->model == PROPLUSX ||
-		parser->model == I770R || parser->model == I470TC) {
-		samplesize = PAGESIZE;
+		layout.temperature = TEMPERATURE_NONE;
+		layout.pressure = PRESSURE_NONE;
+		layout.depth = DEPTH_WORD;
+		layout.depth_offset = 0;
 	}
 
-	unsigned int have_temperature = 1, have_pressure = 1;
-	if (parser->mode == FREEDIVE) {
-		have_temperature = 0;
-		have_pressure = 0;
-	} else if (parser->model == VEO30 || parser->model == OCS ||
-		parser->model == ELEMENT2 || parser->model == VEO20 ||
-		parser->model == A300 || parser->model == ZEN ||
-		parser->model == GEO || parser->model == GEO20 ||
-		parser->model == MANTA || parser->model == I300 ||
-		parser->model == I200 || parser->model == I100 ||
-		parser->model == I300C || parser->model == TALIS ||
-		parser->model == I200C || parser->model == GEO40 ||
-		parser->model == VEO40) {
-		have_pressure = 0;
-	}
+	unsigned int samplesize = layout.samplesize;
+	unsigned int depth_mask = (parser->mode == FREEDIVE) ? 0xFFFF : 0x0FFF;
 
 	// Initial temperature.
 	unsigned int temperature = 0;
-	if (have_temperature) {
+	if (layout.temperature != TEMPERATURE_NONE) {
 		temperature = data[parser->header + 7];
 	}
 
 	// Initial tank pressure.
 	unsigned int tank = 0;
 	unsigned int pressure = 0;
-	if (have_pressure) {
+	if (layout.pressure != PRESSURE_NONE) {
 		unsigned int idx = 2;
 		if (parser->model == A300CS || parser->model == VTX ||
 			parser->model == I750TC)
 			idx = 16;
 		pressure = array_uint16_le(data + parser->header + idx);
 		if (pressure == 10000)
-			have_pressure = 0;
+			layout.pressure = PRESSURE_NONE;
 	}
 
 	// Initial gas mix.
@@ -806,22 +1069,22 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 		// Check for a tank switch sample.
 		if (sampletype == 0xAA) {
-			if (parser->model == DATAMASK || parser->model == COMPUMASK) {
+			switch (layout.tank) {
+			case TANK_1PSI:
 				// Tank pressure (1 psi) and number
 				tank = 0;
 				pressure = (((data[offset + 7] << 8) + data[offset + 6]) & 0x0FFF);
-			} else if (parser->model == A300CS || parser->model == VTX ||
-				parser->model == I750TC) {
+				break;
+			case TANK_1PSI_INDEXED:
 				// Tank pressure (1 psi) and number (one based index)
 				tank = (data[offset + 1] & 0x03) - 1;
 				pressure = ((data[offset + 7] << 8) + data[offset + 6]) & 0x0FFF;
-			} else {
+				break;
+			default:
 				// Tank pressure (2 psi) and number (one based index)
 				tank = (data[offset + 1] & 0x03) - 1;
-				if (parser->model == ATOM2 || parser->model == EPICA || parser->model == EPICB)
-					pressure = (((data[offset + 3] << 8) + data[offset + 4]) & 0x0FFF) * 2;
-				else
-					pressure = (((data[offset + 4] << 8) + data[offset + 5]) & 0x0FFF) * 2;
+				pressure = (((data[offset + layout.tank_offset] << 8) + data[offset + layout.tank_offset + 1]) & 0x0FFF) * 2;
+				break;
 			}
 		} else if (sampletype == 0xBB) {
 			// The surface time is not always a nice multiple of the samplerate.
@@ -860,7 +1123,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 			}
 
 			// Time.
-			if (parser->model == I450T || parser->model == I470TC) {
+			if (layout.timestamp) {
 				unsigned int minute = bcd2dec(data[offset + 0]);
 				unsigned int hour   = bcd2dec(data[offset + 1] & 0x0F);
 				unsigned int second = bcd2dec(data[offset + 2]);
@@ -887,80 +1150,38 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 				samplesize, callback, userdata);
 
 			// Temperature (°F)
-			if (have_temperature) {
-				if (parser->model == GEO || parser->model == ATOM1 ||
-					parser->model == ELEMENT2 || parser->model == MANTA ||
-					parser->model == ZEN) {
-					temperature = data[offset + 6];
-				} else if (parser->model == TALIS) {
-					temperature = data[offset + 7];
-				} else if (parser->model == GEO20 || parser->model == VEO20 ||
-					parser->model == VEO30 || parser->model == OC1A ||
-					parser->model == OC1B || parser->model == OC1C ||
-					parser->model == OCI || parser->model == A300 ||
-					parser->model == I450T || parser->model == I300 ||
-					parser->model == I200 || parser->model == I100 ||
-					parser->model == I300C || parser->model == I200C ||
-					parser->model == GEO40 || parser->model == VEO40 ||
-					parser->model == I470TC) {
-					temperature = data[offset + 3];
-				} else if (parser->model == OCS || parser->model == TX1) {
-					temperature = data[offset + 1];
-				} else if (parser->model == VT4 || parser->model == VT41 ||
-					parser->model == ATOM3 || parser->model == ATOM31 ||
-					parser->model == A300AI || parser->model == VISION ||
-					parser->model == XPAIR) {
+			if (layout.temperature != TEMPERATURE_NONE) {
+				switch (layout.temperature) {
+				case TEMPERATURE_BYTE:
+					temperature = data[offset + layout.temperature_offset];
+					break;
+				case TEMPERATURE_PACKED:
 					temperature = ((data[offset + 7] & 0xF0) >> 4) | ((data[offset + 7] & 0x0C) << 2) | ((data[offset + 5] & 0x0C) << 4);
-				} else if (parser->model == A300CS || parser->model == VTX ||
-					parser->model == I750TC || parser->model == PROPLUSX ||
-					parser->model == I770R) {
-					temperature = data[offset + 11];
-				} else {
-					unsigned int sign;
-					if (parser->model == DG03 || parser->model == PROPLUS3 ||
-						parser->model == I550 || parser->model == I550C ||
-						parser->model == PROPLUS4 || parser->model == WISDOM4)
-						sign = (~data[offset + 5] & 0x04) >> 2;
-					else if (parser->model == VOYAGER2G || parser->model == AMPHOS ||
-						parser->model == AMPHOSAIR || parser->model == ZENAIR)
-						sign = (data[offset + 5] & 0x04) >> 2;
-					else if (parser->model == ATOM2 || parser->model == PROPLUS21 ||
-						parser->model == EPICA || parser->model == EPICB ||
-						parser->model == ATMOSAI2 ||
-						parser->model == WISDOM2 || parser->model == WISDOM3)
-						sign = (data[offset + 0] & 0x80) >> 7;
-					else
-						sign = (~data[offset + 0] & 0x80) >> 7;
-					if (sign)
+					break;
+				default:
+					if (((data[offset + layout.sign_offset] & layout.sign_mask) != 0) != layout.sign_invert)
 						temperature -= (data[offset + 7] & 0x0C) >> 2;
 					else
 						temperature += (data[offset + 7] & 0x0C) >> 2;
+					break;
 				}
 				sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
 				if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
 			}
 
 			// Tank Pressure (psi)
-			if (have_pressure) {
-				if (parser->model == OC1A || parser->model == OC1B ||
-					parser->model == OC1C || parser->model == OCI ||
-					parser->model == I450T || parser->model == I470TC)
-					pressure = (data[offset + 10] + (data[offset + 11] << 8)) & 0x0FFF;
-				else if (parser->model == VT4 || parser->model == VT41||
-					parser->model == ATOM3 || parser->model == ATOM31 ||
-					parser->model == ZENAIR ||parser->model == A300AI ||
-					parser->model == DG03 || parser->model == PROPLUS3 ||
-					parser->model == AMPHOSAIR || parser->model == I550 ||
-					parser->model == VISION || parser->model == XPAIR ||
-					parser->model == I550C || parser->model == PROPLUS4 ||
-					parser->model == WISDOM4)
+			if (layout.pressure != PRESSURE_NONE) {
+				switch (layout.pressure) {
+				case PRESSURE_WORD:
+					pressure = array_uint16_le (data + offset + layout.pressure_offset) & layout.pressure_mask;
+					break;
+				case PRESSURE_PACKED:
 					pressure = (((data[offset + 0] & 0x03) << 8) + data[offset + 1]) * 5;
-				else if (parser->model == TX1 || parser->model == A300CS ||
-					parser->model == VTX || parser->model == I750TC ||
-					parser->model == PROPLUSX || parser->model == I770R)
-					pressure = array_uint16_le (data + offset + 4);
-				else
+					break;
+				default:
 					pressure -= data[offset + 1];
+					break;
+				}
 				sample.pressure.tank = tank;
 				sample.pressure.value = pressure * PSI / BAR;
 				if (callback) callback (DC_SAMPLE_PRESSURE, sample, userdata);
@@ -968,29 +1189,17 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 			// Depth (1/16 ft)
 			unsigned int depth;
-			if (parser->mode == FREEDIVE)
-				depth = array_uint16_le (data + offset);
-			else if (parser->model == GEO20 || parser->model == VEO20 ||
-				parser->model == VEO30 || parser->model == OC1A ||
-				parser->model == OC1B || parser->model == OC1C ||
-				parser->model == OCI || parser->model == A300 ||
-				parser->model == I450T || parser->model == I300 ||
-				parser->model == I200 || parser->model == I100 ||
-				parser->model == I300C || parser->model == I200C ||
-				parser->model == GEO40 || parser->model == VEO40 ||
-				parser->model == I470TC)
-				depth = (data[offset + 4] + (data[offset + 5] << 8)) & 0x0FFF;
-			else if (parser->model == ATOM1)
-				depth = data[offset + 3] * 16;
+			if (layout.depth == DEPTH_BYTE)
+				depth = data[offset + layout.depth_offset] * 16;
 			else
-				depth = (data[offset + 2] + (data[offset + 3] << 8)) & 0x0FFF;
+				depth = array_uint16_le (data + offset + layout.depth_offset) & depth_mask;
 			sample.depth = depth / 16.0 * FEET;
 			if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
 
 			// Gas mix
 			unsigned int have_gasmix = 0;
 			unsigned int gasmix = 0;
-			if (parser->model == TX1) {
+			if (layout.gasmix) {
 				gasmix = data[offset] & 0x07;
 				have_gasmix = 1;
 			}
@@ -1005,40 +1214,9 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 			}
 
 			// NDL / Deco
-			unsigned int have_deco = 0;
-			unsigned int decostop = 0, decotime = 0;
-			if (parser->model == A300CS || parser->model == VTX ||
-				parser->model == I750TC ||
-				parser->model == PROPLUSX || parser->model == I770R) {
-				decostop = (data[offset + 15] & 0x70) >> 4;
-				decotime = array_uint16_le(data + offset + 6) & 0x03FF;
-				have_deco = 1;
-			} else if (parser->model == ZEN || parser->model == DG03) {
-				decostop = (data[offset + 5] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 4) & 0x0FFF;
-				have_deco = 1;
-			} else if (parser->model == TX1) {
-				decostop = data[offset + 10];
-				decotime = array_uint16_le(data + offset + 6);
-				have_deco = 1;
-			} else if (parser->model == ATOM31 || parser->model == VISION ||
-				parser->model == XPAIR || parser->model == I550 ||
-				parser->model == I550C || parser->model == WISDOM4) {
-				decostop = (data[offset + 5] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 4) & 0x03FF;
-				have_deco = 1;
-			} else if (parser->model == I200 || parser->model == I300 ||
-				parser->model == OC1A || parser->model == OC1B ||
-				parser->model == OC1C || parser->model == OCI ||
-				parser->model == I100 || parser->model == I300C ||
-				parser->model == I450T || parser->model == I200C ||
-				parser->model == GEO40 || parser->model == VEO40 ||
-				parser->model == I470TC) {
-				decostop = (data[offset + 7] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 6) & 0x0FFF;
-				have_deco = 1;
-			}
-			if (have_deco) {
+			if (layout.deco) {
+				unsigned int decostop = (data[offset + layout.decostop_offset] & layout.decostop_mask) >> layout.decostop_shift;
+				unsigned int decotime = array_uint16_le(data + offset + layout.decotime_offset) & layout.decotime_mask;
 				if (decostop) {
 					sample.deco.type = DC_DECO_DECOSTOP;
 					sample.deco.depth = decostop * 10 * FEET;
@@ -1050,35 +1228,14 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 				if (callback) callback (DC_SAMPLE_DECO, sample, userdata);
 			}
 
-			unsigned int have_rbt = 0;
-			unsigned int rbt = 0;
-			if (parser->model == ATOM31) {
-				rbt = array_uint16_le(data + offset + 6) & 0x01FF;
-				have_rbt = 1;
-			} else if (parser->model == I450T || parser->model == OC1A ||
-				parser->model == OC1B || parser->model == OC1C ||
-				parser->model == OCI || parser->model == PROPLUSX ||
-				parser->model == I770R || parser->model == I470TC) {
-				rbt = array_uint16_le(data + offset + 8) & 0x01FF;
-				have_rbt = 1;
-			} else if (parser->model == VISION || parser->model == XPAIR ||
-				parser->model == I550 || parser->model == I550C ||
-				parser->model == WISDOM4) {
-				rbt = array_uint16_le(data + offset + 6) & 0x03FF;
-				have_rbt = 1;
-			}
-			if (have_rbt) {
-				sample.rbt = rbt;
+			// Remaining bottom time
+			if (layout.rbt) {
+				sample.rbt = array_uint16_le(data + offset + layout.rbt_offset) & layout.rbt_mask;
 				if (callback) callback (DC_SAMPLE_RBT, sample, userdata);
 			}
 
 			// Bookmarks
-			unsigned int have_bookmark = 0;
-			if (parser->model == OC1A || parser->model == OC1B ||
-				parser->model == OC1C || parser->model == OCI) {
-				have_bookmark = data[offset + 12] & 0x80;
-			}
-			if (have_bookmark) {
+			if (layout.bookmark && (data[offset + 12] & 0x80)) {
 				sample.event.type = SAMPLE_EVENT_BOOKMARK;
 				sample.event.time = 0;
 				sample.event.flags = 0;
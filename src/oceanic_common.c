@@ -40,61 +40,84 @@
 
 #define INVALID 0
 
-static unsigned int
-get_profile_first (const unsigned char data[], const oceanic_common_layout_t *layout, unsigned int pagesize)
-{
-	unsigned int value;
-
-	if (layout->pt_mode_logbook == 0) {
-		value = array_uint16_le (data + 5);
-	} else if (layout->pt_mode_logbook == 1) {
-		value = array_uint16_le (data + 4);
-	} else if (layout->pt_mode_logbook == 3) {
-		value = array_uint16_le (data + 16);
-	} else {
-		return array_uint16_le (data + 16);
-	}
+#define PREFETCH 8
 
-	unsigned int npages = (layout->memsize - layout->highmem) / pagesize;
-
-	if (npages > 0x2000) {
-		value &= 0x3FFF;
-	}  else if (npages > 0x1000) {
-		value &= 0x1FFF;
-	} else {
-		value &= 0x0FFF;
+/*
+ * The profile pointers in the logbook entries. The raw pointer decoding
+ * depends only on the logbook pointer mode, and is selected once per
+ * download. The conversion to an address is the same for all modes:
+ * the absolute pointers (mode 2) simply use a full mask, no offset and
+ * a unit page size.
+ */
+typedef struct oceanic_common_pointers_t {
+	unsigned int (*first) (const unsigned char data[]);
+	unsigned int (*last) (const unsigned char data[]);
+	unsigned int mask;
+	unsigned int offset;
+	unsigned int pagesize;
+} oceanic_common_pointers_t;
+
+#define POINTER(name,offset,shift) \
+	static unsigned int \
+	name (const unsigned char data[]) \
+	{ \
+		return array_uint16_le (data + offset) >> shift; \
 	}
 
-	return layout->highmem + value * pagesize;
-}
+POINTER (pointer_first_mode0, 5, 0)
+POINTER (pointer_last_mode0, 6, 4)
+POINTER (pointer_first_mode1, 4, 0)
+POINTER (pointer_last_mode1, 6, 0)
+POINTER (pointer_first_mode3, 16, 0)
+POINTER (pointer_last_mode3, 18, 0)
 
+#undef POINTER
 
-static unsigned int
-get_profile_last (const unsigned char data[], const oceanic_common_layout_t *layout, unsigned int pagesize)
+static void
+oceanic_common_pointers_init (oceanic_common_pointers_t *pointers, const oceanic_common_layout_t *layout, unsigned int pagesize)
 {
-	unsigned int value;
-
 	if (layout->pt_mode_logbook == 0) {
-		value = array_uint16_le (data + 6) >> 4;
+		pointers->first = pointer_first_mode0;
+		pointers->last = pointer_last_mode0;
 	} else if (layout->pt_mode_logbook == 1) {
-		value = array_uint16_le (data + 6);
-	} else if (layout->pt_mode_logbook == 3) {
-		value = array_uint16_le (data + 18);
+		pointers->first = pointer_first_mode1;
+		pointers->last = pointer_last_mode1;
 	} else {
-		return array_uint16_le(data + 18);
+		pointers->first = pointer_first_mode3;
+		pointers->last = pointer_last_mode3;
 	}
 
-	unsigned int npages = (layout->memsize - layout->highmem) / pagesize;
-
-	if (npages > 0x2000) {
-		value &= 0x3FFF;
-	} else if (npages > 0x1000) {
-		value &= 0x1FFF;
+	if (layout->pt_mode_logbook == 0 ||
+		layout->pt_mode_logbook == 1 ||
+		layout->pt_mode_logbook == 3) {
+		unsigned int npages = (layout->memsize - layout->highmem) / pagesize;
+		if (npages > 0x2000) {
+			pointers->mask = 0x3FFF;
+		} else if (npages > 0x1000) {
+			pointers->mask = 0x1FFF;
+		} else {
+			pointers->mask = 0x0FFF;
+		}
+		pointers->offset = layout->highmem;
+		pointers->pagesize = pagesize;
 	} else {
-		value &= 0x0FFF;
+		pointers->mask = 0xFFFF;
+		pointers->offset = 0;
+		pointers->pagesize = 1;
 	}
+}
+
+static unsigned int
+get_profile_first (const unsigned char data[], const oceanic_common_pointers_t *pointers)
+{
+	return pointers->offset + (pointers->first (data) & pointers->mask) * pointers->pagesize;
+}
 
-	return layout->highmem + value * pagesize;
+
+static unsigned int
+get_profile_last (const unsigned char data[], const oceanic_common_pointers_t *pointers)
+{
+	return pointers->offset + (pointers->last (data) & pointers->mask) * pointers->pagesize;
 }
 
 
@@ -110,6 +133,11 @@ oceanic_common_match_pattern (const unsigned char *string, const unsigned char *
 }
 
 
+/*
+ * The version patterns are only matched once, when the device is opened,
+ * against a few dozen short patterns. A linear scan with an early exit on
+ * the first mismatching byte is cheaper than building a lookup structure.
+ */
 int
 oceanic_common_match (const unsigned char *version, const oceanic_common_version_t patterns[], unsigned int n)
 {
@@ -183,29 +211,16 @@ oceanic_common_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 }
 
 
-dc_status_t
-oceanic_common_device_logbook (dc_device_t *abstract, dc_event_progress_t *progress, dc_buffer_t *logbook)
+/*
+ * Read the logbook pointers, and get the end and size of the used part
+ * of the logbook ringbuffer.
+ */
+static dc_status_t
+oceanic_common_device_pointers (dc_device_t *abstract, dc_event_progress_t *progress, unsigned int *end, unsigned int *size)
 {
 	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-
-	assert (device != NULL);
-	assert (device->layout != NULL);
-	assert (device->layout->rb_logbook_entry_size <= sizeof (device->fingerprint));
-	assert (progress != NULL);
-
 	const oceanic_common_layout_t *layout = device->layout;
-
-	// Erase the buffer.
-	if (!dc_buffer_clear (logbook))
-		return DC_STATUS_NOMEMORY;
-
-	// For devices without a logbook ringbuffer, downloading dives isn't
-	// possible. This is not considered a fatal error, but handled as if there
-	// are no dives present.
-	if (layout->rb_logbook_begin == layout->rb_logbook_end) {
-		return DC_STATUS_SUCCESS;
-	}
+	dc_status_t rc = DC_STATUS_SUCCESS;
 
 	// Read the pointer data.
 	unsigned char pointers[PAGESIZE] = {0};
@@ -257,6 +272,44 @@ oceanic_common_device_logbook (dc_device_t *abstract, dc_event_progress_t *progr
 	progress->maximum -= (layout->rb_logbook_end - layout->rb_logbook_begin) - rb_logbook_size;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 
+	*end = rb_logbook_end;
+	*size = rb_logbook_size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+oceanic_common_device_logbook (dc_device_t *abstract, dc_event_progress_t *progress, dc_buffer_t *logbook)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	assert (device != NULL);
+	assert (device->layout != NULL);
+	assert (device->layout->rb_logbook_entry_size <= sizeof (device->fingerprint));
+	assert (progress != NULL);
+
+	const oceanic_common_layout_t *layout = device->layout;
+
+	// Erase the buffer.
+	if (!dc_buffer_clear (logbook))
+		return DC_STATUS_NOMEMORY;
+
+	// For devices without a logbook ringbuffer, downloading dives isn't
+	// possible. This is not considered a fatal error, but handled as if there
+	// are no dives present.
+	if (layout->rb_logbook_begin == layout->rb_logbook_end) {
+		return DC_STATUS_SUCCESS;
+	}
+
+	// Get the logbook ringbuffer range.
+	unsigned int rb_logbook_end = 0, rb_logbook_size = 0;
+	rc = oceanic_common_device_pointers (abstract, progress, &rb_logbook_end, &rb_logbook_size);
+	if (rc != DC_STATUS_SUCCESS) {
+		return rc;
+	}
+
 	// Exit if there are no dives.
 	if (rb_logbook_size == 0) {
 		return DC_STATUS_SUCCESS;
@@ -350,6 +403,10 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 	// Get the pagesize
 	unsigned int pagesize = layout->highmem ? 16 * PAGESIZE : PAGESIZE;
 
+	// Select the profile pointer decoding.
+	oceanic_common_pointers_t pointers;
+	oceanic_common_pointers_init (&pointers, layout, pagesize);
+
 	// Cache the logbook pointer and size.
 	const unsigned char *logbooks = dc_buffer_get_data (logbook);
 	unsigned int rb_logbook_size = dc_buffer_get_size (logbook);
@@ -378,8 +435,8 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 		}
 
 		// Get the profile pointers.
-		unsigned int rb_entry_first = get_profile_first (logbooks + entry, layout, pagesize);
-		unsigned int rb_entry_last  = get_profile_last (logbooks + entry, layout, pagesize);
+		unsigned int rb_entry_first = get_profile_first (logbooks + entry, &pointers);
+		unsigned int rb_entry_last  = get_profile_last (logbooks + entry, &pointers);
 		if (rb_entry_first < layout->rb_profile_begin ||
 			rb_entry_first >= layout->rb_profile_end ||
 			rb_entry_last < layout->rb_profile_begin ||
@@ -433,7 +490,7 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 
 	// Create the ringbuffer stream.
 	dc_rbstream_t *rbstream = NULL;
-	rc = dc_rbstream_new (&rbstream, abstract, PAGESIZE, PAGESIZE * device->multipage, layout->rb_profile_begin, layout->rb_profile_end, rb_profile_end);
+	rc = dc_rbstream_new2 (&rbstream, abstract, PAGESIZE, PAGESIZE * device->multipage, PREFETCH, layout->rb_profile_begin, layout->rb_profile_end, rb_profile_end);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		return rc;
@@ -468,8 +525,8 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 		}
 
 		// Get the profile pointers.
-		unsigned int rb_entry_first = get_profile_first (logbooks + entry, layout, pagesize);
-		unsigned int rb_entry_last  = get_profile_last (logbooks + entry, layout, pagesize);
+		unsigned int rb_entry_first = get_profile_first (logbooks + entry, &pointers);
+		unsigned int rb_entry_last  = get_profile_last (logbooks + entry, &pointers);
 		if (rb_entry_first < layout->rb_profile_begin ||
 			rb_entry_first >= layout->rb_profile_end ||
 			rb_entry_last < layout->rb_profile_begin ||
@@ -499,11 +556,27 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 			break;
 		}
 
+		// Skip the gap, without reading it from the device.
+		if (gap) {
+			rc = dc_rbstream_seek (rbstream, rb_entry_end);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to skip the gap.");
+				dc_rbstream_free (rbstream);
+				free (profiles);
+				return rc;
+			}
+
+			// Update and emit a progress event.
+			progress->current += gap;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+		}
+
 		// Move to the start of the current dive.
-		offset -= rb_entry_size + gap;
+		offset -= rb_entry_size;
 
-		// Read the dive.
-		rc = dc_rbstream_read (rbstream, progress, profiles + offset, rb_entry_size + gap);
+		// Read the dive, without reading ahead into the next one.
+		dc_rbstream_limit (rbstream, rb_entry_size);
+		rc = dc_rbstream_read (rbstream, progress, profiles + offset, rb_entry_size);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
 			dc_rbstream_free (rbstream);
@@ -547,6 +620,207 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 }
 
 
+/*
+ * Download the logbook and profile ringbuffers together. Each logbook
+ * entry is processed as soon as it has been read, and the profile of
+ * that dive is read immediately afterwards. Only the current dive is
+ * kept in memory, and the download stops as soon as the fingerprint is
+ * found or the callback aborts, without reading the remaining logbook
+ * entries first.
+ */
+static dc_status_t
+oceanic_common_device_stream (dc_device_t *abstract, dc_event_progress_t *progress, dc_dive_callback_t callback, void *userdata)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+	const oceanic_common_layout_t *layout = device->layout;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	assert (layout->rb_logbook_entry_size <= sizeof (device->fingerprint));
+
+	// Get the pagesize
+	unsigned int pagesize = layout->highmem ? 16 * PAGESIZE : PAGESIZE;
+
+	// Select the profile pointer decoding.
+	oceanic_common_pointers_t pointers;
+	oceanic_common_pointers_init (&pointers, layout, pagesize);
+
+	// For devices without a logbook ringbuffer, downloading dives isn't
+	// possible. This is not considered a fatal error, but handled as if there
+	// are no dives present.
+	if (layout->rb_logbook_begin == layout->rb_logbook_end) {
+		return DC_STATUS_SUCCESS;
+	}
+
+	// Get the logbook ringbuffer range.
+	unsigned int rb_logbook_end = 0, rb_logbook_size = 0;
+	rc = oceanic_common_device_pointers (abstract, progress, &rb_logbook_end, &rb_logbook_size);
+	if (rc != DC_STATUS_SUCCESS) {
+		return rc;
+	}
+
+	// Exit if there are no dives.
+	if (rb_logbook_size == 0) {
+		goto done;
+	}
+
+	// Create the ringbuffer stream for the logbook entries. The stream
+	// for the profiles is created once the end of the most recent
+	// profile is known.
+	dc_rbstream_t *rblogbook = NULL, *rbprofile = NULL;
+	rc = dc_rbstream_new (&rblogbook, abstract, PAGESIZE, PAGESIZE * device->multipage, layout->rb_logbook_begin, layout->rb_logbook_end, rb_logbook_end);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+		return rc;
+	}
+
+	// Memory buffer for the logbook entry and the profile data.
+	dc_buffer_t *buffer = dc_buffer_new (0);
+	if (buffer == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		dc_rbstream_free (rblogbook);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned char entry[sizeof (device->fingerprint)];
+	unsigned int remaining = layout->rb_profile_end - layout->rb_profile_begin;
+	unsigned int previous = INVALID;
+	unsigned int nbytes = 0;
+	while (nbytes < rb_logbook_size) {
+		// Read the logbook entry.
+		rc = dc_rbstream_read (rblogbook, progress, entry, layout->rb_logbook_entry_size);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the memory.");
+			status = rc;
+			break;
+		}
+
+		nbytes += layout->rb_logbook_entry_size;
+
+		// Skip uninitialized entries.
+		if (array_isequal (entry, layout->rb_logbook_entry_size, 0xFF)) {
+			WARNING (abstract->context, "Uninitialized logbook entries detected!");
+			continue;
+		}
+
+		// Compare the fingerprint to identify previously downloaded entries.
+		if (memcmp (entry, device->fingerprint, layout->rb_logbook_entry_size) == 0) {
+			break;
+		}
+
+		// Get the profile pointers.
+		unsigned int rb_entry_first = get_profile_first (entry, &pointers);
+		unsigned int rb_entry_last  = get_profile_last (entry, &pointers);
+		if (rb_entry_first < layout->rb_profile_begin ||
+			rb_entry_first >= layout->rb_profile_end ||
+			rb_entry_last < layout->rb_profile_begin ||
+			rb_entry_last >= layout->rb_profile_end)
+		{
+			ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%06x 0x%06x).",
+				rb_entry_first, rb_entry_last);
+			status = DC_STATUS_DATAFORMAT;
+			break;
+		}
+
+		// Calculate the end pointer and the number of bytes.
+		unsigned int rb_entry_end   = RB_PROFILE_INCR (rb_entry_last, pagesize, layout);
+		unsigned int rb_entry_size  = RB_PROFILE_DISTANCE (rb_entry_first, rb_entry_last, layout) + pagesize;
+
+		// Take the end pointer of the most recent logbook entry as the
+		// end of profile pointer.
+		if (rbprofile == NULL) {
+			rc = dc_rbstream_new2 (&rbprofile, abstract, PAGESIZE, PAGESIZE * device->multipage, PREFETCH, layout->rb_profile_begin, layout->rb_profile_end, rb_entry_end);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+				status = rc;
+				break;
+			}
+			previous = rb_entry_end;
+		}
+
+		// Skip gaps between the profiles.
+		unsigned int gap = 0;
+		if (rb_entry_end != previous) {
+			WARNING (abstract->context, "Profiles are not continuous.");
+			gap = RB_PROFILE_DISTANCE (rb_entry_end, previous, layout);
+		}
+
+		// Make sure the profile size is valid.
+		if (rb_entry_size + gap > remaining) {
+			WARNING (abstract->context, "Unexpected profile size.");
+			break;
+		}
+
+		// Skip the gap, without reading it from the device.
+		if (gap) {
+			rc = dc_rbstream_seek (rbprofile, rb_entry_end);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (abstract->context, "Failed to skip the gap.");
+				status = rc;
+				break;
+			}
+
+			// Update and emit a progress event.
+			progress->current += gap;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+		}
+
+		// Read the dive, after the logbook entry.
+		if (!dc_buffer_resize (buffer, layout->rb_logbook_entry_size + rb_entry_size)) {
+			ERROR (abstract->context, "Insufficient buffer space available.");
+			status = DC_STATUS_NOMEMORY;
+			break;
+		}
+		unsigned char *p = dc_buffer_get_data (buffer);
+		memcpy (p, entry, layout->rb_logbook_entry_size);
+
+		dc_rbstream_limit (rbprofile, rb_entry_size);
+		rc = dc_rbstream_read (rbprofile, progress, p + layout->rb_logbook_entry_size, rb_entry_size);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the dive.");
+			status = rc;
+			break;
+		}
+
+		remaining -= rb_entry_size + gap;
+		previous = rb_entry_first;
+
+		// Remove padding from the profile.
+		if (layout->highmem) {
+			// The logbook entry contains the total number of pages containing
+			// profile data, excluding the footer page. Limit the profile size
+			// to this size.
+			unsigned int value = array_uint16_le (p + 12);
+			unsigned int value_hi = value & 0xE000;
+			unsigned int value_lo = value & 0x0FFF;
+			unsigned int npages = ((value_hi >> 1) | value_lo) + 1;
+			unsigned int length = npages * PAGESIZE;
+			if (rb_entry_size > length) {
+				rb_entry_size = length;
+			}
+		}
+
+		if (callback && !callback (p, rb_entry_size + layout->rb_logbook_entry_size, p, layout->rb_logbook_entry_size, userdata)) {
+			break;
+		}
+	}
+
+	dc_buffer_free (buffer);
+	dc_rbstream_free (rbprofile);
+	dc_rbstream_free (rblogbook);
+
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+done:
+	// The total amount of data is only known at the end.
+	progress->maximum = progress->current;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
@@ -597,6 +871,13 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 			(id[13] & 0x0F) * 10     + ((id[13] & 0xF0) >> 4) * 1;
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
+	// Backends with their own logbook or profile implementation need the
+	// entire logbook first.
+	if (VTABLE(abstract)->logbook == oceanic_common_device_logbook &&
+		VTABLE(abstract)->profile == oceanic_common_device_profile) {
+		return oceanic_common_device_stream (abstract, &progress, callback, userdata);
+	}
+
 	// Memory buffer for the logbook data.
 	dc_buffer_t *logbook = dc_buffer_new (0);
 	if (logbook == NULL) {
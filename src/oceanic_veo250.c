@@ -28,11 +28,14 @@
 #include "device-private.h"
 #include "ringbuffer.h"
 #include "checksum.h"
+#include "timer.h"
+#include "retry.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &oceanic_veo250_device_vtable.base)
 
 #define MAXRETRIES 2
 #define MULTIPAGE  4
+#define KEEPALIVE  1000 // ms
 
 #define ACK 0x5A
 #define NAK 0xA5
@@ -40,6 +43,8 @@
 typedef struct oceanic_veo250_device_t {
 	oceanic_common_device_t base;
 	dc_iostream_t *iostream;
+	dc_timer_t *timer;
+	dc_usecs_t activity;
 	unsigned int last;
 } oceanic_veo250_device_t;
 
@@ -52,10 +57,12 @@ static const oceanic_common_device_vtable_t oceanic_veo250_device_vtable = {
 		DC_FAMILY_OCEANIC_VEO250,
 		oceanic_common_device_set_fingerprint, /* set_fingerprint */
 		oceanic_veo250_device_read, /* read */
+		NULL, /* read_multi */
 		NULL, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
 		NULL, /* timesync */
+		oceanic_veo250_device_keepalive, /* keepalive */
 		oceanic_veo250_device_close /* close */
 	},
 	oceanic_common_device_logbook,
@@ -126,6 +133,8 @@ oceanic_veo250_send (oceanic_veo250_device_t *device, const unsigned char comman
 }
 
 
+static const dc_retry_policy_t oceanic_veo250_retry = {MAXRETRIES, 100, 0, DC_RETRY_BACKOFF};
+
 static dc_status_t
 oceanic_veo250_transfer (oceanic_veo250_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
@@ -138,18 +147,13 @@ oceanic_veo250_transfer (oceanic_veo250_device_t *device, const unsigned char co
 	// a NAK byte, we try to resend the command a number of times before
 	// returning an error.
 
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &oceanic_veo250_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = oceanic_veo250_send (device, command, csize)) != DC_STATUS_SUCCESS) {
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
+		if (!dc_retry_again (&retry, device->iostream, rc))
 			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 100);
 	}
 
 	// Receive the answer of the dive computer.
@@ -165,6 +169,9 @@ oceanic_veo250_transfer (oceanic_veo250_device_t *device, const unsigned char co
 		return DC_STATUS_PROTOCOL;
 	}
 
+	// Remember the time of the last successful command.
+	dc_timer_now (device->timer, &device->activity);
+
 	return DC_STATUS_SUCCESS;
 }
 
@@ -249,27 +256,35 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, dc_iostrea
 
 	// Set the default values.
 	device->iostream = iostream;
+	device->activity = 0;
 	device->last = 0;
 
+	// Create a high resolution timer.
+	status = dc_timer_new (&device->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free;
+	}
+
 	// Set the serial communication protocol (9600 8N1).
 	status = dc_iostream_configure (device->iostream, 9600, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the terminal attributes.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Set the timeout for receiving data (3000 ms).
 	status = dc_iostream_set_timeout (device->iostream, 3000);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the timeout.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Set the DTR line.
 	status = dc_iostream_set_dtr (device->iostream, 1);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the DTR line.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Clear the RTS line to reset the PIC inside the data cable as it
@@ -280,7 +295,7 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, dc_iostrea
 	status = dc_iostream_set_rts (device->iostream, 0);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to clear the RTS line.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Hold RTS clear for a bit to allow PIC to reset.
@@ -290,7 +305,7 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, dc_iostrea
 	status = dc_iostream_set_rts (device->iostream, 1);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the RTS line.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Give the interface 100 ms to settle and draw power up.
@@ -302,7 +317,7 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, dc_iostrea
 	// Initialize the data cable (PPS mode).
 	status = oceanic_veo250_init (device);
 	if (status != DC_STATUS_SUCCESS) {
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Delay the sending of the version command.
@@ -313,7 +328,7 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, dc_iostrea
 	// the user), or already in download mode.
 	status = oceanic_veo250_device_version ((dc_device_t *) device, device->base.version, sizeof (device->base.version));
 	if (status != DC_STATUS_SUCCESS) {
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Override the base class values.
@@ -328,6 +343,8 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, dc_iostrea
 
 	return DC_STATUS_SUCCESS;
 
+error_timer_free:
+	dc_timer_free (device->timer);
 error_free:
 	dc_device_deallocate ((dc_device_t *) device);
 	return status;
@@ -347,6 +364,8 @@ oceanic_veo250_device_close (dc_device_t *abstract)
 		dc_status_set_error(&status, rc);
 	}
 
+	dc_timer_free (device->timer);
+
 	return status;
 }
 
@@ -359,6 +378,14 @@ oceanic_veo250_device_keepalive (dc_device_t *abstract)
 	if (!ISINSTANCE (abstract))
 		return DC_STATUS_INVALIDARGS;
 
+	// Every command keeps the device in download mode. Therefore the
+	// keepalive is only needed after a period without any other
+	// commands, and not after every read.
+	dc_usecs_t now = 0;
+	if (dc_timer_now (device->timer, &now) == DC_STATUS_SUCCESS &&
+		now - device->activity < KEEPALIVE * 1000)
+		return DC_STATUS_SUCCESS;
+
 	unsigned char answer[2] = {0};
 	unsigned char command[4] = {0x91,
 		(device->last     ) & 0xFF, // low
@@ -145,10 +145,10 @@ oceanic_veo250_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, un
 	if (size < 7 * PAGESIZE / 2)
 		return DC_STATUS_DATAFORMAT;
 
-	if (!parser->cached) {
+	if (!parser->cached && (type == DC_FIELD_DIVETIME || type == DC_FIELD_MAXDEPTH)) {
 		sample_statistics_t statistics = SAMPLE_STATISTICS_INITIALIZER;
-		dc_status_t rc = oceanic_veo250_parser_samples_foreach (
-			abstract, sample_statistics_cb, &statistics);
+		dc_status_t rc = sample_statistics_walk (abstract,
+			oceanic_veo250_parser_samples_foreach, &statistics);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 
@@ -237,10 +237,12 @@ oceanic_veo250_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback
 		if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
 
 		// Vendor specific data
-		sample.vendor.type = SAMPLE_VENDOR_OCEANIC_VEO250;
-		sample.vendor.size = PAGESIZE / 2;
-		sample.vendor.data = data + offset;
-		if (callback) callback (DC_SAMPLE_VENDOR, sample, userdata);
+		if (PARSER_SAMPLE_WANTED (abstract, DC_SAMPLE_VENDOR)) {
+			sample.vendor.type = SAMPLE_VENDOR_OCEANIC_VEO250;
+			sample.vendor.size = PAGESIZE / 2;
+			sample.vendor.data = data + offset;
+			if (callback) callback (DC_SAMPLE_VENDOR, sample, userdata);
+		}
 
 		// Depth (ft)
 		unsigned int depth = data[offset + 2];
@@ -29,12 +29,14 @@
 #include "device-private.h"
 #include "ringbuffer.h"
 #include "checksum.h"
+#include "timer.h"
 #include "array.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &oceanic_vtpro_device_vtable.base)
 
 #define MAXRETRIES 2
 #define MULTIPAGE  4
+#define KEEPALIVE  1000 // ms
 
 #define ACK 0x5A
 #define NAK 0xA5
@@ -50,6 +52,8 @@ typedef enum oceanic_vtpro_protocol_t {
 typedef struct oceanic_vtpro_device_t {
 	oceanic_common_device_t base;
 	dc_iostream_t *iostream;
+	dc_timer_t *timer;
+	dc_usecs_t activity;
 	unsigned int model;
 	oceanic_vtpro_protocol_t protocol;
 } oceanic_vtpro_device_t;
@@ -64,10 +68,12 @@ static const oceanic_common_device_vtable_t oceanic_vtpro_device_vtable = {
 		DC_FAMILY_OCEANIC_VTPRO,
 		oceanic_common_device_set_fingerprint, /* set_fingerprint */
 		oceanic_vtpro_device_read, /* read */
+		NULL, /* read_multi */
 		NULL, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
 		NULL, /* timesync */
+		oceanic_vtpro_device_keepalive, /* keepalive */
 		oceanic_vtpro_device_close /* close */
 	},
 	oceanic_vtpro_device_logbook,
@@ -198,6 +204,9 @@ oceanic_vtpro_transfer (oceanic_vtpro_device_t *device, const unsigned char comm
 		}
 	}
 
+	// Remember the time of the last successful command.
+	dc_timer_now (device->timer, &device->activity);
+
 	return DC_STATUS_SUCCESS;
 }
 
@@ -414,6 +423,7 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 
 	// Set the default values.
 	device->iostream = iostream;
+	device->activity = 0;
 	device->model = model;
 	if (model == AERIS500AI) {
 		device->protocol = INTR;
@@ -421,25 +431,32 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 		device->protocol = MOD;
 	}
 
+	// Create a high resolution timer.
+	status = dc_timer_new (&device->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free;
+	}
+
 	// Set the serial communication protocol (9600 8N1).
 	status = dc_iostream_configure (device->iostream, 9600, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the terminal attributes.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Set the timeout for receiving data (3000 ms).
 	status = dc_iostream_set_timeout (device->iostream, 3000);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the timeout.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Set the DTR line.
 	status = dc_iostream_set_dtr (device->iostream, 1);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the DTR line.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Clear the RTS line to reset the PIC inside the data cable as it
@@ -450,7 +467,7 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 	status = dc_iostream_set_rts (device->iostream, 0);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to clear the RTS line.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Hold RTS clear for a bit to allow PIC to reset.
@@ -460,7 +477,7 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 	status = dc_iostream_set_rts (device->iostream, 1);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the RTS line.");
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Give the interface 100 ms to settle and draw power up.
@@ -472,7 +489,7 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 	// Initialize the data cable (MOD mode).
 	status = oceanic_vtpro_init (device);
 	if (status != DC_STATUS_SUCCESS) {
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Switch the device from surface mode into download mode. Before sending
@@ -480,7 +497,7 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 	// the user), or already in download mode.
 	status = oceanic_vtpro_device_version ((dc_device_t *) device, device->base.version, sizeof (device->base.version));
 	if (status != DC_STATUS_SUCCESS) {
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Calibrate the device. Although calibration is optional, it's highly
@@ -488,7 +505,7 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 	// when processing the command itself is quite slow.
 	status = oceanic_vtpro_calibrate (device);
 	if (status != DC_STATUS_SUCCESS) {
-		goto error_free;
+		goto error_timer_free;
 	}
 
 	// Override the base class values.
@@ -507,6 +524,8 @@ oceanic_vtpro_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 
 	return DC_STATUS_SUCCESS;
 
+error_timer_free:
+	dc_timer_free (device->timer);
 error_free:
 	dc_device_deallocate ((dc_device_t *) device);
 	return status;
@@ -526,6 +545,8 @@ oceanic_vtpro_device_close (dc_device_t *abstract)
 		dc_status_set_error(&status, rc);
 	}
 
+	dc_timer_free (device->timer);
+
 	return status;
 }
 
@@ -538,6 +559,14 @@ oceanic_vtpro_device_keepalive (dc_device_t *abstract)
 	if (!ISINSTANCE (abstract))
 		return DC_STATUS_INVALIDARGS;
 
+	// Every command keeps the device in download mode. Therefore the
+	// keepalive is only needed after a period without any other
+	// commands, and not after every read.
+	dc_usecs_t now = 0;
+	if (dc_timer_now (device->timer, &now) == DC_STATUS_SUCCESS &&
+		now - device->activity < KEEPALIVE * 1000)
+		return DC_STATUS_SUCCESS;
+
 	// Send the command to the dive computer.
 	unsigned char answer[1] = {0};
 	unsigned char command[4] = {0x6A, 0x08, 0x00, 0x00};
@@ -0,0 +1,243 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pagecache.h"
+#include "context-private.h"
+
+/*
+ * A fixed number of pages with a least recently used replacement. The
+ * caches are small (typically a few hundred pages), so the pages are
+ * simply searched one by one.
+ */
+
+typedef struct dc_pagecache_page_t {
+	unsigned int page;
+	unsigned int stamp;
+	unsigned char *data;
+} dc_pagecache_page_t;
+
+struct dc_pagecache_t {
+	dc_context_t *context;
+	unsigned int pagesize;
+	unsigned int npages;
+	unsigned int clock;
+	unsigned int hits;
+	unsigned int misses;
+	dc_pagecache_page_t *pages;
+	unsigned char *storage;
+};
+
+static dc_pagecache_page_t *
+dc_pagecache_find (dc_pagecache_t *cache, unsigned int page)
+{
+	for (unsigned int i = 0; i < cache->npages; ++i) {
+		if (cache->pages[i].stamp && cache->pages[i].page == page)
+			return cache->pages + i;
+	}
+
+	return NULL;
+}
+
+static void
+dc_pagecache_touch (dc_pagecache_t *cache, dc_pagecache_page_t *entry)
+{
+	// On a wrap around of the clock, all pages become equally old.
+	if (++cache->clock == 0) {
+		for (unsigned int i = 0; i < cache->npages; ++i) {
+			if (cache->pages[i].stamp)
+				cache->pages[i].stamp = 1;
+		}
+		cache->clock = 2;
+	}
+
+	entry->stamp = cache->clock;
+}
+
+static void
+dc_pagecache_insert (dc_pagecache_t *cache, unsigned int page, const unsigned char data[])
+{
+	// Take an empty page, or else the least recently used one.
+	dc_pagecache_page_t *entry = cache->pages;
+	for (unsigned int i = 0; i < cache->npages && entry->stamp; ++i) {
+		if (cache->pages[i].stamp < entry->stamp)
+			entry = cache->pages + i;
+	}
+
+	entry->page = page;
+	memcpy (entry->data, data, cache->pagesize);
+	dc_pagecache_touch (cache, entry);
+}
+
+static void
+dc_pagecache_copy (dc_pagecache_t *cache, unsigned int page, const unsigned char src[], unsigned int address, unsigned char data[], unsigned int size)
+{
+	// Copy the part of the page within the requested range.
+	unsigned int begin = page * cache->pagesize;
+	unsigned int end = begin + cache->pagesize;
+	unsigned int lo = begin > address ? begin : address;
+	unsigned int hi = end - address < size ? end : address + size;
+
+	memcpy (data + (lo - address), src + (lo - begin), hi - lo);
+}
+
+dc_status_t
+dc_pagecache_new (dc_pagecache_t **out, dc_context_t *context, unsigned int pagesize, unsigned int npages)
+{
+	dc_pagecache_t *cache = NULL;
+
+	if (out == NULL || pagesize == 0 || npages == 0)
+		return DC_STATUS_INVALIDARGS;
+
+	cache = (dc_pagecache_t *) malloc (sizeof (dc_pagecache_t));
+	if (cache == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	cache->context = context;
+	cache->pagesize = pagesize;
+	cache->npages = npages;
+	cache->clock = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->pages = (dc_pagecache_page_t *) malloc (npages * sizeof (dc_pagecache_page_t));
+	cache->storage = (unsigned char *) malloc ((size_t) npages * pagesize);
+	if (cache->pages == NULL || cache->storage == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		free (cache->storage);
+		free (cache->pages);
+		free (cache);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	for (unsigned int i = 0; i < npages; ++i) {
+		cache->pages[i].page = 0;
+		cache->pages[i].stamp = 0;
+		cache->pages[i].data = cache->storage + (size_t) i * pagesize;
+	}
+
+	*out = cache;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_pagecache_read (dc_pagecache_t *cache, dc_device_t *device, dc_pagecache_read_t read, unsigned int address, unsigned char data[], unsigned int size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// Ranges at the very end of the address space are not cached.
+	if (size == 0 || address + size < address ||
+		(address + size - 1) / cache->pagesize + 1 > 0xFFFFFFFFU / cache->pagesize)
+		return read (device, address, data, size);
+
+	unsigned int first = address / cache->pagesize;
+	unsigned int last = (address + size - 1) / cache->pagesize;
+
+	unsigned int page = first;
+	while (page <= last) {
+		dc_pagecache_page_t *entry = dc_pagecache_find (cache, page);
+		if (entry) {
+			dc_pagecache_copy (cache, page, entry->data, address, data, size);
+			dc_pagecache_touch (cache, entry);
+			cache->hits++;
+			page++;
+			continue;
+		}
+
+		// Read all consecutive missing pages at once.
+		unsigned int count = 1;
+		while (page + count <= last && dc_pagecache_find (cache, page + count) == NULL)
+			count++;
+
+		cache->misses += count;
+
+		unsigned int begin = page * cache->pagesize;
+		unsigned int length = count * cache->pagesize;
+		unsigned char *buffer = (unsigned char *) malloc (length);
+		if (buffer == NULL) {
+			ERROR (cache->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		status = read (device, begin, buffer, length);
+		if (status == DC_STATUS_INVALIDARGS && (begin < address || begin + length > address + size)) {
+			// The pages probably extend beyond the end of the memory.
+			// Read only the requested part, without caching it.
+			unsigned int lo = begin > address ? begin : address;
+			unsigned int hi = begin + length < address + size ? begin + length : address + size;
+			status = read (device, lo, data + (lo - address), hi - lo);
+		} else if (status == DC_STATUS_SUCCESS) {
+			for (unsigned int i = 0; i < count; ++i) {
+				const unsigned char *src = buffer + i * cache->pagesize;
+				dc_pagecache_insert (cache, page + i, src);
+				dc_pagecache_copy (cache, page + i, src, address, data, size);
+			}
+		}
+
+		free (buffer);
+
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		page += count;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+dc_pagecache_invalidate (dc_pagecache_t *cache, unsigned int address, unsigned int size)
+{
+	if (cache == NULL || size == 0)
+		return;
+
+	for (unsigned int i = 0; i < cache->npages; ++i) {
+		dc_pagecache_page_t *entry = cache->pages + i;
+		if (entry->stamp == 0)
+			continue;
+
+		unsigned int begin = entry->page * cache->pagesize;
+		if (begin - address < size || address - begin < cache->pagesize)
+			entry->stamp = 0;
+	}
+}
+
+void
+dc_pagecache_get_stats (dc_pagecache_t *cache, dc_device_cache_stats_t *stats)
+{
+	stats->hits = cache ? cache->hits : 0;
+	stats->misses = cache ? cache->misses : 0;
+}
+
+void
+dc_pagecache_free (dc_pagecache_t *cache)
+{
+	if (cache == NULL)
+		return;
+
+	free (cache->storage);
+	free (cache->pages);
+	free (cache);
+}
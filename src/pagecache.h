@@ -0,0 +1,63 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_PAGECACHE_H
+#define DC_PAGECACHE_H
+
+#include <libdivecomputer/device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dc_pagecache_t dc_pagecache_t;
+
+/*
+ * The function to read the missing pages from the device.
+ */
+typedef dc_status_t (*dc_pagecache_read_t) (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size);
+
+dc_status_t
+dc_pagecache_new (dc_pagecache_t **cache, dc_context_t *context, unsigned int pagesize, unsigned int npages);
+
+/*
+ * Read a range of memory. The cached pages are copied, and the missing
+ * pages are read with as few device reads as possible.
+ */
+dc_status_t
+dc_pagecache_read (dc_pagecache_t *cache, dc_device_t *device, dc_pagecache_read_t read, unsigned int address, unsigned char data[], unsigned int size);
+
+/*
+ * Drop all cached pages which overlap with a range of memory.
+ */
+void
+dc_pagecache_invalidate (dc_pagecache_t *cache, unsigned int address, unsigned int size);
+
+void
+dc_pagecache_get_stats (dc_pagecache_t *cache, dc_device_cache_stats_t *stats);
+
+void
+dc_pagecache_free (dc_pagecache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_PAGECACHE_H */
@@ -24,6 +24,7 @@
 
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/parser.h>
+#include <libdivecomputer/buffer.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,12 +34,28 @@ struct dc_parser_t;
 struct dc_parser_vtable_t;
 
 typedef struct dc_parser_vtable_t dc_parser_vtable_t;
+typedef struct dc_parser_stream_t dc_parser_stream_t;
+
+#define PARSER_NOPROFILE 0x01
+#define PARSER_PROFILE   0x02
+#define PARSER_NOVENDOR  0x04
 
 struct dc_parser_t {
 	const dc_parser_vtable_t *vtable;
 	dc_context_t *context;
 	const unsigned char *data;
 	unsigned int size;
+	unsigned int flags;
+	unsigned int model;
+	unsigned int devtime;
+	dc_ticks_t systime;
+	unsigned int settings; // Checksum of the backend settings.
+	dc_parser_cache_t *cache;
+	struct dc_parser_cache_entry_t *entry;
+	struct dc_parser_stream_t *stream;
+	unsigned int filter;
+	unsigned int scratch; // Allocated in caller provided scratch memory.
+	dc_arena_t *arena; // Temporary memory of dc_parser_materialize.
 };
 
 struct dc_parser_vtable_t {
@@ -63,6 +80,41 @@ dc_parser_allocate (dc_context_t *context, const dc_parser_vtable_t *vtable);
 void
 dc_parser_deallocate (dc_parser_t *parser);
 
+/*
+ * Reserve working memory for the parser, from the scratch memory of
+ * dc_parser_new_scratch. Must be called from the create function, after
+ * dc_parser_allocate. For a parser on the heap, the memory is NULL, and
+ * the parser allocates its working memory itself. The reserved size is
+ * included in the size reported by dc_parser_get_scratch_size.
+ */
+dc_status_t
+dc_parser_reserve (dc_parser_t *parser, size_t size, void **memory);
+
+/*
+ * Report a change of the backend settings which affect the decoded
+ * results, like the calibration. The settings are part of the key of the
+ * cached results.
+ */
+void
+dc_parser_set_settings (dc_parser_t *parser, const void *settings, size_t size);
+
+dc_status_t
+dc_parser_pool_get_internal (dc_parser_pool_t *pool, dc_parser_t **parser, dc_family_t family, unsigned int model, unsigned int devtime, dc_ticks_t systime);
+
+/*
+ * Destroy the oldest idle parsers, until the pool has no more than the
+ * maximum number of parsers.
+ */
+void
+dc_parser_pool_trim (dc_parser_pool_t *pool, size_t maximum);
+
+/*
+ * Return the parsers that are still in use to the pool, which resets
+ * their configuration. Only valid once all the users are finished.
+ */
+void
+dc_parser_pool_reclaim (dc_parser_pool_t *pool);
+
 int
 dc_parser_isinstance (dc_parser_t *parser, const dc_parser_vtable_t *vtable);
 
@@ -76,6 +128,30 @@ typedef struct sample_statistics_t {
 void
 sample_statistics_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata);
 
+dc_status_t
+sample_statistics_walk (dc_parser_t *parser, dc_status_t (*foreach) (dc_parser_t *, dc_sample_callback_t, void *), sample_statistics_t *statistics);
+
+/*
+ * Lazy evaluation of the fields which are only available after a walk
+ * over the profile. The backends pass a mask with the fields that depend
+ * on the profile, and the profile is walked (without a callback) only
+ * when the requested field is one of them. Like the statistics walk, the
+ * walk is recorded for the summary, and skipped for a header-only summary.
+ * The backends remain responsible for walking the profile only once.
+ */
+#define PARSER_FIELD(type) (1u << (type))
+
+/*
+ * The sample types requested by a filtered samples walk. The filter is
+ * applied to the callback anyway, but backends can test it to skip the
+ * decoding of the data that would be dropped.
+ */
+#define PARSER_SAMPLE(type) (1u << (type))
+#define PARSER_SAMPLE_WANTED(parser,type) ((parser)->filter & PARSER_SAMPLE (type))
+
+dc_status_t
+sample_profile_walk (dc_parser_t *parser, dc_status_t (*foreach) (dc_parser_t *, dc_sample_callback_t, void *), unsigned int fields, dc_field_type_t type);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
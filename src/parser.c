@@ -19,52 +19,30 @@
  * MA 02110-1301 USA
  */
 
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
-
-#include "suunto_d9.h"
-#include "suunto_eon.h"
-#include "suunto_eonsteel.h"
-#include "suunto_solution.h"
-#include "suunto_vyper2.h"
-#include "suunto_vyper.h"
-#include "reefnet_sensus.h"
-#include "reefnet_sensuspro.h"
-#include "reefnet_sensusultra.h"
-#include "uwatec_aladin.h"
-#include "uwatec_memomouse.h"
-#include "uwatec_smart.h"
-#include "oceanic_atom2.h"
-#include "oceanic_atom2.h"
-#include "oceanic_veo250.h"
-#include "oceanic_vtpro.h"
-#include "mares_darwin.h"
-#include "mares_iconhd.h"
-#include "mares_nemo.h"
-#include "mares_puck.h"
-#include "hw_frog.h"
-#include "hw_ostc.h"
-#include "hw_ostc3.h"
-#include "cressi_edy.h"
-#include "cressi_leonardo.h"
-#include "cressi_goa.h"
-#include "zeagle_n2ition3.h"
-#include "atomics_cobalt.h"
-#include "shearwater_petrel.h"
-#include "shearwater_predator.h"
-#include "diverite_nitekq.h"
-#include "citizen_aqualand.h"
-#include "divesystem_idive.h"
-#include "cochran_commander.h"
-#include "tecdiving_divecomputereu.h"
-#include "mclean_extreme.h"
-#include "liquivision_lynx.h"
+#include <math.h>
 
 #include "context-private.h"
 #include "parser-private.h"
 #include "device-private.h"
+#include "registry.h"
+#include "thread.h"
+#include "cache.h"
+#include "allocator.h"
+#include "platform.h"
+#include "trace.h"
+#include "executor-private.h"
+#include "checksum.h"
 
-#define REACTPROWHITE 0x4354
+struct dc_parser_stream_t {
+	dc_buffer_t *data;
+	dc_buffer_t *pending;
+	unsigned int nrows;
+	unsigned int active;
+};
 
 static dc_status_t
 dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, dc_family_t family, unsigned int model, unsigned int devtime, dc_ticks_t systime)
@@ -75,113 +53,16 @@ dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, dc_family_t fa
 	if (out == NULL)
 		return DC_STATUS_INVALIDARGS;
 
-	switch (family) {
-	case DC_FAMILY_SUUNTO_SOLUTION:
-		rc = suunto_solution_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_SUUNTO_EON:
-		rc = suunto_eon_parser_create (&parser, context, 0);
-		break;
-	case DC_FAMILY_SUUNTO_VYPER:
-		if (model == 0x01)
-			rc = suunto_eon_parser_create (&parser, context, 1);
-		else
-			rc = suunto_vyper_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_SUUNTO_VYPER2:
-	case DC_FAMILY_SUUNTO_D9:
-		rc = suunto_d9_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_SUUNTO_EONSTEEL:
-		rc = suunto_eonsteel_parser_create(&parser, context, model);
-		break;
-	case DC_FAMILY_UWATEC_ALADIN:
-	case DC_FAMILY_UWATEC_MEMOMOUSE:
-		rc = uwatec_memomouse_parser_create (&parser, context, devtime, systime);
-		break;
-	case DC_FAMILY_UWATEC_SMART:
-		rc = uwatec_smart_parser_create (&parser, context, model, devtime, systime);
-		break;
-	case DC_FAMILY_REEFNET_SENSUS:
-		rc = reefnet_sensus_parser_create (&parser, context, devtime, systime);
-		break;
-	case DC_FAMILY_REEFNET_SENSUSPRO:
-		rc = reefnet_sensuspro_parser_create (&parser, context, devtime, systime);
-		break;
-	case DC_FAMILY_REEFNET_SENSUSULTRA:
-		rc = reefnet_sensusultra_parser_create (&parser, context, devtime, systime);
-		break;
-	case DC_FAMILY_OCEANIC_VTPRO:
-		rc = oceanic_vtpro_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_OCEANIC_VEO250:
-		rc = oceanic_veo250_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_OCEANIC_ATOM2:
-		if (model == REACTPROWHITE)
-			rc = oceanic_veo250_parser_create (&parser, context, model);
-		else
-			rc = oceanic_atom2_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_MARES_NEMO:
-	case DC_FAMILY_MARES_PUCK:
-		rc = mares_nemo_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_MARES_DARWIN:
-		rc = mares_darwin_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_MARES_ICONHD:
-		rc = mares_iconhd_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_HW_OSTC:
-		rc = hw_ostc_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_HW_FROG:
-	case DC_FAMILY_HW_OSTC3:
-		rc = hw_ostc3_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_CRESSI_EDY:
-	case DC_FAMILY_ZEAGLE_N2ITION3:
-		rc = cressi_edy_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_CRESSI_LEONARDO:
-		rc = cressi_leonardo_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_CRESSI_GOA:
-		rc = cressi_goa_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_ATOMICS_COBALT:
-		rc = atomics_cobalt_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_SHEARWATER_PREDATOR:
-		rc = shearwater_predator_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_SHEARWATER_PETREL:
-		rc = shearwater_petrel_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_DIVERITE_NITEKQ:
-		rc = diverite_nitekq_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_CITIZEN_AQUALAND:
-		rc = citizen_aqualand_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_DIVESYSTEM_IDIVE:
-		rc = divesystem_idive_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_COCHRAN_COMMANDER:
-		rc = cochran_commander_parser_create (&parser, context, model);
-		break;
-	case DC_FAMILY_TECDIVING_DIVECOMPUTEREU:
-		rc = tecdiving_divecomputereu_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_MCLEAN_EXTREME:
-		rc = mclean_extreme_parser_create (&parser, context);
-		break;
-	case DC_FAMILY_LIQUIVISION_LYNX:
-		rc = liquivision_lynx_parser_create (&parser, context, model);
-		break;
-	default:
+	const dc_backend_t *backend = dc_backend_find (family);
+	if (backend == NULL)
 		return DC_STATUS_INVALIDARGS;
+
+	rc = backend->parser_create (&parser, context, model, devtime, systime);
+
+	if (rc == DC_STATUS_SUCCESS) {
+		parser->model = model;
+		parser->devtime = devtime;
+		parser->systime = systime;
 	}
 
 	*out = parser;
@@ -208,26 +89,125 @@ dc_parser_new2 (dc_parser_t **out, dc_context_t *context, dc_descriptor_t *descr
 		devtime, systime);
 }
 
+/*
+ * The scratch memory of the parser that is being created by the current
+ * thread. The create functions of the backends have no parameter for
+ * it, so dc_parser_allocate and dc_parser_reserve pick it up from here.
+ * Without data, only the required size is calculated, and the parser is
+ * allocated on the heap.
+ */
+typedef struct dc_parser_scratch_t {
+	unsigned char *data;
+	size_t size;
+	size_t used;
+	size_t required;
+} dc_parser_scratch_t;
+
+typedef union dc_parser_align_t {
+	void *p;
+	long long l;
+	double d;
+} dc_parser_align_t;
+
+#define SCRATCH_ALIGN(n) (((n) + sizeof (dc_parser_align_t) - 1) & ~(sizeof (dc_parser_align_t) - 1))
+
+static DC_THREAD_LOCAL dc_parser_scratch_t *g_scratch = NULL;
+
+static dc_status_t
+dc_parser_new_scratch_internal (dc_parser_t **out, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dc_parser_scratch_t *scratch)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (descriptor == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	g_scratch = scratch;
+	status = dc_parser_new_internal (out, context,
+		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor),
+		devtime, systime);
+	g_scratch = NULL;
+
+	return status;
+}
+
+dc_status_t
+dc_parser_get_scratch_size (dc_context_t *context, dc_descriptor_t *descriptor, size_t *size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+
+	if (size == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Create the parser once, to collect its memory requirements.
+	dc_parser_scratch_t scratch = {NULL, 0, 0, 0};
+	status = dc_parser_new_scratch_internal (&parser, context, descriptor, 0, 0, &scratch);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_parser_destroy (parser);
+
+	*size = scratch.required;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parser_new_scratch (dc_parser_t **out, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, void *memory, size_t size)
+{
+	if (out == NULL || memory == NULL ||
+		((size_t) memory % sizeof (dc_parser_align_t)) != 0)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_parser_scratch_t scratch = {(unsigned char *) memory, size, 0, 0};
+	return dc_parser_new_scratch_internal (out, context, descriptor, devtime, systime, &scratch);
+}
+
 dc_parser_t *
 dc_parser_allocate (dc_context_t *context, const dc_parser_vtable_t *vtable)
 {
 	dc_parser_t *parser = NULL;
+	dc_parser_scratch_t *scratch = g_scratch;
 
 	assert(vtable != NULL);
 	assert(vtable->size >= sizeof(dc_parser_t));
 
 	// Allocate memory.
-	parser = (dc_parser_t *) malloc (vtable->size);
-	if (parser == NULL) {
-		ERROR (context, "Failed to allocate memory.");
-		return parser;
+	if (scratch && scratch->data) {
+		size_t size = SCRATCH_ALIGN (vtable->size);
+		if (scratch->size < size) {
+			ERROR (context, "Insufficient scratch memory (" DC_PRINTF_SIZE " bytes required).", size);
+			return NULL;
+		}
+		parser = (dc_parser_t *) scratch->data;
+		scratch->used = size;
+	} else {
+		parser = (dc_parser_t *) dc_malloc (vtable->size);
+		if (parser == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			return parser;
+		}
 	}
 
+	if (scratch)
+		scratch->required = SCRATCH_ALIGN (vtable->size);
+
 	// Initialize the base class.
 	parser->vtable = vtable;
 	parser->context = context;
 	parser->data = NULL;
 	parser->size = 0;
+	parser->flags = 0;
+	parser->model = 0;
+	parser->devtime = 0;
+	parser->systime = 0;
+	parser->settings = 0;
+	parser->cache = NULL;
+	parser->entry = NULL;
+	parser->stream = NULL;
+	parser->filter = ~0u;
+	parser->scratch = scratch && scratch->data;
+	parser->arena = NULL;
 
 	return parser;
 }
@@ -235,7 +215,37 @@ dc_parser_allocate (dc_context_t *context, const dc_parser_vtable_t *vtable)
 void
 dc_parser_deallocate (dc_parser_t *parser)
 {
-	free (parser);
+	if (parser == NULL || parser->scratch)
+		return;
+
+	dc_free (parser);
+}
+
+dc_status_t
+dc_parser_reserve (dc_parser_t *parser, size_t size, void **memory)
+{
+	dc_parser_scratch_t *scratch = g_scratch;
+
+	*memory = NULL;
+
+	if (scratch == NULL)
+		return DC_STATUS_SUCCESS;
+
+	size = SCRATCH_ALIGN (size);
+	scratch->required += size;
+
+	if (!parser->scratch)
+		return DC_STATUS_SUCCESS;
+
+	if (scratch->size - scratch->used < size) {
+		ERROR (parser->context, "Insufficient scratch memory (" DC_PRINTF_SIZE " bytes required).", scratch->required);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	*memory = scratch->data + scratch->used;
+	scratch->used += size;
+
+	return DC_STATUS_SUCCESS;
 }
 
 int
@@ -258,6 +268,23 @@ dc_parser_get_type (dc_parser_t *parser)
 }
 
 
+static void
+dc_parser_acquire_entry (dc_parser_t *parser)
+{
+	if (parser->cache == NULL || parser->data == NULL)
+		return;
+
+	dc_parser_cache_key_t key;
+	key.family = parser->vtable->type;
+	key.model = parser->model;
+	key.devtime = parser->devtime;
+	key.systime = parser->systime;
+	key.settings = parser->settings;
+
+	parser->entry = dc_parser_cache_acquire (parser->cache, &key, parser->data, parser->size);
+}
+
+
 dc_status_t
 dc_parser_set_data (dc_parser_t *parser, const unsigned char *data, unsigned int size)
 {
@@ -270,80 +297,1650 @@ dc_parser_set_data (dc_parser_t *parser, const unsigned char *data, unsigned int
 	parser->data = data;
 	parser->size = size;
 
-	return parser->vtable->set_data (parser, data, size);
+	// Abort an incremental parse.
+	if (parser->stream)
+		parser->stream->active = 0;
+
+	TRACE2 (parser_set_data_entry, parser, size);
+
+	dc_status_t status = parser->vtable->set_data (parser, data, size);
+
+	TRACE2 (parser_set_data_return, parser, status);
+
+	dc_parser_cache_release (parser->cache, parser->entry);
+	parser->entry = NULL;
+	if (status == DC_STATUS_SUCCESS)
+		dc_parser_acquire_entry (parser);
+
+	return status;
+}
+
+
+void
+dc_parser_set_settings (dc_parser_t *parser, const void *settings, size_t size)
+{
+	parser->settings = checksum_crc32 ((const unsigned char *) settings, size);
+
+	// The cached results of the previous settings are no longer valid.
+	dc_parser_cache_release (parser->cache, parser->entry);
+	parser->entry = NULL;
+	dc_parser_acquire_entry (parser);
+}
+
+
+dc_status_t
+dc_parser_set_cache (dc_parser_t *parser, dc_parser_cache_t *cache)
+{
+	if (parser == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_parser_cache_release (parser->cache, parser->entry);
+	parser->entry = NULL;
+	parser->cache = cache;
+
+	dc_parser_acquire_entry (parser);
+
+	return DC_STATUS_SUCCESS;
 }
 
 
 dc_status_t
 dc_parser_get_datetime (dc_parser_t *parser, dc_datetime_t *datetime)
 {
+	dc_status_t status = DC_STATUS_SUCCESS;
+
 	if (parser == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
 	if (parser->vtable->datetime == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return parser->vtable->datetime (parser, datetime);
+	if (parser->entry && dc_parser_cache_get_datetime (parser->entry, datetime, &status))
+		return status;
+
+	status = parser->vtable->datetime (parser, datetime);
+
+	if (parser->entry && datetime)
+		dc_parser_cache_set_datetime (parser->entry, datetime, status);
+
+	return status;
 }
 
 dc_status_t
 dc_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int flags, void *value)
 {
+	dc_status_t status = DC_STATUS_SUCCESS;
+
 	if (parser == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
 	if (parser->vtable->field == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return parser->vtable->field (parser, type, flags, value);
+	if (parser->entry && dc_parser_cache_get_field (parser->entry, type, flags, value, &status))
+		return status;
+
+	status = parser->vtable->field (parser, type, flags, value);
+
+	// A header-only result is not cached, because it may be incomplete.
+	if (parser->entry && !(parser->flags & PARSER_NOPROFILE))
+		dc_parser_cache_set_field (parser->entry, type, flags, value, status);
+
+	return status;
+}
+
+dc_status_t
+dc_parser_get_fields (dc_parser_t *parser, dc_field_request_t requests[], unsigned int count)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (requests == NULL && count)
+		return DC_STATUS_INVALIDARGS;
+
+	if (parser == NULL || parser->vtable->field == NULL) {
+		for (unsigned int i = 0; i < count; ++i) {
+			requests[i].status = DC_STATUS_UNSUPPORTED;
+		}
+		return DC_STATUS_SUCCESS;
+	}
+
+	// The backends validate and cache the header on the first request
+	// only, so the remaining requests are cheap.
+	for (unsigned int i = 0; i < count; ++i) {
+		dc_field_request_t *request = requests + i;
+
+		request->status = dc_parser_get_field (parser, request->type, request->flags, request->value);
+		if (request->status != DC_STATUS_SUCCESS &&
+			request->status != DC_STATUS_UNSUPPORTED &&
+			status == DC_STATUS_SUCCESS)
+			status = request->status;
+	}
+
+	return status;
 }
 
 
+typedef struct dc_parser_record_t {
+	dc_parser_cache_entry_t *entry;
+	dc_sample_callback_t callback;
+	void *userdata;
+} dc_parser_record_t;
+
+typedef struct dc_parser_filter_t {
+	unsigned int mask;
+	dc_sample_callback_t callback;
+	void *userdata;
+} dc_parser_filter_t;
+
+typedef struct dc_parser_feed_t {
+	dc_parser_stream_t *stream;
+	dc_sample_callback_t callback;
+	void *userdata;
+	unsigned int mask;
+	unsigned int ntimes;
+	dc_status_t status;
+} dc_parser_feed_t;
+
+static void
+dc_parser_record_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_parser_record_t *record = (dc_parser_record_t *) userdata;
+
+	dc_parser_cache_samples_record (record->entry, type, value);
+
+	if (record->callback)
+		record->callback (type, value, record->userdata);
+}
+
 dc_status_t
 dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata)
 {
+	dc_status_t status = DC_STATUS_SUCCESS;
+
 	if (parser == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
 	if (parser->vtable->samples_foreach == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return parser->vtable->samples_foreach (parser, callback, userdata);
+	if (parser->flags & PARSER_NOVENDOR)
+		return dc_parser_samples_foreach_filtered (parser, ~0u, callback, userdata);
+
+	TRACE1 (parser_samples_entry, parser);
+
+	if (parser->entry && dc_parser_cache_samples_foreach (parser->entry, callback, userdata)) {
+		status = DC_STATUS_SUCCESS;
+	} else if (parser->entry && dc_parser_cache_samples_begin (parser->entry)) {
+		dc_parser_record_t record = {parser->entry, callback, userdata};
+		status = parser->vtable->samples_foreach (parser, dc_parser_record_cb, &record);
+		dc_parser_cache_samples_commit (parser->entry, status);
+	} else {
+		status = parser->vtable->samples_foreach (parser, callback, userdata);
+	}
+
+	TRACE2 (parser_samples_return, parser, status);
+
+	return status;
 }
 
+static void
+dc_parser_filter_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_parser_filter_t *filter = (dc_parser_filter_t *) userdata;
+
+	if (filter->callback && (filter->mask & PARSER_SAMPLE (type)))
+		filter->callback (type, value, filter->userdata);
+}
 
 dc_status_t
-dc_parser_destroy (dc_parser_t *parser)
+dc_parser_samples_foreach_filtered (dc_parser_t *parser, unsigned int mask, dc_sample_callback_t callback, void *userdata)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 
 	if (parser == NULL)
-		return DC_STATUS_SUCCESS;
+		return DC_STATUS_UNSUPPORTED;
 
-	if (parser->vtable->destroy) {
-		status = parser->vtable->destroy (parser);
-	}
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
 
-	dc_parser_deallocate (parser);
+	if (parser->flags & PARSER_NOVENDOR)
+		mask &= ~PARSER_SAMPLE (DC_SAMPLE_VENDOR);
+
+	dc_parser_filter_t filter = {mask, callback, userdata};
+
+	if (parser->entry && dc_parser_cache_samples_foreach (parser->entry, dc_parser_filter_cb, &filter))
+		return DC_STATUS_SUCCESS;
+
+	// The filtered samples are incomplete, and are never recorded in
+	// the cache.
+	parser->filter = mask;
+	status = parser->vtable->samples_foreach (parser, dc_parser_filter_cb, &filter);
+	parser->filter = ~0u;
 
 	return status;
 }
 
+dc_status_t
+dc_parser_set_vendor_samples (dc_parser_t *parser, int enable)
+{
+	if (parser == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (enable)
+		parser->flags &= ~PARSER_NOVENDOR;
+	else
+		parser->flags |= PARSER_NOVENDOR;
+
+	return DC_STATUS_SUCCESS;
+}
+
 
-void
-sample_statistics_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+/*
+ * Report the samples of a completed sample row, unless the row was
+ * already reported by a previous pass.
+ */
+static void
+dc_parser_feed_flush (dc_parser_feed_t *feed)
 {
-	sample_statistics_t *statistics  = (sample_statistics_t *) userdata;
+	dc_parser_stream_t *stream = feed->stream;
+	unsigned int row = feed->ntimes ? feed->ntimes - 1 : 0;
 
-	switch (type) {
-	case DC_SAMPLE_TIME:
-		statistics->divetime = value.time;
-		break;
-	case DC_SAMPLE_DEPTH:
-		if (statistics->maxdepth < value.depth)
-			statistics->maxdepth = value.depth;
-		break;
+	if (row < stream->nrows)
+		return;
+
+	const unsigned char *data = dc_buffer_get_data (stream->pending);
+	size_t size = dc_buffer_get_size (stream->pending);
+	size_t offset = 0;
+	while (offset < size) {
+		dc_sample_type_t type;
+		dc_sample_value_t value;
+		size_t n = dc_parser_cache_sample_decode (data + offset, size - offset, &type, &value);
+		if (n == 0)
+			break;
+
+		if (feed->callback)
+			feed->callback (type, value, feed->userdata);
+
+		offset += n;
+	}
+
+	dc_buffer_clear (stream->pending);
+	stream->nrows = row + 1;
+}
+
+static void
+dc_parser_feed_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_parser_feed_t *feed = (dc_parser_feed_t *) userdata;
+	dc_parser_stream_t *stream = feed->stream;
+	unsigned char record[DC_PARSER_CACHE_RECORD_MAX];
+
+	// A time sample starts a new row, and completes the previous one.
+	// The samples before the first time sample belong to the first row.
+	if (type == DC_SAMPLE_TIME) {
+		if (feed->ntimes)
+			dc_parser_feed_flush (feed);
+		feed->ntimes++;
+	}
+
+	unsigned int row = feed->ntimes ? feed->ntimes - 1 : 0;
+	if (row < stream->nrows || feed->status != DC_STATUS_SUCCESS)
+		return;
+
+	if (!(feed->mask & PARSER_SAMPLE (type)))
+		return;
+
+	size_t n = dc_parser_cache_sample_encode (record, type, &value);
+	if (!dc_buffer_append (stream->pending, record, n) ||
+		(type == DC_SAMPLE_VENDOR && value.vendor.size &&
+		!dc_buffer_append (stream->pending, (const unsigned char *) value.vendor.data, value.vendor.size))) {
+		feed->status = DC_STATUS_NOMEMORY;
+	}
+}
+
+static int
+dc_parser_feed_supported (dc_family_t family)
+{
+	switch (family) {
+	case DC_FAMILY_SUUNTO_EONSTEEL:
+	case DC_FAMILY_SHEARWATER_PREDATOR:
+	case DC_FAMILY_SHEARWATER_PETREL:
+	case DC_FAMILY_HW_OSTC:
+	case DC_FAMILY_HW_FROG:
+	case DC_FAMILY_HW_OSTC3:
+		return 1;
 	default:
-		break;
+		return 0;
+	}
+}
+
+dc_status_t
+dc_parser_feed (dc_parser_t *parser, const unsigned char data[], unsigned int size, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (parser->vtable->set_data == NULL || parser->vtable->samples_foreach == NULL ||
+		!dc_parser_feed_supported (parser->vtable->type))
+		return DC_STATUS_UNSUPPORTED;
+
+	if (data == NULL && size)
+		return DC_STATUS_INVALIDARGS;
+
+	if (parser->stream == NULL) {
+		dc_parser_stream_t *stream = (dc_parser_stream_t *) malloc (sizeof (dc_parser_stream_t));
+		if (stream == NULL) {
+			ERROR (parser->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		stream->data = dc_buffer_new (0);
+		stream->pending = dc_buffer_new (0);
+		if (stream->data == NULL || stream->pending == NULL) {
+			ERROR (parser->context, "Failed to allocate memory.");
+			dc_buffer_free (stream->data);
+			dc_buffer_free (stream->pending);
+			free (stream);
+			return DC_STATUS_NOMEMORY;
+		}
+
+		stream->nrows = 0;
+		stream->active = 0;
+		parser->stream = stream;
+	}
+
+	dc_parser_stream_t *stream = parser->stream;
+
+	// Start a new dive.
+	if (!stream->active) {
+		dc_buffer_clear (stream->data);
+		stream->nrows = 0;
+		stream->active = 1;
 	}
+
+	if (!dc_buffer_append (stream->data, data, size)) {
+		ERROR (parser->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// The cached results of the previous data are no longer valid.
+	dc_parser_cache_release (parser->cache, parser->entry);
+	parser->entry = NULL;
+
+	// Decode the data received so far from the start. The parsers only
+	// decode the records which are completely available, but a row can
+	// still be cut in the middle. Therefore the last row is only
+	// reported at the end of the dive.
+	parser->data = dc_buffer_get_data (stream->data);
+	parser->size = dc_buffer_get_size (stream->data);
+
+	status = parser->vtable->set_data (parser, parser->data, parser->size);
+	if (status != DC_STATUS_SUCCESS) {
+		if (size)
+			return DC_STATUS_SUCCESS;
+		stream->active = 0;
+		return status;
+	}
+
+	unsigned int mask = ~0u;
+	if (parser->flags & PARSER_NOVENDOR)
+		mask &= ~PARSER_SAMPLE (DC_SAMPLE_VENDOR);
+
+	dc_parser_feed_t feed = {stream, callback, userdata, mask, 0, DC_STATUS_SUCCESS};
+	dc_buffer_clear (stream->pending);
+	parser->filter = mask;
+	status = parser->vtable->samples_foreach (parser, dc_parser_feed_cb, &feed);
+	parser->filter = ~0u;
+	if (feed.status != DC_STATUS_SUCCESS) {
+		ERROR (parser->context, "Failed to allocate memory.");
+		return feed.status;
+	}
+
+	if (size) {
+		// Errors are expected while the data is still incomplete.
+		return DC_STATUS_SUCCESS;
+	}
+
+	dc_parser_feed_flush (&feed);
+	stream->active = 0;
+
+	return status;
+}
+
+dc_status_t
+dc_parser_get_summary (dc_parser_t *parser, dc_summary_t *summary, int profile)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL || summary == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	memset (summary, 0, sizeof (*summary));
+
+	if (!profile)
+		parser->flags |= PARSER_NOPROFILE;
+
+	for (unsigned int i = 0; i < 6; ++i) {
+		unsigned int field = 1u << i;
+
+		parser->flags &= ~PARSER_PROFILE;
+
+		switch (field) {
+		case DC_SUMMARY_DATETIME:
+			status = dc_parser_get_datetime (parser, &summary->datetime);
+			break;
+		case DC_SUMMARY_DIVETIME:
+			status = dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &summary->divetime);
+			break;
+		case DC_SUMMARY_MAXDEPTH:
+			status = dc_parser_get_field (parser, DC_FIELD_MAXDEPTH, 0, &summary->maxdepth);
+			break;
+		case DC_SUMMARY_AVGDEPTH:
+			status = dc_parser_get_field (parser, DC_FIELD_AVGDEPTH, 0, &summary->avgdepth);
+			break;
+		case DC_SUMMARY_GASMIX_COUNT:
+			status = dc_parser_get_field (parser, DC_FIELD_GASMIX_COUNT, 0, &summary->gasmixes);
+			break;
+		case DC_SUMMARY_DIVEMODE:
+			status = dc_parser_get_field (parser, DC_FIELD_DIVEMODE, 0, &summary->divemode);
+			break;
+		}
+
+		if (parser->flags & PARSER_PROFILE)
+			summary->profile |= field;
+
+		if (status == DC_STATUS_SUCCESS) {
+			summary->fields |= field;
+		} else if (status != DC_STATUS_UNSUPPORTED) {
+			break;
+		}
+	}
+
+	parser->flags &= ~(PARSER_NOPROFILE | PARSER_PROFILE);
+
+	if (status == DC_STATUS_UNSUPPORTED)
+		status = DC_STATUS_SUCCESS;
+
+	return status;
+}
+
+static void
+dc_parser_columnar_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_sample_columns_t *columns = (dc_sample_columns_t *) userdata;
+
+	if (type == DC_SAMPLE_TIME) {
+		unsigned int row = columns->count++;
+		if (row >= columns->capacity)
+			return;
+
+		if (columns->time)
+			columns->time[row] = value.time;
+		if (columns->depth)
+			columns->depth[row] = NAN;
+		if (columns->temperature)
+			columns->temperature[row] = NAN;
+		if (columns->ppo2)
+			columns->ppo2[row] = NAN;
+		if (columns->pressure) {
+			for (unsigned int i = 0; i < columns->ntanks; ++i) {
+				if (columns->pressure[i])
+					columns->pressure[i][row] = NAN;
+			}
+		}
+		return;
+	}
+
+	// Ignore everything before the first time sample.
+	if (columns->count == 0)
+		return;
+
+	unsigned int row = columns->count - 1;
+
+	if (type == DC_SAMPLE_EVENT) {
+		unsigned int n = columns->ecount++;
+		if (columns->events && n < columns->ecapacity) {
+			columns->events[n].sample = row;
+			columns->events[n].type = value.event.type;
+			columns->events[n].time = value.event.time;
+			columns->events[n].flags = value.event.flags;
+			columns->events[n].value = value.event.value;
+		}
+		return;
+	}
+
+	if (row >= columns->capacity)
+		return;
+
+	switch (type) {
+	case DC_SAMPLE_DEPTH:
+		if (columns->depth)
+			columns->depth[row] = value.depth;
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		if (columns->temperature)
+			columns->temperature[row] = value.temperature;
+		break;
+	case DC_SAMPLE_PPO2:
+		if (columns->ppo2)
+			columns->ppo2[row] = value.ppo2;
+		break;
+	case DC_SAMPLE_PRESSURE:
+		if (columns->pressure && value.pressure.tank < columns->ntanks &&
+			columns->pressure[value.pressure.tank])
+			columns->pressure[value.pressure.tank][row] = value.pressure.value;
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+dc_parser_get_samples_columnar (dc_parser_t *parser, dc_sample_columns_t *columns)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL || columns == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	columns->count = 0;
+	columns->ecount = 0;
+
+	status = dc_parser_samples_foreach (parser, dc_parser_columnar_cb, columns);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (columns->count > columns->capacity ||
+		(columns->events && columns->ecount > columns->ecapacity)) {
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+typedef struct dc_parser_rows_t {
+	dc_sample_record_t record;
+	dc_sample_record_callback_t callback;
+	void *userdata;
+	unsigned int count;
+	dc_sample_pressure_t *pressures;
+	unsigned int pcapacity;
+	dc_sample_event_t *events;
+	unsigned int ecapacity;
+	dc_status_t status;
+} dc_parser_rows_t;
+
+static void
+dc_parser_rows_flush (dc_parser_rows_t *state)
+{
+	if (state->count == 0)
+		return;
+
+	state->record.pressures = state->pressures;
+	state->record.events = state->events;
+
+	state->callback (&state->record, state->userdata);
+}
+
+/*
+ * Make room for one more element in an array, which grows by doubling
+ * and is reused for all rows.
+ */
+static int
+dc_parser_rows_grow (void **array, unsigned int *capacity, unsigned int count, size_t size)
+{
+	if (count < *capacity)
+		return 1;
+
+	unsigned int n = *capacity ? *capacity * 2 : 8;
+	void *p = realloc (*array, n * size);
+	if (p == NULL)
+		return 0;
+
+	*array = p;
+	*capacity = n;
+
+	return 1;
+}
+
+static void
+dc_parser_rows_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_parser_rows_t *state = (dc_parser_rows_t *) userdata;
+	dc_sample_record_t *record = &state->record;
+
+	if (type == DC_SAMPLE_TIME) {
+		dc_parser_rows_flush (state);
+
+		memset (record, 0, sizeof (*record));
+		record->fields = 1 << DC_SAMPLE_TIME;
+		record->index = state->count++;
+		record->time = value.time;
+		return;
+	}
+
+	// Ignore everything before the first time sample.
+	if (state->count == 0)
+		return;
+
+	switch (type) {
+	case DC_SAMPLE_DEPTH:
+		record->depth = value.depth;
+		break;
+	case DC_SAMPLE_PRESSURE:
+		if (!dc_parser_rows_grow ((void **) &state->pressures, &state->pcapacity, record->npressures, sizeof (dc_sample_pressure_t))) {
+			state->status = DC_STATUS_NOMEMORY;
+			return;
+		}
+		state->pressures[record->npressures].tank = value.pressure.tank;
+		state->pressures[record->npressures].value = value.pressure.value;
+		record->npressures++;
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		record->temperature = value.temperature;
+		break;
+	case DC_SAMPLE_EVENT:
+		if (!dc_parser_rows_grow ((void **) &state->events, &state->ecapacity, record->nevents, sizeof (dc_sample_event_t))) {
+			state->status = DC_STATUS_NOMEMORY;
+			return;
+		}
+		state->events[record->nevents].sample = record->index;
+		state->events[record->nevents].type = value.event.type;
+		state->events[record->nevents].time = value.event.time;
+		state->events[record->nevents].flags = value.event.flags;
+		state->events[record->nevents].value = value.event.value;
+		record->nevents++;
+		break;
+	case DC_SAMPLE_RBT:
+		record->rbt = value.rbt;
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		record->heartbeat = value.heartbeat;
+		break;
+	case DC_SAMPLE_BEARING:
+		record->bearing = value.bearing;
+		break;
+	case DC_SAMPLE_SETPOINT:
+		record->setpoint = value.setpoint;
+		break;
+	case DC_SAMPLE_PPO2:
+		record->ppo2 = value.ppo2;
+		break;
+	case DC_SAMPLE_CNS:
+		record->cns = value.cns;
+		break;
+	case DC_SAMPLE_DECO:
+		record->deco.type = value.deco.type;
+		record->deco.time = value.deco.time;
+		record->deco.depth = value.deco.depth;
+		break;
+	case DC_SAMPLE_GASMIX:
+		record->gasmix = value.gasmix;
+		break;
+	default:
+		return;
+	}
+
+	record->fields |= 1 << type;
+}
+
+dc_status_t
+dc_parser_samples_foreach_record (dc_parser_t *parser, dc_sample_record_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_parser_rows_t state;
+	memset (&state, 0, sizeof (state));
+	state.callback = callback;
+	state.userdata = userdata;
+	state.status = DC_STATUS_SUCCESS;
+
+	status = dc_parser_samples_foreach (parser, dc_parser_rows_cb, &state);
+	if (status == DC_STATUS_SUCCESS) {
+		// Report the last row.
+		dc_parser_rows_flush (&state);
+		status = state.status;
+	}
+
+	free (state.pressures);
+	free (state.events);
+
+	if (status == DC_STATUS_NOMEMORY)
+		ERROR (parser->context, "Failed to allocate memory.");
+
+	return status;
+}
+
+typedef struct dc_parser_materialize_t {
+	dc_buffer_t *samples;
+	dc_buffer_t *pressures;
+	dc_buffer_t *events;
+	dc_status_t status;
+} dc_parser_materialize_t;
+
+static void
+dc_parser_materialize_cb (const dc_sample_record_t *record, void *userdata)
+{
+	dc_parser_materialize_t *state = (dc_parser_materialize_t *) userdata;
+
+	if (state->status != DC_STATUS_SUCCESS)
+		return;
+
+	// The arrays are only valid during the callback, and are copied.
+	if (!dc_buffer_append (state->samples, (const unsigned char *) record, sizeof (*record)) ||
+		!dc_buffer_append (state->pressures, (const unsigned char *) record->pressures, record->npressures * sizeof (dc_sample_pressure_t)) ||
+		!dc_buffer_append (state->events, (const unsigned char *) record->events, record->nevents * sizeof (dc_sample_event_t))) {
+		state->status = DC_STATUS_NOMEMORY;
+	}
+}
+
+static dc_status_t
+dc_parser_materialize_field (dc_parser_t *parser, dc_dive_t *dive, dc_field_type_t type, void *value)
+{
+	dc_status_t status = dc_parser_get_field (parser, type, 0, value);
+	if (status == DC_STATUS_SUCCESS)
+		dive->fields |= 1u << type;
+	else if (status == DC_STATUS_UNSUPPORTED)
+		status = DC_STATUS_SUCCESS;
+
+	return status;
+}
+
+dc_status_t
+dc_parser_materialize (dc_parser_t *parser, dc_dive_t **out)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_dive_t header;
+	dc_gasmix_t *gasmixes = NULL;
+	dc_tank_t *tanks = NULL;
+	dc_parser_materialize_t state;
+
+	if (parser == NULL || out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	memset (&header, 0, sizeof (header));
+	memset (&state, 0, sizeof (state));
+
+	// The temporary memory is taken from an arena, which is kept with
+	// the parser. After the first few dives, the arena is large enough
+	// and a dive needs no other allocation than the final block.
+	if (parser->arena == NULL) {
+		parser->arena = dc_arena_new (0);
+		if (parser->arena == NULL) {
+			ERROR (parser->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	status = dc_parser_get_datetime (parser, &header.datetime);
+	if (status == DC_STATUS_SUCCESS)
+		header.have_datetime = 1;
+	else if (status != DC_STATUS_UNSUPPORTED)
+		goto error;
+
+	static const struct {
+		dc_field_type_t type;
+		size_t offset;
+	} fields[] = {
+		{DC_FIELD_DIVETIME,            offsetof (dc_dive_t, divetime)},
+		{DC_FIELD_MAXDEPTH,            offsetof (dc_dive_t, maxdepth)},
+		{DC_FIELD_AVGDEPTH,            offsetof (dc_dive_t, avgdepth)},
+		{DC_FIELD_SALINITY,            offsetof (dc_dive_t, salinity)},
+		{DC_FIELD_ATMOSPHERIC,         offsetof (dc_dive_t, atmospheric)},
+		{DC_FIELD_TEMPERATURE_SURFACE, offsetof (dc_dive_t, temperature_surface)},
+		{DC_FIELD_TEMPERATURE_MINIMUM, offsetof (dc_dive_t, temperature_minimum)},
+		{DC_FIELD_TEMPERATURE_MAXIMUM, offsetof (dc_dive_t, temperature_maximum)},
+		{DC_FIELD_DIVEMODE,            offsetof (dc_dive_t, divemode)},
+		{DC_FIELD_GASMIX_COUNT,        offsetof (dc_dive_t, ngasmixes)},
+		{DC_FIELD_TANK_COUNT,          offsetof (dc_dive_t, ntanks)},
+	};
+
+	for (size_t i = 0; i < sizeof (fields) / sizeof (fields[0]); ++i) {
+		status = dc_parser_materialize_field (parser, &header, fields[i].type,
+			(unsigned char *) &header + fields[i].offset);
+		if (status != DC_STATUS_SUCCESS)
+			goto error;
+	}
+
+	if (header.ngasmixes) {
+		gasmixes = (dc_gasmix_t *) dc_arena_alloc (parser->arena, header.ngasmixes * sizeof (dc_gasmix_t));
+		if (gasmixes == NULL) {
+			status = DC_STATUS_NOMEMORY;
+			goto error;
+		}
+
+		header.fields |= 1u << DC_FIELD_GASMIX;
+		for (unsigned int i = 0; i < header.ngasmixes; ++i) {
+			status = dc_parser_get_field (parser, DC_FIELD_GASMIX, i, gasmixes + i);
+			if (status == DC_STATUS_UNSUPPORTED) {
+				header.fields &= ~(1u << DC_FIELD_GASMIX);
+				break;
+			} else if (status != DC_STATUS_SUCCESS) {
+				goto error;
+			}
+		}
+		status = DC_STATUS_SUCCESS;
+	}
+
+	if (header.ntanks) {
+		tanks = (dc_tank_t *) dc_arena_alloc (parser->arena, header.ntanks * sizeof (dc_tank_t));
+		if (tanks == NULL) {
+			status = DC_STATUS_NOMEMORY;
+			goto error;
+		}
+
+		header.fields |= 1u << DC_FIELD_TANK;
+		for (unsigned int i = 0; i < header.ntanks; ++i) {
+			status = dc_parser_get_field (parser, DC_FIELD_TANK, i, tanks + i);
+			if (status == DC_STATUS_UNSUPPORTED) {
+				header.fields &= ~(1u << DC_FIELD_TANK);
+				break;
+			} else if (status != DC_STATUS_SUCCESS) {
+				goto error;
+			}
+		}
+		status = DC_STATUS_SUCCESS;
+	}
+
+	unsigned int ngasmixes = (header.fields & (1u << DC_FIELD_GASMIX)) ? header.ngasmixes : 0;
+	unsigned int ntanks = (header.fields & (1u << DC_FIELD_TANK)) ? header.ntanks : 0;
+
+	// Collect the sample rows.
+	state.samples = dc_buffer_new_arena (parser->arena, 0);
+	state.pressures = dc_buffer_new_arena (parser->arena, 0);
+	state.events = dc_buffer_new_arena (parser->arena, 0);
+	if (state.samples == NULL || state.pressures == NULL || state.events == NULL) {
+		status = DC_STATUS_NOMEMORY;
+		goto error;
+	}
+
+	state.status = DC_STATUS_SUCCESS;
+	status = dc_parser_samples_foreach_record (parser, dc_parser_materialize_cb, &state);
+	if (status == DC_STATUS_UNSUPPORTED)
+		status = DC_STATUS_SUCCESS;
+	if (status == DC_STATUS_SUCCESS)
+		status = state.status;
+	if (status != DC_STATUS_SUCCESS)
+		goto error;
+
+	size_t ssize = dc_buffer_get_size (state.samples);
+	size_t psize = dc_buffer_get_size (state.pressures);
+	size_t esize = dc_buffer_get_size (state.events);
+
+	// All parts are multiples of their alignment, and are ordered from
+	// the largest to the smallest alignment, so no padding is needed.
+	size_t size = sizeof (dc_dive_t) +
+		ngasmixes * sizeof (dc_gasmix_t) +
+		ntanks * sizeof (dc_tank_t) +
+		ssize + psize + esize;
+
+	unsigned char *block = (unsigned char *) malloc (size);
+	if (block == NULL) {
+		status = DC_STATUS_NOMEMORY;
+		goto error;
+	}
+
+	dc_dive_t *dive = (dc_dive_t *) block;
+	*dive = header;
+	unsigned char *p = block + sizeof (dc_dive_t);
+
+	dive->gasmixes = ngasmixes ? (const dc_gasmix_t *) memcpy (p, gasmixes, ngasmixes * sizeof (dc_gasmix_t)) : NULL;
+	p += ngasmixes * sizeof (dc_gasmix_t);
+
+	dive->tanks = ntanks ? (const dc_tank_t *) memcpy (p, tanks, ntanks * sizeof (dc_tank_t)) : NULL;
+	p += ntanks * sizeof (dc_tank_t);
+
+	dc_sample_record_t *samples = (dc_sample_record_t *) p;
+	memcpy (p, dc_buffer_get_data (state.samples), ssize);
+	p += ssize;
+
+	dc_sample_pressure_t *pressures = (dc_sample_pressure_t *) p;
+	memcpy (p, dc_buffer_get_data (state.pressures), psize);
+	p += psize;
+
+	dc_sample_event_t *events = (dc_sample_event_t *) p;
+	memcpy (p, dc_buffer_get_data (state.events), esize);
+
+	dive->nsamples = ssize / sizeof (dc_sample_record_t);
+	dive->samples = dive->nsamples ? samples : NULL;
+	dive->npressures = psize / sizeof (dc_sample_pressure_t);
+	dive->pressures = dive->npressures ? pressures : NULL;
+	dive->nevents = esize / sizeof (dc_sample_event_t);
+	dive->events = dive->nevents ? events : NULL;
+
+	// Point the rows to their part of the copied arrays.
+	size_t npressures = 0, nevents = 0;
+	for (unsigned int i = 0; i < dive->nsamples; ++i) {
+		samples[i].pressures = samples[i].npressures ? pressures + npressures : NULL;
+		samples[i].events = samples[i].nevents ? events + nevents : NULL;
+		npressures += samples[i].npressures;
+		nevents += samples[i].nevents;
+	}
+
+	*out = dive;
+
+error:
+	if (status == DC_STATUS_NOMEMORY)
+		ERROR (parser->context, "Failed to allocate memory.");
+	dc_arena_reset (parser->arena);
+	return status;
+}
+
+void
+dc_dive_free (dc_dive_t *dive)
+{
+	free (dive);
+}
+
+typedef struct dc_parser_decimate_row_t {
+	size_t offset;
+	unsigned int keep;
+} dc_parser_decimate_row_t;
+
+typedef struct dc_parser_decimate_t {
+	unsigned int interval;
+	dc_sample_callback_t callback;
+	void *userdata;
+	dc_buffer_t *pending;
+	dc_parser_decimate_row_t *rows;
+	unsigned int nrows;
+	unsigned int capacity;
+	unsigned int ntimes;
+	unsigned int bucket;
+	unsigned int min, max;
+	double mindepth, maxdepth;
+	dc_status_t status;
+} dc_parser_decimate_t;
+
+/*
+ * Report the samples of the rows that are kept in the current bucket:
+ * the rows with the minimum and maximum depth, and the rows with an
+ * event or a gas switch. The rows are reported in their original order.
+ */
+static void
+dc_parser_decimate_flush (dc_parser_decimate_t *state)
+{
+	if (state->nrows == 0)
+		return;
+
+	if (state->mindepth <= state->maxdepth) {
+		state->rows[state->min].keep = 1;
+		state->rows[state->max].keep = 1;
+	}
+
+	const unsigned char *data = dc_buffer_get_data (state->pending);
+	size_t size = dc_buffer_get_size (state->pending);
+	for (unsigned int i = 0; i < state->nrows; ++i) {
+		size_t offset = state->rows[i].offset;
+		size_t end = i + 1 < state->nrows ? state->rows[i + 1].offset : size;
+		if (!state->rows[i].keep)
+			continue;
+
+		while (offset < end) {
+			dc_sample_type_t type;
+			dc_sample_value_t value;
+			size_t n = dc_parser_cache_sample_decode (data + offset, end - offset, &type, &value);
+			if (n == 0)
+				break;
+
+			state->callback (type, value, state->userdata);
+
+			offset += n;
+		}
+	}
+
+	dc_buffer_clear (state->pending);
+	state->nrows = 0;
+	state->mindepth = INFINITY;
+	state->maxdepth = -INFINITY;
+}
+
+static void
+dc_parser_decimate_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_parser_decimate_t *state = (dc_parser_decimate_t *) userdata;
+	unsigned char record[DC_PARSER_CACHE_RECORD_MAX];
+
+	if (state->status != DC_STATUS_SUCCESS)
+		return;
+
+	// A time sample starts a new row, and possibly a new bucket. The
+	// samples before the first time sample belong to the first row.
+	if (type == DC_SAMPLE_TIME) {
+		unsigned int bucket = value.time / state->interval;
+		if (state->ntimes && bucket != state->bucket)
+			dc_parser_decimate_flush (state);
+		state->bucket = bucket;
+	}
+
+	if (state->nrows == 0 || (type == DC_SAMPLE_TIME && state->ntimes)) {
+		if (!dc_parser_rows_grow ((void **) &state->rows, &state->capacity, state->nrows, sizeof (dc_parser_decimate_row_t))) {
+			state->status = DC_STATUS_NOMEMORY;
+			return;
+		}
+		state->rows[state->nrows].offset = dc_buffer_get_size (state->pending);
+		state->rows[state->nrows].keep = 0;
+		state->nrows++;
+	}
+
+	dc_parser_decimate_row_t *row = state->rows + state->nrows - 1;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		// Always keep the first row of the dive.
+		if (state->ntimes++ == 0)
+			row->keep = 1;
+		break;
+	case DC_SAMPLE_DEPTH:
+		if (value.depth < state->mindepth) {
+			state->mindepth = value.depth;
+			state->min = state->nrows - 1;
+		}
+		if (value.depth > state->maxdepth) {
+			state->maxdepth = value.depth;
+			state->max = state->nrows - 1;
+		}
+		break;
+	case DC_SAMPLE_EVENT:
+	case DC_SAMPLE_GASMIX:
+		row->keep = 1;
+		break;
+	default:
+		break;
+	}
+
+	size_t n = dc_parser_cache_sample_encode (record, type, &value);
+	if (!dc_buffer_append (state->pending, record, n) ||
+		(type == DC_SAMPLE_VENDOR && value.vendor.size &&
+		!dc_buffer_append (state->pending, (const unsigned char *) value.vendor.data, value.vendor.size))) {
+		state->status = DC_STATUS_NOMEMORY;
+	}
+}
+
+dc_status_t
+dc_parser_samples_foreach_decimated (dc_parser_t *parser, unsigned int interval, dc_sample_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL || interval == 0 || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_parser_decimate_t state;
+	memset (&state, 0, sizeof (state));
+	state.interval = interval;
+	state.callback = callback;
+	state.userdata = userdata;
+	state.mindepth = INFINITY;
+	state.maxdepth = -INFINITY;
+	state.status = DC_STATUS_SUCCESS;
+
+	state.pending = dc_buffer_new (0);
+	if (state.pending == NULL) {
+		ERROR (parser->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_parser_samples_foreach (parser, dc_parser_decimate_cb, &state);
+	if (status == DC_STATUS_SUCCESS)
+		status = state.status;
+	if (status == DC_STATUS_SUCCESS && state.nrows) {
+		// Always keep the last row of the dive.
+		state.rows[state.nrows - 1].keep = 1;
+		dc_parser_decimate_flush (&state);
+	}
+
+	free (state.rows);
+	dc_buffer_free (state.pending);
+
+	if (status == DC_STATUS_NOMEMORY)
+		ERROR (parser->context, "Failed to allocate memory.");
+
+	return status;
+}
+
+dc_status_t
+dc_parser_destroy (dc_parser_t *parser)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_parser_cache_release (parser->cache, parser->entry);
+
+	if (parser->vtable->destroy) {
+		status = parser->vtable->destroy (parser);
+	}
+
+	if (parser->stream) {
+		dc_buffer_free (parser->stream->data);
+		dc_buffer_free (parser->stream->pending);
+		free (parser->stream);
+	}
+
+	dc_arena_free (parser->arena);
+
+	dc_parser_deallocate (parser);
+
+	return status;
+}
+
+
+typedef struct dc_parser_pool_entry_t {
+	dc_parser_t *parser;
+	dc_family_t family;
+	unsigned int model;
+	unsigned int devtime;
+	dc_ticks_t systime;
+	unsigned int settings; // The default backend settings.
+	int busy;
+} dc_parser_pool_entry_t;
+
+struct dc_parser_pool_t {
+	dc_context_t *context;
+	dc_parser_pool_entry_t *entries;
+	size_t count;
+	size_t capacity;
+};
+
+dc_status_t
+dc_parser_pool_new (dc_parser_pool_t **out, dc_context_t *context)
+{
+	dc_parser_pool_t *pool = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	pool = (dc_parser_pool_t *) malloc (sizeof (dc_parser_pool_t));
+	if (pool == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	pool->context = context;
+	pool->entries = NULL;
+	pool->count = 0;
+	pool->capacity = 0;
+
+	*out = pool;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parser_pool_get (dc_parser_pool_t *pool, dc_parser_t **out, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime)
+{
+	if (pool == NULL || out == NULL || descriptor == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	return dc_parser_pool_get_internal (pool, out,
+		dc_descriptor_get_type (descriptor), dc_descriptor_get_model (descriptor),
+		devtime, systime);
+}
+
+dc_status_t
+dc_parser_pool_get_internal (dc_parser_pool_t *pool, dc_parser_t **out, dc_family_t family, unsigned int model, unsigned int devtime, dc_ticks_t systime)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+
+	// Hand out an idle parser with the same key.
+	for (size_t i = 0; i < pool->count; ++i) {
+		dc_parser_pool_entry_t *entry = pool->entries + i;
+		if (!entry->busy &&
+			entry->family == family && entry->model == model &&
+			entry->devtime == devtime && entry->systime == systime) {
+			entry->busy = 1;
+			*out = entry->parser;
+			return DC_STATUS_SUCCESS;
+		}
+	}
+
+	// Grow the array of entries.
+	if (pool->count == pool->capacity) {
+		size_t capacity = pool->capacity ? pool->capacity * 2 : 4;
+		dc_parser_pool_entry_t *entries = (dc_parser_pool_entry_t *) realloc (pool->entries, capacity * sizeof (dc_parser_pool_entry_t));
+		if (entries == NULL) {
+			ERROR (pool->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		pool->entries = entries;
+		pool->capacity = capacity;
+	}
+
+	status = dc_parser_new_internal (&parser, pool->context, family, model, devtime, systime);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_parser_pool_entry_t *entry = pool->entries + pool->count++;
+	entry->parser = parser;
+	entry->family = family;
+	entry->model = model;
+	entry->devtime = devtime;
+	entry->systime = systime;
+	entry->settings = parser->settings;
+	entry->busy = 1;
+
+	*out = parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parser_pool_put (dc_parser_pool_t *pool, dc_parser_t *parser)
+{
+	if (pool == NULL || parser == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	for (size_t i = 0; i < pool->count; ++i) {
+		dc_parser_pool_entry_t *entry = pool->entries + i;
+		if (entry->parser == parser) {
+			// Drop the reference to the data. The cached state is
+			// reset by the next set_data call.
+			dc_parser_cache_release (parser->cache, parser->entry);
+			parser->entry = NULL;
+			parser->data = NULL;
+			parser->size = 0;
+
+			// The backend settings, like the calibration, can't be
+			// restored here. Such a parser isn't handed out again.
+			if (parser->settings != entry->settings) {
+				dc_parser_destroy (parser);
+				memmove (entry, entry + 1, (pool->count - i - 1) * sizeof (dc_parser_pool_entry_t));
+				pool->count--;
+				return DC_STATUS_SUCCESS;
+			}
+
+			// Restore the default configuration, such that the next
+			// user doesn't inherit the cache and the flags.
+			parser->cache = NULL;
+			parser->flags = 0;
+			parser->filter = ~0u;
+			if (parser->stream) {
+				dc_buffer_clear (parser->stream->data);
+				dc_buffer_clear (parser->stream->pending);
+				parser->stream->nrows = 0;
+				parser->stream->active = 0;
+			}
+
+			entry->busy = 0;
+			return DC_STATUS_SUCCESS;
+		}
+	}
+
+	return DC_STATUS_INVALIDARGS;
+}
+
+void
+dc_parser_pool_trim (dc_parser_pool_t *pool, size_t maximum)
+{
+	if (pool == NULL)
+		return;
+
+	// Destroy the oldest idle parsers.
+	size_t i = 0;
+	while (pool->count > maximum && i < pool->count) {
+		if (pool->entries[i].busy) {
+			i++;
+			continue;
+		}
+
+		dc_parser_destroy (pool->entries[i].parser);
+		memmove (pool->entries + i, pool->entries + i + 1, (pool->count - i - 1) * sizeof (dc_parser_pool_entry_t));
+		pool->count--;
+	}
+}
+
+void
+dc_parser_pool_reclaim (dc_parser_pool_t *pool)
+{
+	if (pool == NULL)
+		return;
+
+	// Backwards, because a parser may be removed from the pool.
+	for (size_t i = pool->count; i > 0; --i) {
+		dc_parser_pool_entry_t *entry = pool->entries + i - 1;
+		if (entry->busy) {
+			WARNING (pool->context, "Parser not returned to the pool.");
+			dc_parser_pool_put (pool, entry->parser);
+		}
+	}
+}
+
+dc_status_t
+dc_parser_pool_free (dc_parser_pool_t *pool)
+{
+	if (pool == NULL)
+		return DC_STATUS_SUCCESS;
+
+	for (size_t i = 0; i < pool->count; ++i) {
+		dc_parser_destroy (pool->entries[i].parser);
+	}
+
+	free (pool->entries);
+	free (pool);
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The jobs of a batch are parsed by runner tasks on the executor of the
+ * context. A runner parses jobs until there are none left, such that the
+ * number of runners limits the number of workers used by the batch.
+ */
+struct dc_parser_batch_t {
+	dc_context_t *context;
+	dc_executor_t *executor;
+	dc_parser_pool_t *pool;
+	dc_mutex_t *mutex;
+	dc_cond_t *done;
+	unsigned int nthreads;
+	unsigned int nrunners;
+	/* The current run. */
+	const dc_parser_job_t *jobs;
+	unsigned int count;
+	unsigned int next;
+	dc_status_t *status;
+	unsigned char *finished;
+	dc_parser_batch_parse_t parse;
+	void *userdata;
+};
+
+static dc_status_t
+dc_parser_batch_parse (dc_parser_batch_t *batch, dc_parser_pool_t *pool, const dc_parser_job_t *job)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+
+	status = dc_parser_pool_get (pool, &parser, job->descriptor, job->devtime, job->systime);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	status = dc_parser_set_data (parser, job->data, job->size);
+	if (status == DC_STATUS_SUCCESS) {
+		status = batch->parse (parser, job, batch->userdata);
+	}
+
+	dc_parser_pool_put (pool, parser);
+
+	return status;
+}
+
+static void
+dc_parser_batch_runner (dc_executor_worker_t *worker, void *userdata)
+{
+	dc_parser_batch_t *batch = (dc_parser_batch_t *) userdata;
+	dc_parser_pool_t *pool = dc_executor_worker_get_pool (worker);
+
+	dc_mutex_lock (batch->mutex);
+
+	while (batch->next < batch->count) {
+		unsigned int i = batch->next++;
+
+		dc_mutex_unlock (batch->mutex);
+		dc_status_t status = dc_parser_batch_parse (batch, pool, batch->jobs + i);
+		dc_mutex_lock (batch->mutex);
+
+		batch->status[i] = status;
+		batch->finished[i] = 1;
+		dc_cond_broadcast (batch->done);
+	}
+
+	batch->nrunners--;
+	dc_cond_broadcast (batch->done);
+
+	dc_mutex_unlock (batch->mutex);
+}
+
+/*
+ * Wait for the runners, or run a pending task of the executor instead.
+ * Once there are no pending tasks, all the runners have been started,
+ * and there is no need to try again.
+ */
+static void
+dc_parser_batch_wait (dc_parser_batch_t *batch, int *help)
+{
+	if (*help) {
+		dc_mutex_unlock (batch->mutex);
+		*help = dc_executor_help (batch->executor);
+		dc_mutex_lock (batch->mutex);
+	} else {
+		dc_cond_wait (batch->done, batch->mutex);
+	}
+}
+
+dc_status_t
+dc_parser_batch_new (dc_parser_batch_t **out, dc_context_t *context, unsigned int nthreads)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_parser_batch_t *batch = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	batch = (dc_parser_batch_t *) malloc (sizeof (dc_parser_batch_t));
+	if (batch == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	batch->context = context;
+	batch->executor = NULL;
+	batch->pool = NULL;
+	batch->mutex = NULL;
+	batch->done = NULL;
+	batch->nthreads = 0;
+	batch->nrunners = 0;
+	batch->jobs = NULL;
+	batch->count = 0;
+	batch->next = 0;
+	batch->status = NULL;
+	batch->finished = NULL;
+	batch->parse = NULL;
+	batch->userdata = NULL;
+
+	// Without worker threads, the jobs are parsed by the calling thread.
+	status = dc_parser_pool_new (&batch->pool, context);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_free;
+
+	if (dc_mutex_new (&batch->mutex) != DC_STATUS_SUCCESS ||
+		dc_cond_new (&batch->done) != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	if (nthreads) {
+		status = dc_executor_get (&batch->executor, context);
+		if (status == DC_STATUS_UNSUPPORTED) {
+			status = DC_STATUS_SUCCESS;
+		} else if (status != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to create the executor.");
+			goto error_free;
+		} else {
+			batch->nthreads = nthreads;
+		}
+	}
+
+	*out = batch;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_parser_batch_free (batch);
+	return status;
+}
+
+dc_status_t
+dc_parser_batch_run (dc_parser_batch_t *batch, const dc_parser_job_t jobs[], unsigned int count, dc_parser_batch_parse_t parse, dc_parser_batch_done_t done, void *userdata)
+{
+	if (batch == NULL || parse == NULL || (jobs == NULL && count != 0))
+		return DC_STATUS_INVALIDARGS;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (jobs[i].descriptor == NULL)
+			return DC_STATUS_INVALIDARGS;
+	}
+
+	if (count == 0)
+		return DC_STATUS_SUCCESS;
+
+	batch->parse = parse;
+	batch->userdata = userdata;
+
+	// Within a task of an application supplied executor, the runners
+	// may never start, and the jobs are parsed by the calling thread.
+	if (batch->nthreads == 0 || count == 1 || !dc_executor_can_wait (batch->executor)) {
+		for (unsigned int i = 0; i < count; ++i) {
+			dc_status_t status = dc_parser_batch_parse (batch, batch->pool, jobs + i);
+			if (done)
+				done (jobs + i, status, userdata);
+		}
+
+		return DC_STATUS_SUCCESS;
+	}
+
+	batch->status = (dc_status_t *) malloc (count * sizeof (dc_status_t));
+	batch->finished = (unsigned char *) calloc (count, sizeof (unsigned char));
+	if (batch->status == NULL || batch->finished == NULL) {
+		ERROR (batch->context, "Failed to allocate memory.");
+		free (batch->status);
+		free (batch->finished);
+		batch->status = NULL;
+		batch->finished = NULL;
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned int nrunners = batch->nthreads < count ? batch->nthreads : count;
+
+	dc_mutex_lock (batch->mutex);
+	batch->jobs = jobs;
+	batch->count = count;
+	batch->next = 0;
+	batch->nrunners = nrunners;
+	dc_mutex_unlock (batch->mutex);
+
+	// The runners are submitted without the lock, because the submit
+	// function of the application may block.
+	for (unsigned int i = 0; i < nrunners; ++i) {
+		if (dc_executor_submit (batch->executor, dc_parser_batch_runner, batch) != DC_STATUS_SUCCESS) {
+			dc_mutex_lock (batch->mutex);
+			batch->nrunners -= nrunners - i;
+			dc_mutex_unlock (batch->mutex);
+			break;
+		}
+	}
+
+	dc_mutex_lock (batch->mutex);
+
+	// Without any runner, the jobs are parsed here.
+	while (batch->nrunners == 0 && batch->next < count) {
+		unsigned int i = batch->next++;
+
+		dc_mutex_unlock (batch->mutex);
+		dc_status_t status = dc_parser_batch_parse (batch, batch->pool, jobs + i);
+		dc_mutex_lock (batch->mutex);
+
+		batch->status[i] = status;
+		batch->finished[i] = 1;
+	}
+
+	// Deliver the results in the original order. Within a task of the
+	// executor, the pending tasks are run while waiting, because the
+	// runners may be queued behind the calling task.
+	int help = 1;
+	for (unsigned int i = 0; i < count; ++i) {
+		while (!batch->finished[i])
+			dc_parser_batch_wait (batch, &help);
+
+		dc_status_t status = batch->status[i];
+
+		if (done) {
+			dc_mutex_unlock (batch->mutex);
+			done (jobs + i, status, userdata);
+			dc_mutex_lock (batch->mutex);
+		}
+	}
+
+	// Wait until the runners no longer access the batch.
+	while (batch->nrunners)
+		dc_parser_batch_wait (batch, &help);
+
+	batch->jobs = NULL;
+	batch->count = 0;
+	batch->next = 0;
+
+	dc_mutex_unlock (batch->mutex);
+
+	free (batch->status);
+	free (batch->finished);
+	batch->status = NULL;
+	batch->finished = NULL;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_parser_batch_free (dc_parser_batch_t *batch)
+{
+	if (batch == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_executor_free (batch->executor);
+	dc_parser_pool_free (batch->pool);
+	dc_cond_free (batch->done);
+	dc_mutex_free (batch->mutex);
+	free (batch);
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+sample_statistics_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	sample_statistics_t *statistics  = (sample_statistics_t *) userdata;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		statistics->divetime = value.time;
+		break;
+	case DC_SAMPLE_DEPTH:
+		if (statistics->maxdepth < value.depth)
+			statistics->maxdepth = value.depth;
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+sample_statistics_walk (dc_parser_t *parser, dc_status_t (*foreach) (dc_parser_t *, dc_sample_callback_t, void *), sample_statistics_t *statistics)
+{
+	// Record the profile walk, and skip it for a header-only summary.
+	parser->flags |= PARSER_PROFILE;
+	if (parser->flags & PARSER_NOPROFILE)
+		return DC_STATUS_UNSUPPORTED;
+
+	return foreach (parser, sample_statistics_cb, statistics);
+}
+
+dc_status_t
+sample_profile_walk (dc_parser_t *parser, dc_status_t (*foreach) (dc_parser_t *, dc_sample_callback_t, void *), unsigned int fields, dc_field_type_t type)
+{
+	// The header fields don't need the profile.
+	if ((fields & PARSER_FIELD (type)) == 0)
+		return DC_STATUS_SUCCESS;
+
+	parser->flags |= PARSER_PROFILE;
+	if (parser->flags & PARSER_NOPROFILE)
+		return DC_STATUS_UNSUPPORTED;
+
+	return foreach (parser, NULL, NULL);
 }
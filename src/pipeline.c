@@ -0,0 +1,425 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/parser.h>
+
+#include "context-private.h"
+#include "device-private.h"
+#include "parser-private.h"
+#include "executor-private.h"
+#include "thread.h"
+
+// The maximum number of downloaded dives waiting to be reported.
+#define MAXPENDING 64
+
+// The maximum number of dives waiting to be reported for a memory image.
+// The dives are usually not copied, and the extraction doesn't need to
+// wait for the parsing.
+#define MAXPENDING_IMAGE 4096
+
+typedef struct dc_pipeline_t dc_pipeline_t;
+
+typedef struct dc_pipeline_job_t {
+	struct dc_pipeline_job_t *next;
+	const unsigned char *data;
+	const unsigned char *fingerprint;
+	unsigned int size;
+	unsigned int fsize;
+	/* The copy of the dive data and the fingerprint, or NULL if they
+	 * are part of the memory image. */
+	unsigned char *buffer;
+	int finished;
+	dc_status_t status;
+	void *result;
+} dc_pipeline_job_t;
+
+struct dc_pipeline_t {
+	dc_device_t *device;
+	dc_dive_parse_t parse;
+	dc_dive_parsed_t done;
+	void *userdata;
+	dc_mutex_t *mutex;
+	dc_cond_t *finished;
+	int quit;
+	int stop;
+	int started;
+	dc_status_t status;
+	/* The executor and the maximum number of runners, or NULL and the
+	 * parser of the calling thread without worker threads. */
+	dc_executor_t *executor;
+	unsigned int nthreads;
+	unsigned int nrunners;
+	dc_parser_t *parser;
+	/* The parser parameters, as reported when the first dive arrived. */
+	dc_family_t family;
+	unsigned int model;
+	unsigned int devtime;
+	dc_ticks_t systime;
+	/* The undelivered jobs in dive order, and the first job without a runner. */
+	dc_pipeline_job_t *head;
+	dc_pipeline_job_t *tail;
+	dc_pipeline_job_t *next;
+	unsigned int pending;
+	unsigned int maxpending;
+	/* The memory image, if the device was opened from one. */
+	const unsigned char *image;
+	unsigned int isize;
+};
+
+static dc_status_t
+dc_pipeline_parse (dc_pipeline_t *pipeline, dc_parser_t *parser, dc_pipeline_job_t *job)
+{
+	dc_status_t status = dc_parser_set_data (parser, job->data, job->size);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return pipeline->parse (parser, job->data, job->size, job->fingerprint, job->fsize, &job->result, pipeline->userdata);
+}
+
+/*
+ * A runner task parses dives until there are none left. New runners are
+ * submitted as the dives arrive, up to the maximum number of runners.
+ */
+static void
+dc_pipeline_runner (dc_executor_worker_t *worker, void *userdata)
+{
+	dc_pipeline_t *pipeline = (dc_pipeline_t *) userdata;
+	dc_parser_pool_t *pool = dc_executor_worker_get_pool (worker);
+	dc_parser_t *parser = NULL;
+
+	dc_status_t rc = dc_parser_pool_get_internal (pool, &parser,
+		pipeline->family, pipeline->model, pipeline->devtime, pipeline->systime);
+
+	dc_mutex_lock (pipeline->mutex);
+
+	while (!pipeline->quit && pipeline->next) {
+		dc_pipeline_job_t *job = pipeline->next;
+		pipeline->next = job->next;
+
+		dc_status_t status = rc;
+		if (status == DC_STATUS_SUCCESS) {
+			dc_mutex_unlock (pipeline->mutex);
+			status = dc_pipeline_parse (pipeline, parser, job);
+			dc_mutex_lock (pipeline->mutex);
+		}
+
+		job->status = status;
+		job->finished = 1;
+		dc_cond_broadcast (pipeline->finished);
+	}
+
+	dc_parser_pool_put (pool, parser);
+
+	pipeline->nrunners--;
+	dc_cond_broadcast (pipeline->finished);
+
+	dc_mutex_unlock (pipeline->mutex);
+}
+
+/*
+ * The parsers are created after the first dive arrives, because they
+ * need the devinfo and clock events of the download.
+ */
+static dc_status_t
+dc_pipeline_start (dc_pipeline_t *pipeline)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *device = pipeline->device;
+
+	pipeline->family = dc_device_get_type (device);
+	pipeline->model = device->devinfo.model;
+	pipeline->devtime = device->clock.devtime;
+	pipeline->systime = device->clock.systime;
+
+	if (pipeline->nthreads) {
+		status = dc_executor_get (&pipeline->executor, device->context);
+		if (status == DC_STATUS_UNSUPPORTED) {
+			pipeline->nthreads = 0;
+		} else if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->context, "Failed to create the executor.");
+			return status;
+		}
+	}
+
+	pipeline->started = 1;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_pipeline_stop (dc_pipeline_t *pipeline)
+{
+	if (!pipeline->started)
+		return;
+
+	dc_mutex_lock (pipeline->mutex);
+	pipeline->quit = 1;
+	while (pipeline->nrunners)
+		dc_cond_wait (pipeline->finished, pipeline->mutex);
+	dc_mutex_unlock (pipeline->mutex);
+
+	dc_executor_free (pipeline->executor);
+	dc_parser_destroy (pipeline->parser);
+	pipeline->executor = NULL;
+	pipeline->parser = NULL;
+}
+
+/*
+ * Parse a dive in the calling thread, when there is no runner for it.
+ */
+static dc_status_t
+dc_pipeline_parse_here (dc_pipeline_t *pipeline, dc_pipeline_job_t *job)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (pipeline->parser == NULL) {
+		status = dc_parser_new (&pipeline->parser, pipeline->device);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (pipeline->device->context, "Failed to create the parser.");
+			return status;
+		}
+	}
+
+	return dc_pipeline_parse (pipeline, pipeline->parser, job);
+}
+
+/*
+ * Report the parsed dives in dive order. The finished dives are always
+ * reported, and the call only waits for the unfinished dives while there
+ * are more than the maximum number of pending dives.
+ */
+static void
+dc_pipeline_deliver (dc_pipeline_t *pipeline, unsigned int maximum)
+{
+	dc_mutex_lock (pipeline->mutex);
+
+	while (pipeline->head && !pipeline->stop) {
+		dc_pipeline_job_t *job = pipeline->head;
+		if (!job->finished) {
+			if (pipeline->pending <= maximum)
+				break;
+			dc_cond_wait (pipeline->finished, pipeline->mutex);
+			continue;
+		}
+
+		pipeline->head = job->next;
+		if (pipeline->head == NULL)
+			pipeline->tail = NULL;
+		pipeline->pending--;
+
+		dc_mutex_unlock (pipeline->mutex);
+		if (pipeline->done && !pipeline->done (job->data, job->size,
+			job->fingerprint, job->fsize, job->status, job->result, pipeline->userdata))
+			pipeline->stop = 1;
+		free (job->buffer);
+		free (job);
+		dc_mutex_lock (pipeline->mutex);
+	}
+
+	dc_mutex_unlock (pipeline->mutex);
+}
+
+static int
+dc_pipeline_in_image (dc_pipeline_t *pipeline, const unsigned char *data, unsigned int size)
+{
+	if (size == 0)
+		return 1;
+
+	if (pipeline->image == NULL || data < pipeline->image)
+		return 0;
+
+	unsigned int offset = data - pipeline->image;
+	return offset <= pipeline->isize && size <= pipeline->isize - offset;
+}
+
+static int
+dc_pipeline_dive (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dc_pipeline_t *pipeline = (dc_pipeline_t *) userdata;
+	dc_context_t *context = pipeline->device->context;
+
+	if (!pipeline->started) {
+		dc_status_t status = dc_pipeline_start (pipeline);
+		if (status != DC_STATUS_SUCCESS) {
+			pipeline->status = status;
+			return 0;
+		}
+	}
+
+	dc_pipeline_job_t *job = (dc_pipeline_job_t *) malloc (sizeof (dc_pipeline_job_t));
+	if (job == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		pipeline->status = DC_STATUS_NOMEMORY;
+		return 0;
+	}
+
+	job->next = NULL;
+	job->data = data;
+	job->fingerprint = fingerprint;
+	job->size = size;
+	job->fsize = fsize;
+	job->buffer = NULL;
+
+	// The dive data is only valid during the callback, unless it's part
+	// of the memory image.
+	if (!dc_pipeline_in_image (pipeline, data, size) ||
+		!dc_pipeline_in_image (pipeline, fingerprint, fsize)) {
+		job->buffer = (unsigned char *) malloc ((size + fsize) ? (size + fsize) : 1);
+		if (job->buffer == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			free (job);
+			pipeline->status = DC_STATUS_NOMEMORY;
+			return 0;
+		}
+
+		if (size)
+			memcpy (job->buffer, data, size);
+		if (fsize)
+			memcpy (job->buffer + size, fingerprint, fsize);
+
+		job->data = job->buffer;
+		job->fingerprint = job->buffer + size;
+	}
+
+	job->finished = 0;
+	job->status = DC_STATUS_SUCCESS;
+	job->result = NULL;
+
+	dc_mutex_lock (pipeline->mutex);
+	if (pipeline->tail)
+		pipeline->tail->next = job;
+	else
+		pipeline->head = job;
+	pipeline->tail = job;
+	pipeline->pending++;
+	if (pipeline->next == NULL)
+		pipeline->next = job;
+
+	// Add a runner, unless the maximum number is already busy. The
+	// runner is submitted without the lock, because the submit function
+	// of the application may block.
+	int submit = 0;
+	if (pipeline->executor && pipeline->nrunners < pipeline->nthreads) {
+		pipeline->nrunners++;
+		submit = 1;
+	}
+	dc_mutex_unlock (pipeline->mutex);
+
+	if (submit && dc_executor_submit (pipeline->executor, dc_pipeline_runner, pipeline) != DC_STATUS_SUCCESS) {
+		dc_mutex_lock (pipeline->mutex);
+		pipeline->nrunners--;
+		dc_cond_broadcast (pipeline->finished);
+		dc_mutex_unlock (pipeline->mutex);
+	}
+
+	// Without any runner, the dives are parsed here.
+	dc_mutex_lock (pipeline->mutex);
+	while (pipeline->nrunners == 0 && pipeline->next) {
+		dc_pipeline_job_t *current = pipeline->next;
+		pipeline->next = current->next;
+
+		dc_mutex_unlock (pipeline->mutex);
+		dc_status_t status = dc_pipeline_parse_here (pipeline, current);
+		dc_mutex_lock (pipeline->mutex);
+
+		current->status = status;
+		current->finished = 1;
+	}
+	dc_mutex_unlock (pipeline->mutex);
+
+	// Apply back-pressure to the download when the parsing can't keep up.
+	dc_pipeline_deliver (pipeline, pipeline->maxpending);
+
+	return !pipeline->stop;
+}
+
+dc_status_t
+dc_device_foreach_parsed (dc_device_t *device, unsigned int nthreads, dc_dive_parse_t parse, dc_dive_parsed_t done, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_pipeline_t pipeline;
+
+	if (device == NULL || parse == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	pipeline.device = device;
+	pipeline.parse = parse;
+	pipeline.done = done;
+	pipeline.userdata = userdata;
+	pipeline.mutex = NULL;
+	pipeline.finished = NULL;
+	pipeline.quit = 0;
+	pipeline.stop = 0;
+	pipeline.started = 0;
+	pipeline.status = DC_STATUS_SUCCESS;
+	pipeline.executor = NULL;
+	pipeline.nthreads = nthreads;
+	pipeline.nrunners = 0;
+	pipeline.parser = NULL;
+	pipeline.family = DC_FAMILY_NULL;
+	pipeline.model = 0;
+	pipeline.devtime = 0;
+	pipeline.systime = 0;
+	pipeline.head = pipeline.tail = pipeline.next = NULL;
+	pipeline.pending = 0;
+	pipeline.maxpending = MAXPENDING;
+	pipeline.image = NULL;
+	pipeline.isize = 0;
+	if (device_image_get (device, &pipeline.image, &pipeline.isize))
+		pipeline.maxpending = MAXPENDING_IMAGE;
+
+	if (dc_mutex_new (&pipeline.mutex) != DC_STATUS_SUCCESS ||
+		dc_cond_new (&pipeline.finished) != DC_STATUS_SUCCESS) {
+		ERROR (device->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	status = dc_device_foreach (device, dc_pipeline_dive, &pipeline);
+	if (pipeline.status != DC_STATUS_SUCCESS)
+		status = pipeline.status;
+
+	// The dives downloaded before an error are still reported.
+	if (pipeline.started)
+		dc_pipeline_deliver (&pipeline, 0);
+
+	dc_pipeline_stop (&pipeline);
+
+	// Report the dives after a stop as cancelled, to release their results.
+	while (pipeline.head) {
+		dc_pipeline_job_t *job = pipeline.head;
+		pipeline.head = job->next;
+		if (done)
+			done (job->data, job->size, job->fingerprint, job->fsize, DC_STATUS_CANCELLED, job->result, userdata);
+		free (job->buffer);
+		free (job);
+	}
+
+cleanup:
+	dc_cond_free (pipeline.finished);
+	dc_mutex_free (pipeline.mutex);
+
+	return status;
+}
@@ -32,6 +32,16 @@ extern "C" {
 #define DC_PRINTF_SIZE "%zu"
 #endif
 
+// Thread local storage. Without compiler support, the variables are
+// shared by all threads.
+#if defined(_MSC_VER)
+#define DC_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define DC_THREAD_LOCAL __thread
+#else
+#define DC_THREAD_LOCAL
+#endif
+
 #ifdef _MSC_VER
 #define snprintf _snprintf
 #define strcasecmp _stricmp
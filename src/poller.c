@@ -0,0 +1,367 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(HAVE_SYS_EPOLL_H)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#elif defined(__APPLE__)
+// Neither kqueue nor poll() supports tty devices on Mac OS X.
+#define USE_SELECT
+#include <sys/select.h>
+#include <poll.h>
+#elif defined(HAVE_SYS_EVENT_H)
+#define USE_KQUEUE
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#else
+#define USE_POLL
+#include <poll.h>
+#endif
+
+#include "poller.h"
+
+#define MAXEVENTS 16
+
+struct dc_poller_t {
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	int fd;
+#else
+	struct pollfd *fds;
+	void **userdata;
+	size_t count;
+	size_t capacity;
+#endif
+};
+
+#if defined(USE_POLL) || defined(USE_SELECT)
+static int
+dc_poller_find (dc_poller_t *poller, int fd)
+{
+	for (size_t i = 0; i < poller->count; ++i) {
+		if (poller->fds[i].fd == fd)
+			return i;
+	}
+
+	errno = ENOENT;
+	return -1;
+}
+
+static short
+dc_poller_mask (unsigned int events)
+{
+	short mask = 0;
+	if (events & DC_POLLER_READ)
+		mask |= POLLIN;
+	if (events & DC_POLLER_WRITE)
+		mask |= POLLOUT;
+	return mask;
+}
+#endif
+
+#if defined(USE_SELECT)
+static int
+dc_poller_select (dc_poller_t *poller, int timeout)
+{
+	fd_set rfds, wfds;
+	int nfds = 0;
+
+	FD_ZERO (&rfds);
+	FD_ZERO (&wfds);
+	for (size_t i = 0; i < poller->count; ++i) {
+		int fd = poller->fds[i].fd;
+		if (fd >= FD_SETSIZE) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (poller->fds[i].events & POLLIN)
+			FD_SET (fd, &rfds);
+		if (poller->fds[i].events & POLLOUT)
+			FD_SET (fd, &wfds);
+		if (fd >= nfds)
+			nfds = fd + 1;
+	}
+
+	struct timeval tv, *ptv = NULL;
+	if (timeout >= 0) {
+		tv.tv_sec  = timeout / 1000;
+		tv.tv_usec = (timeout % 1000) * 1000;
+		ptv = &tv;
+	}
+
+	int n = select (nfds, &rfds, &wfds, NULL, ptv);
+	if (n <= 0)
+		return n;
+
+	for (size_t i = 0; i < poller->count; ++i) {
+		int fd = poller->fds[i].fd;
+		poller->fds[i].revents = 0;
+		if (FD_ISSET (fd, &rfds))
+			poller->fds[i].revents |= POLLIN;
+		if (FD_ISSET (fd, &wfds))
+			poller->fds[i].revents |= POLLOUT;
+	}
+
+	return n;
+}
+#endif
+
+#if defined(USE_EPOLL)
+static int
+dc_poller_ctl (dc_poller_t *poller, int op, int fd, unsigned int events, void *userdata)
+{
+	struct epoll_event ev;
+	memset (&ev, 0, sizeof (ev));
+	if (events & DC_POLLER_READ)
+		ev.events |= EPOLLIN;
+	if (events & DC_POLLER_WRITE)
+		ev.events |= EPOLLOUT;
+	ev.data.ptr = userdata;
+
+	return epoll_ctl (poller->fd, op, fd, &ev);
+}
+#endif
+
+#if defined(USE_KQUEUE)
+static int
+dc_poller_ctl (dc_poller_t *poller, int fd, unsigned int events, void *userdata)
+{
+	// The disabled filters are added as well, such that both filters
+	// always exist and can be enabled or disabled later on.
+	struct kevent changes[2];
+	EV_SET (&changes[0], fd, EVFILT_READ,
+		EV_ADD | ((events & DC_POLLER_READ) ? EV_ENABLE : EV_DISABLE), 0, 0, userdata);
+	EV_SET (&changes[1], fd, EVFILT_WRITE,
+		EV_ADD | ((events & DC_POLLER_WRITE) ? EV_ENABLE : EV_DISABLE), 0, 0, userdata);
+
+	return kevent (poller->fd, changes, 2, NULL, 0, NULL);
+}
+#endif
+
+int
+dc_poller_new (dc_poller_t **out)
+{
+	dc_poller_t *poller = NULL;
+
+	if (out == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	poller = (dc_poller_t *) malloc (sizeof (dc_poller_t));
+	if (poller == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+#if defined(USE_EPOLL)
+	poller->fd = epoll_create1 (EPOLL_CLOEXEC);
+#elif defined(USE_KQUEUE)
+	poller->fd = kqueue ();
+#else
+	poller->fds = NULL;
+	poller->userdata = NULL;
+	poller->count = 0;
+	poller->capacity = 0;
+#endif
+
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	if (poller->fd == -1) {
+		int errcode = errno;
+		free (poller);
+		errno = errcode;
+		return -1;
+	}
+#endif
+
+	*out = poller;
+
+	return 0;
+}
+
+int
+dc_poller_add (dc_poller_t *poller, int fd, unsigned int events, void *userdata)
+{
+#if defined(USE_EPOLL)
+	return dc_poller_ctl (poller, EPOLL_CTL_ADD, fd, events, userdata);
+#elif defined(USE_KQUEUE)
+	return dc_poller_ctl (poller, fd, events, userdata);
+#else
+	if (poller->count == poller->capacity) {
+		size_t capacity = poller->capacity ? poller->capacity * 2 : 4;
+		struct pollfd *fds = (struct pollfd *) realloc (poller->fds, capacity * sizeof (*fds));
+		if (fds == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		poller->fds = fds;
+
+		void **userdata = (void **) realloc (poller->userdata, capacity * sizeof (*userdata));
+		if (userdata == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		poller->userdata = userdata;
+
+		poller->capacity = capacity;
+	}
+
+	poller->fds[poller->count].fd = fd;
+	poller->fds[poller->count].events = dc_poller_mask (events);
+	poller->fds[poller->count].revents = 0;
+	poller->userdata[poller->count] = userdata;
+	poller->count++;
+
+	return 0;
+#endif
+}
+
+int
+dc_poller_modify (dc_poller_t *poller, int fd, unsigned int events, void *userdata)
+{
+#if defined(USE_EPOLL)
+	return dc_poller_ctl (poller, EPOLL_CTL_MOD, fd, events, userdata);
+#elif defined(USE_KQUEUE)
+	return dc_poller_ctl (poller, fd, events, userdata);
+#else
+	int i = dc_poller_find (poller, fd);
+	if (i < 0)
+		return -1;
+
+	poller->fds[i].events = dc_poller_mask (events);
+	poller->userdata[i] = userdata;
+
+	return 0;
+#endif
+}
+
+int
+dc_poller_remove (dc_poller_t *poller, int fd)
+{
+#if defined(USE_EPOLL)
+	struct epoll_event ev;
+	memset (&ev, 0, sizeof (ev));
+	return epoll_ctl (poller->fd, EPOLL_CTL_DEL, fd, &ev);
+#elif defined(USE_KQUEUE)
+	struct kevent changes[2];
+	EV_SET (&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	EV_SET (&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+	return kevent (poller->fd, changes, 2, NULL, 0, NULL);
+#else
+	int i = dc_poller_find (poller, fd);
+	if (i < 0)
+		return -1;
+
+	poller->count--;
+	poller->fds[i] = poller->fds[poller->count];
+	poller->userdata[i] = poller->userdata[poller->count];
+
+	return 0;
+#endif
+}
+
+int
+dc_poller_wait (dc_poller_t *poller, dc_poller_event_t events[], unsigned int maxevents, int timeout)
+{
+	int n = 0;
+
+	if (maxevents > MAXEVENTS)
+		maxevents = MAXEVENTS;
+
+#if defined(USE_EPOLL)
+	struct epoll_event ev[MAXEVENTS];
+	n = epoll_wait (poller->fd, ev, maxevents, timeout < 0 ? -1 : timeout);
+	for (int i = 0; i < n; ++i) {
+		events[i].userdata = ev[i].data.ptr;
+		events[i].events = 0;
+		// Errors and hangups are reported as readable, such that the
+		// subsequent read returns the actual error.
+		if (ev[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			events[i].events |= DC_POLLER_READ;
+		if (ev[i].events & EPOLLOUT)
+			events[i].events |= DC_POLLER_WRITE;
+	}
+#elif defined(USE_KQUEUE)
+	struct kevent ev[MAXEVENTS];
+	struct timespec ts, *pts = NULL;
+	if (timeout >= 0) {
+		ts.tv_sec  = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		pts = &ts;
+	}
+	n = kevent (poller->fd, NULL, 0, ev, maxevents, pts);
+	for (int i = 0; i < n; ++i) {
+		events[i].userdata = ev[i].udata;
+		events[i].events = ev[i].filter == EVFILT_WRITE ?
+			DC_POLLER_WRITE : DC_POLLER_READ;
+	}
+#else
+#if defined(USE_SELECT)
+	n = dc_poller_select (poller, timeout);
+#else
+	n = poll (poller->fds, poller->count, timeout < 0 ? -1 : timeout);
+#endif
+	if (n > 0) {
+		n = 0;
+		for (size_t i = 0; i < poller->count && (unsigned int) n < maxevents; ++i) {
+			short revents = poller->fds[i].revents;
+			if (revents == 0)
+				continue;
+			events[n].userdata = poller->userdata[i];
+			events[n].events = 0;
+			if (revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL))
+				events[n].events |= DC_POLLER_READ;
+			if (revents & POLLOUT)
+				events[n].events |= DC_POLLER_WRITE;
+			n++;
+		}
+	}
+#endif
+
+	if (n < 0 && errno == EINTR)
+		return 0;
+
+	return n;
+}
+
+void
+dc_poller_free (dc_poller_t *poller)
+{
+	if (poller == NULL)
+		return;
+
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	close (poller->fd);
+#else
+	free (poller->userdata);
+	free (poller->fds);
+#endif
+	free (poller);
+}
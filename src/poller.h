@@ -0,0 +1,77 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_POLLER_H
+#define DC_POLLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Readiness notification for file descriptors.
+ *
+ * The poller uses epoll on Linux and kqueue on the BSD's, and falls
+ * back to poll() elsewhere. Unlike select(), none of them is limited to
+ * FD_SETSIZE, and a single poller can watch the descriptors of many
+ * connections at once. Mac OS X is the exception: neither kqueue nor
+ * poll() supports tty devices there, so select() is used instead. The
+ * functions follow the POSIX conventions: on failure, -1 is returned and
+ * errno is set.
+ */
+typedef struct dc_poller_t dc_poller_t;
+
+#define DC_POLLER_READ  0x01
+#define DC_POLLER_WRITE 0x02
+
+typedef struct dc_poller_event_t {
+	void *userdata;
+	unsigned int events;
+} dc_poller_event_t;
+
+int
+dc_poller_new (dc_poller_t **poller);
+
+int
+dc_poller_add (dc_poller_t *poller, int fd, unsigned int events, void *userdata);
+
+int
+dc_poller_modify (dc_poller_t *poller, int fd, unsigned int events, void *userdata);
+
+int
+dc_poller_remove (dc_poller_t *poller, int fd);
+
+/*
+ * Wait for at most timeout milliseconds (or forever for a negative
+ * timeout) until one of the descriptors is ready. Returns the number of
+ * events stored, or zero on timeout. An interrupted wait also returns
+ * zero, so the caller recalculates its remaining time.
+ */
+int
+dc_poller_wait (dc_poller_t *poller, dc_poller_event_t events[], unsigned int maxevents, int timeout);
+
+void
+dc_poller_free (dc_poller_t *poller);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_POLLER_H */
@@ -0,0 +1,416 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libdivecomputer/parser.h>
+
+#include "context-private.h"
+#include "parser-private.h"
+#include "array.h"
+
+/*
+ * Binary profile format
+ *
+ * The data starts with the four byte header "DCP" and a version number,
+ * followed by one record per sample value. Each record starts with a tag
+ * byte containing the dc_sample_type_t value. The integer members are
+ * stored as unsigned LEB128 varints, and signed deltas are zigzag encoded
+ * first.
+ *
+ * Floating point values are stored as the zigzag encoded delta, against
+ * the previous value of the same kind, of the value in units of 0.001.
+ * If a value can't be represented exactly in those units, the RAW bit is
+ * set in the tag and the value is stored as a little endian IEEE double.
+ * That keeps the format lossless.
+ */
+
+#define PROFILE_VERSION 1
+#define RAW     0x80
+#define SCALE   1000.0
+#define NTANKS  16
+
+typedef struct dc_profile_state_t {
+	unsigned int time;
+	long long depth;
+	long long temperature;
+	long long setpoint;
+	long long ppo2;
+	long long cns;
+	long long pressure[NTANKS];
+} dc_profile_state_t;
+
+typedef struct dc_profile_encoder_t {
+	dc_buffer_t *buffer;
+	dc_profile_state_t state;
+	int error;
+} dc_profile_encoder_t;
+
+static const unsigned char header[] = {'D', 'C', 'P', PROFILE_VERSION};
+
+static int
+dc_profile_quantize (double value, long long *result)
+{
+	double scaled = value * SCALE;
+
+	if (!(fabs (scaled) < 4503599627370496.0)) /* 2^52 */
+		return 0;
+
+	long long q = llround (scaled);
+	if ((double) q / SCALE != value)
+		return 0;
+
+	*result = q;
+
+	return 1;
+}
+
+static unsigned long long
+zigzag_encode (long long value)
+{
+	return ((unsigned long long) value << 1) ^ (unsigned long long) (value >> 63);
+}
+
+static long long
+zigzag_decode (unsigned long long value)
+{
+	return (long long) (value >> 1) ^ -(long long) (value & 1);
+}
+
+static size_t
+varint_encode (unsigned char buffer[], unsigned long long value)
+{
+	size_t n = 0;
+
+	while (value >= 0x80) {
+		buffer[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	buffer[n++] = value;
+
+	return n;
+}
+
+static size_t
+varint_decode (const unsigned char data[], size_t size, unsigned long long *value)
+{
+	unsigned long long result = 0;
+	unsigned int shift = 0;
+
+	for (size_t i = 0; i < size && shift < 64; ++i) {
+		result |= (unsigned long long) (data[i] & 0x7F) << shift;
+		if ((data[i] & 0x80) == 0) {
+			*value = result;
+			return i + 1;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+/*
+ * Encode a floating point value at the end of the record, and update the
+ * tag byte at the start of the record if the value has to be stored raw.
+ */
+static size_t
+dc_profile_encode_real (unsigned char record[], size_t n, double value, long long *previous)
+{
+	long long q = 0;
+
+	if (previous && dc_profile_quantize (value, &q)) {
+		n += varint_encode (record + n, zigzag_encode (q - *previous));
+		*previous = q;
+	} else if (!previous && dc_profile_quantize (value, &q)) {
+		n += varint_encode (record + n, zigzag_encode (q));
+	} else {
+		union { double real; unsigned long long uint; } raw;
+		raw.real = value;
+		array_uint32_le_set (record + n, raw.uint & 0xFFFFFFFF);
+		array_uint32_le_set (record + n + 4, raw.uint >> 32);
+		n += 8;
+		record[0] |= RAW;
+		if (previous)
+			*previous = 0;
+	}
+
+	return n;
+}
+
+static size_t
+dc_profile_decode_real (const unsigned char data[], size_t size, unsigned char tag, double *value, long long *previous)
+{
+	if (tag & RAW) {
+		union { double real; unsigned long long uint; } raw;
+		if (size < 8)
+			return 0;
+		raw.uint = array_uint32_le (data) | (unsigned long long) array_uint32_le (data + 4) << 32;
+		*value = raw.real;
+		if (previous)
+			*previous = 0;
+		return 8;
+	}
+
+	unsigned long long u = 0;
+	size_t n = varint_decode (data, size, &u);
+	if (n == 0)
+		return 0;
+
+	long long q = zigzag_decode (u);
+	if (previous) {
+		q += *previous;
+		*previous = q;
+	}
+	*value = (double) q / SCALE;
+
+	return n;
+}
+
+static void
+dc_profile_encode_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_profile_encoder_t *encoder = (dc_profile_encoder_t *) userdata;
+	dc_profile_state_t *state = &encoder->state;
+	unsigned char record[1 + 5 * 10];
+	size_t n = 0;
+
+	if (encoder->error)
+		return;
+
+	record[n++] = type;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		n += varint_encode (record + n, zigzag_encode ((long long) value.time - state->time));
+		state->time = value.time;
+		break;
+	case DC_SAMPLE_DEPTH:
+		n = dc_profile_encode_real (record, n, value.depth, &state->depth);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		n += varint_encode (record + n, value.pressure.tank);
+		n = dc_profile_encode_real (record, n, value.pressure.value,
+			value.pressure.tank < NTANKS ? &state->pressure[value.pressure.tank] : NULL);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		n = dc_profile_encode_real (record, n, value.temperature, &state->temperature);
+		break;
+	case DC_SAMPLE_EVENT:
+		n += varint_encode (record + n, value.event.type);
+		n += varint_encode (record + n, value.event.time);
+		n += varint_encode (record + n, value.event.flags);
+		n += varint_encode (record + n, value.event.value);
+		break;
+	case DC_SAMPLE_RBT:
+		n += varint_encode (record + n, value.rbt);
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		n += varint_encode (record + n, value.heartbeat);
+		break;
+	case DC_SAMPLE_BEARING:
+		n += varint_encode (record + n, value.bearing);
+		break;
+	case DC_SAMPLE_VENDOR:
+		n += varint_encode (record + n, value.vendor.type);
+		n += varint_encode (record + n, value.vendor.size);
+		break;
+	case DC_SAMPLE_SETPOINT:
+		n = dc_profile_encode_real (record, n, value.setpoint, &state->setpoint);
+		break;
+	case DC_SAMPLE_PPO2:
+		n = dc_profile_encode_real (record, n, value.ppo2, &state->ppo2);
+		break;
+	case DC_SAMPLE_CNS:
+		n = dc_profile_encode_real (record, n, value.cns, &state->cns);
+		break;
+	case DC_SAMPLE_DECO:
+		n += varint_encode (record + n, value.deco.type);
+		n += varint_encode (record + n, value.deco.time);
+		n = dc_profile_encode_real (record, n, value.deco.depth, NULL);
+		break;
+	case DC_SAMPLE_GASMIX:
+		n += varint_encode (record + n, value.gasmix);
+		break;
+	default:
+		return;
+	}
+
+	if (!dc_buffer_append (encoder->buffer, record, n) ||
+		(type == DC_SAMPLE_VENDOR && value.vendor.size &&
+		!dc_buffer_append (encoder->buffer, (const unsigned char *) value.vendor.data, value.vendor.size))) {
+		encoder->error = 1;
+	}
+}
+
+dc_status_t
+dc_profile_encode (dc_parser_t *parser, dc_buffer_t *buffer)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_profile_encoder_t encoder;
+
+	if (parser == NULL || buffer == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	memset (&encoder, 0, sizeof (encoder));
+	encoder.buffer = buffer;
+
+	if (!dc_buffer_clear (buffer) ||
+		!dc_buffer_append (buffer, header, sizeof (header))) {
+		ERROR (parser->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_parser_samples_foreach (parser, dc_profile_encode_cb, &encoder);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (encoder.error) {
+		ERROR (parser->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_profile_decode (const unsigned char data[], unsigned int size, dc_sample_callback_t callback, void *userdata)
+{
+	dc_profile_state_t state;
+
+	if (data == NULL && size != 0)
+		return DC_STATUS_INVALIDARGS;
+
+	if (size < sizeof (header) || memcmp (data, header, sizeof (header)) != 0)
+		return DC_STATUS_DATAFORMAT;
+
+	memset (&state, 0, sizeof (state));
+
+	size_t offset = sizeof (header);
+	while (offset < size) {
+		dc_sample_value_t value;
+		unsigned long long u[4] = {0};
+		size_t n = 0;
+
+		memset (&value, 0, sizeof (value));
+
+		unsigned char tag = data[offset++];
+		dc_sample_type_t type = (dc_sample_type_t) (tag & ~RAW);
+		const unsigned char *p = data + offset;
+		size_t len = size - offset;
+
+#define VARINT(i) \
+	do { \
+		size_t k = varint_decode (p + n, len - n, &u[i]); \
+		if (k == 0) return DC_STATUS_DATAFORMAT; \
+		n += k; \
+	} while (0)
+#define REAL(dst, prev) \
+	do { \
+		size_t k = dc_profile_decode_real (p + n, len - n, tag, &(dst), prev); \
+		if (k == 0) return DC_STATUS_DATAFORMAT; \
+		n += k; \
+	} while (0)
+
+		switch (type) {
+		case DC_SAMPLE_TIME:
+			VARINT (0);
+			state.time += (unsigned int) zigzag_decode (u[0]);
+			value.time = state.time;
+			break;
+		case DC_SAMPLE_DEPTH:
+			REAL (value.depth, &state.depth);
+			break;
+		case DC_SAMPLE_PRESSURE:
+			VARINT (0);
+			value.pressure.tank = u[0];
+			REAL (value.pressure.value, u[0] < NTANKS ? &state.pressure[u[0]] : NULL);
+			break;
+		case DC_SAMPLE_TEMPERATURE:
+			REAL (value.temperature, &state.temperature);
+			break;
+		case DC_SAMPLE_EVENT:
+			VARINT (0);
+			VARINT (1);
+			VARINT (2);
+			VARINT (3);
+			value.event.type = u[0];
+			value.event.time = u[1];
+			value.event.flags = u[2];
+			value.event.value = u[3];
+			break;
+		case DC_SAMPLE_RBT:
+			VARINT (0);
+			value.rbt = u[0];
+			break;
+		case DC_SAMPLE_HEARTBEAT:
+			VARINT (0);
+			value.heartbeat = u[0];
+			break;
+		case DC_SAMPLE_BEARING:
+			VARINT (0);
+			value.bearing = u[0];
+			break;
+		case DC_SAMPLE_VENDOR:
+			VARINT (0);
+			VARINT (1);
+			if (u[1] > len - n)
+				return DC_STATUS_DATAFORMAT;
+			value.vendor.type = u[0];
+			value.vendor.size = u[1];
+			value.vendor.data = p + n;
+			n += u[1];
+			break;
+		case DC_SAMPLE_SETPOINT:
+			REAL (value.setpoint, &state.setpoint);
+			break;
+		case DC_SAMPLE_PPO2:
+			REAL (value.ppo2, &state.ppo2);
+			break;
+		case DC_SAMPLE_CNS:
+			REAL (value.cns, &state.cns);
+			break;
+		case DC_SAMPLE_DECO:
+			VARINT (0);
+			VARINT (1);
+			value.deco.type = u[0];
+			value.deco.time = u[1];
+			REAL (value.deco.depth, NULL);
+			break;
+		case DC_SAMPLE_GASMIX:
+			VARINT (0);
+			value.gasmix = u[0];
+			break;
+		default:
+			return DC_STATUS_DATAFORMAT;
+		}
+#undef VARINT
+#undef REAL
+
+		if (callback)
+			callback (type, value, userdata);
+
+		offset += n;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
@@ -25,17 +25,22 @@
 #include "rbstream.h"
 #include "context-private.h"
 #include "device-private.h"
+#include "trace.h"
 
 struct dc_rbstream_t {
 	dc_device_t *device;
 	unsigned int pagesize;
 	unsigned int packetsize;
+	unsigned int prefetch;
 	unsigned int begin;
 	unsigned int end;
 	unsigned int address;
-	unsigned int available;
-	unsigned int skip;
-	unsigned char cache[];
+	int limited;
+	unsigned int remaining;
+	/* The most recent read, starting at the cached address. */
+	unsigned int cached;
+	unsigned int ncached;
+	unsigned char *cache;
 };
 
 static unsigned int
@@ -54,6 +59,12 @@ iceil (unsigned int x, unsigned int n)
 
 dc_status_t
 dc_rbstream_new (dc_rbstream_t **out, dc_device_t *device, unsigned int pagesize, unsigned int packetsize, unsigned int begin, unsigned int end, unsigned int address)
+{
+	return dc_rbstream_new2 (out, device, pagesize, packetsize, 1, begin, end, address);
+}
+
+dc_status_t
+dc_rbstream_new2 (dc_rbstream_t **out, dc_device_t *device, unsigned int pagesize, unsigned int packetsize, unsigned int prefetch, unsigned int begin, unsigned int end, unsigned int address)
 {
 	dc_rbstream_t *rbstream = NULL;
 
@@ -66,6 +77,11 @@ dc_rbstream_new (dc_rbstream_t **out, dc_device_t *device, unsigned int pagesize
 		return DC_STATUS_INVALIDARGS;
 	}
 
+	// Read at least one packet at a time.
+	if (prefetch == 0) {
+		prefetch = 1;
+	}
+
 	// Packet size should be a multiple of the page size.
 	if (packetsize % pagesize != 0) {
 		ERROR (device->context, "Packet size not a multiple of the page size!");
@@ -85,26 +101,83 @@ dc_rbstream_new (dc_rbstream_t **out, dc_device_t *device, unsigned int pagesize
 	}
 
 	// Allocate memory.
-	rbstream = (dc_rbstream_t *) malloc (sizeof(*rbstream) + packetsize);
+	rbstream = (dc_rbstream_t *) malloc (sizeof(*rbstream));
 	if (rbstream == NULL) {
 		ERROR (device->context, "Failed to allocate memory.");
 		return DC_STATUS_NOMEMORY;
 	}
 
+	rbstream->cache = (unsigned char *) malloc (packetsize * prefetch);
+	if (rbstream->cache == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		free (rbstream);
+		return DC_STATUS_NOMEMORY;
+	}
+
 	rbstream->device = device;
 	rbstream->pagesize = pagesize;
 	rbstream->packetsize = packetsize;
+	rbstream->prefetch = prefetch;
 	rbstream->begin = begin;
 	rbstream->end = end;
-	rbstream->address = iceil(address, pagesize);
-	rbstream->available = 0;
-	rbstream->skip = rbstream->address - address;
+	rbstream->address = address;
+	rbstream->limited = 0;
+	rbstream->remaining = 0;
+	rbstream->cached = 0;
+	rbstream->ncached = 0;
 
 	*out = rbstream;
 
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+dc_rbstream_fetch (dc_rbstream_t *rbstream, unsigned int address)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	// Check whether the cache contains the byte just below the address.
+	if (rbstream->ncached && address > rbstream->cached && address <= rbstream->cached + rbstream->ncached)
+		return DC_STATUS_SUCCESS;
+
+	// Reads are always aligned to the page size.
+	unsigned int top = iceil (address, rbstream->pagesize);
+
+	// Calculate the number of bytes to read ahead.
+	unsigned int len = rbstream->packetsize * rbstream->prefetch;
+	if (rbstream->limited) {
+		// Without any data left, fall back to a single packet.
+		unsigned int remaining = iceil (rbstream->remaining, rbstream->pagesize);
+		if (remaining < rbstream->packetsize)
+			remaining = rbstream->packetsize;
+		if (len > remaining)
+			len = remaining;
+	}
+	if (rbstream->begin + len > top) {
+		len = top - rbstream->begin;
+		// Read only complete packets, and leave the remainder
+		// for the last (single packet) read.
+		if (len > rbstream->packetsize)
+			len = ifloor (len, rbstream->packetsize);
+	}
+
+	// Always read at least one full packet.
+	unsigned int nread = len;
+	if (nread < rbstream->packetsize)
+		nread = rbstream->packetsize;
+
+	// Read the packets.
+	rbstream->ncached = 0;
+	rc = dc_device_read (rbstream->device, top - len, rbstream->cache, nread);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	rbstream->cached = top - len;
+	rbstream->ncached = len;
+
+	return rc;
+}
+
 dc_status_t
 dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned char data[], unsigned int size)
 {
@@ -114,42 +187,29 @@ dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsign
 		return DC_STATUS_INVALIDARGS;
 
 	unsigned int address = rbstream->address;
-	unsigned int available = rbstream->available;
-	unsigned int skip = rbstream->skip;
+
+	TRACE3 (rbstream_read_entry, rbstream, address, size);
 
 	unsigned int nbytes = 0;
 	unsigned int offset = size;
 	while (nbytes < size) {
-		if (available == 0) {
-			// Handle the ringbuffer wrap point.
-			if (address == rbstream->begin)
-				address = rbstream->end;
-
-			// Calculate the packet size.
-			unsigned int len = rbstream->packetsize;
-			if (rbstream->begin + len > address)
-				len = address - rbstream->begin;
-
-			// Move to the begin of the current packet.
-			address -= len;
-
-			// Read the packet into the cache.
-			rc = dc_device_read (rbstream->device, address, rbstream->cache, rbstream->packetsize);
-			if (rc != DC_STATUS_SUCCESS)
-				return rc;
-
-			available = len - skip;
-			skip = 0;
-		}
+		// Handle the ringbuffer wrap point.
+		if (address == rbstream->begin)
+			address = rbstream->end;
+
+		// Get the data below the current address.
+		rc = dc_rbstream_fetch (rbstream, address);
+		if (rc != DC_STATUS_SUCCESS)
+			break;
 
-		unsigned int length = available;
+		unsigned int length = address - rbstream->cached;
 		if (nbytes + length > size)
 			length = size - nbytes;
 
 		offset -= length;
-		available -= length;
+		address -= length;
 
-		memcpy (data + offset, rbstream->cache + available, length);
+		memcpy (data + offset, rbstream->cache + (address - rbstream->cached), length);
 
 		// Update and emit a progress event.
 		if (progress) {
@@ -158,18 +218,54 @@ dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsign
 		}
 
 		nbytes += length;
+
+		rbstream->address = address;
+		if (rbstream->limited)
+			rbstream->remaining -= (length < rbstream->remaining ? length : rbstream->remaining);
 	}
 
-	rbstream->address = address;
-	rbstream->available = available;
-	rbstream->skip = skip;
+	TRACE3 (rbstream_read_return, rbstream, rc, nbytes);
 
 	return rc;
 }
 
+dc_status_t
+dc_rbstream_seek (dc_rbstream_t *rbstream, unsigned int address)
+{
+	if (rbstream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Address should be inside the ringbuffer.
+	if (address < rbstream->begin || address > rbstream->end) {
+		ERROR (rbstream->device->context, "Address outside the ringbuffer!");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	rbstream->address = address;
+	rbstream->limited = 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_rbstream_limit (dc_rbstream_t *rbstream, unsigned int size)
+{
+	if (rbstream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	rbstream->limited = 1;
+	rbstream->remaining = size;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_rbstream_free (dc_rbstream_t *rbstream)
 {
+	if (rbstream == NULL)
+		return DC_STATUS_SUCCESS;
+
+	free (rbstream->cache);
 	free (rbstream);
 
 	return DC_STATUS_SUCCESS;
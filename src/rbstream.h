@@ -49,6 +49,28 @@ typedef struct dc_rbstream_t dc_rbstream_t;
 dc_status_t
 dc_rbstream_new (dc_rbstream_t **rbstream, dc_device_t *device, unsigned int pagesize, unsigned int packetsize, unsigned int begin, unsigned int end, unsigned int address);
 
+/**
+ * Create a new ringbuffer stream with read-ahead.
+ *
+ * The stream reads up to prefetch packets at once, in the ringbuffer
+ * direction, and serves the following reads from the cache. A single
+ * large read allows the backend to pipeline or combine the underlying
+ * packet requests.
+ *
+ * @param[out]  rbstream    A location to store the ringbuffer stream.
+ * @param[in]   device      A valid device object.
+ * @param[in]   pagesize    The page size in bytes.
+ * @param[in]   packetsize  The packet size in bytes.
+ * @param[in]   prefetch    The number of packets to read ahead.
+ * @param[in]   begin       The ringbuffer begin address.
+ * @param[in]   end         The ringbuffer end address.
+ * @param[in]   address     The stream start address.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_rbstream_new2 (dc_rbstream_t **rbstream, dc_device_t *device, unsigned int pagesize, unsigned int packetsize, unsigned int prefetch, unsigned int begin, unsigned int end, unsigned int address);
+
 /**
  * Read data from the ringbuffer stream.
  *
@@ -62,6 +84,38 @@ dc_rbstream_new (dc_rbstream_t **rbstream, dc_device_t *device, unsigned int pag
 dc_status_t
 dc_rbstream_read (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned char data[], unsigned int size);
 
+/**
+ * Move the ringbuffer stream to a new address.
+ *
+ * Skipping over data that is not needed, for example a gap between two
+ * profiles, avoids reading it from the device. Data that is still in
+ * the cache is not read again.
+ *
+ * @param[in]  rbstream  A valid ringbuffer stream.
+ * @param[in]  address   The new stream address.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_rbstream_seek (dc_rbstream_t *rbstream, unsigned int address);
+
+/**
+ * Limit the ringbuffer stream to the next size bytes.
+ *
+ * When the total amount of data is known in advance, for example from
+ * the logbook, the read-ahead stops at the limit, instead of reading the
+ * remainder of a full prefetch. Data beyond the limit can still be read,
+ * one packet at a time, without any read-ahead. The limit is cleared by
+ * #dc_rbstream_seek.
+ *
+ * @param[in]  rbstream  A valid ringbuffer stream.
+ * @param[in]  size      The number of bytes which will be read.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_rbstream_limit (dc_rbstream_t *rbstream, unsigned int size);
+
 /**
  * Destroy the ringbuffer stream.
  *
@@ -0,0 +1,230 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_READER_H
+#define DC_READER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A bounds checked cursor over a binary buffer, for parsing records with
+ * a variable layout.
+ *
+ * Every read checks the remaining size. Reading past the end moves the
+ * cursor to the end, sets the overflow flag and returns zero. The flag
+ * is sticky, so a sequence of reads can be checked once afterwards.
+ *
+ * All functions are inline, such that the compiler can merge the checks
+ * of consecutive reads. For a record with a known size, the record can
+ * also be split off as a separate cursor with dc_reader_split(). This
+ * checks the size of the record once, and the reads inside the record
+ * can no longer run into the next one.
+ */
+typedef struct dc_reader_t {
+	const unsigned char *data;
+	unsigned int size;
+	unsigned int offset;
+	unsigned int overflow;
+} dc_reader_t;
+
+static inline void
+dc_reader_init (dc_reader_t *reader, const unsigned char data[], unsigned int size)
+{
+	reader->data = data;
+	reader->size = size;
+	reader->offset = 0;
+	reader->overflow = 0;
+}
+
+static inline unsigned int
+dc_reader_offset (const dc_reader_t *reader)
+{
+	return reader->offset;
+}
+
+static inline unsigned int
+dc_reader_remaining (const dc_reader_t *reader)
+{
+	return reader->size - reader->offset;
+}
+
+static inline int
+dc_reader_overflow (const dc_reader_t *reader)
+{
+	return reader->overflow;
+}
+
+static inline const unsigned char *
+dc_reader_current (const dc_reader_t *reader)
+{
+	return reader->data + reader->offset;
+}
+
+/*
+ * Check whether n more bytes are available. On failure, the overflow
+ * flag is set and the cursor is moved to the end.
+ */
+static inline int
+dc_reader_require (dc_reader_t *reader, unsigned int n)
+{
+	if (reader->overflow || n > reader->size - reader->offset) {
+		reader->offset = reader->size;
+		reader->overflow = 1;
+		return 0;
+	}
+
+	return 1;
+}
+
+static inline void
+dc_reader_skip (dc_reader_t *reader, unsigned int n)
+{
+	if (dc_reader_require (reader, n))
+		reader->offset += n;
+}
+
+/*
+ * Split the next n bytes off into a separate cursor, and advance past
+ * them. On failure, the new cursor is empty and has its overflow flag
+ * set too.
+ */
+static inline int
+dc_reader_split (dc_reader_t *reader, dc_reader_t *block, unsigned int n)
+{
+	if (!dc_reader_require (reader, n)) {
+		dc_reader_init (block, reader->data + reader->offset, 0);
+		block->overflow = 1;
+		return 0;
+	}
+
+	dc_reader_init (block, reader->data + reader->offset, n);
+	reader->offset += n;
+
+	return 1;
+}
+
+static inline unsigned int
+dc_reader_u8 (dc_reader_t *reader)
+{
+	if (!dc_reader_require (reader, 1))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += 1;
+	return p[0];
+}
+
+static inline unsigned int
+dc_reader_u16le (dc_reader_t *reader)
+{
+	if (!dc_reader_require (reader, 2))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += 2;
+	return p[0] | ((unsigned int) p[1] << 8);
+}
+
+static inline unsigned int
+dc_reader_u16be (dc_reader_t *reader)
+{
+	if (!dc_reader_require (reader, 2))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += 2;
+	return ((unsigned int) p[0] << 8) | p[1];
+}
+
+static inline unsigned int
+dc_reader_u24le (dc_reader_t *reader)
+{
+	if (!dc_reader_require (reader, 3))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += 3;
+	return p[0] | ((unsigned int) p[1] << 8) | ((unsigned int) p[2] << 16);
+}
+
+static inline unsigned int
+dc_reader_u24be (dc_reader_t *reader)
+{
+	if (!dc_reader_require (reader, 3))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += 3;
+	return ((unsigned int) p[0] << 16) | ((unsigned int) p[1] << 8) | p[2];
+}
+
+static inline unsigned int
+dc_reader_u32le (dc_reader_t *reader)
+{
+	if (!dc_reader_require (reader, 4))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += 4;
+	return p[0] | ((unsigned int) p[1] << 8) | ((unsigned int) p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static inline unsigned int
+dc_reader_u32be (dc_reader_t *reader)
+{
+	if (!dc_reader_require (reader, 4))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += 4;
+	return ((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16) | ((unsigned int) p[2] << 8) | p[3];
+}
+
+/*
+ * Read nbytes (at most 4) as a big endian value, and keep only the nbits
+ * least significant bits. This is the layout of a bitstream where a
+ * variable number of type bits precedes the value.
+ */
+static inline unsigned int
+dc_reader_bits (dc_reader_t *reader, unsigned int nbytes, unsigned int nbits)
+{
+	if (!dc_reader_require (reader, nbytes))
+		return 0;
+
+	const unsigned char *p = reader->data + reader->offset;
+	reader->offset += nbytes;
+
+	unsigned int value = 0;
+	for (unsigned int i = 0; i < nbytes; ++i)
+		value = (value << 8) | p[i];
+
+	if (nbits == 0)
+		return 0;
+
+	return value & (0xFFFFFFFF >> (32 - nbits));
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_READER_H */
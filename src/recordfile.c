@@ -0,0 +1,159 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "recordfile.h"
+#include "context-private.h"
+#include "array.h"
+
+#define MAXLINE (3 * 16 + 2 * DC_RECORD_MAXSIZE + 2)
+
+static int
+dc_recordfile_write (FILE *fp, const dc_record_t *record)
+{
+	char hex[2 * DC_RECORD_MAXSIZE + 1];
+	array_convert_bin2hex (record->data, record->size, (unsigned char *) hex, 2 * record->size);
+	hex[2 * record->size] = 0;
+
+	return fprintf (fp, "%08x %u %u %s\n", record->family, record->model, record->serial, hex) >= 0;
+}
+
+dc_status_t
+dc_recordfile_load (dc_context_t *context, const char *filename, const char *name, dc_record_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	FILE *fp = fopen (filename, "r");
+	if (fp == NULL) {
+		// A missing file contains no records.
+		if (errno == ENOENT)
+			return DC_STATUS_SUCCESS;
+		ERROR (context, "Failed to open the %s file (%s).", name, filename);
+		return DC_STATUS_IO;
+	}
+
+	unsigned int line = 0;
+	char buffer[MAXLINE + 1];
+	while (fgets (buffer, sizeof (buffer), fp)) {
+		unsigned int family = 0, model = 0, serial = 0;
+		char hex[2 * DC_RECORD_MAXSIZE + 1];
+		dc_record_t record;
+
+		line++;
+
+		// The last line can be incomplete after a crash.
+		unsigned int size = 0;
+		if (sscanf (buffer, "%x %u %u %128s", &family, &model, &serial, hex) != 4 ||
+			(size = strlen (hex)) % 2 != 0 || size == 0 ||
+			array_convert_hex2bin ((const unsigned char *) hex, size, record.data, size / 2) != 0) {
+			WARNING (context, "Ignoring invalid %s entry (line %u).", name, line);
+			continue;
+		}
+
+		record.next = NULL;
+		record.family = (dc_family_t) family;
+		record.model = model;
+		record.serial = serial;
+		record.size = size / 2;
+
+		status = callback (&record, userdata);
+		if (status != DC_STATUS_SUCCESS)
+			break;
+	}
+
+	fclose (fp);
+
+	return status;
+}
+
+dc_status_t
+dc_recordfile_save (dc_context_t *context, const char *filename, const char *name, const dc_record_t *records)
+{
+	// Write all records to a temporary file first, and replace the
+	// original file only if that succeeded. An interrupted write can't
+	// destroy the previously stored records.
+	size_t length = strlen (filename);
+	char *tmpname = (char *) malloc (length + 5);
+	if (tmpname == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+	memcpy (tmpname, filename, length);
+	memcpy (tmpname + length, ".tmp", 5);
+
+	FILE *fp = fopen (tmpname, "w");
+	if (fp == NULL) {
+		ERROR (context, "Failed to open the %s file (%s).", name, tmpname);
+		free (tmpname);
+		return DC_STATUS_IO;
+	}
+
+	int error = 0;
+	for (const dc_record_t *record = records; record; record = record->next) {
+		if (record->size == 0)
+			continue;
+
+		if (!dc_recordfile_write (fp, record))
+			error = 1;
+	}
+
+	if (fclose (fp) != 0)
+		error = 1;
+
+#ifdef _WIN32
+	// Windows can't rename a file to an existing filename.
+	if (!error)
+		remove (filename);
+#endif
+
+	if (error || rename (tmpname, filename) != 0) {
+		ERROR (context, "Failed to write the %s file (%s).", name, filename);
+		remove (tmpname);
+		free (tmpname);
+		return DC_STATUS_IO;
+	}
+
+	free (tmpname);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_recordfile_append (dc_context_t *context, const char *filename, const char *name, const dc_record_t *record)
+{
+	FILE *fp = fopen (filename, "a");
+	if (fp == NULL) {
+		ERROR (context, "Failed to open the %s file (%s).", name, filename);
+		return DC_STATUS_IO;
+	}
+
+	int error = !dc_recordfile_write (fp, record);
+	if (fclose (fp) != 0 || error) {
+		ERROR (context, "Failed to write the %s file (%s).", name, filename);
+		return DC_STATUS_IO;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
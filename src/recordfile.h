@@ -0,0 +1,80 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_RECORDFILE_H
+#define DC_RECORDFILE_H
+
+#include <libdivecomputer/device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The fingerprint store and the journal share the same plain text file
+ * format, with one line per record:
+ *
+ *     <family> <model> <serial> <fingerprint>
+ *
+ * The family is written as a hexadecimal number, the model and serial
+ * number as decimal numbers, and the fingerprint as a hexadecimal
+ * string.
+ */
+
+#define DC_RECORD_MAXSIZE 64
+
+typedef struct dc_record_t {
+	struct dc_record_t *next;
+	dc_family_t family;
+	unsigned int model;
+	unsigned int serial;
+	unsigned int size;
+	unsigned char data[DC_RECORD_MAXSIZE];
+} dc_record_t;
+
+typedef dc_status_t (*dc_record_callback_t) (const dc_record_t *record, void *userdata);
+
+/*
+ * Read all records from the file, and pass them to the callback in file
+ * order. Invalid lines are skipped with a warning, and a missing file
+ * contains no records. The name is only used for the log messages.
+ */
+dc_status_t
+dc_recordfile_load (dc_context_t *context, const char *filename, const char *name, dc_record_callback_t callback, void *userdata);
+
+/*
+ * Replace the file with the list of records. Empty records are not
+ * written. The records are written to a temporary file first, and the
+ * original file is replaced only if that succeeded.
+ */
+dc_status_t
+dc_recordfile_save (dc_context_t *context, const char *filename, const char *name, const dc_record_t *records);
+
+/*
+ * Append a single record to the end of the file.
+ */
+dc_status_t
+dc_recordfile_append (dc_context_t *context, const char *filename, const char *name, const dc_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_RECORDFILE_H */
@@ -53,16 +53,15 @@ static const dc_device_vtable_t reefnet_sensus_device_vtable = {
 	DC_FAMILY_REEFNET_SENSUS,
 	reefnet_sensus_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	reefnet_sensus_device_dump, /* dump */
 	reefnet_sensus_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	reefnet_sensus_device_close /* close */
 };
 
-static dc_status_t
-reefnet_sensus_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 reefnet_sensus_cancel (reefnet_sensus_device_t *device)
 {
@@ -279,7 +278,8 @@ reefnet_sensus_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	// Send the command to the device.
+	// Send the command to the device. This is the only read command, and
+	// it always returns the full memory contents.
 	unsigned char command = 0x40;
 	status = dc_iostream_write (device->iostream, &command, 1, NULL);
 	if (status != DC_STATUS_SUCCESS) {
@@ -354,7 +354,7 @@ reefnet_sensus_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 }
 
 
-static dc_status_t
+dc_status_t
 reefnet_sensus_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	reefnet_sensus_device_t *device = (reefnet_sensus_device_t*) abstract;
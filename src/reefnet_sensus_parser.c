@@ -119,6 +119,9 @@ reefnet_sensus_parser_set_calibration (dc_parser_t *abstract, double atmospheric
 	parser->atmospheric = atmospheric;
 	parser->hydrostatic = hydrostatic;
 
+	double settings[] = {atmospheric, hydrostatic};
+	dc_parser_set_settings (abstract, settings, sizeof (settings));
+
 	return DC_STATUS_SUCCESS;
 }
 
@@ -118,6 +118,9 @@ reefnet_sensuspro_parser_set_calibration (dc_parser_t *abstract, double atmosphe
 	parser->atmospheric = atmospheric;
 	parser->hydrostatic = hydrostatic;
 
+	double settings[] = {atmospheric, hydrostatic};
+	dc_parser_set_settings (abstract, settings, sizeof (settings));
+
 	return DC_STATUS_SUCCESS;
 }
 
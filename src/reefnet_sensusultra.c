@@ -23,11 +23,14 @@
 #include <stdlib.h> // malloc, free
 #include <assert.h> // assert
 
+#include <libdivecomputer/serial.h>
+
 #include "reefnet_sensusultra.h"
 #include "context-private.h"
 #include "device-private.h"
 #include "checksum.h"
 #include "array.h"
+#include "retry.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &reefnet_sensusultra_device_vtable)
 
@@ -60,10 +63,12 @@ static const dc_device_vtable_t reefnet_sensusultra_device_vtable = {
 	DC_FAMILY_REEFNET_SENSUSULTRA,
 	reefnet_sensusultra_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	reefnet_sensusultra_device_dump, /* dump */
 	reefnet_sensusultra_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -105,6 +110,14 @@ reefnet_sensusultra_device_open (dc_device_t **out, dc_context_t *context, dc_io
 		goto error_free;
 	}
 
+	// Enable the low latency mode. This is a best effort setting, and
+	// not every serial port supports it.
+	unsigned int latency = 0;
+	status = dc_iostream_ioctl (device->iostream, DC_IOCTL_SERIAL_SET_LATENCY, &latency, sizeof(latency));
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		WARNING (context, "Failed to set the latency.");
+	}
+
 	// Make sure everything is in a sane state.
 	dc_iostream_purge (device->iostream, DC_DIRECTION_ALL);
 
@@ -314,6 +327,10 @@ reefnet_sensusultra_page (reefnet_sensusultra_device_t *device, unsigned char *d
 }
 
 
+// The delay is fixed, without backoff, because it's required by the
+// developers guide (see reefnet_sensusultra_send).
+static const dc_retry_policy_t reefnet_sensusultra_retry = {MAXRETRIES, 250, DC_DIRECTION_ALL, 0};
+
 static dc_status_t
 reefnet_sensusultra_send (reefnet_sensusultra_device_t *device, unsigned short command)
 {
@@ -321,25 +338,17 @@ reefnet_sensusultra_send (reefnet_sensusultra_device_t *device, unsigned short c
 	dc_iostream_purge (device->iostream, DC_DIRECTION_ALL);
 
 	// Wake-up the device and send the instruction code.
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &reefnet_sensusultra_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = reefnet_sensusultra_handshake (device, command)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted handshake packet,
-		// and wait for the next one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-
 		// According to the developers guide, a 250 ms delay is suggested to
 		// guarantee that the prompt byte sent after the handshake packet is
 		// not accidentally buffered by the host and (mis)interpreted as part
 		// of the next packet.
-
-		dc_iostream_sleep (device->iostream, 250);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_ALL);
+		if (!dc_retry_again (&retry, device->iostream, rc))
+			return rc;
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -0,0 +1,350 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stddef.h>
+
+#include "suunto_d9.h"
+#include "suunto_eon.h"
+#include "suunto_eonsteel.h"
+#include "suunto_solution.h"
+#include "suunto_vyper2.h"
+#include "suunto_vyper.h"
+#include "reefnet_sensus.h"
+#include "reefnet_sensuspro.h"
+#include "reefnet_sensusultra.h"
+#include "uwatec_aladin.h"
+#include "uwatec_memomouse.h"
+#include "uwatec_smart.h"
+#include "oceanic_atom2.h"
+#include "oceanic_veo250.h"
+#include "oceanic_vtpro.h"
+#include "mares_darwin.h"
+#include "mares_iconhd.h"
+#include "mares_nemo.h"
+#include "mares_puck.h"
+#include "hw_frog.h"
+#include "hw_ostc.h"
+#include "hw_ostc3.h"
+#include "cressi_edy.h"
+#include "cressi_leonardo.h"
+#include "cressi_goa.h"
+#include "zeagle_n2ition3.h"
+#include "atomics_cobalt.h"
+#include "shearwater_petrel.h"
+#include "shearwater_predator.h"
+#include "diverite_nitekq.h"
+#include "citizen_aqualand.h"
+#include "divesystem_idive.h"
+#include "cochran_commander.h"
+#include "tecdiving_divecomputereu.h"
+#include "mclean_extreme.h"
+#include "liquivision_lynx.h"
+
+#include "registry.h"
+
+#define REACTPROWHITE 0x4354
+
+/*
+ * The backends don't share a common signature for their open and create
+ * functions, because not every backend needs the model number or the
+ * clock. The macros below define the adapters to the signature of the
+ * registry.
+ */
+
+#define DEVICE_OPEN(name) \
+	static dc_status_t \
+	name##_open (dc_device_t **device, dc_context_t *context, dc_iostream_t *iostream, unsigned int model) \
+	{ \
+		return name##_device_open (device, context, iostream); \
+	}
+
+#define DEVICE_OPEN_MODEL(name) \
+	static dc_status_t \
+	name##_open (dc_device_t **device, dc_context_t *context, dc_iostream_t *iostream, unsigned int model) \
+	{ \
+		return name##_device_open (device, context, iostream, model); \
+	}
+
+#define PARSER(name) \
+	static dc_status_t \
+	name##_parser (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime) \
+	{ \
+		return name##_parser_create (parser, context); \
+	}
+
+#define PARSER_MODEL(name) \
+	static dc_status_t \
+	name##_parser (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime) \
+	{ \
+		return name##_parser_create (parser, context, model); \
+	}
+
+#define PARSER_CLOCK(name) \
+	static dc_status_t \
+	name##_parser (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime) \
+	{ \
+		return name##_parser_create (parser, context, devtime, systime); \
+	}
+
+#define PARSER_MODEL_CLOCK(name) \
+	static dc_status_t \
+	name##_parser (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime) \
+	{ \
+		return name##_parser_create (parser, context, model, devtime, systime); \
+	}
+
+#ifndef DISABLE_SUUNTO
+DEVICE_OPEN (suunto_solution)
+DEVICE_OPEN (suunto_eon)
+DEVICE_OPEN (suunto_vyper)
+DEVICE_OPEN (suunto_vyper2)
+DEVICE_OPEN_MODEL (suunto_d9)
+DEVICE_OPEN_MODEL (suunto_eonsteel)
+PARSER (suunto_solution)
+PARSER_MODEL (suunto_d9)
+PARSER_MODEL (suunto_eonsteel)
+
+static dc_status_t
+suunto_eon_parser (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime)
+{
+	return suunto_eon_parser_create (parser, context, 0);
+}
+
+static dc_status_t
+suunto_vyper_parser (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime)
+{
+	// The Spyder uses the Eon format.
+	if (model == 0x01)
+		return suunto_eon_parser_create (parser, context, 1);
+
+	return suunto_vyper_parser_create (parser, context);
+}
+#endif
+
+#ifndef DISABLE_REEFNET
+DEVICE_OPEN (reefnet_sensus)
+DEVICE_OPEN (reefnet_sensuspro)
+DEVICE_OPEN (reefnet_sensusultra)
+PARSER_CLOCK (reefnet_sensus)
+PARSER_CLOCK (reefnet_sensuspro)
+PARSER_CLOCK (reefnet_sensusultra)
+#endif
+
+#ifndef DISABLE_UWATEC
+DEVICE_OPEN (uwatec_aladin)
+DEVICE_OPEN (uwatec_memomouse)
+DEVICE_OPEN (uwatec_smart)
+PARSER_CLOCK (uwatec_memomouse)
+PARSER_MODEL_CLOCK (uwatec_smart)
+#endif
+
+#ifndef DISABLE_OCEANIC
+DEVICE_OPEN_MODEL (oceanic_vtpro)
+DEVICE_OPEN (oceanic_veo250)
+DEVICE_OPEN_MODEL (oceanic_atom2)
+PARSER_MODEL (oceanic_vtpro)
+PARSER_MODEL (oceanic_veo250)
+
+static dc_status_t
+oceanic_atom2_parser (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime)
+{
+	// The React Pro White uses the Veo 250 format.
+	if (model == REACTPROWHITE)
+		return oceanic_veo250_parser_create (parser, context, model);
+
+	return oceanic_atom2_parser_create (parser, context, model);
+}
+#endif
+
+#ifndef DISABLE_MARES
+DEVICE_OPEN (mares_nemo)
+DEVICE_OPEN (mares_puck)
+DEVICE_OPEN_MODEL (mares_darwin)
+DEVICE_OPEN (mares_iconhd)
+PARSER_MODEL (mares_nemo)
+PARSER_MODEL (mares_darwin)
+PARSER_MODEL (mares_iconhd)
+#endif
+
+#ifndef DISABLE_HW
+DEVICE_OPEN (hw_ostc)
+DEVICE_OPEN (hw_frog)
+DEVICE_OPEN (hw_ostc3)
+PARSER (hw_ostc)
+PARSER_MODEL (hw_ostc3)
+#endif
+
+#ifndef DISABLE_CRESSI
+DEVICE_OPEN (cressi_edy)
+DEVICE_OPEN (cressi_leonardo)
+DEVICE_OPEN (cressi_goa)
+PARSER_MODEL (cressi_edy)
+PARSER_MODEL (cressi_leonardo)
+PARSER_MODEL (cressi_goa)
+#endif
+
+#ifndef DISABLE_ZEAGLE
+DEVICE_OPEN (zeagle_n2ition3)
+#endif
+
+#ifndef DISABLE_ATOMICS
+DEVICE_OPEN (atomics_cobalt)
+PARSER (atomics_cobalt)
+#endif
+
+#ifndef DISABLE_SHEARWATER
+DEVICE_OPEN (shearwater_predator)
+DEVICE_OPEN (shearwater_petrel)
+PARSER_MODEL (shearwater_predator)
+PARSER_MODEL (shearwater_petrel)
+#endif
+
+#ifndef DISABLE_DIVERITE
+DEVICE_OPEN (diverite_nitekq)
+PARSER (diverite_nitekq)
+#endif
+
+#ifndef DISABLE_CITIZEN
+DEVICE_OPEN (citizen_aqualand)
+PARSER (citizen_aqualand)
+#endif
+
+#ifndef DISABLE_DIVESYSTEM
+DEVICE_OPEN_MODEL (divesystem_idive)
+PARSER_MODEL (divesystem_idive)
+#endif
+
+#ifndef DISABLE_COCHRAN
+DEVICE_OPEN (cochran_commander)
+PARSER_MODEL (cochran_commander)
+#endif
+
+#ifndef DISABLE_TECDIVING
+DEVICE_OPEN (tecdiving_divecomputereu)
+PARSER (tecdiving_divecomputereu)
+#endif
+
+#ifndef DISABLE_MCLEAN
+DEVICE_OPEN (mclean_extreme)
+PARSER (mclean_extreme)
+#endif
+
+#ifndef DISABLE_LIQUIVISION
+DEVICE_OPEN (liquivision_lynx)
+PARSER_MODEL (liquivision_lynx)
+#endif
+
+/*
+ * The table is terminated with an empty entry, which also keeps the
+ * table valid when all backends are disabled.
+ */
+static const dc_backend_t g_backends[] = {
+#ifndef DISABLE_SUUNTO
+	{DC_FAMILY_SUUNTO_SOLUTION,          suunto_solution_open,          suunto_solution_parser,           suunto_solution_extract_dives},
+	{DC_FAMILY_SUUNTO_EON,               suunto_eon_open,               suunto_eon_parser,                NULL},
+	{DC_FAMILY_SUUNTO_VYPER,             suunto_vyper_open,             suunto_vyper_parser,              NULL},
+	{DC_FAMILY_SUUNTO_VYPER2,            suunto_vyper2_open,            suunto_d9_parser,                 NULL},
+	{DC_FAMILY_SUUNTO_D9,                suunto_d9_open,                suunto_d9_parser,                 NULL},
+	{DC_FAMILY_SUUNTO_EONSTEEL,          suunto_eonsteel_open,          suunto_eonsteel_parser,           NULL},
+#endif
+#ifndef DISABLE_REEFNET
+	{DC_FAMILY_REEFNET_SENSUS,           reefnet_sensus_open,           reefnet_sensus_parser,            reefnet_sensus_extract_dives},
+	{DC_FAMILY_REEFNET_SENSUSPRO,        reefnet_sensuspro_open,        reefnet_sensuspro_parser,         reefnet_sensuspro_extract_dives},
+	{DC_FAMILY_REEFNET_SENSUSULTRA,      reefnet_sensusultra_open,      reefnet_sensusultra_parser,       NULL},
+#endif
+#ifndef DISABLE_UWATEC
+	{DC_FAMILY_UWATEC_ALADIN,            uwatec_aladin_open,            uwatec_memomouse_parser,          uwatec_aladin_extract_dives},
+	{DC_FAMILY_UWATEC_MEMOMOUSE,         uwatec_memomouse_open,         uwatec_memomouse_parser,          uwatec_memomouse_extract_dives},
+	{DC_FAMILY_UWATEC_SMART,             uwatec_smart_open,             uwatec_smart_parser,              uwatec_smart_extract_dives},
+#endif
+#ifndef DISABLE_OCEANIC
+	{DC_FAMILY_OCEANIC_VTPRO,            oceanic_vtpro_open,            oceanic_vtpro_parser,             NULL},
+	{DC_FAMILY_OCEANIC_VEO250,           oceanic_veo250_open,           oceanic_veo250_parser,            NULL},
+	{DC_FAMILY_OCEANIC_ATOM2,            oceanic_atom2_open,            oceanic_atom2_parser,             NULL},
+#endif
+#ifndef DISABLE_MARES
+	{DC_FAMILY_MARES_NEMO,               mares_nemo_open,               mares_nemo_parser,                NULL},
+	{DC_FAMILY_MARES_PUCK,               mares_puck_open,               mares_nemo_parser,                NULL},
+	{DC_FAMILY_MARES_DARWIN,             mares_darwin_open,             mares_darwin_parser,              NULL},
+	{DC_FAMILY_MARES_ICONHD,             mares_iconhd_open,             mares_iconhd_parser,              NULL},
+#endif
+#ifndef DISABLE_HW
+	{DC_FAMILY_HW_OSTC,                  hw_ostc_open,                  hw_ostc_parser,                   hw_ostc_extract_dives},
+	{DC_FAMILY_HW_FROG,                  hw_frog_open,                  hw_ostc3_parser,                  NULL},
+	{DC_FAMILY_HW_OSTC3,                 hw_ostc3_open,                 hw_ostc3_parser,                  NULL},
+#endif
+#ifndef DISABLE_CRESSI
+	{DC_FAMILY_CRESSI_EDY,               cressi_edy_open,               cressi_edy_parser,                NULL},
+	{DC_FAMILY_CRESSI_LEONARDO,          cressi_leonardo_open,          cressi_leonardo_parser,           cressi_leonardo_extract_dives},
+	{DC_FAMILY_CRESSI_GOA,               cressi_goa_open,               cressi_goa_parser,                NULL},
+#endif
+#ifndef DISABLE_ZEAGLE
+	// The N2ition3 uses the Cressi Edy format, see configure.ac.
+	{DC_FAMILY_ZEAGLE_N2ITION3,          zeagle_n2ition3_open,          cressi_edy_parser,                NULL},
+#endif
+#ifndef DISABLE_ATOMICS
+	{DC_FAMILY_ATOMICS_COBALT,           atomics_cobalt_open,           atomics_cobalt_parser,            NULL},
+#endif
+#ifndef DISABLE_SHEARWATER
+	{DC_FAMILY_SHEARWATER_PREDATOR,      shearwater_predator_open,      shearwater_predator_parser,       shearwater_predator_extract_dives},
+	{DC_FAMILY_SHEARWATER_PETREL,        shearwater_petrel_open,        shearwater_petrel_parser,         NULL},
+#endif
+#ifndef DISABLE_DIVERITE
+	{DC_FAMILY_DIVERITE_NITEKQ,          diverite_nitekq_open,          diverite_nitekq_parser,           diverite_nitekq_extract_dives},
+#endif
+#ifndef DISABLE_CITIZEN
+	{DC_FAMILY_CITIZEN_AQUALAND,         citizen_aqualand_open,         citizen_aqualand_parser,          NULL},
+#endif
+#ifndef DISABLE_DIVESYSTEM
+	{DC_FAMILY_DIVESYSTEM_IDIVE,         divesystem_idive_open,         divesystem_idive_parser,          NULL},
+#endif
+#ifndef DISABLE_COCHRAN
+	{DC_FAMILY_COCHRAN_COMMANDER,        cochran_commander_open,        cochran_commander_parser,         NULL},
+#endif
+#ifndef DISABLE_TECDIVING
+	{DC_FAMILY_TECDIVING_DIVECOMPUTEREU, tecdiving_divecomputereu_open, tecdiving_divecomputereu_parser,  NULL},
+#endif
+#ifndef DISABLE_MCLEAN
+	{DC_FAMILY_MCLEAN_EXTREME,           mclean_extreme_open,           mclean_extreme_parser,            NULL},
+#endif
+#ifndef DISABLE_LIQUIVISION
+	{DC_FAMILY_LIQUIVISION_LYNX,         liquivision_lynx_open,         liquivision_lynx_parser,          NULL},
+#endif
+	{DC_FAMILY_NULL, NULL, NULL, NULL}
+};
+
+const dc_backend_t *
+dc_backend_find (dc_family_t family)
+{
+	if (family == DC_FAMILY_NULL)
+		return NULL;
+
+	for (const dc_backend_t *backend = g_backends; backend->family != DC_FAMILY_NULL; ++backend) {
+		if (backend->family == family)
+			return backend;
+	}
+
+	return NULL;
+}
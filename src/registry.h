@@ -0,0 +1,52 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_REGISTRY_H
+#define DC_REGISTRY_H
+
+#include <libdivecomputer/device.h>
+#include <libdivecomputer/parser.h>
+#include <libdivecomputer/iostream.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The backend of a family. Backends can be left out of the build per
+ * vendor, with the --enable-backends configure option. The families of
+ * a disabled vendor have no backend, and their descriptors are hidden.
+ */
+typedef struct dc_backend_t {
+	dc_family_t family;
+	dc_status_t (*device_open) (dc_device_t **device, dc_context_t *context, dc_iostream_t *iostream, unsigned int model);
+	dc_status_t (*parser_create) (dc_parser_t **parser, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime);
+	// Extract the dives from a memory dump, or NULL if not supported.
+	dc_status_t (*extract_dives) (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
+} dc_backend_t;
+
+const dc_backend_t *
+dc_backend_find (dc_family_t family);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_REGISTRY_H */
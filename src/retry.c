@@ -0,0 +1,63 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include "retry.h"
+
+void
+dc_retry_init (dc_retry_t *retry, const dc_retry_policy_t *policy)
+{
+	retry->policy = policy;
+	retry->nretries = 0;
+	retry->delay = policy->delay;
+}
+
+int
+dc_retry_again (dc_retry_t *retry, dc_iostream_t *iostream, dc_status_t status)
+{
+	const dc_retry_policy_t *policy = retry->policy;
+
+	// Automatically discard a corrupted packet,
+	// and request a new one.
+	if (status != DC_STATUS_PROTOCOL && status != DC_STATUS_TIMEOUT)
+		return 0;
+
+	// Abort if the maximum number of retries is reached.
+	if (retry->nretries++ >= policy->maxretries)
+		return 0;
+
+	// Back off while the device doesn't respond at all.
+	if (!(policy->flags & DC_RETRY_BACKOFF)) {
+		retry->delay = policy->delay;
+	} else if (status == DC_STATUS_TIMEOUT) {
+		if (retry->nretries > 1 && retry->delay < policy->delay * DC_RETRY_MAXBACKOFF)
+			retry->delay *= 2;
+	} else {
+		retry->delay = policy->delay;
+	}
+
+	// Delay the next attempt, and discard any garbage bytes.
+	if (retry->delay)
+		dc_iostream_sleep (iostream, retry->delay);
+	if (policy->purge)
+		dc_iostream_purge (iostream, (dc_direction_t) policy->purge);
+
+	return 1;
+}
@@ -0,0 +1,76 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_RETRY_H
+#define DC_RETRY_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/iostream.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The retry policy of a request/response protocol. A failed packet is
+ * only retried for a timeout or a corrupt answer, at most maxretries
+ * times. Before every retry, the backend waits for the delay (in
+ * milliseconds), and then discards the pending data in the purge
+ * direction. A zero delay or purge direction skips that step.
+ *
+ * With the DC_RETRY_BACKOFF flag, the delay is only the initial value.
+ * After consecutive timeouts, the device is probably still busy, and the
+ * delay is doubled for every retry, up to DC_RETRY_MAXBACKOFF times the
+ * initial value. A corrupt answer shows the device is responding, and
+ * resets the delay. Without the flag, the delay is fixed, for protocols
+ * that mandate it.
+ */
+typedef struct dc_retry_policy_t {
+	unsigned int maxretries;
+	unsigned int delay;
+	unsigned int purge;
+	unsigned int flags;
+} dc_retry_policy_t;
+
+#define DC_RETRY_BACKOFF 0x01
+
+#define DC_RETRY_MAXBACKOFF 8
+
+typedef struct dc_retry_t {
+	const dc_retry_policy_t *policy;
+	unsigned int nretries;
+	unsigned int delay;
+} dc_retry_t;
+
+void
+dc_retry_init (dc_retry_t *retry, const dc_retry_policy_t *policy);
+
+/*
+ * Returns non-zero if the packet that failed with the status should be
+ * sent again, after the delay and the purge of the policy.
+ */
+int
+dc_retry_again (dc_retry_t *retry, dc_iostream_t *iostream, dc_status_t status);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_RETRY_H */
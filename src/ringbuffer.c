@@ -19,15 +19,26 @@
  * MA 02110-1301 USA
  */
 
+#include <string.h> // memcpy
 #include <assert.h>
 
 #include "ringbuffer.h"
 
 
+/*
+ * The arguments are almost always within one wrap of the ringbuffer, so
+ * a single conditional subtraction replaces the division. The modulo is
+ * only needed for the rare larger values.
+ */
 static unsigned int
 normalize (unsigned int a, unsigned int size)
 {
-	return a % size;
+	if (a < size)
+		return a;
+	else if (a - size < size)
+		return a - size;
+	else
+		return a % size;
 }
 
 
@@ -35,9 +46,9 @@ static unsigned int
 distance (unsigned int a, unsigned int b, int mode, unsigned int size)
 {
 	if (a < b) {
-		return (b - a) % size;
+		return normalize (b - a, size);
 	} else if (a > b) {
-		return size - (a - b) % size;
+		return size - normalize (a - b, size);
 	} else {
 		return (mode == 0 ? 0 : size);
 	}
@@ -47,7 +58,10 @@ distance (unsigned int a, unsigned int b, int mode, unsigned int size)
 static unsigned int
 increment (unsigned int a, unsigned int delta, unsigned int size)
 {
-	return (a + delta) % size;
+	if (delta < size && a < size)
+		return normalize (a + delta, size);
+	else
+		return (a + delta) % size;
 }
 
 
@@ -55,9 +69,9 @@ static unsigned int
 decrement (unsigned int a, unsigned int delta, unsigned int size)
 {
 	if (delta <= a) {
-		return (a - delta) % size;
+		return normalize (a - delta, size);
 	} else {
-		return size - (delta - a) % size;
+		return size - normalize (delta - a, size);
 	}
 }
 
@@ -100,3 +114,35 @@ ringbuffer_decrement (unsigned int a, unsigned int delta, unsigned int begin, un
 
 	return decrement (a - begin, delta, end - begin) + begin;
 }
+
+
+void
+ringbuffer_copy (unsigned char out[], const unsigned char data[], unsigned int a, unsigned int size, unsigned int begin, unsigned int end)
+{
+	assert (end >= begin);
+	assert (a >= begin && a <= end);
+	assert (size <= end - begin);
+
+	unsigned int len = end - a;
+	if (len > size)
+		len = size;
+
+	memcpy (out, data + a, len);
+	memcpy (out + len, data + begin, size - len);
+}
+
+
+const unsigned char *
+ringbuffer_view (unsigned char scratch[], const unsigned char data[], unsigned int a, unsigned int size, unsigned int begin, unsigned int end)
+{
+	assert (end >= begin);
+	assert (a >= begin && a <= end);
+	assert (size <= end - begin);
+
+	if (size <= end - a)
+		return data + a;
+
+	ringbuffer_copy (scratch, data, a, size, begin, end);
+
+	return scratch;
+}
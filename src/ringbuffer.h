@@ -38,6 +38,22 @@ ringbuffer_increment (unsigned int a, unsigned int delta, unsigned int begin, un
 unsigned int
 ringbuffer_decrement (unsigned int a, unsigned int delta, unsigned int begin, unsigned int end);
 
+/*
+ * Copy size bytes, starting at address a, out of the ringbuffer of a
+ * memory image into a linear buffer, wrapping around at the end.
+ */
+void
+ringbuffer_copy (unsigned char out[], const unsigned char data[], unsigned int a, unsigned int size, unsigned int begin, unsigned int end);
+
+/*
+ * Get a linear view of size bytes, starting at address a, in the
+ * ringbuffer of a memory image. The view points directly into the image,
+ * unless the data wraps around, in which case it is copied to the
+ * scratch buffer first.
+ */
+const unsigned char *
+ringbuffer_view (unsigned char scratch[], const unsigned char data[], unsigned int a, unsigned int size, unsigned int begin, unsigned int end);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -30,7 +30,7 @@
 #include <fcntl.h>	// fcntl
 #include <termios.h>	// tcgetattr, tcsetattr, cfsetispeed, cfsetospeed, tcflush, tcsendbreak
 #include <sys/ioctl.h>	// ioctl
-#include <time.h>	// nanosleep
+#include <poll.h>	// poll
 #ifdef HAVE_LINUX_SERIAL_H
 #include <linux/serial.h>
 #endif
@@ -41,6 +41,10 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <fnmatch.h>
+#ifdef __linux__
+#include <limits.h>	// PATH_MAX
+#include <libgen.h>	// basename
+#endif
 
 #ifndef TIOCINQ
 #define TIOCINQ FIONREAD
@@ -52,6 +56,9 @@
 #define NOPTY 1
 #endif
 
+// The wait was interrupted with dc_iostream_interrupt.
+#define INTERRUPTED -2
+
 #include <libdivecomputer/serial.h>
 
 #include "common-private.h"
@@ -60,6 +67,7 @@
 #include "iterator-private.h"
 #include "descriptor-private.h"
 #include "timer.h"
+#include "poller.h"
 
 #define DIRNAME "/dev"
 
@@ -74,12 +82,14 @@ static dc_status_t dc_serial_get_lines (dc_iostream_t *iostream, unsigned int *v
 static dc_status_t dc_serial_get_available (dc_iostream_t *iostream, size_t *value);
 static dc_status_t dc_serial_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
 static dc_status_t dc_serial_poll (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_serial_get_fd (dc_iostream_t *iostream, int *fd);
 static dc_status_t dc_serial_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 static dc_status_t dc_serial_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 static dc_status_t dc_serial_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
 static dc_status_t dc_serial_flush (dc_iostream_t *iostream);
 static dc_status_t dc_serial_purge (dc_iostream_t *iostream, dc_direction_t direction);
 static dc_status_t dc_serial_sleep (dc_iostream_t *iostream, unsigned int milliseconds);
+static dc_status_t dc_serial_interrupt (dc_iostream_t *iostream);
 static dc_status_t dc_serial_close (dc_iostream_t *iostream);
 
 struct dc_serial_device_t {
@@ -100,12 +110,33 @@ typedef struct dc_serial_t {
 	int fd;
 	int timeout;
 	dc_timer_t *timer;
+	/*
+	 * The poller used to wait for the file descriptor, and the
+	 * events it is currently registered for.
+	 */
+	dc_poller_t *poller;
+	unsigned int events;
+	/*
+	 * The pipe used to interrupt the waits from another thread. It is
+	 * registered with the poller, and becomes readable permanently
+	 * once the I/O stream is interrupted.
+	 */
+	int wakeup[2];
 	/*
 	 * Serial port settings are saved into this variable immediately
 	 * after the port is opened. These settings are restored when the
 	 * serial port is closed.
 	 */
 	struct termios tty;
+#ifdef __linux__
+	/*
+	 * The sysfs attribute with the latency timer of USB serial
+	 * converters (e.g. FTDI), and its original value. The original
+	 * value is restored when the serial port is closed.
+	 */
+	char latency_timer[PATH_MAX];
+	int latency_orig;
+#endif
 } dc_serial_t;
 
 static const dc_iterator_vtable_t dc_serial_iterator_vtable = {
@@ -124,12 +155,16 @@ static const dc_iostream_vtable_t dc_serial_vtable = {
 	dc_serial_get_available, /* get_available */
 	dc_serial_configure, /* configure */
 	dc_serial_poll, /* poll */
+	dc_serial_get_fd, /* get_fd */
 	dc_serial_read, /* read */
+	NULL, /* read_lend */
+	NULL, /* read_return */
 	dc_serial_write, /* write */
 	dc_serial_ioctl, /* ioctl */
 	dc_serial_flush, /* flush */
 	dc_serial_purge, /* purge */
 	dc_serial_sleep, /* sleep */
+	dc_serial_interrupt, /* interrupt */
 	dc_serial_close, /* close */
 };
 
@@ -282,6 +317,21 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 	// Default to blocking reads.
 	device->timeout = -1;
 
+#ifdef __linux__
+	// Locate the latency timer attribute of the tty device. Symbolic
+	// links (e.g. /dev/serial/by-id) are resolved to the real device
+	// node first, because the sysfs entry uses the kernel name.
+	char path[PATH_MAX];
+	device->latency_timer[0] = '\0';
+	device->latency_orig = -1;
+	if (realpath (name, path) != NULL) {
+		int n = snprintf (device->latency_timer, sizeof (device->latency_timer),
+			"/sys/class/tty/%s/device/latency_timer", basename (path));
+		if (n < 0 || (size_t) n >= sizeof (device->latency_timer))
+			device->latency_timer[0] = '\0';
+	}
+#endif
+
 	// Create a high resolution timer.
 	status = dc_timer_new (&device->timer);
 	if (status != DC_STATUS_SUCCESS) {
@@ -299,13 +349,49 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 		goto error_timer_free;
 	}
 
+	// Register the file descriptor for reading.
+	if (dc_poller_new (&device->poller) != 0) {
+		int errcode = errno;
+		SYSERROR (context, errcode);
+		status = syserror (errcode);
+		goto error_close;
+	}
+
+	device->events = DC_POLLER_READ;
+	if (dc_poller_add (device->poller, device->fd, device->events, device) != 0) {
+		int errcode = errno;
+		SYSERROR (context, errcode);
+		status = syserror (errcode);
+		goto error_poller_free;
+	}
+
+	// Create the pipe to interrupt the waits.
+	if (pipe (device->wakeup) != 0) {
+		int errcode = errno;
+		SYSERROR (context, errcode);
+		status = syserror (errcode);
+		goto error_poller_free;
+	}
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		fcntl (device->wakeup[i], F_SETFL, fcntl (device->wakeup[i], F_GETFL) | O_NONBLOCK);
+		fcntl (device->wakeup[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	if (dc_poller_add (device->poller, device->wakeup[0], DC_POLLER_READ, device->wakeup) != 0) {
+		int errcode = errno;
+		SYSERROR (context, errcode);
+		status = syserror (errcode);
+		goto error_pipe_close;
+	}
+
 #ifndef ENABLE_PTY
 	// Enable exclusive access mode.
 	if (ioctl (device->fd, TIOCEXCL, NULL) != 0) {
 		int errcode = errno;
 		SYSERROR (context, errcode);
 		status = syserror (errcode);
-		goto error_close;
+		goto error_pipe_close;
 	}
 #endif
 
@@ -317,13 +403,18 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 		int errcode = errno;
 		SYSERROR (context, errcode);
 		status = syserror (errcode);
-		goto error_close;
+		goto error_pipe_close;
 	}
 
 	*out = (dc_iostream_t *) device;
 
 	return DC_STATUS_SUCCESS;
 
+error_pipe_close:
+	close (device->wakeup[0]);
+	close (device->wakeup[1]);
+error_poller_free:
+	dc_poller_free (device->poller);
 error_close:
 	close (device->fd);
 error_timer_free:
@@ -333,6 +424,51 @@ error_free:
 	return status;
 }
 
+#ifdef __linux__
+static int
+dc_serial_read_latency_timer (dc_serial_t *device)
+{
+	int value = -1;
+
+	if (device->latency_timer[0] == '\0')
+		return -1;
+
+	FILE *fp = fopen (device->latency_timer, "r");
+	if (fp == NULL)
+		return -1;
+
+	if (fscanf (fp, "%d", &value) != 1)
+		value = -1;
+
+	fclose (fp);
+
+	return value;
+}
+
+static int
+dc_serial_write_latency_timer (dc_serial_t *device, int value)
+{
+	dc_context_t *context = device->base.context;
+
+	if (device->latency_timer[0] == '\0')
+		return -1;
+
+	FILE *fp = fopen (device->latency_timer, "w");
+	if (fp == NULL) {
+		DEBUG (context, "Failed to open the latency timer: %s (%s).", device->latency_timer, strerror (errno));
+		return -1;
+	}
+
+	int rc = fprintf (fp, "%d", value);
+	if (fclose (fp) != 0 || rc < 0) {
+		DEBUG (context, "Failed to write the latency timer: %s (%s).", device->latency_timer, strerror (errno));
+		return -1;
+	}
+
+	return 0;
+}
+#endif
+
 static dc_status_t
 dc_serial_close (dc_iostream_t *abstract)
 {
@@ -355,6 +491,17 @@ dc_serial_close (dc_iostream_t *abstract)
 	}
 #endif
 
+#ifdef __linux__
+	// Restore the original latency timer.
+	if (device->latency_orig >= 0) {
+		dc_serial_write_latency_timer (device, device->latency_orig);
+	}
+#endif
+
+	dc_poller_free (device->poller);
+	close (device->wakeup[0]);
+	close (device->wakeup[1]);
+
 	// Close the device.
 	if (close (device->fd) != 0) {
 		int errcode = errno;
@@ -662,35 +809,99 @@ dc_serial_set_latency (dc_iostream_t *abstract, unsigned int milliseconds)
 	}
 #endif
 
+#ifdef __linux__
+	// USB serial converters (e.g. FTDI) buffer the received data until
+	// their latency timer expires (16 ms by default), regardless of the
+	// low latency flag. The timer is only available through sysfs, and
+	// writing it usually requires extra permissions. Failures are not
+	// fatal, because not every serial port has a latency timer.
+	int orig = dc_serial_read_latency_timer (device);
+	if (orig >= 0) {
+		int value = milliseconds;
+		if (value < 1)
+			value = 1;
+		else if (value > 255)
+			value = 255;
+		if (value != orig) {
+			if (dc_serial_write_latency_timer (device, value) == 0) {
+				if (device->latency_orig < 0)
+					device->latency_orig = orig;
+				DEBUG (abstract->context, "Latency timer: %i ms (was %i ms).", value, orig);
+			} else {
+				INFO (abstract->context, "Failed to change the latency timer.");
+			}
+		}
+	}
+#endif
+
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Wait until the file descriptor is ready for the requested events, for
+ * at most timeout milliseconds (or forever for a negative timeout).
+ * Returns a positive value if ready, zero on timeout or interruption,
+ * and -1 on error with errno set.
+ */
+static int
+dc_serial_wait (dc_serial_t *device, unsigned int events, int timeout)
+{
+	if (device->events != events) {
+		if (dc_poller_modify (device->poller, device->fd, events, device) != 0)
+			return -1;
+		device->events = events;
+	}
+
+	dc_poller_event_t ready[2];
+	int rc = dc_poller_wait (device->poller, ready, 2, timeout);
+	for (int i = 0; i < rc; ++i) {
+		if (ready[i].userdata == device->wakeup)
+			return INTERRUPTED;
+	}
+
+	return rc;
+}
+
 static dc_status_t
 dc_serial_poll (dc_iostream_t *abstract, int timeout)
 {
 	dc_serial_t *device = (dc_serial_t *) abstract;
 	int rc = 0;
 
-	do {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (device->fd, &fds);
+	// The absolute target time.
+	dc_usecs_t target = 0;
+	if (timeout > 0) {
+		dc_usecs_t now = 0;
+		dc_status_t status = dc_timer_now (device->timer, &now);
+		if (status != DC_STATUS_SUCCESS) {
+			return status;
+		}
+		target = now + (dc_usecs_t) timeout * 1000;
+	}
 
-		struct timeval tv, *ptv = NULL;
-		if (timeout > 0) {
-			tv.tv_sec  = (timeout / 1000);
-			tv.tv_usec = (timeout % 1000) * 1000;
-			ptv = &tv;
-		} else if (timeout == 0) {
-			tv.tv_sec  = 0;
-			tv.tv_usec = 0;
-			ptv = &tv;
+	while (1) {
+		rc = dc_serial_wait (device, DC_POLLER_READ, timeout);
+		if (rc != 0 || timeout == 0) {
+			break;
 		}
 
-		rc = select (device->fd + 1, &fds, NULL, NULL, ptv);
-	} while (rc < 0 && errno == EINTR);
+		// Recalculate the remaining timeout after an interruption.
+		if (timeout > 0) {
+			dc_usecs_t now = 0;
+			dc_status_t status = dc_timer_now (device->timer, &now);
+			if (status != DC_STATUS_SUCCESS) {
+				return status;
+			}
+			if (now >= target) {
+				break;
+			}
+			timeout = (target - now + 999) / 1000;
+		}
+	}
 
-	if (rc < 0) {
+	if (rc == INTERRUPTED) {
+		return DC_STATUS_CANCELLED;
+	} else if (rc < 0) {
 		int errcode = errno;
 		SYSERROR (abstract->context, errcode);
 		return syserror (errcode);
@@ -701,6 +912,16 @@ dc_serial_poll (dc_iostream_t *abstract, int timeout)
 	}
 }
 
+static dc_status_t
+dc_serial_get_fd (dc_iostream_t *abstract, int *fd)
+{
+	dc_serial_t *device = (dc_serial_t *) abstract;
+
+	*fd = device->fd;
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dc_serial_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 {
@@ -713,13 +934,9 @@ dc_serial_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 
 	int init = 1;
 	while (nbytes < size) {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (device->fd, &fds);
-
-		struct timeval tv, *ptv = NULL;
+		int timeout = -1;
 		if (device->timeout > 0) {
-			dc_usecs_t timeout = 0;
+			dc_usecs_t remaining = 0;
 
 			dc_usecs_t now = 0;
 			status = dc_timer_now (device->timer, &now);
@@ -729,36 +946,40 @@ dc_serial_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 
 			if (init) {
 				// Calculate the initial timeout.
-				timeout = (dc_usecs_t) device->timeout * 1000;
+				remaining = (dc_usecs_t) device->timeout * 1000;
 				// Calculate the target time.
-				target = now + timeout;
+				target = now + remaining;
 				init = 0;
 			} else {
 				// Calculate the remaining timeout.
 				if (now < target) {
-					timeout = target - now;
+					remaining = target - now;
 				} else {
-					timeout = 0;
+					remaining = 0;
 				}
 			}
-			tv.tv_sec  = timeout / 1000000;
-			tv.tv_usec = timeout % 1000000;
-			ptv = &tv;
+			// Round up to whole milliseconds, to avoid waking up
+			// just before the target time.
+			timeout = (remaining + 999) / 1000;
 		} else if (device->timeout == 0) {
-			tv.tv_sec  = 0;
-			tv.tv_usec = 0;
-			ptv = &tv;
+			timeout = 0;
 		}
 
-		int rc = select (device->fd + 1, &fds, NULL, NULL, ptv);
-		if (rc < 0) {
+		int rc = dc_serial_wait (device, DC_POLLER_READ, timeout);
+		if (rc == INTERRUPTED) {
+			status = DC_STATUS_CANCELLED;
+			goto out;
+		} else if (rc < 0) {
 			int errcode = errno;
-			if (errcode == EINTR)
-				continue; // Retry.
 			SYSERROR (abstract->context, errcode);
 			status = syserror (errcode);
 			goto out;
 		} else if (rc == 0) {
+			// Without a timeout, or with some time remaining, the wait
+			// was interrupted. Otherwise the next iteration performs
+			// a final non-blocking check.
+			if (timeout != 0)
+				continue; // Retry.
 			break; // Timeout.
 		}
 
@@ -796,20 +1017,17 @@ dc_serial_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 	size_t nbytes = 0;
 
 	while (nbytes < size) {
-		fd_set fds;
-		FD_ZERO (&fds);
-		FD_SET (device->fd, &fds);
-
-		int rc = select (device->fd + 1, NULL, &fds, NULL, NULL);
-		if (rc < 0) {
+		int rc = dc_serial_wait (device, DC_POLLER_WRITE, -1);
+		if (rc == INTERRUPTED) {
+			status = DC_STATUS_CANCELLED;
+			goto out;
+		} else if (rc < 0) {
 			int errcode = errno;
-			if (errcode == EINTR)
-				continue; // Retry.
 			SYSERROR (abstract->context, errcode);
 			status = syserror (errcode);
 			goto out;
 		} else if (rc == 0) {
-			break; // Timeout.
+			continue; // Retry.
 		}
 
 		ssize_t n = write (device->fd, (const char *) data + nbytes, size - nbytes);
@@ -995,16 +1213,51 @@ dc_serial_get_lines (dc_iostream_t *abstract, unsigned int *value)
 static dc_status_t
 dc_serial_sleep (dc_iostream_t *abstract, unsigned int timeout)
 {
-	struct timespec ts;
-	ts.tv_sec  = (timeout / 1000);
-	ts.tv_nsec = (timeout % 1000) * 1000000;
+	dc_serial_t *device = (dc_serial_t *) abstract;
 
-	while (nanosleep (&ts, &ts) != 0) {
-		int errcode = errno;
-		if (errcode != EINTR ) {
+	// The absolute target time.
+	dc_usecs_t now = 0, target = 0;
+	dc_status_t status = dc_timer_now (device->timer, &now);
+	if (status != DC_STATUS_SUCCESS) {
+		return status;
+	}
+	target = now + (dc_usecs_t) timeout * 1000;
+
+	// Sleep by waiting for the wakeup pipe only.
+	while (1) {
+		struct pollfd pfd = {device->wakeup[0], POLLIN, 0};
+		int rc = poll (&pfd, 1, (target - now + 999) / 1000);
+		if (rc > 0) {
+			return DC_STATUS_CANCELLED;
+		} else if (rc < 0 && errno != EINTR) {
+			int errcode = errno;
 			SYSERROR (abstract->context, errcode);
 			return syserror (errcode);
 		}
+
+		status = dc_timer_now (device->timer, &now);
+		if (status != DC_STATUS_SUCCESS) {
+			return status;
+		}
+		if (now >= target) {
+			break;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_serial_interrupt (dc_iostream_t *abstract)
+{
+	dc_serial_t *device = (dc_serial_t *) abstract;
+	const unsigned char byte = 0;
+
+	// The pipe is never drained, so a full pipe is fine.
+	if (write (device->wakeup[1], &byte, 1) != 1 && errno != EAGAIN) {
+		int errcode = errno;
+		SYSERROR (abstract->context, errcode);
+		return syserror (errcode);
 	}
 
 	return DC_STATUS_SUCCESS;
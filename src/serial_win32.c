@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #define WIN32_LEAN_AND_MEAN
 #define NOGDI
@@ -32,6 +33,15 @@
 #include "iostream-private.h"
 #include "iterator-private.h"
 #include "descriptor-private.h"
+#include "timer.h"
+
+#define SZ_BUFFER 4096
+
+/*
+ * The background reads complete as soon as some data has arrived, or
+ * without data after this timeout (in milliseconds).
+ */
+#define READAHEAD 1000
 
 static dc_status_t dc_serial_iterator_next (dc_iterator_t *iterator, void *item);
 static dc_status_t dc_serial_iterator_free (dc_iterator_t *iterator);
@@ -78,10 +88,20 @@ typedef struct dc_serial_t {
 	DCB dcb;
 	COMMTIMEOUTS timeouts;
 
-	HANDLE hReadWrite, hPoll;
+	dc_timer_t *timer;
+	int timeout;
+
+	HANDLE hRead, hWrite;
+	/*
+	 * A read is kept posted in the background, into the free space of
+	 * the receive buffer, such that the data is received while the
+	 * caller is busy with other things. The unread data is stored
+	 * between the begin and end offsets.
+	 */
 	OVERLAPPED overlapped;
-	DWORD events;
 	BOOL pending;
+	size_t begin, end;
+	unsigned char buffer[SZ_BUFFER];
 } dc_serial_t;
 
 static const dc_iterator_vtable_t dc_serial_iterator_vtable = {
@@ -100,12 +120,16 @@ static const dc_iostream_vtable_t dc_serial_vtable = {
 	dc_serial_get_available, /* get_available */
 	dc_serial_configure, /* configure */
 	dc_serial_poll, /* poll */
+	NULL, /* get_fd */
 	dc_serial_read, /* read */
+	NULL, /* read_lend */
+	NULL, /* read_return */
 	dc_serial_write, /* write */
 	dc_serial_ioctl, /* ioctl */
 	dc_serial_flush, /* flush */
 	dc_serial_purge, /* purge */
 	dc_serial_sleep, /* sleep */
+	NULL, /* interrupt */
 	dc_serial_close, /* close */
 };
 
@@ -259,6 +283,130 @@ dc_serial_iterator_free (dc_iterator_t *abstract)
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Post a background read into the free space of the receive buffer,
+ * unless one is already pending.
+ */
+static dc_status_t
+dc_serial_post (dc_serial_t *device)
+{
+	if (device->pending)
+		return DC_STATUS_SUCCESS;
+
+	// Make room for more data.
+	if (device->begin == device->end) {
+		device->begin = device->end = 0;
+	} else if (device->end == sizeof (device->buffer)) {
+		memmove (device->buffer, device->buffer + device->begin, device->end - device->begin);
+		device->end -= device->begin;
+		device->begin = 0;
+	}
+
+	if (device->end == sizeof (device->buffer))
+		return DC_STATUS_SUCCESS;
+
+	memset (&device->overlapped, 0, sizeof (device->overlapped));
+	device->overlapped.hEvent = device->hRead;
+	if (!ReadFile (device->hFile, device->buffer + device->end, sizeof (device->buffer) - device->end, NULL, &device->overlapped)) {
+		DWORD errcode = GetLastError ();
+		if (errcode != ERROR_IO_PENDING) {
+			SYSERROR (device->base.context, errcode);
+			return syserror (errcode);
+		}
+	}
+
+	device->pending = TRUE;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Wait at most timeout milliseconds (or forever for a negative timeout)
+ * for the background read, and add its data to the receive buffer.
+ */
+static dc_status_t
+dc_serial_complete (dc_serial_t *device, int timeout)
+{
+	if (!device->pending)
+		return DC_STATUS_SUCCESS;
+
+	DWORD errcode = 0;
+	DWORD rc = WaitForSingleObject (device->hRead, timeout >= 0 ? (DWORD) timeout : INFINITE);
+	switch (rc) {
+	case WAIT_OBJECT_0:
+		break;
+	case WAIT_TIMEOUT:
+		return DC_STATUS_TIMEOUT;
+	default:
+		errcode = GetLastError ();
+		SYSERROR (device->base.context, errcode);
+		return syserror (errcode);
+	}
+
+	DWORD dwRead = 0;
+	BOOL success = GetOverlappedResult (device->hFile, &device->overlapped, &dwRead, FALSE);
+	device->pending = FALSE;
+	if (!success) {
+		errcode = GetLastError ();
+		if (errcode == ERROR_OPERATION_ABORTED)
+			return DC_STATUS_SUCCESS;
+		SYSERROR (device->base.context, errcode);
+		return syserror (errcode);
+	}
+
+	device->end += dwRead;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Abort the background read, and wait until the buffer is released.
+ */
+static void
+dc_serial_cancel (dc_serial_t *device)
+{
+	if (!device->pending)
+		return;
+
+	CancelIo (device->hFile);
+
+	DWORD dwRead = 0;
+	if (GetOverlappedResult (device->hFile, &device->overlapped, &dwRead, TRUE))
+		device->end += dwRead;
+
+	device->pending = FALSE;
+}
+
+/*
+ * Get the remaining time (in milliseconds) until the target time, which
+ * is initialized on the first call. A negative or zero timeout is
+ * returned unchanged.
+ */
+static dc_status_t
+dc_serial_remaining (dc_serial_t *device, int timeout, dc_usecs_t *target, int *init, int *remaining)
+{
+	if (timeout <= 0) {
+		*remaining = timeout;
+		return DC_STATUS_SUCCESS;
+	}
+
+	dc_usecs_t now = 0;
+	dc_status_t status = dc_timer_now (device->timer, &now);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (*init) {
+		*target = now + (dc_usecs_t) timeout * 1000;
+		*init = 0;
+	}
+
+	// Round up to whole milliseconds, to avoid waking up just before
+	// the target time.
+	*remaining = now < *target ? (int) ((*target - now + 999) / 1000) : 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 {
@@ -292,25 +440,34 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 
 	// Default values.
 	memset(&device->overlapped, 0, sizeof(device->overlapped));
-	device->events = 0;
 	device->pending = FALSE;
+	device->begin = 0;
+	device->end = 0;
+	device->timeout = -1;
+
+	// Create a high resolution timer.
+	status = dc_timer_new (&device->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_free;
+	}
 
-	// Create a manual reset event for I/O.
-	device->hReadWrite = CreateEvent (NULL, TRUE, FALSE, NULL);
-	if (device->hReadWrite == INVALID_HANDLE_VALUE) {
+	// Create a manual reset event for reading.
+	device->hRead = CreateEvent (NULL, TRUE, FALSE, NULL);
+	if (device->hRead == NULL) {
 		DWORD errcode = GetLastError ();
 		SYSERROR (context, errcode);
 		status = syserror (errcode);
-		goto error_free;
+		goto error_timer_free;
 	}
 
-	// Create a manual reset event for polling.
-	device->hPoll = CreateEvent (NULL, TRUE, FALSE, NULL);
-	if (device->hPoll == INVALID_HANDLE_VALUE) {
+	// Create a manual reset event for writing.
+	device->hWrite = CreateEvent (NULL, TRUE, FALSE, NULL);
+	if (device->hWrite == NULL) {
 		DWORD errcode = GetLastError ();
 		SYSERROR (context, errcode);
 		status = syserror (errcode);
-		goto error_free_readwrite;
+		goto error_free_read;
 	}
 
 	// Open the device.
@@ -324,7 +481,7 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 		DWORD errcode = GetLastError ();
 		SYSERROR (context, errcode);
 		status = syserror (errcode);
-		goto error_free_poll;
+		goto error_free_write;
 	}
 
 	// Retrieve the current communication settings and timeouts,
@@ -339,8 +496,15 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 		goto error_close;
 	}
 
-	// Enable event monitoring.
-	if (!SetCommMask (device->hFile, EV_RXCHAR)) {
+	// The background reads return as soon as some data is available,
+	// and the timeouts are applied while waiting for them.
+	COMMTIMEOUTS timeouts;
+	timeouts.ReadIntervalTimeout = MAXDWORD;
+	timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+	timeouts.ReadTotalTimeoutConstant = READAHEAD;
+	timeouts.WriteTotalTimeoutMultiplier = 0;
+	timeouts.WriteTotalTimeoutConstant = 0;
+	if (!SetCommTimeouts (device->hFile, &timeouts)) {
 		DWORD errcode = GetLastError ();
 		SYSERROR (context, errcode);
 		status = syserror (errcode);
@@ -353,10 +517,12 @@ dc_serial_open (dc_iostream_t **out, dc_context_t *context, const char *name)
 
 error_close:
 	CloseHandle (device->hFile);
-error_free_poll:
-	CloseHandle (device->hPoll);
-error_free_readwrite:
-	CloseHandle (device->hReadWrite);
+error_free_write:
+	CloseHandle (device->hWrite);
+error_free_read:
+	CloseHandle (device->hRead);
+error_timer_free:
+	dc_timer_free (device->timer);
 error_free:
 	dc_iostream_deallocate ((dc_iostream_t *) device);
 	return status;
@@ -368,8 +534,8 @@ dc_serial_close (dc_iostream_t *abstract)
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_serial_t *device = (dc_serial_t *) abstract;
 
-	// Disable event monitoring.
-	SetCommMask (device->hFile, 0);
+	// Abort the background read.
+	dc_serial_cancel (device);
 
 	// Restore the initial communication settings and timeouts.
 	if (!SetCommState (device->hFile, &device->dcb) ||
@@ -386,8 +552,9 @@ dc_serial_close (dc_iostream_t *abstract)
 		dc_status_set_error(&status, syserror (errcode));
 	}
 
-	CloseHandle (device->hPoll);
-	CloseHandle (device->hReadWrite);
+	CloseHandle (device->hWrite);
+	CloseHandle (device->hRead);
+	dc_timer_free (device->timer);
 
 	return status;
 }
@@ -503,44 +670,7 @@ dc_serial_set_timeout (dc_iostream_t *abstract, int timeout)
 {
 	dc_serial_t *device = (dc_serial_t *) abstract;
 
-	// Retrieve the current timeouts.
-	COMMTIMEOUTS timeouts;
-	if (!GetCommTimeouts (device->hFile, &timeouts)) {
-		DWORD errcode = GetLastError ();
-		SYSERROR (abstract->context, errcode);
-		return syserror (errcode);
-	}
-
-	// Update the settings.
-	if (timeout < 0) {
-		// Blocking mode.
-		timeouts.ReadIntervalTimeout = 0;
-		timeouts.ReadTotalTimeoutMultiplier = 0;
-		timeouts.ReadTotalTimeoutConstant = 0;
-		timeouts.WriteTotalTimeoutMultiplier = 0;
-		timeouts.WriteTotalTimeoutConstant = 0;
-	} else if (timeout == 0) {
-		// Non-blocking mode.
-		timeouts.ReadIntervalTimeout = MAXDWORD;
-		timeouts.ReadTotalTimeoutMultiplier = 0;
-		timeouts.ReadTotalTimeoutConstant = 0;
-		timeouts.WriteTotalTimeoutMultiplier = 0;
-		timeouts.WriteTotalTimeoutConstant = 0;
-	} else {
-		// Standard timeout mode.
-		timeouts.ReadIntervalTimeout = 0;
-		timeouts.ReadTotalTimeoutMultiplier = 0;
-		timeouts.ReadTotalTimeoutConstant = timeout;
-		timeouts.WriteTotalTimeoutMultiplier = 0;
-		timeouts.WriteTotalTimeoutConstant = 0;
-	}
-
-	// Activate the new timeouts.
-	if (!SetCommTimeouts (device->hFile, &timeouts)) {
-		DWORD errcode = GetLastError ();
-		SYSERROR (abstract->context, errcode);
-		return syserror (errcode);
-	}
+	device->timeout = timeout;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -548,56 +678,25 @@ dc_serial_set_timeout (dc_iostream_t *abstract, int timeout)
 static dc_status_t
 dc_serial_poll (dc_iostream_t *abstract, int timeout)
 {
+	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_serial_t *device = (dc_serial_t *) abstract;
 
-	while (1) {
-		COMSTAT stats;
-		if (!ClearCommError (device->hFile, NULL, &stats)) {
-			DWORD errcode = GetLastError ();
-			SYSERROR (abstract->context, errcode);
-			return syserror (errcode);
-		}
-
-		if (stats.cbInQue)
-			break;
-
-		if (!device->pending) {
-			memset(&device->overlapped, 0, sizeof(device->overlapped));
-			device->overlapped.hEvent = device->hPoll;
-			device->events = 0;
-			if (!WaitCommEvent (device->hFile, &device->events, &device->overlapped)) {
-				DWORD errcode = GetLastError ();
-				if (errcode != ERROR_IO_PENDING) {
-					SYSERROR (abstract->context, errcode);
-					return syserror (errcode);
-				}
-				device->pending = TRUE;
-			}
-		}
-
-		if (device->pending) {
-			DWORD errcode = 0;
-			DWORD rc = WaitForSingleObject (device->hPoll, timeout >= 0 ? (DWORD) timeout : INFINITE);
-			switch (rc) {
-			case WAIT_OBJECT_0:
-				break;
-			case WAIT_TIMEOUT:
-				return DC_STATUS_TIMEOUT;
-			default:
-				errcode = GetLastError ();
-				SYSERROR (abstract->context, errcode);
-				return syserror (errcode);
-			}
-		}
+	dc_usecs_t target = 0;
+	int init = 1;
+	while (device->begin == device->end) {
+		status = dc_serial_post (device);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
 
-		DWORD dummy = 0;
-		if (!GetOverlappedResult (device->hFile, &device->overlapped, &dummy, TRUE)) {
-			DWORD errcode = GetLastError ();
-			SYSERROR (abstract->context, errcode);
-			return syserror (errcode);
-		}
+		int remaining = 0;
+		status = dc_serial_remaining (device, timeout, &target, &init, &remaining);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
 
-		device->pending = FALSE;
+		// A background read can complete without any data.
+		status = dc_serial_complete (device, remaining);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -608,34 +707,52 @@ dc_serial_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_serial_t *device = (dc_serial_t *) abstract;
-	DWORD dwRead = 0;
+	size_t nbytes = 0;
 
-	OVERLAPPED overlapped = {0};
-	overlapped.hEvent = device->hReadWrite;
+	dc_usecs_t target = 0;
+	int init = 1;
+	while (1) {
+		// Take the data from the receive buffer.
+		size_t n = device->end - device->begin;
+		if (n > size - nbytes)
+			n = size - nbytes;
+		memcpy ((unsigned char *) data + nbytes, device->buffer + device->begin, n);
+		device->begin += n;
+		nbytes += n;
+
+		// Keep a read posted for the next data.
+		status = dc_serial_post (device);
+		if (status != DC_STATUS_SUCCESS)
+			goto out;
 
-	if (!ReadFile (device->hFile, data, size, NULL, &overlapped)) {
-		DWORD errcode = GetLastError ();
-		if (errcode != ERROR_IO_PENDING) {
-			SYSERROR (abstract->context, errcode);
-			status = syserror (errcode);
+		if (nbytes == size)
+			break;
+
+		int remaining = 0;
+		status = dc_serial_remaining (device, device->timeout, &target, &init, &remaining);
+		if (status != DC_STATUS_SUCCESS)
+			goto out;
+
+		status = dc_serial_complete (device, remaining);
+		if (status == DC_STATUS_TIMEOUT) {
+			break;
+		} else if (status != DC_STATUS_SUCCESS) {
 			goto out;
 		}
-	}
 
-	if (!GetOverlappedResult (device->hFile, &overlapped, &dwRead, TRUE)) {
-		DWORD errcode = GetLastError ();
-		SYSERROR (abstract->context, errcode);
-		status = syserror (errcode);
-		goto out;
+		// A non-blocking read only takes the data that is already
+		// available.
+		if (device->timeout == 0 && device->begin == device->end)
+			break;
 	}
 
-	if (dwRead != size) {
+	if (nbytes != size) {
 		status = DC_STATUS_TIMEOUT;
 	}
 
 out:
 	if (actual)
-		*actual = dwRead;
+		*actual = nbytes;
 
 	return status;
 }
@@ -648,7 +765,7 @@ dc_serial_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 	DWORD dwWritten = 0;
 
 	OVERLAPPED overlapped = {0};
-	overlapped.hEvent = device->hReadWrite;
+	overlapped.hEvent = device->hWrite;
 
 	if (!WriteFile (device->hFile, data, size, NULL, &overlapped)) {
 		DWORD errcode = GetLastError ();
@@ -682,6 +799,10 @@ dc_serial_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size
 {
 	switch (request) {
 	case DC_IOCTL_SERIAL_SET_LATENCY:
+		// There is no standard API to change the latency timer of the
+		// serial driver. Reads already return as soon as the requested
+		// number of bytes has arrived, because the data is received in
+		// the background.
 		return DC_STATUS_SUCCESS;
 	default:
 		return DC_STATUS_UNSUPPORTED;
@@ -709,6 +830,12 @@ dc_serial_purge (dc_iostream_t *abstract, dc_direction_t direction)
 		return DC_STATUS_INVALIDARGS;
 	}
 
+	// Discard the data of the background read too.
+	if (flags & PURGE_RXCLEAR) {
+		dc_serial_cancel (device);
+		device->begin = device->end = 0;
+	}
+
 	if (!PurgeComm (device->hFile, flags)) {
 		DWORD errcode = GetLastError ();
 		SYSERROR (abstract->context, errcode);
@@ -791,6 +918,11 @@ dc_serial_get_available (dc_iostream_t *abstract, size_t *value)
 {
 	dc_serial_t *device = (dc_serial_t *) abstract;
 
+	// Collect a completed background read, without waiting.
+	dc_status_t status = dc_serial_complete (device, 0);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT)
+		return status;
+
 	COMSTAT stats;
 
 	if (!ClearCommError (device->hFile, NULL, &stats)) {
@@ -800,7 +932,7 @@ dc_serial_get_available (dc_iostream_t *abstract, size_t *value)
 	}
 
 	if (value)
-		*value = stats.cbInQue;
+		*value = (device->end - device->begin) + stats.cbInQue;
 
 	return DC_STATUS_SUCCESS;
 }
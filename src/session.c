@@ -0,0 +1,398 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <libdivecomputer/device.h>
+
+#include "context-private.h"
+#include "device-private.h"
+#include "thread.h"
+
+typedef struct dc_session_job_t {
+	struct dc_session_job_t *next;
+	dc_device_t *device;
+	dc_dive_callback_t callback;
+	dc_session_task_t task;
+	dc_session_done_t done;
+	void *userdata;
+	dc_session_t *session;
+	int cancelled;
+	dc_status_t status;
+	/* The cancel callback installed by the application. */
+	dc_cancel_callback_t cancel_callback;
+	void *cancel_userdata;
+} dc_session_job_t;
+
+typedef struct dc_session_list_t {
+	dc_session_job_t *head;
+	dc_session_job_t *tail;
+} dc_session_list_t;
+
+struct dc_session_t {
+	dc_context_t *context;
+	dc_mutex_t *mutex;
+	dc_cond_t *work;
+	dc_cond_t *done;
+	int quit;
+	unsigned int nthreads;
+	dc_thread_t **threads;
+	/* Jobs waiting for a worker, being downloaded and finished. */
+	dc_session_list_t pending;
+	dc_session_list_t running;
+	dc_session_list_t finished;
+};
+
+static void
+dc_session_list_push (dc_session_list_t *list, dc_session_job_t *job)
+{
+	job->next = NULL;
+	if (list->tail)
+		list->tail->next = job;
+	else
+		list->head = job;
+	list->tail = job;
+}
+
+static dc_session_job_t *
+dc_session_list_pop (dc_session_list_t *list)
+{
+	dc_session_job_t *job = list->head;
+	if (job) {
+		list->head = job->next;
+		if (list->head == NULL)
+			list->tail = NULL;
+		job->next = NULL;
+	}
+	return job;
+}
+
+static void
+dc_session_list_remove (dc_session_list_t *list, dc_session_job_t *job)
+{
+	dc_session_job_t *previous = NULL, *current = list->head;
+	while (current && current != job) {
+		previous = current;
+		current = current->next;
+	}
+
+	if (current == NULL)
+		return;
+
+	if (previous)
+		previous->next = current->next;
+	else
+		list->head = current->next;
+	if (list->tail == current)
+		list->tail = previous;
+	current->next = NULL;
+}
+
+static void
+dc_session_list_cancel (dc_session_list_t *list, dc_device_t *device)
+{
+	for (dc_session_job_t *job = list->head; job; job = job->next) {
+		if (device == NULL || job->device == device)
+			job->cancelled = 1;
+	}
+}
+
+static int
+dc_session_cancelled (void *userdata)
+{
+	dc_session_job_t *job = (dc_session_job_t *) userdata;
+	dc_session_t *session = job->session;
+
+	dc_mutex_lock (session->mutex);
+	int cancelled = job->cancelled;
+	dc_mutex_unlock (session->mutex);
+
+	if (cancelled)
+		return 1;
+
+	// Also honour the cancel callback installed by the application.
+	if (job->cancel_callback)
+		return job->cancel_callback (job->cancel_userdata);
+
+	return 0;
+}
+
+static dc_status_t
+dc_session_run (dc_session_job_t *job)
+{
+	dc_device_t *device = job->device;
+
+	if (job->cancelled)
+		return DC_STATUS_CANCELLED;
+
+	// Chain the cancel callback for the duration of the download.
+	job->cancel_callback = device->cancel_callback;
+	job->cancel_userdata = device->cancel_userdata;
+	device->cancel_callback = dc_session_cancelled;
+	device->cancel_userdata = job;
+
+	dc_status_t status = DC_STATUS_SUCCESS;
+	if (job->task)
+		status = job->task (device, job->userdata);
+	else
+		status = dc_device_foreach (device, job->callback, job->userdata);
+
+	device->cancel_callback = job->cancel_callback;
+	device->cancel_userdata = job->cancel_userdata;
+
+	return status;
+}
+
+static void
+dc_session_worker_main (void *userdata)
+{
+	dc_session_t *session = (dc_session_t *) userdata;
+
+	dc_mutex_lock (session->mutex);
+
+	while (1) {
+		while (!session->quit && session->pending.head == NULL)
+			dc_cond_wait (session->work, session->mutex);
+
+		if (session->quit)
+			break;
+
+		dc_session_job_t *job = dc_session_list_pop (&session->pending);
+		dc_session_list_push (&session->running, job);
+
+		dc_mutex_unlock (session->mutex);
+		dc_status_t status = dc_session_run (job);
+		dc_mutex_lock (session->mutex);
+
+		job->status = status;
+		dc_session_list_remove (&session->running, job);
+		dc_session_list_push (&session->finished, job);
+		dc_cond_broadcast (session->done);
+	}
+
+	dc_mutex_unlock (session->mutex);
+}
+
+dc_status_t
+dc_session_new (dc_session_t **out, dc_context_t *context, unsigned int nthreads)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_session_t *session = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	session = (dc_session_t *) malloc (sizeof (dc_session_t));
+	if (session == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	session->context = context;
+	session->mutex = NULL;
+	session->work = NULL;
+	session->done = NULL;
+	session->quit = 0;
+	session->nthreads = 0;
+	session->threads = NULL;
+	session->pending.head = session->pending.tail = NULL;
+	session->running.head = session->running.tail = NULL;
+	session->finished.head = session->finished.tail = NULL;
+
+	if (dc_mutex_new (&session->mutex) != DC_STATUS_SUCCESS ||
+		dc_cond_new (&session->work) != DC_STATUS_SUCCESS ||
+		dc_cond_new (&session->done) != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	if (nthreads) {
+		session->threads = (dc_thread_t **) malloc (nthreads * sizeof (dc_thread_t *));
+		if (session->threads == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_free;
+		}
+	}
+
+	for (unsigned int i = 0; i < nthreads; ++i) {
+		status = dc_thread_new (&session->threads[i], dc_session_worker_main, session);
+		if (status == DC_STATUS_UNSUPPORTED && i == 0) {
+			WARNING (context, "Threads not supported, downloading sequentially.");
+			status = DC_STATUS_SUCCESS;
+			break;
+		} else if (status != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to create the worker thread.");
+			goto error_free;
+		}
+		session->nthreads++;
+	}
+
+	*out = session;
+
+	return DC_STATUS_SUCCESS;
+
+error_free:
+	dc_session_free (session);
+	return status;
+}
+
+static dc_status_t
+dc_session_push (dc_session_t *session, dc_device_t *device, dc_dive_callback_t callback, dc_session_task_t task, dc_session_done_t done, void *userdata)
+{
+	dc_session_job_t *job = NULL;
+
+	if (session == NULL || device == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	job = (dc_session_job_t *) malloc (sizeof (dc_session_job_t));
+	if (job == NULL) {
+		ERROR (session->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	job->next = NULL;
+	job->device = device;
+	job->callback = callback;
+	job->task = task;
+	job->done = done;
+	job->userdata = userdata;
+	job->session = session;
+	job->cancelled = 0;
+	job->status = DC_STATUS_SUCCESS;
+	job->cancel_callback = NULL;
+	job->cancel_userdata = NULL;
+
+	dc_mutex_lock (session->mutex);
+	dc_session_list_push (&session->pending, job);
+	dc_cond_broadcast (session->work);
+	dc_mutex_unlock (session->mutex);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_session_add (dc_session_t *session, dc_device_t *device, dc_dive_callback_t callback, dc_session_done_t done, void *userdata)
+{
+	return dc_session_push (session, device, callback, NULL, done, userdata);
+}
+
+dc_status_t
+dc_session_add_task (dc_session_t *session, dc_device_t *device, dc_session_task_t task, dc_session_done_t done, void *userdata)
+{
+	if (task == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	return dc_session_push (session, device, NULL, task, done, userdata);
+}
+
+dc_status_t
+dc_session_cancel (dc_session_t *session, dc_device_t *device)
+{
+	if (session == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Pending downloads finish immediately once they are picked up by
+	// a worker, running downloads at the next cancellation check.
+	dc_mutex_lock (session->mutex);
+	dc_session_list_cancel (&session->pending, device);
+	dc_session_list_cancel (&session->running, device);
+	dc_mutex_unlock (session->mutex);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_session_wait (dc_session_t *session)
+{
+	if (session == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (session->mutex);
+
+	while (1) {
+		dc_session_job_t *job = dc_session_list_pop (&session->finished);
+
+		if (job == NULL && session->nthreads == 0) {
+			// Without worker threads, the downloads run here.
+			job = dc_session_list_pop (&session->pending);
+			if (job) {
+				dc_mutex_unlock (session->mutex);
+				job->status = dc_session_run (job);
+				dc_mutex_lock (session->mutex);
+			}
+		}
+
+		if (job) {
+			dc_mutex_unlock (session->mutex);
+			if (job->done)
+				job->done (job->device, job->status, job->userdata);
+			free (job);
+			dc_mutex_lock (session->mutex);
+			continue;
+		}
+
+		if (session->pending.head == NULL && session->running.head == NULL)
+			break;
+
+		dc_cond_wait (session->done, session->mutex);
+	}
+
+	dc_mutex_unlock (session->mutex);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_session_free (dc_session_t *session)
+{
+	if (session == NULL)
+		return DC_STATUS_SUCCESS;
+
+	if (session->nthreads) {
+		// Cancel the running downloads, and stop the workers.
+		dc_mutex_lock (session->mutex);
+		dc_session_list_cancel (&session->running, NULL);
+		session->quit = 1;
+		dc_cond_broadcast (session->work);
+		dc_mutex_unlock (session->mutex);
+
+		for (unsigned int i = 0; i < session->nthreads; ++i) {
+			dc_thread_join (session->threads[i]);
+		}
+	}
+
+	// Discard the results that were never collected.
+	dc_session_job_t *job = NULL;
+	while ((job = dc_session_list_pop (&session->pending)) != NULL)
+		free (job);
+	while ((job = dc_session_list_pop (&session->finished)) != NULL)
+		free (job);
+
+	dc_cond_free (session->done);
+	dc_cond_free (session->work);
+	dc_mutex_free (session->mutex);
+	free (session->threads);
+	free (session);
+
+	return DC_STATUS_SUCCESS;
+}
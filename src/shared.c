@@ -0,0 +1,104 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#include <windows.h>
+#elif defined (HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+#include "shared.h"
+
+/*
+ * The published pointer is read with acquire and written with release
+ * semantics, such that a reader which sees the pointer also sees the
+ * data behind it. Without atomic operations, every call takes the lock.
+ */
+#if defined (__GNUC__)
+#define SHARED_LOAD(p)     __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define SHARED_STORE(p, v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#elif defined (_WIN32)
+#define SHARED_LOAD(p)     ((const void *) InterlockedCompareExchangePointer ((PVOID volatile *) (p), NULL, NULL))
+#define SHARED_STORE(p, v) InterlockedExchangePointer ((PVOID volatile *) (p), (PVOID) (v))
+#endif
+
+#if defined (_WIN32)
+static SRWLOCK g_shared = SRWLOCK_INIT;
+#elif defined (HAVE_PTHREAD_H)
+static pthread_mutex_t g_shared = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+dc_status_t
+dc_shared_get (dc_shared_t *shared, dc_shared_build_t build, const void **data)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (shared == NULL || build == NULL || data == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+#ifdef SHARED_LOAD
+	const void *value = SHARED_LOAD (&shared->data);
+	if (value) {
+		*data = value;
+		return DC_STATUS_SUCCESS;
+	}
+#endif
+
+	// A single static lock for all the shared data, because it's only taken
+	// until the data is available.
+#if defined (_WIN32)
+	AcquireSRWLockExclusive (&g_shared);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_lock (&g_shared);
+#endif
+
+	if (shared->data == NULL) {
+		const void *result = NULL;
+		status = build (&result);
+		if (status == DC_STATUS_SUCCESS) {
+#ifdef SHARED_STORE
+			SHARED_STORE (&shared->data, result);
+#else
+			shared->data = result;
+#endif
+		}
+	}
+
+	if (status == DC_STATUS_SUCCESS)
+		*data = (const void *) shared->data;
+
+#if defined (_WIN32)
+	ReleaseSRWLockExclusive (&g_shared);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_unlock (&g_shared);
+#endif
+
+	return status;
+}
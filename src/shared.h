@@ -0,0 +1,58 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifndef DC_SHARED_H
+#define DC_SHARED_H
+
+#include <libdivecomputer/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Process-wide shared immutable data, such as lookup tables that
+ * are derived from the static tables of the library. The data is built
+ * on first use, by the first caller, and is then shared by all contexts,
+ * devices and parsers, for the lifetime of the process.
+ *
+ * Once the data is available, dc_shared_get is a single atomic load. The
+ * build function runs with a global lock held, and must not call
+ * dc_shared_get itself. If it fails, nothing is stored, and the next call
+ * tries again. The object must be statically initialized with
+ * DC_SHARED_INIT.
+ */
+typedef struct dc_shared_t {
+	const void *volatile data;
+} dc_shared_t;
+
+#define DC_SHARED_INIT {NULL}
+
+typedef dc_status_t (*dc_shared_build_t) (const void **data);
+
+dc_status_t
+dc_shared_get (dc_shared_t *shared, dc_shared_build_t build, const void **data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_SHARED_H */
@@ -25,10 +25,15 @@
 #include "shearwater_common.h"
 
 #include "context-private.h"
+#include "iostream-private.h"
 #include "platform.h"
 #include "array.h"
 
 #define SZ_PACKET  254
+#define SZ_FRAME   32
+
+// Maximum number of outstanding block requests (a divisor of 256).
+#define WINDOW     4
 
 // SLIP special character codes
 #define END       0xC0
@@ -42,6 +47,19 @@ shearwater_common_setup (shearwater_common_device_t *device, dc_context_t *conte
 	dc_status_t status = DC_STATUS_SUCCESS;
 
 	device->iostream = iostream;
+	device->roffset = 0;
+	device->rlength = 0;
+
+	// Keep multiple block requests outstanding over BLE, where the
+	// downloads are limited by the round-trip time.
+	if (dc_iostream_get_transport (iostream) == DC_TRANSPORT_BLE) {
+		device->window = WINDOW;
+	} else {
+		device->window = 1;
+	}
+
+	// Request the fastest connection interval for the BLE round-trips.
+	dc_iostream_ble_prefer (iostream, 0, BLE_INTERVAL_MIN, 0);
 
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_iostream_configure (device->iostream, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
@@ -112,11 +130,16 @@ shearwater_common_decompress_lre (unsigned char *data, unsigned int size, dc_buf
 
 
 static int
-shearwater_common_decompress_xor (unsigned char *data, unsigned int size)
+shearwater_common_decompress_xor (unsigned char *data, unsigned int offset, unsigned int size)
 {
 	// Each block of 32 bytes is XOR'ed (in-place) with the previous block,
-	// except for the first block, which is passed through unchanged.
-	for (unsigned int i = 32; i < size; ++i) {
+	// except for the first block, which is passed through unchanged. The
+	// bytes before the offset are already decoded, which allows to decode
+	// the data incrementally, as it arrives.
+	if (offset < 32)
+		offset = 32;
+
+	for (unsigned int i = offset; i < size; ++i) {
 		data[i] ^= data[i - 32];
 	}
 
@@ -128,88 +151,105 @@ shearwater_common_slip_write (shearwater_common_device_t *device, const unsigned
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_transport_t transport = dc_iostream_get_transport(device->iostream);
-	unsigned char buffer[32];
+	unsigned char buffer[2 * (SZ_PACKET + 4) + 1];
 	unsigned int nbytes = 0;
 
-	if (transport == DC_TRANSPORT_BLE) {
-		// Calculate the total number of bytes.
-		unsigned int count = 1;
-		for (unsigned int i = 0; i < size; ++i) {
-			unsigned char c = data[i];
-			if (c == END || c == ESC) {
-				count += 2;
-			} else {
-				count++;
-			}
-		}
-
-		// Calculate the total number of frames.
-		unsigned int nframes = (count + sizeof(buffer) - 1) / sizeof(buffer);
-
-		buffer[0] = nframes;
-		buffer[1] = 0;
-		nbytes = 2;
-	}
+	if (size > SZ_PACKET + 4)
+		return DC_STATUS_INVALIDARGS;
 
+	// Encode the entire packet at once.
 	for (unsigned int i = 0; i < size; ++i) {
 		unsigned char c = data[i];
 
-		if (c == END || c == ESC) {
-			// Append the escape character.
+		if (c == END) {
 			buffer[nbytes++] = ESC;
+			buffer[nbytes++] = ESC_END;
+		} else if (c == ESC) {
+			buffer[nbytes++] = ESC;
+			buffer[nbytes++] = ESC_ESC;
+		} else {
+			buffer[nbytes++] = c;
+		}
+	}
 
-			// Flush the buffer if necessary.
-			if (nbytes >= sizeof(buffer)) {
-				status = dc_iostream_write (device->iostream, buffer, nbytes, NULL);
-				if (status != DC_STATUS_SUCCESS) {
-					ERROR (device->base.context, "Failed to send the packet.");
-					return status;
-				}
-
-				if (transport == DC_TRANSPORT_BLE) {
-					buffer[1]++;
-					nbytes = 2;
-				} else {
-					nbytes = 0;
-				}
-			}
+	// Append the END character to indicate the end of the packet.
+	buffer[nbytes++] = END;
 
-			// Escape the character.
-			if (c == END) {
-				c = ESC_END;
-			} else {
-				c = ESC_ESC;
-			}
+	if (transport != DC_TRANSPORT_BLE) {
+		// Send the packet with a single write.
+		status = dc_iostream_write (device->iostream, buffer, nbytes, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->base.context, "Failed to send the packet.");
+			return status;
 		}
 
-		// Append the character.
-		buffer[nbytes++] = c;
+		return DC_STATUS_SUCCESS;
+	}
 
-		// Flush the buffer if necessary.
-		if (nbytes >= sizeof(buffer)) {
-			status = dc_iostream_write (device->iostream, buffer, nbytes, NULL);
-			if (status != DC_STATUS_SUCCESS) {
-				ERROR (device->base.context, "Failed to send the packet.");
-				return status;
-			}
+	// Over BLE, the packet is split into frames, with a two byte header
+	// containing the total number of frames and the frame index.
+	unsigned char frame[SZ_FRAME];
+	unsigned int nframes = (nbytes + SZ_FRAME - 2 - 1) / (SZ_FRAME - 2);
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < nframes; ++i) {
+		unsigned int length = nbytes - offset;
+		if (length > SZ_FRAME - 2)
+			length = SZ_FRAME - 2;
 
-			if (transport == DC_TRANSPORT_BLE) {
-				buffer[1]++;
-				nbytes = 2;
-			} else {
-				nbytes = 0;
-			}
+		frame[0] = nframes;
+		frame[1] = i;
+		memcpy (frame + 2, buffer + offset, length);
+
+		status = dc_iostream_write (device->iostream, frame, length + 2, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (device->base.context, "Failed to send the packet.");
+			return status;
 		}
+
+		offset += length;
 	}
 
-	// Append the END character to indicate the end of the packet.
-	buffer[nbytes++] = END;
+	return DC_STATUS_SUCCESS;
+}
 
-	// Flush the buffer.
-	status = dc_iostream_write (device->iostream, buffer, nbytes, NULL);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (device->base.context, "Failed to send the packet.");
-		return status;
+
+static dc_status_t
+shearwater_common_slip_fill (shearwater_common_device_t *device)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_transport_t transport = dc_iostream_get_transport(device->iostream);
+	size_t transferred = 0;
+
+	if (transport == DC_TRANSPORT_BLE) {
+		// Every read returns a single frame.
+		status = dc_iostream_read (device->iostream, device->rbuffer, sizeof(device->rbuffer), &transferred);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		if (transferred < 2) {
+			ERROR (device->base.context, "Invalid packet length (" DC_PRINTF_SIZE ").", transferred);
+			return DC_STATUS_PROTOCOL;
+		}
+
+		// Skip the frame header.
+		device->roffset = 2;
+		device->rlength = transferred;
+	} else {
+		// Read all bytes that are already available, but at least one
+		// byte, to avoid blocking beyond the end of the packet.
+		size_t available = 0;
+		status = dc_iostream_get_available (device->iostream, &available);
+		if (status != DC_STATUS_SUCCESS || available == 0)
+			available = 1;
+		if (available > sizeof(device->rbuffer))
+			available = sizeof(device->rbuffer);
+
+		status = dc_iostream_read (device->iostream, device->rbuffer, available, &transferred);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		device->roffset = 0;
+		device->rlength = transferred;
 	}
 
 	return DC_STATUS_SUCCESS;
@@ -220,90 +260,75 @@ static dc_status_t
 shearwater_common_slip_read (shearwater_common_device_t *device, unsigned char data[], unsigned int size, unsigned int *actual)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
-	dc_transport_t transport = dc_iostream_get_transport(device->iostream);
-	unsigned char buffer[256];
 	unsigned int escaped = 0;
 	unsigned int nbytes = 0;
 
-	// Get the packet size.
-	size_t packetsize = (transport == DC_TRANSPORT_BLE) ? sizeof(buffer) : 1;
-
-	// Read bytes until a complete packet has been received. If the
+	// Decode bytes until a complete packet has been received. If the
 	// buffer runs out of space, bytes are dropped. The caller can
 	// detect this condition because the return value will be larger
-	// than the supplied buffer size.
+	// than the supplied buffer size. Bytes received after the end of
+	// the packet remain buffered for the next packet.
 	while (1) {
-		size_t transferred = 0;
-		status = dc_iostream_read (device->iostream, buffer, packetsize, &transferred);
-		if (status != DC_STATUS_SUCCESS) {
-			ERROR (device->base.context, "Failed to receive the packet.");
-			return status;
-		}
-
-		size_t offset = 0;
-		if (transport == DC_TRANSPORT_BLE) {
-			if (transferred < 2) {
-				ERROR (device->base.context, "Invalid packet length (" DC_PRINTF_SIZE ").", transferred);
-				return DC_STATUS_PROTOCOL;
+		if (device->roffset >= device->rlength) {
+			status = shearwater_common_slip_fill (device);
+			if (status != DC_STATUS_SUCCESS) {
+				ERROR (device->base.context, "Failed to receive the packet.");
+				device->roffset = device->rlength = 0;
+				return status;
 			}
-
-			offset = 2;
 		}
 
-		for (size_t i = offset; i < transferred; ++i) {
-			unsigned char c = buffer[i];
+		unsigned char c = device->rbuffer[device->roffset++];
 
-			if (c == END || c == ESC) {
-				if (escaped) {
-					// If the END or ESC characters are escaped, then we
-					// have a protocol violation, and an error is reported.
-					ERROR (device->base.context, "SLIP frame escaped the special character %02x.", c);
-					return DC_STATUS_PROTOCOL;
-				}
-
-				if (c == END) {
-					// If it's an END character then we're done.
-					// As a minor optimization, empty packets are ignored. This
-					// is to avoid bothering the upper layers with all the empty
-					// packets generated by the duplicate END characters which
-					// are sent to try to detect line noise.
-					if (nbytes) {
-						goto done;
-					}
-				} else {
-					// If it's an ESC character, get another character and then
-					// figure out what to store in the packet based on that.
-					escaped = 1;
-				}
-
-				continue;
+		if (c == END || c == ESC) {
+			if (escaped) {
+				// If the END or ESC characters are escaped, then we
+				// have a protocol violation, and an error is reported.
+				ERROR (device->base.context, "SLIP frame escaped the special character %02x.", c);
+				device->roffset = device->rlength = 0;
+				return DC_STATUS_PROTOCOL;
 			}
 
-			if (escaped) {
-				// If it's not one of the two escaped characters, then we
-				// have a protocol violation. The best bet seems to be to
-				// leave the byte alone and just stuff it into the packet.
-				switch (c) {
-				case ESC_END:
-					c = END;
-					break;
-				case ESC_ESC:
-					c = ESC;
-					break;
-				default:
+			if (c == END) {
+				// If it's an END character then we're done.
+				// As a minor optimization, empty packets are ignored. This
+				// is to avoid bothering the upper layers with all the empty
+				// packets generated by the duplicate END characters which
+				// are sent to try to detect line noise.
+				if (nbytes) {
 					break;
 				}
+			} else {
+				// If it's an ESC character, get another character and then
+				// figure out what to store in the packet based on that.
+				escaped = 1;
+			}
 
-				escaped = 0;
+			continue;
+		}
+
+		if (escaped) {
+			// If it's not one of the two escaped characters, then we
+			// have a protocol violation. The best bet seems to be to
+			// leave the byte alone and just stuff it into the packet.
+			switch (c) {
+			case ESC_END:
+				c = END;
+				break;
+			case ESC_ESC:
+				c = ESC;
+				break;
+			default:
+				break;
 			}
 
-			if (nbytes < size)
-				data[nbytes] = c;
-			nbytes++;
+			escaped = 0;
 		}
-	}
 
-done:
+		if (nbytes < size)
+			data[nbytes] = c;
+		nbytes++;
+	}
 
 	if (nbytes > size) {
 		ERROR (device->base.context, "Insufficient buffer space available.");
@@ -317,20 +342,16 @@ done:
 }
 
 
-dc_status_t
-shearwater_common_transfer (shearwater_common_device_t *device, const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize, unsigned int *actual)
+static dc_status_t
+shearwater_common_request (shearwater_common_device_t *device, const unsigned char input[], unsigned int isize)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
 	unsigned char packet[SZ_PACKET + 4];
-	unsigned int n = 0;
 
-	if (isize > SZ_PACKET || osize > SZ_PACKET)
+	if (isize > SZ_PACKET)
 		return DC_STATUS_INVALIDARGS;
 
-	if (device_is_cancelled (abstract))
-		return DC_STATUS_CANCELLED;
-
 	// Setup the request packet.
 	packet[0] = 0xFF;
 	packet[1] = 0x01;
@@ -345,12 +366,20 @@ shearwater_common_transfer (shearwater_common_device_t *device, const unsigned c
 		return status;
 	}
 
-	// Return early if no response packet is requested.
-	if (osize == 0) {
-		if (actual)
-			*actual = 0;
-		return DC_STATUS_SUCCESS;
-	}
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+shearwater_common_response (shearwater_common_device_t *device, unsigned char output[], unsigned int osize, unsigned int *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+	unsigned char packet[SZ_PACKET + 4];
+	unsigned int n = 0;
+
+	if (osize > SZ_PACKET)
+		return DC_STATUS_INVALIDARGS;
 
 	// Receive the response packet.
 	status = shearwater_common_slip_read (device, packet, sizeof (packet), &n);
@@ -380,6 +409,35 @@ shearwater_common_transfer (shearwater_common_device_t *device, const unsigned c
 }
 
 
+dc_status_t
+shearwater_common_transfer (shearwater_common_device_t *device, const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize, unsigned int *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+
+	if (isize > SZ_PACKET || osize > SZ_PACKET)
+		return DC_STATUS_INVALIDARGS;
+
+	if (device_is_cancelled (abstract))
+		return DC_STATUS_CANCELLED;
+
+	// Send the request packet.
+	status = shearwater_common_request (device, input, isize);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	// Return early if no response packet is requested.
+	if (osize == 0) {
+		if (actual)
+			*actual = 0;
+		return DC_STATUS_SUCCESS;
+	}
+
+	// Receive the response packet.
+	return shearwater_common_response (device, output, osize, actual);
+}
+
+
 dc_status_t
 shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress)
 {
@@ -402,8 +460,14 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 	unsigned char req_quit[] = {0x37};
 	unsigned char response[SZ_PACKET];
 
-	// Erase the current contents of the buffer.
-	if (!dc_buffer_clear (buffer)) {
+	// The responses of the outstanding block requests.
+	unsigned char slots[WINDOW][SZ_PACKET];
+	unsigned int lengths[WINDOW] = {0};
+	unsigned int ready[WINDOW] = {0};
+
+	// Erase the current contents of the buffer. Without compression, the
+	// size of the data is known, and the space is reserved upfront.
+	if (!dc_buffer_clear (buffer) || (!compression && !dc_buffer_reserve (buffer, size))) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
 		return DC_STATUS_NOMEMORY;
 	}
@@ -434,58 +498,146 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 	}
 
+	// The maximum block size is needed to avoid requesting blocks past
+	// the end of the data.
+	unsigned int blocksize = response[2];
+	unsigned int window = blocksize ? device->window : 1;
+
 	unsigned int done = 0;
+	unsigned int eof = 0;
+	unsigned int xoffset = 0;
 	unsigned char block = 1;
+	unsigned char next = 1;
+	unsigned int pending = 0;
 	unsigned int nbytes = 0;
 	while (nbytes < size && !done) {
-		// Transfer the block request.
-		req_block[1] = block;
-		rc = shearwater_common_transfer (device, req_block, sizeof (req_block), response, sizeof (response), &n);
-		if (rc != DC_STATUS_SUCCESS) {
-			return rc;
+		// Keep the window filled with block requests, but not beyond
+		// the number of blocks that are still needed. For a compressed
+		// stream, the size is only an upper bound, and the real end is
+		// only known once a short block arrives. No new requests are
+		// sent after that, as long as responses are still outstanding.
+		unsigned int nblocks = window;
+		if (window > 1) {
+			nblocks = (size - nbytes + blocksize - 1) / blocksize;
+			if (nblocks > window)
+				nblocks = window;
 		}
+		while (pending < nblocks && !(eof && pending)) {
+			if (device_is_cancelled (abstract))
+				return DC_STATUS_CANCELLED;
+
+			req_block[1] = next;
+			rc = shearwater_common_request (device, req_block, sizeof (req_block));
+			if (rc != DC_STATUS_SUCCESS) {
+				return rc;
+			}
 
-		// Verify the block header.
-		if (n < 2 || response[0] != 0x76 || response[1] != block) {
-			ERROR (abstract->context, "Unexpected response packet.");
-			return DC_STATUS_PROTOCOL;
+			next++;
+			pending++;
 		}
 
-		// Verify the block length.
-		unsigned int length = n - 2;
-		if (nbytes + length > size) {
-			ERROR (abstract->context, "Unexpected packet size.");
-			return DC_STATUS_PROTOCOL;
+		// Receive the next block response.
+		rc = shearwater_common_response (device, response, sizeof (response), &n);
+
+		// Verify the block header. The block number must match one of
+		// the outstanding requests.
+		unsigned char index = n >= 2 ? (unsigned char) (response[1] - block) : 0;
+		if (rc == DC_STATUS_SUCCESS && (n < 2 || response[0] != 0x76 || index >= pending)) {
+			ERROR (abstract->context, "Unexpected response packet.");
+			rc = DC_STATUS_PROTOCOL;
 		}
 
-		// Update and emit a progress event.
-		if (progress) {
-			current += length;
-			progress->current = initial + STEP (current, maximum);
-			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+		if (rc != DC_STATUS_SUCCESS) {
+			// Fall back to a single outstanding request, if the
+			// firmware doesn't handle multiple requests.
+			if (window > 1 && (rc == DC_STATUS_TIMEOUT || rc == DC_STATUS_PROTOCOL)) {
+				WARNING (abstract->context, "Pipelined block requests failed. Falling back to a single request.");
+				dc_iostream_sleep (device->iostream, 300);
+				dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+				device->roffset = device->rlength = 0;
+				memset (ready, 0, sizeof (ready));
+				device->window = window = 1;
+				next = block;
+				pending = 0;
+				eof = 0;
+				continue;
+			}
+			return rc;
 		}
 
-		if (compression) {
-			if (shearwater_common_decompress_lre (response + 2, length, buffer, &done) != 0) {
-				ERROR (abstract->context, "Decompression error (LRE phase).");
+		// Store the block.
+		unsigned int slot = response[1] % WINDOW;
+		memcpy (slots[slot], response + 2, n - 2);
+		lengths[slot] = n - 2;
+		ready[slot] = 1;
+
+		// A short block marks the end of the data.
+		if (n - 2 < blocksize)
+			eof = 1;
+
+		// Process the blocks in order.
+		while (ready[block % WINDOW] && nbytes < size && !done) {
+			slot = block % WINDOW;
+			ready[slot] = 0;
+
+			// Verify the block length.
+			unsigned int length = lengths[slot];
+			if (nbytes + length > size) {
+				ERROR (abstract->context, "Unexpected packet size.");
 				return DC_STATUS_PROTOCOL;
 			}
-		} else {
-			if (!dc_buffer_append (buffer, response + 2, length)) {
-				ERROR (abstract->context, "Insufficient buffer space available.");
-				return DC_STATUS_PROTOCOL;
+
+			// Update and emit a progress event.
+			if (progress) {
+				current += length;
+				progress->current = initial + STEP (current, maximum);
+				device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 			}
-		}
 
-		nbytes += length;
-		block++;
+			if (compression) {
+				if (shearwater_common_decompress_lre (slots[slot], length, buffer, &done) != 0) {
+					ERROR (abstract->context, "Decompression error (LRE phase).");
+					return DC_STATUS_PROTOCOL;
+				}
+
+				// Decode the new data immediately, while it's still
+				// in the cache.
+				unsigned int decoded = dc_buffer_get_size (buffer);
+				if (shearwater_common_decompress_xor (dc_buffer_get_data (buffer), xoffset, decoded) != 0) {
+					ERROR (abstract->context, "Decompression error (XOR phase).");
+					return DC_STATUS_PROTOCOL;
+				}
+				xoffset = decoded;
+			} else {
+				if (!dc_buffer_append (buffer, slots[slot], length)) {
+					ERROR (abstract->context, "Insufficient buffer space available.");
+					return DC_STATUS_PROTOCOL;
+				}
+			}
+
+			nbytes += length;
+			pending--;
+			block++;
+		}
 	}
 
-	if (compression) {
-		if (shearwater_common_decompress_xor (dc_buffer_get_data (buffer), dc_buffer_get_size (buffer)) != 0) {
-			ERROR (abstract->context, "Decompression error (XOR phase).");
-			return DC_STATUS_PROTOCOL;
+	// Discard the responses of the block requests past the end of the
+	// data. This happens only when the end of a compressed stream falls
+	// on a block boundary, or a short block arrives after the requests
+	// for the next blocks were already sent. That's at most one window
+	// of requests. An error indicates the remaining responses are lost.
+	for (unsigned int i = 0; i < WINDOW; ++i) {
+		if (ready[i])
+			pending--;
+	}
+	while (pending) {
+		rc = shearwater_common_response (device, response, sizeof (response), &n);
+		if (rc != DC_STATUS_SUCCESS) {
+			dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+			device->roffset = device->rlength = 0;
+			break;
 		}
+		pending--;
 	}
 
 	// Transfer the quit request.
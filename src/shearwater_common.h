@@ -50,6 +50,12 @@ extern "C" {
 typedef struct shearwater_common_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
+	/* The received data that is not decoded yet. */
+	unsigned char rbuffer[256];
+	size_t roffset;
+	size_t rlength;
+	/* The number of outstanding block requests. */
+	unsigned int window;
 } shearwater_common_device_t;
 
 dc_status_t
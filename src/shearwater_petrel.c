@@ -53,10 +53,12 @@ static const dc_device_vtable_t shearwater_petrel_device_vtable = {
 	DC_FAMILY_SHEARWATER_PETREL,
 	shearwater_petrel_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	shearwater_petrel_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	shearwater_petrel_device_close /* close */
 };
 
@@ -310,6 +312,12 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 			// Check for a valid dive header.
 			unsigned int header = array_uint16_be (data + offset);
 			if (header == 0x5A23) {
+				// A deleted dive still contains the fingerprint data. If
+				// the fingerprint dive itself was deleted, all older dives
+				// are already downloaded too.
+				if (memcmp (data + offset + 4, device->fingerprint, sizeof (device->fingerprint)) == 0)
+					break;
+
 				// this is a deleted dive; keep looking
 				offset += RECORD_SIZE;
 				deleted++;
@@ -346,12 +354,14 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 	// Update and emit a progress event.
 	progress.current = NSTEPS * current;
 	progress.maximum = NSTEPS * maximum;
+	device_set_phase (abstract, DC_PHASE_PROFILE);
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
 	// Cache the buffer pointer and size.
 	unsigned char *data = dc_buffer_get_data (manifests);
 	unsigned int size = dc_buffer_get_size (manifests);
 
+	unsigned int ndives = 0;
 	unsigned int offset = 0;
 	while (offset < size) {
 		// skip deleted dives
@@ -359,6 +369,20 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 			offset += RECORD_SIZE;
 			continue;
 		}
+
+		// Check the download limits. The fingerprint is the timestamp of
+		// the dive.
+		dc_datetime_t datetime;
+		if (device_limits_reached (abstract, ndives, dc_datetime_gmtime (&datetime, array_uint32_be (data + offset + 4))))
+			break;
+
+		// Skip the dives of an interrupted download.
+		if (device_journal_skip (abstract, data + offset + 4, sizeof (device->fingerprint))) {
+			current += 1;
+			offset += RECORD_SIZE;
+			continue;
+		}
+
 		// Get the address of the dive.
 		unsigned int address = array_uint32_be (data + offset + 20);
 
@@ -375,6 +399,7 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 
 		// Update the progress state.
 		current += 1;
+		ndives++;
 
 		unsigned char *buf = dc_buffer_get_data (buffer);
 		unsigned int len = dc_buffer_get_size (buffer);
@@ -92,6 +92,23 @@ typedef struct shearwater_predator_tank_t {
 	unsigned int endpressure;
 } shearwater_predator_tank_t;
 
+typedef struct shearwater_predator_state_t {
+	unsigned int time;
+	unsigned int interval;
+	unsigned int o2_previous;
+	unsigned int he_previous;
+} shearwater_predator_state_t;
+
+/*
+ * The record layout of the dive samples, resolved once from the model
+ * and the log version when the header is cached.
+ */
+typedef struct shearwater_predator_format_t {
+	unsigned int pnf;
+	unsigned int petrel;
+	unsigned int ai;
+} shearwater_predator_format_t;
+
 struct shearwater_predator_parser_t {
 	dc_parser_t base;
 	unsigned int model;
@@ -117,6 +134,7 @@ struct shearwater_predator_parser_t {
 	unsigned int units;
 	unsigned int atmospheric;
 	unsigned int density;
+	shearwater_predator_format_t format;
 };
 
 static dc_status_t shearwater_predator_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
@@ -161,6 +179,152 @@ shearwater_predator_find_gasmix (shearwater_predator_parser_t *parser, unsigned
 }
 
 
+static dc_status_t
+shearwater_predator_parser_dive_sample (shearwater_predator_parser_t *parser, shearwater_predator_state_t *state, const unsigned char data[], unsigned int offset, dc_sample_callback_t callback, void *userdata)
+{
+	const shearwater_predator_format_t *format = &parser->format;
+	const unsigned int pnf = format->pnf;
+	dc_sample_value_t sample = {0};
+
+	// Time (seconds).
+	state->time += state->interval;
+	sample.time = state->time;
+	if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
+
+	// Depth (1/10 m or ft).
+	unsigned int depth = array_uint16_be (data + pnf + offset);
+	if (parser->units == IMPERIAL)
+		sample.depth = depth * FEET / 10.0;
+	else
+		sample.depth = depth / 10.0;
+	if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
+
+	// Temperature (°C or °F).
+	int temperature = (signed char) data[offset + pnf + 13];
+	if (temperature < 0) {
+		// Fix negative temperatures.
+		temperature += 102;
+		if (temperature > 0) {
+			temperature = 0;
+		}
+	}
+	if (parser->units == IMPERIAL)
+		sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
+	else
+		sample.temperature = temperature;
+	if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
+
+	// Status flags.
+	unsigned int status = data[offset + pnf + 11];
+
+	if ((status & OC) == 0) {
+		// PPO2
+		if ((status & PPO2_EXTERNAL) == 0) {
+#ifdef SENSOR_AVERAGE
+			sample.ppo2 = data[offset + pnf + 6] / 100.0;
+			if (callback) callback (DC_SAMPLE_PPO2, sample, userdata);
+#else
+			sample.ppo2 = data[offset + pnf + 12] * parser->calibration[0];
+			if (callback && (parser->calibrated & 0x01)) callback (DC_SAMPLE_PPO2, sample, userdata);
+
+			sample.ppo2 = data[offset + pnf + 14] * parser->calibration[1];
+			if (callback && (parser->calibrated & 0x02)) callback (DC_SAMPLE_PPO2, sample, userdata);
+
+			sample.ppo2 = data[offset + pnf + 15] * parser->calibration[2];
+			if (callback && (parser->calibrated & 0x04)) callback (DC_SAMPLE_PPO2, sample, userdata);
+#endif
+		}
+
+		// Setpoint
+		if (format->petrel) {
+			sample.setpoint = data[offset + pnf + 18] / 100.0;
+		} else {
+			// this will only ever be called for the actual Predator, so no adjustment needed for PNF
+			if (status & SETPOINT_HIGH) {
+				sample.setpoint = data[18] / 100.0;
+			} else {
+				sample.setpoint = data[17] / 100.0;
+			}
+		}
+		if (callback) callback (DC_SAMPLE_SETPOINT, sample, userdata);
+	}
+
+	// CNS
+	if (format->petrel) {
+		sample.cns = data[offset + pnf + 22] / 100.0;
+		if (callback) callback (DC_SAMPLE_CNS, sample, userdata);
+	}
+
+	// Gaschange.
+	unsigned int o2 = data[offset + pnf + 7];
+	unsigned int he = data[offset + pnf + 8];
+	if (o2 != state->o2_previous || he != state->he_previous) {
+		unsigned int idx = shearwater_predator_find_gasmix (parser, o2, he);
+		if (idx >= parser->ngasmixes) {
+			ERROR (parser->base.context, "Invalid gas mix.");
+			return DC_STATUS_DATAFORMAT;
+		}
+
+		sample.gasmix = idx;
+		if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
+		state->o2_previous = o2;
+		state->he_previous = he;
+	}
+
+	// Deco stop / NDL.
+	unsigned int decostop = array_uint16_be (data + offset + pnf + 2);
+	if (decostop) {
+		sample.deco.type = DC_DECO_DECOSTOP;
+		if (parser->units == IMPERIAL)
+			sample.deco.depth = decostop * FEET;
+		else
+			sample.deco.depth = decostop;
+	} else {
+		sample.deco.type = DC_DECO_NDL;
+		sample.deco.depth = 0.0;
+	}
+	sample.deco.time = data[offset + pnf + 9] * 60;
+	if (callback) callback (DC_SAMPLE_DECO, sample, userdata);
+
+	// for logversion 7 and newer (introduced for Perdix AI)
+	// detect tank pressure
+	if (format->ai) {
+		const unsigned int idx[NTANKS] = {27, 19};
+		for (unsigned int i = 0; i < NTANKS; ++i) {
+			// Tank pressure
+			// Values above 0xFFF0 are special codes:
+			//    0xFFFF AI is off
+			//    0xFFFE No comms for 90 seconds+
+			//    0xFFFD No comms for 30 seconds
+			//    0xFFFC Transmitter not paired
+			// For regular values, the top 4 bits contain the battery
+			// level (0=normal, 1=critical, 2=warning), and the lower 12
+			// bits the tank pressure in units of 2 psi.
+			unsigned int pressure = array_uint16_be (data + offset + pnf + idx[i]);
+			if (pressure < 0xFFF0) {
+				pressure &= 0x0FFF;
+				sample.pressure.tank = parser->tankidx[i];
+				sample.pressure.value = pressure * 2 * PSI / BAR;
+				if (callback) callback (DC_SAMPLE_PRESSURE, sample, userdata);
+			}
+		}
+
+		// Gas time remaining in minutes
+		// Values above 0xF0 are special codes:
+		//    0xFF Not paired
+		//    0xFE No communication
+		//    0xFD Not available in current mode
+		//    0xFC Not available because of DECO
+		//    0xFB Tank size or max pressure haven’t been set up
+		if (data[offset + pnf + 21] < 0xF0) {
+			sample.rbt = data[offset + pnf + 21];
+			if (callback) callback (DC_SAMPLE_RBT, sample, userdata);
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, unsigned int model, unsigned int petrel)
 {
@@ -220,6 +384,9 @@ shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, unsig
 	parser->units = METRIC;
 	parser->density = 1025;
 	parser->atmospheric = ATM / (BAR / 1000);
+	parser->format.pnf = 0;
+	parser->format.petrel = petrel;
+	parser->format.ai = 0;
 
 	*out = (dc_parser_t *) parser;
 
@@ -277,6 +444,9 @@ shearwater_predator_parser_set_data (dc_parser_t *abstract, const unsigned char
 	parser->units = METRIC;
 	parser->density = 1025;
 	parser->atmospheric = ATM / (BAR / 1000);
+	parser->format.pnf = 0;
+	parser->format.petrel = parser->petrel;
+	parser->format.ai = 0;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -533,6 +703,9 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 	parser->units = data[parser->opening[0] + 8];
 	parser->atmospheric = array_uint16_be (data + parser->opening[1] + (parser->pnf ? 16 : 47));
 	parser->density = array_uint16_be (data + parser->opening[3] + (parser->pnf ? 3 : 83));
+	parser->format.pnf = pnf;
+	parser->format.petrel = parser->petrel;
+	parser->format.ai = logversion >= 7;
 	parser->cached = 1;
 
 	return DC_STATUS_SUCCESS;
@@ -624,19 +797,15 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	// Previous gas mix.
-	unsigned int o2_previous = 0, he_previous = 0;
-
-	// Sample interval.
-	unsigned int time = 0;
-	unsigned int interval = 10;
+	// Previous gas mix and sample interval.
+	shearwater_predator_state_t state = {0, 10, 0, 0};
 	if (parser->pnf && parser->logversion >= 9 && parser->opening[5] != UNDEFINED) {
-		interval = array_uint16_be (data + parser->opening[5] + 23);
-		if (interval % 1000 != 0) {
-			ERROR (abstract->context, "Unsupported sample interval (%u ms).", interval);
+		state.interval = array_uint16_be (data + parser->opening[5] + 23);
+		if (state.interval % 1000 != 0) {
+			ERROR (abstract->context, "Unsupported sample interval (%u ms).", state.interval);
 			return DC_STATUS_DATAFORMAT;
 		}
-		interval /= 1000;
+		state.interval /= 1000;
 	}
 
 	unsigned int pnf = parser->pnf;
@@ -655,141 +824,9 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 		unsigned int type = pnf ? data[offset] : LOG_RECORD_DIVE_SAMPLE;
 
 		if (type == LOG_RECORD_DIVE_SAMPLE) {
-			// Time (seconds).
-			time += interval;
-			sample.time = time;
-			if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
-
-			// Depth (1/10 m or ft).
-			unsigned int depth = array_uint16_be (data + pnf + offset);
-			if (parser->units == IMPERIAL)
-				sample.depth = depth * FEET / 10.0;
-			else
-				sample.depth = depth / 10.0;
-			if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
-
-			// Temperature (°C or °F).
-			int temperature = (signed char) data[offset + pnf + 13];
-			if (temperature < 0) {
-				// Fix negative temperatures.
-				temperature += 102;
-				if (temperature > 0) {
-					temperature = 0;
-				}
-			}
-			if (parser->units == IMPERIAL)
-				sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
-			else
-				sample.temperature = temperature;
-			if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
-
-			// Status flags.
-			unsigned int status = data[offset + pnf + 11];
-
-			if ((status & OC) == 0) {
-				// PPO2
-				if ((status & PPO2_EXTERNAL) == 0) {
-#ifdef SENSOR_AVERAGE
-					sample.ppo2 = data[offset + pnf + 6] / 100.0;
-					if (callback) callback (DC_SAMPLE_PPO2, sample, userdata);
-#else
-					sample.ppo2 = data[offset + pnf + 12] * parser->calibration[0];
-					if (callback && (parser->calibrated & 0x01)) callback (DC_SAMPLE_PPO2, sample, userdata);
-
-					sample.ppo2 = data[offset + pnf + 14] * parser->calibration[1];
-					if (callback && (parser->calibrated & 0x02)) callback (DC_SAMPLE_PPO2, sample, userdata);
-
-					sample.ppo2 = data[offset + pnf + 15] * parser->calibration[2];
-					if (callback && (parser->calibrated & 0x04)) callback (DC_SAMPLE_PPO2, sample, userdata);
-#endif
-				}
-
-				// Setpoint
-				if (parser->petrel) {
-					sample.setpoint = data[offset + pnf + 18] / 100.0;
-				} else {
-					// this will only ever be called for the actual Predator, so no adjustment needed for PNF
-					if (status & SETPOINT_HIGH) {
-						sample.setpoint = data[18] / 100.0;
-					} else {
-						sample.setpoint = data[17] / 100.0;
-					}
-				}
-				if (callback) callback (DC_SAMPLE_SETPOINT, sample, userdata);
-			}
-
-			// CNS
-			if (parser->petrel) {
-				sample.cns = data[offset + pnf + 22] / 100.0;
-				if (callback) callback (DC_SAMPLE_CNS, sample, userdata);
-			}
-
-			// Gaschange.
-			unsigned int o2 = data[offset + pnf + 7];
-			unsigned int he = data[offset + pnf + 8];
-			if (o2 != o2_previous || he != he_previous) {
-				unsigned int idx = shearwater_predator_find_gasmix (parser, o2, he);
-				if (idx >= parser->ngasmixes) {
-					ERROR (abstract->context, "Invalid gas mix.");
-					return DC_STATUS_DATAFORMAT;
-				}
-
-				sample.gasmix = idx;
-				if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
-				o2_previous = o2;
-				he_previous = he;
-			}
-
-			// Deco stop / NDL.
-			unsigned int decostop = array_uint16_be (data + offset + pnf + 2);
-			if (decostop) {
-				sample.deco.type = DC_DECO_DECOSTOP;
-				if (parser->units == IMPERIAL)
-					sample.deco.depth = decostop * FEET;
-				else
-					sample.deco.depth = decostop;
-			} else {
-				sample.deco.type = DC_DECO_NDL;
-				sample.deco.depth = 0.0;
-			}
-			sample.deco.time = data[offset + pnf + 9] * 60;
-			if (callback) callback (DC_SAMPLE_DECO, sample, userdata);
-
-			// for logversion 7 and newer (introduced for Perdix AI)
-			// detect tank pressure
-			if (parser->logversion >= 7) {
-				const unsigned int idx[NTANKS] = {27, 19};
-				for (unsigned int i = 0; i < NTANKS; ++i) {
-					// Tank pressure
-					// Values above 0xFFF0 are special codes:
-					//    0xFFFF AI is off
-					//    0xFFFE No comms for 90 seconds+
-					//    0xFFFD No comms for 30 seconds
-					//    0xFFFC Transmitter not paired
-					// For regular values, the top 4 bits contain the battery
-					// level (0=normal, 1=critical, 2=warning), and the lower 12
-					// bits the tank pressure in units of 2 psi.
-					unsigned int pressure = array_uint16_be (data + offset + pnf + idx[i]);
-					if (pressure < 0xFFF0) {
-						pressure &= 0x0FFF;
-						sample.pressure.tank = parser->tankidx[i];
-						sample.pressure.value = pressure * 2 * PSI / BAR;
-						if (callback) callback (DC_SAMPLE_PRESSURE, sample, userdata);
-					}
-				}
-
-				// Gas time remaining in minutes
-				// Values above 0xF0 are special codes:
-				//    0xFF Not paired
-				//    0xFE No communication
-				//    0xFD Not available in current mode
-				//    0xFC Not available because of DECO
-				//    0xFB Tank size or max pressure haven’t been set up
-				if (data[offset + pnf + 21] < 0xF0) {
-					sample.rbt = data[offset + pnf + 21];
-					if (callback) callback (DC_SAMPLE_RBT, sample, userdata);
-				}
-			}
+			rc = shearwater_predator_parser_dive_sample (parser, &state, data, offset, callback, userdata);
+			if (rc != DC_STATUS_SUCCESS)
+				return rc;
 		} else if (type == LOG_RECORD_FREEDIVE_SAMPLE) {
 			// A freedive record is actually 4 samples, each 8-bytes,
 			// packed into a standard 32-byte sized record. At the end
@@ -803,8 +840,8 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 				}
 
 				// Time (seconds).
-				time += interval;
-				sample.time = time;
+				state.time += state.interval;
+				sample.time = state.time;
 				if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
 
 				// Depth (absolute pressure in millibar)
@@ -19,6 +19,8 @@
  * MA 02110-1301 USA
  */
 
+#include <stdlib.h>
+
 #include "socket.h"
 
 #include "common-private.h"
@@ -41,10 +43,19 @@ dc_socket_syserror (s_errcode_t errcode)
 	}
 }
 
-dc_status_t
-dc_socket_init (dc_context_t *context)
-{
 #ifdef _WIN32
+/*
+ * The winsock library is initialized once per context, on first use, and
+ * terminated when the context is freed.
+ */
+typedef struct dc_socket_session_t {
+	size_t refcount;
+	dc_context_t *context;
+} dc_socket_session_t;
+
+static dc_status_t
+dc_socket_startup (dc_context_t *context)
+{
 	// Initialize the winsock dll.
 	WSADATA wsaData;
 	WORD wVersionRequested = MAKEWORD (2, 2);
@@ -60,23 +71,109 @@ dc_socket_init (dc_context_t *context)
 	if (LOBYTE (wsaData.wVersion) != 2 ||
 		HIBYTE (wsaData.wVersion) != 2) {
 		ERROR (context, "Incorrect winsock version.");
+		WSACleanup ();
 		return DC_STATUS_UNSUPPORTED;
 	}
-#endif
 
 	return DC_STATUS_SUCCESS;
 }
 
-dc_status_t
-dc_socket_exit (dc_context_t *context)
+static dc_status_t
+dc_socket_cleanup (dc_context_t *context)
 {
-#ifdef _WIN32
 	// Terminate the winsock dll.
 	if (WSACleanup () != 0) {
 		s_errcode_t errcode = S_ERRNO;
 		SYSERROR (context, errcode);
 		return dc_socket_syserror(errcode);
 	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_socket_session_create (void **out, dc_context_t *context)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_socket_session_t *session = NULL;
+
+	session = (dc_socket_session_t *) malloc (sizeof (dc_socket_session_t));
+	if (session == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	status = dc_socket_startup (context);
+	if (status != DC_STATUS_SUCCESS) {
+		free (session);
+		return status;
+	}
+
+	session->refcount = 1;
+	session->context = context;
+
+	*out = session;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void *
+dc_socket_session_ref (void *resource)
+{
+	dc_socket_session_t *session = (dc_socket_session_t *) resource;
+
+	session->refcount++;
+
+	return session;
+}
+
+static dc_status_t
+dc_socket_session_unref (void *resource)
+{
+	dc_socket_session_t *session = (dc_socket_session_t *) resource;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (--session->refcount == 0) {
+		status = dc_socket_cleanup (session->context);
+		free (session);
+	}
+
+	return status;
+}
+
+static const dc_resource_vtable_t dc_socket_session_vtable = {
+	dc_socket_session_create,
+	dc_socket_session_ref,
+	dc_socket_session_unref,
+};
+#endif
+
+dc_status_t
+dc_socket_init (dc_context_t *context)
+{
+#ifdef _WIN32
+	if (context == NULL)
+		return dc_socket_startup (context);
+
+	// The context keeps its own reference, and terminates the library
+	// when it is freed.
+	void *session = NULL;
+	dc_status_t status = dc_context_get_resource (context, DC_RESOURCE_SOCKET, &dc_socket_session_vtable, &session);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_socket_session_unref (session);
+#endif
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_socket_exit (dc_context_t *context)
+{
+#ifdef _WIN32
+	if (context == NULL)
+		return dc_socket_cleanup (context);
 #endif
 
 	return DC_STATUS_SUCCESS;
@@ -153,6 +250,122 @@ dc_socket_connect (dc_iostream_t *abstract, const struct sockaddr *addr, s_sockl
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+dc_socket_set_blocking (dc_iostream_t *abstract, int blocking)
+{
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+
+#ifdef _WIN32
+	unsigned long mode = blocking ? 0 : 1;
+	if (ioctlsocket (socket->fd, FIONBIO, &mode) != 0) {
+#else
+	int flags = fcntl (socket->fd, F_GETFL);
+	if (flags < 0 || fcntl (socket->fd, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK)) != 0) {
+#endif
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (abstract->context, errcode);
+		return dc_socket_syserror(errcode);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_socket_connect_start (dc_iostream_t *abstract, const struct sockaddr *addr, s_socklen_t addrlen, int *pending)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+
+	*pending = 0;
+
+	status = dc_socket_set_blocking (abstract, 0);
+	if (status != DC_STATUS_SUCCESS) {
+		return status;
+	}
+
+	if (connect (socket->fd, addr, addrlen) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		if (errcode == S_EINPROGRESS) {
+			*pending = 1;
+			return DC_STATUS_SUCCESS;
+		}
+		SYSERROR (abstract->context, errcode);
+		dc_socket_set_blocking (abstract, 1);
+		return dc_socket_syserror(errcode);
+	}
+
+	return dc_socket_set_blocking (abstract, 1);
+}
+
+dc_status_t
+dc_socket_connect_finish (dc_iostream_t *abstract)
+{
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+
+	int error = 0;
+	s_socklen_t size = sizeof (error);
+	if (getsockopt (socket->fd, SOL_SOCKET, SO_ERROR, (char *) &error, &size) != 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (abstract->context, errcode);
+		dc_socket_set_blocking (abstract, 1);
+		return dc_socket_syserror(errcode);
+	}
+
+	if (error != 0) {
+		SYSERROR (abstract->context, error);
+		dc_socket_set_blocking (abstract, 1);
+		return dc_socket_syserror(error);
+	}
+
+	return dc_socket_set_blocking (abstract, 1);
+}
+
+dc_status_t
+dc_socket_connect_timeout (dc_iostream_t *abstract, const struct sockaddr *addr, s_socklen_t addrlen, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+	int pending = 0;
+	int rc = 0;
+
+	if (timeout < 0)
+		return dc_socket_connect (abstract, addr, addrlen);
+
+	status = dc_socket_connect_start (abstract, addr, addrlen, &pending);
+	if (status != DC_STATUS_SUCCESS || !pending) {
+		return status;
+	}
+
+	do {
+		// A failed connection is reported in the exception set on
+		// Windows, and in the write set elsewhere.
+		fd_set wfds, efds;
+		FD_ZERO (&wfds);
+		FD_ZERO (&efds);
+		FD_SET (socket->fd, &wfds);
+		FD_SET (socket->fd, &efds);
+
+		struct timeval tv;
+		tv.tv_sec  = (timeout / 1000);
+		tv.tv_usec = (timeout % 1000) * 1000;
+
+		rc = select (socket->fd + 1, NULL, &wfds, &efds, &tv);
+	} while (rc < 0 && S_ERRNO == S_EINTR);
+
+	if (rc < 0) {
+		s_errcode_t errcode = S_ERRNO;
+		SYSERROR (abstract->context, errcode);
+		dc_socket_set_blocking (abstract, 1);
+		return dc_socket_syserror(errcode);
+	} else if (rc == 0) {
+		ERROR (abstract->context, "Connection timed out.");
+		dc_socket_set_blocking (abstract, 1);
+		return DC_STATUS_TIMEOUT;
+	}
+
+	return dc_socket_connect_finish (abstract);
+}
+
 dc_status_t
 dc_socket_set_timeout (dc_iostream_t *abstract, int timeout)
 {
@@ -222,6 +435,20 @@ dc_socket_poll (dc_iostream_t *abstract, int timeout)
 	}
 }
 
+dc_status_t
+dc_socket_get_fd (dc_iostream_t *abstract, int *fd)
+{
+#ifdef _WIN32
+	return DC_STATUS_UNSUPPORTED;
+#else
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+
+	*fd = socket->fd;
+
+	return DC_STATUS_SUCCESS;
+#endif
+}
+
 dc_status_t
 dc_socket_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 {
@@ -30,6 +30,7 @@
 #else
 #include <errno.h>      // errno
 #include <unistd.h>     // close
+#include <fcntl.h>      // fcntl
 #include <sys/types.h>  // socket, getsockopt
 #include <sys/socket.h> // socket, getsockopt
 #include <sys/select.h> // select
@@ -51,6 +52,7 @@ typedef int s_socklen_t;
 #define S_ERRNO WSAGetLastError ()
 #define S_EINTR WSAEINTR
 #define S_EAGAIN WSAEWOULDBLOCK
+#define S_EINPROGRESS WSAEWOULDBLOCK
 #define S_ENOMEM WSA_NOT_ENOUGH_MEMORY
 #define S_EINVAL WSAEINVAL
 #define S_EACCES WSAEACCES
@@ -66,6 +68,7 @@ typedef socklen_t s_socklen_t;
 #define S_ERRNO errno
 #define S_EINTR EINTR
 #define S_EAGAIN EAGAIN
+#define S_EINPROGRESS EINPROGRESS
 #define S_ENOMEM ENOMEM
 #define S_EINVAL EINVAL
 #define S_EACCES EACCES
@@ -103,6 +106,27 @@ dc_socket_close (dc_iostream_t *iostream);
 dc_status_t
 dc_socket_connect (dc_iostream_t *iostream, const struct sockaddr *addr, s_socklen_t addrlen);
 
+/*
+ * Non-blocking connect. The connection is started with
+ * dc_socket_connect_start, which sets pending if the connection is still
+ * in progress. In that case, the socket becomes writable once the
+ * connection is established or has failed, and dc_socket_connect_finish
+ * reports the result. Both functions restore the blocking mode when the
+ * connection is complete.
+ */
+dc_status_t
+dc_socket_connect_start (dc_iostream_t *iostream, const struct sockaddr *addr, s_socklen_t addrlen, int *pending);
+
+dc_status_t
+dc_socket_connect_finish (dc_iostream_t *iostream);
+
+/*
+ * Connect with a timeout in milliseconds, or without a timeout for a
+ * negative value.
+ */
+dc_status_t
+dc_socket_connect_timeout (dc_iostream_t *iostream, const struct sockaddr *addr, s_socklen_t addrlen, int timeout);
+
 dc_status_t
 dc_socket_set_timeout (dc_iostream_t *iostream, int timeout);
 
@@ -112,6 +136,9 @@ dc_socket_get_available (dc_iostream_t *iostream, size_t *value);
 dc_status_t
 dc_socket_poll (dc_iostream_t *iostream, int timeout);
 
+dc_status_t
+dc_socket_get_fd (dc_iostream_t *iostream, int *fd);
+
 dc_status_t
 dc_socket_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 
@@ -0,0 +1,295 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libdivecomputer/statistics.h>
+
+#include "context-private.h"
+
+#define SURFACE 1.01325 // bar
+
+struct dc_statistics_t {
+	dc_context_t *context;
+	dc_statistics_config_t config;
+	double atmospheric;
+	double volumes[DC_STATISTICS_NTANKS];
+	dc_statistics_result_t result;
+	unsigned int time;
+	unsigned int ndepths;
+	unsigned int begin;
+	unsigned int previous;
+	double depth;
+	double area;
+	unsigned int violation;
+};
+
+dc_status_t
+dc_statistics_new (dc_statistics_t **out, dc_context_t *context, const dc_statistics_config_t *config)
+{
+	dc_statistics_t *statistics = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (config) {
+		if (config->nbands > DC_STATISTICS_NBANDS || config->ascentrate < 0.0)
+			return DC_STATUS_INVALIDARGS;
+		for (unsigned int i = 1; i < config->nbands; ++i) {
+			if (config->bands[i] <= config->bands[i - 1])
+				return DC_STATUS_INVALIDARGS;
+		}
+	}
+
+	statistics = (dc_statistics_t *) malloc (sizeof (dc_statistics_t));
+	if (statistics == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	statistics->context = context;
+	if (config)
+		statistics->config = *config;
+	else
+		memset (&statistics->config, 0, sizeof (statistics->config));
+
+	dc_statistics_reset (statistics, 0.0);
+
+	*out = statistics;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_statistics_reset (dc_statistics_t *statistics, double atmospheric)
+{
+	if (statistics == NULL || atmospheric < 0.0)
+		return DC_STATUS_INVALIDARGS;
+
+	statistics->atmospheric = atmospheric > 0.0 ? atmospheric : SURFACE;
+	for (unsigned int i = 0; i < DC_STATISTICS_NTANKS; ++i)
+		statistics->volumes[i] = 0.0;
+
+	dc_statistics_result_t *result = &statistics->result;
+	memset (result, 0, sizeof (*result));
+	result->maxdepth = NAN;
+	result->avgdepth = NAN;
+	result->mintemperature = NAN;
+	result->maxtemperature = NAN;
+	result->maxascentrate = NAN;
+	result->sac = NAN;
+
+	statistics->time = 0;
+	statistics->ndepths = 0;
+	statistics->begin = 0;
+	statistics->previous = 0;
+	statistics->depth = 0.0;
+	statistics->area = 0.0;
+	statistics->violation = 0;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_statistics_set_volume (dc_statistics_t *statistics, unsigned int tank, double volume)
+{
+	if (statistics == NULL || tank >= DC_STATISTICS_NTANKS || volume < 0.0)
+		return DC_STATUS_INVALIDARGS;
+
+	statistics->volumes[tank] = volume;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static unsigned int
+dc_statistics_band (const dc_statistics_config_t *config, double depth)
+{
+	unsigned int i = 0;
+	while (i < config->nbands && depth >= config->bands[i])
+		i++;
+
+	return i;
+}
+
+/*
+ * Account for the segment between the previous depth sample and the
+ * current one, assuming a constant rate in between.
+ */
+static void
+dc_statistics_segment (dc_statistics_t *statistics, double depth)
+{
+	dc_statistics_result_t *result = &statistics->result;
+	unsigned int duration = statistics->time - statistics->previous;
+	if (statistics->time < statistics->previous || duration == 0)
+		return;
+
+	double mean = (statistics->depth + depth) / 2.0;
+	statistics->area += mean * duration;
+	result->bands[dc_statistics_band (&statistics->config, mean)] += duration;
+
+	double rate = (statistics->depth - depth) * 60.0 / duration;
+	if (rate > 0.0 && (isnan (result->maxascentrate) || rate > result->maxascentrate))
+		result->maxascentrate = rate;
+
+	if (statistics->config.ascentrate > 0.0 && rate > statistics->config.ascentrate) {
+		if (!statistics->violation)
+			result->ascents++;
+		result->ascenttime += duration;
+		statistics->violation = 1;
+	} else {
+		statistics->violation = 0;
+	}
+}
+
+static void
+dc_statistics_pressure (dc_statistics_t *statistics, unsigned int tank, double pressure)
+{
+	dc_statistics_result_t *result = &statistics->result;
+
+	unsigned int i = 0;
+	while (i < result->ntanks && result->tanks[i].tank != tank)
+		i++;
+
+	if (i == result->ntanks) {
+		if (result->ntanks == DC_STATISTICS_NTANKS)
+			return;
+		result->tanks[i].tank = tank;
+		result->tanks[i].beginpressure = pressure;
+		result->ntanks++;
+	}
+
+	result->tanks[i].endpressure = pressure;
+}
+
+void
+dc_statistics_sample (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_statistics_t *statistics = (dc_statistics_t *) userdata;
+	dc_statistics_result_t *result = &statistics->result;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		statistics->time = value.time;
+		if (result->divetime < value.time)
+			result->divetime = value.time;
+		break;
+	case DC_SAMPLE_DEPTH:
+		if (statistics->ndepths == 0)
+			statistics->begin = statistics->time;
+		else
+			dc_statistics_segment (statistics, value.depth);
+		if (statistics->ndepths == 0 || result->maxdepth < value.depth)
+			result->maxdepth = value.depth;
+		statistics->ndepths++;
+		statistics->previous = statistics->time;
+		statistics->depth = value.depth;
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		if (isnan (result->mintemperature) || value.temperature < result->mintemperature)
+			result->mintemperature = value.temperature;
+		if (isnan (result->maxtemperature) || value.temperature > result->maxtemperature)
+			result->maxtemperature = value.temperature;
+		break;
+	case DC_SAMPLE_PRESSURE:
+		dc_statistics_pressure (statistics, value.pressure.tank, value.pressure.value);
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+dc_statistics_get (dc_statistics_t *statistics, dc_statistics_result_t *result)
+{
+	if (statistics == NULL || result == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	*result = statistics->result;
+
+	unsigned int duration = statistics->previous - statistics->begin;
+	if (statistics->ndepths && duration)
+		result->avgdepth = statistics->area / duration;
+	else if (statistics->ndepths)
+		result->avgdepth = statistics->depth;
+
+	// The gas consumption of all tanks with a known volume, at the mean
+	// ambient pressure of the dive.
+	double consumed = 0.0;
+	unsigned int nvolumes = 0;
+	for (unsigned int i = 0; i < result->ntanks; ++i) {
+		dc_statistics_tank_t *tank = result->tanks + i;
+		tank->volume = tank->tank < DC_STATISTICS_NTANKS ? statistics->volumes[tank->tank] : 0.0;
+		if (tank->volume > 0.0) {
+			consumed += (tank->beginpressure - tank->endpressure) * tank->volume;
+			nvolumes++;
+		}
+	}
+
+	if (nvolumes && duration) {
+		double ambient = statistics->atmospheric + result->avgdepth / 10.0;
+		result->sac = consumed / (duration / 60.0) / ambient;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_statistics_process (dc_statistics_t *statistics, dc_parser_t *parser, dc_statistics_result_t *result)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (statistics == NULL || parser == NULL || result == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	double atmospheric = 0.0;
+	if (dc_parser_get_field (parser, DC_FIELD_ATMOSPHERIC, 0, &atmospheric) != DC_STATUS_SUCCESS ||
+		atmospheric < 0.0)
+		atmospheric = 0.0;
+
+	dc_statistics_reset (statistics, atmospheric);
+
+	unsigned int ntanks = 0;
+	if (dc_parser_get_field (parser, DC_FIELD_TANK_COUNT, 0, &ntanks) != DC_STATUS_SUCCESS)
+		ntanks = 0;
+	for (unsigned int i = 0; i < ntanks && i < DC_STATISTICS_NTANKS; ++i) {
+		dc_tank_t tank;
+		if (dc_parser_get_field (parser, DC_FIELD_TANK, i, &tank) != DC_STATUS_SUCCESS)
+			break;
+		if (tank.type != DC_TANKVOLUME_NONE && tank.volume > 0.0)
+			statistics->volumes[i] = tank.volume;
+	}
+
+	status = dc_parser_samples_foreach (parser, dc_statistics_sample, statistics);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	return dc_statistics_get (statistics, result);
+}
+
+dc_status_t
+dc_statistics_free (dc_statistics_t *statistics)
+{
+	free (statistics);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -109,22 +109,16 @@ suunto_common_extract_dives (suunto_common_device_t *device, const suunto_common
 		// to find the start of the current dive.
 		unsigned int idx = RB_PROFILE_PEEK (current, layout);
 		if (data[idx] == 0x80) {
+			// Only a dive that wraps around is copied.
 			unsigned int len = RB_PROFILE_DISTANCE (current, previous, layout);
-			if (current + len > layout->rb_profile_end) {
-				unsigned int a = layout->rb_profile_end - current;
-				unsigned int b = (current + len) - layout->rb_profile_end;
-				memcpy (buffer + 0, data + current, a);
-				memcpy (buffer + a, data + layout->rb_profile_begin,   b);
-			} else {
-				memcpy (buffer, data + current, len);
-			}
+			const unsigned char *dive = ringbuffer_view (buffer, data, current, len, layout->rb_profile_begin, layout->rb_profile_end);
 
-			if (device && memcmp (buffer + layout->fp_offset, device->fingerprint, sizeof (device->fingerprint)) == 0) {
+			if (device && memcmp (dive + layout->fp_offset, device->fingerprint, sizeof (device->fingerprint)) == 0) {
 				free (buffer);
 				return DC_STATUS_SUCCESS;
 			}
 
-			if (callback && !callback (buffer, len, buffer + layout->fp_offset, sizeof (device->fingerprint), userdata)) {
+			if (callback && !callback (dive, len, dive + layout->fp_offset, sizeof (device->fingerprint), userdata)) {
 				free (buffer);
 				return DC_STATUS_SUCCESS;
 			}
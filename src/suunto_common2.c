@@ -29,6 +29,7 @@
 #include "rbstream.h"
 #include "checksum.h"
 #include "array.h"
+#include "retry.h"
 
 #define MAXRETRIES 2
 
@@ -36,6 +37,8 @@
 #define SZ_PACKET     0x78
 #define SZ_MINIMUM    8
 
+#define PREFETCH 4
+
 #define RB_PROFILE_DISTANCE(l,a,b,m)  ringbuffer_distance (a, b, m, l->rb_profile_begin, l->rb_profile_end)
 
 #define VTABLE(abstract)	((const suunto_common2_device_vtable_t *) abstract->vtable)
@@ -52,6 +55,8 @@ suunto_common2_device_init (suunto_common2_device_t *device)
 }
 
 
+static const dc_retry_policy_t suunto_common2_retry = {MAXRETRIES, 0, 0, 0};
+
 static dc_status_t
 suunto_common2_transfer (dc_device_t *abstract, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int size)
 {
@@ -65,16 +70,12 @@ suunto_common2_transfer (dc_device_t *abstract, const unsigned char command[], u
 	// returning an error. Usually the dive computer will respond
 	// again during one of the retries.
 
-	unsigned int nretries = 0;
+	dc_retry_t retry;
+	dc_retry_init (&retry, &suunto_common2_retry);
+
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = VTABLE (abstract)->packet (abstract, command, csize, answer, asize, size)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
+		if (!dc_retry_again (&retry, NULL, rc))
 			return rc;
 	}
 
@@ -311,7 +312,7 @@ suunto_common2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 
 	// Create the ringbuffer stream.
 	dc_rbstream_t *rbstream = NULL;
-	rc = dc_rbstream_new (&rbstream, abstract, 1, SZ_PACKET, layout->rb_profile_begin, layout->rb_profile_end, end);
+	rc = dc_rbstream_new2 (&rbstream, abstract, 1, SZ_PACKET, PREFETCH, layout->rb_profile_begin, layout->rb_profile_end, end);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		return rc;
@@ -344,7 +345,8 @@ suunto_common2_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 		// Move to the begin of the current dive.
 		offset -= size;
 
-		// Read the dive.
+		// Read the dive, without reading ahead into the next one.
+		dc_rbstream_limit (rbstream, size);
 		rc = dc_rbstream_read (rbstream, &progress, data + offset, size);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
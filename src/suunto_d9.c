@@ -54,10 +54,12 @@ static const suunto_common2_device_vtable_t suunto_d9_device_vtable = {
 		DC_FAMILY_SUUNTO_D9,
 		suunto_common2_device_set_fingerprint, /* set_fingerprint */
 		suunto_common2_device_read, /* read */
+		NULL, /* read_multi */
 		suunto_common2_device_write, /* write */
 		suunto_common2_device_dump, /* dump */
 		suunto_common2_device_foreach, /* foreach */
 		NULL, /* timesync */
+		NULL, /* keepalive */
 		NULL /* close */
 	},
 	suunto_d9_device_packet
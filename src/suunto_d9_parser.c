@@ -30,6 +30,7 @@
 #define ISINSTANCE(parser) dc_parser_isinstance((parser), &suunto_d9_parser_vtable)
 
 #define MAXPARAMS 3
+#define MAXPERIOD 256
 #define NGASMIXES 11
 
 #define D9       0x0E
@@ -91,6 +92,16 @@ typedef struct sample_info_t {
 	unsigned int divisor;
 } sample_info_t;
 
+/*
+ * The parameters present in a sample, with their byte offsets relative
+ * to the start of the sample.
+ */
+typedef struct sample_layout_t {
+	unsigned int mask;
+	unsigned int size;
+	unsigned int offset[MAXPARAMS];
+} sample_layout_t;
+
 static dc_status_t suunto_d9_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
 static dc_status_t suunto_d9_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t suunto_d9_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
@@ -414,6 +425,40 @@ suunto_d9_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigne
 }
 
 
+static void
+suunto_d9_parser_layout (sample_layout_t *layout, const sample_info_t info[], unsigned int nparams, unsigned int n)
+{
+	layout->mask = 0;
+	layout->size = 0;
+	for (unsigned int i = 0; i < nparams; ++i) {
+		layout->offset[i] = layout->size;
+		if (info[i].interval && (n % info[i].interval) == 0) {
+			layout->mask |= 1u << i;
+			layout->size += info[i].size;
+		}
+	}
+}
+
+static unsigned int
+suunto_d9_parser_period (const sample_info_t info[], unsigned int nparams)
+{
+	unsigned int period = 1;
+	for (unsigned int i = 0; i < nparams; ++i) {
+		unsigned int a = period, b = info[i].interval;
+		if (b == 0)
+			continue;
+		while (b) {
+			unsigned int t = a % b;
+			a = b;
+			b = t;
+		}
+		period = period / a * info[i].interval;
+		if (period > MAXPERIOD)
+			return 0;
+	}
+	return period;
+}
+
 static dc_status_t
 suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
 {
@@ -489,12 +534,23 @@ suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t ca
 		return DC_STATUS_DATAFORMAT;
 	}
 
+	// The parameters repeat with a period equal to the least common
+	// multiple of their intervals. The layout of all samples within one
+	// period is compiled in advance. For a longer period, the layout is
+	// computed for every sample.
+	sample_layout_t schedule[MAXPERIOD];
+	unsigned int period = suunto_d9_parser_period (info, nparams);
+	for (unsigned int i = 0; i < period; ++i) {
+		suunto_d9_parser_layout (schedule + i, info, nparams, i);
+	}
+
 	// Offset to the first marker position.
 	unsigned int marker = array_uint16_le (data + profile + 3);
 
 	unsigned int in_deco = 0;
 	unsigned int time = 0;
 	unsigned int nsamples = 0;
+	unsigned int phase = 0;
 	unsigned int offset = profile + 5;
 	while (offset < size) {
 		dc_sample_value_t sample = {0};
@@ -503,41 +559,53 @@ suunto_d9_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t ca
 		sample.time = time;
 		if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
 
+		// Get the layout of the sample.
+		sample_layout_t computed;
+		const sample_layout_t *layout = &computed;
+		if (period) {
+			layout = schedule + phase;
+			if (++phase == period)
+				phase = 0;
+		} else {
+			suunto_d9_parser_layout (&computed, info, nparams, nsamples);
+		}
+
 		// Sample data.
 		for (unsigned int i = 0; i < nparams; ++i) {
-			if (info[i].interval && (nsamples % info[i].interval) == 0) {
-				if (offset + info[i].size > size) {
-					ERROR (abstract->context, "Buffer overflow detected!");
-					return DC_STATUS_DATAFORMAT;
-				}
+			if ((layout->mask & (1u << i)) == 0)
+				continue;
 
-				unsigned int value = 0;
-				switch (info[i].type) {
-				case 0x64: // Depth
-					value = array_uint16_le (data + offset);
-					sample.depth = value / (double) info[i].divisor;
-					if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
-					break;
-				case 0x68: // Pressure
-					value = array_uint16_le (data + offset);
-					if (value != 0xFFFF) {
-						sample.pressure.tank = 0;
-						sample.pressure.value = value / (double) info[i].divisor;
-						if (callback) callback (DC_SAMPLE_PRESSURE, sample, userdata);
-					}
-					break;
-				case 0x74: // Temperature
-					sample.temperature = (signed char) data[offset] / (double) info[i].divisor;
-					if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
-					break;
-				default: // Unknown sample type
-					ERROR (abstract->context, "Unknown sample type 0x%02x.", info[i].type);
-					return DC_STATUS_DATAFORMAT;
-				}
+			unsigned int idx = offset + layout->offset[i];
+			if (idx + info[i].size > size) {
+				ERROR (abstract->context, "Buffer overflow detected!");
+				return DC_STATUS_DATAFORMAT;
+			}
 
-				offset += info[i].size;
+			unsigned int value = 0;
+			switch (info[i].type) {
+			case 0x64: // Depth
+				value = array_uint16_le (data + idx);
+				sample.depth = value / (double) info[i].divisor;
+				if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
+				break;
+			case 0x68: // Pressure
+				value = array_uint16_le (data + idx);
+				if (value != 0xFFFF) {
+					sample.pressure.tank = 0;
+					sample.pressure.value = value / (double) info[i].divisor;
+					if (callback) callback (DC_SAMPLE_PRESSURE, sample, userdata);
+				}
+				break;
+			case 0x74: // Temperature
+				sample.temperature = (signed char) data[idx] / (double) info[i].divisor;
+				if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
+				break;
+			default: // Unknown sample type
+				ERROR (abstract->context, "Unknown sample type 0x%02x.", info[i].type);
+				return DC_STATUS_DATAFORMAT;
 			}
 		}
+		offset += layout->size;
 
 		// Initial gasmix.
 		if (time == 0 && parser->ngasmixes > 0) {
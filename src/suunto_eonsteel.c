@@ -23,8 +23,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libdivecomputer/ble.h>
+
 #include "suunto_eonsteel.h"
 #include "context-private.h"
+#include "iostream-private.h"
 #include "device-private.h"
 #include "array.h"
 #include "platform.h"
@@ -39,6 +42,8 @@ typedef struct suunto_eonsteel_device_t {
 	unsigned int model;
 	unsigned int magic;
 	unsigned short seq;
+	unsigned int window;
+	unsigned int mtu;
 	unsigned char version[0x30];
 	unsigned char fingerprint[4];
 } suunto_eonsteel_device_t;
@@ -48,12 +53,19 @@ typedef struct suunto_eonsteel_device_t {
 #define DIRTYPE_DIR  0x0002
 
 struct directory_entry {
-	struct directory_entry *next;
-	int type;
+	unsigned int time;
 	int namelen;
 	char name[1];
 };
 
+// The dive files, sorted with the most recent dive first
+struct file_list {
+	struct directory_entry **entries;
+	unsigned int count;
+	unsigned int capacity;
+	unsigned int invalid;
+};
+
 // EON Steel command numbers and other magic field values
 #define CMD_INIT	0x0000
 #define INIT_MAGIC	0x0001
@@ -75,11 +87,17 @@ struct directory_entry {
 #define CMD_SET_DATE	0x0203
 #define CMD_GET_DATE	0x0303
 
+#define READ_WINDOW 2
+
 #define PACKET_SIZE 64
 #define HEADER_SIZE 12
 #define MAXDATA_SIZE 2048
 #define CRC_SIZE    4
 
+// BLE packet size (without and with a larger MTU)
+#define SZ_PACKET_BLE 20
+#define SZ_PACKET_MAX 512
+
 // HDLC special characters
 #define END     0x7E
 #define ESC     0x7D
@@ -94,32 +112,33 @@ static const dc_device_vtable_t suunto_eonsteel_device_vtable = {
 	DC_FAMILY_SUUNTO_EONSTEEL,
 	suunto_eonsteel_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	suunto_eonsteel_device_foreach, /* foreach */
 	suunto_eonsteel_device_timesync, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
 static const char dive_directory[] = "0:/dives";
 
-static void file_list_free (struct directory_entry *de)
+static void file_list_free (struct file_list *list)
 {
-	while (de) {
-		struct directory_entry *next = de->next;
-		free (de);
-		de = next;
-	}
+	for (unsigned int i = 0; i < list->count; ++i)
+		free (list->entries[i]);
+	free (list->entries);
+	list->entries = NULL;
+	list->count = list->capacity = 0;
 }
 
-static struct directory_entry *alloc_dirent(int type, int len, const char *name)
+static struct directory_entry *alloc_dirent(unsigned int time, int len, const char *name)
 {
 	struct directory_entry *res;
 
 	res = (struct directory_entry *) malloc(offsetof(struct directory_entry, name) + len + 1);
 	if (res) {
-		res->next = NULL;
-		res->type = type;
+		res->time = time;
 		res->namelen = len;
 		memcpy(res->name, name, len);
 		res->name[len] = 0;
@@ -127,6 +146,22 @@ static struct directory_entry *alloc_dirent(int type, int len, const char *name)
 	return res;
 }
 
+static int file_list_append (struct file_list *list, struct directory_entry *entry)
+{
+	if (list->count == list->capacity) {
+		unsigned int capacity = list->capacity ? list->capacity * 2 : 64;
+		struct directory_entry **entries = (struct directory_entry **) realloc (list->entries, capacity * sizeof (*entries));
+		if (entries == NULL)
+			return -1;
+		list->entries = entries;
+		list->capacity = capacity;
+	}
+
+	list->entries[list->count++] = entry;
+
+	return 0;
+}
+
 static void put_le16(unsigned short val, unsigned char *p)
 {
 	p[0] = val;
@@ -141,75 +176,73 @@ static void put_le32(unsigned int val, unsigned char *p)
 	p[3] = val >> 24;
 }
 
-static dc_status_t
-suunto_eonsteel_hdlc_write (suunto_eonsteel_device_t *device, const unsigned char data[], size_t size, size_t *actual)
+/*
+ * Encode a complete HDLC frame. The output buffer needs room for twice
+ * the input size (every byte escaped), plus the two frame markers.
+ */
+static size_t
+suunto_eonsteel_hdlc_encode (unsigned char out[], const unsigned char data[], size_t size)
 {
-	dc_status_t status = DC_STATUS_SUCCESS;
-	unsigned char buffer[20];
 	size_t nbytes = 0;
 
 	// Start of the packet.
-	buffer[nbytes++] = END;
+	out[nbytes++] = END;
 
 	for (size_t i = 0; i < size; ++i) {
 		unsigned char c = data[i];
 
 		if (c == END || c == ESC) {
-			// Append the escape character.
-			buffer[nbytes++] = ESC;
-
-			// Flush the buffer if necessary.
-			if (nbytes >= sizeof(buffer)) {
-				status = dc_iostream_write(device->iostream, buffer, nbytes, NULL);
-				if (status != DC_STATUS_SUCCESS) {
-					ERROR(device->base.context, "Failed to send the packet.");
-					return status;
-				}
-
-				nbytes = 0;
-			}
-
-			// Escape the character.
+			out[nbytes++] = ESC;
 			c ^= ESC_BIT;
 		}
 
-		// Append the character.
-		buffer[nbytes++] = c;
+		out[nbytes++] = c;
+	}
 
-		// Flush the buffer if necessary.
-		if (nbytes >= sizeof(buffer)) {
-			status = dc_iostream_write(device->iostream, buffer, nbytes, NULL);
-			if (status != DC_STATUS_SUCCESS) {
-				ERROR(device->base.context, "Failed to send the packet.");
-				return status;
-			}
+	// End of the packet.
+	out[nbytes++] = END;
 
-			nbytes = 0;
-		}
+	return nbytes;
+}
+
+static dc_status_t
+suunto_eonsteel_hdlc_write (suunto_eonsteel_device_t *device, const unsigned char data[], size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned char buffer[2 * (HEADER_SIZE + PACKET_SIZE + CRC_SIZE) + 2];
+
+	if (2 * size + 2 > sizeof(buffer)) {
+		ERROR(device->base.context, "Insufficient buffer space available.");
+		return DC_STATUS_PROTOCOL;
 	}
 
-	// End of the packet.
-	buffer[nbytes++] = END;
+	size_t nbytes = suunto_eonsteel_hdlc_encode(buffer, data, size);
 
-	// Flush the buffer.
-	status = dc_iostream_write(device->iostream, buffer, nbytes, NULL);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR(device->base.context, "Failed to send the packet.");
-		return status;
+	// Send the whole frame in packets of the negotiated size. With a
+	// large enough MTU, that's a single write per command.
+	for (size_t offset = 0; offset < nbytes; offset += device->mtu) {
+		size_t len = nbytes - offset;
+		if (len > device->mtu)
+			len = device->mtu;
+
+		status = dc_iostream_write(device->iostream, buffer + offset, len, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR(device->base.context, "Failed to send the packet.");
+			return status;
+		}
 	}
 
 	if (actual)
 		*actual = size;
 
 	return status;
-
 }
 
 static dc_status_t
 suunto_eonsteel_hdlc_read (suunto_eonsteel_device_t *device, unsigned char data[], size_t size, size_t *actual)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
-	unsigned char buffer[20];
+	unsigned char buffer[SZ_PACKET_MAX];
 	unsigned int initialized = 0;
 	unsigned int escaped = 0;
 	size_t nbytes = 0;
@@ -217,13 +250,28 @@ suunto_eonsteel_hdlc_read (suunto_eonsteel_device_t *device, unsigned char data[
 	while (1) {
 		// Read a single data packet.
 		size_t transferred = 0;
-		status = dc_iostream_read(device->iostream, buffer, sizeof(buffer), &transferred);
+		status = dc_iostream_read(device->iostream, buffer, device->mtu, &transferred);
 		if (status != DC_STATUS_SUCCESS) {
 			ERROR(device->base.context, "Failed to receive the packet.");
 			return status;
 		}
 
 		for (size_t i = 0; i < transferred; ++i) {
+			// Copy the run of plain data bytes at once.
+			if (initialized && !escaped) {
+				size_t n = 0;
+				while (i + n < transferred && buffer[i + n] != END && buffer[i + n] != ESC)
+					n++;
+				if (n) {
+					if (nbytes < size)
+						memcpy(data + nbytes, buffer + i, nbytes + n <= size ? n : size - nbytes);
+					nbytes += n;
+					i += n;
+					if (i >= transferred)
+						break;
+				}
+			}
+
 			unsigned char c = buffer[i];
 
 			if (c == END) {
@@ -375,7 +423,7 @@ suunto_eonsteel_receive_ble(suunto_eonsteel_device_t *device, unsigned char data
 
 static dc_status_t
 suunto_eonsteel_send(suunto_eonsteel_device_t *device,
-	unsigned short cmd,
+	unsigned short cmd, unsigned short seq,
 	const unsigned char data[],
 	unsigned int size)
 {
@@ -400,7 +448,7 @@ suunto_eonsteel_send(suunto_eonsteel_device_t *device,
 	put_le32(device->magic, buf + 4);
 
 	// 2-byte LE sequence number;
-	put_le16(device->seq, buf + 8);
+	put_le16(seq, buf + 8);
 
 	// 4-byte LE length
 	put_le32(size, buf + 10);
@@ -430,7 +478,7 @@ suunto_eonsteel_send(suunto_eonsteel_device_t *device,
 }
 
 /*
- * Send a command, receive a reply
+ * Receive the reply to a command
  *
  * This carefully checks the data fields in the reply for a match
  * against the command, and then only returns the actual reply
@@ -443,9 +491,8 @@ suunto_eonsteel_send(suunto_eonsteel_device_t *device,
  * send() side. The offsets are the same in the actual raw packet.
  */
 static dc_status_t
-suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
-	unsigned short cmd,
-	const unsigned char data[], unsigned int size,
+suunto_eonsteel_receive(suunto_eonsteel_device_t *device,
+	unsigned short cmd, unsigned short expected,
 	unsigned char answer[], unsigned int asize,
 	unsigned int *actual)
 {
@@ -453,11 +500,6 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 	unsigned char header[HEADER_SIZE + MAXDATA_SIZE];
 	unsigned int len = 0;
 
-	// Send the command.
-	rc = suunto_eonsteel_send(device, cmd, data, size);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
-
 	if (dc_iostream_get_transport(device->iostream) == DC_TRANSPORT_BLE) {
 		// Receive the entire data packet.
 		rc = suunto_eonsteel_receive_ble(device, header, sizeof(header), &len);
@@ -495,8 +537,8 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 	}
 
 	// Verify the sequence number.
-	if (seq != device->seq) {
-		ERROR(device->base.context, "Unexpected sequence number (received %04x, expected %04x).", seq, device->seq);
+	if (seq != expected) {
+		ERROR(device->base.context, "Unexpected sequence number (received %04x, expected %04x).", seq, expected);
 		return DC_STATUS_PROTOCOL;
 	}
 
@@ -541,17 +583,48 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 		device->magic = (magic & 0xffff0000) | 0x0005;
 	}
 
-	// Increment the sequence number.
-	device->seq++;
-
 	if (actual)
 		*actual = nbytes;
 
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Send a command, receive a reply
+ */
 static dc_status_t
-read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
+suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
+	unsigned short cmd,
+	const unsigned char data[], unsigned int size,
+	unsigned char answer[], unsigned int asize,
+	unsigned int *actual)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	// Send the command.
+	rc = suunto_eonsteel_send(device, cmd, device->seq, data, size);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// Receive the reply.
+	rc = suunto_eonsteel_receive(device, cmd, device->seq, answer, asize, actual);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// Increment the sequence number.
+	device->seq++;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Read a file in chunks. With a window larger than one, multiple read
+ * requests are kept outstanding, such that the dive computer can already
+ * process the next request while the current reply is being received.
+ * The replies arrive in the order of the sequence numbers.
+ */
+static dc_status_t
+read_file_chunks(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf, unsigned int window)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	unsigned char result[2560];
@@ -585,20 +658,46 @@ read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 	size = array_uint32_le(result+4);
 	offset = 0;
 
+	// Reserve the space for the entire file upfront.
+	if (!dc_buffer_reserve (buf, dc_buffer_get_size (buf) + size)) {
+		ERROR (eon->base.context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned int asks[READ_WINDOW] = {0};
+	unsigned int requested = 0;
+	unsigned int pending = 0;
 	while (size > 0) {
 		unsigned int ask, got, at;
 
-		ask = size;
-		if (ask > 1024)
-			ask = 1024;
-		put_le32(1234, cmdbuf+0);	// Not file offset, after all
-		put_le32(ask, cmdbuf+4);	// Size of read
-		rc = suunto_eonsteel_transfer(eon, CMD_FILE_READ,
-			cmdbuf, 8, result, sizeof(result), &n);
+		// Send the read requests, without asking for more data than
+		// the remainder of the file.
+		while (pending < window && requested < size) {
+			ask = size - requested;
+			if (ask > 1024)
+				ask = 1024;
+			put_le32(1234, cmdbuf+0);	// Not file offset, after all
+			put_le32(ask, cmdbuf+4);	// Size of read
+			rc = suunto_eonsteel_send(eon, CMD_FILE_READ, eon->seq + pending, cmdbuf, 8);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR(eon->base.context, "unable to read %s", filename);
+				return rc;
+			}
+			asks[(eon->seq + pending) % READ_WINDOW] = ask;
+			requested += ask;
+			pending++;
+		}
+
+		rc = suunto_eonsteel_receive(eon, CMD_FILE_READ, eon->seq,
+			result, sizeof(result), &n);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR(eon->base.context, "unable to read %s", filename);
 			return rc;
 		}
+		requested -= asks[eon->seq % READ_WINDOW];
+		eon->seq++;
+		pending--;
+
 		if (n < 8) {
 			ERROR(eon->base.context, "got short read reply for %s", filename);
 			return DC_STATUS_PROTOCOL;
@@ -630,6 +729,18 @@ read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 		size -= got;
 	}
 
+	// Receive the replies to the remaining read requests.
+	while (pending) {
+		rc = suunto_eonsteel_receive(eon, CMD_FILE_READ, eon->seq,
+			result, sizeof(result), &n);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR(eon->base.context, "unable to read %s", filename);
+			return rc;
+		}
+		eon->seq++;
+		pending--;
+	}
+
 	rc = suunto_eonsteel_transfer(eon, CMD_FILE_CLOSE,
 		NULL, 0, result, sizeof(result), &n);
 	if (rc != DC_STATUS_SUCCESS) {
@@ -641,41 +752,61 @@ read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 	return DC_STATUS_SUCCESS;
 }
 
-/*
- * Insert a directory entry in the sorted list, most recent entry
- * first.
- *
- * The directory entry names are the timestamps as hex, so ordering
- * in alphabetical order ends up also ordering in date order!
- */
-static struct directory_entry *insert_dirent(struct directory_entry *entry, struct directory_entry *list)
+static dc_status_t
+read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 {
-	struct directory_entry **pos = &list, *next;
+	size_t initial = dc_buffer_get_size(buf);
 
-	while ((next = *pos) != NULL) {
-		/* Is this bigger (more recent) than the next entry? We're good! */
-		if (strcmp(entry->name, next->name) > 0)
-			break;
-		pos = &next->next;
-	}
-	entry->next = next;
-	*pos = entry;
+	dc_status_t rc = read_file_chunks(eon, filename, buf, eon->window);
+	if (rc == DC_STATUS_SUCCESS || eon->window == 1 ||
+		(rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL))
+		return rc;
+
+	// Read the file once more with a single outstanding request, if the
+	// firmware doesn't handle multiple requests. The file is closed
+	// first, and any late replies are discarded.
+	WARNING(eon->base.context, "Pipelined read requests failed. Falling back to a single request.");
+	eon->window = 1;
+	eon->seq++;
+	suunto_eonsteel_send(eon, CMD_FILE_CLOSE, eon->seq, NULL, 0);
+	dc_iostream_sleep(eon->iostream, 500);
+	dc_iostream_purge(eon->iostream, DC_DIRECTION_INPUT);
+	eon->seq += READ_WINDOW;
 
-	return list;
+	dc_buffer_resize(buf, initial);
+
+	return read_file_chunks(eon, filename, buf, eon->window);
+}
+
+/*
+ * Order the directory entries by timestamp, most recent entry first.
+ * That's intentional: for dives, we will want to look up the last
+ * dive first.
+ */
+static int compare_dirent(const void *a, const void *b)
+{
+	const struct directory_entry *x = *(const struct directory_entry * const *) a;
+	const struct directory_entry *y = *(const struct directory_entry * const *) b;
+
+	if (x->time > y->time)
+		return -1;
+	if (x->time < y->time)
+		return 1;
+	return 0;
 }
 
 /*
- * NOTE! This will create the list of dirent's in reverse order,
- * with the last dirent first. That's intentional: for dives,
- * we will want to look up the last dive first.
+ * Add the dive files to the list. The file names are the timestamps
+ * as hex. Subdirectories in the dive directory are ignored.
  */
-static struct directory_entry *parse_dirent(suunto_eonsteel_device_t *eon, int nr, const unsigned char *p, unsigned int len, struct directory_entry *list)
+static dc_status_t parse_dirent(suunto_eonsteel_device_t *eon, int nr, const unsigned char *p, unsigned int len, struct file_list *list)
 {
 	while (len > 8) {
 		unsigned int type = array_uint32_le(p);
 		unsigned int namelen = array_uint32_le(p+4);
 		const unsigned char *name = p+8;
 		struct directory_entry *entry;
+		unsigned int time;
 
 		if (namelen + 8 + 1 > len || name[namelen] != 0) {
 			ERROR(eon->base.context, "corrupt dirent entry");
@@ -685,21 +816,27 @@ static struct directory_entry *parse_dirent(suunto_eonsteel_device_t *eon, int n
 
 		p += 8 + namelen + 1;
 		len -= 8 + namelen + 1;
-		entry = alloc_dirent(type, namelen, (const char *) name);
-		if (!entry) {
+		if (type != DIRTYPE_FILE)
+			continue;
+		if (sscanf((const char *) name, "%x.LOG", &time) != 1) {
+			ERROR(eon->base.context, "unexpected file name %s", name);
+			list->invalid++;
+			continue;
+		}
+		entry = alloc_dirent(time, namelen, (const char *) name);
+		if (!entry || file_list_append(list, entry) != 0) {
 			ERROR(eon->base.context, "out of memory");
-			break;
+			free(entry);
+			return DC_STATUS_NOMEMORY;
 		}
-		list = insert_dirent(entry, list);
 	}
-	return list;
+	return DC_STATUS_SUCCESS;
 }
 
 static dc_status_t
-get_file_list(suunto_eonsteel_device_t *eon, struct directory_entry **res)
+get_file_list(suunto_eonsteel_device_t *eon, struct file_list *list)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	struct directory_entry *de = NULL;
 	unsigned char cmd[64];
 	unsigned char result[2048];
 	unsigned int n = 0;
@@ -723,19 +860,23 @@ get_file_list(suunto_eonsteel_device_t *eon, struct directory_entry **res)
 			NULL, 0, result, sizeof(result), &n);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR(eon->base.context, "readdir failed");
-			file_list_free(de);
+			file_list_free(list);
 			return rc;
 		}
 		if (n < 8) {
 			ERROR(eon->base.context, "short readdir result");
-			file_list_free(de);
+			file_list_free(list);
 			return DC_STATUS_PROTOCOL;
 		}
 		nr = array_uint32_le(result);
 		last = array_uint32_le(result+4);
 		HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "dir packet", result, 8);
 
-		de = parse_dirent(eon, nr, result+8, n-8, de);
+		rc = parse_dirent(eon, nr, result+8, n-8, list);
+		if (rc != DC_STATUS_SUCCESS) {
+			file_list_free(list);
+			return rc;
+		}
 		if (last)
 			break;
 	}
@@ -744,26 +885,38 @@ get_file_list(suunto_eonsteel_device_t *eon, struct directory_entry **res)
 		NULL, 0, result, sizeof(result), NULL);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR(eon->base.context, "dir close failed");
-		file_list_free(de);
+		file_list_free(list);
 		return rc;
 	}
 
-	*res = de;
+	if (list->count > 1)
+		qsort(list->entries, list->count, sizeof(*list->entries), compare_dirent);
 
 	return DC_STATUS_SUCCESS;
 }
 
-static int
-count_file_list(struct directory_entry *list)
+/*
+ * Locate the fingerprint dive in the sorted list. All the dives before
+ * it are new. If the fingerprint dive is no longer present, all the
+ * dives are downloaded.
+ */
+static unsigned int
+find_file_list(const struct file_list *list, unsigned int time)
 {
-	int count = 0;
-
-	while (list) {
-		count++;
-		list = list->next;
+	unsigned int lo = 0, hi = list->count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (list->entries[mid]->time > time)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	return count;
+	if (lo < list->count && list->entries[lo]->time == time)
+		return lo;
+
+	return list->count;
 }
 
 dc_status_t
@@ -784,9 +937,24 @@ suunto_eonsteel_device_open(dc_device_t **out, dc_context_t *context, dc_iostrea
 	eon->model = model;
 	eon->magic = INIT_MAGIC;
 	eon->seq = INIT_SEQ;
+	eon->window = 1;
+	eon->mtu = SZ_PACKET_BLE;
 	memset (eon->version, 0, sizeof (eon->version));
 	memset (eon->fingerprint, 0, sizeof (eon->fingerprint));
 
+	// Request a short BLE connection interval, for the many small
+	// read requests of the download, and a larger MTU, to send each
+	// command in a single write.
+	dc_iostream_ble_prefer(eon->iostream, SZ_PACKET_MAX, BLE_INTERVAL_MIN, 0);
+
+	if (dc_iostream_get_transport(eon->iostream) == DC_TRANSPORT_BLE) {
+		unsigned int mtu = 0;
+		status = dc_iostream_ioctl(eon->iostream, DC_IOCTL_BLE_GET_MTU, &mtu, sizeof(mtu));
+		if (status == DC_STATUS_SUCCESS && mtu > SZ_PACKET_BLE) {
+			eon->mtu = mtu < SZ_PACKET_MAX ? mtu : SZ_PACKET_MAX;
+		}
+	}
+
 	status = dc_iostream_set_timeout(eon->iostream, 5000);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to set the timeout.");
@@ -801,6 +969,12 @@ suunto_eonsteel_device_open(dc_device_t **out, dc_context_t *context, dc_iostrea
 		goto error_free;
 	}
 
+	// Keep multiple read requests outstanding over BLE, where the
+	// downloads are limited by the round-trip time.
+	if (dc_iostream_get_transport(eon->iostream) == DC_TRANSPORT_BLE) {
+		eon->window = READ_WINDOW;
+	}
+
 	*out = (dc_device_t *) eon;
 
 	return DC_STATUS_SUCCESS;
@@ -831,12 +1005,11 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	int skip = 0;
-	struct directory_entry *de;
+	struct file_list list = {NULL, 0, 0, 0};
+	unsigned int count = 0;
 	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
 	dc_buffer_t *file;
 	char pathname[64];
-	unsigned int time;
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
 
 	// Emit a device info event.
@@ -846,63 +1019,68 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 	devinfo.serial = array_convert_str2num(eon->version + 0x10, 16);
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
-	rc = get_file_list(eon, &de);
+	rc = get_file_list(eon, &list);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	if (de == NULL) {
-		return DC_STATUS_SUCCESS;
+	if (list.invalid)
+		dc_status_set_error(&status, DC_STATUS_PROTOCOL);
+
+	if (list.count == 0) {
+		file_list_free(&list);
+		return status;
+	}
+
+	count = list.count;
+	if (array_isequal (eon->fingerprint, sizeof (eon->fingerprint), 0) == 0)
+		count = find_file_list(&list, array_uint32_le (eon->fingerprint));
+
+	// Apply the download limits, on the (newest first) file list.
+	for (unsigned int i = 0; i < count; ++i) {
+		dc_datetime_t datetime;
+		if (device_limits_reached(abstract, i, dc_datetime_gmtime(&datetime, list.entries[i]->time))) {
+			count = i;
+			break;
+		}
 	}
 
 	file = dc_buffer_new (16384);
 	if (file == NULL) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
-		file_list_free(de);
+		file_list_free(&list);
 		return DC_STATUS_NOMEMORY;
 	}
 
-	progress.maximum = count_file_list(de);
+	progress.maximum = count;
 	progress.current = 0;
+	device_set_phase(abstract, DC_PHASE_PROFILE);
 	device_event_emit(abstract, DC_EVENT_PROGRESS, &progress);
 
-	while (de) {
+	for (unsigned int i = 0; i < count; ++i) {
 		int len;
-		struct directory_entry *next = de->next;
+		struct directory_entry *de = list.entries[i];
 		unsigned char buf[4];
 		const unsigned char *data = NULL;
 		unsigned int size = 0;
 
 		if (device_is_cancelled(abstract)) {
 			dc_status_set_error(&status, DC_STATUS_CANCELLED);
-			skip = 1;
-		}
-
-		switch (de->type) {
-		case DIRTYPE_DIR:
-			/* Ignore subdirectories in the dive directory */
 			break;
-		case DIRTYPE_FILE:
-			if (skip)
-				break;
-
-			if (sscanf(de->name, "%x.LOG", &time) != 1) {
-				dc_status_set_error(&status, DC_STATUS_PROTOCOL);
-				break;
-			}
-
-			put_le32(time, buf);
+		}
 
-			if (memcmp (buf, eon->fingerprint, sizeof (eon->fingerprint)) == 0) {
-				skip = 1;
-				break;
-			}
+		put_le32(de->time, buf);
 
-			len = snprintf(pathname, sizeof(pathname), "%s/%s", dive_directory, de->name);
-			if (len < 0 || (unsigned int) len >= sizeof(pathname)) {
-				dc_status_set_error(&status, DC_STATUS_PROTOCOL);
-				break;
-			}
+		// Skip the dives of an interrupted download.
+		if (device_journal_skip(abstract, buf, sizeof(buf))) {
+			progress.current++;
+			device_event_emit(abstract, DC_EVENT_PROGRESS, &progress);
+			continue;
+		}
 
+		len = snprintf(pathname, sizeof(pathname), "%s/%s", dive_directory, de->name);
+		if (len < 0 || (unsigned int) len >= sizeof(pathname)) {
+			dc_status_set_error(&status, DC_STATUS_PROTOCOL);
+		} else {
 			// Reset the membuffer, put the 4-byte length at the head.
 			dc_buffer_clear(file);
 			dc_buffer_append(file, buf, 4);
@@ -911,22 +1089,20 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 			rc = read_file(eon, pathname, file);
 			if (rc != DC_STATUS_SUCCESS) {
 				dc_status_set_error(&status, rc);
-				break;
-			}
-
-			data = dc_buffer_get_data(file);
-			size = dc_buffer_get_size(file);
+			} else {
+				data = dc_buffer_get_data(file);
+				size = dc_buffer_get_size(file);
 
-			if (callback && !callback(data, size, data, sizeof(eon->fingerprint), userdata))
-				skip = 1;
+				if (callback && !callback(data, size, data, sizeof(eon->fingerprint), userdata))
+					break;
+			}
 		}
+
 		progress.current++;
 		device_event_emit(abstract, DC_EVENT_PROGRESS, &progress);
-
-		free(de);
-		de = next;
 	}
 	dc_buffer_free(file);
+	file_list_free(&list);
 
 	return status;
 }
@@ -62,18 +62,74 @@ enum eon_sample {
 };
 
 #define EON_MAX_GROUP 16
+#define EON_MAX_ENUM  100
+
+#define ENUM_MISSING  0xFF
+
+enum eon_setpoint {
+	SP_unknown = 0,
+	SP_low,
+	SP_high,
+	SP_custom,
+};
 
 struct type_desc {
 	char *desc, *format, *mod;
 	unsigned int size;
 	enum eon_sample type[EON_MAX_GROUP];
+	// Enumeration values, pre-resolved to the event
+	// or setpoint type for the enum sample type.
+	unsigned char enums[EON_MAX_ENUM];
 };
 
 #define MAXTYPE 512
 #define MAXGASES 16
 
+#define ARENA_BLOCKSIZE 4096
+
+// The working memory without the heap: a single arena block for the
+// descriptor strings, and an index of a fixed size.
+#define SCRATCH_ARENA   32768
+#define SCRATCH_RECORDS 4096
+
+/*
+ * The descriptor strings are allocated from a list of blocks,
+ * which are kept and reused for the next dive. Once the blocks
+ * are large enough, parsing a dive doesn't allocate anymore.
+ */
+struct arena_block {
+	struct arena_block *next;
+	size_t size, used;
+};
+
+struct arena {
+	struct arena_block *head, *current;
+	int fixed;
+};
+
+/*
+ * The location of all data records of a dive, in file order. The index
+ * is built during the single pass over the dive file when the data is
+ * set, and the samples are served from it afterwards, without decoding
+ * the entries and resolving the descriptors again. Like the arena, the
+ * memory is kept and reused for the next dive.
+ */
+struct index_record {
+	unsigned int offset, len;
+	unsigned short type;
+};
+
+struct index {
+	struct index_record *records;
+	size_t count, capacity;
+	int valid;
+	int fixed;
+};
+
 typedef struct suunto_eonsteel_parser_t {
 	dc_parser_t base;
+	struct arena arena;
+	struct index index;
 	struct type_desc type_desc[MAXTYPE];
 	// field cache
 	struct {
@@ -102,42 +158,48 @@ typedef struct eon_event_t {
 	parser_sample_event_t type;
 } eon_event_t;
 
-static const struct {
+// Sorted by name, for the binary search in lookup_descriptor_type().
+static const struct eon_translation_t {
 	const char *name;
 	enum eon_sample type;
 } type_translation[] = {
 	{ "+Time",				ES_dtime },
-	{ "Depth",				ES_depth },
-	{ "Temperature",			ES_temp },
-	{ "NoDecTime",				ES_ndl },
 	{ "Ceiling",				ES_ceiling },
-	{ "TimeToSurface",			ES_tts },
-	{ "Heading",				ES_heading },
-	{ "DeviceInternalAbsPressure",		ES_abspressure },
-	{ "GasTime",				ES_gastime },
-	{ "Ventilation",			ES_ventilation },
 	{ "Cylinders+Cylinder.GasNumber",	ES_gasnr },
 	{ "Cylinders.Cylinder.Pressure",	ES_pressure },
-	{ "Events+State.Type",			ES_state },
-	{ "Events.State.Active",		ES_state_active },
+	{ "Depth",				ES_depth },
+	{ "DeviceInternalAbsPressure",		ES_abspressure },
+	{ "Events+Alarm.Type",			ES_alarm },
 	{ "Events+Notify.Type",			ES_notify },
-	{ "Events.Notify.Active",		ES_notify_active },
+	{ "Events+State.Type",			ES_state },
 	{ "Events+Warning.Type",		ES_warning },
-	{ "Events.Warning.Active",		ES_warning_active },
-	{ "Events+Alarm.Type",			ES_alarm },
 	{ "Events.Alarm.Active",		ES_alarm_active },
 	{ "Events.Bookmark.Name",		ES_bookmark },
-	{ "Events.GasSwitch.GasNumber",		ES_gasswitch },
-	{ "Events.SetPoint.Type",		ES_setpoint_type },
-	{ "Events.Events.SetPoint.PO2",		ES_setpoint_po2 },
-	{ "Events.SetPoint.Automatic",		ES_setpoint_automatic },
 	{ "Events.DiveTimer.Active",		ES_none },
 	{ "Events.DiveTimer.Time",		ES_none },
+	{ "Events.Events.SetPoint.PO2",		ES_setpoint_po2 },
+	{ "Events.GasSwitch.GasNumber",		ES_gasswitch },
+	{ "Events.Notify.Active",		ES_notify_active },
+	{ "Events.SetPoint.Automatic",		ES_setpoint_automatic },
+	{ "Events.SetPoint.Type",		ES_setpoint_type },
+	{ "Events.State.Active",		ES_state_active },
+	{ "Events.Warning.Active",		ES_warning_active },
+	{ "GasTime",				ES_gastime },
+	{ "Heading",				ES_heading },
+	{ "NoDecTime",				ES_ndl },
+	{ "Temperature",			ES_temp },
+	{ "TimeToSurface",			ES_tts },
+	{ "Ventilation",			ES_ventilation },
 };
 
+static int cmp_translation(const void *key, const void *entry)
+{
+	return strcmp((const char *) key, ((const struct eon_translation_t *) entry)->name);
+}
+
 static enum eon_sample lookup_descriptor_type(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
 {
-	int i;
+	const struct eon_translation_t *entry;
 	const char *name = desc->desc;
 
 	// Not a sample type? Skip it
@@ -160,17 +222,22 @@ static enum eon_sample lookup_descriptor_type(suunto_eonsteel_parser_t *eon, str
 	name += 8;
 
 	// .. and look it up in the table of sample type strings
-	for (i = 0; i < C_ARRAY_SIZE(type_translation); i++) {
-		if (!strcmp(name, type_translation[i].name))
-			return type_translation[i].type;
-	}
+	entry = (const struct eon_translation_t *) bsearch(name, type_translation,
+		C_ARRAY_SIZE(type_translation), sizeof(type_translation[0]), cmp_translation);
+	if (entry)
+		return entry->type;
 	return ES_none;
 }
 
-static parser_sample_event_t lookup_event(const char *name, const eon_event_t events[], size_t n)
+static int enum_is(const char *name, size_t len, const char *str)
+{
+	return !strncasecmp(name, str, len) && str[len] == 0;
+}
+
+static parser_sample_event_t lookup_event(const char *name, size_t len, const eon_event_t events[], size_t n)
 {
 	for (size_t i = 0; i < n; ++i) {
-		if (!strcasecmp(name, events[i].name))
+		if (enum_is(name, len, events[i].name))
 			return events[i].type;
 	}
 
@@ -263,6 +330,241 @@ static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc
 	return -1;
 }
 
+/*
+ * Walk the strings of an enumeration.
+ *
+ * Enumerations have the enum values in the "format" string,
+ * and all start with "enum:" followed by a comma-separated list
+ * of enumeration values and strings. Example:
+ *
+ * "enum:0=NoFly Time,1=Depth,2=Surface Time,3=..."
+ *
+ * The callback gets the value and the (not NUL terminated)
+ * string, and can stop the walk by returning non-zero.
+ */
+typedef int (*eon_enum_cb_t)(unsigned char value, const char *name, size_t len, void *user);
+
+static void foreach_enum(const char *str, eon_enum_cb_t callback, void *user)
+{
+	unsigned char c;
+
+	if (!str)
+		return;
+	if (strncmp(str, "enum:", 5))
+		return;
+	str += 5;
+
+	while ((c = *str) != 0) {
+		unsigned char n;
+		const char *begin, *end;
+
+		str++;
+		if (!isdigit(c))
+			continue;
+		n = c - '0';
+
+		// We only handle one or two digits
+		if (isdigit(*str)) {
+			n = n*10 + *str - '0';
+			str++;
+		}
+
+		begin = end = str;
+		while ((c = *str) != 0) {
+			str++;
+			if (c == ',')
+				break;
+			end = str;
+		}
+
+		// Verify that it has the 'n=string' format and skip the equals sign
+		if (*begin != '=')
+			continue;
+		begin++;
+
+		if (callback(n, begin, end - begin, user))
+			return;
+	}
+}
+
+struct enum_lookup {
+	unsigned char value;
+	const char *result;
+	size_t len;
+};
+
+static int lookup_enum_cb(unsigned char value, const char *name, size_t len, void *user)
+{
+	struct enum_lookup *lookup = (struct enum_lookup *) user;
+
+	// Is it the value we're looking for?
+	if (value != lookup->value)
+		return 0;
+
+	lookup->result = name;
+	lookup->len = len;
+	return 1;
+}
+
+/*
+ * Look up the string from an enumeration. The result points
+ * into the format string, and is not NUL terminated.
+ */
+static const char *lookup_enum(const struct type_desc *desc, unsigned char value, size_t *len)
+{
+	struct enum_lookup lookup = { value, NULL, 0 };
+
+	foreach_enum(desc->format, lookup_enum_cb, &lookup);
+	*len = lookup.len;
+	return lookup.result;
+}
+
+/*
+ * The EON Steel has four different sample events: "state", "notification",
+ * "warning" and "alarm". All end up having two fields: type and a boolean value.
+ */
+static const eon_event_t states[] = {
+	{"Wet Outside",                SAMPLE_EVENT_NONE},
+	{"Below Wet Activation Depth", SAMPLE_EVENT_NONE},
+	{"Below Surface",              SAMPLE_EVENT_NONE},
+	{"Dive Active",                SAMPLE_EVENT_NONE},
+	{"Surface Calculation",        SAMPLE_EVENT_NONE},
+	{"Tank pressure available",    SAMPLE_EVENT_NONE},
+	{"Closed Circuit Mode",        SAMPLE_EVENT_NONE},
+};
+
+static const eon_event_t notifications[] = {
+	{"NoFly Time",         SAMPLE_EVENT_NONE},
+	{"Depth",              SAMPLE_EVENT_NONE},
+	{"Surface Time",       SAMPLE_EVENT_NONE},
+	{"Tissue Level",       SAMPLE_EVENT_TISSUELEVEL},
+	{"Deco",               SAMPLE_EVENT_NONE},
+	{"Deco Window",        SAMPLE_EVENT_NONE},
+	{"Safety Stop Ahead",  SAMPLE_EVENT_NONE},
+	{"Safety Stop",        SAMPLE_EVENT_SAFETYSTOP},
+	{"Safety Stop Broken", SAMPLE_EVENT_CEILING_SAFETYSTOP},
+	{"Deep Stop Ahead",    SAMPLE_EVENT_NONE},
+	{"Deep Stop",          SAMPLE_EVENT_DEEPSTOP},
+	{"Dive Time",          SAMPLE_EVENT_DIVETIME},
+	{"Gas Available",      SAMPLE_EVENT_NONE},
+	{"SetPoint Switch",    SAMPLE_EVENT_NONE},
+	{"Diluent Hypoxia",    SAMPLE_EVENT_NONE},
+	{"Air Time",           SAMPLE_EVENT_NONE},
+	{"Tank Pressure",      SAMPLE_EVENT_NONE},
+};
+
+static const eon_event_t warnings[] = {
+	{"ICD Penalty",           SAMPLE_EVENT_NONE},
+	{"Deep Stop Penalty",     SAMPLE_EVENT_VIOLATION},
+	{"Mandatory Safety Stop", SAMPLE_EVENT_SAFETYSTOP_MANDATORY},
+	{"OTU250",                SAMPLE_EVENT_NONE},
+	{"OTU300",                SAMPLE_EVENT_NONE},
+	{"CNS80%",                SAMPLE_EVENT_NONE},
+	{"CNS100%",               SAMPLE_EVENT_NONE},
+	{"Max.Depth",             SAMPLE_EVENT_MAXDEPTH},
+	{"Air Time",              SAMPLE_EVENT_AIRTIME},
+	{"Tank Pressure",         SAMPLE_EVENT_NONE},
+	{"Safety Stop Broken",    SAMPLE_EVENT_CEILING_SAFETYSTOP},
+	{"Deep Stop Broken",      SAMPLE_EVENT_CEILING_SAFETYSTOP},
+	{"Ceiling Broken",        SAMPLE_EVENT_CEILING},
+	{"PO2 High",              SAMPLE_EVENT_PO2},
+};
+
+static const eon_event_t alarms[] = {
+	{"Mandatory Safety Stop Broken", SAMPLE_EVENT_CEILING_SAFETYSTOP},
+	{"Ascent Speed",                 SAMPLE_EVENT_ASCENT},
+	{"Diluent Hyperoxia",            SAMPLE_EVENT_NONE},
+	{"Violated Deep Stop",           SAMPLE_EVENT_VIOLATION},
+	{"Ceiling Broken",               SAMPLE_EVENT_CEILING},
+	{"PO2 High",                     SAMPLE_EVENT_PO2},
+	{"PO2 Low",                      SAMPLE_EVENT_PO2},
+};
+
+
+struct enum_resolve {
+	struct type_desc *desc;
+	enum eon_sample type;
+};
+
+static int resolve_enum_cb(unsigned char value, const char *name, size_t len, void *user)
+{
+	struct enum_resolve *resolve = (struct enum_resolve *) user;
+	unsigned char *result = resolve->desc->enums + value;
+
+	// Only the first string for a value is used.
+	if (value >= EON_MAX_ENUM || *result != ENUM_MISSING)
+		return 0;
+
+	switch (resolve->type) {
+	case ES_state:
+		*result = lookup_event(name, len, states, C_ARRAY_SIZE(states));
+		break;
+	case ES_notify:
+		*result = lookup_event(name, len, notifications, C_ARRAY_SIZE(notifications));
+		break;
+	case ES_warning:
+		*result = lookup_event(name, len, warnings, C_ARRAY_SIZE(warnings));
+		break;
+	case ES_alarm:
+		*result = lookup_event(name, len, alarms, C_ARRAY_SIZE(alarms));
+		break;
+	case ES_setpoint_type:
+		if (enum_is(name, len, "Low"))
+			*result = SP_low;
+		else if (enum_is(name, len, "High"))
+			*result = SP_high;
+		else if (enum_is(name, len, "Custom"))
+			*result = SP_custom;
+		else
+			*result = SP_unknown;
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Resolve the enumeration strings of the descriptor once, so the
+ * sample parsing never has to look at the strings.
+ *
+ * The strings are resolved for the first sample type using them.
+ */
+static void resolve_enums(struct type_desc *desc)
+{
+	struct enum_resolve resolve = { desc, ES_none };
+
+	memset(desc->enums, ENUM_MISSING, sizeof(desc->enums));
+
+	for (int i = 0; i < EON_MAX_GROUP && !resolve.type; i++) {
+		switch (desc->type[i]) {
+		case ES_state:
+		case ES_notify:
+		case ES_warning:
+		case ES_alarm:
+		case ES_setpoint_type:
+			resolve.type = desc->type[i];
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (resolve.type)
+		foreach_enum(desc->format, resolve_enum_cb, &resolve);
+}
+
+/*
+ * Look up the pre-resolved value from an enumeration.
+ */
+static unsigned int lookup_enum_cached(const struct type_desc *desc, unsigned char value)
+{
+	if (value >= EON_MAX_ENUM)
+		return ENUM_MISSING;
+
+	return desc->enums[value];
+}
+
 /*
  * Here we cache descriptor data so that we don't have
  * to re-parse the string all the time. That way we can
@@ -275,25 +577,80 @@ static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc
  */
 static int fill_in_desc_details(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
 {
+	int rc = 0;
+
+	memset(desc->enums, ENUM_MISSING, sizeof(desc->enums));
+
 	if (!desc->desc)
 		return 0;
 
-	if (isdigit(desc->desc[0]))
-		return fill_in_group_details(eon, desc);
+	if (isdigit(desc->desc[0])) {
+		rc = fill_in_group_details(eon, desc);
+	} else {
+		desc->size = lookup_descriptor_size(eon, desc);
+		desc->type[0] = lookup_descriptor_type(eon, desc);
+	}
 
-	desc->size = lookup_descriptor_size(eon, desc);
-	desc->type[0] = lookup_descriptor_type(eon, desc);
-	return 0;
+	resolve_enums(desc);
+	return rc;
+}
+
+static char *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_block *block = arena->current;
+
+	// Find the first (reused) block with enough space left.
+	while (block && block->used + size > block->size) {
+		block = block->next;
+		if (block)
+			block->used = 0;
+	}
+
+	if (!block) {
+		if (arena->fixed)
+			return NULL;
+
+		size_t blocksize = size > ARENA_BLOCKSIZE ? size : ARENA_BLOCKSIZE;
+		block = (struct arena_block *) malloc(sizeof(*block) + blocksize);
+		if (!block)
+			return NULL;
+		block->size = blocksize;
+		block->used = 0;
+		block->next = NULL;
+
+		// Append the new block at the end of the list.
+		if (arena->current) {
+			struct arena_block *last = arena->current;
+			while (last->next)
+				last = last->next;
+			last->next = block;
+		} else {
+			arena->head = block;
+		}
+	}
+
+	arena->current = block;
+	block->used += size;
+	return (char *) (block + 1) + block->used - size;
+}
+
+static void arena_reset(struct arena *arena)
+{
+	arena->current = arena->head;
+	if (arena->current)
+		arena->current->used = 0;
 }
 
-static void
-desc_free (struct type_desc desc[], unsigned int count)
+static void arena_free(struct arena *arena)
 {
-	for (unsigned int i = 0; i < count; ++i) {
-		free(desc[i].desc);
-		free(desc[i].format);
-		free(desc[i].mod);
+	struct arena_block *block = arena->fixed ? NULL : arena->head;
+
+	while (block) {
+		struct arena_block *next = block->next;
+		free(block);
+		block = next;
 	}
+	arena->head = arena->current = NULL;
 }
 
 static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const char *name, int namelen)
@@ -320,10 +677,9 @@ static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const
 			ERROR(eon->base.context, "Unexpected type description: %.*s", len, name);
 			return -1;
 		}
-		p = (char *) malloc(len-4);
+		p = arena_alloc(&eon->arena, len-4);
 		if (!p) {
 			ERROR(eon->base.context, "out of memory");
-			desc_free(&desc, 1);
 			return -1;
 		}
 		memcpy(p, name+5, len-5);
@@ -343,8 +699,6 @@ static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const
 			break;
 		default:
 			ERROR(eon->base.context, "Unknown type descriptor: %.*s", len, name);
-			desc_free(&desc, 1);
-			free(p);
 			return -1;
 		}
 	} while ((name = next) != NULL);
@@ -355,13 +709,15 @@ static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const
 			desc.desc ? desc.desc : "",
 			desc.format ? desc.format : "",
 			desc.mod ? desc.mod : "");
-		desc_free(&desc, 1);
 		return -1;
 	}
 
 	fill_in_desc_details(eon, &desc);
 
-	desc_free(eon->type_desc + type, 1);
+	// The index only knows the last descriptor of each type.
+	if (eon->type_desc[type].desc)
+		eon->index.valid = 0;
+
 	eon->type_desc[type] = desc;
 	return 0;
 }
@@ -458,13 +814,83 @@ static int traverse_data(suunto_eonsteel_parser_t *eon, eon_data_cb_t callback,
 	return 0;
 }
 
+static int index_append(struct index *index, unsigned short type, unsigned int offset, unsigned int len)
+{
+	if (index->count == index->capacity) {
+		if (index->fixed)
+			return -1;
+
+		size_t capacity = index->capacity ? index->capacity * 2 : 1024;
+		struct index_record *records = (struct index_record *) realloc(index->records, capacity * sizeof(*records));
+		if (!records)
+			return -1;
+		index->records = records;
+		index->capacity = capacity;
+	}
+
+	index->records[index->count].offset = offset;
+	index->records[index->count].len = len;
+	index->records[index->count].type = type;
+	index->count++;
+	return 0;
+}
+
+struct index_data {
+	suunto_eonsteel_parser_t *eon;
+	eon_data_cb_t callback;
+	void *user;
+};
+
+static int index_record(unsigned short type, const struct type_desc *desc, const unsigned char *data, int len, void *user)
+{
+	struct index_data *index = (struct index_data *) user;
+	suunto_eonsteel_parser_t *eon = index->eon;
+
+	if (eon->index.valid &&
+		index_append(&eon->index, type, data - eon->base.data, len) < 0)
+		eon->index.valid = 0;
+
+	return index->callback(type, desc, data, len, index->user);
+}
+
+/*
+ * Traverse the dive file, and build the index of the data records.
+ */
+static int index_traverse_data(suunto_eonsteel_parser_t *eon, eon_data_cb_t callback, void *user)
+{
+	struct index_data index = { eon, callback, user };
+
+	eon->index.count = 0;
+	eon->index.valid = 1;
+
+	return traverse_data(eon, index_record, &index);
+}
+
+/*
+ * Traverse the data records, from the index if possible.
+ */
+static int index_traverse(suunto_eonsteel_parser_t *eon, eon_data_cb_t callback, void *user)
+{
+	if (!eon->index.valid)
+		return traverse_data(eon, callback, user);
+
+	for (size_t i = 0; i < eon->index.count; ++i) {
+		const struct index_record *record = eon->index.records + i;
+		int rc = callback(record->type, eon->type_desc + record->type,
+			eon->base.data + record->offset, record->len, user);
+		if (rc < 0)
+			return 1;
+	}
+	return 0;
+}
+
 struct sample_data {
 	suunto_eonsteel_parser_t *eon;
 	dc_sample_callback_t callback;
 	void *userdata;
 	unsigned int time;
-	char *state_type, *notify_type;
-	char *warning_type, *alarm_type;
+	unsigned int state_type, notify_type;
+	unsigned int warning_type, alarm_type;
 
 	/* We gather up deco and cylinder pressure information */
 	int gasnr;
@@ -604,144 +1030,37 @@ static void sample_gas_switch_event(struct sample_data *info, unsigned short idx
 	if (info->callback) info->callback(DC_SAMPLE_GASMIX, sample, info->userdata);
 }
 
-/*
- * Look up the string from an enumeration.
- *
- * Enumerations have the enum values in the "format" string,
- * and all start with "enum:" followed by a comma-separated list
- * of enumeration values and strings. Example:
- *
- * "enum:0=NoFly Time,1=Depth,2=Surface Time,3=..."
- */
-static char *lookup_enum(const struct type_desc *desc, unsigned char value)
-{
-	const char *str = desc->format;
-	unsigned char c;
-
-	if (!str)
-		return NULL;
-	if (strncmp(str, "enum:", 5))
-		return NULL;
-	str += 5;
 
-	while ((c = *str) != 0) {
-		unsigned char n;
-		const char *begin, *end;
-		char *ret;
-
-		str++;
-		if (!isdigit(c))
-			continue;
-		n = c - '0';
-
-		// We only handle one or two digits
-		if (isdigit(*str)) {
-			n = n*10 + *str - '0';
-			str++;
-		}
-
-		begin = end = str;
-		while ((c = *str) != 0) {
-			str++;
-			if (c == ',')
-				break;
-			end = str;
-		}
-
-		// Verify that it has the 'n=string' format and skip the equals sign
-		if (*begin != '=')
-			continue;
-		begin++;
-
-		// Is it the value we're looking for?
-		if (n != value)
-			continue;
-
-		ret = (char *)malloc(end - begin + 1);
-		if (!ret)
-			break;
-
-		memcpy(ret, begin, end-begin);
-		ret[end-begin] = 0;
-		return ret;
-	}
-	return NULL;
-}
-
-/*
- * The EON Steel has four different sample events: "state", "notification",
- * "warning" and "alarm". All end up having two fields: type and a boolean value.
- */
 static void sample_event_state_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->state_type);
-	info->state_type = lookup_enum(desc, type);
+	info->state_type = lookup_enum_cached(desc, type);
 }
 
 static void sample_event_state_value(const struct type_desc *desc, struct sample_data *info, unsigned char value)
 {
 	dc_sample_value_t sample = {0};
-	static const eon_event_t states[] = {
-		{"Wet Outside",                SAMPLE_EVENT_NONE},
-		{"Below Wet Activation Depth", SAMPLE_EVENT_NONE},
-		{"Below Surface",              SAMPLE_EVENT_NONE},
-		{"Dive Active",                SAMPLE_EVENT_NONE},
-		{"Surface Calculation",        SAMPLE_EVENT_NONE},
-		{"Tank pressure available",    SAMPLE_EVENT_NONE},
-		{"Closed Circuit Mode",        SAMPLE_EVENT_NONE},
-	};
-	const char *name;
 
-	name = info->state_type;
-	if (!name)
-		return;
-
-	sample.event.type = lookup_event(name, states, C_ARRAY_SIZE(states));
-	if (sample.event.type == SAMPLE_EVENT_NONE)
+	if (info->state_type == ENUM_MISSING || info->state_type == SAMPLE_EVENT_NONE)
 		return;
 
+	sample.event.type = info->state_type;
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	if (info->callback) info->callback(DC_SAMPLE_EVENT, sample, info->userdata);
 }
 
 static void sample_event_notify_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->notify_type);
-	info->notify_type = lookup_enum(desc, type);
+	info->notify_type = lookup_enum_cached(desc, type);
 }
 
 static void sample_event_notify_value(const struct type_desc *desc, struct sample_data *info, unsigned char value)
 {
-	static const eon_event_t notifications[] = {
-		{"NoFly Time",         SAMPLE_EVENT_NONE},
-		{"Depth",              SAMPLE_EVENT_NONE},
-		{"Surface Time",       SAMPLE_EVENT_NONE},
-		{"Tissue Level",       SAMPLE_EVENT_TISSUELEVEL},
-		{"Deco",               SAMPLE_EVENT_NONE},
-		{"Deco Window",        SAMPLE_EVENT_NONE},
-		{"Safety Stop Ahead",  SAMPLE_EVENT_NONE},
-		{"Safety Stop",        SAMPLE_EVENT_SAFETYSTOP},
-		{"Safety Stop Broken", SAMPLE_EVENT_CEILING_SAFETYSTOP},
-		{"Deep Stop Ahead",    SAMPLE_EVENT_NONE},
-		{"Deep Stop",          SAMPLE_EVENT_DEEPSTOP},
-		{"Dive Time",          SAMPLE_EVENT_DIVETIME},
-		{"Gas Available",      SAMPLE_EVENT_NONE},
-		{"SetPoint Switch",    SAMPLE_EVENT_NONE},
-		{"Diluent Hypoxia",    SAMPLE_EVENT_NONE},
-		{"Air Time",           SAMPLE_EVENT_NONE},
-		{"Tank Pressure",      SAMPLE_EVENT_NONE},
-	};
 	dc_sample_value_t sample = {0};
-	const char *name;
 
-	name = info->notify_type;
-	if (!name)
-		return;
-
-	sample.event.type = lookup_event(name, notifications, C_ARRAY_SIZE(notifications));
-	if (sample.event.type == SAMPLE_EVENT_NONE)
+	if (info->notify_type == ENUM_MISSING || info->notify_type == SAMPLE_EVENT_NONE)
 		return;
 
+	sample.event.type = info->notify_type;
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	if (info->callback) info->callback(DC_SAMPLE_EVENT, sample, info->userdata);
 }
@@ -749,72 +1068,35 @@ static void sample_event_notify_value(const struct type_desc *desc, struct sampl
 
 static void sample_event_warning_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->warning_type);
-	info->warning_type = lookup_enum(desc, type);
+	info->warning_type = lookup_enum_cached(desc, type);
 }
 
 static void sample_event_warning_value(const struct type_desc *desc, struct sample_data *info, unsigned char value)
 {
-	static const eon_event_t warnings[] = {
-		{"ICD Penalty",           SAMPLE_EVENT_NONE},
-		{"Deep Stop Penalty",     SAMPLE_EVENT_VIOLATION},
-		{"Mandatory Safety Stop", SAMPLE_EVENT_SAFETYSTOP_MANDATORY},
-		{"OTU250",                SAMPLE_EVENT_NONE},
-		{"OTU300",                SAMPLE_EVENT_NONE},
-		{"CNS80%",                SAMPLE_EVENT_NONE},
-		{"CNS100%",               SAMPLE_EVENT_NONE},
-		{"Max.Depth",             SAMPLE_EVENT_MAXDEPTH},
-		{"Air Time",              SAMPLE_EVENT_AIRTIME},
-		{"Tank Pressure",         SAMPLE_EVENT_NONE},
-		{"Safety Stop Broken",    SAMPLE_EVENT_CEILING_SAFETYSTOP},
-		{"Deep Stop Broken",      SAMPLE_EVENT_CEILING_SAFETYSTOP},
-		{"Ceiling Broken",        SAMPLE_EVENT_CEILING},
-		{"PO2 High",              SAMPLE_EVENT_PO2},
-	};
 	dc_sample_value_t sample = {0};
-	const char *name;
 
-	name = info->warning_type;
-	if (!name)
-		return;
-
-	sample.event.type = lookup_event(name, warnings, C_ARRAY_SIZE(warnings));
-	if (sample.event.type == SAMPLE_EVENT_NONE)
+	if (info->warning_type == ENUM_MISSING || info->warning_type == SAMPLE_EVENT_NONE)
 		return;
 
+	sample.event.type = info->warning_type;
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	if (info->callback) info->callback(DC_SAMPLE_EVENT, sample, info->userdata);
 }
 
 static void sample_event_alarm_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->alarm_type);
-	info->alarm_type = lookup_enum(desc, type);
+	info->alarm_type = lookup_enum_cached(desc, type);
 }
 
 
 static void sample_event_alarm_value(const struct type_desc *desc, struct sample_data *info, unsigned char value)
 {
-	static const eon_event_t alarms[] = {
-		{"Mandatory Safety Stop Broken", SAMPLE_EVENT_CEILING_SAFETYSTOP},
-		{"Ascent Speed",                 SAMPLE_EVENT_ASCENT},
-		{"Diluent Hyperoxia",            SAMPLE_EVENT_NONE},
-		{"Violated Deep Stop",           SAMPLE_EVENT_VIOLATION},
-		{"Ceiling Broken",               SAMPLE_EVENT_CEILING},
-		{"PO2 High",                     SAMPLE_EVENT_PO2},
-		{"PO2 Low",                      SAMPLE_EVENT_PO2},
-	};
 	dc_sample_value_t sample = {0};
-	const char *name;
-
-	name = info->alarm_type;
-	if (!name)
-		return;
 
-	sample.event.type = lookup_event(name, alarms, C_ARRAY_SIZE(alarms));
-	if (sample.event.type == SAMPLE_EVENT_NONE)
+	if (info->alarm_type == ENUM_MISSING || info->alarm_type == SAMPLE_EVENT_NONE)
 		return;
 
+	sample.event.type = info->alarm_type;
 	sample.event.flags = value ? SAMPLE_FLAGS_BEGIN : SAMPLE_FLAGS_END;
 	if (info->callback) info->callback(DC_SAMPLE_EVENT, sample, info->userdata);
 }
@@ -823,27 +1105,26 @@ static void sample_event_alarm_value(const struct type_desc *desc, struct sample
 static void sample_setpoint_type(const struct type_desc *desc, struct sample_data *info, unsigned char value)
 {
 	dc_sample_value_t sample = {0};
-	char *type = lookup_enum(desc, value);
 
-	if (!type) {
+	switch (lookup_enum_cached(desc, value)) {
+	case ENUM_MISSING:
 		DEBUG(info->eon->base.context, "sample_setpoint_type(%u) did not match anything in %s", value, desc->format);
 		return;
-	}
-
-	if (!strcasecmp(type, "Low"))
+	case SP_low:
 		sample.ppo2 = info->eon->cache.lowsetpoint;
-	else if (!strcasecmp(type, "High"))
+		break;
+	case SP_high:
 		sample.ppo2 = info->eon->cache.highsetpoint;
-	else if (!strcasecmp(type, "Custom"))
+		break;
+	case SP_custom:
 		sample.ppo2 = info->eon->cache.customsetpoint;
-	else {
-		DEBUG(info->eon->base.context, "sample_setpoint_type(%u) unknown type '%s'", value, type);
-		free(type);
+		break;
+	default:
+		DEBUG(info->eon->base.context, "sample_setpoint_type(%u) unknown type", value);
 		return;
 	}
 
 	if (info->callback) info->callback(DC_SAMPLE_SETPOINT, sample, info->userdata);
-	free(type);
 }
 
 // uint32
@@ -1016,12 +1297,7 @@ suunto_eonsteel_parser_samples_foreach(dc_parser_t *abstract, dc_sample_callback
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) abstract;
 	struct sample_data data = { eon, callback, userdata, 0 };
 
-	traverse_data(eon, traverse_samples, &data);
-
-	free(data.state_type);
-	free(data.notify_type);
-	free(data.warning_type);
-	free(data.alarm_type);
+	index_traverse(eon, traverse_samples, &data);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -1158,29 +1434,29 @@ static int add_gas_type(suunto_eonsteel_parser_t *eon, const struct type_desc *d
 {
 	int idx = eon->cache.ngases;
 	dc_tankvolume_t tankinfo = DC_TANKVOLUME_METRIC;
-	char *name;
+	const char *name;
+	size_t len;
 
 	if (idx >= MAXGASES)
 		return 0;
 
 	eon->cache.ngases = idx+1;
-	name = lookup_enum(desc, type);
+	name = lookup_enum(desc, type, &len);
 	if (!name)
 		DEBUG(eon->base.context, "Unable to look up gas type %u in %s", type, desc->format);
-	else if (!strcasecmp(name, "Diluent"))
+	else if (enum_is(name, len, "Diluent"))
 		;
-	else if (!strcasecmp(name, "Oxygen"))
+	else if (enum_is(name, len, "Oxygen"))
 		;
-	else if (!strcasecmp(name, "None"))
+	else if (enum_is(name, len, "None"))
 		tankinfo = DC_TANKVOLUME_NONE;
-	else if (strcasecmp(name, "Primary"))
-		DEBUG(eon->base.context, "Unknown gas type %u (%s)", type, name);
+	else if (!enum_is(name, len, "Primary"))
+		DEBUG(eon->base.context, "Unknown gas type %u (%.*s)", type, (int) len, name);
 
 	eon->cache.tankinfo[idx] = tankinfo;
 
 	eon->cache.initialized |= 1 << DC_FIELD_GASMIX_COUNT;
 	eon->cache.initialized |= 1 << DC_FIELD_TANK_COUNT;
-	free(name);
 	return 0;
 }
 
@@ -1453,7 +1729,7 @@ static void initialize_field_caches(suunto_eonsteel_parser_t *eon)
 	memset(&eon->cache, 0, sizeof(eon->cache));
 	eon->cache.initialized = 1 << DC_FIELD_DIVETIME;
 
-	traverse_data(eon, traverse_fields, eon);
+	index_traverse_data(eon, traverse_fields, eon);
 
 	// The internal time fields are in ms and have to be added up
 	// like that. At the end, we translate it back to seconds.
@@ -1490,7 +1766,7 @@ suunto_eonsteel_parser_set_data(dc_parser_t *parser, const unsigned char *data,
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) parser;
 
-	desc_free(eon->type_desc, MAXTYPE);
+	arena_reset(&eon->arena);
 	memset(eon->type_desc, 0, sizeof(eon->type_desc));
 	initialize_field_caches(eon);
 	show_all_descriptors(eon);
@@ -1502,7 +1778,9 @@ suunto_eonsteel_parser_destroy(dc_parser_t *parser)
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) parser;
 
-	desc_free(eon->type_desc, MAXTYPE);
+	arena_free(&eon->arena);
+	if (!eon->index.fixed)
+		free(eon->index.records);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -1531,9 +1809,38 @@ suunto_eonsteel_parser_create(dc_parser_t **out, dc_context_t *context, unsigned
 		return DC_STATUS_NOMEMORY;
 	}
 
+	parser->arena.head = parser->arena.current = NULL;
+	parser->arena.fixed = 0;
+	parser->index.records = NULL;
+	parser->index.count = parser->index.capacity = 0;
+	parser->index.valid = 0;
+	parser->index.fixed = 0;
 	memset(&parser->type_desc, 0, sizeof(parser->type_desc));
 	memset(&parser->cache, 0, sizeof(parser->cache));
 
+	// Without the heap, the descriptor strings must fit in a single
+	// arena block. A dive with more records than the index can hold
+	// is decoded again for every pass.
+	unsigned char *scratch = NULL;
+	dc_status_t status = dc_parser_reserve ((dc_parser_t *) parser,
+		SCRATCH_ARENA + SCRATCH_RECORDS * sizeof(struct index_record), (void **) &scratch);
+	if (status != DC_STATUS_SUCCESS) {
+		dc_parser_deallocate ((dc_parser_t *) parser);
+		return status;
+	}
+
+	if (scratch) {
+		struct arena_block *block = (struct arena_block *) scratch;
+		block->next = NULL;
+		block->size = SCRATCH_ARENA - sizeof(*block);
+		block->used = 0;
+		parser->arena.head = parser->arena.current = block;
+		parser->arena.fixed = 1;
+		parser->index.records = (struct index_record *) (scratch + SCRATCH_ARENA);
+		parser->index.capacity = SCRATCH_RECORDS;
+		parser->index.fixed = 1;
+	}
+
 	*out = (dc_parser_t *) parser;
 
 	return DC_STATUS_SUCCESS;
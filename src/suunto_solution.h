@@ -34,6 +34,9 @@ extern "C" {
 dc_status_t
 suunto_solution_device_open (dc_device_t **device, dc_context_t *context, dc_iostream_t *iostream);
 
+dc_status_t
+suunto_solution_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
+
 dc_status_t
 suunto_solution_parser_create (dc_parser_t **parser, dc_context_t *context);
 
@@ -23,6 +23,8 @@
 #include <stdlib.h> // malloc, free
 #include <assert.h>	// assert
 
+#include <libdivecomputer/serial.h>
+
 #include "suunto_vyper.h"
 #include "suunto_common.h"
 #include "context-private.h"
@@ -58,10 +60,12 @@ static const dc_device_vtable_t suunto_vyper_device_vtable = {
 	DC_FAMILY_SUUNTO_VYPER,
 	suunto_common_device_set_fingerprint, /* set_fingerprint */
 	suunto_vyper_device_read, /* read */
+	NULL, /* read_multi */
 	suunto_vyper_device_write, /* write */
 	suunto_vyper_device_dump, /* dump */
 	suunto_vyper_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
@@ -118,6 +122,14 @@ suunto_vyper_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 		goto error_free;
 	}
 
+	// Enable the low latency mode. This is a best effort setting, and
+	// not every serial port supports it.
+	unsigned int latency = 0;
+	status = dc_iostream_ioctl (device->iostream, DC_IOCTL_SERIAL_SET_LATENCY, &latency, sizeof(latency));
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		WARNING (context, "Failed to set the latency.");
+	}
+
 	// Set the DTR line (power supply for the interface).
 	status = dc_iostream_set_dtr (device->iostream, 1);
 	if (status != DC_STATUS_SUCCESS) {
@@ -174,7 +186,26 @@ suunto_vyper_send (suunto_vyper_device_t *device, const unsigned char command[],
 	// receive the reply before RTS is cleared. We have to wait some time
 	// before clearing RTS (around 30ms). But if we wait too long (> 500ms),
 	// the reply disappears again.
-	dc_iostream_sleep (device->iostream, 200);
+	// Instead of always waiting the full 200ms, the echo is consumed as
+	// soon as it has arrived completely. Without an echo, the read times
+	// out after the same 200ms.
+	unsigned char echo[SZ_PACKET + 5];
+	assert (csize <= sizeof (echo));
+	status = dc_iostream_set_timeout (device->iostream, 200);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to set the timeout.");
+		return status;
+	}
+	status = dc_iostream_read (device->iostream, echo, csize, NULL);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT) {
+		ERROR (abstract->context, "Failed to receive the echo.");
+		return status;
+	}
+	status = dc_iostream_set_timeout (device->iostream, 1000);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to set the timeout.");
+		return status;
+	}
 	dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
 
 	// Clear RTS to receive the reply.
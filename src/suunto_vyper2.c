@@ -48,10 +48,12 @@ static const suunto_common2_device_vtable_t suunto_vyper2_device_vtable = {
 		DC_FAMILY_SUUNTO_VYPER2,
 		suunto_common2_device_set_fingerprint, /* set_fingerprint */
 		suunto_common2_device_read, /* read */
+		NULL, /* read_multi */
 		suunto_common2_device_write, /* write */
 		suunto_common2_device_dump, /* dump */
 		suunto_common2_device_foreach, /* foreach */
 		NULL, /* timesync */
+		NULL, /* keepalive */
 		suunto_vyper2_device_close /* close */
 	},
 	suunto_vyper2_device_packet
@@ -25,6 +25,7 @@
 #include "tecdiving_divecomputereu.h"
 #include "context-private.h"
 #include "device-private.h"
+#include "platform.h"
 #include "array.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &tecdiving_divecomputereu_device_vtable)
@@ -70,10 +71,12 @@ static const dc_device_vtable_t tecdiving_divecomputereu_device_vtable = {
 	DC_FAMILY_TECDIVING_DIVECOMPUTEREU,
 	tecdiving_divecomputereu_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	NULL, /* dump */
 	tecdiving_divecomputereu_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	tecdiving_divecomputereu_device_close, /* close */
 };
 
@@ -140,7 +143,7 @@ tecdiving_divecomputereu_send (tecdiving_divecomputereu_device_t *device, unsign
 }
 
 static dc_status_t
-tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, unsigned char rsp, unsigned char data[], size_t size, size_t *actual)
+tecdiving_divecomputereu_receive_header (tecdiving_divecomputereu_device_t *device, unsigned char rsp, size_t size, size_t *length, unsigned short *crc)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
@@ -196,9 +199,9 @@ tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, uns
 	}
 
 	// Verify the length.
-	unsigned int length = array_uint32_le (header + 2);
-	if (length > size) {
-		ERROR (abstract->context, "Unexpected packet length (%u).", length);
+	unsigned int len = array_uint32_le (header + 2);
+	if (len > size) {
+		ERROR (abstract->context, "Unexpected packet length (%u).", len);
 		return DC_STATUS_PROTOCOL;
 	}
 
@@ -209,6 +212,49 @@ tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, uns
 		return DC_STATUS_PROTOCOL;
 	}
 
+	*length = len;
+	*crc = checksum_crc (header + 1, sizeof(header) - 1, 0);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+tecdiving_divecomputereu_receive_checksum (tecdiving_divecomputereu_device_t *device, unsigned short ccrc)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+
+	// Read the packet checksum.
+	unsigned char checksum[4];
+	status = dc_iostream_read (device->iostream, checksum, sizeof(checksum), NULL);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to receive the packet checksum.");
+		return status;
+	}
+
+	// Verify the checksum.
+	unsigned short crc = array_uint16_be (checksum);
+	if (crc != ccrc || checksum[2] != 0x00 || checksum[3] != 0) {
+		ERROR (abstract->context, "Unexpected packet checksum.");
+		return DC_STATUS_PROTOCOL;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, unsigned char rsp, unsigned char data[], size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+	unsigned short crc = 0;
+	size_t length = 0;
+
+	// Read the packet header.
+	status = tecdiving_divecomputereu_receive_header (device, rsp, size, &length, &crc);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	size_t nbytes = 0;
 	while (nbytes < length) {
 		// Set the maximum packet size.
@@ -228,28 +274,16 @@ tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, uns
 		nbytes += len;
 	}
 
-	// Read the packet checksum.
-	unsigned char checksum[4];
-	status = dc_iostream_read (device->iostream, checksum, sizeof(checksum), NULL);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Failed to receive the packet checksum.");
+	// Read and verify the packet checksum.
+	crc = checksum_crc (data, length, crc);
+	status = tecdiving_divecomputereu_receive_checksum (device, crc);
+	if (status != DC_STATUS_SUCCESS)
 		return status;
-	}
-
-	// Verify the checksum.
-	unsigned short crc = array_uint16_be (checksum);
-	unsigned short ccrc = 0;
-	ccrc = checksum_crc (header + 1, sizeof(header) - 1, ccrc);
-	ccrc = checksum_crc (data, length, ccrc);
-	if (crc != ccrc || checksum[2] != 0x00 || checksum[3] != 0) {
-		ERROR (abstract->context, "Unexpected packet checksum.");
-		return DC_STATUS_PROTOCOL;
-	}
 
 	if (actual == NULL) {
 		// Verify the actual length.
 		if (length != size) {
-			ERROR (abstract->context, "Unexpected packet length (%u).", length);
+			ERROR (abstract->context, "Unexpected packet length (" DC_PRINTF_SIZE ").", length);
 			return DC_STATUS_PROTOCOL;
 		}
 	} else {
@@ -260,6 +294,86 @@ tecdiving_divecomputereu_receive (tecdiving_divecomputereu_device_t *device, uns
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Receive the dive list. The list is received in small chunks, and only
+ * the entries up to the one matching the fingerprint are kept. The rest
+ * of the packet is still received, to verify the checksum and to keep
+ * the stream in sync.
+ */
+static dc_status_t
+tecdiving_divecomputereu_receive_list (tecdiving_divecomputereu_device_t *device, dc_buffer_t *logbook)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+	unsigned short crc = 0;
+	size_t length = 0;
+
+	// Read the packet header.
+	status = tecdiving_divecomputereu_receive_header (device, RSP_LIST, SZ_LIST, &length, &crc);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	// Verify the minimum length.
+	if (length < 2) {
+		ERROR (abstract->context, "Unexpected packet length (" DC_PRINTF_SIZE ").", length);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	// Read the number of logbook entries.
+	unsigned char count[2];
+	status = dc_iostream_read (device->iostream, count, sizeof(count), NULL);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to receive the packet payload.");
+		return status;
+	}
+
+	crc = checksum_crc (count, sizeof(count), crc);
+
+	unsigned int nlogbooks = array_uint16_be (count);
+	if (length != 2 + nlogbooks * SZ_SUMMARY) {
+		ERROR (abstract->context, "Unexpected packet length (" DC_PRINTF_SIZE ").", length);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	unsigned int found = 0;
+	size_t nbytes = 2;
+	while (nbytes < length) {
+		// Read a chunk of logbook entries.
+		unsigned char chunk[128 * SZ_SUMMARY];
+		size_t len = sizeof(chunk);
+		if (nbytes + len > length)
+			len = length - nbytes;
+
+		status = dc_iostream_read (device->iostream, chunk, len, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to receive the packet payload.");
+			return status;
+		}
+
+		crc = checksum_crc (chunk, len, crc);
+		nbytes += len;
+
+		// Keep the entries up to the fingerprint.
+		size_t n = 0;
+		while (!found && n < len) {
+			if (memcmp (chunk + n, device->fingerprint, sizeof(device->fingerprint)) == 0) {
+				found = 1;
+				break;
+			}
+
+			n += SZ_SUMMARY;
+		}
+
+		if (n && !dc_buffer_append (logbook, chunk, n)) {
+			ERROR (abstract->context, "Insufficient buffer space available.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	// Read and verify the packet checksum.
+	return tecdiving_divecomputereu_receive_checksum (device, crc);
+}
+
 static dc_status_t
 tecdiving_divecomputereu_readdive (dc_device_t *abstract, dc_event_progress_t *progress, unsigned int idx, dc_buffer_t *buffer)
 {
@@ -458,8 +572,7 @@ tecdiving_divecomputereu_device_foreach (dc_device_t *abstract, dc_dive_callback
 	device_event_emit (abstract, DC_EVENT_VENDOR, &vendor);
 
 	// Allocate memory for the dive list.
-	size_t length = SZ_LIST;
-	unsigned char *logbook = (unsigned char *) malloc (length);
+	dc_buffer_t *logbook = dc_buffer_new (0);
 	if (logbook == NULL) {
 		status = DC_STATUS_NOMEMORY;
 		goto error_exit;
@@ -472,51 +585,32 @@ tecdiving_divecomputereu_device_foreach (dc_device_t *abstract, dc_dive_callback
 		goto error_logbook_free;
 	}
 
-	// Read the dive list.
-	status = tecdiving_divecomputereu_receive (device, RSP_LIST, logbook, length, &length);
+	// Read the dive list, up to the fingerprint.
+	status = tecdiving_divecomputereu_receive_list (device, logbook);
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to receive the logbook.");
 		goto error_logbook_free;
 	}
 
-	// Verify the minimum length.
-	if (length < 2) {
-		status = DC_STATUS_DATAFORMAT;
-		goto error_logbook_free;
-	}
-
-	// Get the number of logbook entries.
-	unsigned int nlogbooks = array_uint16_be (logbook);
-	if (length != 2 + nlogbooks * SZ_SUMMARY) {
-		status = DC_STATUS_DATAFORMAT;
-		goto error_logbook_free;
-	}
-
-	// Count the number of dives to download.
-	unsigned int ndives = 0;
-	for (unsigned int i = 0; i < nlogbooks; ++i) {
-		unsigned int offset = 2 + i * SZ_SUMMARY;
-
-		if (memcmp(logbook + offset, device->fingerprint, sizeof(device->fingerprint)) == 0)
-			break;
-
-		ndives++;
-	}
+	// Get the number of dives to download.
+	const unsigned char *entries = dc_buffer_get_data (logbook);
+	unsigned int ndives = dc_buffer_get_size (logbook) / SZ_SUMMARY;
 
 	// Update and emit a progress event.
 	progress.current = 1 * NSTEPS;
 	progress.maximum = (ndives + 1) * NSTEPS;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	// Allocate a memory buffer for a single dive.
-	dc_buffer_t *buffer = dc_buffer_new(0);
+	// Allocate a memory buffer for a single dive, which is reused for
+	// all dives.
+	dc_buffer_t *buffer = dc_buffer_new (SZ_HEADER + SZ_PROFILE);
 	if (buffer == NULL) {
 		status = DC_STATUS_NOMEMORY;
 		goto error_logbook_free;
 	}
 
 	for (unsigned int i = 0; i < ndives; ++i) {
-		unsigned int offset = 2 + i * SZ_SUMMARY;
+		unsigned int offset = i * SZ_SUMMARY;
 
 		// Read the dive.
 		status = tecdiving_divecomputereu_readdive (abstract, &progress, i, buffer);
@@ -529,7 +623,7 @@ tecdiving_divecomputereu_device_foreach (dc_device_t *abstract, dc_dive_callback
 		unsigned int size = dc_buffer_get_size(buffer);
 
 		// Verify the logbook entry.
-		if (memcmp (data, logbook + offset, SZ_SUMMARY) != 0) {
+		if (memcmp (data, entries + offset, SZ_SUMMARY) != 0) {
 			ERROR (abstract->context, "Dive header doesn't match logbook entry.");
 			status = DC_STATUS_DATAFORMAT;
 			goto error_buffer_free;
@@ -543,7 +637,7 @@ tecdiving_divecomputereu_device_foreach (dc_device_t *abstract, dc_dive_callback
 error_buffer_free:
 	dc_buffer_free (buffer);
 error_logbook_free:
-	free (logbook);
+	dc_buffer_free (logbook);
 error_exit:
 	return status;
 }
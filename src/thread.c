@@ -0,0 +1,317 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#include <windows.h>
+#elif defined (HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+#include "thread.h"
+
+/*
+ * Without thread support, the mutex and condition variable are no-ops.
+ * That is sufficient for single threaded use, and dc_thread_new reports
+ * DC_STATUS_UNSUPPORTED so callers can fall back to doing the work inline.
+ */
+
+struct dc_mutex_t {
+#if defined (_WIN32)
+	CRITICAL_SECTION handle;
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_t handle;
+#else
+	int dummy;
+#endif
+};
+
+struct dc_cond_t {
+#if defined (_WIN32)
+	CONDITION_VARIABLE handle;
+#elif defined (HAVE_PTHREAD_H)
+	pthread_cond_t handle;
+#else
+	int dummy;
+#endif
+};
+
+struct dc_thread_t {
+#if defined (_WIN32)
+	HANDLE handle;
+#elif defined (HAVE_PTHREAD_H)
+	pthread_t handle;
+#endif
+	dc_thread_func_t func;
+	void *userdata;
+};
+
+dc_status_t
+dc_mutex_new (dc_mutex_t **out)
+{
+	dc_mutex_t *mutex = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	mutex = (dc_mutex_t *) malloc (sizeof (dc_mutex_t));
+	if (mutex == NULL) {
+		return DC_STATUS_NOMEMORY;
+	}
+
+#if defined (_WIN32)
+	InitializeCriticalSection (&mutex->handle);
+#elif defined (HAVE_PTHREAD_H)
+	if (pthread_mutex_init (&mutex->handle, NULL) != 0) {
+		free (mutex);
+		return DC_STATUS_NOMEMORY;
+	}
+#endif
+
+	*out = mutex;
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+dc_mutex_lock (dc_mutex_t *mutex)
+{
+#if defined (_WIN32)
+	EnterCriticalSection (&mutex->handle);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_lock (&mutex->handle);
+#else
+	(void) mutex;
+#endif
+}
+
+void
+dc_mutex_unlock (dc_mutex_t *mutex)
+{
+#if defined (_WIN32)
+	LeaveCriticalSection (&mutex->handle);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_unlock (&mutex->handle);
+#else
+	(void) mutex;
+#endif
+}
+
+dc_status_t
+dc_mutex_free (dc_mutex_t *mutex)
+{
+	if (mutex == NULL)
+		return DC_STATUS_SUCCESS;
+
+#if defined (_WIN32)
+	DeleteCriticalSection (&mutex->handle);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_destroy (&mutex->handle);
+#endif
+	free (mutex);
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_cond_new (dc_cond_t **out)
+{
+	dc_cond_t *cond = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	cond = (dc_cond_t *) malloc (sizeof (dc_cond_t));
+	if (cond == NULL) {
+		return DC_STATUS_NOMEMORY;
+	}
+
+#if defined (_WIN32)
+	InitializeConditionVariable (&cond->handle);
+#elif defined (HAVE_PTHREAD_H)
+	if (pthread_cond_init (&cond->handle, NULL) != 0) {
+		free (cond);
+		return DC_STATUS_NOMEMORY;
+	}
+#endif
+
+	*out = cond;
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+dc_cond_wait (dc_cond_t *cond, dc_mutex_t *mutex)
+{
+#if defined (_WIN32)
+	SleepConditionVariableCS (&cond->handle, &mutex->handle, INFINITE);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_cond_wait (&cond->handle, &mutex->handle);
+#else
+	(void) cond;
+	(void) mutex;
+#endif
+}
+
+void
+dc_cond_broadcast (dc_cond_t *cond)
+{
+#if defined (_WIN32)
+	WakeAllConditionVariable (&cond->handle);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_cond_broadcast (&cond->handle);
+#else
+	(void) cond;
+#endif
+}
+
+dc_status_t
+dc_cond_free (dc_cond_t *cond)
+{
+	if (cond == NULL)
+		return DC_STATUS_SUCCESS;
+
+#if defined (HAVE_PTHREAD_H) && !defined (_WIN32)
+	pthread_cond_destroy (&cond->handle);
+#endif
+	free (cond);
+
+	return DC_STATUS_SUCCESS;
+}
+
+#if defined (_WIN32)
+static DWORD WINAPI
+dc_thread_main (LPVOID arg)
+{
+	dc_thread_t *thread = (dc_thread_t *) arg;
+
+	thread->func (thread->userdata);
+
+	return 0;
+}
+#elif defined (HAVE_PTHREAD_H)
+static void *
+dc_thread_main (void *arg)
+{
+	dc_thread_t *thread = (dc_thread_t *) arg;
+
+	thread->func (thread->userdata);
+
+	return NULL;
+}
+#endif
+
+dc_status_t
+dc_thread_new (dc_thread_t **out, dc_thread_func_t func, void *userdata)
+{
+#if defined (_WIN32) || defined (HAVE_PTHREAD_H)
+	dc_thread_t *thread = NULL;
+
+	if (out == NULL || func == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	thread = (dc_thread_t *) malloc (sizeof (dc_thread_t));
+	if (thread == NULL) {
+		return DC_STATUS_NOMEMORY;
+	}
+
+	thread->func = func;
+	thread->userdata = userdata;
+
+#if defined (_WIN32)
+	thread->handle = CreateThread (NULL, 0, dc_thread_main, thread, 0, NULL);
+	if (thread->handle == NULL) {
+		free (thread);
+		return DC_STATUS_NOMEMORY;
+	}
+#else
+	if (pthread_create (&thread->handle, NULL, dc_thread_main, thread) != 0) {
+		free (thread);
+		return DC_STATUS_NOMEMORY;
+	}
+#endif
+
+	*out = thread;
+
+	return DC_STATUS_SUCCESS;
+#else
+	(void) func;
+	(void) userdata;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+dc_status_t
+dc_thread_join (dc_thread_t *thread)
+{
+	if (thread == NULL)
+		return DC_STATUS_SUCCESS;
+
+#if defined (_WIN32)
+	WaitForSingleObject (thread->handle, INFINITE);
+	CloseHandle (thread->handle);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_join (thread->handle, NULL);
+#endif
+	free (thread);
+
+	return DC_STATUS_SUCCESS;
+}
+
+#if defined (_WIN32)
+static SRWLOCK g_once = SRWLOCK_INIT;
+#elif defined (HAVE_PTHREAD_H)
+static pthread_mutex_t g_once = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void
+dc_once (dc_once_t *once, void (*func) (void))
+{
+	// A single static lock for all flags, because it's only taken for
+	// a few cheap checks once the initialization is done.
+#if defined (_WIN32)
+	AcquireSRWLockExclusive (&g_once);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_lock (&g_once);
+#endif
+
+	if (*once == DC_ONCE_INIT) {
+		func ();
+		*once = 1;
+	}
+
+#if defined (_WIN32)
+	ReleaseSRWLockExclusive (&g_once);
+#elif defined (HAVE_PTHREAD_H)
+	pthread_mutex_unlock (&g_once);
+#endif
+}
@@ -160,3 +160,26 @@ dc_timer_free (dc_timer_t *timer)
 
 	return DC_STATUS_SUCCESS;
 }
+
+void
+dc_timer_scope_begin (dc_timer_scope_t *scope, dc_timer_t *timer)
+{
+	scope->timer = timer;
+	scope->begin = 0;
+
+	if (timer && dc_timer_now (timer, &scope->begin) != DC_STATUS_SUCCESS)
+		scope->timer = NULL;
+}
+
+dc_usecs_t
+dc_timer_scope_end (const dc_timer_scope_t *scope)
+{
+	dc_usecs_t now = 0;
+
+	if (scope->timer == NULL ||
+		dc_timer_now (scope->timer, &now) != DC_STATUS_SUCCESS ||
+		now < scope->begin)
+		return 0;
+
+	return now - scope->begin;
+}
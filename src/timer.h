@@ -45,6 +45,24 @@ dc_timer_now (dc_timer_t *timer, dc_usecs_t *usecs);
 dc_status_t
 dc_timer_free (dc_timer_t *timer);
 
+/*
+ * Measurement of the elapsed time of a code section. Without a timer,
+ * the measurement is disabled, and the elapsed time is always zero. The
+ * clock is the monotonic clock of the timer, which is read through the
+ * vDSO on most systems and thus already costs only a few tens of
+ * nanoseconds per reading.
+ */
+typedef struct dc_timer_scope_t {
+	dc_timer_t *timer;
+	dc_usecs_t begin;
+} dc_timer_scope_t;
+
+void
+dc_timer_scope_begin (dc_timer_scope_t *scope, dc_timer_t *timer);
+
+dc_usecs_t
+dc_timer_scope_end (const dc_timer_scope_t *scope);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
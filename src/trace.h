@@ -0,0 +1,53 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_TRACE_H
+#define DC_TRACE_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/*
+ * Static trace points for the hot paths, in the "libdivecomputer"
+ * provider. With the USDT probes from <sys/sdt.h>, a disabled probe is
+ * a single nop instruction, and the arguments are only evaluated when
+ * they are already available in registers or memory. For example:
+ *
+ *     bpftrace -e 'usdt:libdivecomputer.so:libdivecomputer:iostream_read { ... }'
+ *
+ * Without tracing support, the macros expand to nothing.
+ */
+
+#if defined(ENABLE_TRACING) && defined(HAVE_SYS_SDT_H)
+#include <sys/sdt.h>
+#define TRACE1(name, a) DTRACE_PROBE1 (libdivecomputer, name, a)
+#define TRACE2(name, a, b) DTRACE_PROBE2 (libdivecomputer, name, a, b)
+#define TRACE3(name, a, b, c) DTRACE_PROBE3 (libdivecomputer, name, a, b, c)
+#define TRACE4(name, a, b, c, d) DTRACE_PROBE4 (libdivecomputer, name, a, b, c, d)
+#else
+#define TRACE1(name, a)
+#define TRACE2(name, a, b)
+#define TRACE3(name, a, b, c)
+#define TRACE4(name, a, b, c, d)
+#endif
+
+#endif /* DC_TRACE_H */
@@ -42,13 +42,26 @@
 #include "descriptor-private.h"
 #include "iterator-private.h"
 #include "platform.h"
+#include "thread.h"
+#ifdef HAVE_LIBUSB
+#include "usbasync.h"
+#endif
 
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_usb_vtable)
 
+#define NPOOL 4
+
 typedef struct dc_usb_session_t {
 	size_t refcount;
+	dc_mutex_t *mutex;
 #ifdef HAVE_LIBUSB
 	libusb_context *handle;
+	/* Event thread. */
+	dc_thread_t *thread;
+	int completed;
+	/* Handles of the recently closed connections. */
+	libusb_device_handle *pool[NPOOL];
+	unsigned int npool;
 #endif
 } dc_usb_session_t;
 
@@ -64,6 +77,8 @@ struct dc_usb_device_t {
 };
 
 #ifdef HAVE_LIBUSB
+#define NTRANSFERS 16
+
 static dc_status_t dc_usb_iterator_next (dc_iterator_t *iterator, void *item);
 static dc_status_t dc_usb_iterator_free (dc_iterator_t *iterator);
 
@@ -93,7 +108,24 @@ typedef struct dc_usb_t {
 	unsigned char endpoint_in;
 	unsigned char endpoint_out;
 	unsigned int timeout;
+	dc_usb_async_t *async;
 } dc_usb_t;
+#endif
+
+struct dc_usb_hotplug_t {
+	dc_context_t *context;
+#ifdef HAVE_LIBUSB
+	dc_descriptor_t *descriptor;
+	dc_usb_session_t *session;
+	dc_usb_hotplug_callback_t callback;
+	void *userdata;
+	libusb_hotplug_callback_handle handle;
+	dc_thread_t *thread;
+	int completed;
+#endif
+};
+
+#ifdef HAVE_LIBUSB
 
 static const dc_iterator_vtable_t dc_usb_iterator_vtable = {
 	sizeof(dc_usb_iterator_t),
@@ -111,12 +143,16 @@ static const dc_iostream_vtable_t dc_usb_vtable = {
 	NULL, /* get_available */
 	NULL, /* configure */
 	dc_usb_poll, /* poll */
+	NULL, /* get_fd */
 	dc_usb_read, /* read */
+	NULL, /* read_lend */
+	NULL, /* read_return */
 	dc_usb_write, /* write */
 	dc_usb_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	NULL, /* sleep */
+	NULL, /* interrupt */
 	dc_usb_close, /* close */
 };
 
@@ -158,19 +194,33 @@ dc_usb_session_new (dc_usb_session_t **out, dc_context_t *context)
 	}
 
 	session->refcount = 1;
+	session->thread = NULL;
+	session->completed = 0;
+	session->npool = 0;
+
+	// The session is shared by all devices of the context, and the
+	// devices of a hotplug subscription are created and destroyed from
+	// different threads.
+	status = dc_mutex_new (&session->mutex);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create the mutex.");
+		goto error_free;
+	}
 
 	int rc = libusb_init (&session->handle);
 	if (rc != LIBUSB_SUCCESS) {
 		ERROR (context, "Failed to initialize usb support (%s).",
 			libusb_error_name (rc));
 		status = syserror (rc);
-		goto error_free;
+		goto error_mutex_free;
 	}
 
 	*out = session;
 
 	return status;
 
+error_mutex_free:
+	dc_mutex_free (session->mutex);
 error_free:
 	free (session);
 error_unlock:
@@ -183,7 +233,9 @@ dc_usb_session_ref (dc_usb_session_t *session)
 	if (session == NULL)
 		return NULL;
 
+	dc_mutex_lock (session->mutex);
 	session->refcount++;
+	dc_mutex_unlock (session->mutex);
 
 	return session;
 }
@@ -194,13 +246,149 @@ dc_usb_session_unref (dc_usb_session_t *session)
 	if (session == NULL)
 		return DC_STATUS_SUCCESS;
 
-	if (--session->refcount == 0) {
+	dc_mutex_lock (session->mutex);
+	size_t refcount = --session->refcount;
+	dc_mutex_unlock (session->mutex);
+
+	if (refcount == 0) {
+		if (session->thread) {
+			session->completed = 1;
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+			libusb_interrupt_event_handler (session->handle);
+#endif
+			dc_thread_join (session->thread);
+		}
+		for (unsigned int i = 0; i < session->npool; ++i) {
+			libusb_close (session->pool[i]);
+		}
 		libusb_exit (session->handle);
+		dc_mutex_free (session->mutex);
 		free (session);
 	}
 
 	return DC_STATUS_SUCCESS;
 }
+
+static void
+dc_usb_session_run (void *userdata)
+{
+	dc_usb_session_t *session = (dc_usb_session_t *) userdata;
+
+	while (!session->completed) {
+		struct timeval tv = {1, 0};
+		int rc = libusb_handle_events_timeout_completed (session->handle, &tv, &session->completed);
+		if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED)
+			break;
+	}
+}
+
+/*
+ * The session of the context has its own event thread, which is shared
+ * by the asynchronous transfers of all devices. Without thread support,
+ * the transfers handle the events themselves.
+ */
+static dc_status_t
+dc_usb_session_create (void **out, dc_context_t *context)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usb_session_t *session = NULL;
+
+	status = dc_usb_session_new (&session, context);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (dc_thread_new (&session->thread, dc_usb_session_run, session) != DC_STATUS_SUCCESS) {
+		session->thread = NULL;
+	}
+
+	*out = session;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void *
+dc_usb_session_vref (void *session)
+{
+	return dc_usb_session_ref ((dc_usb_session_t *) session);
+}
+
+static dc_status_t
+dc_usb_session_vunref (void *session)
+{
+	return dc_usb_session_unref ((dc_usb_session_t *) session);
+}
+
+static const dc_resource_vtable_t dc_usb_session_vtable = {
+	dc_usb_session_create,
+	dc_usb_session_vref,
+	dc_usb_session_vunref,
+};
+
+/*
+ * Get a reference to the session of the context. The session stays
+ * alive until the context is freed, such that a new connection does
+ * not pay for the initialization of the usb library again.
+ */
+static dc_status_t
+dc_usb_session_get (dc_usb_session_t **out, dc_context_t *context)
+{
+	void *session = NULL;
+
+	dc_status_t status = dc_context_get_resource (context, DC_RESOURCE_USB, &dc_usb_session_vtable, &session);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*out = (dc_usb_session_t *) session;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Take the handle of a previous connection to the device from the pool,
+ * or return NULL if there is none.
+ */
+static libusb_device_handle *
+dc_usb_session_take (dc_usb_session_t *session, struct libusb_device *device)
+{
+	libusb_device_handle *handle = NULL;
+
+	dc_mutex_lock (session->mutex);
+	for (unsigned int i = 0; i < session->npool; ++i) {
+		if (libusb_get_device (session->pool[i]) == device) {
+			handle = session->pool[i];
+			session->pool[i] = session->pool[--session->npool];
+			break;
+		}
+	}
+	dc_mutex_unlock (session->mutex);
+
+	return handle;
+}
+
+/*
+ * Keep the handle of a closed connection open for a quick reconnect.
+ * When the pool is full, the oldest handle is closed.
+ */
+static void
+dc_usb_session_give (dc_usb_session_t *session, libusb_device_handle *handle)
+{
+	libusb_device_handle *oldest = NULL;
+
+	dc_mutex_lock (session->mutex);
+	if (session->npool == NPOOL) {
+		oldest = session->pool[0];
+		for (unsigned int i = 1; i < NPOOL; ++i) {
+			session->pool[i - 1] = session->pool[i];
+		}
+		session->npool--;
+	}
+	session->pool[session->npool++] = handle;
+	dc_mutex_unlock (session->mutex);
+
+	if (oldest) {
+		libusb_close (oldest);
+	}
+}
 #endif
 
 unsigned int
@@ -251,7 +439,7 @@ dc_usb_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descriptor_t
 	}
 
 	// Initialize the usb library.
-	status = dc_usb_session_new (&iterator->session, context);
+	status = dc_usb_session_get (&iterator->session, context);
 	if (status != DC_STATUS_SUCCESS) {
 		goto error_free;
 	}
@@ -286,104 +474,122 @@ error_free:
 }
 
 #ifdef HAVE_LIBUSB
+/*
+ * Create the device object for a libusb device. If the device is not
+ * accepted by the descriptor, or has no matching bulk endpoints,
+ * DC_STATUS_NODEVICE is returned.
+ */
 static dc_status_t
-dc_usb_iterator_next (dc_iterator_t *abstract, void *out)
+dc_usb_device_new (dc_usb_device_t **out, dc_context_t *context, dc_usb_session_t *session, dc_descriptor_t *descriptor, struct libusb_device *current)
 {
-	dc_usb_iterator_t *iterator = (dc_usb_iterator_t *) abstract;
 	dc_usb_device_t *device = NULL;
 
-	while (iterator->current < iterator->count) {
-		struct libusb_device *current = iterator->devices[iterator->current++];
-
-		// Get the device descriptor.
-		struct libusb_device_descriptor dev;
-		int rc = libusb_get_device_descriptor (current, &dev);
-		if (rc < 0) {
-			ERROR (abstract->context, "Failed to get the device descriptor (%s).",
-				libusb_error_name (rc));
-			return syserror (rc);
-		}
+	// Get the device descriptor.
+	struct libusb_device_descriptor dev;
+	int rc = libusb_get_device_descriptor (current, &dev);
+	if (rc < 0) {
+		ERROR (context, "Failed to get the device descriptor (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
 
-		dc_usb_desc_t usb = {dev.idVendor, dev.idProduct};
-		dc_usb_params_t params = {0, 0, 0};
-		if (!dc_descriptor_filter (iterator->descriptor, DC_TRANSPORT_USB, &usb, &params)) {
-			continue;
-		}
+	dc_usb_desc_t usb = {dev.idVendor, dev.idProduct};
+	dc_usb_params_t params = {0, 0, 0};
+	if (!dc_descriptor_filter (descriptor, DC_TRANSPORT_USB, &usb, &params)) {
+		return DC_STATUS_NODEVICE;
+	}
 
-		// Get the active configuration descriptor.
-		struct libusb_config_descriptor *config = NULL;
-		rc = libusb_get_active_config_descriptor (current, &config);
-		if (rc != LIBUSB_SUCCESS) {
-			ERROR (abstract->context, "Failed to get the configuration descriptor (%s).",
-				libusb_error_name (rc));
-			return syserror (rc);
-		}
+	// Get the active configuration descriptor.
+	struct libusb_config_descriptor *config = NULL;
+	rc = libusb_get_active_config_descriptor (current, &config);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to get the configuration descriptor (%s).",
+			libusb_error_name (rc));
+		return syserror (rc);
+	}
 
-		// Find the first matching interface.
-		const struct libusb_interface_descriptor *interface = NULL;
-		for (unsigned int i = 0; i < config->bNumInterfaces; i++) {
-			const struct libusb_interface *iface = &config->interface[i];
-			for (int j = 0; j < iface->num_altsetting; j++) {
-				const struct libusb_interface_descriptor *desc = &iface->altsetting[j];
-				if (interface == NULL && desc->bInterfaceNumber == params.interface) {
-					interface = desc;
-				}
+	// Find the first matching interface.
+	const struct libusb_interface_descriptor *interface = NULL;
+	for (unsigned int i = 0; i < config->bNumInterfaces; i++) {
+		const struct libusb_interface *iface = &config->interface[i];
+		for (int j = 0; j < iface->num_altsetting; j++) {
+			const struct libusb_interface_descriptor *desc = &iface->altsetting[j];
+			if (interface == NULL && desc->bInterfaceNumber == params.interface) {
+				interface = desc;
 			}
 		}
+	}
+
+	if (interface == NULL) {
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_NODEVICE;
+	}
+
+	// Find the first matching input and output bulk endpoints.
+	const struct libusb_endpoint_descriptor *ep_in = NULL, *ep_out = NULL;
+	for (unsigned int i = 0; i < interface->bNumEndpoints; i++) {
+		const struct libusb_endpoint_descriptor *desc = &interface->endpoint[i];
 
-		if (interface == NULL) {
-			libusb_free_config_descriptor (config);
+		unsigned int type = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
+		unsigned int direction = desc->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK;
+
+		if (type != LIBUSB_TRANSFER_TYPE_BULK) {
 			continue;
 		}
 
-		// Find the first matching input and output bulk endpoints.
-		const struct libusb_endpoint_descriptor *ep_in = NULL, *ep_out = NULL;
-		for (unsigned int i = 0; i < interface->bNumEndpoints; i++) {
-			const struct libusb_endpoint_descriptor *desc = &interface->endpoint[i];
+		if (ep_in == NULL && direction == LIBUSB_ENDPOINT_IN &&
+			(params.endpoint_in == 0 || params.endpoint_in == desc->bEndpointAddress)) {
+			ep_in = desc;
+		}
 
-			unsigned int type = desc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
-			unsigned int direction = desc->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK;
+		if (ep_out == NULL && direction == LIBUSB_ENDPOINT_OUT &&
+			(params.endpoint_out == 0 || params.endpoint_out == desc->bEndpointAddress)) {
+			ep_out = desc;
+		}
+	}
 
-			if (type != LIBUSB_TRANSFER_TYPE_BULK) {
-				continue;
-			}
+	if (ep_in == NULL || ep_out == NULL) {
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_NODEVICE;
+	}
 
-			if (ep_in == NULL && direction == LIBUSB_ENDPOINT_IN &&
-				(params.endpoint_in == 0 || params.endpoint_in == desc->bEndpointAddress)) {
-				ep_in = desc;
-			}
+	device = (dc_usb_device_t *) malloc (sizeof(dc_usb_device_t));
+	if (device == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		libusb_free_config_descriptor (config);
+		return DC_STATUS_NOMEMORY;
+	}
 
-			if (ep_out == NULL && direction == LIBUSB_ENDPOINT_OUT &&
-				(params.endpoint_out == 0 || params.endpoint_out == desc->bEndpointAddress)) {
-				ep_out = desc;
-			}
-		}
+	device->session = dc_usb_session_ref (session);
+	device->vid = dev.idVendor;
+	device->pid = dev.idProduct;
+	device->handle = libusb_ref_device (current);
+	device->interface = interface->bInterfaceNumber;
+	device->endpoint_in = ep_in->bEndpointAddress;
+	device->endpoint_out = ep_out->bEndpointAddress;
 
-		if (ep_in == NULL || ep_out == NULL) {
-			libusb_free_config_descriptor (config);
-			continue;
-		}
+	*out = device;
 
-		device = (dc_usb_device_t *) malloc (sizeof(dc_usb_device_t));
-		if (device == NULL) {
-			ERROR (abstract->context, "Failed to allocate memory.");
-			libusb_free_config_descriptor (config);
-			return DC_STATUS_NOMEMORY;
-		}
+	libusb_free_config_descriptor (config);
 
-		device->session = dc_usb_session_ref (iterator->session);
-		device->vid = dev.idVendor;
-		device->pid = dev.idProduct;
-		device->handle = libusb_ref_device (current);
-		device->interface = interface->bInterfaceNumber;
-		device->endpoint_in = ep_in->bEndpointAddress;
-		device->endpoint_out = ep_out->bEndpointAddress;
+	return DC_STATUS_SUCCESS;
+}
 
-		*(dc_usb_device_t **) out = device;
+static dc_status_t
+dc_usb_iterator_next (dc_iterator_t *abstract, void *out)
+{
+	dc_usb_iterator_t *iterator = (dc_usb_iterator_t *) abstract;
 
-		libusb_free_config_descriptor (config);
+	while (iterator->current < iterator->count) {
+		struct libusb_device *current = iterator->devices[iterator->current++];
 
-		return DC_STATUS_SUCCESS;
+		dc_status_t status = dc_usb_device_new ((dc_usb_device_t **) out,
+			abstract->context, iterator->session, iterator->descriptor, current);
+		if (status == DC_STATUS_NODEVICE) {
+			continue;
+		}
+
+		return status;
 	}
 
 	return DC_STATUS_DONE;
@@ -399,7 +605,132 @@ dc_usb_iterator_free (dc_iterator_t *abstract)
 
 	return DC_STATUS_SUCCESS;
 }
+
+static int LIBUSB_CALL
+dc_usb_hotplug_cb (libusb_context *handle, libusb_device *current, libusb_hotplug_event event, void *userdata)
+{
+	dc_usb_hotplug_t *hotplug = (dc_usb_hotplug_t *) userdata;
+	dc_usb_device_t *device = NULL;
+
+	// For a device which is gone, libusb still has the cached
+	// descriptors, so the same checks apply to both events.
+	dc_status_t status = dc_usb_device_new (&device, hotplug->context, hotplug->session, hotplug->descriptor, current);
+	if (status != DC_STATUS_SUCCESS) {
+		return 0;
+	}
+
+	hotplug->callback (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED ?
+		DC_USB_HOTPLUG_ARRIVED : DC_USB_HOTPLUG_LEFT,
+		device, hotplug->userdata);
+
+	return 0;
+}
+
+static void
+dc_usb_hotplug_run (void *userdata)
+{
+	dc_usb_hotplug_t *hotplug = (dc_usb_hotplug_t *) userdata;
+
+	while (!hotplug->completed) {
+		int rc = libusb_handle_events_completed (hotplug->session->handle, &hotplug->completed);
+		if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+			ERROR (hotplug->context, "Failed to handle the usb events (%s).",
+				libusb_error_name (rc));
+			break;
+		}
+	}
+}
+#endif
+
+dc_status_t
+dc_usb_hotplug_new (dc_usb_hotplug_t **out, dc_context_t *context, dc_descriptor_t *descriptor, dc_usb_hotplug_callback_t callback, void *userdata)
+{
+#ifdef HAVE_LIBUSB
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usb_hotplug_t *hotplug = NULL;
+
+	if (out == NULL || callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (!libusb_has_capability (LIBUSB_CAP_HAS_HOTPLUG)) {
+		ERROR (context, "Hotplug notifications are not supported.");
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	hotplug = (dc_usb_hotplug_t *) malloc (sizeof (dc_usb_hotplug_t));
+	if (hotplug == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	hotplug->context = context;
+	hotplug->descriptor = descriptor;
+	hotplug->callback = callback;
+	hotplug->userdata = userdata;
+	hotplug->thread = NULL;
+	hotplug->completed = 0;
+
+	// Initialize the usb library.
+	status = dc_usb_session_new (&hotplug->session, context);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_free;
+	}
+
+	// Register the callback. The devices which are already connected
+	// are reported immediately, from the calling thread.
+	int rc = libusb_hotplug_register_callback (hotplug->session->handle,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+		LIBUSB_HOTPLUG_ENUMERATE,
+		LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		dc_usb_hotplug_cb, hotplug, &hotplug->handle);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (context, "Failed to register the hotplug callback (%s).",
+			libusb_error_name (rc));
+		status = syserror (rc);
+		goto error_session_unref;
+	}
+
+	// Handle the events in the background.
+	status = dc_thread_new (&hotplug->thread, dc_usb_hotplug_run, hotplug);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create the event thread.");
+		goto error_deregister;
+	}
+
+	*out = hotplug;
+
+	return DC_STATUS_SUCCESS;
+
+error_deregister:
+	libusb_hotplug_deregister_callback (hotplug->session->handle, hotplug->handle);
+error_session_unref:
+	dc_usb_session_unref (hotplug->session);
+error_free:
+	free (hotplug);
+	return status;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
+dc_status_t
+dc_usb_hotplug_free (dc_usb_hotplug_t *hotplug)
+{
+	if (hotplug == NULL)
+		return DC_STATUS_SUCCESS;
+
+#ifdef HAVE_LIBUSB
+	// Deregistering the callback wakes up the event thread.
+	hotplug->completed = 1;
+	libusb_hotplug_deregister_callback (hotplug->session->handle, hotplug->handle);
+	dc_thread_join (hotplug->thread);
+
+	dc_usb_session_unref (hotplug->session);
 #endif
+	free (hotplug);
+
+	return DC_STATUS_SUCCESS;
+}
 
 dc_status_t
 dc_usb_open (dc_iostream_t **out, dc_context_t *context, dc_usb_device_t *device)
@@ -427,18 +758,23 @@ dc_usb_open (dc_iostream_t **out, dc_context_t *context, dc_usb_device_t *device
 		goto error_free;
 	}
 
-	// Open the USB device.
-	int rc = libusb_open (device->handle, &usb->handle);
-	if (rc != LIBUSB_SUCCESS) {
-		ERROR (context, "Failed to open the usb device (%s).",
-			libusb_error_name (rc));
-		status = syserror (rc);
-		goto error_session_unref;
-	}
+	// Re-use the handle of a previous connection, or open the USB
+	// device.
+	int rc = LIBUSB_SUCCESS;
+	usb->handle = dc_usb_session_take (usb->session, device->handle);
+	if (usb->handle == NULL) {
+		rc = libusb_open (device->handle, &usb->handle);
+		if (rc != LIBUSB_SUCCESS) {
+			ERROR (context, "Failed to open the usb device (%s).",
+				libusb_error_name (rc));
+			status = syserror (rc);
+			goto error_session_unref;
+		}
 
 #if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
-	libusb_set_auto_detach_kernel_driver (usb->handle, 1);
+		libusb_set_auto_detach_kernel_driver (usb->handle, 1);
 #endif
+	}
 
 	// Claim the interface.
 	rc = libusb_claim_interface (usb->handle, device->interface);
@@ -454,6 +790,19 @@ dc_usb_open (dc_iostream_t **out, dc_context_t *context, dc_usb_device_t *device
 	usb->endpoint_out = device->endpoint_out;
 	usb->timeout = 0;
 
+	// Keep several bulk transfers in flight, to receive the data while
+	// the previous packets are being processed. Every transfer is
+	// limited to a single packet, such that a transfer never has to
+	// wait for more data than the device is about to send. On failure,
+	// the synchronous transfers are used instead.
+	rc = dc_usb_async_new (&usb->async, context, usb->session->handle,
+		usb->session->thread != NULL, usb->handle, LIBUSB_TRANSFER_TYPE_BULK, usb->endpoint_in, 0, NTRANSFERS);
+	if (rc != LIBUSB_SUCCESS) {
+		WARNING (context, "Failed to start the asynchronous transfers (%s).",
+			libusb_error_name (rc));
+		usb->async = NULL;
+	}
+
 	*out = (dc_iostream_t *) usb;
 
 	return DC_STATUS_SUCCESS;
@@ -477,8 +826,9 @@ dc_usb_close (dc_iostream_t *abstract)
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_usb_t *usb = (dc_usb_t *) abstract;
 
+	dc_usb_async_free (usb->async);
 	libusb_release_interface (usb->handle, usb->interface);
-	libusb_close (usb->handle);
+	dc_usb_session_give (usb->session, usb->handle);
 	dc_usb_session_unref (usb->session);
 
 	return status;
@@ -503,7 +853,21 @@ dc_usb_set_timeout (dc_iostream_t *abstract, int timeout)
 static dc_status_t
 dc_usb_poll (dc_iostream_t *abstract, int timeout)
 {
-	return DC_STATUS_UNSUPPORTED;
+	dc_usb_t *usb = (dc_usb_t *) abstract;
+
+	if (usb->async == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	int rc = dc_usb_async_poll (usb->async, timeout);
+	if (rc != LIBUSB_SUCCESS) {
+		if (rc != LIBUSB_ERROR_TIMEOUT) {
+			ERROR (abstract->context, "Usb poll failed (%s).",
+				libusb_error_name (rc));
+		}
+		return syserror (rc);
+	}
+
+	return DC_STATUS_SUCCESS;
 }
 
 static dc_status_t
@@ -513,7 +877,12 @@ dc_usb_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 	dc_usb_t *usb = (dc_usb_t *) abstract;
 	int nbytes = 0;
 
-	int rc = libusb_bulk_transfer (usb->handle, usb->endpoint_in, data, size, &nbytes, usb->timeout);
+	int rc = 0;
+	if (usb->async) {
+		rc = dc_usb_async_read (usb->async, data, size, &nbytes, usb->timeout);
+	} else {
+		rc = libusb_bulk_transfer (usb->handle, usb->endpoint_in, data, size, &nbytes, usb->timeout);
+	}
 	if (rc != LIBUSB_SUCCESS || nbytes < 0) {
 		ERROR (abstract->context, "Usb read bulk transfer failed (%s).",
 			libusb_error_name (rc));
@@ -576,6 +945,24 @@ dc_usb_ioctl_control (dc_iostream_t *abstract, void *data, size_t size)
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+dc_usb_ioctl_statistics (dc_iostream_t *abstract, void *data, size_t size)
+{
+	dc_usb_t *usb = (dc_usb_t *) abstract;
+
+	if (size < sizeof(dc_usb_statistics_t)) {
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	if (usb->async == NULL) {
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	dc_usb_async_get_statistics (usb->async, (dc_usb_statistics_t *) data);
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dc_usb_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
 {
@@ -583,6 +970,8 @@ dc_usb_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t
 	case DC_IOCTL_USB_CONTROL_READ:
 	case DC_IOCTL_USB_CONTROL_WRITE:
 		return dc_usb_ioctl_control (abstract, data, size);
+	case DC_IOCTL_USB_STATISTICS:
+		return dc_usb_ioctl_statistics (abstract, data, size);
 	default:
 		return DC_STATUS_UNSUPPORTED;
 	}
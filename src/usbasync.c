@@ -0,0 +1,489 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LIBUSB
+
+#include "usbasync.h"
+#include "context-private.h"
+#include "platform.h"
+#include "timer.h"
+
+#define DEFAULT_LENGTH 64
+
+#ifdef _WIN32
+#define DC_PRINTF_U64 "%I64u"
+#else
+#define DC_PRINTF_U64 "%llu"
+#endif
+
+typedef struct dc_usb_async_slot_t {
+	dc_usb_async_t *async;
+	struct libusb_transfer *transfer;
+	dc_usecs_t submitted;
+} dc_usb_async_slot_t;
+
+struct dc_usb_async_t {
+	dc_context_t *context;
+	libusb_context *ctx;
+	int threaded;
+	libusb_device_handle *handle;
+	dc_timer_t *timer;
+	unsigned char type;
+	unsigned char endpoint;
+	unsigned int length;
+	unsigned int ntransfers;
+	dc_usb_async_slot_t *slots;
+	/* Completed transfers, in order of completion. */
+	dc_usb_async_slot_t **queue;
+	unsigned int head;
+	unsigned int count;
+	/* Number of bytes already consumed from the head transfer. */
+	unsigned int offset;
+	/* Number of submitted transfers. */
+	unsigned int pending;
+	dc_usb_statistics_t statistics;
+};
+
+static void LIBUSB_CALL
+dc_usb_async_callback (struct libusb_transfer *transfer)
+{
+	dc_usb_async_slot_t *slot = (dc_usb_async_slot_t *) transfer->user_data;
+	dc_usb_async_t *async = slot->async;
+	dc_usb_statistics_t *statistics = &async->statistics;
+
+	libusb_lock_event_waiters (async->ctx);
+
+	async->pending--;
+
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		goto done;
+
+	// Update the statistics.
+	dc_usecs_t now = 0;
+	dc_timer_now (async->timer, &now);
+	unsigned int latency = now > slot->submitted ? now - slot->submitted : 0;
+	if (statistics->transfers == 0 || latency < statistics->latency_min)
+		statistics->latency_min = latency;
+	if (latency > statistics->latency_max)
+		statistics->latency_max = latency;
+	statistics->latency_total += latency;
+	statistics->transfers++;
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		statistics->bytes += transfer->actual_length;
+	} else {
+		statistics->errors++;
+	}
+
+	async->queue[(async->head + async->count) % async->ntransfers] = slot;
+	async->count++;
+
+	if (async->count > statistics->queued_max)
+		statistics->queued_max = async->count;
+
+done:
+	libusb_unlock_event_waiters (async->ctx);
+}
+
+static int
+dc_usb_async_submit (dc_usb_async_t *async, dc_usb_async_slot_t *slot)
+{
+	dc_timer_now (async->timer, &slot->submitted);
+
+	// The transfer may complete on the event thread before the submit
+	// returns, so the pending counter is updated under the lock.
+	libusb_lock_event_waiters (async->ctx);
+	int rc = libusb_submit_transfer (slot->transfer);
+	if (rc == LIBUSB_SUCCESS) {
+		async->pending++;
+	}
+	libusb_unlock_event_waiters (async->ctx);
+
+	if (rc != LIBUSB_SUCCESS) {
+		WARNING (async->context, "Failed to submit the usb transfer (%s).",
+			libusb_error_name (rc));
+		return rc;
+	}
+
+	return LIBUSB_SUCCESS;
+}
+
+static int
+dc_usb_async_status (enum libusb_transfer_status status)
+{
+	switch (status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		return LIBUSB_SUCCESS;
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		return LIBUSB_ERROR_TIMEOUT;
+	case LIBUSB_TRANSFER_STALL:
+		return LIBUSB_ERROR_PIPE;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		return LIBUSB_ERROR_NO_DEVICE;
+	case LIBUSB_TRANSFER_OVERFLOW:
+		return LIBUSB_ERROR_OVERFLOW;
+	default:
+		return LIBUSB_ERROR_IO;
+	}
+}
+
+/*
+ * Get the number of completed transfers, and optionally the number of
+ * submitted transfers.
+ */
+static unsigned int
+dc_usb_async_count (dc_usb_async_t *async, unsigned int *pending)
+{
+	libusb_lock_event_waiters (async->ctx);
+	unsigned int count = async->count;
+	if (pending)
+		*pending = async->pending;
+	libusb_unlock_event_waiters (async->ctx);
+
+	return count;
+}
+
+/*
+ * Handle the libusb events, or wait for the event thread, until a
+ * completed transfer is available, or the deadline expires. A zero
+ * deadline waits forever, and a negative one only processes the pending
+ * events without blocking.
+ */
+static int
+dc_usb_async_wait (dc_usb_async_t *async, long long deadline)
+{
+	unsigned int pending = 0;
+
+	while (dc_usb_async_count (async, &pending) == 0) {
+		struct timeval tv = {1, 0};
+
+		if (pending == 0) {
+			// No more data will arrive.
+			return LIBUSB_ERROR_IO;
+		}
+
+		if (deadline < 0) {
+			tv.tv_sec = tv.tv_usec = 0;
+		} else if (deadline > 0) {
+			dc_usecs_t now = 0;
+			dc_timer_now (async->timer, &now);
+			if ((long long) now >= deadline)
+				return LIBUSB_ERROR_TIMEOUT;
+			long long remaining = deadline - (long long) now;
+			tv.tv_sec  = remaining / 1000000;
+			tv.tv_usec = remaining % 1000000;
+		}
+
+		if (async->threaded) {
+			// The completion may already be queued, and the wait
+			// returns after every round of the event thread.
+			libusb_lock_event_waiters (async->ctx);
+			if (async->count == 0 && (tv.tv_sec || tv.tv_usec)) {
+				libusb_wait_for_event (async->ctx, &tv);
+			}
+			libusb_unlock_event_waiters (async->ctx);
+		} else {
+			int rc = libusb_handle_events_timeout_completed (async->ctx, &tv, NULL);
+			if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED)
+				return rc;
+		}
+
+		if (deadline < 0 && dc_usb_async_count (async, NULL) == 0)
+			return LIBUSB_ERROR_TIMEOUT;
+	}
+
+	return LIBUSB_SUCCESS;
+}
+
+static long long
+dc_usb_async_deadline (dc_usb_async_t *async, long long timeout)
+{
+	dc_usecs_t now = 0;
+
+	if (timeout <= 0)
+		return timeout;
+
+	dc_timer_now (async->timer, &now);
+
+	return (long long) now + timeout * 1000;
+}
+
+/*
+ * Remove the head transfer from the queue, and submit it again for the
+ * next packet.
+ */
+static void
+dc_usb_async_release (dc_usb_async_t *async)
+{
+	libusb_lock_event_waiters (async->ctx);
+	dc_usb_async_slot_t *slot = async->queue[async->head];
+	async->head = (async->head + 1) % async->ntransfers;
+	async->count--;
+	async->offset = 0;
+	libusb_unlock_event_waiters (async->ctx);
+
+	if (slot->transfer->status != LIBUSB_TRANSFER_NO_DEVICE) {
+		dc_usb_async_submit (async, slot);
+	}
+}
+
+int
+dc_usb_async_new (dc_usb_async_t **out, dc_context_t *context, libusb_context *ctx, int threaded, libusb_device_handle *handle, unsigned char type, unsigned char endpoint, unsigned int length, unsigned int ntransfers)
+{
+	int rc = LIBUSB_SUCCESS;
+	dc_usb_async_t *async = NULL;
+
+	if (out == NULL || ntransfers == 0 ||
+		(type != LIBUSB_TRANSFER_TYPE_BULK && type != LIBUSB_TRANSFER_TYPE_INTERRUPT))
+		return LIBUSB_ERROR_INVALID_PARAM;
+
+	// Allocate memory.
+	async = (dc_usb_async_t *) malloc (sizeof (dc_usb_async_t));
+	if (async == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return LIBUSB_ERROR_NO_MEM;
+	}
+
+	async->context = context;
+	async->ctx = ctx;
+	async->threaded = threaded;
+	async->handle = handle;
+	async->timer = NULL;
+	async->type = type;
+	async->endpoint = endpoint;
+	async->ntransfers = ntransfers;
+	async->head = 0;
+	async->count = 0;
+	async->offset = 0;
+	async->pending = 0;
+	memset (&async->statistics, 0, sizeof (async->statistics));
+
+	// Use the maximum packet size of the endpoint as the default
+	// transfer size.
+	if (length == 0) {
+		int maxsize = libusb_get_max_packet_size (libusb_get_device (handle), endpoint);
+		length = maxsize > 0 ? maxsize : DEFAULT_LENGTH;
+	}
+	async->length = length;
+
+	if (dc_timer_new (&async->timer) != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		rc = LIBUSB_ERROR_OTHER;
+		goto error_free;
+	}
+
+	async->slots = (dc_usb_async_slot_t *) calloc (ntransfers, sizeof (*async->slots));
+	async->queue = (dc_usb_async_slot_t **) calloc (ntransfers, sizeof (*async->queue));
+	if (async->slots == NULL || async->queue == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		rc = LIBUSB_ERROR_NO_MEM;
+		goto error_free_transfers;
+	}
+
+	for (unsigned int i = 0; i < ntransfers; ++i) {
+		dc_usb_async_slot_t *slot = &async->slots[i];
+		unsigned char *buffer = (unsigned char *) malloc (async->length);
+		slot->async = async;
+		slot->transfer = libusb_alloc_transfer (0);
+		if (buffer == NULL || slot->transfer == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			free (buffer);
+			rc = LIBUSB_ERROR_NO_MEM;
+			goto error_free_transfers;
+		}
+
+		if (type == LIBUSB_TRANSFER_TYPE_BULK) {
+			libusb_fill_bulk_transfer (slot->transfer, handle, endpoint,
+				buffer, async->length, dc_usb_async_callback, slot, 0);
+		} else {
+			libusb_fill_interrupt_transfer (slot->transfer, handle, endpoint,
+				buffer, async->length, dc_usb_async_callback, slot, 0);
+		}
+		slot->transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+	}
+
+	for (unsigned int i = 0; i < ntransfers; ++i) {
+		rc = dc_usb_async_submit (async, &async->slots[i]);
+		if (rc != LIBUSB_SUCCESS) {
+			goto error_cancel;
+		}
+	}
+
+	*out = async;
+
+	return LIBUSB_SUCCESS;
+
+error_cancel:
+	dc_usb_async_free (async);
+	return rc;
+
+error_free_transfers:
+	for (unsigned int i = 0; async->slots && i < ntransfers; ++i) {
+		if (async->slots[i].transfer)
+			libusb_free_transfer (async->slots[i].transfer);
+	}
+	free (async->queue);
+	free (async->slots);
+	dc_timer_free (async->timer);
+error_free:
+	free (async);
+	return rc;
+}
+
+int
+dc_usb_async_poll (dc_usb_async_t *async, int timeout)
+{
+	long long deadline = 0;
+
+	if (timeout == 0)
+		deadline = -1;
+	else if (timeout > 0)
+		deadline = dc_usb_async_deadline (async, timeout);
+
+	return dc_usb_async_wait (async, deadline);
+}
+
+int
+dc_usb_async_read (dc_usb_async_t *async, unsigned char data[], size_t size, int *actual, unsigned int timeout)
+{
+	int rc = LIBUSB_SUCCESS;
+	size_t nbytes = 0;
+
+	long long deadline = dc_usb_async_deadline (async, timeout);
+
+	while (1) {
+		rc = dc_usb_async_wait (async, deadline);
+		if (rc != LIBUSB_SUCCESS)
+			break;
+
+		struct libusb_transfer *transfer = async->queue[async->head]->transfer;
+
+		rc = dc_usb_async_status (transfer->status);
+		if (rc != LIBUSB_SUCCESS) {
+			dc_usb_async_release (async);
+			break;
+		}
+
+		unsigned int available = transfer->actual_length - async->offset;
+		int eop = transfer->actual_length < transfer->length;
+
+		if (async->type == LIBUSB_TRANSFER_TYPE_INTERRUPT) {
+			// Every read returns a single packet.
+			if (available > size) {
+				WARNING (async->context, "Insufficient buffer space available (%u > " DC_PRINTF_SIZE ").", available, size);
+				available = size;
+			}
+			memcpy (data, transfer->buffer, available);
+			nbytes = available;
+			dc_usb_async_release (async);
+			break;
+		}
+
+		// Copy as much data as possible, and keep the remainder of the
+		// packet for the next read.
+		size_t n = available < size - nbytes ? available : size - nbytes;
+		memcpy (data + nbytes, transfer->buffer + async->offset, n);
+		nbytes += n;
+		async->offset += n;
+
+		if (async->offset == (unsigned int) transfer->actual_length) {
+			dc_usb_async_release (async);
+			// A short packet terminates the transfer.
+			if (eop)
+				break;
+		}
+
+		if (nbytes == size)
+			break;
+	}
+
+	if (actual)
+		*actual = nbytes;
+
+	return rc;
+}
+
+void
+dc_usb_async_get_statistics (dc_usb_async_t *async, dc_usb_statistics_t *statistics)
+{
+	*statistics = async->statistics;
+}
+
+void
+dc_usb_async_free (dc_usb_async_t *async)
+{
+	if (async == NULL)
+		return;
+
+	const dc_usb_statistics_t *statistics = &async->statistics;
+	DEBUG (async->context, "Usb transfers: count=%u, errors=%u, bytes=" DC_PRINTF_U64 ", queued=%u, latency=%u/%u/%u",
+		statistics->transfers, statistics->errors, statistics->bytes, statistics->queued_max,
+		statistics->latency_min,
+		statistics->transfers ? (unsigned int) (statistics->latency_total / statistics->transfers) : 0,
+		statistics->latency_max);
+
+	// Cancel the submitted transfers, and wait for their completion.
+	for (unsigned int i = 0; i < async->ntransfers; ++i) {
+		libusb_cancel_transfer (async->slots[i].transfer);
+	}
+
+	while (1) {
+		unsigned int pending = 0;
+		dc_usb_async_count (async, &pending);
+		if (pending == 0)
+			break;
+
+		struct timeval tv = {0, 100000};
+		if (async->threaded) {
+			libusb_lock_event_waiters (async->ctx);
+			if (async->pending) {
+				libusb_wait_for_event (async->ctx, &tv);
+			}
+			libusb_unlock_event_waiters (async->ctx);
+			continue;
+		}
+
+		int rc = libusb_handle_events_timeout_completed (async->ctx, &tv, NULL);
+		if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+			ERROR (async->context, "Failed to cancel the usb transfers (%s).",
+				libusb_error_name (rc));
+			// The transfers are still in use, and can't be freed.
+			return;
+		}
+	}
+
+	for (unsigned int i = 0; i < async->ntransfers; ++i) {
+		libusb_free_transfer (async->slots[i].transfer);
+	}
+
+	free (async->queue);
+	free (async->slots);
+	dc_timer_free (async->timer);
+	free (async);
+}
+
+#endif /* HAVE_LIBUSB */
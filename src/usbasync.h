@@ -0,0 +1,78 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_USBASYNC_H
+#define DC_USBASYNC_H
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#endif
+#include <libusb.h>
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/usb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Asynchronous reads from a USB IN endpoint.
+ *
+ * A number of transfers are kept submitted at all times, and the
+ * completed transfers are queued until they are read. The libusb events
+ * are handled from within the read and poll functions, unless the
+ * libusb context has its own event thread (threaded), in which case
+ * these functions only wait for the completions. The queue is protected
+ * with the libusb event waiters lock, so the events may be handled from
+ * any thread. The functions return libusb error codes, to be used as a
+ * drop-in replacement for the synchronous transfers.
+ *
+ * For interrupt endpoints, every read returns a single packet. For bulk
+ * endpoints, the data is read as a stream: a read returns once the
+ * buffer is full, or after a short packet, like a synchronous bulk
+ * transfer. On timeout, the data received so far is returned.
+ *
+ * A zero length uses the maximum packet size of the endpoint.
+ */
+typedef struct dc_usb_async_t dc_usb_async_t;
+
+int
+dc_usb_async_new (dc_usb_async_t **async, dc_context_t *context, libusb_context *ctx, int threaded, libusb_device_handle *handle, unsigned char type, unsigned char endpoint, unsigned int length, unsigned int ntransfers);
+
+int
+dc_usb_async_poll (dc_usb_async_t *async, int timeout);
+
+int
+dc_usb_async_read (dc_usb_async_t *async, unsigned char data[], size_t size, int *actual, unsigned int timeout);
+
+void
+dc_usb_async_get_statistics (dc_usb_async_t *async, dc_usb_statistics_t *statistics);
+
+void
+dc_usb_async_free (dc_usb_async_t *async);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_USBASYNC_H */
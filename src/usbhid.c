@@ -60,6 +60,9 @@
 #include "descriptor-private.h"
 #include "iterator-private.h"
 #include "platform.h"
+#if defined(USE_LIBUSB)
+#include "usbasync.h"
+#endif
 
 #ifdef _WIN32
 typedef LONG dc_mutex_t;
@@ -71,6 +74,8 @@ typedef pthread_mutex_t dc_mutex_t;
 
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_usbhid_vtable)
 
+#define NTRANSFERS 4
+
 typedef struct dc_usbhid_session_t {
 	size_t refcount;
 #if defined(USE_LIBUSB)
@@ -126,6 +131,7 @@ typedef struct dc_usbhid_t {
 	unsigned char endpoint_in;
 	unsigned char endpoint_out;
 	unsigned int timeout;
+	dc_usb_async_t *async;
 #elif defined(USE_HIDAPI)
 	hid_device *handle;
 	int timeout;
@@ -148,17 +154,21 @@ static const dc_iostream_vtable_t dc_usbhid_vtable = {
 	NULL, /* get_available */
 	NULL, /* configure */
 	dc_usbhid_poll, /* poll */
+	NULL, /* get_fd */
 	dc_usbhid_read, /* read */
+	NULL, /* read_lend */
+	NULL, /* read_return */
 	dc_usbhid_write, /* write */
 	dc_usbhid_ioctl, /* ioctl */
 	NULL, /* flush */
 	NULL, /* purge */
 	NULL, /* sleep */
+	NULL, /* interrupt */
 	dc_usbhid_close, /* close */
 };
 
-#ifdef USE_HIDAPI
 static dc_mutex_t g_usbhid_mutex = DC_MUTEX_INIT;
+#ifdef USE_HIDAPI
 static dc_usbhid_session_t *g_usbhid_session = NULL;
 #endif
 
@@ -185,7 +195,6 @@ syserror(int errcode)
 }
 #endif
 
-#ifdef USE_HIDAPI
 static void
 dc_mutex_lock (dc_mutex_t *mutex)
 {
@@ -207,7 +216,6 @@ dc_mutex_unlock (dc_mutex_t *mutex)
 	pthread_mutex_unlock (mutex);
 #endif
 }
-#endif
 
 static dc_status_t
 dc_usbhid_session_new (dc_usbhid_session_t **out, dc_context_t *context)
@@ -278,15 +286,9 @@ dc_usbhid_session_ref (dc_usbhid_session_t *session)
 	if (session == NULL)
 		return NULL;
 
-#ifdef USE_HIDAPI
 	dc_mutex_lock (&g_usbhid_mutex);
-#endif
-
 	session->refcount++;
-
-#ifdef USE_HIDAPI
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
 
 	return session;
 }
@@ -297,9 +299,7 @@ dc_usbhid_session_unref (dc_usbhid_session_t *session)
 	if (session == NULL)
 		return DC_STATUS_SUCCESS;
 
-#ifdef USE_HIDAPI
 	dc_mutex_lock (&g_usbhid_mutex);
-#endif
 
 	if (--session->refcount == 0) {
 #if defined(USE_LIBUSB)
@@ -311,9 +311,57 @@ dc_usbhid_session_unref (dc_usbhid_session_t *session)
 		free (session);
 	}
 
-#ifdef USE_HIDAPI
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbhid_session_create (void **out, dc_context_t *context)
+{
+	dc_usbhid_session_t *session = NULL;
+
+	dc_status_t status = dc_usbhid_session_new (&session, context);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*out = session;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void *
+dc_usbhid_session_vref (void *session)
+{
+	return dc_usbhid_session_ref ((dc_usbhid_session_t *) session);
+}
+
+static dc_status_t
+dc_usbhid_session_vunref (void *session)
+{
+	return dc_usbhid_session_unref ((dc_usbhid_session_t *) session);
+}
+
+static const dc_resource_vtable_t dc_usbhid_session_vtable = {
+	dc_usbhid_session_create,
+	dc_usbhid_session_vref,
+	dc_usbhid_session_vunref,
+};
+
+/*
+ * Get a reference to the session of the context. The session stays
+ * alive until the context is freed.
+ */
+static dc_status_t
+dc_usbhid_session_get (dc_usbhid_session_t **out, dc_context_t *context)
+{
+	void *session = NULL;
+
+	dc_status_t status = dc_context_get_resource (context, DC_RESOURCE_USBHID, &dc_usbhid_session_vtable, &session);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	*out = (dc_usbhid_session_t *) session;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -371,7 +419,7 @@ dc_usbhid_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descripto
 	}
 
 	// Initialize the usb library.
-	status = dc_usbhid_session_new (&iterator->session, context);
+	status = dc_usbhid_session_get (&iterator->session, context);
 	if (status != DC_STATUS_SUCCESS) {
 		goto error_free;
 	}
@@ -616,6 +664,17 @@ dc_usbhid_open (dc_iostream_t **out, dc_context_t *context, dc_usbhid_device_t *
 	usbhid->endpoint_out = device->endpoint_out;
 	usbhid->timeout = 0;
 
+	// Keep several interrupt transfers in flight, to receive the
+	// reports without waiting for the next read. On failure, the
+	// synchronous transfers are used instead.
+	rc = dc_usb_async_new (&usbhid->async, context, usbhid->session->handle,
+		0, usbhid->handle, LIBUSB_TRANSFER_TYPE_INTERRUPT, usbhid->endpoint_in, 0, NTRANSFERS);
+	if (rc != LIBUSB_SUCCESS) {
+		WARNING (context, "Failed to start the asynchronous transfers (%s).",
+			libusb_error_name (rc));
+		usbhid->async = NULL;
+	}
+
 #elif defined(USE_HIDAPI)
 	INFO (context, "Open: path=%s", device->path);
 
@@ -656,6 +715,7 @@ dc_usbhid_close (dc_iostream_t *abstract)
 	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
 
 #if defined(USE_LIBUSB)
+	dc_usb_async_free (usbhid->async);
 	libusb_release_interface (usbhid->handle, usbhid->interface);
 	libusb_close (usbhid->handle);
 #elif defined(USE_HIDAPI)
@@ -693,7 +753,25 @@ dc_usbhid_set_timeout (dc_iostream_t *abstract, int timeout)
 static dc_status_t
 dc_usbhid_poll (dc_iostream_t *abstract, int timeout)
 {
+#if defined(USE_LIBUSB)
+	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
+
+	if (usbhid->async == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	int rc = dc_usb_async_poll (usbhid->async, timeout);
+	if (rc != LIBUSB_SUCCESS) {
+		if (rc != LIBUSB_ERROR_TIMEOUT) {
+			ERROR (abstract->context, "Usb poll failed (%s).",
+				libusb_error_name (rc));
+		}
+		return syserror (rc);
+	}
+
+	return DC_STATUS_SUCCESS;
+#else
 	return DC_STATUS_UNSUPPORTED;
+#endif
 }
 
 static dc_status_t
@@ -704,7 +782,12 @@ dc_usbhid_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 	int nbytes = 0;
 
 #if defined(USE_LIBUSB)
-	int rc = libusb_interrupt_transfer (usbhid->handle, usbhid->endpoint_in, data, size, &nbytes, usbhid->timeout);
+	int rc = 0;
+	if (usbhid->async) {
+		rc = dc_usb_async_read (usbhid->async, data, size, &nbytes, usbhid->timeout);
+	} else {
+		rc = libusb_interrupt_transfer (usbhid->handle, usbhid->endpoint_in, data, size, &nbytes, usbhid->timeout);
+	}
 	if (rc != LIBUSB_SUCCESS || nbytes < 0) {
 		ERROR (abstract->context, "Usb read interrupt transfer failed (%s).",
 			libusb_error_name (rc));
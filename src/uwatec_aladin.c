@@ -57,16 +57,15 @@ static const dc_device_vtable_t uwatec_aladin_device_vtable = {
 	DC_FAMILY_UWATEC_ALADIN,
 	uwatec_aladin_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	uwatec_aladin_device_dump, /* dump */
 	uwatec_aladin_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
-static dc_status_t
-uwatec_aladin_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 dc_status_t
 uwatec_aladin_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -163,7 +162,9 @@ uwatec_aladin_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	unsigned char answer[SZ_MEMORY + 2] = {0};
 
-	// Receive the header of the package.
+	// Receive the header of the package. The Aladin sends its complete
+	// memory after the user starts the transfer, so a partial read of
+	// the changed data is not possible.
 	for (unsigned int i = 0; i < 4;) {
 		if (device_is_cancelled (abstract))
 			return DC_STATUS_CANCELLED;
@@ -256,7 +257,7 @@ uwatec_aladin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback
 }
 
 
-static dc_status_t
+dc_status_t
 uwatec_aladin_extract_dives (dc_device_t *abstract, const unsigned char* data, unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	uwatec_aladin_device_t *device = (uwatec_aladin_device_t*) abstract;
@@ -337,14 +338,7 @@ uwatec_aladin_extract_dives (dc_device_t *abstract, const unsigned char* data, u
 				buffer[16] = (len     ) & 0xFF;
 				buffer[17] = (len >> 8) & 0xFF;
 				// Copy the profile data.
-				if (begin + len > RB_PROFILE_END) {
-					unsigned int a = RB_PROFILE_END - begin;
-					unsigned int b = (begin + len) - RB_PROFILE_END;
-					memcpy (buffer + 18 + 0, data + HEADER + begin, a);
-					memcpy (buffer + 18 + a, data + HEADER,         b);
-				} else {
-					memcpy (buffer + 18, data + HEADER + begin, len);
-				}
+				ringbuffer_copy (buffer + 18, data + HEADER, begin, len, RB_PROFILE_BEGIN, RB_PROFILE_END);
 			}
 
 			// Since the size of the profile ringbuffer is limited,
@@ -36,6 +36,11 @@
 #define ACK 0x60
 #define NAK 0xA8
 
+typedef struct uwatec_memomouse_scan_t {
+	unsigned int previous;
+	unsigned int current;
+} uwatec_memomouse_scan_t;
+
 typedef struct uwatec_memomouse_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
@@ -53,16 +58,15 @@ static const dc_device_vtable_t uwatec_memomouse_device_vtable = {
 	DC_FAMILY_UWATEC_MEMOMOUSE,
 	uwatec_memomouse_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	uwatec_memomouse_device_dump, /* dump */
 	uwatec_memomouse_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
-static dc_status_t
-uwatec_memomouse_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 dc_status_t
 uwatec_memomouse_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream)
 {
@@ -221,8 +225,34 @@ uwatec_memomouse_read_packet_outer (uwatec_memomouse_device_t *device, unsigned
 }
 
 
+/*
+ * Scan the received part of the data stream for the end of the first
+ * copy of the dives, using the same rules as the extraction. The scan
+ * continues from the previous position, and returns the size of the
+ * data up to the end of the first copy, or zero if it isn't complete
+ * yet.
+ */
+static unsigned int
+uwatec_memomouse_scan (uwatec_memomouse_scan_t *scan, const unsigned char data[], unsigned int size)
+{
+	while (scan->current + 18 <= size) {
+		if (scan->previous && memcmp (data + scan->previous, data + scan->current, 18) == 0)
+			return scan->current;
+
+		unsigned int len = array_uint16_le (data + scan->current + 16);
+		if (scan->current + len + 18 > size)
+			break;
+
+		scan->previous = scan->current;
+		scan->current += len + 18;
+	}
+
+	return 0;
+}
+
+
 static dc_status_t
-uwatec_memomouse_read_packet_inner (uwatec_memomouse_device_t *device, dc_buffer_t *buffer, dc_event_progress_t *progress)
+uwatec_memomouse_read_packet_inner (uwatec_memomouse_device_t *device, dc_buffer_t *buffer, dc_event_progress_t *progress, uwatec_memomouse_scan_t *scan)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
@@ -284,6 +314,22 @@ uwatec_memomouse_read_packet_inner (uwatec_memomouse_device_t *device, dc_buffer
 		dc_buffer_append (buffer, packet + 1, length);
 
 		nbytes += length;
+
+		// Stop as soon as the first copy of the dives is complete. The
+		// rest of the data isn't needed, and the inner checksum can't
+		// be verified without it. Every packet has its own checksum.
+		if (scan && nbytes < total) {
+			const unsigned char *data = dc_buffer_get_data (buffer);
+			unsigned int end = uwatec_memomouse_scan (scan, data + 2, nbytes - 2);
+			if (end) {
+				if (progress) {
+					progress->current = progress->maximum;
+					device_event_emit (&device->base, DC_EVENT_PROGRESS, progress);
+				}
+				dc_buffer_slice (buffer, 2, end);
+				return DC_STATUS_DONE;
+			}
+		}
 	}
 
 	// Obtain the pointer to the buffer contents.
@@ -305,7 +351,7 @@ uwatec_memomouse_read_packet_inner (uwatec_memomouse_device_t *device, dc_buffer
 
 
 static dc_status_t
-uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *buffer)
+uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *buffer, uwatec_memomouse_scan_t *scan)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
@@ -332,7 +378,7 @@ uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *
 	}
 
 	// Read the ID string.
-	dc_status_t rc = uwatec_memomouse_read_packet_inner (device, buffer, NULL);
+	dc_status_t rc = uwatec_memomouse_read_packet_inner (device, buffer, NULL, NULL);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
@@ -393,8 +439,8 @@ uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *
 	dc_ticks_t now = dc_datetime_now ();
 
 	// Read the data packet.
-	rc = uwatec_memomouse_read_packet_inner (device, buffer, &progress);
-	if (rc != DC_STATUS_SUCCESS)
+	rc = uwatec_memomouse_read_packet_inner (device, buffer, &progress, scan);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_DONE)
 		return rc;
 
 	// Store the clock calibration values.
@@ -407,12 +453,12 @@ uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *
 	clock.devtime = device->devtime;
 	device_event_emit ((dc_device_t *) device, DC_EVENT_CLOCK, &clock);
 
-	return DC_STATUS_SUCCESS;
+	return rc;
 }
 
 
 static dc_status_t
-uwatec_memomouse_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
+uwatec_memomouse_transfer (dc_device_t *abstract, dc_buffer_t *buffer, uwatec_memomouse_scan_t *scan)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	uwatec_memomouse_device_t *device = (uwatec_memomouse_device_t*) abstract;
@@ -430,7 +476,7 @@ uwatec_memomouse_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	}
 
 	// Start the transfer.
-	status = uwatec_memomouse_dump_internal (device, buffer);
+	status = uwatec_memomouse_dump_internal (device, buffer, scan);
 
 	// Clear the DTR line again.
 	rc = dc_iostream_set_dtr (device->iostream, 0);
@@ -439,10 +485,24 @@ uwatec_memomouse_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 		return rc;
 	}
 
+	// Discard the remainder of an interrupted transfer.
+	if (status == DC_STATUS_DONE) {
+		dc_iostream_sleep (device->iostream, 100);
+		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+		status = DC_STATUS_SUCCESS;
+	}
+
 	return status;
 }
 
 
+static dc_status_t
+uwatec_memomouse_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
+{
+	return uwatec_memomouse_transfer (abstract, buffer, NULL);
+}
+
+
 static dc_status_t
 uwatec_memomouse_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
@@ -450,7 +510,9 @@ uwatec_memomouse_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
-	dc_status_t rc = uwatec_memomouse_device_dump (abstract, buffer);
+	// Only the first copy of the dives is downloaded.
+	uwatec_memomouse_scan_t scan = {0, 5};
+	dc_status_t rc = uwatec_memomouse_transfer (abstract, buffer, &scan);
 	if (rc != DC_STATUS_SUCCESS) {
 		dc_buffer_free (buffer);
 		return rc;
@@ -465,7 +527,7 @@ uwatec_memomouse_device_foreach (dc_device_t *abstract, dc_dive_callback_t callb
 }
 
 
-static dc_status_t
+dc_status_t
 uwatec_memomouse_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	if (abstract && !ISINSTANCE (abstract))
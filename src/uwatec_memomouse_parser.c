@@ -304,7 +304,8 @@ uwatec_memomouse_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callba
 				offset++;
 			}
 
-			if (callback) callback (DC_SAMPLE_VENDOR, sample, userdata);
+			if (callback && PARSER_SAMPLE_WANTED (abstract, DC_SAMPLE_VENDOR))
+				callback (DC_SAMPLE_VENDOR, sample, userdata);
 		}
 
 		time += 20;
@@ -24,6 +24,7 @@
 
 #include "uwatec_smart.h"
 #include "context-private.h"
+#include "iostream-private.h"
 #include "device-private.h"
 #include "checksum.h"
 #include "platform.h"
@@ -73,16 +74,15 @@ static const dc_device_vtable_t uwatec_smart_device_vtable = {
 	DC_FAMILY_UWATEC_SMART,
 	uwatec_smart_device_set_fingerprint, /* set_fingerprint */
 	NULL, /* read */
+	NULL, /* read_multi */
 	NULL, /* write */
 	uwatec_smart_device_dump, /* dump */
 	uwatec_smart_device_foreach, /* foreach */
 	NULL, /* timesync */
+	NULL, /* keepalive */
 	NULL /* close */
 };
 
-static dc_status_t
-uwatec_smart_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 static dc_status_t
 uwatec_smart_irda_send (uwatec_smart_device_t *device, unsigned char cmd, const unsigned char data[], size_t size)
 {
@@ -234,6 +234,8 @@ uwatec_smart_serial_receive (uwatec_smart_device_t *device, dc_event_progress_t
 			return DC_STATUS_PROTOCOL;
 		}
 
+		unsigned char ccsum = checksum_xor_uint8_update (header, sizeof (header), 0x00);
+
 		// Read the packet data.
 		status = dc_iostream_read (device->iostream, data + nbytes, len - 1, NULL);
 		if (status != DC_STATUS_SUCCESS) {
@@ -241,6 +243,8 @@ uwatec_smart_serial_receive (uwatec_smart_device_t *device, dc_event_progress_t
 			return status;
 		}
 
+		ccsum = checksum_xor_uint8_update (data + nbytes, len - 1, ccsum);
+
 		// Read the checksum.
 		unsigned char csum = 0x00;
 		status = dc_iostream_read (device->iostream, &csum, sizeof (csum), NULL);
@@ -250,10 +254,7 @@ uwatec_smart_serial_receive (uwatec_smart_device_t *device, dc_event_progress_t
 		}
 
 		// Verify the checksum.
-		unsigned char ccsum = 0x00;
-		ccsum = checksum_xor_uint8 (header, sizeof (header), ccsum);
-		ccsum = checksum_xor_uint8 (data + nbytes, len - 1, ccsum);
-		if (csum != ccsum) {
+		if (csum != checksum_xor_uint8_final (ccsum)) {
 			ERROR (abstract->context, "Unexpected answer checksum.");
 			return DC_STATUS_PROTOCOL;
 		}
@@ -370,7 +371,7 @@ uwatec_smart_usbhid_receive (uwatec_smart_device_t *device, dc_event_progress_t
 
 		HEXDUMP (abstract->context, DC_LOGLEVEL_DEBUG, "rcv", buf + 1, len);
 
-		if (len > size) {
+		if (len > size - nbytes) {
 			ERROR (abstract->context, "Insufficient buffer space available.");
 			return DC_STATUS_PROTOCOL;
 		}
@@ -470,6 +471,9 @@ uwatec_smart_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 	device->systime = (dc_ticks_t) -1;
 	device->devtime = 0;
 
+	// Request a short BLE connection interval.
+	dc_iostream_ble_prefer (iostream, 0, BLE_INTERVAL_MIN, 0);
+
 	// Set the serial communication protocol (57600 8N1).
 	status = dc_iostream_configure (device->iostream, 57600, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -674,7 +678,7 @@ uwatec_smart_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback,
 }
 
 
-static dc_status_t
+dc_status_t
 uwatec_smart_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
 {
 	if (abstract && !ISINSTANCE (abstract))
@@ -28,6 +28,7 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "array.h"
+#include "reader.h"
 
 #define ISINSTANCE(parser) dc_parser_isinstance((parser), &uwatec_smart_parser_vtable)
 
@@ -57,6 +58,7 @@
 #define UNSUPPORTED 0xFFFFFFFF
 
 #define NEVENTS   3
+#define NSAMPLES  32
 #define NGASMIXES 10
 
 #define HEADER  1
@@ -117,6 +119,12 @@ typedef struct uwatec_smart_sample_info_t {
 	unsigned int extrabytes;
 } uwatec_smart_sample_info_t;
 
+typedef struct uwatec_smart_decoder_t {
+	unsigned int skip;   // Number of type bytes to skip
+	unsigned int nbytes; // Number of bytes containing the data bits
+	unsigned int nbits;  // Number of data bits
+} uwatec_smart_decoder_t;
+
 typedef struct uwatec_smart_event_info_t {
 	uwatec_smart_event_t type;
 	unsigned int mask;
@@ -147,6 +155,8 @@ struct uwatec_smart_parser_t {
 	const uwatec_smart_header_info_t *header;
 	unsigned int headersize;
 	unsigned int nsamples;
+	unsigned char lookup[256];
+	uwatec_smart_decoder_t decoder[NSAMPLES];
 	const uwatec_smart_event_info_t *events[NEVENTS];
 	unsigned int nevents[NEVENTS];
 	unsigned int trimix;
@@ -167,6 +177,9 @@ static dc_status_t uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, d
 
 static dc_status_t uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+static unsigned int uwatec_smart_identify (const unsigned char data[], unsigned int size);
+static unsigned int uwatec_galileo_identify (unsigned char value);
+
 static const dc_parser_vtable_t uwatec_smart_parser_vtable = {
 	sizeof(uwatec_smart_parser_t),
 	DC_FAMILY_UWATEC_SMART,
@@ -268,6 +281,9 @@ uwatec_smart_header_info_t uwatec_smart_tec_header = {
 	UNSUPPORTED, /* settings */
 };
 
+#define LOOKUP_ESCAPE  0xFE
+#define LOOKUP_INVALID 0xFF
+
 static const
 uwatec_smart_sample_info_t uwatec_smart_pro_samples[] = {
 	{DEPTH,          0, 0, 1, 0, 0}, // 0ddddddd
@@ -571,6 +587,44 @@ uwatec_smart_parser_cache (uwatec_smart_parser_t *parser)
 }
 
 
+static void
+uwatec_smart_parser_init_decoder (uwatec_smart_parser_t *parser)
+{
+	const uwatec_smart_sample_info_t *table = parser->samples;
+	unsigned int entries = parser->nsamples;
+
+	// Build the first byte lookup table. The Galileo type bits always
+	// fit in the first byte, but the type bits of the Smart models can
+	// continue in the next byte if all bits of the first byte are set.
+	int galileo = (table == uwatec_smart_galileo_samples);
+	for (unsigned int i = 0; i < 256; ++i) {
+		unsigned char value = i;
+		unsigned int id = galileo ?
+			uwatec_galileo_identify (value) :
+			uwatec_smart_identify (&value, 1);
+		if (id == (unsigned int) -1)
+			parser->lookup[i] = LOOKUP_ESCAPE;
+		else if (id >= entries)
+			parser->lookup[i] = LOOKUP_INVALID;
+		else
+			parser->lookup[i] = id;
+	}
+
+	// Precompute the position and size of the data bits.
+	for (unsigned int i = 0; i < entries; ++i) {
+		unsigned int n = table[i].ntypebits % NBITS;
+		parser->decoder[i].skip = table[i].ntypebits / NBITS;
+		parser->decoder[i].nbytes = table[i].extrabytes + (n > 0);
+		parser->decoder[i].nbits = table[i].extrabytes * NBITS;
+		if (n > 0 && !table[i].ignoretype) {
+			// The data bits in the last type byte are only
+			// used for some samples.
+			parser->decoder[i].nbits += NBITS - n;
+		}
+	}
+}
+
+
 dc_status_t
 uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, unsigned int model, unsigned int devtime, dc_ticks_t systime)
 {
@@ -682,6 +736,8 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, unsigned i
 		goto error_free;
 	}
 
+	uwatec_smart_parser_init_decoder (parser);
+
 	parser->cached = 0;
 	parser->ngasmixes = 0;
 	parser->ntanks = 0;
@@ -960,23 +1016,17 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 	int have_depth = 0, have_temperature = 0, have_pressure = 0, have_rbt = 0,
 		have_heartrate = 0, have_bearing = 0;
 
-	unsigned int offset = parser->headersize;
-	while (offset < size) {
+	dc_reader_t reader;
+	dc_reader_init (&reader, data, size);
+	dc_reader_skip (&reader, parser->headersize);
+	while (dc_reader_remaining (&reader)) {
 		dc_sample_value_t sample = {0};
 
 		// Process the type bits in the bitstream.
-		unsigned int id = 0;
-		if (parser->model == GALILEO || parser->model == GALILEOTRIMIX ||
-			parser->model == ALADIN2G || parser->model == MERIDIAN ||
-			parser->model == CHROMIS || parser->model == MANTIS2 ||
-			parser->model == G2 || parser->model == ALADINSPORTMATRIX ||
-			parser->model == ALADINSQUARE || parser->model == G2HUD ||
-			parser->model == ALADINA1 || parser->model == ALADINA2 ) {
-			// Uwatec Galileo
-			id = uwatec_galileo_identify (data[offset]);
-		} else {
-			// Uwatec Smart
-			id = uwatec_smart_identify (data + offset, size - offset);
+		const unsigned char *p = dc_reader_current (&reader);
+		unsigned int id = parser->lookup[p[0]];
+		if (id == LOOKUP_ESCAPE) {
+			id = uwatec_smart_identify (p, dc_reader_remaining (&reader));
 		}
 		if (id >= entries) {
 			ERROR (abstract->context, "Invalid type bits.");
@@ -984,37 +1034,18 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 		}
 
 		// Skip the processed type bytes.
-		offset += table[id].ntypebits / NBITS;
-
-		// Process the remaining data bits.
-		unsigned int nbits = 0;
-		unsigned int value = 0;
-		unsigned int n = table[id].ntypebits % NBITS;
-		if (n > 0) {
-			nbits = NBITS - n;
-			value = data[offset] & (0xFF >> n);
-			if (table[id].ignoretype) {
-				// Ignore any data bits that are stored in
-				// the last type byte for certain samples.
-				nbits = 0;
-				value = 0;
-			}
-			offset++;
-		}
+		const uwatec_smart_decoder_t *decoder = parser->decoder + id;
+		dc_reader_skip (&reader, decoder->skip);
 
 		// Check for buffer overflows.
-		if (offset + table[id].extrabytes > size) {
+		if (!dc_reader_require (&reader, decoder->nbytes)) {
 			ERROR (abstract->context, "Incomplete sample data.");
 			return DC_STATUS_DATAFORMAT;
 		}
 
-		// Process the extra data bytes.
-		for (unsigned int i = 0; i < table[id].extrabytes; ++i) {
-			nbits += NBITS;
-			value <<= NBITS;
-			value += data[offset];
-			offset++;
-		}
+		// Read all data bytes at once, and strip the type bits.
+		unsigned int nbits = decoder->nbits;
+		unsigned int value = dc_reader_bits (&reader, decoder->nbytes, nbits);
 
 		// Fix the sign bit.
 		signed int svalue = uwatec_smart_fixsignbit (value, nbits);
@@ -1023,6 +1054,7 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 		unsigned int idx = 0;
 		unsigned int subtype = 0;
 		unsigned int nevents = 0;
+		dc_reader_t record;
 		const uwatec_smart_event_info_t *events = NULL;
 		switch (table[id].type) {
 		case PRESSURE_DEPTH:
@@ -1115,19 +1147,19 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 			complete = value;
 			break;
 		case APNEA:
-			if (offset + 8 > size) {
+			if (!dc_reader_require (&reader, 8)) {
 				ERROR (abstract->context, "Incomplete sample data.");
 				return DC_STATUS_DATAFORMAT;
 			}
-			offset += 8;
+			dc_reader_skip (&reader, 8);
 			break;
 		case MISC:
-			if (value < 1 || offset + value - 1 > size) {
+			if (value < 1 || !dc_reader_split (&reader, &record, value - 1)) {
 				ERROR (abstract->context, "Incomplete sample data.");
 				return DC_STATUS_DATAFORMAT;
 			}
 
-			subtype = data[offset];
+			subtype = dc_reader_u8 (&record);
 			if (subtype >= 32 && subtype <= 41) {
 				if (value < 16) {
 					ERROR (abstract->context, "Incomplete sample data.");
@@ -1135,10 +1167,10 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 				}
 				unsigned int mixid = subtype - 32;
 				unsigned int mixidx = DC_GASMIX_UNKNOWN;
-				unsigned int o2 = array_uint16_le (data + offset + 1);
-				unsigned int he = array_uint16_le (data + offset + 3);
-				unsigned int beginpressure = array_uint16_le (data + offset + 5);
-				unsigned int endpressure   = array_uint16_le (data + offset + 7);
+				unsigned int o2 = dc_reader_u16le (&record);
+				unsigned int he = dc_reader_u16le (&record);
+				unsigned int beginpressure = dc_reader_u16le (&record);
+				unsigned int endpressure   = dc_reader_u16le (&record);
 
 				if (o2 != 0 || he != 0) {
 					idx = uwatec_smart_find_gasmix (parser, mixid);
@@ -1171,8 +1203,6 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 					}
 				}
 			}
-
-			offset += value - 1;
 			break;
 		default:
 			WARNING (abstract->context, "Unknown sample type.");
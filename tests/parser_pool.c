@@ -0,0 +1,134 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/parser.h>
+#include <libdivecomputer/reefnet_sensusultra.h>
+
+#include "parser-private.h"
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) { \
+			fprintf (stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #expr); \
+			return 1; \
+		} \
+	} while (0)
+
+static dc_descriptor_t *
+find_descriptor (dc_family_t family)
+{
+	dc_iterator_t *iterator = NULL;
+	dc_descriptor_t *descriptor = NULL;
+
+	if (dc_descriptor_iterator (&iterator) != DC_STATUS_SUCCESS)
+		return NULL;
+
+	while (dc_iterator_next (iterator, &descriptor) == DC_STATUS_SUCCESS) {
+		if (dc_descriptor_get_type (descriptor) == family)
+			break;
+		dc_descriptor_free (descriptor);
+		descriptor = NULL;
+	}
+
+	dc_iterator_free (iterator);
+
+	return descriptor;
+}
+
+static int
+test_reset (dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	dc_parser_pool_t *pool = NULL;
+	dc_parser_cache_t *cache = NULL;
+	dc_parser_t *parser = NULL, *other = NULL;
+
+	CHECK (dc_parser_pool_new (&pool, context) == DC_STATUS_SUCCESS);
+	CHECK (dc_parser_cache_new (&cache, context, 4) == DC_STATUS_SUCCESS);
+
+	// A configured parser is handed out again, without its configuration.
+	CHECK (dc_parser_pool_get (pool, &parser, descriptor, 0, 0) == DC_STATUS_SUCCESS);
+	CHECK (dc_parser_set_cache (parser, cache) == DC_STATUS_SUCCESS);
+	CHECK (dc_parser_set_vendor_samples (parser, 0) == DC_STATUS_SUCCESS);
+	CHECK (dc_parser_pool_put (pool, parser) == DC_STATUS_SUCCESS);
+	dc_parser_cache_free (cache);
+
+	CHECK (dc_parser_pool_get (pool, &other, descriptor, 0, 0) == DC_STATUS_SUCCESS);
+	CHECK (other == parser);
+	CHECK (other->cache == NULL);
+	CHECK ((other->flags & PARSER_NOVENDOR) == 0);
+	CHECK (other->entry == NULL && other->data == NULL);
+	CHECK (dc_parser_pool_put (pool, other) == DC_STATUS_SUCCESS);
+
+	dc_parser_pool_free (pool);
+
+	return 0;
+}
+
+static int
+test_calibration (dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	dc_parser_pool_t *pool = NULL;
+	dc_parser_t *parser = NULL;
+	unsigned int settings = 0;
+
+	CHECK (dc_parser_pool_new (&pool, context) == DC_STATUS_SUCCESS);
+
+	// A calibrated parser is destroyed instead of handed out again.
+	CHECK (dc_parser_pool_get (pool, &parser, descriptor, 0, 0) == DC_STATUS_SUCCESS);
+	settings = parser->settings;
+	CHECK (reefnet_sensusultra_parser_set_calibration (parser, 1100.0, 1.0) == DC_STATUS_SUCCESS);
+	CHECK (parser->settings != settings);
+	CHECK (dc_parser_pool_put (pool, parser) == DC_STATUS_SUCCESS);
+
+	CHECK (dc_parser_pool_get (pool, &parser, descriptor, 0, 0) == DC_STATUS_SUCCESS);
+	CHECK (parser->settings == settings);
+	CHECK (dc_parser_pool_put (pool, parser) == DC_STATUS_SUCCESS);
+
+	dc_parser_pool_free (pool);
+
+	return 0;
+}
+
+int
+main (void)
+{
+	dc_context_t *context = NULL;
+	dc_descriptor_t *descriptor = NULL;
+	int result = 1;
+
+	if (dc_context_new (&context) != DC_STATUS_SUCCESS)
+		return 1;
+
+	descriptor = find_descriptor (DC_FAMILY_REEFNET_SENSUSULTRA);
+	if (descriptor == NULL)
+		goto cleanup;
+
+	result = test_reset (context, descriptor) || test_calibration (context, descriptor);
+
+cleanup:
+	dc_descriptor_free (descriptor);
+	dc_context_free (context);
+	return result;
+}